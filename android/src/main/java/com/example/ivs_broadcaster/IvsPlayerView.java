@@ -4,6 +4,7 @@ package com.example.ivs_broadcaster;
 import android.content.Context;
 import android.net.Uri;
 import android.util.Log;
+import android.view.Choreographer;
 import android.view.Surface;
 import android.view.SurfaceHolder;
 import android.view.SurfaceView;
@@ -35,6 +36,28 @@ public class IvsPlayerView extends Player.Listener implements PlatformView, Surf
     private final SurfaceView surfaceView;
     private Surface surface;
     private EventChannel.EventSink eventSink;
+    private final ThumbnailEngine thumbnails = new ThumbnailEngine();
+
+    // Pushes playback position to Dart on display frames, throttled to
+    // positionUpdateRate, instead of Dart polling "position".
+    private final Choreographer choreographer = Choreographer.getInstance();
+    private long positionIntervalNanos = 0;
+    private long lastPositionNanos = 0;
+    private boolean positionUpdatesScheduled = false;
+    private final Choreographer.FrameCallback positionCallback = new Choreographer.FrameCallback() {
+        @Override
+        public void doFrame(long frameTimeNanos) {
+            positionUpdatesScheduled = false;
+            if (positionIntervalNanos == 0 || surface == null) {
+                return;
+            }
+            if (frameTimeNanos - lastPositionNanos >= positionIntervalNanos) {
+                lastPositionNanos = frameTimeNanos;
+                sendPlayback();
+            }
+            schedulePositionUpdates();
+        }
+    };
 
     public IvsPlayerView(Context context, BinaryMessenger messenger, int viewId, Object args) {
         this.player = new PlayerView(context).getPlayer();
@@ -72,6 +95,8 @@ public class IvsPlayerView extends Player.Listener implements PlatformView, Surf
 
     @Override
     public void dispose() {
+        setPositionUpdateRate(0);
+        thumbnails.shutdown();
         player.removeListener(this);
         player.release();
     }
@@ -82,6 +107,7 @@ public class IvsPlayerView extends Player.Listener implements PlatformView, Surf
         if (player != null) {
             player.setSurface(this.surface);
         }
+        schedulePositionUpdates();
     }
 
     @Override
@@ -91,6 +117,7 @@ public class IvsPlayerView extends Player.Listener implements PlatformView, Surf
 
     @Override
     public void surfaceDestroyed(@NonNull SurfaceHolder holder) {
+        // The callback sees the null surface and stops rescheduling itself.
         this.surface = null;
         if (player != null) {
             player.setSurface(null);
@@ -118,6 +145,8 @@ public class IvsPlayerView extends Player.Listener implements PlatformView, Surf
                 String url = (String) args.get("url");
                 Boolean autoPlay = (Boolean) args.get("autoPlay");
                 startPlayer(url, autoPlay);
+                Number positionUpdateRate = (Number) args.get("positionUpdateRate");
+                setPositionUpdateRate(positionUpdateRate != null ? positionUpdateRate.intValue() : 10);
                 result.success(true);
                 break;
             case "stopPlayer":
@@ -162,12 +191,66 @@ public class IvsPlayerView extends Player.Listener implements PlatformView, Surf
             case "isAuto":
                 result.success(isAuto());
                 break;
+            case "getScreenshot":
+                getScreenshot(args, result);
+                break;
             default:
                 result.notImplemented();
                 break;
         }
     }
 
+    private void getScreenshot(Map<String, Object> args, MethodChannel.Result result) {
+        Object url = args != null ? args.get("url") : null;
+        if (!(url instanceof String)) {
+            result.error("INVALID_ARGUMENTS", "url is required", null);
+            return;
+        }
+        thumbnails.request((String) url, number(args.get("time"), 0).doubleValue(),
+                number(args.get("width"), 320).intValue(), number(args.get("height"), 180).intValue(),
+                args.get("format") instanceof String ? (String) args.get("format") : "jpeg",
+                number(args.get("quality"), 80).intValue(), (data, error) -> {
+                    if (data != null) {
+                        result.success(data);
+                    } else {
+                        result.error("THUMBNAIL_FAILED", error, null);
+                    }
+                });
+    }
+
+    private static Number number(Object value, Number fallback) {
+        return value instanceof Number ? (Number) value : fallback;
+    }
+
+    private void setPositionUpdateRate(int rate) {
+        positionIntervalNanos = rate > 0 ? 1_000_000_000L / rate : 0;
+        // A slightly early frame should not skip a whole interval.
+        positionIntervalNanos -= positionIntervalNanos / 10;
+        lastPositionNanos = 0;
+        if (positionIntervalNanos == 0) {
+            choreographer.removeFrameCallback(positionCallback);
+            positionUpdatesScheduled = false;
+        } else {
+            schedulePositionUpdates();
+        }
+    }
+
+    private void schedulePositionUpdates() {
+        if (positionUpdatesScheduled || positionIntervalNanos == 0 || surface == null) {
+            return;
+        }
+        positionUpdatesScheduled = true;
+        choreographer.postFrameCallback(positionCallback);
+    }
+
+    private void sendPlayback() {
+        HashMap<String, Object> data = new HashMap<>();
+        data.put("position", player.getPosition() / 1000.0);
+        data.put("bufferedPosition", player.getBufferedPosition() / 1000.0);
+        data.put("liveLatency", player.getLiveLatency() / 1000.0);
+        sendEvent(data);
+    }
+
     private void seekPlayer(String time) {
         if (player != null) {
             player.seekTo(Long.parseLong(time));
@@ -40,6 +40,7 @@ import com.google.gson.Gson;
 
 import java.util.Arrays;
 import java.util.HashMap;
+import java.util.List;
 import java.util.Map;
 
 import io.flutter.plugin.common.EventChannel;
@@ -138,8 +139,16 @@ public class StreamView implements PlatformView, MethodChannel.MethodCallHandler
                 result.success(isMuted);
                 break;
             case METHOD_SEND_TIME_METADATA:
-                sendMetaData(call.argument("metadata"));
-                result.success(true);
+                int sent = 0;
+                String metadata = call.argument("metadata");
+                if (metadata != null && sendMetaData(metadata)) sent++;
+                List<String> messages = call.argument("messages");
+                if (messages != null) {
+                    for (String message : messages) {
+                        if (sendMetaData(message)) sent++;
+                    }
+                }
+                result.success(sent);
                 break;
             case METHOD_GET_CAMERA_ZOOM_FACTOR:
                 result.success(getCameraZoomFactor());
@@ -159,10 +168,9 @@ public class StreamView implements PlatformView, MethodChannel.MethodCallHandler
         return Map.of();
     }
 
-    private void sendMetaData(String metadata) {
-        if (broadcastSession != null) {
-            broadcastSession.sendTimedMetadata(metadata);
-        }
+    private boolean sendMetaData(String metadata) {
+        if (broadcastSession == null) return false;
+        return broadcastSession.sendTimedMetadata(metadata);
     }
 
     private TextureView cameraPreview;
@@ -0,0 +1,140 @@
+package com.example.ivs_broadcaster;
+
+import android.graphics.Bitmap;
+import android.media.MediaMetadataRetriever;
+import android.os.Build;
+import android.os.Handler;
+import android.os.Looper;
+import android.util.LruCache;
+
+import java.io.ByteArrayOutputStream;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+
+/**
+ * Produces thumbnails off the main thread.
+ *
+ * <p>A small worker pool decodes the sync frame nearest the requested time with
+ * {@link MediaMetadataRetriever}, scales it into the requested box and encodes
+ * it as JPEG or WebP. Results are kept in a byte-bounded {@link LruCache} keyed
+ * by (url, time bucket, size, format); identical requests in flight share one
+ * decode.
+ */
+final class ThumbnailEngine {
+    interface Callback {
+        /** Called on the main thread with the encoded image, or null and an error. */
+        void onThumbnail(byte[] data, String error);
+    }
+
+    private static final long BUCKET_US = 2_000_000L;
+    private static final int CACHE_BYTES = 16 * 1024 * 1024;
+
+    private final ExecutorService workers = Executors.newFixedThreadPool(2);
+    private final Handler mainHandler = new Handler(Looper.getMainLooper());
+    private final LruCache<String, byte[]> cache = new LruCache<String, byte[]>(CACHE_BYTES) {
+        @Override
+        protected int sizeOf(String key, byte[] value) {
+            return value.length;
+        }
+    };
+    // Callbacks waiting on each key being decoded. Main thread only.
+    private final Map<String, List<Callback>> waiting = new HashMap<>();
+
+    /** Must be called on the main thread. */
+    void request(String url, double timeSeconds, int width, int height, String format,
+                 int quality, Callback callback) {
+        final long timeUs = (long) (Math.max(0, timeSeconds) * 1_000_000);
+        final String key = url + "|" + (timeUs / BUCKET_US) + "|" + width + "x" + height + "|" + format;
+        byte[] cached = cache.get(key);
+        if (cached != null) {
+            callback.onThumbnail(cached, null);
+            return;
+        }
+        List<Callback> callbacks = waiting.get(key);
+        if (callbacks != null) {
+            callbacks.add(callback);
+            return;
+        }
+        callbacks = new ArrayList<>();
+        callbacks.add(callback);
+        waiting.put(key, callbacks);
+
+        workers.execute(() -> {
+            byte[] data = null;
+            String error = null;
+            try {
+                data = produce(url, timeUs, width, height, format, quality);
+            } catch (Exception e) {
+                error = e.getMessage() != null ? e.getMessage() : e.toString();
+            }
+            final byte[] result = data;
+            final String failure = error;
+            mainHandler.post(() -> {
+                if (result != null) {
+                    cache.put(key, result);
+                }
+                List<Callback> done = waiting.remove(key);
+                if (done == null) {
+                    return;
+                }
+                for (Callback waiter : done) {
+                    waiter.onThumbnail(result, failure);
+                }
+            });
+        });
+    }
+
+    void shutdown() {
+        workers.shutdownNow();
+        cache.evictAll();
+    }
+
+    private static byte[] produce(String url, long timeUs, int width, int height, String format,
+                                  int quality) throws Exception {
+        MediaMetadataRetriever retriever = new MediaMetadataRetriever();
+        try {
+            retriever.setDataSource(url, new HashMap<>());
+            Bitmap frame;
+            if (Build.VERSION.SDK_INT >= 27) {
+                // Decodes straight into the box; no full-size bitmap.
+                frame = retriever.getScaledFrameAtTime(timeUs,
+                        MediaMetadataRetriever.OPTION_CLOSEST_SYNC, width, height);
+            } else {
+                frame = retriever.getFrameAtTime(timeUs, MediaMetadataRetriever.OPTION_CLOSEST_SYNC);
+                if (frame != null) {
+                    float scale = Math.min(1f, Math.min((float) width / frame.getWidth(),
+                            (float) height / frame.getHeight()));
+                    Bitmap scaled = Bitmap.createScaledBitmap(frame,
+                            Math.max(1, Math.round(frame.getWidth() * scale)),
+                            Math.max(1, Math.round(frame.getHeight() * scale)), true);
+                    if (scaled != frame) {
+                        frame.recycle();
+                    }
+                    frame = scaled;
+                }
+            }
+            if (frame == null) {
+                throw new IllegalStateException("No frame near the requested time");
+            }
+            ByteArrayOutputStream out = new ByteArrayOutputStream();
+            frame.compress(compressFormat(format), quality, out);
+            frame.recycle();
+            return out.toByteArray();
+        } finally {
+            retriever.release();
+        }
+    }
+
+    @SuppressWarnings("deprecation")
+    private static Bitmap.CompressFormat compressFormat(String format) {
+        if (!"webp".equals(format)) {
+            return Bitmap.CompressFormat.JPEG;
+        }
+        return Build.VERSION.SDK_INT >= 30 ? Bitmap.CompressFormat.WEBP_LOSSY
+                : Bitmap.CompressFormat.WEBP;
+    }
+}
@@ -1,6 +1,8 @@
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
+import 'package:ivs_broadcaster/Player/Classes/sprite_sheets.dart';
 import 'package:ivs_broadcaster/Player/Widget/ivs_player_view.dart';
+import 'package:ivs_broadcaster/Player/Widget/sprite_preview.dart';
 import 'package:ivs_broadcaster/Player/ivs_player.dart';
 import 'package:ivs_broadcaster/helpers/enums.dart';
 
@@ -24,6 +26,41 @@ class _PlayerPageState extends State<PlayerPage> {
   final player4 =
       "https://4c62a87c1810.us-west-2.playback.live-video.net/api/video/v1/us-west-2.049054135175.channel.NUiimXpVUGyr.m3u8?player_version=1.19.0";
 
+  // The stream playing, and the sprite sheets previewing it while the seek
+  // slider is dragged; null for live streams.
+  String? _url;
+  String? _spritesUrl;
+  final sprites = ValueNotifier<SpriteSheets?>(null);
+  final scrubPosition = ValueNotifier<Duration?>(null);
+
+  // Shows [url], then loads its sprites once [started], the call playing it,
+  // completes.
+  Future<void> _play(String url, Future<void> started) async {
+    _url = url;
+    sprites.value = null;
+    try {
+      await started;
+    } catch (_) {
+      return;
+    }
+    if (mounted && url == _url) _loadSprites();
+  }
+
+  // Sprites are built once per VOD stream, in the background, and cached on
+  // disk, so scrubbing previews need no network requests. Generating them
+  // fails for live streams, which scrub without previews.
+  Future<void> _loadSprites() async {
+    final url = _url;
+    if (url == null || url == _spritesUrl) return;
+    _spritesUrl = url;
+    try {
+      final sheets = await _player.generateSprites(url: url);
+      if (mounted && url == _url) sprites.value = sheets;
+    } catch (_) {
+      // Live streams and platforms without sprites scrub without previews.
+    }
+  }
+
   @override
   void initState() {
     _player = IvsPlayer.instance;
@@ -32,12 +69,15 @@ class _PlayerPageState extends State<PlayerPage> {
         "https://4c62a87c1810.us-west-2.playback.live-video.net/api/video/v1/us-west-2.049054135175.channel.JmLwVqcdvTLO.m3u8";
     WidgetsBinding.instance.addPostFrameCallback(
       (timeStamp) {
-        _player.multiPlayer([
+        _play(
           player1,
-          player2,
-          player3,
-          player4,
-        ]);
+          _player.multiPlayer([
+            player1,
+            player2,
+            player3,
+            player4,
+          ]),
+        );
       },
     );
   }
@@ -103,9 +143,12 @@ class _PlayerPageState extends State<PlayerPage> {
                                         ElevatedButton(
                                           child: const Text("Load"),
                                           onPressed: () {
-                                            _player.startPlayer(
+                                            _play(
                                               urlController.text,
-                                              autoPlay: autoPlay.value,
+                                              _player.startPlayer(
+                                                urlController.text,
+                                                autoPlay: autoPlay.value,
+                                              ),
                                             );
                                           },
                                         ),
@@ -231,6 +274,23 @@ class _PlayerPageState extends State<PlayerPage> {
                                       ),
                                     ],
                                   ),
+                                  ValueListenableBuilder<Duration?>(
+                                    valueListenable: scrubPosition,
+                                    builder: (context, scrub, child) {
+                                      final cell = scrub == null
+                                          ? null
+                                          : sprites.value?.cellAt(scrub);
+                                      if (cell == null) {
+                                        return const SizedBox.shrink();
+                                      }
+                                      return Column(
+                                        children: [
+                                          SpritePreview(cell: cell),
+                                          Text(_printDuration(scrub!)),
+                                        ],
+                                      );
+                                    },
+                                  ),
                                   Row(
                                     children: [
                                       StreamBuilder<Duration>(
@@ -252,27 +312,47 @@ class _PlayerPageState extends State<PlayerPage> {
                                               stream:
                                                   _player.positionStream.stream,
                                               builder: (context, position) {
-                                                return Slider(
-                                                  onChanged: (value) {
-                                                    _player.seekTo(Duration(
-                                                        seconds:
-                                                            value.toInt()));
+                                                final max = getMax(
+                                                  position.data,
+                                                  duration.data,
+                                                );
+                                                return ValueListenableBuilder<
+                                                    Duration?>(
+                                                  valueListenable:
+                                                      scrubPosition,
+                                                  builder:
+                                                      (context, scrub, child) {
+                                                    // Previews while
+                                                    // dragging, seeks on
+                                                    // release.
+                                                    return Slider(
+                                                      onChanged: (value) {
+                                                        scrubPosition.value =
+                                                            Duration(
+                                                          seconds:
+                                                              value.toInt(),
+                                                        );
+                                                      },
+                                                      onChangeEnd: (value) {
+                                                        scrubPosition.value =
+                                                            null;
+                                                        _player.seekTo(
+                                                          Duration(
+                                                            seconds:
+                                                                value.toInt(),
+                                                          ),
+                                                        );
+                                                      },
+                                                      value: (scrub ??
+                                                                  position
+                                                                      .data)
+                                                              ?.inSeconds
+                                                              .toDouble() ??
+                                                          0,
+                                                      min: 0,
+                                                      max: max < 1 ? 1 : max,
+                                                    );
                                                   },
-                                                  value: position
-                                                          .data?.inSeconds
-                                                          .toDouble() ??
-                                                      0,
-                                                  min: 0,
-                                                  max: getMax(
-                                                            position.data,
-                                                            duration.data,
-                                                          ) <
-                                                          1
-                                                      ? 1
-                                                      : getMax(
-                                                          position.data,
-                                                          duration.data,
-                                                        ),
                                                 );
                                               },
                                             );
@@ -320,7 +400,10 @@ class _PlayerPageState extends State<PlayerPage> {
                                             player3,
                                             player4,
                                           ][index];
-                                          _player.selectPlayer(playerid);
+                                          _play(
+                                            playerid,
+                                            _player.selectPlayer(playerid),
+                                          );
                                           // final image =
                                           //     await _player.getThumbnail(
                                           //   url: playerid,
@@ -6,6 +6,10 @@
 
 #include "generated_plugin_registrant.h"
 
+#include <ivs_broadcaster/ivs_broadcaster_plugin.h>
 
 void fl_register_plugins(FlPluginRegistry* registry) {
+  g_autoptr(FlPluginRegistrar) ivs_broadcaster_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "IvsBroadcasterPlugin");
+  ivs_broadcaster_plugin_register_with_registrar(ivs_broadcaster_registrar);
 }
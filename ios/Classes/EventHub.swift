@@ -0,0 +1,126 @@
+import Foundation
+import Flutter
+
+/// Coalesces events on their way to a Flutter event channel so the main
+/// thread carries a predictable load however chatty the SDK callbacks are.
+///
+/// * `.state` events are delivered in order on the next main-queue pass.
+/// * `.stats` events keep only the latest pending value per key.
+/// * `.metrics` events are collected per key and delivered as one list
+///   every `metricsInterval`.
+///
+/// Pending work is bounded: past `maxPendingStates` the oldest state event
+/// for the same key (or the oldest overall) is replaced, and each metrics
+/// batch keeps its newest `maxBatch` entries. `post` may be called from any
+/// thread; the sink is only called on the main queue.
+final class EventHub {
+    enum Kind {
+        case state
+        case stats
+        case metrics
+    }
+
+    var sink: FlutterEventSink? {
+        get { lock.lock(); defer { lock.unlock() }; return _sink }
+        set { lock.lock(); _sink = newValue; lock.unlock() }
+    }
+
+    private let metricsInterval: TimeInterval
+    private let maxPendingStates: Int
+    private let maxBatch: Int
+
+    private let lock = NSLock()
+    private var _sink: FlutterEventSink?
+    private var states: [(key: String, event: Any)] = []
+    private var stats: [(key: String, event: Any)] = []
+    private var batches: [(key: String, firstPosted: TimeInterval, events: [Any])] = []
+    private var drainScheduled = false
+    private var flushScheduled = false
+
+    init(metricsInterval: TimeInterval = 0.25, maxPendingStates: Int = 64, maxBatch: Int = 32) {
+        self.metricsInterval = metricsInterval
+        self.maxPendingStates = maxPendingStates
+        self.maxBatch = maxBatch
+    }
+
+    func post(_ key: String, _ kind: Kind, _ event: Any) {
+        lock.lock()
+        var scheduleDrain = false
+        var scheduleFlush = false
+        switch kind {
+        case .state:
+            if states.count >= maxPendingStates {
+                let same = states.firstIndex { $0.key == key } ?? 0
+                states.remove(at: same)
+            }
+            states.append((key, event))
+            scheduleDrain = !drainScheduled
+        case .stats:
+            if let index = stats.firstIndex(where: { $0.key == key }) {
+                stats[index].event = event
+            } else {
+                stats.append((key, event))
+            }
+            scheduleDrain = !drainScheduled
+        case .metrics:
+            if let index = batches.firstIndex(where: { $0.key == key }) {
+                if batches[index].events.count >= maxBatch {
+                    batches[index].events.removeFirst()
+                }
+                batches[index].events.append(event)
+            } else {
+                batches.append((key, ProcessInfo.processInfo.systemUptime, [event]))
+            }
+            scheduleFlush = !flushScheduled
+        }
+        drainScheduled = drainScheduled || scheduleDrain
+        flushScheduled = flushScheduled || scheduleFlush
+        lock.unlock()
+
+        if scheduleDrain {
+            DispatchQueue.main.async { [weak self] in self?.drain() }
+        }
+        if scheduleFlush {
+            DispatchQueue.main.asyncAfter(deadline: .now() + metricsInterval) { [weak self] in
+                self?.flush()
+            }
+        }
+    }
+
+    /// Drops everything pending, e.g. when the listener cancels.
+    func reset() {
+        lock.lock()
+        states.removeAll()
+        stats.removeAll()
+        batches.removeAll()
+        lock.unlock()
+    }
+
+    private func drain() {
+        lock.lock()
+        let ready = states + stats
+        states.removeAll(keepingCapacity: true)
+        stats.removeAll(keepingCapacity: true)
+        drainScheduled = false
+        let sink = _sink
+        lock.unlock()
+        ready.forEach { sink?($0.event) }
+    }
+
+    private func flush() {
+        let now = ProcessInfo.processInfo.systemUptime
+        lock.lock()
+        let due = batches.filter { now - $0.firstPosted >= metricsInterval }
+        batches.removeAll { now - $0.firstPosted >= metricsInterval }
+        let next = batches.map { $0.firstPosted + metricsInterval - now }.min()
+        flushScheduled = next != nil
+        let sink = _sink
+        lock.unlock()
+        due.forEach { sink?($0.events) }
+        if let next = next {
+            DispatchQueue.main.asyncAfter(deadline: .now() + next) { [weak self] in
+                self?.flush()
+            }
+        }
+    }
+}
@@ -17,12 +17,13 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
         withArguments arguments: Any?,
         eventSink events: @escaping FlutterEventSink
     ) -> FlutterError? {
-        _eventSink = events
+        self.events.sink = events
         return nil
     }
 
     func onCancel(withArguments arguments: Any?) -> FlutterError? {
-        _eventSink = nil
+        events.sink = nil
+        events.reset()
         return nil
     }
 
@@ -32,7 +33,7 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
 
     private var _methodChannel: FlutterMethodChannel
     private var _eventChannel: FlutterEventChannel
-    var _eventSink: FlutterEventSink?
+    private let events = EventHub()
     private var previewView: UIView
     private var broadcastSession: IVSBroadcastSession?
 
@@ -244,9 +245,16 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
             result(true)
 
         case METHOD_SEND_TIME_METADATA:
-            let args = call.arguments as! String
-            sendMetaData(metadata: args)
-            result("")
+            var messages: [String] = []
+            if let metadata = call.arguments as? String {
+                messages.append(metadata)
+            } else if let args = call.arguments as? [String: Any] {
+                if let metadata = args["metadata"] as? String {
+                    messages.append(metadata)
+                }
+                messages += args["messages"] as? [String] ?? []
+            }
+            result(messages.filter { sendMetaData(metadata: $0) }.count)
 
         default:
             result(FlutterMethodNotImplemented)
@@ -254,11 +262,14 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
     }
 
     
-    func sendMetaData( metadata:String){
+    @discardableResult
+    func sendMetaData( metadata:String) -> Bool {
         do {
             try self.broadcastSession?.sendTimedMetadata(metadata);
+            return self.broadcastSession != nil
         } catch {
             print("Unable to Send Timed Metadata")
+            return false
         }
     }
 
@@ -311,9 +322,7 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
             "isRecording": true,
             "videoPath": "",
         ]
-        if self._eventSink != nil {
-            self._eventSink!(data)
-        }
+        self.events.post("isRecording", .state, data)
         // Stop recording after the specified duration
         DispatchQueue.main.asyncAfter(deadline: .now() + .seconds(seconds)) {
             [weak self] in
@@ -372,7 +381,7 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
             }
             videoDevice.unlockForConfiguration()
             let data = ["foucsPoint": "\(tapPoint.x)_\(tapPoint.y)"]
-            self._eventSink!(data)
+            self.events.post("foucsPoint", .state, data)
 
         } catch {
             print("Error setting focus point: \(error)")
@@ -507,9 +516,7 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
         self.captureSession?.stopRunning()
         broadcastSession?.stop()
         broadcastSession = nil
-        if self._eventSink != nil {
-            self._eventSink?(["state": "DISCONNECTED"])
-        }
+        self.events.post("state", .state, ["state": "DISCONNECTED"])
         previewView.subviews.forEach { $0.removeFromSuperview() }
 
     }
@@ -852,16 +859,12 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
         print("RetyryState change to \(state)")
         var data = [String: Any]()
         data = ["retrystate": state.rawValue]
-        self._eventSink?(data)
+        self.events.post("retrystate", .state, data)
         
     }
 //258013
     func sendEvent(_ event: Any) {
-        DispatchQueue.main.async {
-            if self._eventSink != nil {
-                self._eventSink!(event)
-            }
-        }
+        self.events.post("state", .state, event)
     }
 
     func broadcastSession(
@@ -879,7 +882,7 @@ class IvsBroadcasterView: NSObject, FlutterPlatformView, FlutterStreamHandler,
         let quality = statiscs.broadcastQuality.rawValue
         let health = statiscs.networkHealth.rawValue
         data = ["quality": quality, "network": health]
-        self._eventSink?(data)
+        self.events.post("transmission", .stats, data)
     }
 }
 
@@ -949,8 +952,6 @@ extension IvsBroadcasterView: AVCaptureFileOutputRecordingDelegate {
             "isRecording": false,
             "videoPath": outputFileURL.path,
         ]
-        if self._eventSink != nil {
-            self._eventSink!(data)
-        }
+        self.events.post("isRecording", .state, data)
     }
 }
@@ -8,7 +8,9 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
     private var playerView: UIView
     private var _methodChannel: FlutterMethodChannel?
     private var _eventChannel: FlutterEventChannel?
-    private var _eventSink: FlutterEventSink?
+    private let events = EventHub()
+    private let ticker = PlaybackTicker()
+    private let thumbnails = ThumbnailEngine()
     private var players: [String: IVSPlayer] = [:] // Dictionary to manage multiple players
     private var playerViews: [String: IVSPlayerView] = [:]
     private var playerId: String?
@@ -18,31 +20,19 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
     }
     
     func player(_ player: IVSPlayer, didChangeState state: IVSPlayer.State) {
-        guard let eventSink = _eventSink else { return }
-        let dict: [String: Any] = ["state": state.rawValue]
-        print(dict)
-        eventSink(dict)
+        events.post("state", .state, ["state": state.rawValue])
     }
 
     func player(_ player: IVSPlayer, didChangeDuration time: CMTime) {
-        guard let eventSink = _eventSink else { return }
-        let dict: [String: Any] = ["duration": time.seconds]
-        print(dict)
-        eventSink(dict)
+        events.post("duration", .state, ["duration": time.seconds])
     }
 
     func player(_ player: IVSPlayer, didChangeSyncTime time: CMTime) {
-        guard let eventSink = _eventSink else { return }
-        let dict: [String: Any] = ["syncTime": time.seconds]
-        print(dict)
-        eventSink(dict)
+        events.post("syncTime", .stats, ["syncTime": time.seconds])
     }
 
     func player(_ player: IVSPlayer, didChangeQuality quality: IVSQuality?) {
-        guard let eventSink = _eventSink else { return }
-        let dict: [String: Any] = ["quality": quality?.name ?? ""]
-        print(dict)
-        eventSink(dict)
+        events.post("quality", .state, ["quality": quality?.name ?? ""])
     }
     
     func player(_ player: IVSPlayer, didOutputCue cue: IVSCue) {
@@ -52,31 +42,26 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
                 "startTime": textMetadataCue.startTime.epoch,
                 "endTime": textMetadataCue.endTime.epoch,
             ]
-            _eventSink?(dict)
+            events.post("metadata", .metrics, dict)
         }
     }
 
     func player(_ player: IVSPlayer, didFailWithError error: any Error) {
-        guard let eventSink = _eventSink else { return }
-        let dict: [String: Any] = ["error": error.localizedDescription]
-        print(dict)
-        eventSink(dict)
+        events.post("error", .state, ["error": error.localizedDescription])
     }
 
     func player(_ player: IVSPlayer, didSeekTo time: CMTime) {
-        guard let eventSink = _eventSink else { return }
-        let dict: [String: Any] = ["seekedToTime": time.seconds]
-        print(dict)
-        eventSink(dict)
+        events.post("seekedToTime", .state, ["seekedToTime": time.seconds])
     }
     
     func onListen(withArguments arguments: Any?, eventSink events: @escaping FlutterEventSink) -> FlutterError? {
-        self._eventSink = events;
+        self.events.sink = events
         return nil
     }
     
     func onCancel(withArguments arguments: Any?) -> FlutterError? {
-        self._eventSink = nil
+        events.sink = nil
+        events.reset()
         return nil
     }
     
@@ -91,12 +76,13 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
         _eventChannel = FlutterEventChannel(name: "ivs_player_event", binaryMessenger: messenger)
         playerView = UIView(frame: frame)
         super.init();
+        ticker.onTick = { [weak self] in self?.postPlayback() }
         _methodChannel?.setMethodCallHandler(onMethodCall)
         _eventChannel?.setStreamHandler(self)
     }
     
     
-    func onMethodCall(call: FlutterMethodCall, result: FlutterResult) {
+    func onMethodCall(call: FlutterMethodCall, result: @escaping FlutterResult) {
         print(call.method)
         switch(call.method) {
         case "createPlayer":
@@ -108,6 +94,7 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
             let args = call.arguments as? [String: Any]
             let urls = args?["urls"] as? [String]
             multiPlayer(urls!)
+            ticker.start(rate: args?["positionUpdateRate"] as? Int ?? 10)
             result("Players created successfully")
         case "selectPlayer":
             let args = call.arguments as? [String: Any]
@@ -119,12 +106,14 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
             let url = args?["url"] as? String
             let autoPlay = args?["autoPlay"] as? Bool
             startPlayer(  url: url!, autoPlay: autoPlay!)
+            ticker.start(rate: args?["positionUpdateRate"] as? Int ?? 10)
             result(true)
         case "stopPlayer":
             let playerId = self.playerId
             if (playerId != nil){
                 stopPlayer(playerId: playerId!)
             }
+            ticker.stop()
             result(true)
         case "mute":
             let playerId = self.playerId
@@ -170,9 +159,7 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
             
             result(isAuto(playerId: playerId!))
         case "getScreenshot":
-            let args = call.arguments as? [String: Any]
-            let url = args?["url"] as? String
-            result(getScreenShot(url: url!))
+            getScreenShot(args: call.arguments as? [String: Any], result: result)
         default:
             result(FlutterMethodNotImplemented)
         }
@@ -181,32 +168,27 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
     
     
     
-    func getScreenShot(url: String) -> [UInt8]? {
-        guard let videoURL = URL(string: url) else {
-            print("Invalid URL")
-            return nil
+    func getScreenShot(args: [String: Any]?, result: @escaping FlutterResult) {
+        guard let url = (args?["url"] as? String).flatMap(URL.init(string:)) else {
+            result(FlutterError(code: "INVALID_ARGUMENTS", message: "A valid url is required", details: nil))
+            return
         }
-        
-        // Create an AVAsset and AVAssetImageGenerator
-        let asset = AVAsset(url: URL(string: "https://commondatastorage.googleapis.com/gtv-videos-bucket/sample/BigBuckBunny.mp4")!)
-        let imageGenerator = AVAssetImageGenerator(asset: asset)
-        imageGenerator.appliesPreferredTrackTransform = true // Adjust for orientation
-        
-        // Define the time for the screenshot (e.g., at the 1-second mark)
-        let time = CMTime(seconds: 1.0, preferredTimescale: 600)
-        
-        do {
-            // Generate the CGImage
-            let cgImage = try imageGenerator.copyCGImage(at: time, actualTime: nil)
-            // Convert to UIImage
-            let image =  UIImage(cgImage: cgImage)
-            guard let imageData = image.pngData() else { return nil }
-            return [UInt8](imageData)
-        } catch {
-            print("Failed to generate screenshot: \(error.localizedDescription)")
-            return nil
+        let request = ThumbnailRequest(
+            url: url,
+            time: args?["time"] as? Double ?? 0,
+            width: args?["width"] as? Int ?? 320,
+            height: args?["height"] as? Int ?? 180,
+            format: ThumbnailFormat(rawValue: args?["format"] as? String ?? "") ?? .jpeg,
+            quality: Double(args?["quality"] as? Int ?? 80) / 100
+        )
+        thumbnails.request(request) { outcome in
+            switch outcome {
+            case .success(let data):
+                result(FlutterStandardTypedData(bytes: data))
+            case .failure(let error):
+                result(FlutterError(code: "THUMBNAIL_FAILED", message: error.localizedDescription, details: nil))
+            }
         }
-        
     }
     
     func multiPlayer(_ urls:[String]) {
@@ -262,10 +244,22 @@ class IvsPlayerView: NSObject, FlutterPlatformView, FlutterStreamHandler , IVSPl
         guard let player = players[self.playerId!] else { return }
         player.delegate = self 
         let dict: [String: Any] = ["state": player.state.rawValue, "duration": player.duration.seconds, "syncTime": player.syncTime.seconds, "quality": player.quality?.name ?? ""]
-        print(dict)
-        _eventSink?(dict)
+        events.post("snapshot", .state, dict)
     }
     
+    /// Pushes position, buffered position and live latency of the selected
+    /// player. Skipped while the view is off screen.
+    func postPlayback() {
+        guard playerView.window != nil, let playerId = self.playerId,
+              let player = players[playerId] else { return }
+        let dict: [String: Any] = [
+            "position": player.position.seconds,
+            "bufferedPosition": player.buffered.seconds,
+            "liveLatency": player.liveLatency.seconds,
+        ]
+        events.post("playback", .stats, dict)
+    }
+
     func stopPlayer(playerId: String) {
         guard let player = players[playerId] else { return }
         player.pause()
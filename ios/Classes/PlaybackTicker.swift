@@ -0,0 +1,66 @@
+import UIKit
+
+/// Calls `onTick` at up to `rate` times a second, aligned to display
+/// refreshes, while the ticker is running and the app is active.
+///
+/// Used to push playback position to Dart instead of having Dart poll it
+/// over the method channel. A rate of 0 keeps the ticker stopped.
+final class PlaybackTicker {
+    var onTick: (() -> Void)?
+
+    private var displayLink: CADisplayLink?
+    private var rate: Int = 0
+    private var running = false
+    private var observers: [NSObjectProtocol] = []
+
+    init() {
+        let center = NotificationCenter.default
+        observers.append(center.addObserver(
+            forName: UIApplication.didEnterBackgroundNotification, object: nil, queue: .main
+        ) { [weak self] _ in self?.displayLink?.isPaused = true })
+        observers.append(center.addObserver(
+            forName: UIApplication.willEnterForegroundNotification, object: nil, queue: .main
+        ) { [weak self] _ in self?.displayLink?.isPaused = false })
+    }
+
+    deinit {
+        observers.forEach { NotificationCenter.default.removeObserver($0) }
+        displayLink?.invalidate()
+    }
+
+    /// Starts ticking at `rate` Hz, or stops when `rate` is 0.
+    func start(rate: Int) {
+        self.rate = max(0, rate)
+        running = self.rate > 0
+        displayLink?.invalidate()
+        displayLink = nil
+        guard running else { return }
+        // CADisplayLink retains its target; the proxy keeps that from
+        // retaining the ticker.
+        let link = CADisplayLink(target: WeakTarget(self), selector: #selector(WeakTarget.tick))
+        link.preferredFramesPerSecond = self.rate
+        link.isPaused = UIApplication.shared.applicationState == .background
+        link.add(to: .main, forMode: .common)
+        displayLink = link
+    }
+
+    func stop() {
+        start(rate: 0)
+    }
+
+    fileprivate func tick() {
+        onTick?()
+    }
+
+    private final class WeakTarget: NSObject {
+        weak var ticker: PlaybackTicker?
+
+        init(_ ticker: PlaybackTicker) {
+            self.ticker = ticker
+        }
+
+        @objc func tick() {
+            ticker?.tick()
+        }
+    }
+}
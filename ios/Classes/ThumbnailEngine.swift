@@ -0,0 +1,138 @@
+import AVFoundation
+import UIKit
+
+enum ThumbnailFormat: String {
+    case jpeg
+    case webp
+}
+
+struct ThumbnailRequest {
+    let url: URL
+    let time: Double
+    let width: Int
+    let height: Int
+    let format: ThumbnailFormat
+    let quality: Double
+}
+
+/// Produces thumbnails off the main thread.
+///
+/// A small operation queue decodes the keyframe nearest the requested time
+/// with `AVAssetImageGenerator`, which also scales it down to the requested
+/// box, and encodes it. Results are kept in a byte-bounded LRU cache keyed by
+/// (url, time bucket, size, format); identical requests in flight share one
+/// decode. iOS has no system WebP encoder, so WebP requests produce JPEG.
+final class ThumbnailEngine {
+    typealias Completion = (Result<Data, Error>) -> Void
+
+    private struct Key: Hashable {
+        let url: URL
+        let bucket: Int
+        let width: Int
+        let height: Int
+        let format: ThumbnailFormat
+    }
+
+    private struct Entry {
+        let data: Data
+        var lastUse: UInt64
+    }
+
+    private let queue: OperationQueue = {
+        let queue = OperationQueue()
+        queue.name = "ivs.thumbnails"
+        queue.maxConcurrentOperationCount = 2
+        queue.qualityOfService = .userInitiated
+        return queue
+    }()
+    private let bucketSeconds: Double
+    private let maxBytes: Int
+
+    // Guards everything below.
+    private let lock = NSLock()
+    private var cache: [Key: Entry] = [:]
+    private var cacheBytes = 0
+    private var useCounter: UInt64 = 0
+    private var waiting: [Key: [Completion]] = [:]
+
+    init(bucketSeconds: Double = 2, maxBytes: Int = 16 * 1024 * 1024) {
+        self.bucketSeconds = bucketSeconds
+        self.maxBytes = maxBytes
+    }
+
+    deinit {
+        queue.cancelAllOperations()
+    }
+
+    /// Calls `completion` on the main queue.
+    func request(_ request: ThumbnailRequest, completion: @escaping Completion) {
+        let key = Key(
+            url: request.url,
+            bucket: Int(max(0, request.time) / bucketSeconds),
+            width: request.width,
+            height: request.height,
+            format: request.format
+        )
+        lock.lock()
+        if var entry = cache[key] {
+            useCounter += 1
+            entry.lastUse = useCounter
+            cache[key] = entry
+            lock.unlock()
+            DispatchQueue.main.async { completion(.success(entry.data)) }
+            return
+        }
+        let first = waiting[key] == nil
+        waiting[key, default: []].append(completion)
+        lock.unlock()
+        guard first else { return }
+
+        queue.addOperation { [weak self] in
+            guard let self = self else { return }
+            let result = Result { try self.produce(request) }
+            self.lock.lock()
+            if case .success(let data) = result {
+                self.store(data, for: key)
+            }
+            let completions = self.waiting.removeValue(forKey: key) ?? []
+            self.lock.unlock()
+            DispatchQueue.main.async {
+                completions.forEach { $0(result) }
+            }
+        }
+    }
+
+    private func produce(_ request: ThumbnailRequest) throws -> Data {
+        let generator = AVAssetImageGenerator(asset: AVAsset(url: request.url))
+        generator.appliesPreferredTrackTransform = true
+        // Any tolerance lets the generator stop at the nearest keyframe
+        // instead of decoding forward to the exact time.
+        generator.requestedTimeToleranceBefore = .positiveInfinity
+        generator.requestedTimeToleranceAfter = .positiveInfinity
+        generator.maximumSize = CGSize(width: request.width, height: request.height)
+        let time = CMTime(seconds: max(0, request.time), preferredTimescale: 600)
+        let image = try generator.copyCGImage(at: time, actualTime: nil)
+        guard let data = UIImage(cgImage: image)
+            .jpegData(compressionQuality: CGFloat(request.quality)) else {
+            throw NSError(domain: "ivs_player", code: 1, userInfo: [
+                NSLocalizedDescriptionKey: "Failed to encode thumbnail",
+            ])
+        }
+        return data
+    }
+
+    // Called with `lock` held.
+    private func store(_ data: Data, for key: Key) {
+        guard data.count <= maxBytes else { return }
+        useCounter += 1
+        if let old = cache.updateValue(Entry(data: data, lastUse: useCounter), forKey: key) {
+            cacheBytes -= old.data.count
+        }
+        cacheBytes += data.count
+        while cacheBytes > maxBytes,
+              let oldest = cache.min(by: { $0.value.lastUse < $1.value.lastUse }) {
+            cacheBytes -= oldest.value.data.count
+            cache.removeValue(forKey: oldest.key)
+        }
+    }
+}
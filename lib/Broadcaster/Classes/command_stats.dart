@@ -0,0 +1,27 @@
+/// How long native commands of one method waited in the executor's queue
+/// and how long they ran, in milliseconds.
+class CommandStats {
+  final int count;
+  final double meanWaitMs;
+  final double maxWaitMs;
+  final double meanRunMs;
+  final double maxRunMs;
+
+  CommandStats({
+    required this.count,
+    required this.meanWaitMs,
+    required this.maxWaitMs,
+    required this.meanRunMs,
+    required this.maxRunMs,
+  });
+
+  factory CommandStats.fromMap(Map<String, dynamic> map) {
+    return CommandStats(
+      count: map['count'],
+      meanWaitMs: (map['meanWaitMs'] as num).toDouble(),
+      maxWaitMs: (map['maxWaitMs'] as num).toDouble(),
+      meanRunMs: (map['meanRunMs'] as num).toDouble(),
+      maxRunMs: (map['maxRunMs'] as num).toDouble(),
+    );
+  }
+}
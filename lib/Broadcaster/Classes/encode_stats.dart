@@ -0,0 +1,40 @@
+import 'package:ivs_broadcaster/Broadcaster/Classes/telemetry_record.dart';
+
+class EncodeStats {
+  /// Frames encoded in the last second.
+  final int encodedFrames;
+
+  /// Unchanged frames that were not re-encoded in the last second.
+  final int skippedFrames;
+
+  /// Time spent comparing frames to detect unchanged ones.
+  final double compareTimeMs;
+
+  /// Estimated encoder time saved by skipping unchanged frames.
+  final double encodeTimeSavedMs;
+
+  EncodeStats({
+    required this.encodedFrames,
+    required this.skippedFrames,
+    required this.compareTimeMs,
+    required this.encodeTimeSavedMs,
+  });
+
+  factory EncodeStats.fromMap(Map<dynamic, dynamic> map) {
+    return EncodeStats(
+      encodedFrames: map['encodedFrames'] ?? 0,
+      skippedFrames: map['skippedFrames'] ?? 0,
+      compareTimeMs: (map['compareTimeMs'] as num?)?.toDouble() ?? 0,
+      encodeTimeSavedMs: (map['encodeTimeSavedMs'] as num?)?.toDouble() ?? 0,
+    );
+  }
+
+  factory EncodeStats.fromTelemetry(TelemetryRecord record) {
+    return EncodeStats(
+      encodedFrames: record.framesEncoded,
+      skippedFrames: record.framesSkipped,
+      compareTimeMs: record.compareTimeUs / 1000,
+      encodeTimeSavedMs: record.encodeTimeSavedUs / 1000,
+    );
+  }
+}
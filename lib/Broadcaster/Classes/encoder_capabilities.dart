@@ -0,0 +1,47 @@
+class EncoderBenchmark {
+  final String backend;
+  final String quality;
+  final double fps;
+  final bool realtime;
+
+  EncoderBenchmark({
+    required this.backend,
+    required this.quality,
+    required this.fps,
+    required this.realtime,
+  });
+
+  factory EncoderBenchmark.fromMap(Map<String, dynamic> map) {
+    return EncoderBenchmark(
+      backend: map['backend'],
+      quality: map['quality'],
+      fps: (map['fps'] as num).toDouble(),
+      realtime: map['realtime'],
+    );
+  }
+}
+
+class EncoderCapabilities {
+  /// Highest quality this device encodes in real time, empty if none does.
+  final String recommendedQuality;
+
+  /// Encoder backend used for [recommendedQuality].
+  final String backend;
+  final List<EncoderBenchmark> benchmarks;
+
+  EncoderCapabilities({
+    required this.recommendedQuality,
+    required this.backend,
+    required this.benchmarks,
+  });
+
+  factory EncoderCapabilities.fromMap(Map<String, dynamic> map) {
+    return EncoderCapabilities(
+      recommendedQuality: map['recommendedQuality'],
+      backend: map['backend'],
+      benchmarks: (map['benchmarks'] as List)
+          .map((e) => EncoderBenchmark.fromMap(Map<String, dynamic>.from(e)))
+          .toList(),
+    );
+  }
+}
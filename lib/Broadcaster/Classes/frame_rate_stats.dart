@@ -0,0 +1,38 @@
+import 'package:ivs_broadcaster/Broadcaster/Classes/telemetry_record.dart';
+
+class FrameRateStats {
+  /// Frame rate the encoder is currently fed at.
+  final int frameRate;
+
+  /// Frames dropped by the frame governor since the preview started.
+  final int droppedFrames;
+
+  /// Deepest capture queue seen in the last measurement window.
+  final int queueDepth;
+  final double encodeLatencyMs;
+
+  FrameRateStats({
+    required this.frameRate,
+    required this.droppedFrames,
+    required this.queueDepth,
+    required this.encodeLatencyMs,
+  });
+
+  factory FrameRateStats.fromMap(Map<dynamic, dynamic> map) {
+    return FrameRateStats(
+      frameRate: map['frameRate'],
+      droppedFrames: map['droppedFrames'] ?? 0,
+      queueDepth: map['queueDepth'] ?? 0,
+      encodeLatencyMs: (map['encodeLatencyMs'] as num?)?.toDouble() ?? 0,
+    );
+  }
+
+  factory FrameRateStats.fromTelemetry(TelemetryRecord record) {
+    return FrameRateStats(
+      frameRate: record.targetFps,
+      droppedFrames: record.framesDropped,
+      queueDepth: record.maxQueueDepth,
+      encodeLatencyMs: record.encodeLatencyUs / 1000,
+    );
+  }
+}
@@ -0,0 +1,161 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/telemetry_record.dart';
+
+typedef _SlotCountNative = Int32 Function();
+typedef _SlotCount = int Function();
+typedef _ReadNative = Int32 Function(Int32 slot, Pointer<Uint8> out, Int32 size);
+typedef _Read = int Function(int slot, Pointer<Uint8> out, int size);
+
+/// One slot of the native telemetry block.
+///
+/// Mirrors the slot layout in `linux/telemetry_block.h`; all fields are
+/// little-endian.
+class TelemetrySnapshot {
+  static const int sourceBroadcastSession = 1;
+  static const int sourcePlayer = 2;
+
+  /// Indices into [counters].
+  static const int framesCaptured = 0;
+  static const int framesDropped = 1;
+  static const int framesEncoded = 2;
+  static const int framesSkipped = 3;
+  static const int stateChanges = 4;
+  static const int errors = 5;
+
+  /// Indices into [gauges].
+  static const int state = 0;
+  static const int targetFps = 1;
+  static const int queueDepth = 2;
+  static const int encodeLatencyMs = 3;
+
+  /// Indices into [counters] of a [sourcePlayer] slot, which mirrors the
+  /// selected player and starts over when another is selected. State
+  /// changes and errors keep the indices above.
+  static const int packets = 0;
+  static const int framesDecoded = 1;
+  static const int framesShown = 2;
+  static const int packetsSkipped = 3;
+  static const int switches = 6;
+  static const int seeks = 7;
+
+  /// Indices into [gauges] of a [sourcePlayer] slot. The state keeps its
+  /// index above.
+  static const int playbackRate = 1;
+  static const int positionMs = 2;
+  static const int bufferedMs = 3;
+  static const int liveLatencyMs = 4;
+  static const int durationMs = 5;
+  static const int decodeMs = 6;
+  static const int switchLatencyMs = 7;
+
+  final int source;
+  final String name;
+
+  /// Monotonic clock time of the last update, in microseconds.
+  final int updatedUs;
+
+  /// Totals since the slot was claimed.
+  final List<int> counters;
+
+  /// Current values.
+  final List<double> gauges;
+
+  /// The latest statistics record, or null before the first one.
+  final TelemetryRecord? stats;
+
+  TelemetrySnapshot._(
+    this.source,
+    this.name,
+    this.updatedUs,
+    this.counters,
+    this.gauges,
+    this.stats,
+  );
+
+  static TelemetrySnapshot? _parse(Uint8List bytes) {
+    final data = ByteData.sublistView(bytes);
+    final source = data.getUint16(8, Endian.little);
+    if (source == 0) return null;
+    final nameBytes = bytes.sublist(16, 48);
+    final end = nameBytes.indexOf(0);
+    return TelemetrySnapshot._(
+      source,
+      String.fromCharCodes(end < 0 ? nameBytes : nameBytes.sublist(0, end)),
+      data.getInt64(240, Endian.little),
+      List.generate(8, (i) => data.getUint64(48 + 8 * i, Endian.little)),
+      List.generate(8, (i) => data.getFloat64(112 + 8 * i, Endian.little)),
+      TelemetryRecord.tryParse(bytes.sublist(176, 176 + TelemetryRecord.size)),
+    );
+  }
+}
+
+/// Synchronous access to the telemetry the Linux plugin keeps in shared
+/// memory, through `dart:ffi` rather than the method and event channels.
+///
+/// Reads are cheap enough to do every frame, e.g. from an overlay's build
+/// method, and never wait for the native side.
+class TelemetryBlock {
+  TelemetryBlock._(this._slotCount, this._read, this._slotSize)
+      : _buffer = malloc<Uint8>(_slotSize);
+
+  static TelemetryBlock? _instance;
+
+  /// Opens the block, or returns null on platforms without it.
+  static TelemetryBlock? open() {
+    if (_instance != null) return _instance;
+    if (!Platform.isLinux) return null;
+    try {
+      final library = DynamicLibrary.open('libivs_broadcaster_plugin.so');
+      final slotCount = library
+          .lookupFunction<_SlotCountNative, _SlotCount>(
+              'ivs_telemetry_slot_count')
+          .call();
+      final slotSize = library
+          .lookupFunction<_SlotCountNative, _SlotCount>(
+              'ivs_telemetry_slot_size')
+          .call();
+      if (slotCount == 0) return null;
+      final read =
+          library.lookupFunction<_ReadNative, _Read>('ivs_telemetry_read');
+      return _instance = TelemetryBlock._(slotCount, read, slotSize);
+    } catch (e) {
+      return null;
+    }
+  }
+
+  final int _slotCount;
+  final _Read _read;
+  final int _slotSize;
+
+  // Reused for every read; the block lives as long as the process.
+  final Pointer<Uint8> _buffer;
+
+  /// Reads [slot], or returns null if it is empty or was busy.
+  TelemetrySnapshot? read(int slot) {
+    if (_read(slot, _buffer, _slotSize) == 0) return null;
+    return TelemetrySnapshot._parse(_buffer.asTypedList(_slotSize));
+  }
+
+  /// Reads the slot published under [name], e.g. `broadcaster`.
+  TelemetrySnapshot? find(String name) {
+    for (var slot = 0; slot < _slotCount; ++slot) {
+      final snapshot = read(slot);
+      if (snapshot?.name == name) return snapshot;
+    }
+    return null;
+  }
+
+  /// Reads every slot in use.
+  List<TelemetrySnapshot> readAll() {
+    final snapshots = <TelemetrySnapshot>[];
+    for (var slot = 0; slot < _slotCount; ++slot) {
+      final snapshot = read(slot);
+      if (snapshot != null) snapshots.add(snapshot);
+    }
+    return snapshots;
+  }
+}
@@ -0,0 +1,50 @@
+import 'dart:typed_data';
+
+/// Fixed-layout binary statistics record sent by the Linux broadcaster.
+///
+/// Mirrors `linux/telemetry_record.h`; all fields are little-endian.
+class TelemetryRecord {
+  static const int version = 1;
+  static const int size = 64;
+
+  /// [changed] bit: frame governor fields were updated.
+  static const int frameRateChanged = 1 << 0;
+
+  /// [changed] bit: per-second encoder fields were updated.
+  static const int encodeChanged = 1 << 1;
+
+  final int changed;
+  final int timestampUs;
+  final int targetFps;
+  final int framesDropped;
+  final int maxQueueDepth;
+  final int encodeLatencyUs;
+  final int framesEncoded;
+  final int framesSkipped;
+  final int compareTimeUs;
+  final int encodeTimeSavedUs;
+  final int captureLatencyUs;
+  final int muxLatencyUs;
+
+  TelemetryRecord._(ByteData data)
+      : changed = data.getUint16(2, Endian.little),
+        targetFps = data.getUint32(4, Endian.little),
+        timestampUs = data.getInt64(8, Endian.little),
+        framesDropped = data.getUint64(16, Endian.little),
+        maxQueueDepth = data.getUint32(24, Endian.little),
+        encodeLatencyUs = data.getUint32(28, Endian.little),
+        framesEncoded = data.getUint64(32, Endian.little),
+        framesSkipped = data.getUint64(40, Endian.little),
+        compareTimeUs = data.getUint32(48, Endian.little),
+        encodeTimeSavedUs = data.getUint32(52, Endian.little),
+        captureLatencyUs = data.getUint32(56, Endian.little),
+        muxLatencyUs = data.getUint32(60, Endian.little);
+
+  /// Returns null when [bytes] is not a record this version understands.
+  static TelemetryRecord? tryParse(Uint8List bytes) {
+    if (bytes.length < size) return null;
+    final data = ByteData.sublistView(bytes);
+    if (data.getUint16(0, Endian.little) != version) return null;
+    return TelemetryRecord._(data);
+  }
+}
@@ -0,0 +1,36 @@
+import 'dart:convert';
+import 'dart:io';
+
+/// Unpacks timed-metadata payloads sent by the Linux broadcaster.
+///
+/// Mirrors the wire format in `linux/metadata_codec.h`: a payload is a
+/// single message, a batch of messages each preceded by `\x1e`, or `\x1f`
+/// followed by the base64 of either, raw-deflated with a preset dictionary.
+class TimedMetadata {
+  static const String batchMarker = '\x1e';
+  static const String compressedMarker = '\x1f';
+
+  /// Splits [payload] into the messages it carries.
+  ///
+  /// [dictionary] must be the one `configureTimedMetadata` returned for
+  /// compressed payloads. Throws a [FormatException] when a compressed
+  /// payload cannot be decoded.
+  static List<String> decode(String payload, {String? dictionary}) {
+    var framed = payload;
+    if (payload.startsWith(compressedMarker)) {
+      final decoder = ZLibDecoder(
+        raw: true,
+        dictionary: dictionary == null ? null : utf8.encode(dictionary),
+      );
+      try {
+        framed = utf8.decode(
+          decoder.convert(base64.decode(payload.substring(1))),
+        );
+      } on Exception catch (e) {
+        throw FormatException("Undecodable timed metadata: $e");
+      }
+    }
+    if (!framed.startsWith(batchMarker)) return [framed];
+    return framed.substring(1).split(batchMarker);
+  }
+}
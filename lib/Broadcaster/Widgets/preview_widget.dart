@@ -2,10 +2,12 @@ import 'dart:io';
 
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
+import 'package:ivs_broadcaster/Broadcaster/ivs_broadcaster_platform_interface.dart';
 
 /// A stateful widget that provides a preview of the broadcaster view.
 ///
-/// This widget renders a platform-specific view for the IVS broadcaster on Android and iOS.
+/// This widget renders a platform-specific view for the IVS broadcaster on Android and iOS,
+/// and a [Texture] fed by the native capture pipeline on Linux.
 /// It uses `AutomaticKeepAliveClientMixin` to ensure that the platform view is kept alive
 /// and not destroyed when the widget is offscreen or when the widget tree rebuilds.
 class BroadcaterPreview extends StatefulWidget {
@@ -44,6 +46,16 @@ class _BroadcaterPreviewState extends State<BroadcaterPreview>
         viewType: 'ivs_broadcaster',
         creationParamsCodec: StandardMessageCodec(),
       );
+    } else if (Platform.isLinux) {
+      // Frames are converted natively and pulled by the raster thread.
+      _platformView = FutureBuilder<int?>(
+        future: IvsBroadcasterPlatform.instance.getPreviewTextureId(),
+        builder: (context, snapshot) {
+          final textureId = snapshot.data;
+          if (textureId == null) return const SizedBox.shrink();
+          return Texture(textureId: textureId);
+        },
+      );
     } else {
       // Display an error message if the platform is not supported.
       _platformView = const Center(
@@ -1,8 +1,16 @@
 // ignore_for_file: constant_identifier_names
 
 import 'dart:async';
+import 'dart:typed_data';
 
 import 'package:flutter/services.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/command_stats.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/encode_stats.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/encoder_capabilities.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/frame_rate_stats.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/telemetry_block.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/telemetry_record.dart';
+import 'package:ivs_broadcaster/Broadcaster/Classes/timed_metadata.dart';
 import 'package:ivs_broadcaster/Broadcaster/Classes/video_capturing_model.dart';
 import 'package:ivs_broadcaster/Broadcaster/Classes/zoom_factor.dart';
 import 'package:ivs_broadcaster/Broadcaster/ivs_broadcaster_platform_interface.dart';
@@ -40,6 +48,14 @@ class IvsBroadcaster {
   StreamController<BroadcastHealth> broadcastHealth =
       StreamController<BroadcastHealth>.broadcast();
 
+  /// A stream controller to handle frame rate changes made under encoder load (Linux).
+  StreamController<FrameRateStats> frameRateStats =
+      StreamController<FrameRateStats>.broadcast();
+
+  /// A stream controller to handle per-second encoder statistics while broadcasting (Linux).
+  StreamController<EncodeStats> encodeStats =
+      StreamController<EncodeStats>.broadcast();
+
   /// Focus Point Stream Controller
   StreamController<Offset> focusPoint = StreamController<Offset>.broadcast();
 
@@ -69,11 +85,35 @@ class IvsBroadcaster {
     }
   }
 
+  /// Routes a binary statistics record to the stream controllers it updates.
+  void _parseTelemetry(Uint8List data) {
+    final record = TelemetryRecord.tryParse(data);
+    if (record == null) return;
+    if ((record.changed & TelemetryRecord.frameRateChanged) != 0) {
+      frameRateStats.add(FrameRateStats.fromTelemetry(record));
+    }
+    if ((record.changed & TelemetryRecord.encodeChanged) != 0) {
+      encodeStats.add(EncodeStats.fromTelemetry(record));
+    }
+  }
+
   /// Parses the raw data received from the platform-specific implementation
   /// and adds it to the appropriate stream controller.
   ///
-  /// * [data]: A dynamic object that could be a Map containing state, quality, and network information.
+  /// * [data]: A dynamic object that could be a Map containing state, quality, and network information,
+  ///   or a binary [TelemetryRecord] (Linux).
   void _parseRawData(dynamic data) {
+    if (data is Uint8List) {
+      _parseTelemetry(data);
+      return;
+    }
+    // Batched events arrive as a list.
+    if (data is List) {
+      for (final event in data) {
+        _parseRawData(event);
+      }
+      return;
+    }
     if (data is Map) {
       if (data.containsKey("state")) {
         broadcastState.add(_parseBroadCastState(data["state"]));
@@ -140,6 +180,8 @@ class IvsBroadcaster {
   /// * [streamKey]: The stream key for the broadcast.
   /// * [quality]: The desired broadcast quality, default is [IvsQuality.q720].
   /// * [cameraType]: The camera to use for the preview, default is [CameraType.BACK].
+  /// * [enforceEncoderLimit]: On Linux, lowers [quality] to the highest quality the device encodes in real time.
+  /// * [minRefreshRate]: On Linux, frames per second still encoded when the picture does not change; 0 encodes every frame.
   ///
   /// Returns a [Future] that completes when the preview has started.
   Future<void> startPreview({
@@ -148,6 +190,8 @@ class IvsBroadcaster {
     IvsQuality quality = IvsQuality.q720,
     CameraType cameraType = CameraType.BACK,
     bool autoReconnect = false,
+    bool enforceEncoderLimit = true,
+    double minRefreshRate = 1.0,
   }) async {
     return await broadcater.startPreview(
       imgset: imgset,
@@ -155,6 +199,8 @@ class IvsBroadcaster {
       cameraType: cameraType,
       quality: quality,
       autoReconnect: autoReconnect,
+      enforceEncoderLimit: enforceEncoderLimit,
+      minRefreshRate: minRefreshRate,
       onData: (data) {
         _parseRawData(data);
       },
@@ -245,6 +291,65 @@ class IvsBroadcaster {
     return await broadcater.captureVideo(seconds);
   }
 
+  /// Gets the encoder benchmark results and the highest quality the device
+  /// encodes in real time.
+  ///
+  /// The first call on a device may take a few seconds while the encoders are
+  /// benchmarked; results are cached afterwards.
+  Future<EncoderCapabilities> getEncoderCapabilities() async {
+    return await broadcater.getEncoderCapabilities();
+  }
+
+  /// Per-method queue-wait and run times of native commands (Linux).
+  Future<Map<String, CommandStats>> getCommandStats() {
+    return broadcater.getCommandStats();
+  }
+
+  /// Sends [metadata] as timed metadata with the stream.
+  Future<bool> sendTimedMetadata(String metadata) async {
+    return await broadcater.sendTimedMetadata([metadata]) > 0;
+  }
+
+  /// Sends several timed metadata messages at once and returns how many
+  /// were accepted. On Linux they may share one payload; see
+  /// [TimedMetadata.decode].
+  Future<int> sendTimedMetadataBatch(List<String> messages) {
+    return broadcater.sendTimedMetadata(messages);
+  }
+
+  /// Tunes batching, rate limiting and compression of timed metadata
+  /// (Linux).
+  ///
+  /// Returns the dictionary viewers pass to [TimedMetadata.decode]: a
+  /// built-in one trained on typical quiz, poll and score messages unless
+  /// [dictionary] is given, or null when [compress] is off.
+  Future<String?> configureTimedMetadata({
+    Duration window = const Duration(milliseconds: 100),
+    int bytesPerSecond = 2048,
+    int burstBytes = 4096,
+    int maxPayloadBytes = 1024,
+    bool compress = false,
+    String? dictionary,
+  }) {
+    return broadcater.configureTimedMetadata(
+      window: window,
+      bytesPerSecond: bytesPerSecond,
+      burstBytes: burstBytes,
+      maxPayloadBytes: maxPayloadBytes,
+      compress: compress,
+      dictionary: dictionary,
+    );
+  }
+
+  /// Reads the broadcaster's telemetry straight from native memory (Linux).
+  ///
+  /// Synchronous and free of channel traffic, so dashboards can call it
+  /// every frame. Returns null on other platforms or before the session
+  /// publishes anything.
+  TelemetrySnapshot? readTelemetry() {
+    return TelemetryBlock.open()?.find('broadcaster');
+  }
+
   /// A stream controller to handle video capturing events.
   StreamController<VideoCapturingModel> onVideoCapturingStream =
       StreamController<VideoCapturingModel>.broadcast();
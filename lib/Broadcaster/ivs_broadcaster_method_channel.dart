@@ -6,6 +6,8 @@ import 'package:flutter/services.dart';
 import 'package:ivs_broadcaster/helpers/enums.dart';
 import 'package:permission_handler/permission_handler.dart';
 
+import 'Classes/command_stats.dart';
+import 'Classes/encoder_capabilities.dart';
 import 'Classes/zoom_factor.dart';
 import 'ivs_broadcaster_platform_interface.dart';
 
@@ -82,6 +84,8 @@ class MethodChannelIvsBroadcaster extends IvsBroadcasterPlatform {
   /// * [cameraType]: The camera to use for the preview, default is [CameraType.BACK].
   /// * [onData]: A callback function to handle real-time data from the event stream.
   /// * [onError]: A callback function to handle errors from the event stream.
+  /// * [enforceEncoderLimit]: Lower [quality] to the highest quality the device encodes in real time (Linux only).
+  /// * [minRefreshRate]: Frames per second still encoded when the picture does not change; 0 encodes every frame (Linux only).
   ///
   /// Throws an [Exception] if the preview cannot start due to missing permissions, invalid parameters, or native platform issues.
   @override
@@ -93,6 +97,8 @@ class MethodChannelIvsBroadcaster extends IvsBroadcasterPlatform {
     void Function(dynamic)? onData,
     void Function(dynamic)? onError,
     bool autoReconnect = false,
+    bool enforceEncoderLimit = true,
+    double minRefreshRate = 1.0,
   }) async {
     try {
       // Request permissions before starting the preview.
@@ -113,6 +119,8 @@ class MethodChannelIvsBroadcaster extends IvsBroadcasterPlatform {
         'cameraType': cameraType.index.toString(),
         "quality": quality.description,
         'autoReconnect': autoReconnect,
+        'enforceEncoderLimit': enforceEncoderLimit,
+        'minRefreshRate': minRefreshRate,
       });
       // Cancel any existing event stream before starting a new one.
       try {
@@ -264,4 +272,82 @@ class MethodChannelIvsBroadcaster extends IvsBroadcasterPlatform {
       throw Exception("$e [Stop Video Capture]");
     }
   }
+
+  @override
+  Future<EncoderCapabilities> getEncoderCapabilities() async {
+    try {
+      final Map<Object?, Object?>? capabilities = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("getEncoderCapabilities");
+      return EncoderCapabilities.fromMap(
+          Map<String, dynamic>.from(capabilities ?? {}));
+    } catch (e) {
+      throw Exception("$e [Get Encoder Capabilities]");
+    }
+  }
+
+  @override
+  Future<int?> getPreviewTextureId() async {
+    try {
+      return await methodChannel.invokeMethod<int>("getPreviewTextureId");
+    } catch (e) {
+      throw Exception("$e [Get Preview Texture Id]");
+    }
+  }
+
+  @override
+  Future<Map<String, CommandStats>> getCommandStats() async {
+    if (defaultTargetPlatform != TargetPlatform.linux) return {};
+    try {
+      final Map<Object?, Object?>? stats = await methodChannel
+          .invokeMethod<Map<Object?, Object?>>("getCommandStats");
+      return (stats ?? {}).map((method, value) => MapEntry(
+            method as String,
+            CommandStats.fromMap(Map<String, dynamic>.from(value as Map)),
+          ));
+    } catch (e) {
+      throw Exception("$e [Get Command Stats]");
+    }
+  }
+
+  @override
+  Future<int> sendTimedMetadata(List<String> messages) async {
+    try {
+      final accepted = await methodChannel.invokeMethod<Object?>(
+        "sendTimeMetaData",
+        <String, dynamic>{
+          'messages': messages,
+        },
+      );
+      return accepted is int ? accepted : (accepted == true ? 1 : 0);
+    } catch (e) {
+      throw Exception("$e [Send Timed Metadata]");
+    }
+  }
+
+  @override
+  Future<String?> configureTimedMetadata({
+    Duration window = const Duration(milliseconds: 100),
+    int bytesPerSecond = 2048,
+    int burstBytes = 4096,
+    int maxPayloadBytes = 1024,
+    bool compress = false,
+    String? dictionary,
+  }) async {
+    if (defaultTargetPlatform != TargetPlatform.linux) return null;
+    try {
+      return await methodChannel.invokeMethod<String>(
+        "configureTimedMetadata",
+        <String, dynamic>{
+          'windowMs': window.inMilliseconds,
+          'bytesPerSecond': bytesPerSecond,
+          'burstBytes': burstBytes,
+          'maxPayloadBytes': maxPayloadBytes,
+          'compress': compress,
+          if (dictionary != null) 'dictionary': dictionary,
+        },
+      );
+    } catch (e) {
+      throw Exception("$e [Configure Timed Metadata]");
+    }
+  }
 }
@@ -1,6 +1,8 @@
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
 import '../helpers/enums.dart';
+import 'Classes/command_stats.dart';
+import 'Classes/encoder_capabilities.dart';
 import 'Classes/zoom_factor.dart';
 import 'ivs_broadcaster_method_channel.dart';
 
@@ -52,6 +54,8 @@ abstract class IvsBroadcasterPlatform extends PlatformInterface {
   /// * [cameraType]: The camera to use for the preview, default is [CameraType.BACK].
   /// * [onData]: A callback function to handle real-time data from the event stream.
   /// * [onError]: A callback function to handle errors from the event stream.
+  /// * [enforceEncoderLimit]: Lower [quality] to the highest quality the device encodes in real time (Linux only).
+  /// * [minRefreshRate]: Frames per second still encoded when the picture does not change; 0 encodes every frame (Linux only).
   ///
   /// Returns a [Future] that completes when the preview has started.
   Future<void> startPreview({
@@ -62,6 +66,8 @@ abstract class IvsBroadcasterPlatform extends PlatformInterface {
     void Function(dynamic)? onData,
     void Function(dynamic)? onError,
     bool autoReconnect,
+    bool enforceEncoderLimit,
+    double minRefreshRate,
   });
 
   /// Starts the broadcast.
@@ -117,4 +123,43 @@ abstract class IvsBroadcasterPlatform extends PlatformInterface {
   Future<void> captureVideo(int seconds);
 
   Future<void> stopVideoCapture();
+
+  /// Benchmarks the available encoders (once per device) and reports the
+  /// highest quality they sustain in real time. Supported on Linux.
+  Future<EncoderCapabilities> getEncoderCapabilities();
+
+  /// The id of the texture showing the camera preview, for a [Texture]
+  /// widget. Supported on Linux; null elsewhere.
+  Future<int?> getPreviewTextureId();
+
+  /// Queue-wait and run times of the native commands executed so far, keyed
+  /// by method name. Supported on Linux, where camera and session commands
+  /// run off the platform thread; empty elsewhere.
+  Future<Map<String, CommandStats>> getCommandStats();
+
+  /// Sends [messages] as timed metadata with the stream.
+  ///
+  /// Returns how many messages were accepted. On Linux they are queued,
+  /// deduplicated and packed into batched, optionally compressed payloads;
+  /// viewers unpack those with `TimedMetadata.decode`.
+  Future<int> sendTimedMetadata(List<String> messages);
+
+  /// Tunes how Linux batches timed metadata.
+  ///
+  /// * [window]: How long a message may wait for others to share its payload.
+  /// * [bytesPerSecond], [burstBytes]: The metadata bandwidth budget.
+  /// * [maxPayloadBytes]: The largest payload sent at once.
+  /// * [compress]: Deflate payloads with a preset dictionary: [dictionary]
+  ///   when given, otherwise a built-in one trained on typical messages.
+  ///
+  /// Returns the dictionary in use, which viewers must decode with, or null
+  /// when payloads are not compressed.
+  Future<String?> configureTimedMetadata({
+    Duration window,
+    int bytesPerSecond,
+    int burstBytes,
+    int maxPayloadBytes,
+    bool compress,
+    String? dictionary,
+  });
 }
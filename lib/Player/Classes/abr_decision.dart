@@ -0,0 +1,49 @@
+/// A rendition choice of the native adaptive bitrate controller, made for
+/// every segment. Reported on Linux.
+class AbrDecision {
+  /// The rendition chosen, e.g. "720p", as listed by `getQualities`.
+  final String quality;
+
+  /// Its peak bits per second.
+  final int bandwidth;
+
+  /// Whether it differs from the rendition of the previous segment.
+  final bool switched;
+
+  /// False when the rendition was pinned with `setQuality`.
+  final bool automatic;
+
+  /// What the choice rested on: "throughput", "buffer", "buffer, capped",
+  /// "resolution cap" or "manual".
+  final String reason;
+
+  /// Estimated network throughput in bits per second.
+  final int throughput;
+
+  /// Media downloaded but not played yet.
+  final Duration buffer;
+
+  AbrDecision({
+    required this.quality,
+    required this.bandwidth,
+    required this.switched,
+    required this.automatic,
+    required this.reason,
+    required this.throughput,
+    required this.buffer,
+  });
+
+  factory AbrDecision.fromMap(Map<dynamic, dynamic> map) {
+    return AbrDecision(
+      quality: map['quality'] ?? '',
+      bandwidth: map['bandwidth'] ?? 0,
+      switched: map['switched'] ?? false,
+      automatic: map['automatic'] ?? true,
+      reason: map['reason'] ?? '',
+      throughput: map['throughput'] ?? 0,
+      buffer: Duration(
+        microseconds: (((map['buffer'] as num?) ?? 0) * 1000000).round(),
+      ),
+    );
+  }
+}
@@ -0,0 +1,28 @@
+/// A timed-metadata cue of the stream being played, e.g. a message sent
+/// with `sendTimedMetadata`.
+class MetadataCue {
+  /// The cue's text.
+  final String text;
+
+  /// When the cue starts and ends in the stream; equal for cues without a
+  /// duration.
+  final Duration startTime;
+  final Duration endTime;
+
+  MetadataCue({
+    required this.text,
+    required this.startTime,
+    required this.endTime,
+  });
+
+  factory MetadataCue.fromMap(Map<dynamic, dynamic> map) {
+    Duration seconds(dynamic value) => Duration(
+          microseconds: (((value as num?) ?? 0) * 1000000).round(),
+        );
+    return MetadataCue(
+      text: map['metadata'] ?? '',
+      startTime: seconds(map['startTime']),
+      endTime: seconds(map['endTime']),
+    );
+  }
+}
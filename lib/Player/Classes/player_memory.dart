@@ -0,0 +1,101 @@
+/// What one player holds against the memory budget. Reported on Linux.
+class PlayerMemory {
+  /// The player's id, its URL.
+  final String id;
+
+  /// "full", "keyframes" or "networkOnly".
+  final String mode;
+
+  /// 0 for the selected player, then in order of last selection; -1 if it
+  /// was never selected. Higher ranks give memory back first.
+  final int rank;
+
+  /// Media loaded ahead or cached but not decoded.
+  final int demuxedBytes;
+
+  /// Decoded pictures and audio.
+  final int decodedBytes;
+
+  /// The player's share of the budget, weighted by its rank.
+  final int allowanceBytes;
+
+  final int peakBytes;
+
+  /// Times the player gave memory back, and how much in all.
+  final int evictions;
+  final int evictedBytes;
+
+  PlayerMemory({
+    required this.id,
+    required this.mode,
+    required this.rank,
+    required this.demuxedBytes,
+    required this.decodedBytes,
+    required this.allowanceBytes,
+    required this.peakBytes,
+    required this.evictions,
+    required this.evictedBytes,
+  });
+
+  int get bytes => demuxedBytes + decodedBytes;
+
+  factory PlayerMemory.fromMap(Map<dynamic, dynamic> map) {
+    return PlayerMemory(
+      id: map['id'] ?? '',
+      mode: map['mode'] ?? '',
+      rank: map['rank'] ?? -1,
+      demuxedBytes: map['demuxedBytes'] ?? 0,
+      decodedBytes: map['decodedBytes'] ?? 0,
+      allowanceBytes: map['allowanceBytes'] ?? 0,
+      peakBytes: map['peakBytes'] ?? 0,
+      evictions: map['evictions'] ?? 0,
+      evictedBytes: map['evictedBytes'] ?? 0,
+    );
+  }
+}
+
+/// The memory budget shared by all players, from `getMemoryStats`.
+///
+/// When the players together hold more than [maxBytes], the least recently
+/// selected give back their cached GOPs and decoded buffers first and the
+/// selected player last.
+class MemoryStats {
+  /// The budget; 0 when there is none.
+  final int maxBytes;
+  final int bytes;
+  final int peakBytes;
+  final int evictions;
+  final int evictedBytes;
+
+  /// Times the budget stayed exceeded after every player gave back what it
+  /// could.
+  final int overruns;
+
+  /// Every player, selected first.
+  final List<PlayerMemory> players;
+
+  MemoryStats({
+    required this.maxBytes,
+    required this.bytes,
+    required this.peakBytes,
+    required this.evictions,
+    required this.evictedBytes,
+    required this.overruns,
+    required this.players,
+  });
+
+  factory MemoryStats.fromMap(Map<dynamic, dynamic> map) {
+    return MemoryStats(
+      maxBytes: map['maxBytes'] ?? 0,
+      bytes: map['bytes'] ?? 0,
+      peakBytes: map['peakBytes'] ?? 0,
+      evictions: map['evictions'] ?? 0,
+      evictedBytes: map['evictedBytes'] ?? 0,
+      overruns: map['overruns'] ?? 0,
+      players: [
+        for (final player in (map['players'] as List? ?? const []))
+          PlayerMemory.fromMap(player as Map),
+      ],
+    );
+  }
+}
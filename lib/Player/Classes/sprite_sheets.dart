@@ -0,0 +1,100 @@
+import 'dart:ui';
+
+/// The preview for a time: a rectangle of one sprite sheet.
+class SpriteCell {
+  /// The sheet image on disk.
+  final String path;
+
+  /// Where the cell is within the sheet, in pixels.
+  final Rect rect;
+
+  /// The size of the whole sheet, in pixels.
+  final Size sheetSize;
+
+  /// The time of the keyframe shown.
+  final Duration time;
+
+  SpriteCell({
+    required this.path,
+    required this.rect,
+    required this.sheetSize,
+    required this.time,
+  });
+}
+
+/// Trick-play sprite sheets of a VOD stream, made by `generateSprites`.
+///
+/// Every keyframe found is scaled into a cell; sheets hold [columns] x
+/// [rows] cells filled row by row. The sheets are cached on disk, so
+/// [cellAt] previews any time without a network request.
+class SpriteSheets {
+  /// Paths of the sheet images, in order.
+  final List<String> sheets;
+
+  /// The time of each cell's keyframe, ascending.
+  final List<Duration> times;
+
+  final int cellWidth;
+  final int cellHeight;
+  final int columns;
+  final int rows;
+
+  SpriteSheets({
+    required this.sheets,
+    required this.times,
+    required this.cellWidth,
+    required this.cellHeight,
+    required this.columns,
+    required this.rows,
+  });
+
+  factory SpriteSheets.fromMap(Map<dynamic, dynamic> map) {
+    Duration seconds(dynamic value) => Duration(
+          microseconds: (((value as num?) ?? 0) * 1000000).round(),
+        );
+    return SpriteSheets(
+      sheets: List<String>.from(map['sheets'] ?? const []),
+      times: [
+        for (final time in (map['times'] as List? ?? const [])) seconds(time),
+      ],
+      cellWidth: map['cellWidth'] ?? 0,
+      cellHeight: map['cellHeight'] ?? 0,
+      columns: map['columns'] ?? 1,
+      rows: map['rows'] ?? 1,
+    );
+  }
+
+  /// The cell of the last keyframe at or before [time], or of the first one
+  /// for an earlier time; null if there are no cells.
+  SpriteCell? cellAt(Duration time) {
+    if (times.isEmpty) return null;
+    // The first keyframe after [time].
+    var low = 0;
+    var high = times.length;
+    while (low < high) {
+      final middle = (low + high) ~/ 2;
+      if (times[middle] <= time) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    final index = low == 0 ? 0 : low - 1;
+    final perSheet = columns * rows;
+    final position = index % perSheet;
+    return SpriteCell(
+      path: sheets[index ~/ perSheet],
+      rect: Rect.fromLTWH(
+        (position % columns * cellWidth).toDouble(),
+        (position ~/ columns * cellHeight).toDouble(),
+        cellWidth.toDouble(),
+        cellHeight.toDouble(),
+      ),
+      sheetSize: Size(
+        (columns * cellWidth).toDouble(),
+        (rows * cellHeight).toDouble(),
+      ),
+      time: times[index],
+    );
+  }
+}
@@ -0,0 +1,26 @@
+/// What `prefetchVod` stored in the segment cache.
+class VodPrefetch {
+  /// Segments and initialisation sections of the chosen variant within the
+  /// requested duration.
+  final int segments;
+
+  /// How many of [segments] were cached already.
+  final int cached;
+
+  /// Bytes downloaded for the rest.
+  final int bytes;
+
+  VodPrefetch({
+    required this.segments,
+    required this.cached,
+    required this.bytes,
+  });
+
+  factory VodPrefetch.fromMap(Map<dynamic, dynamic> map) {
+    return VodPrefetch(
+      segments: map['segments'] ?? 0,
+      cached: map['cached'] ?? 0,
+      bytes: map['bytes'] ?? 0,
+    );
+  }
+}
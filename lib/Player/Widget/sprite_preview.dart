@@ -0,0 +1,48 @@
+import 'dart:io';
+
+import 'package:flutter/material.dart';
+import 'package:ivs_broadcaster/Player/Classes/sprite_sheets.dart';
+
+/// Shows one cell of a sprite sheet, e.g. above the seek slider while
+/// scrubbing. The sheet is read from disk once and kept by the image cache,
+/// so moving between its cells costs nothing.
+class SpritePreview extends StatelessWidget {
+  /// The cell to show, from [SpriteSheets.cellAt].
+  final SpriteCell cell;
+
+  /// Scales the cell, which is shown at its pixel size by default.
+  final double scale;
+
+  const SpritePreview({
+    Key? key,
+    required this.cell,
+    this.scale = 1,
+  }) : super(key: key);
+
+  @override
+  Widget build(BuildContext context) {
+    return SizedBox(
+      width: cell.rect.width * scale,
+      height: cell.rect.height * scale,
+      child: ClipRect(
+        child: OverflowBox(
+          alignment: Alignment.topLeft,
+          minWidth: 0,
+          minHeight: 0,
+          maxWidth: double.infinity,
+          maxHeight: double.infinity,
+          child: Transform.translate(
+            offset: -cell.rect.topLeft * scale,
+            child: Image.file(
+              File(cell.path),
+              width: cell.sheetSize.width * scale,
+              height: cell.sheetSize.height * scale,
+              fit: BoxFit.fill,
+              gaplessPlayback: true,
+            ),
+          ),
+        ),
+      ),
+    );
+  }
+}
@@ -6,6 +6,11 @@ import 'dart:io';
 
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
+import 'package:ivs_broadcaster/Player/Classes/abr_decision.dart';
+import 'package:ivs_broadcaster/Player/Classes/metadata_cue.dart';
+import 'package:ivs_broadcaster/Player/Classes/player_memory.dart';
+import 'package:ivs_broadcaster/Player/Classes/sprite_sheets.dart';
+import 'package:ivs_broadcaster/Player/Classes/vod_prefetch.dart';
 import 'package:ivs_broadcaster/Player/ivs_player_interface.dart';
 import 'package:ivs_broadcaster/helpers/enums.dart';
 import 'package:ivs_broadcaster/helpers/strings.dart';
@@ -28,6 +33,7 @@ class IvsPlayer {
   ///
   /// - For Android, it uses [AndroidView] to create a platform-specific view.
   /// - For iOS, it uses [UiKitView] to create a platform-specific view.
+  /// - For Linux, it uses a [Texture] showing the selected player.
   /// - If the platform is not supported, a message is displayed.
   Widget _getView() {
     if (Platform.isAndroid) {
@@ -40,6 +46,15 @@ class IvsPlayer {
         viewType: 'ivs_player',
         creationParamsCodec: StandardMessageCodec(),
       );
+    } else if (Platform.isLinux) {
+      return FutureBuilder<int?>(
+        future: _controller.getTextureId(),
+        builder: (context, snapshot) {
+          final textureId = snapshot.data;
+          if (textureId == null) return const SizedBox.shrink();
+          return Texture(textureId: textureId);
+        },
+      );
     }
     return const Center(
       child: Text(
@@ -82,8 +97,38 @@ class IvsPlayer {
   /// StreamController to broadcast whether auto-quality adjustment is enabled.
   StreamController<bool> isAutoQualityStream = StreamController.broadcast();
 
-  /// StreamSubscription to periodically update the player's position.
-  StreamSubscription? _positionStreamSubs;
+  /// StreamController to broadcast how far ahead of the position the player
+  /// has buffered.
+  StreamController<Duration> bufferedPositionStream =
+      StreamController.broadcast();
+
+  /// StreamController to broadcast the latency behind the live edge.
+  StreamController<Duration> liveLatencyStream = StreamController.broadcast();
+
+  /// StreamController to broadcast how long a stream selected with
+  /// [selectPlayer] took to show its first frame. Reported on Linux.
+  StreamController<Duration> switchLatencyStream =
+      StreamController.broadcast();
+
+  /// StreamController to broadcast the rendition the adaptive bitrate
+  /// controller chose for each segment, and why. Reported on Linux.
+  StreamController<AbrDecision> abrDecisionStream =
+      StreamController.broadcast();
+
+  /// StreamController to broadcast the rate a live stream plays at while it
+  /// catches up with its target latency, and 1 once it has. Reported on
+  /// Linux.
+  StreamController<double> playbackRateStream = StreamController.broadcast();
+
+  /// StreamController to broadcast timed-metadata cues as playback reaches
+  /// them.
+  StreamController<MetadataCue> cueStream = StreamController.broadcast();
+
+  /// StreamController to broadcast the cues active where a [seekTo] landed,
+  /// including ones that started before it; empty when there are none.
+  /// Reported on Linux.
+  StreamController<List<MetadataCue>> activeCuesStream =
+      StreamController.broadcast();
 
   /// Toggles mute/unmute for the player.
   void muteUnmute() {
@@ -108,34 +153,60 @@ class IvsPlayer {
   ///
   /// This method initializes the player and begins streaming the content from the specified URL.
   /// It listens for various events such as player state changes, quality updates, and errors, and broadcasts them via the respective streams.
-  void startPlayer(String url, {bool autoPlay = true}) {
+  ///
+  /// The native player pushes its position, buffered position and live
+  /// latency [positionUpdateRate] times a second, on display frames, while
+  /// the view is visible. Pass 0 to stop the updates.
+  Future<void> startPlayer(
+    String url, {
+    bool autoPlay = true,
+    int positionUpdateRate = 10,
+  }) {
     _controller.createPlayer(url);
-    _controller.startPlayer(
+    return _controller.startPlayer(
       url,
       autoPlay: autoPlay,
+      positionUpdateRate: positionUpdateRate,
       onData: (data) async {
         _parseEvents(data);
       },
       onError: (error) {},
     );
+  }
 
-    // Periodically update the player's position.
-    _positionStreamSubs?.cancel();
-    _positionStreamSubs = Stream.periodic(
-      const Duration(milliseconds: 100),
-    ).listen(
-      (event) async {
-        positionStream.add(await _controller.getPosition());
-      },
-    );
+  /// Converts a native time in seconds to a [Duration].
+  Duration? _seconds(dynamic value) {
+    final seconds = double.tryParse(value.toString());
+    if (seconds == null || !seconds.isFinite) return null;
+    return Duration(microseconds: (seconds * 1000000).round());
   }
 
   void _parseEvents(dynamic data) async {
+    // Batched events (e.g. metadata cues) arrive as a list.
+    if (data is List) {
+      for (final event in data) {
+        _parseEvents(event);
+      }
+      return;
+    }
     // Parse incoming data and add relevant information to the appropriate streams.
     final Map<String, dynamic> parsedData = Map<String, dynamic>.from(data);
-    if (parsedData.containsKey(AppStrings.state)) {
+    if (parsedData.containsKey(AppStrings.position)) {
+      // Playback updates carry several values at once.
+      final position = _seconds(parsedData[AppStrings.position]);
+      final buffered = _seconds(parsedData[AppStrings.bufferedPosition]);
+      final latency = _seconds(parsedData[AppStrings.liveLatency]);
+      if (position != null) positionStream.add(position);
+      if (buffered != null) bufferedPositionStream.add(buffered);
+      if (latency != null) liveLatencyStream.add(latency);
+    } else if (parsedData.containsKey(AppStrings.state)) {
       final value = parsedData[AppStrings.state];
       playeStateStream.add(PlayerState.values[value]);
+    } else if (parsedData.containsKey(AppStrings.abrDecision)) {
+      final decision =
+          AbrDecision.fromMap(parsedData[AppStrings.abrDecision] as Map);
+      abrDecisionStream.add(decision);
+      if (decision.switched) qualityStream.add(decision.quality);
     } else if (parsedData.containsKey(AppStrings.quality)) {
       final value = parsedData[AppStrings.quality];
       qualityStream.add(value);
@@ -153,17 +224,32 @@ class IvsPlayer {
       final value = parsedData[AppStrings.syncTime];
       syncTimeStream
           .add(Duration(seconds: double.parse(value.toString()).toInt()));
+    } else if (parsedData.containsKey(AppStrings.metadata)) {
+      cueStream.add(MetadataCue.fromMap(parsedData));
+    } else if (parsedData.containsKey(AppStrings.activeCues)) {
+      final cues = parsedData[AppStrings.activeCues] as List? ?? const [];
+      activeCuesStream.add([
+        for (final cue in cues) MetadataCue.fromMap(cue as Map),
+      ]);
+    } else if (parsedData.containsKey(AppStrings.playbackRate)) {
+      final rate = double.tryParse(
+        parsedData[AppStrings.playbackRate].toString(),
+      );
+      final latency = _seconds(parsedData[AppStrings.liveLatency]);
+      if (rate != null) playbackRateStream.add(rate);
+      if (latency != null) liveLatencyStream.add(latency);
+    } else if (parsedData.containsKey(AppStrings.switchLatency)) {
+      final latency = _seconds(parsedData[AppStrings.switchLatency]);
+      if (latency != null) switchLatencyStream.add(latency);
     } else if (parsedData.containsKey(AppStrings.error)) {
       final value = parsedData[AppStrings.error];
       errorStream.add(value);
     }
   }
 
-  /// Stops the player and cancels the position update stream subscription.
+  /// Stops the player; native position updates stop with it.
   void stopPlayer() async {
     _controller.stopPlayer();
-    _positionStreamSubs?.cancel();
-    _positionStreamSubs = null;
   }
 
   /// ValueNotifier to hold the available streaming qualities.
@@ -196,12 +282,34 @@ class IvsPlayer {
     await _controller.seekTo(duration);
   }
 
+  /// Sets the latency behind the live edge that playback steers back to.
+  ///
+  /// See [IvsPlayerInterface.setTargetLatency]; [playbackRateStream] reports
+  /// the rate while it catches up.
+  Future<void> setTargetLatency(Duration latency) async {
+    await _controller.setTargetLatency(latency);
+  }
+
+  /// Retrieves the cues seen so far that overlap [from] to [to].
+  ///
+  /// See [IvsPlayerInterface.getCues].
+  Future<List<MetadataCue>> getCues(Duration from, Duration to) {
+    return _controller.getCues(from, to);
+  }
+
+  /// Retrieves what each player holds against the shared memory budget.
+  ///
+  /// See [IvsPlayerInterface.getMemoryStats].
+  Future<MemoryStats> getMemoryStats() {
+    return _controller.getMemoryStats();
+  }
+
   /// Selects a player using the given identifier.
   ///
   /// This function asynchronously invokes `_controller.selectPlayer`
   /// with the provided player identifier `s`.
-  void selectPlayer(String s) async {
-    _controller.selectPlayer(s);
+  Future<void> selectPlayer(String s) {
+    return _controller.selectPlayer(s);
   }
 
   /// Initiates multi-player mode with a list of player identifiers.
@@ -210,13 +318,15 @@ class IvsPlayer {
   /// - `autoPlay` determines if playback should start automatically (default: true).
   /// - `onData` callback handles incoming player data and logs it.
   /// - `onError` handles any errors that occur.
-  void multiPlayer(
+  Future<void> multiPlayer(
     List<String> s, {
     bool autoPlay = true,
-  }) async {
-    _controller.multiPlayer(
+    int positionUpdateRate = 10,
+  }) {
+    return _controller.multiPlayer(
       s,
       autoPlay: true,
+      positionUpdateRate: positionUpdateRate,
       onData: (data) async {
         log("PlayerData: $data");
         _parseEvents(data);
@@ -225,12 +335,95 @@ class IvsPlayer {
     );
   }
 
-  /// Retrieves a thumbnail image for the provided media URL.
+  /// Plays [urls] tiled into one texture and returns its id.
+  ///
+  /// See [IvsPlayerInterface.startMosaic]; show it with a [Texture] widget.
+  Future<int?> startMosaic(
+    List<String> urls, {
+    MosaicLayout layout = MosaicLayout.grid,
+    int columns = 0,
+    int width = 1280,
+    int height = 720,
+    String? audio,
+  }) {
+    return _controller.startMosaic(
+      urls,
+      layout: layout,
+      columns: columns,
+      width: width,
+      height: height,
+      audio: audio,
+      onData: (data) async {
+        log("PlayerData: $data");
+        _parseEvents(data);
+      },
+      onError: (error) {},
+    );
+  }
+
+  /// See [IvsPlayerInterface.stopMosaic].
+  Future<void> stopMosaic() {
+    return _controller.stopMosaic();
+  }
+
+  /// Retrieves a thumbnail image of [url] at [time].
+  ///
+  /// See [IvsPlayerInterface.getThumbnail]. Decoding happens off the platform
+  /// thread, so this is safe to call while scrubbing.
+  Future<Uint8List> getThumbnail({
+    required String url,
+    Duration time = Duration.zero,
+    int width = 320,
+    int height = 180,
+    ThumbnailFormat format = ThumbnailFormat.jpeg,
+  }) {
+    return _controller.getThumbnail(
+      url: url,
+      time: time,
+      width: width,
+      height: height,
+      format: format,
+    );
+  }
+
+  /// Builds, or loads from the disk cache, trick-play sprite sheets of the
+  /// VOD stream at [url] for scrubbing previews.
   ///
-  /// This asynchronous function calls `_controller.getThumbnail`
-  /// with an optional `url` parameter and returns a `Uint8List`
-  /// containing the image data.
-  // Future<Uint8List> getThumbnail({String? url}) async {
-  //   return await _controller.getThumbnail(url: url);
-  // }
+  /// See [IvsPlayerInterface.generateSprites]. Show a cell with
+  /// `SpritePreview`.
+  Future<SpriteSheets> generateSprites({
+    required String url,
+    Duration interval = const Duration(seconds: 10),
+    int width = 160,
+    int height = 90,
+    int columns = 10,
+    int rows = 10,
+    ThumbnailFormat format = ThumbnailFormat.jpeg,
+  }) {
+    return _controller.generateSprites(
+      url: url,
+      interval: interval,
+      width: width,
+      height: height,
+      columns: columns,
+      rows: rows,
+      format: format,
+    );
+  }
+
+  /// Downloads the VOD stream at [url] into the disk segment cache so that
+  /// playing it later loads only its playlists.
+  ///
+  /// See [IvsPlayerInterface.prefetchVod].
+  Future<VodPrefetch> prefetchVod({
+    required String url,
+    Duration? duration,
+    int maxBandwidth = 0,
+  }) {
+    return _controller.prefetchVod(
+      url: url,
+      duration: duration,
+      maxBandwidth: maxBandwidth,
+    );
+  }
 }
@@ -2,6 +2,11 @@ import 'dart:typed_data';
 
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
+import '../helpers/enums.dart';
+import 'Classes/metadata_cue.dart';
+import 'Classes/player_memory.dart';
+import 'Classes/sprite_sheets.dart';
+import 'Classes/vod_prefetch.dart';
 import 'ivs_player_method_channel.dart';
 
 /// [IvsPlayerInterface] serves as the abstract base class for platform-specific
@@ -35,17 +40,22 @@ abstract class IvsPlayerInterface extends PlatformInterface {
   ///
   /// - [url]: The streaming URL that the player should start playing.
   /// - [autoPlay]: If true, the player starts playing the content automatically.
+  /// - [positionUpdateRate]: How many times a second the native side pushes
+  ///   the playback position on the event channel; 0 disables the updates.
   /// - [onData]: Callback function to handle data events from the player.
   /// - [onError]: Callback function to handle error events from the player.
-  void startPlayer(
+  ///
+  /// Completes once the native player has been created.
+  Future<void> startPlayer(
     String url, {
     required bool autoPlay,
+    int positionUpdateRate = 10,
     void Function(dynamic)? onData,
     void Function(dynamic)? onError,
   });
 
   void createPlayer(String url);
-  void selectPlayer(String url);
+  Future<void> selectPlayer(String url);
 
   /// Resumes the playback if the player was paused.
   void resume();
@@ -86,6 +96,28 @@ abstract class IvsPlayerInterface extends PlatformInterface {
   /// Returns a [Future] that completes when the seek operation is done.
   Future<void> seekTo(Duration duration);
 
+  /// Sets the latency behind the live edge that playback steers back to,
+  /// by playing live streams at up to 1.1x or down to 0.9x. Linux only.
+  ///
+  /// - [latency]: The target; [Duration.zero] uses the stream's own, and a
+  ///   negative one turns catch-up off.
+  Future<void> setTargetLatency(Duration latency);
+
+  /// Retrieves the timed-metadata cues of the stream seen so far that
+  /// overlap [from] to [to], in order of their start. Linux only.
+  ///
+  /// Cues are indexed as their segments are played, so this answers for
+  /// the range played or buffered without downloading anything again.
+  Future<List<MetadataCue>> getCues(Duration from, Duration to);
+
+  /// Retrieves what the players hold against their shared memory budget.
+  /// Linux only.
+  ///
+  /// Players keep their read-ahead within a share of the budget weighted by
+  /// how recently they were selected, and the least recently selected give
+  /// memory back first when it runs out.
+  Future<MemoryStats> getMemoryStats();
+
   /// Retrieves the current playback position of the player.
   ///
   /// Returns a [Future] that resolves to a [Duration] representing the current playback position.
@@ -94,15 +126,86 @@ abstract class IvsPlayerInterface extends PlatformInterface {
   /// Sets the player to play multiple streams simultaneously.
   ///
   /// - [urls]: A list of streaming URLs to play simultaneously.
-  void multiPlayer(
+  /// - [positionUpdateRate]: See [startPlayer].
+  ///
+  /// Completes once the native players have been created.
+  Future<void> multiPlayer(
     List<String> urls, {
     required bool autoPlay,
+    int positionUpdateRate = 10,
+    void Function(dynamic)? onData,
+    void Function(dynamic)? onError,
+  });
+
+  /// The id of the texture showing the selected player, for a [Texture]
+  /// widget. Supported on Linux; null elsewhere.
+  Future<int?> getTextureId();
+
+  /// Plays [urls] together, tiled into one [width] x [height] texture, and
+  /// returns its id for a [Texture] widget.
+  ///
+  /// - [layout]: How the streams are arranged; [columns] fixes the columns
+  ///   of a grid, 0 picks them.
+  /// - [audio]: The stream heard, whose events are sent; the first by
+  ///   default. [selectPlayer] changes it without changing the tiles.
+  ///
+  /// Each stream plays the rendition nearest its tile's size. Supported on
+  /// Linux; null elsewhere.
+  Future<int?> startMosaic(
+    List<String> urls, {
+    MosaicLayout layout = MosaicLayout.grid,
+    int columns = 0,
+    int width = 1280,
+    int height = 720,
+    String? audio,
     void Function(dynamic)? onData,
     void Function(dynamic)? onError,
   });
 
-  /// Get Screenshot of the player.
-  /// Returns a [Future] that resolves to a [Uint8List] representing the path of the screenshot.
+  /// Leaves mosaic mode; the streams keep playing in the background.
+  Future<void> stopMosaic();
+
+  /// Gets a thumbnail of the stream at [url].
+  ///
+  /// The native side decodes the keyframe nearest [time] on a worker thread,
+  /// scales it to fit within [width] x [height] keeping its aspect ratio and
+  /// encodes it as [format]. Results are cached, so requests a moment apart
+  /// in the same stream return the same image.
+  Future<Uint8List> getThumbnail({
+    String? url,
+    Duration time = Duration.zero,
+    int width = 320,
+    int height = 180,
+    ThumbnailFormat format = ThumbnailFormat.jpeg,
+  });
+
+  /// Builds trick-play sprite sheets of the VOD stream at [url]. Linux only.
+  ///
+  /// The native side seeks to every [interval], decodes only the keyframe
+  /// there and scales it into a [width] x [height] cell of a [columns] x
+  /// [rows] sheet. Sheets and their index are cached on disk, so a second
+  /// call, even after a restart, answers at once, and previews while
+  /// scrubbing need no network requests. Fails for live streams.
+  Future<SpriteSheets> generateSprites({
+    required String url,
+    Duration interval = const Duration(seconds: 10),
+    int width = 160,
+    int height = 90,
+    int columns = 10,
+    int rows = 10,
+    ThumbnailFormat format = ThumbnailFormat.jpeg,
+  });
+
+  /// Downloads the segments of the VOD stream at [url] into the on-disk
+  /// segment cache ahead of playback. Linux only.
   ///
-  Future<Uint8List> getThumbnail({String? url});
+  /// Warms the variant a player limited to [maxBandwidth] would pick (0 takes
+  /// the highest), and only its first [duration] when given. Players opening
+  /// [url] later read the cached segments from disk instead of the network,
+  /// including after a restart. Fails for live streams.
+  Future<VodPrefetch> prefetchVod({
+    required String url,
+    Duration? duration,
+    int maxBandwidth = 0,
+  });
 }
@@ -2,7 +2,12 @@ import 'dart:async';
 import 'dart:developer';
 
 import 'package:flutter/services.dart';
+import 'package:ivs_broadcaster/Player/Classes/metadata_cue.dart';
+import 'package:ivs_broadcaster/Player/Classes/player_memory.dart';
+import 'package:ivs_broadcaster/Player/Classes/sprite_sheets.dart';
+import 'package:ivs_broadcaster/Player/Classes/vod_prefetch.dart';
 import 'package:ivs_broadcaster/Player/ivs_player_interface.dart';
+import 'package:ivs_broadcaster/helpers/enums.dart';
 
 /// [IvsPlayerMethodChannel] is a platform-specific implementation of the [IvsPlayerInterface]
 /// using the MethodChannel and EventChannel to communicate with native code.
@@ -52,9 +57,10 @@ class IvsPlayerMethodChannel extends IvsPlayerInterface {
   /// This method initializes the player and begins streaming the content from the specified URL.
   /// It listens for various events such as player state changes and errors, and triggers the provided callbacks.
   @override
-  void startPlayer(
+  Future<void> startPlayer(
     String url, {
     required bool autoPlay,
+    int positionUpdateRate = 10,
     void Function(dynamic)? onData,
     void Function(dynamic)? onError,
   }) async {
@@ -62,6 +68,7 @@ class IvsPlayerMethodChannel extends IvsPlayerInterface {
       await _methodChannel.invokeMethod("startPlayer", {
         "url": url,
         "autoPlay": autoPlay,
+        "positionUpdateRate": positionUpdateRate,
       });
 
       // Cancel any existing subscription before creating a new one.
@@ -150,6 +157,48 @@ class IvsPlayerMethodChannel extends IvsPlayerInterface {
     }
   }
 
+  /// Sets the latency behind the live edge that playback steers back to.
+  @override
+  Future<void> setTargetLatency(Duration latency) async {
+    try {
+      return await _methodChannel.invokeMethod("setTargetLatency", {
+        "latency": latency.inMicroseconds / 1000000,
+      });
+    } catch (e) {
+      log(e.toString());
+      throw Exception("Unable to set the target latency [Set Target Latency]");
+    }
+  }
+
+  /// Retrieves the cues seen so far that overlap [from] to [to].
+  @override
+  Future<List<MetadataCue>> getCues(Duration from, Duration to) async {
+    try {
+      final cues = await _methodChannel.invokeMethod("getCues", {
+        "from": from.inMicroseconds / 1000000,
+        "to": to.inMicroseconds / 1000000,
+      });
+      return [
+        for (final cue in (cues as List? ?? const []))
+          MetadataCue.fromMap(cue as Map),
+      ];
+    } catch (e) {
+      log(e.toString());
+      throw Exception("Unable to get the cues [Get Cues]");
+    }
+  }
+
+  /// Retrieves what the players hold against their memory budget.
+  @override
+  Future<MemoryStats> getMemoryStats() async {
+    try {
+      final stats = await _methodChannel.invokeMethod("getMemoryStats");
+      return MemoryStats.fromMap(stats as Map);
+    } catch (e) {
+      throw Exception("$e [Get Memory Stats]");
+    }
+  }
+
   /// Retrieves the current playback position of the player.
   @override
   Future<Duration> getPosition() async {
@@ -176,21 +225,23 @@ class IvsPlayerMethodChannel extends IvsPlayerInterface {
   }
 
   @override
-  void selectPlayer(String url) async {
+  Future<void> selectPlayer(String url) async {
     await _methodChannel.invokeMethod("selectPlayer", {
       "playerId": url,
     });
   }
 
   @override
-  void multiPlayer(
+  Future<void> multiPlayer(
     List<String> urls, {
     required bool autoPlay,
+    int positionUpdateRate = 10,
     void Function(dynamic)? onData,
     void Function(dynamic)? onError,
-  }) {
-    _methodChannel.invokeMethod("multiPlayer", {
+  }) async {
+    await _methodChannel.invokeMethod("multiPlayer", {
       "urls": urls,
+      "positionUpdateRate": positionUpdateRate,
     });
 
     // Cancel any existing subscription before creating a new one.
@@ -199,13 +250,69 @@ class IvsPlayerMethodChannel extends IvsPlayerInterface {
         _eventChannel.receiveBroadcastStream().listen(onData, onError: onError);
   }
 
+  @override
+  Future<int?> getTextureId() async {
+    try {
+      return await _methodChannel.invokeMethod<int>("getTextureId");
+    } catch (e) {
+      throw Exception("$e [Get Texture Id]");
+    }
+  }
+
+  @override
+  Future<int?> startMosaic(
+    List<String> urls, {
+    MosaicLayout layout = MosaicLayout.grid,
+    int columns = 0,
+    int width = 1280,
+    int height = 720,
+    String? audio,
+    void Function(dynamic)? onData,
+    void Function(dynamic)? onError,
+  }) async {
+    try {
+      // Listen first, so the first events of the audio stream arrive.
+      playerStateSubscription?.cancel();
+      playerStateSubscription = _eventChannel
+          .receiveBroadcastStream()
+          .listen(onData, onError: onError);
+      return await _methodChannel.invokeMethod<int>("startMosaic", {
+        "urls": urls,
+        "layout": layout.name,
+        "columns": columns,
+        "width": width,
+        "height": height,
+        if (audio != null) "audio": audio,
+      });
+    } catch (e) {
+      throw Exception("$e [Start Mosaic]");
+    }
+  }
+
+  @override
+  Future<void> stopMosaic() async {
+    try {
+      await _methodChannel.invokeMethod("stopMosaic");
+    } catch (e) {
+      throw Exception("$e [Stop Mosaic]");
+    }
+  }
+
   @override
   Future<Uint8List> getThumbnail({
     String? url,
+    Duration time = Duration.zero,
+    int width = 320,
+    int height = 180,
+    ThumbnailFormat format = ThumbnailFormat.jpeg,
   }) async {
     try {
       final data = await _methodChannel.invokeMethod("getScreenshot", {
         "url": url,
+        "time": time.inMicroseconds / Duration.microsecondsPerSecond,
+        "width": width,
+        "height": height,
+        "format": format.name,
       });
       return Uint8List.fromList(List<int>.from(data));
     } catch (e) {
@@ -213,4 +320,51 @@ class IvsPlayerMethodChannel extends IvsPlayerInterface {
       throw Exception("Unable to get the screenshot [Get Screenshot]");
     }
   }
+
+  /// Builds or loads the sprite sheets of [url].
+  @override
+  Future<SpriteSheets> generateSprites({
+    required String url,
+    Duration interval = const Duration(seconds: 10),
+    int width = 160,
+    int height = 90,
+    int columns = 10,
+    int rows = 10,
+    ThumbnailFormat format = ThumbnailFormat.jpeg,
+  }) async {
+    try {
+      final sprites = await _methodChannel.invokeMethod("generateSprites", {
+        "url": url,
+        "interval": interval.inMicroseconds / Duration.microsecondsPerSecond,
+        "width": width,
+        "height": height,
+        "columns": columns,
+        "rows": rows,
+        "format": format.name,
+      });
+      return SpriteSheets.fromMap(sprites as Map);
+    } catch (e) {
+      throw Exception("$e [Generate Sprites]");
+    }
+  }
+
+  /// Loads the segments of [url] into the segment cache.
+  @override
+  Future<VodPrefetch> prefetchVod({
+    required String url,
+    Duration? duration,
+    int maxBandwidth = 0,
+  }) async {
+    try {
+      final prefetch = await _methodChannel.invokeMethod("prefetchVod", {
+        "url": url,
+        "duration": (duration?.inMicroseconds ?? 0) /
+            Duration.microsecondsPerSecond,
+        "maxBandwidth": maxBandwidth,
+      });
+      return VodPrefetch.fromMap(prefetch as Map);
+    } catch (e) {
+      throw Exception("$e [Prefetch Vod]");
+    }
+  }
 }
@@ -103,3 +103,18 @@ extension IvsQualityExtension on IvsQuality {
     }
   }
 }
+
+/// Image format of a player thumbnail. WebP falls back to JPEG where the
+/// platform has no WebP encoder (iOS, and Linux FFmpeg builds without
+/// libwebp).
+enum ThumbnailFormat {
+  jpeg,
+  webp,
+}
+
+/// How startMosaic arranges its streams: equal tiles, or the
+/// first stream large with the others in a column beside it.
+enum MosaicLayout {
+  grid,
+  spotlight,
+}
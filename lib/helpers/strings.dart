@@ -7,4 +7,12 @@ class AppStrings {
   static const error = "error";
   static const seekedtotime = "seekedtotime";
   static const syncTime = "syncTime";
+  static const position = "position";
+  static const bufferedPosition = "bufferedPosition";
+  static const liveLatency = "liveLatency";
+  static const switchLatency = "switchLatency";
+  static const abrDecision = "abrDecision";
+  static const playbackRate = "playbackRate";
+  static const metadata = "metadata";
+  static const activeCues = "activeCues";
 }
@@ -0,0 +1,246 @@
+#include "abr_controller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+AbrChoice ThroughputAbrPolicy::Choose(const AbrInput& input) {
+  const std::vector<AbrRendition>& ladder = *input.ladder;
+  const double usable = input.throughput_bps * safety_;
+  int index = 0;
+  for (size_t i = 1; i < ladder.size(); ++i) {
+    if (ladder[i].bandwidth <= usable) index = static_cast<int>(i);
+  }
+  return {index, "throughput"};
+}
+
+BolaAbrPolicy::BolaAbrPolicy(const BolaConfig& config)
+    : config_(config), throughput_(config.safety) {}
+
+AbrChoice BolaAbrPolicy::Choose(const AbrInput& input) {
+  const int64_t previous_buffer_us = last_buffer_us_;
+  last_buffer_us_ = input.buffer_us;
+  if (input.buffer_us >= config_.bola_above_us) {
+    buffer_based_ = true;
+  } else if (input.buffer_us < config_.throughput_below_us) {
+    buffer_based_ = false;
+  }
+  const int sustained = throughput_.Choose(input).index;
+  if (!buffer_based_ || input.current < 0) {
+    return {sustained, "throughput"};
+  }
+  const bool draining = input.buffer_us < previous_buffer_us;
+  const int chosen = ChooseByBuffer(input);
+  if (chosen > input.current && chosen > sustained) {
+    return {std::max(input.current, sustained), "buffer, capped"};
+  }
+  // Entering buffer-based choice from throughput-based choice, BOLA may
+  // want less than what plays; only a draining buffer says it must.
+  if (chosen < input.current && !draining) {
+    return {input.current, "buffer"};
+  }
+  return {chosen, "buffer"};
+}
+
+int BolaAbrPolicy::ChooseByBuffer(const AbrInput& input) const {
+  // BOLA-BASIC in seconds, with utilities ln(S_m / S_1) + 1 so that the
+  // lowest rendition's is 1, and V and gamma*p picked so that the choice
+  // climbs from the lowest rendition at the minimum buffer to the highest
+  // at the target.
+  const std::vector<AbrRendition>& ladder = *input.ladder;
+  const double lowest = std::max<int64_t>(ladder.front().bandwidth, 1);
+  const double top_utility =
+      std::log(std::max<double>(ladder.back().bandwidth, lowest) / lowest) +
+      1;
+  const double min_buffer = config_.min_buffer_us / 1e6;
+  const double target = std::max(config_.target_buffer_us / 1e6,
+                                 min_buffer * 1.01);
+  if (top_utility <= 1) return 0;
+  const double gp = (top_utility - 1) / (target / min_buffer - 1);
+  const double v = min_buffer / gp;
+  const double buffer = input.buffer_us / 1e6;
+  int best = 0;
+  double best_score = -INFINITY;
+  for (size_t i = 0; i < ladder.size(); ++i) {
+    const double bandwidth = std::max<double>(ladder[i].bandwidth, lowest);
+    const double utility = std::log(bandwidth / lowest) + 1;
+    const double score = (v * (utility + gp) - buffer) / bandwidth;
+    if (score >= best_score) {
+      best_score = score;
+      best = static_cast<int>(i);
+    }
+  }
+  return best;
+}
+
+ThroughputEstimator::ThroughputEstimator(const AbrConfig& config)
+    : config_(config) {
+  fast_.alpha = std::exp(std::log(0.5) / config.fast_half_life_s);
+  slow_.alpha = std::exp(std::log(0.5) / config.slow_half_life_s);
+}
+
+void ThroughputEstimator::Average::Add(double weight, double value) {
+  const double adjusted = std::pow(alpha, weight);
+  estimate = value * (1 - adjusted) + adjusted * estimate;
+  total_weight += weight;
+}
+
+double ThroughputEstimator::Average::Get() const {
+  // Undoes the pull towards the zero the average started from.
+  return estimate / (1 - std::pow(alpha, total_weight));
+}
+
+void ThroughputEstimator::AddSample(int64_t bytes, int64_t duration_us) {
+  if (bytes < config_.min_sample_bytes) return;
+  // Transfers faster than the clock can tell apart.
+  duration_us = std::max<int64_t>(duration_us, 1000);
+  const double seconds = duration_us / 1e6;
+  const double bps = bytes * 8 / seconds;
+  fast_.Add(seconds, bps);
+  slow_.Add(seconds, bps);
+  total_bytes_ += bytes;
+}
+
+int64_t ThroughputEstimator::estimate_bps() const {
+  if (total_bytes_ < config_.min_total_bytes) {
+    return config_.initial_bandwidth_bps;
+  }
+  return static_cast<int64_t>(std::min(fast_.Get(), slow_.Get()));
+}
+
+AbrController::AbrController(const AbrConfig& config,
+                             std::unique_ptr<AbrPolicy> policy)
+    : estimator_(config), policy_(std::move(policy)) {}
+
+void AbrController::SetCallback(DecisionCallback callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  callback_ = std::move(callback);
+}
+
+void AbrController::SetLadder(std::vector<AbrRendition> ladder) {
+  std::stable_sort(ladder.begin(), ladder.end(),
+                   [](const AbrRendition& a, const AbrRendition& b) {
+                     return a.bandwidth < b.bandwidth;
+                   });
+  std::lock_guard<std::mutex> lock(mutex_);
+  ladder_ = std::move(ladder);
+  current_ = -1;
+}
+
+std::vector<AbrRendition> AbrController::ladder() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ladder_;
+}
+
+void AbrController::OnDownload(int64_t bytes, int64_t duration_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  estimator_.AddSample(bytes, duration_us);
+}
+
+AbrDecision AbrController::Decide(int64_t buffer_us,
+                                  int64_t segment_duration_us) {
+  AbrDecision decision;
+  DecisionCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    decision.previous = current_;
+    decision.automatic = automatic_;
+    decision.throughput_bps = estimator_.estimate_bps();
+    decision.buffer_us = buffer_us;
+    if (ladder_.empty()) {
+      decision.index = -1;
+      return decision;
+    }
+    int pinned = -1;
+    if (!automatic_) {
+      for (size_t i = 0; i < ladder_.size(); ++i) {
+        if (ladder_[i].name == manual_) pinned = static_cast<int>(i);
+      }
+    }
+    if (pinned >= 0) {
+      decision.index = pinned;
+      decision.reason = "manual";
+    } else {
+      AbrInput input;
+      input.ladder = &ladder_;
+      input.current = current_;
+      input.buffer_us = buffer_us;
+      input.throughput_bps = decision.throughput_bps;
+      input.segment_duration_us = segment_duration_us;
+      const AbrChoice choice = policy_->Choose(input);
+      decision.index = std::clamp(choice.index, 0,
+                                  static_cast<int>(ladder_.size()) - 1);
+      decision.reason = choice.reason;
+      const int cap = CapLocked();
+      if (decision.index > cap) {
+        decision.index = cap;
+        decision.reason = "resolution cap";
+      }
+    }
+    decision.rendition = ladder_[decision.index];
+    current_ = decision.index;
+    callback = callback_;
+  }
+  if (callback) callback(decision);
+  return decision;
+}
+
+bool AbrController::SetManual(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool known =
+      std::any_of(ladder_.begin(), ladder_.end(),
+                  [&name](const AbrRendition& rendition) {
+                    return rendition.name == name;
+                  });
+  if (!known) return false;
+  manual_ = name;
+  automatic_ = false;
+  return true;
+}
+
+void AbrController::SetAutomatic(bool automatic) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  automatic_ = automatic;
+  // Turning automatic choice off without a pick keeps what plays now.
+  if (!automatic && current_ >= 0) manual_ = ladder_[current_].name;
+}
+
+bool AbrController::automatic() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return automatic_;
+}
+
+void AbrController::SetMaxResolution(int width, int height) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_width_ = width;
+  max_height_ = height;
+}
+
+int AbrController::CapLocked() const {
+  const int last = static_cast<int>(ladder_.size()) - 1;
+  if (max_width_ <= 0 && max_height_ <= 0) return last;
+  // The ladder is in bandwidth order, which is size order for any sensible
+  // ladder.
+  for (int i = 0; i <= last; ++i) {
+    const AbrRendition& rendition = ladder_[i];
+    if (rendition.width <= 0 && rendition.height <= 0) return last;
+    if (rendition.width >= max_width_ && rendition.height >= max_height_) {
+      return i;
+    }
+  }
+  return last;
+}
+
+int64_t AbrController::throughput_bps() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return estimator_.estimate_bps();
+}
+
+std::string AbrRenditionName(int height, int64_t bandwidth) {
+  if (height > 0) return std::to_string(height) + "p";
+  return std::to_string(bandwidth / 1000) + "kbps";
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,212 @@
+#ifndef IVS_BROADCASTER_ABR_CONTROLLER_H_
+#define IVS_BROADCASTER_ABR_CONTROLLER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// One rendition of a stream, e.g. a variant of an HLS master playlist.
+struct AbrRendition {
+  // Shown to users, e.g. "720p".
+  std::string name;
+  // Peak bits per second.
+  int64_t bandwidth = 0;
+  int width = 0;
+  int height = 0;
+};
+
+// What a policy chooses from.
+struct AbrInput {
+  // Sorted by bandwidth, lowest first; never empty.
+  const std::vector<AbrRendition>* ladder = nullptr;
+  // Index of the rendition playing; -1 before the first choice.
+  int current = -1;
+  // Media downloaded but not played yet.
+  int64_t buffer_us = 0;
+  // Estimated bits per second the network delivers.
+  int64_t throughput_bps = 0;
+  int64_t segment_duration_us = 0;
+};
+
+struct AbrChoice {
+  int index = 0;
+  // Why, e.g. "throughput"; a string literal.
+  const char* reason = "";
+};
+
+// Picks the rendition of each segment. Called on one thread at a time.
+class AbrPolicy {
+ public:
+  virtual ~AbrPolicy() = default;
+  virtual const char* name() const = 0;
+  virtual AbrChoice Choose(const AbrInput& input) = 0;
+};
+
+using AbrPolicyFactory = std::function<std::unique_ptr<AbrPolicy>()>;
+
+// The highest rendition the estimated throughput sustains with a margin.
+class ThroughputAbrPolicy : public AbrPolicy {
+ public:
+  explicit ThroughputAbrPolicy(double safety = 0.9) : safety_(safety) {}
+
+  const char* name() const override { return "throughput"; }
+  AbrChoice Choose(const AbrInput& input) override;
+
+ private:
+  const double safety_;
+};
+
+struct BolaConfig {
+  // The buffer BOLA plans for: it picks the lowest rendition below
+  // |min_buffer_us| and the highest at |target_buffer_us|.
+  int64_t min_buffer_us = 4000000;
+  int64_t target_buffer_us = 12000000;
+  // Choices follow BOLA from this buffer until it falls below
+  // |throughput_below_us|, and the throughput estimate otherwise.
+  int64_t bola_above_us = 6000000;
+  int64_t throughput_below_us = 3000000;
+  double safety = 0.9;
+};
+
+// Buffer-based choice (BOLA, Spiteri et al.) once the buffer is deep
+// enough to ride out throughput dips, throughput-based choice while it is
+// not, as at startup or on a live stream held close to the edge. BOLA never
+// switches up past what the throughput sustains (BOLA-O), which keeps it
+// from oscillating when the top of the ladder is just out of reach.
+class BolaAbrPolicy : public AbrPolicy {
+ public:
+  explicit BolaAbrPolicy(const BolaConfig& config = BolaConfig());
+
+  const char* name() const override { return "bola"; }
+  AbrChoice Choose(const AbrInput& input) override;
+
+ private:
+  int ChooseByBuffer(const AbrInput& input) const;
+
+  const BolaConfig config_;
+  ThroughputAbrPolicy throughput_;
+  bool buffer_based_ = false;
+  int64_t last_buffer_us_ = 0;
+};
+
+struct AbrConfig {
+  // The estimate until enough has been downloaded to measure.
+  int64_t initial_bandwidth_bps = 1000000;
+  // Downloads smaller than this say more about latency than throughput and
+  // are not measured.
+  int64_t min_sample_bytes = 16 << 10;
+  // Bytes measured before the estimate replaces the initial one.
+  int64_t min_total_bytes = 128 << 10;
+  // Half-lives, in seconds of download time, of the fast and slow moving
+  // averages; the estimate is the lower of the two, so it drops at once
+  // and recovers slowly.
+  double fast_half_life_s = 2;
+  double slow_half_life_s = 5;
+};
+
+// Bits per second from download samples, as two exponentially weighted
+// moving averages weighted by download time.
+class ThroughputEstimator {
+ public:
+  explicit ThroughputEstimator(const AbrConfig& config);
+
+  void AddSample(int64_t bytes, int64_t duration_us);
+  int64_t estimate_bps() const;
+
+ private:
+  struct Average {
+    double alpha = 0;
+    double estimate = 0;
+    double total_weight = 0;
+
+    void Add(double weight, double value);
+    double Get() const;
+  };
+
+  const AbrConfig config_;
+  Average fast_;
+  Average slow_;
+  int64_t total_bytes_ = 0;
+};
+
+struct AbrDecision {
+  // Index into the ladder, and the one before; -1 before the first.
+  int index = 0;
+  int previous = -1;
+  AbrRendition rendition;
+  // The policy's reason, "resolution cap" when SetMaxResolution() held it
+  // down, or "manual" when pinned.
+  std::string reason;
+  bool automatic = true;
+  int64_t throughput_bps = 0;
+  int64_t buffer_us = 0;
+
+  bool switched() const { return index != previous; }
+};
+
+// Chooses the rendition of each segment of one stream: measures downloads,
+// asks a policy, and honours a rendition pinned by the user. Thread-safe.
+class AbrController {
+ public:
+  using DecisionCallback = std::function<void(const AbrDecision&)>;
+
+  AbrController(const AbrConfig& config, std::unique_ptr<AbrPolicy> policy);
+
+  AbrController(const AbrController&) = delete;
+  AbrController& operator=(const AbrController&) = delete;
+
+  // Called with every decision, outside the lock.
+  void SetCallback(DecisionCallback callback);
+
+  // Sorts |ladder| by bandwidth. A rendition pinned by name stays pinned.
+  void SetLadder(std::vector<AbrRendition> ladder);
+  std::vector<AbrRendition> ladder() const;
+
+  // |bytes| took |duration_us| to download, from the request.
+  void OnDownload(int64_t bytes, int64_t duration_us);
+
+  // Chooses the rendition of the next segment.
+  AbrDecision Decide(int64_t buffer_us, int64_t segment_duration_us);
+
+  // Pins the rendition called |name| and stops choosing automatically.
+  // Returns false if there is none.
+  bool SetManual(const std::string& name);
+  void SetAutomatic(bool automatic);
+  bool automatic() const;
+
+  // Caps automatic choices at the smallest rendition that covers |width| x
+  // |height|, or the largest if none does, e.g. for a stream shown in a
+  // small tile. Renditions of unknown size are not capped. 0 x 0 lifts the
+  // cap; a pinned rendition is not affected.
+  void SetMaxResolution(int width, int height);
+
+  int64_t throughput_bps() const;
+
+ private:
+  // The highest ladder index SetMaxResolution() allows.
+  int CapLocked() const;
+
+  mutable std::mutex mutex_;
+  ThroughputEstimator estimator_;
+  std::unique_ptr<AbrPolicy> policy_;
+  std::vector<AbrRendition> ladder_;
+  int current_ = -1;
+  bool automatic_ = true;
+  std::string manual_;
+  int max_width_ = 0;
+  int max_height_ = 0;
+  DecisionCallback callback_;
+};
+
+// A name for a rendition from its resolution, or from its bandwidth when
+// that is unknown, e.g. "720p" or "800kbps".
+std::string AbrRenditionName(int height, int64_t bandwidth);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_ABR_CONTROLLER_H_
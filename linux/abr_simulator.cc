@@ -0,0 +1,126 @@
+#include "abr_simulator.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Walks a trace that repeats forever.
+class TraceClock {
+ public:
+  explicit TraceClock(const std::vector<BandwidthSample>& trace)
+      : trace_(trace) {}
+
+  // Advances by |duration_us| without transferring anything.
+  void Wait(int64_t duration_us) {
+    while (duration_us > 0) {
+      const int64_t step = std::min(duration_us, left_us());
+      Advance(step);
+      duration_us -= step;
+    }
+  }
+
+  // Advances until |bits| have been transferred. Returns the time taken.
+  int64_t Transfer(double bits) {
+    int64_t taken = 0;
+    while (bits > 0) {
+      const double rate = trace_[index_].bits_per_second;
+      const int64_t left = left_us();
+      if (rate <= 0) {
+        Advance(left);
+        taken += left;
+        continue;
+      }
+      const double possible = rate * left / 1e6;
+      if (possible >= bits) {
+        const int64_t step = std::max<int64_t>(
+            1, static_cast<int64_t>(bits / rate * 1e6 + 0.5));
+        Advance(std::min(step, left));
+        taken += std::min(step, left);
+        break;
+      }
+      bits -= possible;
+      Advance(left);
+      taken += left;
+    }
+    return taken;
+  }
+
+ private:
+  int64_t left_us() const { return trace_[index_].duration_us - offset_us_; }
+
+  void Advance(int64_t duration_us) {
+    offset_us_ += duration_us;
+    if (offset_us_ >= trace_[index_].duration_us) {
+      offset_us_ = 0;
+      index_ = (index_ + 1) % trace_.size();
+    }
+  }
+
+  const std::vector<BandwidthSample>& trace_;
+  size_t index_ = 0;
+  int64_t offset_us_ = 0;
+};
+
+}  // namespace
+
+AbrSimulationResult SimulateAbr(const std::vector<AbrRendition>& ladder,
+                                const std::vector<BandwidthSample>& trace,
+                                const AbrSimulationConfig& config,
+                                std::unique_ptr<AbrPolicy> policy) {
+  AbrSimulationResult result;
+  if (ladder.empty() || trace.empty()) return result;
+  AbrController controller(config.abr, std::move(policy));
+  controller.SetLadder(ladder);
+  const std::vector<AbrRendition> sorted = controller.ladder();
+  TraceClock clock(trace);
+  int64_t now_us = 0;
+  int64_t buffer_us = 0;
+  bool playing = false;
+  double bitrate_sum = 0;
+  // Lets time pass: playback drains the buffer and stalls when it is empty.
+  auto elapse = [&](int64_t duration_us) {
+    now_us += duration_us;
+    if (!playing) return;
+    if (duration_us > buffer_us) {
+      result.rebuffer_us += duration_us - buffer_us;
+      buffer_us = 0;
+    } else {
+      buffer_us -= duration_us;
+    }
+  };
+  for (int i = 0; i < config.segments; ++i) {
+    const int64_t excess =
+        buffer_us + config.segment_duration_us - config.max_buffer_us;
+    if (playing && excess > 0) {
+      clock.Wait(excess);
+      elapse(excess);
+    }
+    const AbrDecision decision =
+        controller.Decide(buffer_us, config.segment_duration_us);
+    const int64_t bandwidth = sorted[decision.index].bandwidth;
+    const double bits = static_cast<double>(bandwidth) *
+                        config.segment_duration_us / 1e6;
+    clock.Wait(config.request_latency_us);
+    const int64_t transfer_us = clock.Transfer(bits);
+    const int64_t took_us = config.request_latency_us + transfer_us;
+    const bool stalled = playing && took_us > buffer_us;
+    elapse(took_us);
+    if (stalled) ++result.rebuffers;
+    controller.OnDownload(static_cast<int64_t>(bits / 8), took_us);
+    buffer_us += config.segment_duration_us;
+    if (!playing && buffer_us >= config.startup_buffer_us) {
+      playing = true;
+      result.startup_us = now_us;
+    }
+    if (decision.previous >= 0 && decision.switched()) ++result.switches;
+    bitrate_sum += bandwidth;
+    result.choices.push_back(decision.index);
+  }
+  result.average_bitrate = bitrate_sum / config.segments;
+  return result;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,55 @@
+#ifndef IVS_BROADCASTER_ABR_SIMULATOR_H_
+#define IVS_BROADCASTER_ABR_SIMULATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "abr_controller.h"
+
+namespace ivs_broadcaster {
+
+// A stretch of a bandwidth trace during which the network delivers a
+// constant rate.
+struct BandwidthSample {
+  int64_t duration_us = 0;
+  int64_t bits_per_second = 0;
+};
+
+struct AbrSimulationConfig {
+  int64_t segment_duration_us = 2000000;
+  int segments = 150;
+  // Playback starts once this much is buffered, and resumes after a stall
+  // once the segment it waited for has arrived.
+  int64_t startup_buffer_us = 2000000;
+  // Downloading pauses while this much is buffered, as a player bounded by
+  // its buffer or a live stream bounded by the edge would.
+  int64_t max_buffer_us = 20000000;
+  // Time to first byte of every request.
+  int64_t request_latency_us = 50000;
+  AbrConfig abr;
+};
+
+struct AbrSimulationResult {
+  int64_t startup_us = 0;
+  // Time stalled after startup, and how many stalls.
+  int64_t rebuffer_us = 0;
+  int rebuffers = 0;
+  // Mean bandwidth of the renditions played, per segment.
+  double average_bitrate = 0;
+  int switches = 0;
+  // The rendition of every segment.
+  std::vector<int> choices;
+};
+
+// Plays |config.segments| segments of a stream encoded at |ladder| over a
+// network following |trace|, which repeats when it runs out, with |policy|
+// choosing through an AbrController. Runs in simulated time.
+AbrSimulationResult SimulateAbr(const std::vector<AbrRendition>& ladder,
+                                const std::vector<BandwidthSample>& trace,
+                                const AbrSimulationConfig& config,
+                                std::unique_ptr<AbrPolicy> policy);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_ABR_SIMULATOR_H_
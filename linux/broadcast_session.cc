@@ -0,0 +1,469 @@
+#include "broadcast_session.h"
+
+#include <chrono>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavdevice/avdevice.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Frames waiting for the encoder. Anything older is stale for a live stream.
+constexpr size_t kMaxQueuedFrames = 4;
+
+constexpr int kMaxReconnectAttempts = 5;
+
+constexpr int64_t kStatsIntervalUs = 1000000;
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int InterruptCallback(void* opaque) {
+  return static_cast<std::atomic<bool>*>(opaque)->load() ? 1 : 0;
+}
+
+}  // namespace
+
+const char* BroadcastStateName(BroadcastState state) {
+  switch (state) {
+    case BroadcastState::kInvalid:
+      return "INVALID";
+    case BroadcastState::kDisconnected:
+      return "DISCONNECTED";
+    case BroadcastState::kConnecting:
+      return "CONNECTING";
+    case BroadcastState::kConnected:
+      return "CONNECTED";
+    case BroadcastState::kError:
+      return "ERROR";
+  }
+  return "INVALID";
+}
+
+// FLV over RTMP(S) to the ingest endpoint.
+class BroadcastSession::Muxer {
+ public:
+  ~Muxer() {
+    if (context_ != nullptr) {
+      if (header_written_) av_write_trailer(context_);
+      avio_closep(&context_->pb);
+      avformat_free_context(context_);
+    }
+    av_packet_free(&packet_);
+  }
+
+  bool Open(const std::string& url, const EncoderPreset& preset,
+            const std::vector<uint8_t>& codec_config,
+            std::atomic<bool>* interrupt) {
+    if (avformat_alloc_output_context2(&context_, nullptr, "flv",
+                                       url.c_str()) < 0) {
+      return false;
+    }
+    context_->interrupt_callback.callback = InterruptCallback;
+    context_->interrupt_callback.opaque = interrupt;
+
+    stream_ = avformat_new_stream(context_, nullptr);
+    if (stream_ == nullptr) return false;
+    AVCodecParameters* params = stream_->codecpar;
+    params->codec_type = AVMEDIA_TYPE_VIDEO;
+    params->codec_id = AV_CODEC_ID_H264;
+    params->width = preset.width;
+    params->height = preset.height;
+    params->bit_rate = preset.bitrate;
+    if (!codec_config.empty()) {
+      params->extradata = static_cast<uint8_t*>(av_mallocz(
+          codec_config.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+      if (params->extradata == nullptr) return false;
+      std::copy(codec_config.begin(), codec_config.end(), params->extradata);
+      params->extradata_size = static_cast<int>(codec_config.size());
+    }
+    stream_->time_base = AVRational{1, 1000};
+
+    // Timed metadata travels as FLV onTextData tags on a data stream.
+    text_stream_ = avformat_new_stream(context_, nullptr);
+    if (text_stream_ == nullptr) return false;
+    text_stream_->codecpar->codec_type = AVMEDIA_TYPE_DATA;
+    text_stream_->codecpar->codec_id = AV_CODEC_ID_TEXT;
+    text_stream_->time_base = AVRational{1, 1000};
+
+    if (avio_open2(&context_->pb, url.c_str(), AVIO_FLAG_WRITE,
+                   &context_->interrupt_callback, nullptr) < 0) {
+      return false;
+    }
+    if (avformat_write_header(context_, nullptr) < 0) return false;
+    header_written_ = true;
+    packet_ = av_packet_alloc();
+    return packet_ != nullptr;
+  }
+
+  bool Write(const EncodedPacket& packet, int64_t origin_us) {
+    if (av_new_packet(packet_, static_cast<int>(packet.data.size())) < 0) {
+      return false;
+    }
+    std::copy(packet.data.begin(), packet.data.end(), packet_->data);
+    const AVRational micros{1, 1000000};
+    packet_->pts = av_rescale_q(packet.pts_us - origin_us, micros,
+                                stream_->time_base);
+    packet_->dts = av_rescale_q(packet.dts_us - origin_us, micros,
+                                stream_->time_base);
+    packet_->stream_index = stream_->index;
+    if (packet.keyframe) packet_->flags |= AV_PKT_FLAG_KEY;
+    return av_interleaved_write_frame(context_, packet_) >= 0;
+  }
+
+  bool WriteMetadata(const MetadataPayload& payload, int64_t origin_us) {
+    if (av_new_packet(packet_, static_cast<int>(payload.data.size())) < 0) {
+      return false;
+    }
+    std::copy(payload.data.begin(), payload.data.end(), packet_->data);
+    packet_->pts = packet_->dts =
+        av_rescale_q(payload.pts_us - origin_us, AVRational{1, 1000000},
+                     text_stream_->time_base);
+    packet_->stream_index = text_stream_->index;
+    return av_interleaved_write_frame(context_, packet_) >= 0;
+  }
+
+ private:
+  AVFormatContext* context_ = nullptr;
+  AVStream* stream_ = nullptr;
+  AVStream* text_stream_ = nullptr;
+  AVPacket* packet_ = nullptr;
+  bool header_written_ = false;
+};
+
+BroadcastSession::BroadcastSession(EncoderRegistry* encoders,
+                                   Listener* listener)
+    : encoders_(encoders),
+      listener_(listener),
+      metadata_(std::make_shared<MetadataQueue>(MetadataQueueConfig(),
+                                                nullptr)) {}
+
+BroadcastSession::~BroadcastSession() { Stop(); }
+
+void BroadcastSession::StartPreview(const Config& config) {
+  Stop();
+  config_ = config;
+  stopping_ = false;
+  preset_ready_ = false;
+  capture_thread_ = std::thread(&BroadcastSession::CaptureLoop, this);
+  encode_thread_ = std::thread(&BroadcastSession::EncodeLoop, this);
+}
+
+// Timed metadata belongs to the broadcast it was sent during, so messages
+// pushed while not broadcasting are dropped rather than sent in a burst when
+// the next one starts.
+void BroadcastSession::ClearMetadata() {
+  std::lock_guard<std::mutex> lock(metadata_mutex_);
+  metadata_->Clear();
+}
+
+void BroadcastSession::StartBroadcast() {
+  ClearMetadata();
+  broadcast_requested_ = true;
+  queue_cv_.notify_all();
+}
+
+void BroadcastSession::StopBroadcast() {
+  broadcast_requested_ = false;
+  queue_cv_.notify_all();
+  ClearMetadata();
+}
+
+void BroadcastSession::Stop() {
+  ClearMetadata();
+  broadcast_requested_ = false;
+  stopping_ = true;
+  queue_cv_.notify_all();
+  if (capture_thread_.joinable()) capture_thread_.join();
+  if (encode_thread_.joinable()) encode_thread_.join();
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  queue_.clear();
+}
+
+void BroadcastSession::ConfigureMetadata(
+    const MetadataQueueConfig& config,
+    std::shared_ptr<const MetadataCompressor> compressor) {
+  auto queue = std::make_shared<MetadataQueue>(config, std::move(compressor));
+  std::lock_guard<std::mutex> lock(metadata_mutex_);
+  queue->MoveFrom(metadata_.get());
+  metadata_ = std::move(queue);
+}
+
+bool BroadcastSession::SendTimedMetadata(const std::string& message) {
+  std::lock_guard<std::mutex> lock(metadata_mutex_);
+  return metadata_->Push(message, NowUs());
+}
+
+MetadataQueueStats BroadcastSession::metadata_stats() const {
+  std::lock_guard<std::mutex> lock(metadata_mutex_);
+  return metadata_->stats();
+}
+
+void BroadcastSession::SetPreview(PreviewRenderer* preview) {
+  preview_ = preview;
+}
+
+void BroadcastSession::CaptureLoop() {
+  while (!encoders_->WaitForCalibration(std::chrono::milliseconds(100))) {
+    if (stopping_) return;
+  }
+  const std::string preset_name = encoders_->ResolvePreset(
+      config_.quality, config_.enforce_encoder_limit);
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    preset_ = *FindEncoderPreset(preset_name);
+    FrameGovernorConfig governor_config;
+    governor_config.source_fps = preset_.fps;
+    governor_ = std::make_unique<FrameGovernor>(governor_config);
+    governor_->set_window_callback([this](const FrameGovernorStats& stats) {
+      listener_->OnGovernorStats(stats);
+    });
+    governor_->set_level_changed_callback(
+        [this](const FrameGovernorStats& stats) {
+          listener_->OnFrameRateChanged(stats);
+        });
+    preset_ready_ = true;
+  }
+  queue_cv_.notify_all();
+
+  static std::once_flag devices_registered;
+  std::call_once(devices_registered, [] { avdevice_register_all(); });
+
+  AVFormatContext* input = avformat_alloc_context();
+  input->interrupt_callback.callback = InterruptCallback;
+  input->interrupt_callback.opaque = &stopping_;
+  AVDictionary* options = nullptr;
+  const std::string size =
+      std::to_string(preset_.width) + "x" + std::to_string(preset_.height);
+  av_dict_set(&options, "video_size", size.c_str(), 0);
+  av_dict_set(&options, "framerate", std::to_string(preset_.fps).c_str(), 0);
+  int status = avformat_open_input(&input, config_.camera_device.c_str(),
+                                   av_find_input_format("video4linux2"),
+                                   &options);
+  av_dict_free(&options);
+  if (status < 0) {
+    listener_->OnError("Unable to open camera " + config_.camera_device);
+    return;
+  }
+
+  AVCodecContext* decoder = nullptr;
+  AVPacket* packet = av_packet_alloc();
+  AVFrame* raw = av_frame_alloc();
+  SwsContext* scaler = nullptr;
+  const AVCodec* codec = nullptr;
+  int stream_index = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                         &codec, 0);
+  if (stream_index >= 0) {
+    decoder = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(decoder,
+                                  input->streams[stream_index]->codecpar);
+    if (avcodec_open2(decoder, codec, nullptr) < 0) {
+      avcodec_free_context(&decoder);
+    }
+  }
+  if (decoder == nullptr) {
+    listener_->OnError("Unsupported camera format on " +
+                       config_.camera_device);
+  }
+
+  while (decoder != nullptr && !stopping_ &&
+         av_read_frame(input, packet) >= 0) {
+    if (packet->stream_index == stream_index &&
+        avcodec_send_packet(decoder, packet) >= 0) {
+      while (avcodec_receive_frame(decoder, raw) >= 0) {
+        const int64_t captured_us = NowUs();
+        scaler = sws_getCachedContext(
+            scaler, raw->width, raw->height,
+            static_cast<AVPixelFormat>(raw->format), preset_.width,
+            preset_.height, AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr,
+            nullptr, nullptr);
+        VideoFrame frame;
+        frame.Allocate(preset_.width, preset_.height);
+        frame.pts_us = captured_us;
+        uint8_t* planes[] = {frame.y(), frame.u(), frame.v()};
+        int strides[] = {frame.y_stride(), frame.uv_stride(),
+                         frame.uv_stride()};
+        sws_scale(scaler, raw->data, raw->linesize, 0, raw->height, planes,
+                  strides);
+        av_frame_unref(raw);
+        governor_->ReportStage(PipelineStage::kCapture,
+                               NowUs() - captured_us);
+        if (PreviewRenderer* preview = preview_.load()) {
+          preview->Submit(frame);
+        }
+
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (queue_.size() >= kMaxQueuedFrames) queue_.pop_front();
+        queue_.push_back(std::move(frame));
+        queue_cv_.notify_one();
+      }
+    }
+    av_packet_unref(packet);
+  }
+
+  sws_freeContext(scaler);
+  av_frame_free(&raw);
+  av_packet_free(&packet);
+  avcodec_free_context(&decoder);
+  avformat_close_input(&input);
+}
+
+void BroadcastSession::EncodeLoop() {
+  int64_t origin_us = -1;
+  int reconnect_attempts = 0;
+  std::vector<EncodedPacket> packets;
+  std::unique_ptr<StaticFrameDetector> detector;
+  StaticFrameStats reported_static;
+  EncodeStats stats;
+  int64_t encode_total_us = 0;
+  int64_t stats_start_us = -1;
+  std::vector<MetadataPayload> metadata;
+  for (;;) {
+    VideoFrame frame;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cv_.wait(lock, [this] {
+        return stopping_ ||
+               (preset_ready_ && broadcast_requested_ != (muxer_ != nullptr)) ||
+               (muxer_ && !queue_.empty());
+      });
+      if (stopping_) break;
+      if (!queue_.empty() && muxer_) {
+        governor_->ReportQueueDepth(queue_.size());
+        frame = std::move(queue_.front());
+        queue_.pop_front();
+      }
+    }
+
+    if (broadcast_requested_ && !muxer_) {
+      if (!OpenBroadcast()) {
+        CloseBroadcast();
+        if (!config_.auto_reconnect ||
+            ++reconnect_attempts > kMaxReconnectAttempts) {
+          broadcast_requested_ = false;
+          SetState(BroadcastState::kError);
+        } else {
+          std::unique_lock<std::mutex> lock(queue_mutex_);
+          queue_cv_.wait_for(
+              lock, std::chrono::seconds(1 << (reconnect_attempts - 1)),
+              [this] { return stopping_.load(); });
+        }
+        continue;
+      }
+      reconnect_attempts = 0;
+      origin_us = -1;
+      StaticFrameDetectorConfig detector_config;
+      detector_config.min_refresh_fps = config_.min_refresh_fps;
+      detector = std::make_unique<StaticFrameDetector>(detector_config);
+      reported_static = StaticFrameStats();
+      stats = EncodeStats();
+      encode_total_us = 0;
+      stats_start_us = -1;
+      continue;
+    }
+    if (!broadcast_requested_ && muxer_) {
+      CloseBroadcast();
+      SetState(BroadcastState::kDisconnected);
+      continue;
+    }
+    if (frame.data.empty()) continue;
+
+    int64_t now_us = NowUs();
+    governor_->ReportStage(PipelineStage::kQueue, now_us - frame.pts_us);
+    if (!governor_->Admit(frame.pts_us, &frame.pts_us)) continue;
+
+    if (stats_start_us < 0) stats_start_us = now_us;
+    if (now_us - stats_start_us >= kStatsIntervalUs) {
+      const StaticFrameStats& totals = detector->stats();
+      stats.frames_skipped =
+          totals.frames_skipped - reported_static.frames_skipped;
+      stats.compare_time_ms =
+          (totals.compare_us - reported_static.compare_us) / 1000.0;
+      if (stats.frames_encoded > 0) {
+        stats.encode_time_saved_ms = stats.frames_skipped * encode_total_us /
+                                     1000.0 / stats.frames_encoded;
+      }
+      listener_->OnEncodeStats(stats);
+      reported_static = totals;
+      stats = EncodeStats();
+      encode_total_us = 0;
+      stats_start_us = now_us;
+    }
+    if (detector->ShouldSkip(frame)) continue;
+
+    if (origin_us < 0) origin_us = frame.pts_us;
+    packets.clear();
+    now_us = NowUs();
+    bool ok = encoder_->Encode(frame, &packets);
+    const int64_t encoded_us = NowUs();
+    governor_->ReportStage(PipelineStage::kEncode, encoded_us - now_us);
+    encode_total_us += encoded_us - now_us;
+    ++stats.frames_encoded;
+    for (const auto& packet : packets) {
+      ok = ok && muxer_->Write(packet, origin_us);
+    }
+    metadata.clear();
+    {
+      std::unique_lock<std::mutex> lock(metadata_mutex_);
+      std::shared_ptr<MetadataQueue> queue = metadata_;
+      lock.unlock();
+      queue->Poll(frame.pts_us, &metadata);
+    }
+    for (const auto& payload : metadata) {
+      ok = ok && muxer_->WriteMetadata(payload, origin_us);
+    }
+    governor_->ReportStage(PipelineStage::kMux, NowUs() - encoded_us);
+    if (!ok) {
+      CloseBroadcast();
+      SetState(config_.auto_reconnect ? BroadcastState::kConnecting
+                                      : BroadcastState::kError);
+      if (!config_.auto_reconnect) broadcast_requested_ = false;
+    }
+  }
+  CloseBroadcast();
+}
+
+bool BroadcastSession::OpenBroadcast() {
+  SetState(BroadcastState::kConnecting);
+  std::string backend;
+  encoder_ = encoders_->Open(preset_, &backend);
+  if (!encoder_) {
+    listener_->OnError("No H.264 encoder could be opened");
+    return false;
+  }
+  listener_->OnPresetSelected(preset_.name, backend);
+
+  std::string url = config_.ingest_url;
+  if (!url.empty() && url.back() != '/') url += '/';
+  url += config_.stream_key;
+  static std::once_flag network_initialized;
+  std::call_once(network_initialized, [] { avformat_network_init(); });
+  muxer_ = std::make_unique<Muxer>();
+  if (!muxer_->Open(url, preset_, encoder_->codec_config(), &stopping_)) {
+    listener_->OnError("Unable to connect to " + config_.ingest_url);
+    return false;
+  }
+  SetState(BroadcastState::kConnected);
+  return true;
+}
+
+void BroadcastSession::CloseBroadcast() {
+  muxer_.reset();
+  encoder_.reset();
+}
+
+void BroadcastSession::SetState(BroadcastState state) {
+  if (state == state_) return;
+  state_ = state;
+  listener_->OnStateChanged(state);
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,161 @@
+#ifndef IVS_BROADCASTER_BROADCAST_SESSION_H_
+#define IVS_BROADCASTER_BROADCAST_SESSION_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "encoder_registry.h"
+#include "frame_governor.h"
+#include "metadata_queue.h"
+#include "preview_renderer.h"
+#include "static_frame_detector.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+// Mirrors BroadCastState on the Dart side.
+enum class BroadcastState {
+  kInvalid,
+  kDisconnected,
+  kConnecting,
+  kConnected,
+  kError,
+};
+
+// The string the Dart side parses for |state| ("CONNECTED", ...).
+const char* BroadcastStateName(BroadcastState state);
+
+// Encoder work over the last stats period.
+struct EncodeStats {
+  uint64_t frames_encoded = 0;
+  // Static frames that were not sent to the encoder.
+  uint64_t frames_skipped = 0;
+  // Time spent detecting static frames.
+  double compare_time_ms = 0;
+  // Encode time the skipped frames would have cost at the mean encode time.
+  double encode_time_saved_ms = 0;
+};
+
+// Captures from a V4L2 camera, encodes with the backend picked by the
+// EncoderRegistry and publishes FLV over RTMP(S) to the IVS ingest endpoint.
+//
+// Capture and encoding run on their own threads, connected by a short queue
+// that drops the oldest frame when the encoder falls behind. A FrameGovernor
+// lowers the encoded frame rate before that happens, and frames identical to
+// the last encoded one are skipped down to a minimum refresh rate. Listener
+// callbacks arrive on those threads.
+class BroadcastSession {
+ public:
+  class Listener {
+   public:
+    virtual ~Listener() = default;
+    virtual void OnStateChanged(BroadcastState state) = 0;
+    // The preset actually used, after the registry applied its limits.
+    virtual void OnPresetSelected(const std::string& preset,
+                                  const std::string& backend) = 0;
+    virtual void OnError(const std::string& message) = 0;
+    // Frame governor statistics at the end of every measurement window.
+    virtual void OnGovernorStats(const FrameGovernorStats& stats) = 0;
+    // The frame governor changed the encoded frame rate. Follows the
+    // OnGovernorStats() call of the same window.
+    virtual void OnFrameRateChanged(const FrameGovernorStats& stats) = 0;
+    // Periodic encoder statistics while broadcasting.
+    virtual void OnEncodeStats(const EncodeStats& stats) = 0;
+  };
+
+  struct Config {
+    std::string ingest_url;
+    std::string stream_key;
+    std::string quality = "720";
+    // Lower |quality| to the preset this machine sustains in real time
+    // instead of only recommending it.
+    bool enforce_encoder_limit = true;
+    bool auto_reconnect = false;
+    // Static frames are still encoded at this rate. Zero encodes every frame.
+    double min_refresh_fps = 1.0;
+    std::string camera_device = "/dev/video0";
+  };
+
+  BroadcastSession(EncoderRegistry* encoders, Listener* listener);
+  ~BroadcastSession();
+
+  BroadcastSession(const BroadcastSession&) = delete;
+  BroadcastSession& operator=(const BroadcastSession&) = delete;
+
+  // Opens the camera and starts capturing. Waits for encoder calibration on
+  // the capture thread, never on the caller's.
+  void StartPreview(const Config& config);
+
+  // Starts publishing captured frames.
+  void StartBroadcast();
+
+  // Stops publishing but keeps the camera open.
+  void StopBroadcast();
+
+  // Stops publishing and closes the camera.
+  void Stop();
+
+  // Replaces the timed-metadata queue, carrying over the messages still
+  // pending. |compressor| may be null. May be called from any thread.
+  void ConfigureMetadata(
+      const MetadataQueueConfig& config,
+      std::shared_ptr<const MetadataCompressor> compressor);
+
+  // Queues a timed-metadata message. It is batched, rate-limited and muxed
+  // alongside the video frame encoded when it becomes sendable. Returns
+  // false if the queue rejected it. May be called from any thread.
+  bool SendTimedMetadata(const std::string& message);
+
+  MetadataQueueStats metadata_stats() const;
+
+  // Also hands every captured frame to |preview|; nullptr stops that.
+  // |preview| must outlive the session.
+  void SetPreview(PreviewRenderer* preview);
+
+ private:
+  class Muxer;
+
+  void CaptureLoop();
+  void EncodeLoop();
+  bool OpenBroadcast();
+  void CloseBroadcast();
+  void ClearMetadata();
+  void SetState(BroadcastState state);
+
+  EncoderRegistry* encoders_;
+  Listener* listener_;
+  Config config_;
+  EncoderPreset preset_{};
+
+  std::thread capture_thread_;
+  std::thread encode_thread_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<bool> broadcast_requested_{false};
+  std::atomic<PreviewRenderer*> preview_{nullptr};
+
+  // Swapped by ConfigureMetadata(); the encode thread takes a reference per
+  // frame. Pushes hold the lock so none lands in a queue being replaced.
+  mutable std::mutex metadata_mutex_;
+  std::shared_ptr<MetadataQueue> metadata_;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<VideoFrame> queue_;
+  bool preset_ready_ = false;
+  // Created with the preset, before |preset_ready_| is set.
+  std::unique_ptr<FrameGovernor> governor_;
+
+  // Owned by the encode thread.
+  std::unique_ptr<EncoderSession> encoder_;
+  std::unique_ptr<Muxer> muxer_;
+  BroadcastState state_ = BroadcastState::kDisconnected;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_BROADCAST_SESSION_H_
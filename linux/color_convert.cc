@@ -0,0 +1,163 @@
+#include "color_convert.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// BT.601 limited-range coefficients scaled by 64.
+constexpr int kYScale = 74;   // 1.164
+constexpr int kVToR = 102;    // 1.596
+constexpr int kUToG = 25;     // 0.391
+constexpr int kVToG = 52;     // 0.813
+constexpr int kUToB = 129;    // 2.018
+constexpr int kRound = 32;
+
+// Mirrors the SIMD lanes: 16-bit saturating sums, then a shift and a clamp.
+int Saturate16(int value) { return std::min(32767, std::max(-32768, value)); }
+
+uint8_t Clamp8(int value) {
+  return static_cast<uint8_t>(std::min(255, std::max(0, value >> 6)));
+}
+
+void RowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, int from,
+               int width, uint8_t* rgba) {
+  for (int x = from; x < width; ++x) {
+    const int luma = (y[x] - 16) * kYScale + kRound;
+    const int cb = u[x / 2] - 128;
+    const int cr = v[x / 2] - 128;
+    uint8_t* pixel = rgba + 4 * x;
+    pixel[0] = Clamp8(Saturate16(luma + cr * kVToR));
+    pixel[1] = Clamp8(luma - cb * kUToG - cr * kVToG);
+    pixel[2] = Clamp8(Saturate16(luma + cb * kUToB));
+    pixel[3] = 255;
+  }
+}
+
+#if defined(__SSE2__)
+
+// Converts 16 pixels; |y| holds 16 luma bytes, |u| and |v| 8 chroma bytes.
+void Row16(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+           uint8_t* rgba) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i luma8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y));
+  const __m128i cb8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u));
+  const __m128i cr8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v));
+  const __m128i bias = _mm_set1_epi16(128);
+  const __m128i cb = _mm_sub_epi16(_mm_unpacklo_epi8(cb8, zero), bias);
+  const __m128i cr = _mm_sub_epi16(_mm_unpacklo_epi8(cr8, zero), bias);
+
+  __m128i out[3][2];
+  for (int half = 0; half < 2; ++half) {
+    const __m128i luma = _mm_add_epi16(
+        _mm_mullo_epi16(
+            _mm_sub_epi16(half == 0 ? _mm_unpacklo_epi8(luma8, zero)
+                                    : _mm_unpackhi_epi8(luma8, zero),
+                          _mm_set1_epi16(16)),
+            _mm_set1_epi16(kYScale)),
+        _mm_set1_epi16(kRound));
+    // Each chroma sample covers two neighbouring pixels.
+    const __m128i pair_cb = half == 0 ? _mm_unpacklo_epi16(cb, cb)
+                                      : _mm_unpackhi_epi16(cb, cb);
+    const __m128i pair_cr = half == 0 ? _mm_unpacklo_epi16(cr, cr)
+                                      : _mm_unpackhi_epi16(cr, cr);
+    out[0][half] = _mm_srai_epi16(
+        _mm_adds_epi16(luma,
+                       _mm_mullo_epi16(pair_cr, _mm_set1_epi16(kVToR))),
+        6);
+    out[1][half] = _mm_srai_epi16(
+        _mm_subs_epi16(
+            _mm_subs_epi16(luma,
+                           _mm_mullo_epi16(pair_cb, _mm_set1_epi16(kUToG))),
+            _mm_mullo_epi16(pair_cr, _mm_set1_epi16(kVToG))),
+        6);
+    out[2][half] = _mm_srai_epi16(
+        _mm_adds_epi16(luma,
+                       _mm_mullo_epi16(pair_cb, _mm_set1_epi16(kUToB))),
+        6);
+  }
+  const __m128i r = _mm_packus_epi16(out[0][0], out[0][1]);
+  const __m128i g = _mm_packus_epi16(out[1][0], out[1][1]);
+  const __m128i b = _mm_packus_epi16(out[2][0], out[2][1]);
+  const __m128i a = _mm_set1_epi8(static_cast<char>(0xff));
+  const __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+  const __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+  const __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+  const __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+  __m128i* dst = reinterpret_cast<__m128i*>(rgba);
+  _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+  _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+  _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+  _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+}
+
+#elif defined(__aarch64__)
+
+void Row16(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+           uint8_t* rgba) {
+  const uint8x16_t luma8 = vld1q_u8(y);
+  const int16x8_t bias = vdupq_n_s16(128);
+  const int16x8_t cb =
+      vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u))), bias);
+  const int16x8_t cr =
+      vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v))), bias);
+  // Each chroma sample covers two neighbouring pixels.
+  const int16x8_t pair_cb[2] = {vzip1q_s16(cb, cb), vzip2q_s16(cb, cb)};
+  const int16x8_t pair_cr[2] = {vzip1q_s16(cr, cr), vzip2q_s16(cr, cr)};
+  const uint8x8_t luma_half[2] = {vget_low_u8(luma8), vget_high_u8(luma8)};
+
+  uint8x8_t out[3][2];
+  for (int half = 0; half < 2; ++half) {
+    const int16x8_t luma = vaddq_s16(
+        vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(luma_half[half])),
+                              vdupq_n_s16(16)),
+                    kYScale),
+        vdupq_n_s16(kRound));
+    out[0][half] = vqmovun_s16(vshrq_n_s16(
+        vqaddq_s16(luma, vmulq_n_s16(pair_cr[half], kVToR)), 6));
+    out[1][half] = vqmovun_s16(vshrq_n_s16(
+        vqsubq_s16(vqsubq_s16(luma, vmulq_n_s16(pair_cb[half], kUToG)),
+                   vmulq_n_s16(pair_cr[half], kVToG)),
+        6));
+    out[2][half] = vqmovun_s16(vshrq_n_s16(
+        vqaddq_s16(luma, vmulq_n_s16(pair_cb[half], kUToB)), 6));
+  }
+  uint8x16x4_t pixels;
+  pixels.val[0] = vcombine_u8(out[0][0], out[0][1]);
+  pixels.val[1] = vcombine_u8(out[1][0], out[1][1]);
+  pixels.val[2] = vcombine_u8(out[2][0], out[2][1]);
+  pixels.val[3] = vdupq_n_u8(255);
+  vst4q_u8(rgba, pixels);
+}
+
+#endif
+
+}  // namespace
+
+void I420ToRgba(const uint8_t* y, int y_stride, const uint8_t* u,
+                const uint8_t* v, int uv_stride, int width, int height,
+                uint8_t* rgba, int rgba_stride) {
+  for (int row = 0; row < height; ++row) {
+    const uint8_t* y_row = y + static_cast<size_t>(row) * y_stride;
+    const uint8_t* u_row = u + static_cast<size_t>(row / 2) * uv_stride;
+    const uint8_t* v_row = v + static_cast<size_t>(row / 2) * uv_stride;
+    uint8_t* out = rgba + static_cast<size_t>(row) * rgba_stride;
+    int x = 0;
+#if defined(__SSE2__) || defined(__aarch64__)
+    for (; x + 16 <= width; x += 16) {
+      Row16(y_row + x, u_row + x / 2, v_row + x / 2, out + 4 * x);
+    }
+#endif
+    RowScalar(y_row, u_row, v_row, x, width, out);
+  }
+}
+
+}  // namespace ivs_broadcaster
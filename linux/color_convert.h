@@ -0,0 +1,20 @@
+#ifndef IVS_BROADCASTER_COLOR_CONVERT_H_
+#define IVS_BROADCASTER_COLOR_CONVERT_H_
+
+#include <cstdint>
+
+namespace ivs_broadcaster {
+
+// Converts I420 to RGBA (BT.601, limited range, alpha 255) for display.
+//
+// Rows are converted 16 pixels at a time with SSE2 on x86-64 or NEON on
+// AArch64, in 16-bit fixed point with 6 fractional bits; the scalar tail and
+// fallback use the same arithmetic, so every path produces identical bytes.
+// |width| may be odd; chroma is sampled at x / 2, y / 2.
+void I420ToRgba(const uint8_t* y, int y_stride, const uint8_t* u,
+                const uint8_t* v, int uv_stride, int width, int height,
+                uint8_t* rgba, int rgba_stride);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_COLOR_CONVERT_H_
@@ -0,0 +1,100 @@
+#include "command_executor.h"
+
+#include <algorithm>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+std::chrono::microseconds Micros(CommandExecutor::Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+
+}  // namespace
+
+CommandExecutor::CommandExecutor(int threads) {
+  for (int i = 0; i < std::max(1, threads); ++i) {
+    workers_.emplace_back(&CommandExecutor::WorkerLoop, this);
+  }
+}
+
+CommandExecutor::~CommandExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+bool CommandExecutor::Post(const std::string& lane, const std::string& method,
+                           std::function<void()> work) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) return false;
+    Lane& queue = lanes_[lane];
+    queue.commands.push_back(Command{method, std::move(work), Clock::now()});
+    ++pending_;
+    if (queue.running || queue.commands.size() > 1) return true;
+    ready_.push_back(lane);
+  }
+  wake_.notify_one();
+  return true;
+}
+
+std::map<std::string, CommandStats> CommandExecutor::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+size_t CommandExecutor::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_;
+}
+
+void CommandExecutor::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+    if (ready_.empty()) {
+      // Stopping, and nothing is runnable. Lanes still held by another
+      // worker are finished by that worker.
+      return;
+    }
+    const std::string name = std::move(ready_.front());
+    ready_.pop_front();
+    Lane& lane = lanes_[name];
+    lane.running = true;
+    Command command = std::move(lane.commands.front());
+    lane.commands.pop_front();
+
+    lock.unlock();
+    const Clock::time_point started = Clock::now();
+    command.work();
+    const Clock::time_point finished = Clock::now();
+    // Release captures outside the lock; they may own large buffers.
+    command.work = nullptr;
+    lock.lock();
+
+    CommandStats& stats = stats_[command.method];
+    ++stats.count;
+    const std::chrono::microseconds wait = Micros(started - command.posted);
+    const std::chrono::microseconds run = Micros(finished - started);
+    stats.total_wait += wait;
+    stats.max_wait = std::max(stats.max_wait, wait);
+    stats.total_run += run;
+    stats.max_run = std::max(stats.max_run, run);
+    --pending_;
+
+    Lane& done = lanes_[name];
+    done.running = false;
+    if (done.commands.empty()) {
+      lanes_.erase(name);
+    } else {
+      ready_.push_back(name);
+      wake_.notify_one();
+    }
+  }
+}
+
+}  // namespace ivs_broadcaster
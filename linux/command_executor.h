@@ -0,0 +1,103 @@
+#ifndef IVS_BROADCASTER_COMMAND_EXECUTOR_H_
+#define IVS_BROADCASTER_COMMAND_EXECUTOR_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// Timing of every command run under one method name.
+struct CommandStats {
+  uint64_t count = 0;
+  // Time between Post() and the command starting.
+  std::chrono::microseconds total_wait{0};
+  std::chrono::microseconds max_wait{0};
+  // Time the command itself ran.
+  std::chrono::microseconds total_run{0};
+  std::chrono::microseconds max_run{0};
+};
+
+// Runs method-call work off the platform thread.
+//
+// Commands are posted to a named lane, e.g. the camera device they touch.
+// Commands in one lane run one at a time in the order they were posted;
+// different lanes run in parallel on a small pool of threads. A lane is
+// never bound to a thread, so an idle lane costs nothing.
+class CommandExecutor {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit CommandExecutor(int threads);
+  // Runs every command already posted, then joins the pool.
+  ~CommandExecutor();
+
+  CommandExecutor(const CommandExecutor&) = delete;
+  CommandExecutor& operator=(const CommandExecutor&) = delete;
+
+  // Queues |work| on |lane|. |method| names it in stats(). Returns false,
+  // without running it, once the executor is shutting down. |work| must not
+  // throw; use Submit() for work that may.
+  bool Post(const std::string& lane, const std::string& method,
+            std::function<void()> work);
+
+  // Like Post(), returning |work|'s result, or its exception, through a
+  // future. The future is broken if the command was refused.
+  template <typename Fn>
+  auto Submit(const std::string& lane, const std::string& method, Fn&& work)
+      -> std::future<std::invoke_result_t<Fn>> {
+    using Result = std::invoke_result_t<Fn>;
+    auto task =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(work));
+    std::future<Result> future = task->get_future();
+    Post(lane, method, [task] { (*task)(); });
+    return future;
+  }
+
+  // Per-method timings, keyed by method name.
+  std::map<std::string, CommandStats> stats() const;
+
+  // Commands queued or running.
+  size_t pending() const;
+
+ private:
+  struct Command {
+    std::string method;
+    std::function<void()> work;
+    Clock::time_point posted;
+  };
+
+  struct Lane {
+    std::deque<Command> commands;
+    // A worker is running this lane's head; others leave it alone.
+    bool running = false;
+  };
+
+  void WorkerLoop();
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::unordered_map<std::string, Lane> lanes_;
+  // Lanes with queued commands and no worker, oldest first.
+  std::deque<std::string> ready_;
+  size_t pending_ = 0;
+  std::map<std::string, CommandStats> stats_;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_COMMAND_EXECUTOR_H_
@@ -0,0 +1,205 @@
+#include "cue_index.h"
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Orders the tree; equal keys go right, after the cues already there.
+bool Before(const MetadataCue& a, const MetadataCue& b) {
+  return std::tie(a.start_us, a.end_us) < std::tie(b.start_us, b.end_us);
+}
+
+}  // namespace
+
+CueIndex::CueIndex(size_t max_cues)
+    : max_cues_(std::max<size_t>(max_cues, 1)) {}
+
+bool CueIndex::Add(const MetadataCue& cue) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ContainsLocked(cue)) {
+    ++stats_.duplicates;
+    return false;
+  }
+  int added;
+  if (!free_.empty()) {
+    added = free_.back();
+    free_.pop_back();
+    nodes_[added] = Node();
+  } else {
+    added = static_cast<int>(nodes_.size());
+    nodes_.emplace_back();
+  }
+  nodes_[added].cue = cue;
+  nodes_[added].max_end_us = cue.end_us;
+  root_ = Insert(root_, added);
+  ++stats_.cues;
+  while (stats_.cues > max_cues_) {
+    root_ = EraseFirst(root_);
+    --stats_.cues;
+    ++stats_.evictions;
+  }
+  return true;
+}
+
+std::vector<MetadataCue> CueIndex::Overlapping(int64_t from_us,
+                                               int64_t to_us) const {
+  std::vector<MetadataCue> cues;
+  std::lock_guard<std::mutex> lock(mutex_);
+  CollectOverlapping(root_, from_us, to_us, &cues);
+  return cues;
+}
+
+std::vector<MetadataCue> CueIndex::ActiveAt(int64_t time_us) const {
+  std::vector<MetadataCue> cues = Overlapping(time_us, time_us);
+  // A cue ending at |time_us| is over, unless it is an instant.
+  cues.erase(std::remove_if(cues.begin(), cues.end(),
+                            [time_us](const MetadataCue& cue) {
+                              return cue.end_us == time_us &&
+                                     cue.start_us != cue.end_us;
+                            }),
+             cues.end());
+  return cues;
+}
+
+std::vector<MetadataCue> CueIndex::Starting(int64_t after_us,
+                                            int64_t until_us) const {
+  std::vector<MetadataCue> cues;
+  std::lock_guard<std::mutex> lock(mutex_);
+  CollectStarting(root_, after_us, until_us, &cues);
+  return cues;
+}
+
+void CueIndex::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  nodes_.clear();
+  free_.clear();
+  root_ = -1;
+  stats_.cues = 0;
+}
+
+CueIndexStats CueIndex::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+int CueIndex::Insert(int node, int added) {
+  if (node < 0) return added;
+  if (Before(nodes_[added].cue, nodes_[node].cue)) {
+    nodes_[node].left = Insert(nodes_[node].left, added);
+  } else {
+    nodes_[node].right = Insert(nodes_[node].right, added);
+  }
+  return Balance(node);
+}
+
+int CueIndex::EraseFirst(int node) {
+  if (nodes_[node].left < 0) {
+    const int right = nodes_[node].right;
+    nodes_[node].cue.text.clear();
+    free_.push_back(node);
+    return right;
+  }
+  nodes_[node].left = EraseFirst(nodes_[node].left);
+  return Balance(node);
+}
+
+int CueIndex::Balance(int node) {
+  Update(node);
+  const int skew = height(nodes_[node].left) - height(nodes_[node].right);
+  if (skew > 1) {
+    const int left = nodes_[node].left;
+    if (height(nodes_[left].left) < height(nodes_[left].right)) {
+      nodes_[node].left = RotateLeft(left);
+    }
+    return RotateRight(node);
+  }
+  if (skew < -1) {
+    const int right = nodes_[node].right;
+    if (height(nodes_[right].right) < height(nodes_[right].left)) {
+      nodes_[node].right = RotateRight(right);
+    }
+    return RotateLeft(node);
+  }
+  return node;
+}
+
+int CueIndex::RotateLeft(int node) {
+  const int right = nodes_[node].right;
+  nodes_[node].right = nodes_[right].left;
+  nodes_[right].left = node;
+  Update(node);
+  Update(right);
+  return right;
+}
+
+int CueIndex::RotateRight(int node) {
+  const int left = nodes_[node].left;
+  nodes_[node].left = nodes_[left].right;
+  nodes_[left].right = node;
+  Update(node);
+  Update(left);
+  return left;
+}
+
+void CueIndex::Update(int node) {
+  Node& n = nodes_[node];
+  n.height = 1 + std::max(height(n.left), height(n.right));
+  n.max_end_us = n.cue.end_us;
+  if (n.left >= 0) {
+    n.max_end_us = std::max(n.max_end_us, nodes_[n.left].max_end_us);
+  }
+  if (n.right >= 0) {
+    n.max_end_us = std::max(n.max_end_us, nodes_[n.right].max_end_us);
+  }
+}
+
+bool CueIndex::ContainsLocked(const MetadataCue& cue) const {
+  int node = root_;
+  while (node >= 0) {
+    const Node& n = nodes_[node];
+    if (Before(cue, n.cue)) {
+      node = n.left;
+    } else if (Before(n.cue, cue)) {
+      node = n.right;
+    } else {
+      // Cues with the same times may sit on either side after rotations.
+      std::vector<MetadataCue> same;
+      CollectOverlapping(node, cue.start_us, cue.start_us, &same);
+      return std::find(same.begin(), same.end(), cue) != same.end();
+    }
+  }
+  return false;
+}
+
+void CueIndex::CollectOverlapping(int node, int64_t from_us, int64_t to_us,
+                                  std::vector<MetadataCue>* cues) const {
+  // Nothing below ends late enough.
+  if (node < 0 || nodes_[node].max_end_us < from_us) return;
+  const Node& n = nodes_[node];
+  CollectOverlapping(n.left, from_us, to_us, cues);
+  // Everything to the right starts later still.
+  if (n.cue.start_us > to_us) return;
+  if (n.cue.end_us >= from_us) cues->push_back(n.cue);
+  CollectOverlapping(n.right, from_us, to_us, cues);
+}
+
+void CueIndex::CollectStarting(int node, int64_t after_us, int64_t until_us,
+                               std::vector<MetadataCue>* cues) const {
+  if (node < 0) return;
+  const Node& n = nodes_[node];
+  if (n.cue.start_us > after_us) {
+    CollectStarting(n.left, after_us, until_us, cues);
+  }
+  if (n.cue.start_us > after_us && n.cue.start_us <= until_us) {
+    cues->push_back(n.cue);
+  }
+  if (n.cue.start_us <= until_us) {
+    CollectStarting(n.right, after_us, until_us, cues);
+  }
+}
+
+}  // namespace ivs_broadcaster
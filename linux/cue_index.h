@@ -0,0 +1,100 @@
+#ifndef IVS_BROADCASTER_CUE_INDEX_H_
+#define IVS_BROADCASTER_CUE_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// A timed-metadata cue, e.g. the text of an ID3 frame in a segment. Times
+// are stream time, the clock frames carry; a cue without a duration starts
+// and ends at the same time.
+struct MetadataCue {
+  int64_t start_us = 0;
+  int64_t end_us = 0;
+  std::string text;
+
+  bool operator==(const MetadataCue& other) const {
+    return start_us == other.start_us && end_us == other.end_us &&
+           text == other.text;
+  }
+};
+
+struct CueIndexStats {
+  size_t cues = 0;
+  // Cues seen again, e.g. when a segment is played a second time.
+  uint64_t duplicates = 0;
+  // Cues dropped, earliest first, to stay within the limit.
+  uint64_t evictions = 0;
+};
+
+// Every cue of a stream seen so far, in an interval tree: an AVL tree
+// ordered by start time whose nodes also hold the latest end time below
+// them. Finding the cues overlapping a range, active at an instant or
+// starting within a range costs O(log n) plus the cues found, so a seek or
+// a scrub can be answered from the cues already downloaded. Thread-safe.
+class CueIndex {
+ public:
+  // Keeps at most |max_cues| cues.
+  explicit CueIndex(size_t max_cues = 10000);
+
+  CueIndex(const CueIndex&) = delete;
+  CueIndex& operator=(const CueIndex&) = delete;
+
+  // Returns false if the index already holds an equal cue.
+  bool Add(const MetadataCue& cue);
+
+  // Cues overlapping [from_us, to_us], ordered by start time.
+  std::vector<MetadataCue> Overlapping(int64_t from_us, int64_t to_us) const;
+  // Cues that have started but not ended at |time_us|, and cues without a
+  // duration at exactly |time_us|.
+  std::vector<MetadataCue> ActiveAt(int64_t time_us) const;
+  // Cues starting after |after_us| and no later than |until_us|, in order;
+  // what playback from |after_us| to |until_us| reaches.
+  std::vector<MetadataCue> Starting(int64_t after_us, int64_t until_us) const;
+
+  void Clear();
+  CueIndexStats stats() const;
+
+ private:
+  struct Node {
+    MetadataCue cue;
+    // The latest end in this subtree.
+    int64_t max_end_us = 0;
+    int left = -1;
+    int right = -1;
+    int height = 1;
+  };
+
+  // Inserts into the subtree at |node| and returns its new root.
+  int Insert(int node, int added);
+  // Removes the earliest cue of the subtree at |node|.
+  int EraseFirst(int node);
+  int Balance(int node);
+  int RotateLeft(int node);
+  int RotateRight(int node);
+  void Update(int node);
+  int height(int node) const { return node < 0 ? 0 : nodes_[node].height; }
+
+  bool ContainsLocked(const MetadataCue& cue) const;
+  void CollectOverlapping(int node, int64_t from_us, int64_t to_us,
+                          std::vector<MetadataCue>* cues) const;
+  void CollectStarting(int node, int64_t after_us, int64_t until_us,
+                       std::vector<MetadataCue>* cues) const;
+
+  const size_t max_cues_;
+
+  mutable std::mutex mutex_;
+  // Nodes refer to each other by index; erased ones are reused.
+  std::vector<Node> nodes_;
+  std::vector<int> free_;
+  int root_ = -1;
+  CueIndexStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_CUE_INDEX_H_
@@ -0,0 +1,127 @@
+#include "decode_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+DecodePool::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)),
+      threads_(std::exchange(other.threads_, 1)) {}
+
+DecodePool::Lease& DecodePool::Lease::operator=(Lease&& other) noexcept {
+  if (this != &other) {
+    if (pool_ != nullptr) pool_->Release(threads_);
+    pool_ = std::exchange(other.pool_, nullptr);
+    threads_ = std::exchange(other.threads_, 1);
+  }
+  return *this;
+}
+
+DecodePool::Lease::~Lease() {
+  if (pool_ != nullptr) pool_->Release(threads_);
+}
+
+DecodePool::DecodePool(const DecodePoolConfig& config)
+    : threads_(config.threads > 0
+                   ? config.threads
+                   : std::max(1, static_cast<int>(
+                                     std::thread::hardware_concurrency()))),
+      max_frame_threads_(config.max_frame_threads) {
+  stats_.threads = threads_;
+}
+
+DecodePool::~DecodePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+void DecodePool::Run(int count, const Job& job) {
+  if (count <= 0) return;
+  Batch batch;
+  batch.job = &job;
+  batch.count = count;
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++stats_.batches;
+  stats_.jobs += count;
+  if (count > 1) {
+    StartWorkers();
+    batches_.push_back(&batch);
+    lock.unlock();
+    if (count == 2) {
+      work_.notify_one();
+    } else {
+      work_.notify_all();
+    }
+    lock.lock();
+  }
+  for (int index; (index = Claim(&batch)) >= 0;) {
+    ++stats_.caller_jobs;
+    lock.unlock();
+    job(index, 0);
+    lock.lock();
+    ++batch.done;
+  }
+  // Workers still on the last jobs notify while holding the lock, so the
+  // batch outlives every use once this returns.
+  finished_.wait(lock, [&batch] { return batch.done == batch.count; });
+}
+
+int DecodePool::Claim(Batch* batch) {
+  if (batch->next == batch->count) return -1;
+  const int index = batch->next++;
+  if (batch->next == batch->count) {
+    auto it = std::find(batches_.begin(), batches_.end(), batch);
+    if (it != batches_.end()) batches_.erase(it);
+  }
+  return index;
+}
+
+void DecodePool::StartWorkers() {
+  if (!workers_.empty()) return;
+  workers_.reserve(threads_);
+  for (int i = 0; i < threads_; ++i) {
+    workers_.emplace_back(&DecodePool::WorkLoop, this, i + 1);
+  }
+}
+
+void DecodePool::WorkLoop(int worker) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_.wait(lock, [this] { return stopping_ || !batches_.empty(); });
+    if (stopping_) return;
+    Batch* batch = batches_.front();
+    const int index = Claim(batch);
+    lock.unlock();
+    (*batch->job)(index, worker);
+    lock.lock();
+    if (++batch->done == batch->count) finished_.notify_all();
+  }
+}
+
+DecodePool::Lease DecodePool::LeaseFrameThreads() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int free = threads() - stats_.frame_threads;
+  const int threads = std::min(free, max_frame_threads_);
+  if (threads < 2) return Lease();
+  ++stats_.frame_threaded_decoders;
+  stats_.frame_threads += threads;
+  return Lease(this, threads);
+}
+
+void DecodePool::Release(int threads) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  --stats_.frame_threaded_decoders;
+  stats_.frame_threads -= threads;
+}
+
+DecodePoolStats DecodePool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace ivs_broadcaster
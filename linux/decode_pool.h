@@ -0,0 +1,125 @@
+#ifndef IVS_BROADCASTER_DECODE_POOL_H_
+#define IVS_BROADCASTER_DECODE_POOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+struct DecodePoolConfig {
+  // Worker threads; 0 starts one per core.
+  int threads = 0;
+  // Most threads one decoder gets for frame threading; 1 turns frame
+  // threading off.
+  int max_frame_threads = 4;
+};
+
+struct DecodePoolStats {
+  int threads = 0;
+  // Run() calls, the jobs they ran, and those run by the calling thread.
+  uint64_t batches = 0;
+  uint64_t jobs = 0;
+  uint64_t caller_jobs = 0;
+  // Decoders holding frame threads, and how many they hold in all.
+  int frame_threaded_decoders = 0;
+  int frame_threads = 0;
+};
+
+// Software decoding threads shared by every player in the process.
+//
+// A frame-threaded decoder keeps a frame in flight on each of its threads,
+// so those threads cannot be shared. LeaseFrameThreads() hands them out
+// from the pool's budget, so players decoding at once stay within one
+// thread per core between them, and a player alone on screen still gets
+// several. Decoders opened while the budget is used up get none and decode
+// on their own thread.
+//
+// Run() spreads work split into independent jobs over the pool's workers
+// and the calling thread. The workers start on the first batch, so a pool
+// that only hands out leases starts no threads. (libavcodec cannot run its
+// slice jobs here: it starts slice threads of its own whenever it creates
+// slice contexts.)
+class DecodePool {
+ public:
+  // Frame threads held by one decoder until it goes away.
+  class Lease {
+   public:
+    Lease() = default;
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    ~Lease();
+
+    // Threads the decoder may start; 1 means no frame threading.
+    int threads() const { return threads_; }
+
+   private:
+    friend class DecodePool;
+    Lease(DecodePool* pool, int threads) : pool_(pool), threads_(threads) {}
+
+    DecodePool* pool_ = nullptr;
+    int threads_ = 1;
+  };
+
+  // Runs job(index, worker) for every index below a count. |worker| is
+  // below threads() + 1 and no two jobs running at once share it, so it
+  // can pick per-thread scratch space; the calling thread is worker 0.
+  using Job = std::function<void(int index, int worker)>;
+
+  explicit DecodePool(const DecodePoolConfig& config);
+  // Joins the workers. No Run() may be in progress.
+  ~DecodePool();
+
+  DecodePool(const DecodePool&) = delete;
+  DecodePool& operator=(const DecodePool&) = delete;
+
+  int threads() const { return threads_; }
+
+  // Runs |count| jobs and returns once all are done. The calling thread
+  // runs jobs too, so a batch finishes even when other batches keep every
+  // worker busy. Called from any number of threads at once.
+  void Run(int count, const Job& job);
+
+  // Frame threads for a decoder being opened: as many as are not leased,
+  // up to max_frame_threads, or 1 if that leaves fewer than 2.
+  Lease LeaseFrameThreads();
+
+  DecodePoolStats stats() const;
+
+ private:
+  struct Batch {
+    const Job* job = nullptr;
+    int count = 0;
+    int next = 0;
+    int done = 0;
+  };
+
+  // Starts the workers if they are not running yet. Called locked.
+  void StartWorkers();
+  void WorkLoop(int worker);
+  // Takes the next job of |batch|, or returns -1 when all are taken. Called
+  // locked.
+  int Claim(Batch* batch);
+  void Release(int threads);
+
+  const int threads_;
+  const int max_frame_threads_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_;
+  std::condition_variable finished_;
+  bool stopping_ = false;
+  // Batches with jobs nobody has taken yet, oldest first.
+  std::deque<Batch*> batches_;
+  DecodePoolStats stats_;
+  // Empty until the first batch with more than one job.
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_DECODE_POOL_H_
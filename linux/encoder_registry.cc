@@ -0,0 +1,288 @@
+#include "encoder_registry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr char kCacheHeader[] = "# ivs_broadcaster encoder benchmark v1";
+
+// Give up on a preset once encoding the one-second clip has taken this long;
+// the backend is clearly not real time and the user is waiting.
+constexpr auto kBenchmarkBudget = std::chrono::seconds(2);
+
+// Distinct synthetic frames cycled through during a benchmark run. Generating
+// them up front keeps pattern synthesis out of the measurement.
+constexpr int kBenchmarkFramePool = 4;
+
+std::string Sanitize(std::string value) {
+  std::replace(value.begin(), value.end(), '\t', ' ');
+  std::replace(value.begin(), value.end(), '\n', ' ');
+  return value;
+}
+
+std::string Trim(const std::string& value) {
+  size_t begin = value.find_first_not_of(" \t");
+  if (begin == std::string::npos) return "";
+  size_t end = value.find_last_not_of(" \t");
+  return value.substr(begin, end - begin + 1);
+}
+
+int PresetIndex(const std::string& name) {
+  const auto& presets = DefaultEncoderPresets();
+  for (size_t i = 0; i < presets.size(); ++i) {
+    if (presets[i].name == name) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+bool IsRealtime(const EncoderPreset& preset, double fps) {
+  return fps >= preset.fps * EncoderRegistry::kRealtimeHeadroom;
+}
+
+}  // namespace
+
+const std::vector<EncoderPreset>& DefaultEncoderPresets() {
+  static const std::vector<EncoderPreset> presets = {
+      {"360", 640, 360, 30, 800000},
+      {"720", 1280, 720, 30, 2500000},
+      {"1080", 1920, 1080, 30, 5000000},
+  };
+  return presets;
+}
+
+const EncoderPreset* FindEncoderPreset(const std::string& name) {
+  int index = PresetIndex(name);
+  return index < 0 ? nullptr : &DefaultEncoderPresets()[index];
+}
+
+void EncoderRegistry::Register(std::unique_ptr<EncoderBackend> backend) {
+  backends_.push_back(std::move(backend));
+}
+
+void EncoderRegistry::Calibrate(const std::string& cache_path,
+                                const std::string& cpu_model) {
+  const std::string cpu = Sanitize(cpu_model);
+  std::vector<std::string> foreign_lines;
+  std::vector<EncoderBenchmark> results;
+
+  std::ifstream in(cache_path);
+  std::string line;
+  if (std::getline(in, line) && line == kCacheHeader) {
+    while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string model, backend, preset, fps;
+      if (!std::getline(fields, model, '\t') ||
+          !std::getline(fields, backend, '\t') ||
+          !std::getline(fields, preset, '\t') ||
+          !std::getline(fields, fps, '\t')) {
+        continue;
+      }
+      if (model != cpu) {
+        foreign_lines.push_back(line);
+        continue;
+      }
+      const EncoderPreset* known = FindEncoderPreset(preset);
+      if (known == nullptr) continue;
+      EncoderBenchmark entry;
+      entry.backend = backend;
+      entry.preset = preset;
+      entry.fps = std::strtod(fps.c_str(), nullptr);
+      entry.realtime = IsRealtime(*known, entry.fps);
+      results.push_back(entry);
+    }
+  }
+  in.close();
+
+  bool measured = false;
+  for (const auto& backend : backends_) {
+    const std::string name = backend->name();
+    bool cached = std::any_of(
+        results.begin(), results.end(),
+        [&](const EncoderBenchmark& r) { return r.backend == name; });
+    if (cached || !backend->IsAvailable()) continue;
+    std::vector<EncoderBenchmark> fresh = Benchmark(backend.get());
+    results.insert(results.end(), fresh.begin(), fresh.end());
+    measured = true;
+  }
+
+  if (measured && !cache_path.empty()) {
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(cache_path).parent_path(), error);
+    std::ofstream out(cache_path, std::ios::trunc);
+    out << kCacheHeader << '\n';
+    for (const auto& foreign : foreign_lines) out << foreign << '\n';
+    for (const auto& r : results) {
+      out << cpu << '\t' << r.backend << '\t' << r.preset << '\t' << r.fps
+          << '\n';
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  results_ = std::move(results);
+  calibrated_ = true;
+  calibrated_cv_.notify_all();
+}
+
+bool EncoderRegistry::WaitForCalibration(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return calibrated_cv_.wait_for(lock, timeout, [this] { return calibrated_; });
+}
+
+std::vector<EncoderBenchmark> EncoderRegistry::results() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return results_;
+}
+
+EncoderRecommendation EncoderRegistry::Recommend() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EncoderRecommendation best;
+  int best_index = -1;
+  double best_fps = 0;
+  // Walk backends in registration order so earlier ones win ties.
+  for (const auto& backend : backends_) {
+    for (const auto& r : results_) {
+      if (r.backend != backend->name() || !r.realtime) continue;
+      int index = PresetIndex(r.preset);
+      if (index > best_index || (index == best_index && r.fps > best_fps)) {
+        best_index = index;
+        best_fps = r.fps;
+        best.backend = r.backend;
+        best.preset = r.preset;
+      }
+    }
+  }
+  return best;
+}
+
+std::string EncoderRegistry::ResolvePreset(const std::string& requested,
+                                           bool enforce) const {
+  std::string recommended = Recommend().preset;
+  // Nothing sustains real time; the smallest preset falls behind the least.
+  if (recommended.empty()) recommended = DefaultEncoderPresets().front().name;
+
+  int requested_index = PresetIndex(requested);
+  if (requested_index < 0) return recommended;
+  if (enforce && requested_index > PresetIndex(recommended)) {
+    return recommended;
+  }
+  return requested;
+}
+
+std::unique_ptr<EncoderSession> EncoderRegistry::Open(
+    const EncoderPreset& preset, std::string* backend_name) const {
+  std::vector<EncoderBenchmark> ranked = results();
+  ranked.erase(std::remove_if(ranked.begin(), ranked.end(),
+                              [&](const EncoderBenchmark& r) {
+                                return r.preset != preset.name || !r.realtime;
+                              }),
+               ranked.end());
+  std::stable_sort(ranked.begin(), ranked.end(),
+                   [](const EncoderBenchmark& a, const EncoderBenchmark& b) {
+                     return a.fps > b.fps;
+                   });
+
+  std::vector<EncoderBackend*> order;
+  for (const auto& r : ranked) {
+    for (const auto& backend : backends_) {
+      if (backend->name() == r.backend) order.push_back(backend.get());
+    }
+  }
+  for (const auto& backend : backends_) {
+    if (std::find(order.begin(), order.end(), backend.get()) == order.end()) {
+      order.push_back(backend.get());
+    }
+  }
+
+  for (EncoderBackend* backend : order) {
+    if (!backend->IsAvailable()) continue;
+    std::unique_ptr<EncoderSession> session = backend->Open(preset);
+    if (session) {
+      if (backend_name != nullptr) *backend_name = backend->name();
+      return session;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<EncoderBenchmark> EncoderRegistry::Benchmark(
+    EncoderBackend* backend) const {
+  std::vector<EncoderBenchmark> results;
+  bool keeping_up = true;
+  for (const auto& preset : DefaultEncoderPresets()) {
+    EncoderBenchmark entry;
+    entry.backend = backend->name();
+    entry.preset = preset.name;
+    // A backend that cannot keep up with a smaller preset will not keep up
+    // with a larger one; record it without spending the time.
+    std::unique_ptr<EncoderSession> session =
+        keeping_up ? backend->Open(preset) : nullptr;
+    if (session) {
+      SyntheticFrameSource source(preset.width, preset.height, preset.fps);
+      std::vector<VideoFrame> frames(kBenchmarkFramePool);
+      for (auto& frame : frames) source.Next(&frame);
+
+      std::vector<EncodedPacket> packets;
+      const auto start = std::chrono::steady_clock::now();
+      int encoded = 0;
+      bool ok = true;
+      for (; encoded < preset.fps && ok; ++encoded) {
+        VideoFrame& frame = frames[encoded % kBenchmarkFramePool];
+        frame.pts_us = static_cast<int64_t>(encoded) * 1000000 / preset.fps;
+        ok = session->Encode(frame, &packets);
+        packets.clear();
+        if (std::chrono::steady_clock::now() - start > kBenchmarkBudget) {
+          ++encoded;
+          break;
+        }
+      }
+      ok = ok && session->Flush(&packets);
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      if (ok && elapsed.count() > 0) entry.fps = encoded / elapsed.count();
+    }
+    entry.realtime = IsRealtime(preset, entry.fps);
+    keeping_up = entry.realtime;
+    results.push_back(entry);
+  }
+  return results;
+}
+
+std::string ReadCpuModel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  std::string fallback;
+  while (std::getline(cpuinfo, line)) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string key = Trim(line.substr(0, colon));
+    std::string value = Trim(line.substr(colon + 1));
+    if (key == "model name" && !value.empty()) return value;
+    // ARM kernels report the SoC as "Hardware" and the core as "CPU part".
+    if ((key == "Hardware" || key == "CPU part") && fallback.empty()) {
+      fallback = value;
+    }
+  }
+  return fallback.empty() ? "unknown" : fallback;
+}
+
+std::string DefaultBenchmarkCachePath() {
+  std::filesystem::path base;
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    base = xdg;
+  } else if (const char* home = std::getenv("HOME"); home && *home) {
+    base = std::filesystem::path(home) / ".cache";
+  } else {
+    base = std::filesystem::temp_directory_path();
+  }
+  return (base / "ivs_broadcaster" / "encoder_benchmark").string();
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,149 @@
+#ifndef IVS_BROADCASTER_ENCODER_REGISTRY_H_
+#define IVS_BROADCASTER_ENCODER_REGISTRY_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+// A broadcast quality preset. |name| matches IvsQuality.description on the
+// Dart side ("360", "720", "1080") and the sizes and bitrates mirror the
+// configurations used by the iOS and Android views.
+struct EncoderPreset {
+  std::string name;
+  int width;
+  int height;
+  int fps;
+  int bitrate;
+};
+
+// Presets in ascending order of cost.
+const std::vector<EncoderPreset>& DefaultEncoderPresets();
+
+// Returns the preset called |name|, or nullptr if there is none.
+const EncoderPreset* FindEncoderPreset(const std::string& name);
+
+struct EncodedPacket {
+  std::vector<uint8_t> data;
+  int64_t pts_us = 0;
+  int64_t dts_us = 0;
+  bool keyframe = false;
+};
+
+// An open encoder producing H.264 for a single preset.
+class EncoderSession {
+ public:
+  virtual ~EncoderSession() = default;
+
+  // Encodes |frame| and appends any packets that became ready to |packets|.
+  virtual bool Encode(const VideoFrame& frame,
+                      std::vector<EncodedPacket>* packets) = 0;
+
+  // Drains frames still held by the encoder.
+  virtual bool Flush(std::vector<EncodedPacket>* packets) = 0;
+
+  // SPS/PPS in the form the encoder emitted them, for the muxer header.
+  virtual const std::vector<uint8_t>& codec_config() const = 0;
+};
+
+// A way of encoding H.264 on this machine, e.g. a software or hardware codec.
+class EncoderBackend {
+ public:
+  virtual ~EncoderBackend() = default;
+
+  virtual std::string name() const = 0;
+
+  // Whether the backend is present at all. A present backend may still fail
+  // to open, which the benchmark records as not sustaining any preset.
+  virtual bool IsAvailable() const = 0;
+
+  virtual std::unique_ptr<EncoderSession> Open(const EncoderPreset& preset) = 0;
+};
+
+// Throughput measured for one backend at one preset.
+struct EncoderBenchmark {
+  std::string backend;
+  std::string preset;
+  double fps = 0;
+  bool realtime = false;
+};
+
+struct EncoderRecommendation {
+  // Both empty when no backend sustains even the smallest preset.
+  std::string backend;
+  std::string preset;
+};
+
+// Keeps the encoder backends known to the plugin and decides which preset
+// this machine can actually sustain.
+//
+// On first run every available backend encodes one second of synthetic
+// frames at each preset. The results are cached on disk keyed by CPU model
+// so later launches only benchmark backends that were not measured before.
+class EncoderRegistry {
+ public:
+  // Encoding must run this much faster than the preset frame rate to count as
+  // real time; capture, conversion and muxing share the same cores.
+  static constexpr double kRealtimeHeadroom = 1.25;
+
+  EncoderRegistry() = default;
+  EncoderRegistry(const EncoderRegistry&) = delete;
+  EncoderRegistry& operator=(const EncoderRegistry&) = delete;
+
+  // Adds a backend. Backends registered first win ties, so register hardware
+  // encoders before software ones.
+  void Register(std::unique_ptr<EncoderBackend> backend);
+
+  // Loads cached results for |cpu_model| from |cache_path|, benchmarks any
+  // available backend missing from the cache and writes the cache back.
+  void Calibrate(const std::string& cache_path, const std::string& cpu_model);
+
+  // Blocks until Calibrate() has completed or |timeout| elapses. Returns
+  // whether calibration has completed.
+  bool WaitForCalibration(std::chrono::milliseconds timeout);
+
+  std::vector<EncoderBenchmark> results() const;
+
+  // The highest preset some backend sustains in real time, and the fastest
+  // backend at that preset.
+  EncoderRecommendation Recommend() const;
+
+  // Resolves the preset requested by the app. "auto" and unknown names map to
+  // the recommendation. With |enforce| set, requests above the recommendation
+  // are lowered to it; otherwise they are honoured as is.
+  std::string ResolvePreset(const std::string& requested, bool enforce) const;
+
+  // Opens the fastest realtime backend for |preset|, falling back to any
+  // backend that opens.
+  std::unique_ptr<EncoderSession> Open(const EncoderPreset& preset,
+                                       std::string* backend_name) const;
+
+ private:
+  std::vector<EncoderBenchmark> Benchmark(EncoderBackend* backend) const;
+
+  std::vector<std::unique_ptr<EncoderBackend>> backends_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable calibrated_cv_;
+  bool calibrated_ = false;
+  std::vector<EncoderBenchmark> results_;
+};
+
+// The "model name" of the first CPU in /proc/cpuinfo, or the best substitute
+// the kernel exposes on ARM boards.
+std::string ReadCpuModel();
+
+// $XDG_CACHE_HOME/ivs_broadcaster/encoder_benchmark, falling back to
+// ~/.cache when XDG_CACHE_HOME is unset.
+std::string DefaultBenchmarkCachePath();
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_ENCODER_REGISTRY_H_
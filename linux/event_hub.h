@@ -0,0 +1,249 @@
+#ifndef IVS_BROADCASTER_EVENT_HUB_H_
+#define IVS_BROADCASTER_EVENT_HUB_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// How an event may be coalesced on its way to the Dart listener.
+enum class EventPriority {
+  // Delivered in order on the next drain, e.g. {"state": "CONNECTED"}.
+  kState,
+  // Only the latest pending value per key is delivered.
+  kStats,
+  // Collected per key and delivered as one batch every metrics interval.
+  kMetrics,
+};
+
+struct EventHubConfig {
+  std::chrono::milliseconds metrics_interval{250};
+  // State events kept while the listener is behind. Past this, the oldest
+  // event with the same key is replaced, or the oldest event overall.
+  size_t max_pending_states = 64;
+  // Metrics kept per key between flushes; the oldest are dropped.
+  size_t max_batch = 32;
+};
+
+struct EventHubStats {
+  uint64_t posted = 0;
+  uint64_t delivered = 0;
+  // Stats events replaced by a newer value before delivery.
+  uint64_t coalesced = 0;
+  // State and metrics events dropped to keep pending work bounded.
+  uint64_t dropped = 0;
+};
+
+// Collects events from pipeline threads and hands them to the platform
+// thread in bounded drains, so the load on the Flutter event channel stays
+// predictable however chatty the media engine gets.
+//
+// Post() may be called from any thread. The hub asks its owner, through
+// |Scheduler|, to call Drain() on the delivery thread after a delay. A
+// wake-up is requested only when it is earlier than every one still
+// outstanding, so neither a burst of events nor drains while a metrics
+// batch waits pile up redundant timers.
+template <typename Payload>
+class EventHub {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Scheduler = std::function<void(std::chrono::milliseconds delay)>;
+
+  struct Event {
+    std::string key;
+    EventPriority priority;
+    // One payload, or the batch collected for a metrics key.
+    std::vector<Payload> payloads;
+    // When the latest payload was posted, counting every Post() call.
+    uint64_t sequence = 0;
+  };
+
+  EventHub(EventHubConfig config, Scheduler scheduler)
+      : config_(config), scheduler_(std::move(scheduler)) {}
+
+  EventHub(const EventHub&) = delete;
+  EventHub& operator=(const EventHub&) = delete;
+
+  void Post(const std::string& key, EventPriority priority, Payload payload) {
+    Post(key, priority, std::move(payload), Clock::now());
+  }
+
+  void Post(const std::string& key, EventPriority priority, Payload payload,
+            Clock::time_point now) {
+    Clock::time_point wake = now;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.posted;
+      const uint64_t sequence = ++sequence_;
+      switch (priority) {
+        case EventPriority::kState:
+          PostState(key, sequence, std::move(payload));
+          break;
+        case EventPriority::kStats:
+          PostStats(key, sequence, std::move(payload));
+          break;
+        case EventPriority::kMetrics:
+          wake = PostMetrics(key, sequence, std::move(payload), now);
+          break;
+      }
+      if (!wakes_.empty() && *wakes_.begin() <= wake) return;
+      wakes_.insert(wake);
+    }
+    scheduler_(DelayUntil(wake, now));
+  }
+
+  // Returns the events ready for delivery, in the order they were posted:
+  // every state, the latest value of each stats key and the metrics batches
+  // whose interval has elapsed. A coalesced stats value and a batch take
+  // the place of their latest payload, so a state posted after the final
+  // stats still comes after them.
+  std::vector<Event> Drain() { return Drain(Clock::now()); }
+
+  std::vector<Event> Drain(Clock::time_point now) {
+    std::vector<Event> ready;
+    Clock::time_point next = Clock::time_point::max();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready.reserve(states_.size() + stats_pending_.size());
+      for (auto& state : states_) {
+        ready.push_back(Single(std::move(state), EventPriority::kState));
+      }
+      states_.clear();
+      for (auto& stat : stats_pending_) {
+        ready.push_back(Single(std::move(stat), EventPriority::kStats));
+      }
+      stats_pending_.clear();
+      for (auto it = batches_.begin(); it != batches_.end();) {
+        if (now - it->first_posted >= config_.metrics_interval) {
+          ready.push_back(Event{std::move(it->key), EventPriority::kMetrics,
+                                std::move(it->payloads), it->sequence});
+          it = batches_.erase(it);
+        } else {
+          next = std::min(next, it->first_posted + config_.metrics_interval);
+          ++it;
+        }
+      }
+      // States are already in order; stats and batches are few.
+      std::stable_sort(ready.begin(), ready.end(),
+                       [](const Event& a, const Event& b) {
+                         return a.sequence < b.sequence;
+                       });
+      for (const auto& event : ready) stats_.delivered += event.payloads.size();
+      // Wake-ups that are due have fired or are about to, and find this
+      // drain done. The slack covers a timer firing on the millisecond
+      // boundary just before its deadline.
+      wakes_.erase(wakes_.begin(),
+                   wakes_.upper_bound(now + std::chrono::milliseconds(1)));
+      if (next == Clock::time_point::max() ||
+          (!wakes_.empty() && *wakes_.begin() <= next)) {
+        return ready;
+      }
+      wakes_.insert(next);
+    }
+    scheduler_(DelayUntil(next, now));
+    return ready;
+  }
+
+  EventHubStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+ private:
+  struct Pending {
+    std::string key;
+    uint64_t sequence;
+    Payload payload;
+  };
+
+  struct Batch {
+    std::string key;
+    Clock::time_point first_posted;
+    std::vector<Payload> payloads;
+    uint64_t sequence;
+  };
+
+  static Event Single(Pending pending, EventPriority priority) {
+    Event event{std::move(pending.key), priority, {}, pending.sequence};
+    event.payloads.push_back(std::move(pending.payload));
+    return event;
+  }
+
+  static std::chrono::milliseconds DelayUntil(Clock::time_point when,
+                                              Clock::time_point now) {
+    if (when <= now) return std::chrono::milliseconds(0);
+    // Round up so the drain never runs before the batch is due.
+    return std::chrono::ceil<std::chrono::milliseconds>(when - now);
+  }
+
+  void PostState(const std::string& key, uint64_t sequence,
+                 Payload payload) {
+    if (states_.size() >= config_.max_pending_states) {
+      auto same = std::find_if(states_.begin(), states_.end(),
+                               [&key](const Pending& state) {
+                                 return state.key == key;
+                               });
+      states_.erase(same != states_.end() ? same : states_.begin());
+      ++stats_.dropped;
+    }
+    states_.push_back(Pending{key, sequence, std::move(payload)});
+  }
+
+  void PostStats(const std::string& key, uint64_t sequence,
+                 Payload payload) {
+    for (auto& stat : stats_pending_) {
+      if (stat.key == key) {
+        stat.sequence = sequence;
+        stat.payload = std::move(payload);
+        ++stats_.coalesced;
+        return;
+      }
+    }
+    stats_pending_.push_back(Pending{key, sequence, std::move(payload)});
+  }
+
+  Clock::time_point PostMetrics(const std::string& key, uint64_t sequence,
+                                Payload payload, Clock::time_point now) {
+    for (auto& batch : batches_) {
+      if (batch.key == key) {
+        if (batch.payloads.size() >= config_.max_batch) {
+          batch.payloads.erase(batch.payloads.begin());
+          ++stats_.dropped;
+        }
+        batch.payloads.push_back(std::move(payload));
+        batch.sequence = sequence;
+        return batch.first_posted + config_.metrics_interval;
+      }
+    }
+    batches_.push_back(Batch{key, now, {}, sequence});
+    batches_.back().payloads.push_back(std::move(payload));
+    return now + config_.metrics_interval;
+  }
+
+  const EventHubConfig config_;
+  const Scheduler scheduler_;
+
+  mutable std::mutex mutex_;
+  std::deque<Pending> states_;
+  std::vector<Pending> stats_pending_;
+  std::vector<Batch> batches_;
+  // Post() calls so far; orders pending events across kinds.
+  uint64_t sequence_ = 0;
+  // Deadlines of the wake-ups requested from the scheduler that have not
+  // come yet. Only ever grows by one earlier than all of them.
+  std::set<Clock::time_point> wakes_;
+  EventHubStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_EVENT_HUB_H_
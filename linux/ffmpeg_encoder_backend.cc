@@ -0,0 +1,145 @@
+#include "ffmpeg_encoder_backend.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+}
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// IVS requires a keyframe at least every two seconds.
+constexpr int64_t kKeyframeIntervalUs = 2000000;
+
+// Encoders that accept system-memory YUV 4:2:0 frames, in order of
+// preference. VAAPI and QSV need hardware frame contexts and are not listed.
+constexpr const char* kCodecNames[] = {
+    "h264_nvenc",
+    "h264_v4l2m2m",
+    "libx264",
+    "libopenh264",
+};
+
+class FfmpegEncoderSession : public EncoderSession {
+ public:
+  ~FfmpegEncoderSession() override {
+    av_packet_free(&packet_);
+    av_frame_free(&frame_);
+    avcodec_free_context(&context_);
+  }
+
+  bool Init(const AVCodec* codec, const EncoderPreset& preset) {
+    context_ = avcodec_alloc_context3(codec);
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (context_ == nullptr || frame_ == nullptr || packet_ == nullptr) {
+      return false;
+    }
+
+    context_->width = preset.width;
+    context_->height = preset.height;
+    context_->pix_fmt = AV_PIX_FMT_YUV420P;
+    context_->time_base = AVRational{1, 1000000};
+    context_->framerate = AVRational{preset.fps, 1};
+    context_->bit_rate = preset.bitrate;
+    context_->rc_max_rate = preset.bitrate;
+    context_->rc_buffer_size = preset.bitrate;
+    // No B-frames, as IVS requires. The frame-count GOP is only a ceiling:
+    // dropped and skipped frames stretch it, so Encode() also forces
+    // keyframes by timestamp.
+    context_->gop_size = preset.fps * 2;
+    context_->max_b_frames = 0;
+    context_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    context_->thread_count = 0;
+
+    av_opt_set(context_->priv_data, "preset", "veryfast", 0);
+    av_opt_set(context_->priv_data, "tune", "zerolatency", 0);
+    if (avcodec_open2(context_, codec, nullptr) < 0) return false;
+
+    if (context_->extradata != nullptr) {
+      codec_config_.assign(context_->extradata,
+                           context_->extradata + context_->extradata_size);
+    }
+    frame_->format = AV_PIX_FMT_YUV420P;
+    frame_->width = preset.width;
+    frame_->height = preset.height;
+    return true;
+  }
+
+  bool Encode(const VideoFrame& frame,
+              std::vector<EncodedPacket>* packets) override {
+    frame_->data[0] = const_cast<uint8_t*>(frame.y());
+    frame_->data[1] = const_cast<uint8_t*>(frame.u());
+    frame_->data[2] = const_cast<uint8_t*>(frame.v());
+    frame_->linesize[0] = frame.y_stride();
+    frame_->linesize[1] = frame.uv_stride();
+    frame_->linesize[2] = frame.uv_stride();
+    frame_->pts = frame.pts_us;
+    const bool keyframe_due = last_keyframe_us_ < 0 ||
+                              frame.pts_us - last_keyframe_us_ >=
+                                  kKeyframeIntervalUs;
+    frame_->pict_type = keyframe_due ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+    if (keyframe_due) last_keyframe_us_ = frame.pts_us;
+    if (avcodec_send_frame(context_, frame_) < 0) return false;
+    return Drain(packets);
+  }
+
+  bool Flush(std::vector<EncodedPacket>* packets) override {
+    if (avcodec_send_frame(context_, nullptr) < 0) return false;
+    return Drain(packets);
+  }
+
+  const std::vector<uint8_t>& codec_config() const override {
+    return codec_config_;
+  }
+
+ private:
+  bool Drain(std::vector<EncodedPacket>* packets) {
+    for (;;) {
+      int status = avcodec_receive_packet(context_, packet_);
+      if (status == AVERROR(EAGAIN) || status == AVERROR_EOF) return true;
+      if (status < 0) return false;
+      EncodedPacket out;
+      out.data.assign(packet_->data, packet_->data + packet_->size);
+      out.pts_us = packet_->pts;
+      out.dts_us = packet_->dts;
+      out.keyframe = (packet_->flags & AV_PKT_FLAG_KEY) != 0;
+      if (out.keyframe) last_keyframe_us_ = packet_->pts;
+      packets->push_back(std::move(out));
+      av_packet_unref(packet_);
+    }
+  }
+
+  AVCodecContext* context_ = nullptr;
+  AVFrame* frame_ = nullptr;
+  AVPacket* packet_ = nullptr;
+  std::vector<uint8_t> codec_config_;
+  int64_t last_keyframe_us_ = -1;
+};
+
+}  // namespace
+
+FfmpegEncoderBackend::FfmpegEncoderBackend(std::string codec_name)
+    : codec_name_(std::move(codec_name)) {}
+
+bool FfmpegEncoderBackend::IsAvailable() const {
+  return avcodec_find_encoder_by_name(codec_name_.c_str()) != nullptr;
+}
+
+std::unique_ptr<EncoderSession> FfmpegEncoderBackend::Open(
+    const EncoderPreset& preset) {
+  const AVCodec* codec = avcodec_find_encoder_by_name(codec_name_.c_str());
+  if (codec == nullptr) return nullptr;
+  auto session = std::make_unique<FfmpegEncoderSession>();
+  if (!session->Init(codec, preset)) return nullptr;
+  return session;
+}
+
+void RegisterFfmpegEncoderBackends(EncoderRegistry* registry) {
+  for (const char* name : kCodecNames) {
+    registry->Register(std::make_unique<FfmpegEncoderBackend>(name));
+  }
+}
+
+}  // namespace ivs_broadcaster
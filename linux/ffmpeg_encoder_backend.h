@@ -0,0 +1,31 @@
+#ifndef IVS_BROADCASTER_FFMPEG_ENCODER_BACKEND_H_
+#define IVS_BROADCASTER_FFMPEG_ENCODER_BACKEND_H_
+
+#include <memory>
+#include <string>
+
+#include "encoder_registry.h"
+
+namespace ivs_broadcaster {
+
+// An H.264 encoder provided by libavcodec, identified by its codec name
+// (e.g. "libx264" or "h264_nvenc").
+class FfmpegEncoderBackend : public EncoderBackend {
+ public:
+  explicit FfmpegEncoderBackend(std::string codec_name);
+
+  std::string name() const override { return codec_name_; }
+  bool IsAvailable() const override;
+  std::unique_ptr<EncoderSession> Open(const EncoderPreset& preset) override;
+
+ private:
+  std::string codec_name_;
+};
+
+// Registers every libavcodec H.264 encoder the plugin knows how to drive,
+// hardware encoders first.
+void RegisterFfmpegEncoderBackends(EncoderRegistry* registry);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_FFMPEG_ENCODER_BACKEND_H_
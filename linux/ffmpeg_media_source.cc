@@ -0,0 +1,590 @@
+#include "ffmpeg_media_source.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "id3_tag.h"
+#include "ll_hls_loader.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr AVRational kMicroseconds = {1, 1000000};
+constexpr int kIoBufferBytes = 32 << 10;
+
+bool IsHlsUrl(const std::string& url) {
+  const std::string path = url.substr(0, url.find_first_of("?#"));
+  constexpr char kExtension[] = ".m3u8";
+  const size_t length = sizeof(kExtension) - 1;
+  return path.size() >= length &&
+         path.compare(path.size() - length, length, kExtension) == 0;
+}
+
+std::string ErrorString(int status) {
+  char buffer[128] = {};
+  av_strerror(status, buffer, sizeof(buffer));
+  return buffer;
+}
+
+class FfmpegVideoDecoder : public VideoDecoder {
+ public:
+  FfmpegVideoDecoder()
+      : packet_(av_packet_alloc()), decoded_(av_frame_alloc()) {}
+
+  ~FfmpegVideoDecoder() override {
+    sws_freeContext(scaler_);
+    avcodec_free_context(&context_);
+    av_frame_free(&decoded_);
+    av_packet_free(&packet_);
+  }
+
+  bool Open(const AVCodecParameters* parameters, DecodePool* pool,
+            std::string* error) {
+    const AVCodec* codec = avcodec_find_decoder(parameters->codec_id);
+    context_ = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (context_ == nullptr ||
+        avcodec_parameters_to_context(context_, parameters) < 0) {
+      *error = "no decoder for the video stream";
+      return false;
+    }
+    // Packets arrive with timestamps in microseconds.
+    context_->pkt_timebase = kMicroseconds;
+    if (pool != nullptr) lease_ = pool->LeaseFrameThreads();
+    if (lease_.threads() > 1) {
+      // Holds each output back by one packet per thread; Decode() drains
+      // the threads after every keyframe in keyframe-only mode.
+      context_->thread_count = lease_.threads();
+      context_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    } else if (pool != nullptr) {
+      // The pool's budget is used up. libavcodec sizes slice contexts by
+      // the threads it starts for them, so slice threading would add a
+      // thread per core for this decoder alone.
+      context_->thread_count = 1;
+    } else {
+      context_->thread_count = 0;
+      context_->thread_type = FF_THREAD_SLICE;
+    }
+    if (avcodec_open2(context_, codec, nullptr) < 0) {
+      *error = "cannot open the video decoder";
+      return false;
+    }
+    frame_threaded_ = (context_->active_thread_type & FF_THREAD_FRAME) != 0;
+    return true;
+  }
+
+  bool Decode(const MediaPacket& packet, VideoFrame* frame) override {
+    // Not reference counted, so the decoder copies what it keeps.
+    packet_->data = const_cast<uint8_t*>(packet.data.data());
+    packet_->size = static_cast<int>(packet.data.size());
+    packet_->pts = packet.pts_us;
+    packet_->dts = AV_NOPTS_VALUE;
+    packet_->flags = packet.keyframe ? AV_PKT_FLAG_KEY : 0;
+    const int sent = avcodec_send_packet(context_, packet_);
+    packet_->data = nullptr;
+    packet_->size = 0;
+    if (sent < 0 && sent != AVERROR(EAGAIN)) return false;
+    holding_ = true;
+    // The next keyframe may be a GOP away; nothing after this one refers
+    // to it, so the threads can let go of it now.
+    if (frame_threaded_ && keyframes_only_) return Drain(frame);
+    if (avcodec_receive_frame(context_, decoded_) < 0) return false;
+    const bool converted = Convert(frame);
+    av_frame_unref(decoded_);
+    return converted;
+  }
+
+  void Flush() override {
+    avcodec_flush_buffers(context_);
+    holding_ = false;
+  }
+
+  void SetKeyframesOnly(bool keyframes_only) override {
+    keyframes_only_ = keyframes_only;
+    context_->skip_frame =
+        keyframes_only ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+  }
+
+  size_t BufferedBytes() const override {
+    if (!holding_) return 0;
+    // Reference pictures, one in flight per frame thread and the one being
+    // converted, in 4:2:0 at the coded size; libavcodec does not say what
+    // its pools hold.
+    const size_t picture = static_cast<size_t>(context_->width) *
+                           context_->height * 3 / 2;
+    const int threads = frame_threaded_ ? lease_.threads() : 0;
+    return picture * (std::max(context_->refs, 1) + threads + 1);
+  }
+
+ private:
+  // Takes every frame the threads still hold, keeping the last, and makes
+  // the decoder ready for the next packet.
+  bool Drain(VideoFrame* frame) {
+    avcodec_send_packet(context_, nullptr);
+    bool converted = false;
+    while (avcodec_receive_frame(context_, decoded_) >= 0) {
+      converted = Convert(frame) || converted;
+      av_frame_unref(decoded_);
+    }
+    avcodec_flush_buffers(context_);
+    holding_ = false;
+    return converted;
+  }
+
+  bool Convert(VideoFrame* frame) {
+    const int width = decoded_->width & ~1;
+    const int height = decoded_->height & ~1;
+    if (width <= 0 || height <= 0) return false;
+    scaler_ = sws_getCachedContext(
+        scaler_, width, height,
+        static_cast<AVPixelFormat>(decoded_->format), width, height,
+        AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (scaler_ == nullptr) return false;
+    frame->Allocate(width, height);
+    uint8_t* planes[] = {frame->y(), frame->u(), frame->v()};
+    const int strides[] = {frame->y_stride(), frame->uv_stride(),
+                           frame->uv_stride()};
+    sws_scale(scaler_, decoded_->data, decoded_->linesize, 0, height, planes,
+              strides);
+    const int64_t pts = decoded_->best_effort_timestamp;
+    frame->pts_us = pts == AV_NOPTS_VALUE ? 0 : pts;
+    return true;
+  }
+
+  AVCodecContext* context_ = nullptr;
+  AVPacket* packet_;
+  AVFrame* decoded_;
+  SwsContext* scaler_ = nullptr;
+  DecodePool::Lease lease_;
+  bool frame_threaded_ = false;
+  bool keyframes_only_ = false;
+  // Set from a packet sent until the decoder is flushed.
+  bool holding_ = false;
+};
+
+// Decodes audio to interleaved float. Converts the sample formats decoders
+// produce by hand rather than through libswresample.
+class FfmpegAudioDecoder : public AudioDecoder {
+ public:
+  FfmpegAudioDecoder()
+      : packet_(av_packet_alloc()), decoded_(av_frame_alloc()) {}
+
+  ~FfmpegAudioDecoder() override {
+    avcodec_free_context(&context_);
+    av_frame_free(&decoded_);
+    av_packet_free(&packet_);
+  }
+
+  bool Open(const AVCodecParameters* parameters, std::string* error) {
+    const AVCodec* codec = avcodec_find_decoder(parameters->codec_id);
+    context_ = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (context_ == nullptr ||
+        avcodec_parameters_to_context(context_, parameters) < 0) {
+      *error = "no decoder for the audio stream";
+      return false;
+    }
+    context_->pkt_timebase = kMicroseconds;
+    if (avcodec_open2(context_, codec, nullptr) < 0) {
+      *error = "cannot open the audio decoder";
+      return false;
+    }
+    return true;
+  }
+
+  bool Decode(const MediaPacket& packet, AudioBuffer* buffer) override {
+    packet_->data = const_cast<uint8_t*>(packet.data.data());
+    packet_->size = static_cast<int>(packet.data.size());
+    packet_->pts = packet.pts_us;
+    packet_->dts = AV_NOPTS_VALUE;
+    packet_->flags = AV_PKT_FLAG_KEY;
+    const int sent = avcodec_send_packet(context_, packet_);
+    packet_->data = nullptr;
+    packet_->size = 0;
+    if (sent < 0 && sent != AVERROR(EAGAIN)) return false;
+    buffer->samples.clear();
+    buffer->channels = 0;
+    // A packet may hold several frames; they follow one another.
+    while (avcodec_receive_frame(context_, decoded_) >= 0) {
+      if (buffer->samples.empty()) {
+        const int64_t pts = decoded_->best_effort_timestamp;
+        buffer->pts_us = pts == AV_NOPTS_VALUE ? packet.pts_us : pts;
+        buffer->sample_rate = decoded_->sample_rate;
+        buffer->channels = decoded_->ch_layout.nb_channels;
+      }
+      if (decoded_->sample_rate == buffer->sample_rate &&
+          decoded_->ch_layout.nb_channels == buffer->channels) {
+        Convert(buffer);
+      }
+      av_frame_unref(decoded_);
+    }
+    return !buffer->samples.empty();
+  }
+
+ private:
+  // Appends decoded_ to |buffer|, interleaved.
+  void Convert(AudioBuffer* buffer) {
+    const auto format = static_cast<AVSampleFormat>(decoded_->format);
+    const AVSampleFormat packed = av_get_packed_sample_fmt(format);
+    const bool planar = av_sample_fmt_is_planar(format) != 0;
+    const int channels = buffer->channels;
+    const int frames = decoded_->nb_samples;
+    std::vector<float>& samples = buffer->samples;
+    samples.reserve(samples.size() + static_cast<size_t>(frames) * channels);
+    for (int i = 0; i < frames; ++i) {
+      for (int c = 0; c < channels; ++c) {
+        const uint8_t* plane = decoded_->extended_data[planar ? c : 0];
+        samples.push_back(Sample(packed, plane, planar ? i : i * channels + c));
+      }
+    }
+  }
+
+  static float Sample(AVSampleFormat format, const uint8_t* data, int index) {
+    switch (format) {
+      case AV_SAMPLE_FMT_U8:
+        return (data[index] - 128) / 128.0f;
+      case AV_SAMPLE_FMT_S16:
+        return reinterpret_cast<const int16_t*>(data)[index] / 32768.0f;
+      case AV_SAMPLE_FMT_S32:
+        return reinterpret_cast<const int32_t*>(data)[index] / 2147483648.0f;
+      case AV_SAMPLE_FMT_FLT:
+        return reinterpret_cast<const float*>(data)[index];
+      case AV_SAMPLE_FMT_DBL:
+        return static_cast<float>(
+            reinterpret_cast<const double*>(data)[index]);
+      default:
+        return 0;
+    }
+  }
+
+  AVCodecContext* context_ = nullptr;
+  AVPacket* packet_;
+  AVFrame* decoded_;
+};
+
+class FfmpegMediaSource : public MediaSource {
+ public:
+  FfmpegMediaSource(DecodePool* decode_pool, SegmentCache* cache)
+      : packet_(av_packet_alloc()), decode_pool_(decode_pool), cache_(cache) {}
+
+  ~FfmpegMediaSource() override {
+    CloseInput();
+    av_packet_free(&packet_);
+  }
+
+  void SetAbrController(AbrController* abr) override { abr_ = abr; }
+
+  bool Open(const std::string& url, std::string* error) override {
+    url_ = url;
+    if (!OpenInput(0, error) || !ChooseStreams(error)) return false;
+    // Stream time starts at 0, so that it is a position to seek to.
+    if (input_->start_time != AV_NOPTS_VALUE) start_us_ = input_->start_time;
+    return true;
+  }
+
+  ReadResult Read(MediaPacket* packet, std::string* error) override {
+    if (input_ == nullptr) {
+      *error = "cannot open " + url_ + " again after seeking";
+      return ReadResult::kError;
+    }
+    while (true) {
+      const int status = av_read_frame(input_, packet_);
+      if (status == AVERROR_EOF) return ReadResult::kEnd;
+      if (status < 0) {
+        *error = ErrorString(status);
+        return ReadResult::kError;
+      }
+      if (packet_->stream_index == cue_stream_index_) {
+        ReadCues();
+        av_packet_unref(packet_);
+        continue;
+      }
+      const bool audio = packet_->stream_index == audio_stream_index_;
+      if (packet_->stream_index != stream_index_ && !audio) {
+        av_packet_unref(packet_);
+        continue;
+      }
+      packet->video = !audio;
+      packet->keyframe = audio || (packet_->flags & AV_PKT_FLAG_KEY) != 0;
+      packet->pts_us = PacketTimeUs();
+      packet->data.assign(packet_->data, packet_->data + packet_->size);
+      av_packet_unref(packet_);
+      return ReadResult::kPacket;
+    }
+  }
+
+  std::unique_ptr<VideoDecoder> CreateDecoder(std::string* error) override {
+    auto decoder = std::make_unique<FfmpegVideoDecoder>();
+    if (!decoder->Open(input_->streams[stream_index_]->codecpar,
+                       decode_pool_, error)) {
+      return nullptr;
+    }
+    return decoder;
+  }
+
+  std::unique_ptr<AudioDecoder> CreateAudioDecoder() override {
+    if (audio_stream_index_ < 0) return nullptr;
+    auto decoder = std::make_unique<FfmpegAudioDecoder>();
+    // Plays on without sound rather than failing.
+    std::string error;
+    if (!decoder->Open(input_->streams[audio_stream_index_]->codecpar,
+                       &error)) {
+      return nullptr;
+    }
+    return decoder;
+  }
+
+  int64_t LiveLatencyUs() override {
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    return loader_ && loader_->live() ? loader_->BufferedUs() : -1;
+  }
+
+  int64_t TargetLatencyUs() override {
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    return loader_ && loader_->live() ? loader_->stats().start_offset_us : 0;
+  }
+
+  int64_t DurationUs() override {
+    {
+      std::lock_guard<std::mutex> lock(loader_mutex_);
+      if (loader_) return loader_->duration_us();
+    }
+    // libavformat's HLS demuxer only knows the length of ended playlists.
+    if (input_->duration == AV_NOPTS_VALUE || input_->duration <= 0) {
+      return -1;
+    }
+    return input_->duration;
+  }
+
+  int64_t BufferedUs() override {
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    return loader_ ? loader_->BufferedUs() : 0;
+  }
+
+  size_t BufferedBytes() override {
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    return loader_ ? loader_->BufferedBytes() : 0;
+  }
+
+  void SetMaxBufferedBytes(size_t bytes) override {
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    if (loader_) loader_->SetMaxBufferedBytes(bytes);
+  }
+
+  bool Seek(int64_t position_us) override {
+    if (loader_ != nullptr) {
+      // The loader hands the demuxer a byte stream, which cannot seek. A
+      // VOD's is started again at the segment holding |position_us|;
+      // segments start with keyframes.
+      if (loader_->live()) return false;
+      CloseInput();
+      std::string error;
+      if (!OpenInput(position_us, &error) || !ChooseStreams(&error)) {
+        return false;
+      }
+      if (loader_ != nullptr) return true;
+    }
+    return av_seek_frame(input_, -1, start_us_ + position_us,
+                         AVSEEK_FLAG_BACKWARD) >= 0;
+  }
+
+  void TakeCues(std::vector<MetadataCue>* cues) override {
+    if (cues_.empty()) return;
+    cues->insert(cues->end(), cues_.begin(), cues_.end());
+    cues_.clear();
+  }
+
+  void Interrupt() override {
+    interrupted_ = true;
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    if (loader_) loader_->Interrupt();
+  }
+
+ private:
+  // Opens url_, through the loader from |start_us| where it applies.
+  bool OpenInput(int64_t start_us, std::string* error) {
+    input_ = avformat_alloc_context();
+    if (input_ == nullptr) {
+      *error = "out of memory";
+      return false;
+    }
+    input_->interrupt_callback.callback = &FfmpegMediaSource::Interrupted;
+    input_->interrupt_callback.opaque = this;
+    if (IsHlsUrl(url_) && !OpenHls(start_us, error)) return false;
+    // Without a name, the playlist's extension cannot make libavformat
+    // take the loaded media for a playlist.
+    const char* name = io_ != nullptr ? "" : url_.c_str();
+    // avformat_open_input() frees the context on failure.
+    int status = avformat_open_input(&input_, name, nullptr, nullptr);
+    if (status >= 0) status = avformat_find_stream_info(input_, nullptr);
+    if (status < 0) {
+      *error = "cannot open " + url_ + ": " + ErrorString(status);
+      return false;
+    }
+    return true;
+  }
+
+  // Picks the video stream, the audio stream that goes with it and the cue
+  // stream, and discards the others.
+  bool ChooseStreams(std::string* error) {
+    stream_index_ =
+        av_find_best_stream(input_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (stream_index_ < 0) {
+      *error = "no video stream in " + url_;
+      return false;
+    }
+    audio_stream_index_ = std::max(
+        av_find_best_stream(input_, AVMEDIA_TYPE_AUDIO, -1, stream_index_,
+                            nullptr, 0),
+        -1);
+    cue_stream_index_ = -1;
+    for (unsigned i = 0; i < input_->nb_streams; ++i) {
+      if (static_cast<int>(i) == stream_index_ ||
+          static_cast<int>(i) == audio_stream_index_) {
+        continue;
+      }
+      // Timed metadata travels as ID3 tags on a data stream.
+      if (cue_stream_index_ < 0 &&
+          input_->streams[i]->codecpar->codec_id == AV_CODEC_ID_TIMED_ID3) {
+        cue_stream_index_ = static_cast<int>(i);
+        continue;
+      }
+      input_->streams[i]->discard = AVDISCARD_ALL;
+    }
+    return true;
+  }
+
+  void CloseInput() {
+    {
+      std::lock_guard<std::mutex> lock(loader_mutex_);
+      if (loader_) loader_->Interrupt();
+    }
+    avformat_close_input(&input_);
+    if (io_ != nullptr) {
+      av_freep(&io_->buffer);
+      avio_context_free(&io_);
+    }
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    loader_.reset();
+  }
+
+  // The stream time of packet_.
+  int64_t PacketTimeUs() const {
+    const AVRational time_base =
+        input_->streams[packet_->stream_index]->time_base;
+    const int64_t pts =
+        packet_->pts != AV_NOPTS_VALUE ? packet_->pts : packet_->dts;
+    if (pts == AV_NOPTS_VALUE) return 0;
+    return av_rescale_q(pts, time_base, kMicroseconds) - start_us_;
+  }
+
+  // Turns the text frames of the ID3 tag in packet_ into cues. Tags carry
+  // no duration, so each cue is an instant.
+  void ReadCues() {
+    texts_.clear();
+    if (!ParseId3TextFrames(packet_->data, packet_->size, &texts_)) return;
+    const int64_t time_us = PacketTimeUs();
+    for (std::string& text : texts_) {
+      cues_.push_back({time_us, time_us, std::move(text)});
+    }
+  }
+
+  static int Interrupted(void* opaque) {
+    return static_cast<FfmpegMediaSource*>(opaque)->interrupted_ ? 1 : 0;
+  }
+
+  static int ReadLoaded(void* opaque, uint8_t* buffer, int size) {
+    const int64_t read =
+        static_cast<LlHlsLoader*>(opaque)->Read(buffer, size);
+    if (read == 0) return AVERROR_EOF;
+    return read < 0 ? AVERROR_EXIT : static_cast<int>(read);
+  }
+
+  // Low-latency HLS playlists are loaded part by part and the demuxer reads
+  // the loaded bytes as they arrive; libavformat's HLS demuxer would wait
+  // for whole segments at HOLD-BACK. Playlists with several variants are
+  // loaded the same way so that the AbrController picks the variant of
+  // each segment, and so are plain live playlists, which the loader already
+  // fetched and which would otherwise play without prefetch or a live
+  // latency to catch up on. VODs are loaded this way when there is a
+  // segment cache, so that replays come from disk; libavformat plays the
+  // rest.
+  bool OpenHls(int64_t start_us, std::string* error) {
+    LlHlsConfig config;
+    config.abr = abr_;
+    config.cache = cache_;
+    config.start_us = start_us;
+    auto loader = std::make_unique<LlHlsLoader>(config);
+    std::string load_error;
+    if (!loader->Open(url_, &load_error)) {
+      if (interrupted_) {
+        *error = "interrupted";
+        return false;
+      }
+      return true;
+    }
+    if (!loader->low_latency() && !loader->adaptive() && !loader->live() &&
+        cache_ == nullptr) {
+      return true;
+    }
+    auto* buffer = static_cast<uint8_t*>(av_malloc(kIoBufferBytes));
+    io_ = buffer ? avio_alloc_context(buffer, kIoBufferBytes, 0, loader.get(),
+                                      &FfmpegMediaSource::ReadLoaded, nullptr,
+                                      nullptr)
+                 : nullptr;
+    if (io_ == nullptr) {
+      av_free(buffer);
+      *error = "out of memory";
+      return false;
+    }
+    input_->pb = io_;
+    input_->flags |= AVFMT_FLAG_CUSTOM_IO;
+    // Probing reads ahead; the default would hold the first frame back by
+    // several parts.
+    input_->probesize = 64 << 10;
+    input_->max_analyze_duration = 500000;
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    loader_ = std::move(loader);
+    if (interrupted_) loader_->Interrupt();
+    return true;
+  }
+
+  AVFormatContext* input_ = nullptr;
+  AVPacket* packet_;
+  DecodePool* const decode_pool_;
+  SegmentCache* const cache_;
+  AbrController* abr_ = nullptr;
+  std::string url_;
+  int stream_index_ = -1;
+  // -1 without audio.
+  int audio_stream_index_ = -1;
+  int cue_stream_index_ = -1;
+  // The container time stream time 0 stands for.
+  int64_t start_us_ = 0;
+  std::vector<std::string> texts_;
+  // Found since the last TakeCues().
+  std::vector<MetadataCue> cues_;
+  std::atomic<bool> interrupted_{false};
+  // Set while an HLS playlist is read through the loader.
+  AVIOContext* io_ = nullptr;
+  std::mutex loader_mutex_;
+  std::unique_ptr<LlHlsLoader> loader_;
+};
+
+}  // namespace
+
+std::unique_ptr<MediaSource> CreateFfmpegMediaSource(
+    DecodePool* decode_pool, SegmentCache* cache) {
+  return std::make_unique<FfmpegMediaSource>(decode_pool, cache);
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,40 @@
+#ifndef IVS_BROADCASTER_FFMPEG_MEDIA_SOURCE_H_
+#define IVS_BROADCASTER_FFMPEG_MEDIA_SOURCE_H_
+
+#include <memory>
+
+#include "decode_pool.h"
+#include "media_player.h"
+
+namespace ivs_broadcaster {
+
+class SegmentCache;
+
+// Opens URLs, including HLS playlists, with libavformat and decodes their
+// video and audio with libavcodec. Streams other than the chosen video
+// stream and the audio stream related to it are discarded, which also
+// stops the HLS demuxer from downloading renditions nobody reads.
+// Low-latency HLS playlists and master playlists with several variants are
+// loaded by LlHlsLoader instead, so the demuxer sees each part as its bytes
+// arrive and the variant follows the AbrController. For a live playlist
+// the loader also tells how far playback is behind the live edge, and the
+// hold-back it started at is the target latency.
+//
+// Stream time starts at 0. Timed-metadata ID3 tags are read into cues, and
+// sources that libavformat reads on its own can seek, as can VODs the
+// loader reads, by loading them again from the segment to seek to.
+//
+// With a |decode_pool|, which outlives the source, video is decoded with
+// frame threads leased from the pool, or on the source's own thread once
+// they are all leased. Without one, libavcodec starts slice threads of its
+// own.
+//
+// With a |cache|, which outlives the source, HLS VODs are read by the
+// loader too, and their segments come from the cache once played or
+// warmed.
+std::unique_ptr<MediaSource> CreateFfmpegMediaSource(
+    DecodePool* decode_pool = nullptr, SegmentCache* cache = nullptr);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_FFMPEG_MEDIA_SOURCE_H_
@@ -0,0 +1,223 @@
+#include "ffmpeg_thumbnail_codec.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Packets to read after a seek before giving up on finding a keyframe.
+constexpr int kMaxPacketsPerSeek = 600;
+
+class FfmpegThumbnailCodec : public ThumbnailCodec {
+ public:
+  FfmpegThumbnailCodec()
+      : packet_(av_packet_alloc()), decoded_(av_frame_alloc()) {}
+
+  ~FfmpegThumbnailCodec() override {
+    CloseInput();
+    sws_freeContext(scaler_);
+    av_frame_free(&decoded_);
+    av_packet_free(&packet_);
+  }
+
+  bool DecodeKeyframe(const std::string& url, int64_t time_us,
+                      VideoFrame* frame, std::string* error) override {
+    if (url != url_ && !OpenInput(url, error)) return false;
+    AVStream* stream = input_->streams[stream_index_];
+    const int64_t target = av_rescale_q(start_us_ + time_us,
+                                        AVRational{1, 1000000},
+                                        stream->time_base);
+    if (av_seek_frame(input_, stream_index_, target, AVSEEK_FLAG_BACKWARD) <
+        0) {
+      // Live or unseekable input: take the next keyframe instead.
+      av_seek_frame(input_, stream_index_, target, 0);
+    }
+    avcodec_flush_buffers(decoder_);
+
+    for (int i = 0; i < kMaxPacketsPerSeek; ++i) {
+      if (av_read_frame(input_, packet_) < 0) break;
+      const bool ours = packet_->stream_index == stream_index_;
+      const int sent = ours ? avcodec_send_packet(decoder_, packet_) : 0;
+      av_packet_unref(packet_);
+      if (sent < 0) continue;
+      if (ours && avcodec_receive_frame(decoder_, decoded_) == 0) {
+        const bool converted = Convert(stream, frame);
+        av_frame_unref(decoded_);
+        if (converted) return true;
+        *error = "unsupported pixel format";
+        return false;
+      }
+    }
+    *error = "no keyframe near the requested time";
+    // Forces a clean reopen next time in case the input is broken.
+    CloseInput();
+    return false;
+  }
+
+  bool Duration(const std::string& url, int64_t* duration_us,
+                std::string* error) override {
+    if (url != url_ && !OpenInput(url, error)) return false;
+    if (input_->duration == AV_NOPTS_VALUE || input_->duration <= 0) {
+      *error = "not a VOD stream: " + url;
+      return false;
+    }
+    // AV_TIME_BASE is a microsecond.
+    *duration_us = input_->duration;
+    return true;
+  }
+
+  bool Encode(const VideoFrame& frame, int quality, ThumbnailFormat* format,
+              std::vector<uint8_t>* out, std::string* error) override {
+    const AVCodec* codec = nullptr;
+    if (*format == ThumbnailFormat::kWebp) {
+      codec = avcodec_find_encoder_by_name("libwebp");
+    }
+    if (codec == nullptr) {
+      *format = ThumbnailFormat::kJpeg;
+      codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    }
+    AVCodecContext* context = codec ? avcodec_alloc_context3(codec) : nullptr;
+    AVFrame* picture = av_frame_alloc();
+    bool ok = context != nullptr && picture != nullptr;
+    if (ok) {
+      const bool jpeg = *format == ThumbnailFormat::kJpeg;
+      quality = std::min(100, std::max(1, quality));
+      context->width = frame.width;
+      context->height = frame.height;
+      context->time_base = AVRational{1, 25};
+      // The planes are the same either way; mjpeg only accepts the
+      // full-range tag.
+      context->pix_fmt = jpeg ? AV_PIX_FMT_YUVJ420P : AV_PIX_FMT_YUV420P;
+      if (jpeg) {
+        // Map 1..100 onto mjpeg's quantiser scale, 31 (worst) to 2 (best).
+        const int qscale = 31 - (quality - 1) * 29 / 99;
+        context->flags |= AV_CODEC_FLAG_QSCALE;
+        context->qmin = context->qmax = qscale;
+        picture->quality = FF_QP2LAMBDA * qscale;
+      } else {
+        av_opt_set_double(context->priv_data, "quality", quality, 0);
+      }
+      ok = avcodec_open2(context, codec, nullptr) >= 0;
+    }
+    if (ok) {
+      picture->format = context->pix_fmt;
+      picture->width = frame.width;
+      picture->height = frame.height;
+      picture->data[0] = const_cast<uint8_t*>(frame.y());
+      picture->data[1] = const_cast<uint8_t*>(frame.u());
+      picture->data[2] = const_cast<uint8_t*>(frame.v());
+      picture->linesize[0] = frame.y_stride();
+      picture->linesize[1] = frame.uv_stride();
+      picture->linesize[2] = frame.uv_stride();
+      picture->pts = 0;
+      ok = avcodec_send_frame(context, picture) >= 0 &&
+           avcodec_send_frame(context, nullptr) >= 0 &&
+           avcodec_receive_packet(context, packet_) >= 0;
+    }
+    if (ok) {
+      out->assign(packet_->data, packet_->data + packet_->size);
+      av_packet_unref(packet_);
+    } else {
+      *error = "failed to encode thumbnail";
+    }
+    av_frame_free(&picture);
+    avcodec_free_context(&context);
+    return ok;
+  }
+
+ private:
+  bool OpenInput(const std::string& url, std::string* error) {
+    CloseInput();
+    if (avformat_open_input(&input_, url.c_str(), nullptr, nullptr) < 0 ||
+        avformat_find_stream_info(input_, nullptr) < 0) {
+      *error = "cannot open " + url;
+      CloseInput();
+      return false;
+    }
+    const AVCodec* codec = nullptr;
+    stream_index_ =
+        av_find_best_stream(input_, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (stream_index_ < 0 || codec == nullptr) {
+      *error = "no video stream in " + url;
+      CloseInput();
+      return false;
+    }
+    decoder_ = avcodec_alloc_context3(codec);
+    if (decoder_ == nullptr ||
+        avcodec_parameters_to_context(
+            decoder_, input_->streams[stream_index_]->codecpar) < 0) {
+      *error = "cannot configure decoder";
+      CloseInput();
+      return false;
+    }
+    // Only keyframes are wanted, so the decoder can drop everything else
+    // without reconstructing it.
+    decoder_->skip_frame = AVDISCARD_NONKEY;
+    decoder_->thread_count = 1;
+    if (avcodec_open2(decoder_, codec, nullptr) < 0) {
+      *error = "cannot open decoder";
+      CloseInput();
+      return false;
+    }
+    url_ = url;
+    // Times are from the start of the stream, as the player's are.
+    start_us_ = input_->start_time == AV_NOPTS_VALUE ? 0 : input_->start_time;
+    return true;
+  }
+
+  void CloseInput() {
+    avcodec_free_context(&decoder_);
+    avformat_close_input(&input_);
+    url_.clear();
+    start_us_ = 0;
+    stream_index_ = -1;
+  }
+
+  bool Convert(AVStream* stream, VideoFrame* frame) {
+    const int width = decoded_->width & ~1;
+    const int height = decoded_->height & ~1;
+    if (width <= 0 || height <= 0) return false;
+    scaler_ = sws_getCachedContext(
+        scaler_, width, height,
+        static_cast<AVPixelFormat>(decoded_->format), width, height,
+        AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (scaler_ == nullptr) return false;
+    frame->Allocate(width, height);
+    uint8_t* planes[] = {frame->y(), frame->u(), frame->v()};
+    const int strides[] = {frame->y_stride(), frame->uv_stride(),
+                           frame->uv_stride()};
+    sws_scale(scaler_, decoded_->data, decoded_->linesize, 0, height, planes,
+              strides);
+    const int64_t pts = decoded_->best_effort_timestamp;
+    frame->pts_us = pts == AV_NOPTS_VALUE
+                        ? 0
+                        : av_rescale_q(pts, stream->time_base,
+                                       AVRational{1, 1000000}) - start_us_;
+    return true;
+  }
+
+  AVFormatContext* input_ = nullptr;
+  AVCodecContext* decoder_ = nullptr;
+  int stream_index_ = -1;
+  std::string url_;
+  int64_t start_us_ = 0;
+  AVPacket* packet_;
+  AVFrame* decoded_;
+  SwsContext* scaler_ = nullptr;
+};
+
+}  // namespace
+
+std::unique_ptr<ThumbnailCodec> CreateFfmpegThumbnailCodec() {
+  return std::make_unique<FfmpegThumbnailCodec>();
+}
+
+}  // namespace ivs_broadcaster
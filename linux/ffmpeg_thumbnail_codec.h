@@ -0,0 +1,17 @@
+#ifndef IVS_BROADCASTER_FFMPEG_THUMBNAIL_CODEC_H_
+#define IVS_BROADCASTER_FFMPEG_THUMBNAIL_CODEC_H_
+
+#include <memory>
+
+#include "thumbnail_engine.h"
+
+namespace ivs_broadcaster {
+
+// Decodes keyframes with libavformat/libavcodec and encodes thumbnails with
+// the mjpeg encoder, or libwebp when FFmpeg was built with it. Keeps the
+// last input open so scrubbing through one stream does not reconnect.
+std::unique_ptr<ThumbnailCodec> CreateFfmpegThumbnailCodec();
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_FFMPEG_THUMBNAIL_CODEC_H_
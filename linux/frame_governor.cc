@@ -0,0 +1,131 @@
+#include "frame_governor.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace ivs_broadcaster {
+
+FrameGovernor::FrameGovernor(FrameGovernorConfig config)
+    : config_(std::move(config)) {
+  stats_.target_fps =
+      config_.levels.empty() ? config_.source_fps : config_.levels.front();
+}
+
+bool FrameGovernor::Admit(int64_t capture_pts_us, int64_t* output_pts_us) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (window_start_us_ < 0) window_start_us_ = capture_pts_us;
+  if (capture_pts_us - window_start_us_ >= config_.window_us) {
+    const size_t previous = level_;
+    EndWindow(capture_pts_us);
+    const bool level_changed = level_ != previous && level_changed_;
+    if (window_ended_ || level_changed) {
+      FrameGovernorStats snapshot = stats_;
+      lock.unlock();
+      if (window_ended_) window_ended_(snapshot);
+      if (level_changed) level_changed_(snapshot);
+      lock.lock();
+    }
+  }
+  ++stats_.frames_in;
+
+  // Bresenham-style decimation: emit whenever the accumulated output rate
+  // crosses the source rate, which spreads drops evenly.
+  const int target = std::min(stats_.target_fps, config_.source_fps);
+  accumulator_ += target;
+  if (accumulator_ < config_.source_fps) {
+    ++stats_.frames_dropped;
+    return false;
+  }
+  accumulator_ -= config_.source_fps;
+
+  // Decimation puts kept frames up to one source interval away from the
+  // uniform grid; anything beyond two means the camera clock has drifted.
+  const int64_t max_drift_us = 2 * 1000000 / config_.source_fps;
+  int64_t grid_pts =
+      anchor_pts_us_ + emitted_since_anchor_ * 1000000 / target;
+  // Re-anchor on level changes and whenever the grid has drifted from the
+  // capture clock.
+  if (anchor_pts_us_ < 0 ||
+      std::llabs(grid_pts - capture_pts_us) > max_drift_us) {
+    anchor_pts_us_ = capture_pts_us;
+    emitted_since_anchor_ = 0;
+    grid_pts = capture_pts_us;
+  }
+  ++emitted_since_anchor_;
+  *output_pts_us = grid_pts;
+  return true;
+}
+
+void FrameGovernor::ReportStage(PipelineStage stage, int64_t latency_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = static_cast<size_t>(stage);
+  stage_total_us_[index] += latency_us;
+  ++stage_samples_[index];
+}
+
+void FrameGovernor::ReportQueueDepth(size_t depth) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  window_queue_depth_ = std::max(window_queue_depth_, depth);
+}
+
+int FrameGovernor::target_fps() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_.target_fps;
+}
+
+FrameGovernorStats FrameGovernor::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void FrameGovernor::EndWindow(int64_t now_us) {
+  // Only the stages that run once per encoded frame count against the frame
+  // interval; queue wait is a symptom and is judged through queue depth.
+  int64_t busy_us = 0;
+  for (size_t i = 0; i < kPipelineStageCount; ++i) {
+    stats_.stage_latency_us[i] =
+        stage_samples_[i] > 0 ? stage_total_us_[i] / stage_samples_[i] : 0;
+    if (i != static_cast<size_t>(PipelineStage::kQueue)) {
+      busy_us += stats_.stage_latency_us[i];
+    }
+    stage_total_us_[i] = 0;
+    stage_samples_[i] = 0;
+  }
+  stats_.max_queue_depth = window_queue_depth_;
+  window_queue_depth_ = 0;
+  window_start_us_ = now_us;
+
+  if (config_.levels.empty()) return;
+  const int64_t interval_us = 1000000 / config_.levels[level_];
+  const bool overloaded =
+      busy_us > interval_us * config_.overload_ratio ||
+      stats_.max_queue_depth > config_.max_queue_depth;
+  if (overloaded) {
+    healthy_windows_ = 0;
+    if (level_ + 1 < config_.levels.size()) SetLevel(level_ + 1);
+    return;
+  }
+  if (level_ == 0) return;
+
+  const int64_t higher_interval_us = 1000000 / config_.levels[level_ - 1];
+  const bool healthy = busy_us < higher_interval_us * config_.recover_ratio &&
+                       stats_.max_queue_depth <= 1;
+  healthy_windows_ = healthy ? healthy_windows_ + 1 : 0;
+  if (healthy_windows_ >= config_.recover_windows) {
+    healthy_windows_ = 0;
+    SetLevel(level_ - 1);
+  }
+}
+
+void FrameGovernor::SetLevel(size_t level) {
+  level_ = level;
+  stats_.target_fps = config_.levels[level];
+  ++stats_.level_changes;
+  // Prime the accumulator so the first frame at the new rate is kept.
+  accumulator_ =
+      config_.source_fps - std::min(stats_.target_fps, config_.source_fps);
+  anchor_pts_us_ = -1;
+  emitted_since_anchor_ = 0;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,116 @@
+#ifndef IVS_BROADCASTER_FRAME_GOVERNOR_H_
+#define IVS_BROADCASTER_FRAME_GOVERNOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// Stages of the broadcast pipeline whose latency the governor watches.
+enum class PipelineStage {
+  kCapture,  // Camera read, decode and colour conversion.
+  kQueue,    // Waiting between capture and the encoder.
+  kEncode,
+  kMux,
+};
+
+constexpr size_t kPipelineStageCount = 4;
+
+struct FrameGovernorConfig {
+  int source_fps = 30;
+  // Output rates to step through under load, highest first. Each should
+  // divide evenly into the source cadence or close to it.
+  std::vector<int> levels = {30, 24, 20, 15};
+  // Length of one measurement window.
+  int64_t window_us = 500000;
+  // A window is overloaded when the encode path takes more than this share of
+  // the output frame interval, or the capture queue holds more frames.
+  double overload_ratio = 0.9;
+  size_t max_queue_depth = 2;
+  // A window is healthy enough to step up when the encode path would take
+  // less than this share of the *next higher* level's frame interval.
+  double recover_ratio = 0.6;
+  // Consecutive healthy windows needed before stepping up. Stepping down
+  // happens after a single overloaded window.
+  int recover_windows = 4;
+};
+
+struct FrameGovernorStats {
+  int target_fps = 0;
+  uint64_t frames_in = 0;
+  uint64_t frames_dropped = 0;
+  uint64_t level_changes = 0;
+  // Mean latency per stage over the last completed window.
+  int64_t stage_latency_us[kPipelineStageCount] = {};
+  size_t max_queue_depth = 0;
+};
+
+// Decimates captured frames when the encoder cannot keep up.
+//
+// The governor steps the output rate through |levels| based on per-stage
+// latency and queue depth, recovering with hysteresis. Frames are dropped on
+// an even pattern (e.g. one in five for 30 -> 24 fps) and surviving frames
+// get presentation timestamps on a uniform grid at the output rate so
+// playback does not judder.
+//
+// Admit() and ReportQueueDepth() are called from the encode thread;
+// ReportStage() may be called from any pipeline thread.
+class FrameGovernor {
+ public:
+  using LevelChangedCallback = std::function<void(const FrameGovernorStats&)>;
+  using WindowCallback = std::function<void(const FrameGovernorStats&)>;
+
+  explicit FrameGovernor(FrameGovernorConfig config = FrameGovernorConfig());
+
+  // Called when the output rate changes, on the thread calling Admit().
+  void set_level_changed_callback(LevelChangedCallback callback) {
+    level_changed_ = std::move(callback);
+  }
+
+  // Called with the latest statistics at the end of every measurement
+  // window, before any level change is reported, on the thread calling
+  // Admit(). Drops keep being counted while a level holds, so this is where
+  // statistics should be published from.
+  void set_window_callback(WindowCallback callback) {
+    window_ended_ = std::move(callback);
+  }
+
+  // Decides whether the frame captured at |capture_pts_us| is encoded. When
+  // it is, |output_pts_us| receives its rewritten timestamp.
+  bool Admit(int64_t capture_pts_us, int64_t* output_pts_us);
+
+  void ReportStage(PipelineStage stage, int64_t latency_us);
+  void ReportQueueDepth(size_t depth);
+
+  int target_fps() const;
+  FrameGovernorStats stats() const;
+
+ private:
+  void EndWindow(int64_t now_us);
+  void SetLevel(size_t level);
+
+  const FrameGovernorConfig config_;
+  LevelChangedCallback level_changed_;
+  WindowCallback window_ended_;
+
+  mutable std::mutex mutex_;
+  size_t level_ = 0;
+  int healthy_windows_ = 0;
+  int64_t window_start_us_ = -1;
+  int64_t stage_total_us_[kPipelineStageCount] = {};
+  int64_t stage_samples_[kPipelineStageCount] = {};
+  size_t window_queue_depth_ = 0;
+  FrameGovernorStats stats_;
+
+  // Decimation state, owned by the Admit() caller.
+  int accumulator_ = 0;
+  int64_t anchor_pts_us_ = -1;
+  int64_t emitted_since_anchor_ = 0;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_FRAME_GOVERNOR_H_
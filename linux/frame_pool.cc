@@ -0,0 +1,57 @@
+#include "frame_pool.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+struct FramePool::State {
+  explicit State(size_t max_free) : max_free(max_free) {}
+
+  const size_t max_free;
+  std::mutex mutex;
+  std::vector<std::unique_ptr<VideoFrame>> free;
+  FramePoolStats stats;
+};
+
+FramePool::FramePool(size_t max_free)
+    : state_(std::make_shared<State>(max_free)) {}
+
+FramePool::~FramePool() = default;
+
+std::shared_ptr<VideoFrame> FramePool::Acquire() {
+  std::unique_ptr<VideoFrame> frame;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->free.empty()) {
+      ++state_->stats.allocated;
+    } else {
+      frame = std::move(state_->free.back());
+      state_->free.pop_back();
+      ++state_->stats.reused;
+    }
+  }
+  if (!frame) frame = std::make_unique<VideoFrame>();
+  // Holds the state weakly, so frames still out do not keep it alive.
+  std::weak_ptr<State> weak = state_;
+  return std::shared_ptr<VideoFrame>(
+      frame.release(), [weak = std::move(weak)](VideoFrame* released) {
+        std::unique_ptr<VideoFrame> owned(released);
+        const std::shared_ptr<State> state = weak.lock();
+        if (!state) return;
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->free.size() < state->max_free) {
+          state->free.push_back(std::move(owned));
+        }
+      });
+}
+
+FramePoolStats FramePool::stats() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  FramePoolStats stats = state_->stats;
+  stats.free = state_->free.size();
+  return stats;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,52 @@
+#ifndef IVS_BROADCASTER_FRAME_POOL_H_
+#define IVS_BROADCASTER_FRAME_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+// A decoded frame shared between the player and whoever shows it.
+using FramePtr = std::shared_ptr<const VideoFrame>;
+
+struct FramePoolStats {
+  // Frames made because none was free, and frames handed out again.
+  uint64_t allocated = 0;
+  uint64_t reused = 0;
+  // Frames waiting to be handed out.
+  size_t free = 0;
+};
+
+// Recycles decoded frames, so that steady playback does not allocate.
+//
+// A frame handed out by Acquire() comes back when its last reference goes,
+// e.g. once the renderer has converted it, and keeps the capacity of its
+// planes; VideoFrame::Allocate() of the same size then costs nothing.
+// Thread-safe. Frames may outlive the pool, and are then freed.
+class FramePool {
+ public:
+  // Keeps at most |max_free| frames waiting; the rest are freed.
+  explicit FramePool(size_t max_free = 8);
+  ~FramePool();
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  // A free frame, or a new empty one. Its size and contents are whatever
+  // it held last.
+  std::shared_ptr<VideoFrame> Acquire();
+
+  FramePoolStats stats() const;
+
+ private:
+  struct State;
+
+  const std::shared_ptr<State> state_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_FRAME_POOL_H_
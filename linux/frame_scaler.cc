@@ -0,0 +1,157 @@
+#include "frame_scaler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace ivs_broadcaster {
+
+namespace {
+
+struct Plane {
+  const uint8_t* data;
+  int stride;
+  int width;
+  int height;
+};
+
+void BilinearPlane(const Plane& src, uint8_t* dst, int dst_stride,
+                   int dst_width, int dst_height) {
+  // 16.16 fixed point, sampling at pixel centres.
+  const int64_t step_x = (static_cast<int64_t>(src.width) << 16) / dst_width;
+  const int64_t step_y = (static_cast<int64_t>(src.height) << 16) / dst_height;
+  for (int y = 0; y < dst_height; ++y) {
+    const int64_t fy = std::max<int64_t>(0, y * step_y + step_y / 2 - 0x8000);
+    const int y0 = std::min(static_cast<int>(fy >> 16), src.height - 1);
+    const int y1 = std::min(y0 + 1, src.height - 1);
+    const int wy = static_cast<int>((fy >> 8) & 0xff);
+    const uint8_t* row0 = src.data + static_cast<size_t>(y0) * src.stride;
+    const uint8_t* row1 = src.data + static_cast<size_t>(y1) * src.stride;
+    uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+    for (int x = 0; x < dst_width; ++x) {
+      const int64_t fx =
+          std::max<int64_t>(0, x * step_x + step_x / 2 - 0x8000);
+      const int x0 = std::min(static_cast<int>(fx >> 16), src.width - 1);
+      const int x1 = std::min(x0 + 1, src.width - 1);
+      const int wx = static_cast<int>((fx >> 8) & 0xff);
+      const int top = row0[x0] * (256 - wx) + row0[x1] * wx;
+      const int bottom = row1[x0] * (256 - wx) + row1[x1] * wx;
+      out[x] = static_cast<uint8_t>(
+          (top * (256 - wy) + bottom * wy + (1 << 15)) >> 16);
+    }
+  }
+}
+
+void ScalePlane(Plane src, uint8_t* dst, int dst_stride, int dst_width,
+                int dst_height) {
+  std::vector<uint8_t> scratch[2];
+  int current = 0;
+  while (src.width >= 2 * dst_width && src.height >= 2 * dst_height) {
+    const int width = src.width / 2;
+    const int height = src.height / 2;
+    std::vector<uint8_t>& next = scratch[current];
+    next.resize(static_cast<size_t>(width) * height);
+    HalvePlane(src.data, src.stride, src.width, src.height, next.data(),
+               width);
+    src = Plane{next.data(), width, width, height};
+    current ^= 1;
+  }
+  if (src.width == dst_width && src.height == dst_height) {
+    for (int y = 0; y < dst_height; ++y) {
+      std::copy(src.data + static_cast<size_t>(y) * src.stride,
+                src.data + static_cast<size_t>(y) * src.stride + dst_width,
+                dst + static_cast<size_t>(y) * dst_stride);
+    }
+    return;
+  }
+  BilinearPlane(src, dst, dst_stride, dst_width, dst_height);
+}
+
+}  // namespace
+
+void HalvePlane(const uint8_t* src, int src_stride, int width, int height,
+                uint8_t* dst, int dst_stride) {
+  const int out_width = width / 2;
+  const int out_height = height / 2;
+  for (int y = 0; y < out_height; ++y) {
+    const uint8_t* row0 = src + static_cast<size_t>(2 * y) * src_stride;
+    const uint8_t* row1 = row0 + src_stride;
+    uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 16 <= out_width; x += 16) {
+      const __m128i a0 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x));
+      const __m128i a1 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 2 * x + 16));
+      const __m128i b0 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x));
+      const __m128i b1 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 2 * x + 16));
+      // Sums of the four corners in 16-bit lanes, rounded once like the
+      // scalar tail; chained byte averages would round up twice.
+      const __m128i s0 = _mm_add_epi16(
+          _mm_add_epi16(_mm_and_si128(a0, low_bytes), _mm_srli_epi16(a0, 8)),
+          _mm_add_epi16(_mm_and_si128(b0, low_bytes), _mm_srli_epi16(b0, 8)));
+      const __m128i s1 = _mm_add_epi16(
+          _mm_add_epi16(_mm_and_si128(a1, low_bytes), _mm_srli_epi16(a1, 8)),
+          _mm_add_epi16(_mm_and_si128(b1, low_bytes), _mm_srli_epi16(b1, 8)));
+      const __m128i h0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+      const __m128i h1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                       _mm_packus_epi16(h0, h1));
+    }
+#elif defined(__aarch64__)
+    for (; x + 16 <= out_width; x += 16) {
+      // Pairwise widening adds give the horizontal sums; the rounding
+      // narrowing shift adds 2 before dividing by 4, once.
+      const uint16x8_t s0 = vaddq_u16(vpaddlq_u8(vld1q_u8(row0 + 2 * x)),
+                                      vpaddlq_u8(vld1q_u8(row1 + 2 * x)));
+      const uint16x8_t s1 =
+          vaddq_u16(vpaddlq_u8(vld1q_u8(row0 + 2 * x + 16)),
+                    vpaddlq_u8(vld1q_u8(row1 + 2 * x + 16)));
+      vst1q_u8(out + x,
+               vcombine_u8(vrshrn_n_u16(s0, 2), vrshrn_n_u16(s1, 2)));
+    }
+#endif
+    for (; x < out_width; ++x) {
+      out[x] = static_cast<uint8_t>(
+          (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) /
+          4);
+    }
+  }
+}
+
+void ScaleFrame(const VideoFrame& src, VideoFrame* dst) {
+  ScalePlane(Plane{src.y(), src.y_stride(), src.width, src.height}, dst->y(),
+             dst->y_stride(), dst->width, dst->height);
+  const int src_uv_width = src.uv_stride();
+  const int dst_uv_width = dst->uv_stride();
+  ScalePlane(Plane{src.u(), src.uv_stride(), src_uv_width, src.uv_height()},
+             dst->u(), dst->uv_stride(), dst_uv_width, dst->uv_height());
+  ScalePlane(Plane{src.v(), src.uv_stride(), src_uv_width, src.uv_height()},
+             dst->v(), dst->uv_stride(), dst_uv_width, dst->uv_height());
+}
+
+void FitWithin(int src_width, int src_height, int max_width, int max_height,
+               int* width, int* height) {
+  double scale = 1.0;
+  if (max_width > 0) {
+    scale = std::min(scale, static_cast<double>(max_width) / src_width);
+  }
+  if (max_height > 0) {
+    scale = std::min(scale, static_cast<double>(max_height) / src_height);
+  }
+  *width = std::max(2, static_cast<int>(src_width * scale) & ~1);
+  *height = std::max(2, static_cast<int>(src_height * scale) & ~1);
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,30 @@
+#ifndef IVS_BROADCASTER_FRAME_SCALER_H_
+#define IVS_BROADCASTER_FRAME_SCALER_H_
+
+#include <cstdint>
+
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+// Halves a plane in both directions by averaging 2x2 blocks, 16 output
+// pixels at a time with SSE2 or NEON. |dst| holds (width / 2) x
+// (height / 2) pixels; an odd last column or row is dropped.
+void HalvePlane(const uint8_t* src, int src_stride, int width, int height,
+                uint8_t* dst, int dst_stride);
+
+// Downscales |src| into |dst|, which must already be allocated at the target
+// size. Repeated SIMD halving does the bulk of a large reduction, so every
+// source pixel contributes; the last step, by a factor below two, is
+// bilinear. Upscaling falls back to bilinear alone.
+void ScaleFrame(const VideoFrame& src, VideoFrame* dst);
+
+// The largest size with |src_width| x |src_height|'s aspect ratio that fits
+// in |max_width| x |max_height|, rounded down to even numbers for I420.
+// Either bound may be zero to leave that dimension unconstrained.
+void FitWithin(int src_width, int src_height, int max_width, int max_height,
+               int* width, int* height);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_FRAME_SCALER_H_
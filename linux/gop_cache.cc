@@ -0,0 +1,93 @@
+#include "gop_cache.h"
+
+#include <utility>
+
+namespace ivs_broadcaster {
+
+GopCache::GopCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+void GopCache::Append(const std::string& id, SharedPacket packet) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stream& stream = streams_[id];
+  if (packet->keyframe) {
+    if (stream.packets.empty()) ++stats_.streams;
+    stats_.bytes -= stream.bytes;
+    stream.packets.clear();
+    stream.bytes = 0;
+  } else if (stream.packets.empty()) {
+    // Useless without the keyframe it depends on.
+    return;
+  }
+  stream.bytes += packet->data.size();
+  stats_.bytes += packet->data.size();
+  stream.packets.push_back(std::move(packet));
+  EvictLocked();
+}
+
+std::vector<SharedPacket> GopCache::Get(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = streams_.find(id);
+  return it == streams_.end() ? std::vector<SharedPacket>()
+                              : it->second.packets;
+}
+
+void GopCache::SetRank(const std::string& id, int rank) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  streams_[id].rank = rank;
+}
+
+void GopCache::Remove(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = streams_.find(id);
+  if (it == streams_.end()) return;
+  if (!it->second.packets.empty()) --stats_.streams;
+  stats_.bytes -= it->second.bytes;
+  streams_.erase(it);
+}
+
+size_t GopCache::Drop(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = streams_.find(id);
+  if (it == streams_.end() || it->second.packets.empty()) return 0;
+  const size_t freed = it->second.bytes;
+  stats_.bytes -= freed;
+  --stats_.streams;
+  ++stats_.evictions;
+  it->second.packets.clear();
+  it->second.bytes = 0;
+  return freed;
+}
+
+size_t GopCache::bytes(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = streams_.find(id);
+  return it == streams_.end() ? 0 : it->second.bytes;
+}
+
+GopCacheStats GopCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void GopCache::EvictLocked() {
+  while (stats_.bytes > max_bytes_) {
+    Stream* victim = nullptr;
+    for (auto& entry : streams_) {
+      Stream& stream = entry.second;
+      if (stream.packets.empty()) continue;
+      // Highest rank first; among equals the biggest frees the most.
+      if (victim == nullptr || stream.rank > victim->rank ||
+          (stream.rank == victim->rank && stream.bytes > victim->bytes)) {
+        victim = &stream;
+      }
+    }
+    if (victim == nullptr) return;
+    stats_.bytes -= victim->bytes;
+    --stats_.streams;
+    ++stats_.evictions;
+    victim->packets.clear();
+    victim->bytes = 0;
+  }
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,82 @@
+#ifndef IVS_BROADCASTER_GOP_CACHE_H_
+#define IVS_BROADCASTER_GOP_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "media_player.h"
+
+namespace ivs_broadcaster {
+
+using SharedPacket = std::shared_ptr<const MediaPacket>;
+
+struct GopCacheStats {
+  size_t bytes = 0;
+  // Streams holding a complete GOP.
+  size_t streams = 0;
+  // GOPs dropped to stay within the budget.
+  uint64_t evictions = 0;
+};
+
+// Keeps the latest group of pictures of each stream, from its keyframe up to
+// the newest packet, so a player can start decoding a stream it has been
+// skipping without waiting for the next keyframe.
+//
+// All streams share one byte budget. When it is exceeded, whole GOPs are
+// dropped starting with the stream of the highest rank; a stream that lost
+// its GOP is cached again from its next keyframe. Thread-safe.
+class GopCache {
+ public:
+  explicit GopCache(size_t max_bytes);
+
+  GopCache(const GopCache&) = delete;
+  GopCache& operator=(const GopCache&) = delete;
+
+  // Adds the next video packet of stream |id|. A keyframe replaces the
+  // cached GOP; other packets extend it, or are ignored while the stream has
+  // no keyframe cached.
+  void Append(const std::string& id, SharedPacket packet);
+
+  // The cached GOP of |id|, keyframe first, or nothing. The packets are
+  // shared, not copied.
+  std::vector<SharedPacket> Get(const std::string& id) const;
+
+  // Streams with a lower rank keep their GOP longer. Unranked streams go
+  // first.
+  void SetRank(const std::string& id, int rank);
+
+  void Remove(const std::string& id);
+
+  // Drops the cached GOP of |id| but keeps its rank; the stream is cached
+  // again from its next keyframe. Returns the bytes freed.
+  size_t Drop(const std::string& id);
+
+  size_t bytes(const std::string& id) const;
+  GopCacheStats stats() const;
+
+ private:
+  struct Stream {
+    std::vector<SharedPacket> packets;
+    size_t bytes = 0;
+    int rank = kUnranked;
+  };
+
+  static constexpr int kUnranked = 1 << 30;
+
+  void EvictLocked();
+
+  const size_t max_bytes_;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Stream> streams_;
+  GopCacheStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_GOP_CACHE_H_
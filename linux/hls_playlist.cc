@@ -0,0 +1,823 @@
+#include "hls_playlist.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+std::string_view Trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t' ||
+                           text.back() == '\r')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+bool ParseInt(std::string_view text, int64_t* value) {
+  text = Trim(text);
+  if (text.empty()) return false;
+  const char* end = text.data() + text.size();
+  auto result = std::from_chars(text.data(), end, *value);
+  return result.ec == std::errc() && result.ptr == end;
+}
+
+// A decimal-floating-point number of seconds, in microseconds.
+bool ParseSecondsUs(std::string_view text, int64_t* us) {
+  text = Trim(text);
+  int64_t whole = 0;
+  int64_t fraction = 0;
+  int64_t scale = 1000000;
+  size_t i = 0;
+  for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+    whole = whole * 10 + (text[i] - '0');
+  }
+  if (i == 0) return false;
+  if (i < text.size() && text[i] == '.') {
+    for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+      if (scale > 1) {
+        scale /= 10;
+        fraction += (text[i] - '0') * scale;
+      }
+    }
+  }
+  if (i != text.size()) return false;
+  *us = whole * 1000000 + fraction;
+  return true;
+}
+
+// <length>[@<offset>]; the offset is -1 when it is left out.
+bool ParseByteRange(std::string_view text, HlsByteRange* range) {
+  const size_t at = text.find('@');
+  if (!ParseInt(text.substr(0, at), &range->length) || range->length < 0) {
+    return false;
+  }
+  range->offset = -1;
+  return at == std::string_view::npos ||
+         (ParseInt(text.substr(at + 1), &range->offset) && range->offset >= 0);
+}
+
+bool Digits(std::string_view text, size_t pos, size_t count, int* value) {
+  if (pos + count > text.size()) return false;
+  *value = 0;
+  for (size_t i = pos; i < pos + count; ++i) {
+    if (text[i] < '0' || text[i] > '9') return false;
+    *value = *value * 10 + (text[i] - '0');
+  }
+  return true;
+}
+
+// Days from 1970-01-01 to the given proleptic Gregorian date.
+int64_t DaysFromCivil(int64_t year, int month, int day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t year_of_era = year - era * 400;
+  const int64_t day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int64_t day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+bool SameRange(const HlsByteRange& a, const HlsByteRange& b) {
+  return a.length == b.length && (a.length < 0 || a.offset == b.offset);
+}
+
+}  // namespace
+
+int64_t HlsMediaPlaylist::media_sequence() const {
+  return segments.empty() ? 0 : segments.front().sequence;
+}
+
+int64_t HlsMediaPlaylist::next_sequence() const {
+  return segments.empty() ? 0 : segments.back().sequence + 1;
+}
+
+const HlsSegment* HlsMediaPlaylist::Find(int64_t sequence) const {
+  if (segments.empty() || sequence < segments.front().sequence ||
+      sequence > segments.back().sequence) {
+    return nullptr;
+  }
+  return &segments[sequence - segments.front().sequence];
+}
+
+bool HlsAttributeReader::Next(std::string_view* name,
+                              std::string_view* value) {
+  if (!ok_) return false;
+  list_ = Trim(list_);
+  if (list_.empty()) return false;
+  const size_t equals = list_.find('=');
+  if (equals == std::string_view::npos || equals == 0) {
+    ok_ = false;
+    return false;
+  }
+  *name = Trim(list_.substr(0, equals));
+  list_.remove_prefix(equals + 1);
+  if (!list_.empty() && list_.front() == '"') {
+    const size_t close = list_.find('"', 1);
+    if (close == std::string_view::npos) {
+      ok_ = false;
+      return false;
+    }
+    *value = list_.substr(1, close - 1);
+    list_ = Trim(list_.substr(close + 1));
+    if (!list_.empty()) {
+      if (list_.front() != ',') {
+        ok_ = false;
+        return false;
+      }
+      list_.remove_prefix(1);
+    }
+    return true;
+  }
+  const size_t comma = list_.find(',');
+  *value = Trim(list_.substr(0, comma));
+  list_.remove_prefix(comma == std::string_view::npos ? list_.size()
+                                                      : comma + 1);
+  return true;
+}
+
+HlsPlaylistParser::HlsPlaylistParser(HlsMediaPlaylist* playlist)
+    : playlist_(playlist),
+      previous_next_sequence_(playlist->next_sequence()),
+      previous_pending_parts_(playlist->pending_parts.size()) {}
+
+bool HlsPlaylistParser::Feed(std::string_view data) {
+  if (failed_ || finished_) return false;
+  if (!partial_.empty()) {
+    const size_t end = data.find('\n');
+    if (end == std::string_view::npos) {
+      partial_.append(data);
+      return true;
+    }
+    partial_.append(data.substr(0, end));
+    const bool ok = ParseLine(partial_);
+    partial_.clear();
+    if (!ok) return false;
+    data.remove_prefix(end + 1);
+  }
+  size_t end;
+  while ((end = data.find('\n')) != std::string_view::npos) {
+    if (!ParseLine(data.substr(0, end))) return false;
+    data.remove_prefix(end + 1);
+  }
+  partial_.assign(data);
+  return true;
+}
+
+bool HlsPlaylistParser::Finish() {
+  if (failed_ || finished_) return !failed_;
+  if (!partial_.empty()) {
+    std::string line;
+    line.swap(partial_);
+    if (!ParseLine(line)) return false;
+  }
+  if (!saw_header_) return Fail("empty playlist");
+  if (target_duration_us_ < 0) return Fail("missing EXT-X-TARGETDURATION");
+  if (!segments_begun_ && !BeginSegments()) return false;
+  finished_ = true;
+
+  std::deque<HlsSegment>& segments = playlist_->segments;
+  while (!segments.empty() && segments.front().sequence < media_sequence_) {
+    playlist_->duration_us -= segments.front().duration_us;
+    segments.pop_front();
+    ++stats_.removed;
+  }
+  while (!segments.empty() && segments.back().sequence >= next_sequence_) {
+    playlist_->duration_us -= segments.back().duration_us;
+    segments.pop_back();
+    ++stats_.removed;
+  }
+  stats_.skipped = skipped_segments_;
+
+  playlist_->version = version_;
+  playlist_->type = type_;
+  playlist_->target_duration_us = target_duration_us_;
+  playlist_->discontinuity_sequence =
+      segments.empty() ? discontinuity_sequence_
+                       : segments.front().discontinuity_sequence;
+  playlist_->end_list = end_list_;
+  playlist_->independent_segments = independent_segments_;
+  playlist_->server_control = server_control_;
+  playlist_->part_target_us = part_target_us_;
+  if (next_sequence_ != previous_next_sequence_) {
+    stats_.parts_added = static_cast<int64_t>(parts_.size());
+  } else if (parts_.size() > previous_pending_parts_) {
+    stats_.parts_added =
+        static_cast<int64_t>(parts_.size() - previous_pending_parts_);
+  }
+  playlist_->pending_parts = std::move(parts_);
+  playlist_->preload_hint = std::move(preload_hint_);
+  playlist_->rendition_reports = std::move(rendition_reports_);
+  return true;
+}
+
+bool HlsPlaylistParser::ParseLine(std::string_view line) {
+  ++line_;
+  line = Trim(line);
+  if (!saw_header_) {
+    if (line.substr(0, 3) == "\xEF\xBB\xBF") line.remove_prefix(3);
+    if (line != "#EXTM3U") return Fail("missing #EXTM3U");
+    saw_header_ = true;
+    return true;
+  }
+  if (line.empty()) return true;
+  if (line.front() != '#') return AddSegment(line);
+  // Lines starting with # but not #EXT are comments.
+  if (line.substr(0, 4) != "#EXT") return true;
+  line.remove_prefix(1);
+  const size_t colon = line.find(':');
+  if (colon == std::string_view::npos) return ParseTag(line, {});
+  return ParseTag(line.substr(0, colon), line.substr(colon + 1));
+}
+
+bool HlsPlaylistParser::ParseTag(std::string_view name,
+                                 std::string_view value) {
+  // Roughly in order of how often they appear.
+  if (name == "EXTINF") {
+    if (!ParseSecondsUs(value.substr(0, value.find(',')), &duration_us_)) {
+      return Fail("bad EXTINF");
+    }
+    has_duration_ = true;
+    return true;
+  }
+  if (name == "EXT-X-PROGRAM-DATE-TIME") {
+    if (!ParseHlsDateTime(value, &program_date_time_ms_)) {
+      return Fail("bad EXT-X-PROGRAM-DATE-TIME");
+    }
+    return true;
+  }
+  if (name == "EXT-X-BYTERANGE") {
+    if (!ParseByteRange(value, &byte_range_)) {
+      return Fail("bad EXT-X-BYTERANGE");
+    }
+    has_byte_range_ = true;
+    return true;
+  }
+  if (name == "EXT-X-PART") return ParsePart(value);
+  if (name == "EXT-X-DISCONTINUITY") {
+    discontinuity_ = true;
+    return true;
+  }
+  if (name == "EXT-X-GAP") {
+    gap_ = true;
+    return true;
+  }
+  if (name == "EXT-X-KEY") return ParseKey(value);
+  if (name == "EXT-X-MAP") return ParseMap(value);
+  if (name == "EXT-X-TARGETDURATION") {
+    int64_t seconds;
+    if (!ParseInt(value, &seconds) || seconds <= 0) {
+      return Fail("bad EXT-X-TARGETDURATION");
+    }
+    target_duration_us_ = seconds * 1000000;
+    return true;
+  }
+  if (name == "EXT-X-MEDIA-SEQUENCE") {
+    if (segments_begun_ || !ParseInt(value, &media_sequence_) ||
+        media_sequence_ < 0) {
+      return Fail("bad EXT-X-MEDIA-SEQUENCE");
+    }
+    return true;
+  }
+  if (name == "EXT-X-DISCONTINUITY-SEQUENCE") {
+    if (segments_begun_ || !ParseInt(value, &discontinuity_sequence_) ||
+        discontinuity_sequence_ < 0) {
+      return Fail("bad EXT-X-DISCONTINUITY-SEQUENCE");
+    }
+    return true;
+  }
+  if (name == "EXT-X-SKIP") return ParseSkip(value);
+  if (name == "EXT-X-ENDLIST") {
+    end_list_ = true;
+    return true;
+  }
+  if (name == "EXT-X-SERVER-CONTROL") return ParseServerControl(value);
+  if (name == "EXT-X-PRELOAD-HINT") return ParsePreloadHint(value);
+  if (name == "EXT-X-RENDITION-REPORT") return ParseRenditionReport(value);
+  if (name == "EXT-X-PART-INF") {
+    std::string_view attribute, seconds;
+    HlsAttributeReader reader(value);
+    while (reader.Next(&attribute, &seconds)) {
+      if (attribute == "PART-TARGET" &&
+          !ParseSecondsUs(seconds, &part_target_us_)) {
+        return Fail("bad EXT-X-PART-INF");
+      }
+    }
+    return reader.ok() || Fail("bad EXT-X-PART-INF");
+  }
+  if (name == "EXT-X-PLAYLIST-TYPE") {
+    if (value == "EVENT") {
+      type_ = HlsPlaylistType::kEvent;
+    } else if (value == "VOD") {
+      type_ = HlsPlaylistType::kVod;
+    } else {
+      return Fail("bad EXT-X-PLAYLIST-TYPE");
+    }
+    return true;
+  }
+  if (name == "EXT-X-VERSION") {
+    int64_t version;
+    if (!ParseInt(value, &version)) return Fail("bad EXT-X-VERSION");
+    version_ = static_cast<int>(version);
+    return true;
+  }
+  if (name == "EXT-X-INDEPENDENT-SEGMENTS") {
+    independent_segments_ = true;
+    return true;
+  }
+  if (name == "EXT-X-STREAM-INF" || name == "EXT-X-I-FRAME-STREAM-INF") {
+    return Fail("not a media playlist");
+  }
+  // Clients must ignore tags they do not know.
+  return true;
+}
+
+bool HlsPlaylistParser::ParseKey(std::string_view attributes) {
+  std::string_view method, uri, iv, name, value;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    if (name == "METHOD") {
+      method = value;
+    } else if (name == "URI") {
+      uri = value;
+    } else if (name == "IV") {
+      iv = value;
+    }
+  }
+  if (!reader.ok() || method.empty()) return Fail("bad EXT-X-KEY");
+  if (method == "NONE") {
+    key_.reset();
+    return true;
+  }
+  // Live playlists repeat the same key in every refresh; only a rotation
+  // allocates.
+  if (!key_ || key_->method != method || key_->uri != uri || key_->iv != iv) {
+    key_ = std::make_shared<const HlsKey>(
+        HlsKey{std::string(method), std::string(uri), std::string(iv)});
+  }
+  return true;
+}
+
+bool HlsPlaylistParser::ParseMap(std::string_view attributes) {
+  std::string_view uri, name, value;
+  HlsByteRange range;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    if (name == "URI") {
+      uri = value;
+    } else if (name == "BYTERANGE") {
+      if (!ParseByteRange(value, &range)) return Fail("bad EXT-X-MAP");
+      if (range.offset < 0) range.offset = 0;
+    }
+  }
+  if (!reader.ok() || uri.empty()) return Fail("bad EXT-X-MAP");
+  if (!map_ || map_->uri != uri || !SameRange(map_->byte_range, range)) {
+    map_ = std::make_shared<const HlsMap>(HlsMap{std::string(uri), range});
+  }
+  return true;
+}
+
+bool HlsPlaylistParser::ParseServerControl(std::string_view attributes) {
+  std::string_view name, value;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    bool ok = true;
+    if (name == "CAN-SKIP-UNTIL") {
+      ok = ParseSecondsUs(value, &server_control_.can_skip_until_us);
+    } else if (name == "CAN-SKIP-DATERANGES") {
+      server_control_.can_skip_dateranges = value == "YES";
+    } else if (name == "CAN-BLOCK-RELOAD") {
+      server_control_.can_block_reload = value == "YES";
+    } else if (name == "HOLD-BACK") {
+      ok = ParseSecondsUs(value, &server_control_.hold_back_us);
+    } else if (name == "PART-HOLD-BACK") {
+      ok = ParseSecondsUs(value, &server_control_.part_hold_back_us);
+    }
+    if (!ok) return Fail("bad EXT-X-SERVER-CONTROL");
+  }
+  return reader.ok() || Fail("bad EXT-X-SERVER-CONTROL");
+}
+
+bool HlsPlaylistParser::ParseSkip(std::string_view attributes) {
+  if (segments_begun_) return Fail("EXT-X-SKIP after the first segment");
+  std::string_view name, value;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    if (name == "SKIPPED-SEGMENTS" &&
+        (!ParseInt(value, &skipped_segments_) || skipped_segments_ < 0)) {
+      return Fail("bad EXT-X-SKIP");
+    }
+  }
+  if (!reader.ok()) return Fail("bad EXT-X-SKIP");
+  return BeginSegments();
+}
+
+bool HlsPlaylistParser::ParsePart(std::string_view attributes) {
+  HlsPart part;
+  bool has_duration = false;
+  bool has_range = false;
+  std::string_view uri, name, value;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    bool ok = true;
+    if (name == "DURATION") {
+      ok = has_duration = ParseSecondsUs(value, &part.duration_us);
+    } else if (name == "URI") {
+      uri = value;
+    } else if (name == "INDEPENDENT") {
+      part.independent = value == "YES";
+    } else if (name == "GAP") {
+      part.gap = value == "YES";
+    } else if (name == "BYTERANGE") {
+      ok = has_range = ParseByteRange(value, &part.byte_range);
+    }
+    if (!ok) return Fail("bad EXT-X-PART");
+  }
+  if (!reader.ok() || !has_duration || uri.empty()) {
+    return Fail("bad EXT-X-PART");
+  }
+  part.uri.assign(uri);
+  if (has_range) {
+    // Without an offset a part follows the previous part of its resource.
+    if (part.byte_range.offset < 0) {
+      part.byte_range.offset = part_uri_end_ == uri ? part_range_end_ : 0;
+    }
+    part_uri_end_ = part.uri;
+    part_range_end_ = part.byte_range.offset + part.byte_range.length;
+  }
+  parts_.push_back(std::move(part));
+  return true;
+}
+
+bool HlsPlaylistParser::ParsePreloadHint(std::string_view attributes) {
+  HlsPreloadHint hint;
+  int64_t start = 0;
+  int64_t length = -1;
+  std::string_view type, uri, name, value;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    bool ok = true;
+    if (name == "TYPE") {
+      type = value;
+    } else if (name == "URI") {
+      uri = value;
+    } else if (name == "BYTERANGE-START") {
+      ok = ParseInt(value, &start) && start >= 0;
+    } else if (name == "BYTERANGE-LENGTH") {
+      ok = ParseInt(value, &length) && length >= 0;
+    }
+    if (!ok) return Fail("bad EXT-X-PRELOAD-HINT");
+  }
+  if (!reader.ok() || uri.empty() || (type != "PART" && type != "MAP")) {
+    return Fail("bad EXT-X-PRELOAD-HINT");
+  }
+  // Only the part hint matters for reading ahead; a map hint is kept if
+  // it is the only one.
+  if (type == "MAP" && !preload_hint_.uri.empty()) return true;
+  preload_hint_.type =
+      type == "MAP" ? HlsPreloadHint::Type::kMap : HlsPreloadHint::Type::kPart;
+  preload_hint_.uri.assign(uri);
+  preload_hint_.byte_range.offset = start;
+  preload_hint_.byte_range.length = length;
+  return true;
+}
+
+bool HlsPlaylistParser::ParseRenditionReport(std::string_view attributes) {
+  HlsRenditionReport report;
+  std::string_view name, value;
+  HlsAttributeReader reader(attributes);
+  while (reader.Next(&name, &value)) {
+    bool ok = true;
+    if (name == "URI") {
+      report.uri.assign(value);
+    } else if (name == "LAST-MSN") {
+      ok = ParseInt(value, &report.last_msn);
+    } else if (name == "LAST-PART") {
+      ok = ParseInt(value, &report.last_part);
+    }
+    if (!ok) return Fail("bad EXT-X-RENDITION-REPORT");
+  }
+  if (!reader.ok() || report.uri.empty()) {
+    return Fail("bad EXT-X-RENDITION-REPORT");
+  }
+  rendition_reports_.push_back(std::move(report));
+  return true;
+}
+
+bool HlsPlaylistParser::BeginSegments() {
+  segments_begun_ = true;
+  std::deque<HlsSegment>& segments = playlist_->segments;
+  const int64_t first_listed = media_sequence_ + skipped_segments_;
+  if (skipped_segments_ > 0) {
+    // A delta update only makes sense against the version it was asked
+    // for; the skipped segments must all still be here.
+    if (segments.empty() || media_sequence_ < segments.front().sequence ||
+        first_listed > playlist_->next_sequence()) {
+      return Fail("delta update does not match the previous playlist");
+    }
+    // Carry over the state the skipped tags would have set.
+    const HlsSegment& last = *playlist_->Find(first_listed - 1);
+    running_discontinuity_ = last.discontinuity_sequence;
+    range_end_ = last.byte_range.length < 0
+                     ? 0
+                     : last.byte_range.offset + last.byte_range.length;
+    last_program_date_time_ms_ = last.program_date_time_ms;
+    last_duration_us_ = last.duration_us;
+    key_ = last.key;
+    map_ = last.map;
+  } else {
+    running_discontinuity_ = discontinuity_sequence_;
+    // Sequence numbers went backwards (the origin restarted) or jumped
+    // past everything we hold (we fell behind): nothing can be reused.
+    if (!segments.empty() && (media_sequence_ < segments.front().sequence ||
+                              media_sequence_ > playlist_->next_sequence())) {
+      segments.clear();
+      playlist_->duration_us = 0;
+      stats_.reset = true;
+    }
+  }
+  next_sequence_ = first_listed;
+  return true;
+}
+
+bool HlsPlaylistParser::AddSegment(std::string_view uri) {
+  if (!has_duration_) return Fail("segment without EXTINF");
+  if (!segments_begun_ && !BeginSegments()) return false;
+
+  // The first segment of a full playlist has the advertised discontinuity
+  // sequence whatever precedes it.
+  if (discontinuity_ && (listed_ > 0 || skipped_segments_ > 0)) {
+    ++running_discontinuity_;
+  }
+  HlsByteRange range;
+  if (has_byte_range_) {
+    range = byte_range_;
+    if (range.offset < 0) range.offset = range_end_;
+    range_end_ = range.offset + range.length;
+  }
+  int64_t program_date_time_ms = program_date_time_ms_;
+  if (program_date_time_ms < 0 && last_program_date_time_ms_ >= 0) {
+    program_date_time_ms =
+        last_program_date_time_ms_ + last_duration_us_ / 1000;
+  }
+
+  std::deque<HlsSegment>& segments = playlist_->segments;
+  const int64_t sequence = next_sequence_++;
+  HlsSegment* segment;
+  if (!segments.empty() && sequence < playlist_->next_sequence()) {
+    segment = &segments[sequence - segments.front().sequence];
+    if (segment->uri == uri && SameRange(segment->byte_range, range)) {
+      ++stats_.reused;
+      EndSegment(*segment);
+      return true;
+    }
+    playlist_->duration_us -= segment->duration_us;
+    ++stats_.replaced;
+  } else {
+    segments.emplace_back();
+    segment = &segments.back();
+    ++stats_.added;
+  }
+  segment->sequence = sequence;
+  segment->discontinuity_sequence = running_discontinuity_;
+  segment->duration_us = duration_us_;
+  segment->uri.assign(uri);
+  segment->byte_range = range;
+  segment->discontinuity = discontinuity_;
+  segment->gap = gap_;
+  segment->program_date_time_ms = program_date_time_ms;
+  segment->key = key_;
+  segment->map = map_;
+  segment->parts = std::move(parts_);
+  playlist_->duration_us += duration_us_;
+  EndSegment(*segment);
+  return true;
+}
+
+void HlsPlaylistParser::EndSegment(const HlsSegment& segment) {
+  last_program_date_time_ms_ = segment.program_date_time_ms;
+  last_duration_us_ = segment.duration_us;
+  ++listed_;
+  has_duration_ = false;
+  discontinuity_ = false;
+  gap_ = false;
+  has_byte_range_ = false;
+  program_date_time_ms_ = -1;
+  // Those of a segment seen before are kept from the previous version.
+  parts_.clear();
+}
+
+bool HlsPlaylistParser::Fail(const std::string& message) {
+  failed_ = true;
+  error_ = "line " + std::to_string(line_) + ": " + message;
+  *playlist_ = HlsMediaPlaylist();
+  return false;
+}
+
+bool ParseHlsPlaylist(std::string_view text, HlsMediaPlaylist* playlist,
+                      HlsUpdateStats* stats, std::string* error) {
+  HlsPlaylistParser parser(playlist);
+  const bool ok = parser.Feed(text) && parser.Finish();
+  if (stats != nullptr) *stats = parser.stats();
+  if (!ok && error != nullptr) *error = parser.error();
+  return ok;
+}
+
+std::string HlsReloadUrl(const std::string& url,
+                         const HlsMediaPlaylist& playlist, int64_t age_us) {
+  const HlsServerControl& control = playlist.server_control;
+  if (playlist.end_list || playlist.segments.empty()) return url;
+  // In lexical order, as servers expect for cache hits.
+  std::string directives;
+  if (control.can_block_reload) {
+    directives = "_HLS_msn=" + std::to_string(playlist.next_sequence());
+    if (playlist.part_target_us > 0) {
+      directives +=
+          "&_HLS_part=" + std::to_string(playlist.pending_parts.size());
+    }
+  }
+  if (control.can_skip_until_us > 0 &&
+      age_us <= control.can_skip_until_us / 2) {
+    if (!directives.empty()) directives += '&';
+    directives +=
+        control.can_skip_dateranges ? "_HLS_skip=v2" : "_HLS_skip=YES";
+  }
+  if (directives.empty()) return url;
+  const size_t fragment = url.find('#');
+  const size_t query_end = fragment == std::string::npos ? url.size()
+                                                          : fragment;
+  const bool has_query = url.find('?') < query_end;
+  std::string reload = url;
+  reload.insert(query_end, (has_query ? "&" : "?") + directives);
+  return reload;
+}
+
+int64_t HlsReloadDelayUs(const HlsMediaPlaylist& playlist, bool changed) {
+  if (playlist.end_list) return -1;
+  if (playlist.server_control.can_block_reload) {
+    // The server answered as soon as it could; an answer without news
+    // must not turn into a busy loop.
+    return changed ? 0
+                   : std::max(playlist.part_target_us,
+                              playlist.target_duration_us / 4);
+  }
+  return changed ? playlist.target_duration_us
+                 : playlist.target_duration_us / 2;
+}
+
+bool ParseHlsMasterPlaylist(std::string_view text,
+                            std::vector<HlsVariant>* variants,
+                            std::string* error) {
+  variants->clear();
+  bool saw_header = false;
+  bool has_variant = false;
+  HlsVariant variant;
+  while (!text.empty()) {
+    const size_t end = text.find('\n');
+    std::string_view line = Trim(text.substr(0, end));
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    if (!saw_header) {
+      if (line.substr(0, 3) == "\xEF\xBB\xBF") line.remove_prefix(3);
+      if (line != "#EXTM3U") {
+        *error = "missing #EXTM3U";
+        return false;
+      }
+      saw_header = true;
+      continue;
+    }
+    if (line.empty()) continue;
+    if (line.front() != '#') {
+      if (has_variant) {
+        variant.uri.assign(line);
+        variants->push_back(std::move(variant));
+        variant = HlsVariant();
+        has_variant = false;
+      }
+      continue;
+    }
+    if (line.substr(0, 7) == "#EXTINF") {
+      *error = "not a master playlist";
+      return false;
+    }
+    constexpr std::string_view kStreamInf = "#EXT-X-STREAM-INF:";
+    if (line.substr(0, kStreamInf.size()) != kStreamInf) continue;
+    std::string_view name, value;
+    HlsAttributeReader reader(line.substr(kStreamInf.size()));
+    while (reader.Next(&name, &value)) {
+      if (name == "BANDWIDTH") {
+        ParseInt(value, &variant.bandwidth);
+      } else if (name == "CODECS") {
+        variant.codecs.assign(value);
+      } else if (name == "RESOLUTION") {
+        int64_t width = 0, height = 0;
+        const size_t x = value.find('x');
+        if (x != std::string_view::npos &&
+            ParseInt(value.substr(0, x), &width) &&
+            ParseInt(value.substr(x + 1), &height)) {
+          variant.width = static_cast<int>(width);
+          variant.height = static_cast<int>(height);
+        }
+      }
+    }
+    if (!reader.ok()) {
+      *error = "bad EXT-X-STREAM-INF";
+      return false;
+    }
+    has_variant = true;
+  }
+  if (variants->empty()) {
+    *error = saw_header ? "no variants" : "empty playlist";
+    return false;
+  }
+  return true;
+}
+
+const HlsVariant* ChooseHlsVariant(const std::vector<HlsVariant>& variants,
+                                   int64_t max_bandwidth) {
+  const HlsVariant* chosen = nullptr;
+  for (const HlsVariant& variant : variants) {
+    const bool fits = max_bandwidth <= 0 || variant.bandwidth <= max_bandwidth;
+    const bool chosen_fits = chosen != nullptr &&
+                             (max_bandwidth <= 0 ||
+                              chosen->bandwidth <= max_bandwidth);
+    if (chosen == nullptr ||
+        (fits && (!chosen_fits || variant.bandwidth > chosen->bandwidth)) ||
+        (!fits && !chosen_fits && variant.bandwidth < chosen->bandwidth)) {
+      chosen = &variant;
+    }
+  }
+  return chosen;
+}
+
+std::string ResolveHlsUrl(const std::string& base,
+                          const std::string& reference) {
+  const size_t scheme_end = base.find("://");
+  if (reference.find("://") != std::string::npos ||
+      scheme_end == std::string::npos) {
+    return reference;
+  }
+  if (reference.compare(0, 2, "//") == 0) {
+    return base.substr(0, scheme_end + 1) + reference;
+  }
+  const size_t path = base.find('/', scheme_end + 3);
+  if (!reference.empty() && reference.front() == '/') {
+    return base.substr(0, path) + reference;
+  }
+  if (path == std::string::npos) return base + "/" + reference;
+  const size_t query = base.find_first_of("?#", path);
+  const size_t directory = base.rfind('/', query);
+  return base.substr(0, directory + 1) + reference;
+}
+
+bool ParseHlsDateTime(std::string_view text, int64_t* ms) {
+  text = Trim(text);
+  int year, month, day, hour, minute, second;
+  if (!Digits(text, 0, 4, &year) || text.size() < 19 || text[4] != '-' ||
+      !Digits(text, 5, 2, &month) || text[7] != '-' ||
+      !Digits(text, 8, 2, &day) || (text[10] != 'T' && text[10] != 't') ||
+      !Digits(text, 11, 2, &hour) || text[13] != ':' ||
+      !Digits(text, 14, 2, &minute) || text[16] != ':' ||
+      !Digits(text, 17, 2, &second) || month < 1 || month > 12 || day < 1 ||
+      day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return false;
+  }
+  size_t pos = 19;
+  int64_t millis = 0;
+  if (pos < text.size() && text[pos] == '.') {
+    int64_t scale = 100;
+    for (++pos; pos < text.size() && text[pos] >= '0' && text[pos] <= '9';
+         ++pos) {
+      millis += (text[pos] - '0') * scale;
+      scale /= 10;
+    }
+  }
+  int64_t offset_minutes = 0;
+  if (pos < text.size()) {
+    const char sign = text[pos];
+    if (sign == 'Z' || sign == 'z') {
+      ++pos;
+    } else if (sign == '+' || sign == '-') {
+      int offset_hours, offset_mins;
+      if (!Digits(text, pos + 1, 2, &offset_hours)) return false;
+      pos += 3;
+      if (pos < text.size() && text[pos] == ':') ++pos;
+      if (!Digits(text, pos, 2, &offset_mins)) return false;
+      pos += 2;
+      offset_minutes = offset_hours * 60 + offset_mins;
+      if (sign == '-') offset_minutes = -offset_minutes;
+    }
+  }
+  if (pos != text.size()) return false;
+  const int64_t days = DaysFromCivil(year, month, day);
+  const int64_t seconds =
+      ((days * 24 + hour) * 60 + minute - offset_minutes) * 60 + second;
+  *ms = seconds * 1000 + millis;
+  return true;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,321 @@
+#ifndef IVS_BROADCASTER_HLS_PLAYLIST_H_
+#define IVS_BROADCASTER_HLS_PLAYLIST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+enum class HlsPlaylistType {
+  kLive = 0,
+  kEvent = 1,
+  kVod = 2,
+};
+
+// A sub-range of a resource, from EXT-X-BYTERANGE or a BYTERANGE attribute.
+struct HlsByteRange {
+  // -1 when the whole resource is meant.
+  int64_t length = -1;
+  int64_t offset = 0;
+};
+
+// EXT-X-KEY. Shared by every segment it applies to.
+struct HlsKey {
+  std::string method;
+  std::string uri;
+  std::string iv;
+};
+
+// EXT-X-MAP. Shared by every segment it applies to.
+struct HlsMap {
+  std::string uri;
+  HlsByteRange byte_range;
+};
+
+// EXT-X-PART: a piece of a segment, published before the whole segment is.
+struct HlsPart {
+  int64_t duration_us = 0;
+  std::string uri;
+  HlsByteRange byte_range;
+  // Starts with a frame that decodes on its own.
+  bool independent = false;
+  bool gap = false;
+};
+
+// EXT-X-PRELOAD-HINT: the resource that will hold the next part. A request
+// for it is answered as soon as the server has the bytes.
+struct HlsPreloadHint {
+  enum class Type { kPart, kMap };
+
+  Type type = Type::kPart;
+  // Empty when the playlist has no hint.
+  std::string uri;
+  // Length -1 when the part runs to the end of the resource.
+  HlsByteRange byte_range;
+};
+
+// EXT-X-RENDITION-REPORT: where another rendition's live edge is, so a
+// switch can ask for its next part straight away.
+struct HlsRenditionReport {
+  std::string uri;
+  int64_t last_msn = -1;
+  int64_t last_part = -1;
+};
+
+struct HlsSegment {
+  int64_t sequence = 0;
+  int64_t discontinuity_sequence = 0;
+  int64_t duration_us = 0;
+  // As written in the playlist; may be relative to the playlist URL.
+  std::string uri;
+  HlsByteRange byte_range;
+  // Preceded by EXT-X-DISCONTINUITY.
+  bool discontinuity = false;
+  bool gap = false;
+  // Milliseconds since the epoch, from EXT-X-PROGRAM-DATE-TIME or carried
+  // forward from an earlier segment; -1 when unknown.
+  int64_t program_date_time_ms = -1;
+  std::shared_ptr<const HlsKey> key;
+  std::shared_ptr<const HlsMap> map;
+  // Listed only for segments near the live edge.
+  std::vector<HlsPart> parts;
+};
+
+// EXT-X-SERVER-CONTROL.
+struct HlsServerControl {
+  // Delta updates may skip segments older than this from the live edge;
+  // 0 when the server does not offer them.
+  int64_t can_skip_until_us = 0;
+  bool can_skip_dateranges = false;
+  bool can_block_reload = false;
+  int64_t hold_back_us = 0;
+  int64_t part_hold_back_us = 0;
+};
+
+// A media playlist as of its latest update.
+struct HlsMediaPlaylist {
+  int version = 1;
+  HlsPlaylistType type = HlsPlaylistType::kLive;
+  int64_t target_duration_us = 0;
+  int64_t discontinuity_sequence = 0;
+  bool end_list = false;
+  bool independent_segments = false;
+  HlsServerControl server_control;
+  // Consecutive sequence numbers, oldest first. A deque so that a live
+  // window can slide without moving the segments it keeps.
+  std::deque<HlsSegment> segments;
+  // Sum of the segment durations.
+  int64_t duration_us = 0;
+
+  // Low-latency HLS. PART-TARGET of EXT-X-PART-INF; 0 without parts.
+  int64_t part_target_us = 0;
+  // Parts of the segment in progress, numbered next_sequence().
+  std::vector<HlsPart> pending_parts;
+  HlsPreloadHint preload_hint;
+  std::vector<HlsRenditionReport> rendition_reports;
+
+  // Sequence number of the first segment.
+  int64_t media_sequence() const;
+  // Sequence number the next new segment will get.
+  int64_t next_sequence() const;
+  // The segment numbered |sequence|, or nullptr outside the window.
+  const HlsSegment* Find(int64_t sequence) const;
+};
+
+// What one update did to a playlist.
+struct HlsUpdateStats {
+  // Segments not in the previous version.
+  int64_t added = 0;
+  // Segments listed again and kept as they were, without copying.
+  int64_t reused = 0;
+  // Segments listed again with a different URI, e.g. after a server
+  // restart, and rebuilt.
+  int64_t replaced = 0;
+  // Segments a delta update left out (EXT-X-SKIP) and that were kept.
+  int64_t skipped = 0;
+  // Segments that slid out of the window.
+  int64_t removed = 0;
+  // The previous version was discarded rather than updated.
+  bool reset = false;
+  // Parts published since the previous version, counted within the
+  // segment in progress.
+  int64_t parts_added = 0;
+
+  bool changed() const {
+    return added || replaced || removed || reset || parts_added;
+  }
+};
+
+// Reads NAME=VALUE pairs from an attribute list. Names and values point into
+// the list; quoted values are returned without their quotes.
+class HlsAttributeReader {
+ public:
+  explicit HlsAttributeReader(std::string_view list) : list_(list) {}
+
+  // Returns false at the end of the list or on malformed input; ok() tells
+  // the two apart.
+  bool Next(std::string_view* name, std::string_view* value);
+  bool ok() const { return ok_; }
+
+ private:
+  std::string_view list_;
+  bool ok_ = true;
+};
+
+// Parses a media playlist as its bytes arrive and applies it to the
+// previous version of the same playlist in place.
+//
+// Lines are tokenised as views into the input and only what is new is
+// copied: on a live refresh the segments already known are matched by
+// sequence number and URI and left untouched, so a refresh of a DVR
+// playlist with thousands of segments allocates only for the few that
+// were appended. Delta updates (EXT-X-SKIP, requested with _HLS_skip)
+// are resolved against the segments kept from the previous version.
+// Low-latency playlists add parts, a preload hint and rendition reports.
+//
+// A parser handles one update; create a new one for the next.
+class HlsPlaylistParser {
+ public:
+  // |playlist| is the previous version, or empty for the first load. It
+  // must outlive the parser and is modified as lines are parsed; after a
+  // failure it is cleared, so the next load is a full one.
+  explicit HlsPlaylistParser(HlsMediaPlaylist* playlist);
+
+  HlsPlaylistParser(const HlsPlaylistParser&) = delete;
+  HlsPlaylistParser& operator=(const HlsPlaylistParser&) = delete;
+
+  // Parses the complete lines in |data|; the rest waits for the next call.
+  // Returns false once parsing has failed.
+  bool Feed(std::string_view data);
+  // Parses what is left and completes the update.
+  bool Finish();
+
+  const HlsUpdateStats& stats() const { return stats_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  bool ParseLine(std::string_view line);
+  bool ParseTag(std::string_view name, std::string_view value);
+  bool ParseKey(std::string_view attributes);
+  bool ParseMap(std::string_view attributes);
+  bool ParseServerControl(std::string_view attributes);
+  bool ParseSkip(std::string_view attributes);
+  bool ParsePart(std::string_view attributes);
+  bool ParsePreloadHint(std::string_view attributes);
+  bool ParseRenditionReport(std::string_view attributes);
+  bool AddSegment(std::string_view uri);
+  // Clears the tags that applied to |segment|, the one just listed.
+  void EndSegment(const HlsSegment& segment);
+  // Matches the first listed segment against the previous version.
+  bool BeginSegments();
+  bool Fail(const std::string& message);
+
+  HlsMediaPlaylist* const playlist_;
+  HlsUpdateStats stats_;
+  std::string error_;
+  bool failed_ = false;
+  bool finished_ = false;
+  bool saw_header_ = false;
+  int line_ = 0;
+  // An incomplete line left over from the previous Feed().
+  std::string partial_;
+
+  // Header values, applied to the playlist by Finish().
+  int64_t media_sequence_ = 0;
+  int64_t discontinuity_sequence_ = 0;
+  int64_t target_duration_us_ = -1;
+  int64_t skipped_segments_ = 0;
+  bool end_list_ = false;
+  bool independent_segments_ = false;
+  int version_ = 1;
+  HlsPlaylistType type_ = HlsPlaylistType::kLive;
+  HlsServerControl server_control_;
+  int64_t part_target_us_ = 0;
+  HlsPreloadHint preload_hint_;
+  std::vector<HlsRenditionReport> rendition_reports_;
+  // What the previous version held of the segment in progress.
+  int64_t previous_next_sequence_ = 0;
+  size_t previous_pending_parts_ = 0;
+
+  // Segment state while the list is walked.
+  bool segments_begun_ = false;
+  int64_t next_sequence_ = 0;
+  int64_t listed_ = 0;
+  int64_t running_discontinuity_ = 0;
+  int64_t range_end_ = 0;
+  int64_t last_program_date_time_ms_ = -1;
+  int64_t last_duration_us_ = 0;
+  std::shared_ptr<const HlsKey> key_;
+  std::shared_ptr<const HlsMap> map_;
+
+  // Tags that apply to the next URI line.
+  bool has_duration_ = false;
+  int64_t duration_us_ = 0;
+  bool discontinuity_ = false;
+  bool gap_ = false;
+  bool has_byte_range_ = false;
+  HlsByteRange byte_range_;
+  int64_t program_date_time_ms_ = -1;
+  // Parts listed since the last URI line, and where the last byte-range
+  // part of |part_uri_end_| ended.
+  std::vector<HlsPart> parts_;
+  std::string part_uri_end_;
+  int64_t part_range_end_ = 0;
+};
+
+// Parses a complete playlist text; see HlsPlaylistParser.
+bool ParseHlsPlaylist(std::string_view text, HlsMediaPlaylist* playlist,
+                      HlsUpdateStats* stats, std::string* error);
+
+// The URL to reload |playlist| from. Asks for a delta update (_HLS_skip)
+// when the server offers them and the copy we hold, fetched |age_us| ago,
+// is recent enough for the server to skip against it. When the server can
+// block reloads, asks it (_HLS_msn, _HLS_part) to answer once the next part,
+// or without parts the next segment, is out.
+std::string HlsReloadUrl(const std::string& url,
+                         const HlsMediaPlaylist& playlist, int64_t age_us);
+
+// How long to wait before reloading a live playlist: a target duration after
+// an update that changed it, half of one after one that did not, and none
+// when the server holds the reload until there is something new. -1 once
+// the playlist has ended.
+int64_t HlsReloadDelayUs(const HlsMediaPlaylist& playlist, bool changed);
+
+// One EXT-X-STREAM-INF of a master playlist.
+struct HlsVariant {
+  int64_t bandwidth = 0;
+  int width = 0;
+  int height = 0;
+  std::string codecs;
+  // As written in the playlist; may be relative to the playlist URL.
+  std::string uri;
+};
+
+// Parses the variants of a master playlist, in the order listed.
+bool ParseHlsMasterPlaylist(std::string_view text,
+                            std::vector<HlsVariant>* variants,
+                            std::string* error);
+
+// The variant with the highest bandwidth within |max_bandwidth|, or the
+// leanest if none fits; 0 takes the highest listed. Null when there are
+// no variants.
+const HlsVariant* ChooseHlsVariant(const std::vector<HlsVariant>& variants,
+                                   int64_t max_bandwidth);
+
+// Resolves |reference|, e.g. a segment URI, against the URL of the
+// playlist that lists it.
+std::string ResolveHlsUrl(const std::string& base,
+                          const std::string& reference);
+
+// Parses an ISO 8601 date-time such as 2024-05-01T12:00:00.250+02:00 into
+// milliseconds since the epoch.
+bool ParseHlsDateTime(std::string_view text, int64_t* ms);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_HLS_PLAYLIST_H_
@@ -0,0 +1,157 @@
+#include "http_client.h"
+
+#include <curl/curl.h>
+#include <strings.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Transfer {
+  CURL* curl;
+  const HttpClient::DataCallback* on_data;
+  const std::function<bool()>* cancelled;
+  HttpResponse* response;
+  int64_t start_us;
+  int64_t content_range_total = -1;
+  bool started = false;
+  bool aborted = false;
+};
+
+size_t OnHeader(char* data, size_t size, size_t count, void* user) {
+  auto* transfer = static_cast<Transfer*>(user);
+  const size_t length = size * count;
+  // A new status line starts the headers of a redirect target.
+  if (length >= 5 && std::strncmp(data, "HTTP/", 5) == 0) {
+    transfer->content_range_total = -1;
+  }
+  constexpr char kContentRange[] = "content-range:";
+  constexpr size_t kPrefix = sizeof(kContentRange) - 1;
+  if (length > kPrefix && strncasecmp(data, kContentRange, kPrefix) == 0) {
+    // bytes <first>-<last>/<total>
+    const std::string value(data + kPrefix, length - kPrefix);
+    const size_t slash = value.find('/');
+    if (slash != std::string::npos && value[slash + 1] != '*') {
+      transfer->content_range_total =
+          std::strtoll(value.c_str() + slash + 1, nullptr, 10);
+    }
+  }
+  return length;
+}
+
+size_t OnBody(char* data, size_t size, size_t count, void* user) {
+  auto* transfer = static_cast<Transfer*>(user);
+  HttpResponse* response = transfer->response;
+  if (!transfer->started) {
+    transfer->started = true;
+    response->first_byte_us = NowUs() - transfer->start_us;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE,
+                      &response->status);
+    response->partial = response->status == 206;
+    if (response->partial) {
+      response->total_size = transfer->content_range_total;
+    } else {
+      curl_off_t length = -1;
+      curl_easy_getinfo(transfer->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                        &length);
+      response->total_size = length;
+    }
+  }
+  const size_t length = size * count;
+  response->bytes += length;
+  if (*transfer->on_data &&
+      !(*transfer->on_data)(reinterpret_cast<const uint8_t*>(data), length,
+                            *response)) {
+    transfer->aborted = true;
+    return 0;
+  }
+  return length;
+}
+
+int OnProgress(void* user, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+  auto* transfer = static_cast<Transfer*>(user);
+  if (*transfer->cancelled && (*transfer->cancelled)()) {
+    transfer->aborted = true;
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+HttpClient::HttpClient() {
+  static std::once_flag global_init;
+  std::call_once(global_init, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+  curl_ = curl_easy_init();
+}
+
+HttpClient::~HttpClient() {
+  if (curl_ != nullptr) curl_easy_cleanup(static_cast<CURL*>(curl_));
+}
+
+bool HttpClient::Get(const std::string& url, int64_t offset, int64_t length,
+                     const DataCallback& on_data, HttpResponse* response) {
+  *response = HttpResponse();
+  CURL* curl = static_cast<CURL*>(curl_);
+  if (curl == nullptr) {
+    response->error = "curl_easy_init failed";
+    return false;
+  }
+  Transfer transfer{curl, &on_data, &cancelled_, response, NowUs()};
+
+  curl_easy_reset(curl);
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS,
+                   static_cast<long>(timeout_us_ / 1000));
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, OnHeader);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, OnBody);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+  if (cancelled_) {
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, OnProgress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &transfer);
+  }
+  std::string range;
+  if (length >= 0) {
+    range = std::to_string(offset) + "-" + std::to_string(offset + length - 1);
+  } else if (offset > 0) {
+    range = std::to_string(offset) + "-";
+  }
+  if (!range.empty()) curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+
+  const CURLcode code = curl_easy_perform(curl);
+  response->elapsed_us = NowUs() - transfer.start_us;
+  if (response->status == 0) {
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response->status);
+  }
+  if (code != CURLE_OK) {
+    response->error = transfer.aborted ? "aborted" : curl_easy_strerror(code);
+    return false;
+  }
+  if (!transfer.started) {
+    // An empty body.
+    response->first_byte_us = response->elapsed_us;
+    response->partial = response->status == 206;
+    response->total_size =
+        response->partial ? transfer.content_range_total : 0;
+  }
+  return true;
+}
+
+}  // namespace ivs_broadcaster
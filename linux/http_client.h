@@ -0,0 +1,69 @@
+#ifndef IVS_BROADCASTER_HTTP_CLIENT_H_
+#define IVS_BROADCASTER_HTTP_CLIENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+struct HttpResponse {
+  long status = 0;
+  // Size of the whole resource: from Content-Range for a partial response,
+  // Content-Length otherwise. -1 when the server did not say.
+  int64_t total_size = -1;
+  // Whether the server honoured the requested range.
+  bool partial = false;
+  // From sending the request to the first body byte; approximately one
+  // round trip on a reused connection.
+  int64_t first_byte_us = 0;
+  int64_t elapsed_us = 0;
+  int64_t bytes = 0;
+  std::string error;
+};
+
+// A blocking HTTP(S) GET client on libcurl. One client keeps its
+// connections alive across requests, so a worker thread that owns one
+// pays for the TCP and TLS handshakes once per origin.
+//
+// Not thread-safe; use one client per thread.
+class HttpClient {
+ public:
+  // Receives body bytes as they arrive. The response already holds the
+  // status and sizes. Returning false aborts the transfer.
+  using DataCallback = std::function<bool(const uint8_t* data, size_t size,
+                                          const HttpResponse& response)>;
+
+  HttpClient();
+  ~HttpClient();
+
+  HttpClient(const HttpClient&) = delete;
+  HttpClient& operator=(const HttpClient&) = delete;
+
+  // Fetches |url|, or |length| bytes of it from |offset| when |length| is
+  // not -1, or the rest of it from a non-zero |offset|. Returns false for
+  // transport errors, non-2xx statuses and aborted transfers, with
+  // |response->error| set.
+  bool Get(const std::string& url, int64_t offset, int64_t length,
+           const DataCallback& on_data, HttpResponse* response);
+
+  // Polled about once a second during a request; returning true aborts
+  // it, even while no bytes arrive.
+  void set_cancel_check(std::function<bool()> cancelled) {
+    cancelled_ = std::move(cancelled);
+  }
+
+  // Gives up on a request that has not finished after |timeout_us|.
+  void set_timeout_us(int64_t timeout_us) { timeout_us_ = timeout_us; }
+
+ private:
+  void* curl_;  // CURL*
+  std::function<bool()> cancelled_;
+  int64_t timeout_us_ = 20000000;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_HTTP_CLIENT_H_
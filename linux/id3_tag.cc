@@ -0,0 +1,152 @@
+#include "id3_tag.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr size_t kHeaderBytes = 10;
+// Header flags.
+constexpr uint8_t kUnsynchronised = 0x80;
+constexpr uint8_t kExtendedHeader = 0x40;
+
+enum Encoding : uint8_t {
+  kLatin1 = 0,
+  kUtf16 = 1,
+  kUtf16Be = 2,
+  kUtf8 = 3,
+};
+
+uint32_t SyncSafe(const uint8_t* bytes) {
+  return (bytes[0] & 0x7f) << 21 | (bytes[1] & 0x7f) << 14 |
+         (bytes[2] & 0x7f) << 7 | (bytes[3] & 0x7f);
+}
+
+uint32_t BigEndian(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) << 24 | bytes[1] << 16 |
+         bytes[2] << 8 | bytes[3];
+}
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xc0 | code_point >> 6));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xe0 | code_point >> 12));
+    out->push_back(static_cast<char>(0x80 | (code_point >> 6 & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else {
+    out->push_back(static_cast<char>(0xf0 | code_point >> 18));
+    out->push_back(static_cast<char>(0x80 | (code_point >> 12 & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point >> 6 & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+// Where the string starting at |begin| ends: at its terminator, or |end|.
+const uint8_t* StringEnd(const uint8_t* begin, const uint8_t* end,
+                         uint8_t encoding) {
+  if (encoding == kUtf16 || encoding == kUtf16Be) {
+    for (const uint8_t* p = begin; p + 1 < end; p += 2) {
+      if (p[0] == 0 && p[1] == 0) return p;
+    }
+    return end;
+  }
+  for (const uint8_t* p = begin; p < end; ++p) {
+    if (*p == 0) return p;
+  }
+  return end;
+}
+
+// The terminator after a string ending at |string_end|, if any.
+const uint8_t* SkipTerminator(const uint8_t* string_end, const uint8_t* end,
+                              uint8_t encoding) {
+  const size_t bytes = encoding == kUtf16 || encoding == kUtf16Be ? 2 : 1;
+  return string_end + bytes <= end ? string_end + bytes : end;
+}
+
+std::string Decode(const uint8_t* begin, const uint8_t* end,
+                   uint8_t encoding) {
+  std::string out;
+  if (encoding == kUtf8) return std::string(begin, end);
+  if (encoding == kLatin1) {
+    for (const uint8_t* p = begin; p < end; ++p) AppendUtf8(*p, &out);
+    return out;
+  }
+  bool big_endian = encoding == kUtf16Be;
+  if (encoding == kUtf16 && end - begin >= 2) {
+    // The byte order mark; without one, big-endian.
+    if (begin[0] == 0xff && begin[1] == 0xfe) {
+      big_endian = false;
+      begin += 2;
+    } else if (begin[0] == 0xfe && begin[1] == 0xff) {
+      begin += 2;
+    } else {
+      big_endian = true;
+    }
+  }
+  auto unit = [big_endian](const uint8_t* p) -> uint32_t {
+    return big_endian ? p[0] << 8 | p[1] : p[1] << 8 | p[0];
+  };
+  for (const uint8_t* p = begin; p + 1 < end; p += 2) {
+    uint32_t code_point = unit(p);
+    if (code_point >= 0xd800 && code_point < 0xdc00 && p + 3 < end) {
+      const uint32_t low = unit(p + 2);
+      if (low >= 0xdc00 && low < 0xe000) {
+        code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        p += 2;
+      }
+    }
+    AppendUtf8(code_point, &out);
+  }
+  return out;
+}
+
+}  // namespace
+
+bool ParseId3TextFrames(const uint8_t* data, size_t size,
+                        std::vector<std::string>* texts) {
+  if (size < kHeaderBytes || data[0] != 'I' || data[1] != 'D' ||
+      data[2] != '3') {
+    return false;
+  }
+  const uint8_t version = data[3];
+  const uint8_t flags = data[5];
+  if (version != 3 && version != 4) return false;
+  const size_t tag_bytes = kHeaderBytes + SyncSafe(data + 6);
+  // Unsynchronised tags are rare in segments and left alone.
+  if (tag_bytes > size || (flags & kUnsynchronised) != 0) return false;
+  const uint8_t* p = data + kHeaderBytes;
+  const uint8_t* const end = data + tag_bytes;
+  if ((flags & kExtendedHeader) != 0) {
+    if (end - p < 4) return false;
+    // v2.3 does not count the size field itself.
+    const size_t extended =
+        version == 4 ? SyncSafe(p) : BigEndian(p) + size_t{4};
+    if (extended > static_cast<size_t>(end - p)) return false;
+    p += extended;
+  }
+  // Padding, zeros, may follow the last frame.
+  while (end - p >= static_cast<ptrdiff_t>(kHeaderBytes) && p[0] != 0) {
+    const std::string id(reinterpret_cast<const char*>(p), 4);
+    const size_t body_bytes =
+        version == 4 ? SyncSafe(p + 4) : BigEndian(p + 4);
+    const uint8_t* body = p + kHeaderBytes;
+    if (body_bytes > static_cast<size_t>(end - body)) return false;
+    const uint8_t* body_end = body + body_bytes;
+    p = body_end;
+    if (id[0] != 'T' || body_bytes == 0 || body[0] > kUtf8) continue;
+    const uint8_t encoding = body[0];
+    const uint8_t* text = body + 1;
+    if (id == "TXXX") {
+      text = SkipTerminator(StringEnd(text, body_end, encoding), body_end,
+                            encoding);
+    }
+    texts->push_back(
+        Decode(text, StringEnd(text, body_end, encoding), encoding));
+  }
+  return true;
+}
+
+}  // namespace ivs_broadcaster
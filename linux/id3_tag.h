@@ -0,0 +1,20 @@
+#ifndef IVS_BROADCASTER_ID3_TAG_H_
+#define IVS_BROADCASTER_ID3_TAG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// Appends the text of the text frames (TXXX and T***) of the ID3v2.3 or
+// v2.4 tag in |data| to |texts|, in UTF-8; timed metadata reaches HLS
+// viewers as such tags in the segments. A TXXX frame contributes its value,
+// not its description. Returns false when |data| is not a whole tag.
+bool ParseId3TextFrames(const uint8_t* data, size_t size,
+                        std::vector<std::string>* texts);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_ID3_TAG_H_
@@ -0,0 +1,29 @@
+#ifndef FLUTTER_PLUGIN_IVS_TELEMETRY_H_
+#define FLUTTER_PLUGIN_IVS_TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "ivs_broadcaster_plugin.h"
+
+G_BEGIN_DECLS
+
+// C entry points for reading broadcaster telemetry from Dart through
+// dart:ffi, without going through the method or event channels. Slots use
+// the layout documented in telemetry_block.h.
+
+// Number of slots in the process-wide telemetry block, or 0 if it could
+// not be created.
+FLUTTER_PLUGIN_EXPORT int32_t ivs_telemetry_slot_count(void);
+
+// Size in bytes of one slot.
+FLUTTER_PLUGIN_EXPORT int32_t ivs_telemetry_slot_size(void);
+
+// Copies a consistent snapshot of |slot| into |out|, which holds |size|
+// bytes. Returns 1 on success and 0 for a bad slot, a short buffer or a
+// writer that kept the slot busy. Never blocks.
+FLUTTER_PLUGIN_EXPORT int32_t ivs_telemetry_read(int32_t slot, uint8_t* out,
+                                                 int32_t size);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_IVS_TELEMETRY_H_
@@ -0,0 +1,1526 @@
+#include "include/ivs_broadcaster/ivs_broadcaster_plugin.h"
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "broadcast_session.h"
+#include "command_executor.h"
+#include "decode_pool.h"
+#include "encoder_registry.h"
+#include "event_hub.h"
+#include "ffmpeg_encoder_backend.h"
+#include "ffmpeg_media_source.h"
+#include "ffmpeg_thumbnail_codec.h"
+#include "ivs_broadcaster_plugin_private.h"
+#include "mosaic.h"
+#include "multi_player.h"
+#include "preview_texture.h"
+#include "segment_cache.h"
+#include "segment_cache_warmer.h"
+#include "sprite_sheet.h"
+#include "telemetry_ffi.h"
+#include "telemetry_record.h"
+#include "thumbnail_engine.h"
+
+#define IVS_BROADCASTER_PLUGIN(obj)                                     \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), ivs_broadcaster_plugin_get_type(), \
+                              IvsBroadcasterPlugin))
+
+namespace {
+
+constexpr int kBroadcastStateCount =
+    static_cast<int>(ivs_broadcaster::BroadcastState::kError) + 1;
+
+// Executor lane for commands that reconfigure the session and its camera.
+constexpr char kSessionLane[] = "session";
+// Executor lane for commands that start and stop players.
+constexpr char kPlayerLane[] = "player";
+
+struct FlValueUnref {
+  void operator()(FlValue* value) const { fl_value_unref(value); }
+};
+
+// An event waiting in a hub. FlValue reference counts are not atomic, so
+// the shared prebuilt state events are only picked up on the platform
+// thread; other events are owned until delivery.
+struct QueuedEvent {
+  std::unique_ptr<FlValue, FlValueUnref> value;
+  ivs_broadcaster::BroadcastState state;
+};
+
+using BroadcasterEventHub = ivs_broadcaster::EventHub<QueuedEvent>;
+// Player events always carry their value.
+using PlayerEventHub = ivs_broadcaster::EventHub<QueuedEvent>;
+
+// Forwards session callbacks, which arrive on capture and encode threads, to
+// the event channel on the platform thread, and mirrors them into the FFI
+// telemetry block for synchronous reads from Dart.
+class SessionListener : public ivs_broadcaster::BroadcastSession::Listener {
+ public:
+  explicit SessionListener(IvsBroadcasterPlugin* plugin);
+  ~SessionListener() override;
+
+  void OnStateChanged(ivs_broadcaster::BroadcastState state) override;
+  void OnPresetSelected(const std::string& preset,
+                        const std::string& backend) override;
+  void OnError(const std::string& message) override;
+  void OnGovernorStats(
+      const ivs_broadcaster::FrameGovernorStats& stats) override;
+  void OnFrameRateChanged(
+      const ivs_broadcaster::FrameGovernorStats& stats) override;
+  void OnEncodeStats(const ivs_broadcaster::EncodeStats& stats) override;
+
+ private:
+  void PostTelemetry(uint16_t changed);
+  template <typename Fn>
+  void UpdateTelemetrySlot(Fn&& update);
+
+  IvsBroadcasterPlugin* plugin_;
+  // Latest statistics, only touched on the encode thread.
+  ivs_broadcaster::TelemetryRecord telemetry_;
+  // This session's slot in the FFI telemetry block, or -1.
+  ivs_broadcaster::TelemetryBlock* const block_;
+  int slot_ = -1;
+};
+
+// Forwards the selected player's events to the ivs_player_event channel and
+// its frames to the player texture, and the frames of mosaic tiles to the
+// mosaic.
+class PlayerListener : public ivs_broadcaster::MultiPlayer::Listener {
+ public:
+  explicit PlayerListener(IvsBroadcasterPlugin* plugin);
+  ~PlayerListener() override;
+
+  // Replaces the mosaic tile frames are drawn into; null drops them.
+  void SetMosaic(std::shared_ptr<ivs_broadcaster::MosaicCompositor> mosaic) {
+    std::lock_guard<std::mutex> lock(mosaic_mutex_);
+    mosaic_ = std::move(mosaic);
+  }
+
+  void OnStateChanged(const std::string& id,
+                      ivs_broadcaster::PlayerState state) override;
+  void OnError(const std::string& id, const std::string& message) override;
+  void OnFrame(const std::string& id,
+               const ivs_broadcaster::FramePtr& frame) override;
+  void OnTileFrame(const std::string& id, int tile,
+                   const ivs_broadcaster::FramePtr& frame) override;
+  void OnSwitched(const std::string& id, int64_t latency_us) override;
+  void OnAbrDecision(const std::string& id,
+                     const ivs_broadcaster::AbrDecision& decision) override;
+  void OnAudio(const std::string& id,
+               const ivs_broadcaster::AudioBuffer& buffer) override {}
+  void OnPlaybackRateChanged(const std::string& id, double rate,
+                             int64_t latency_us) override;
+  void OnCues(const std::string& id,
+              const std::vector<ivs_broadcaster::MetadataCue>& cues,
+              bool seek) override;
+  void OnPosition(const std::string& id,
+                  const ivs_broadcaster::MediaPlayerStats& stats) override;
+  void OnDuration(const std::string& id, int64_t duration_us) override;
+
+ private:
+  template <typename Fn>
+  void UpdateTelemetrySlot(Fn&& update);
+
+  IvsBroadcasterPlugin* plugin_;
+  // The selected player's slot in the FFI telemetry block, or -1.
+  ivs_broadcaster::TelemetryBlock* const block_;
+  int slot_ = -1;
+  std::mutex mosaic_mutex_;
+  std::shared_ptr<ivs_broadcaster::MosaicCompositor> mosaic_;
+};
+
+}  // namespace
+
+struct _IvsBroadcasterPlugin {
+  GObject parent_instance;
+
+  FlEventChannel* event_channel;
+  gboolean listening;
+
+  ivs_broadcaster::EncoderRegistry* encoders;
+  std::thread* calibration;
+  gboolean calibrated;
+  // getEncoderCapabilities calls waiting for calibration to finish.
+  GPtrArray* pending_capability_calls;
+
+  SessionListener* listener;
+  ivs_broadcaster::BroadcastSession* session;
+  // Runs session commands, which open devices and join threads, off the
+  // platform thread.
+  ivs_broadcaster::CommandExecutor* commands;
+  // Camera preview shown by a Texture widget; null until registered.
+  IvsPreviewTexture* preview_texture;
+
+  // Serves getScreenshot on the ivs_player channel from a worker pool.
+  ivs_broadcaster::ThumbnailEngine* thumbnails;
+  // Serves generateSprites, caching the sheets on disk.
+  ivs_broadcaster::SpriteSheetGenerator* sprites;
+  // HLS VOD segments kept on disk for the players; null when the cache
+  // directory cannot be opened. cache_warmer serves prefetchVod.
+  ivs_broadcaster::SegmentCache* segment_cache;
+  ivs_broadcaster::SegmentCacheWarmer* cache_warmer;
+
+  // Players of the ivs_player channel; only the selected one is decoded in
+  // full and drawn into player_texture.
+  PlayerListener* player_listener;
+  // Decoding threads shared by all players.
+  ivs_broadcaster::DecodePool* decode_pool;
+  ivs_broadcaster::MultiPlayer* players;
+  IvsPreviewTexture* player_texture;
+  // The streams of startMosaic tiled into one picture.
+  IvsPreviewTexture* mosaic_texture;
+  FlEventChannel* player_event_channel;
+  gboolean player_listening;
+  // Coalesces player events on their way to the platform thread.
+  PlayerEventHub* player_events;
+
+  // Coalesces session events on their way to the platform thread.
+  BroadcasterEventHub* events;
+  // {"state": name} events, built once and indexed by BroadcastState.
+  FlValue* state_events[kBroadcastStateCount];
+};
+
+G_DEFINE_TYPE(IvsBroadcasterPlugin, ivs_broadcaster_plugin, g_object_get_type())
+
+static FlValue* resolve_event(IvsBroadcasterPlugin* self,
+                              const QueuedEvent& event) {
+  return event.value ? event.value.get()
+                     : self->state_events[static_cast<int>(event.state)];
+}
+
+// Sends the events |hub| has ready on |channel|, each metrics batch as one
+// list.
+static void send_drained_events(IvsBroadcasterPlugin* self,
+                                BroadcasterEventHub* hub,
+                                FlEventChannel* channel, gboolean listening,
+                                const char* name) {
+  for (const auto& event : hub->Drain()) {
+    if (!listening || channel == nullptr) continue;
+    g_autoptr(FlValue) batch = nullptr;
+    FlValue* value = nullptr;
+    if (event.priority == ivs_broadcaster::EventPriority::kMetrics) {
+      batch = fl_value_new_list();
+      for (const auto& item : event.payloads) {
+        fl_value_append(batch, resolve_event(self, item));
+      }
+      value = batch;
+    } else {
+      value = resolve_event(self, event.payloads.front());
+    }
+    g_autoptr(GError) error = nullptr;
+    if (!fl_event_channel_send(channel, value, nullptr, &error)) {
+      g_warning("Failed to send %s event: %s", name, error->message);
+    }
+  }
+}
+
+static gboolean drain_events_cb(gpointer user_data) {
+  IvsBroadcasterPlugin* self = IVS_BROADCASTER_PLUGIN(user_data);
+  send_drained_events(self, self->events, self->event_channel,
+                      self->listening, "broadcaster");
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean drain_player_events_cb(gpointer user_data) {
+  IvsBroadcasterPlugin* self = IVS_BROADCASTER_PLUGIN(user_data);
+  send_drained_events(self, self->player_events, self->player_event_channel,
+                      self->player_listening, "player");
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Asks for |drain| on the platform thread. Called by a hub only when no
+// earlier wake-up is outstanding, not once per event.
+static void schedule_drain(IvsBroadcasterPlugin* self, GSourceFunc drain,
+                           std::chrono::milliseconds delay) {
+  g_object_ref(self);
+  if (delay.count() == 0) {
+    g_idle_add(drain, self);
+  } else {
+    g_timeout_add(static_cast<guint>(delay.count()), drain, self);
+  }
+}
+
+// Queues |event| for delivery on the platform thread. Takes ownership.
+static void post_event(IvsBroadcasterPlugin* self, const char* key,
+                       ivs_broadcaster::EventPriority priority,
+                       FlValue* event) {
+  QueuedEvent queued;
+  queued.value.reset(event);
+  self->events->Post(key, priority, std::move(queued));
+}
+
+static void post_string_event(IvsBroadcasterPlugin* self, const gchar* key,
+                              const gchar* value) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, key, fl_value_new_string(value));
+  post_event(self, key, ivs_broadcaster::EventPriority::kState, event);
+}
+
+SessionListener::SessionListener(IvsBroadcasterPlugin* plugin)
+    : plugin_(plugin), block_(ivs_broadcaster::ProcessTelemetryBlock()) {
+  if (block_ != nullptr) {
+    slot_ = block_->Acquire(
+        ivs_broadcaster::TelemetrySource::kBroadcastSession, "broadcaster");
+  }
+}
+
+SessionListener::~SessionListener() {
+  if (slot_ >= 0) block_->Release(slot_);
+}
+
+template <typename Fn>
+void SessionListener::UpdateTelemetrySlot(Fn&& update) {
+  if (slot_ < 0) return;
+  block_->Update(slot_, [&update](ivs_broadcaster::TelemetrySlot* values) {
+    values->updated_us = g_get_monotonic_time();
+    update(values);
+  });
+}
+
+void SessionListener::OnStateChanged(ivs_broadcaster::BroadcastState state) {
+  UpdateTelemetrySlot([state](ivs_broadcaster::TelemetrySlot* values) {
+    ++values->counters[ivs_broadcaster::kTelemetryStateChanges];
+    values->gauges[ivs_broadcaster::kTelemetryState] =
+        static_cast<int>(state);
+  });
+  QueuedEvent queued;
+  queued.state = state;
+  plugin_->events->Post("state", ivs_broadcaster::EventPriority::kState,
+                        std::move(queued));
+}
+
+void SessionListener::OnPresetSelected(const std::string& preset,
+                                       const std::string& backend) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "encoderQuality",
+                           fl_value_new_string(preset.c_str()));
+  fl_value_set_string_take(event, "encoderBackend",
+                           fl_value_new_string(backend.c_str()));
+  post_event(plugin_, "encoder", ivs_broadcaster::EventPriority::kState, event);
+}
+
+void SessionListener::OnError(const std::string& message) {
+  UpdateTelemetrySlot([](ivs_broadcaster::TelemetrySlot* values) {
+    ++values->counters[ivs_broadcaster::kTelemetryErrors];
+  });
+  post_string_event(plugin_, "error", message.c_str());
+}
+
+// Keeps drops visible while a level holds: the slot follows every window,
+// and the per-second encode events carry the latest governor fields too.
+void SessionListener::OnGovernorStats(
+    const ivs_broadcaster::FrameGovernorStats& stats) {
+  ivs_broadcaster::SetFrameGovernorTelemetry(stats, &telemetry_);
+  UpdateTelemetrySlot([&stats](ivs_broadcaster::TelemetrySlot* values) {
+    ivs_broadcaster::SetFrameGovernorTelemetry(stats, values);
+  });
+}
+
+void SessionListener::OnFrameRateChanged(
+    const ivs_broadcaster::FrameGovernorStats& stats) {
+  ivs_broadcaster::SetFrameGovernorTelemetry(stats, &telemetry_);
+  PostTelemetry(ivs_broadcaster::kTelemetryFrameRate);
+}
+
+void SessionListener::OnEncodeStats(const ivs_broadcaster::EncodeStats& stats) {
+  telemetry_.frames_encoded = stats.frames_encoded;
+  telemetry_.frames_skipped = stats.frames_skipped;
+  telemetry_.compare_time_us =
+      static_cast<uint32_t>(stats.compare_time_ms * 1000);
+  telemetry_.encode_time_saved_us =
+      static_cast<uint32_t>(stats.encode_time_saved_ms * 1000);
+  UpdateTelemetrySlot([&stats](ivs_broadcaster::TelemetrySlot* values) {
+    values->counters[ivs_broadcaster::kTelemetryFramesEncoded] +=
+        stats.frames_encoded;
+    values->counters[ivs_broadcaster::kTelemetryFramesSkipped] +=
+        stats.frames_skipped;
+  });
+  PostTelemetry(ivs_broadcaster::kTelemetryEncode);
+}
+
+// High-rate statistics travel as one fixed-layout Uint8List rather than a map
+// of named values; see telemetry_record.h for the layout.
+void SessionListener::PostTelemetry(uint16_t changed) {
+  uint8_t bytes[ivs_broadcaster::kTelemetryRecordSize];
+  telemetry_.changed = changed;
+  telemetry_.timestamp_us = g_get_monotonic_time();
+  ivs_broadcaster::EncodeTelemetryRecord(telemetry_, bytes);
+  UpdateTelemetrySlot([this](ivs_broadcaster::TelemetrySlot* values) {
+    values->stats = telemetry_;
+  });
+  // Each kind of update keeps its own latest value while Dart is behind.
+  post_event(plugin_,
+             changed == ivs_broadcaster::kTelemetryFrameRate ? "frameRate"
+                                                             : "encode",
+             ivs_broadcaster::EventPriority::kStats,
+             fl_value_new_uint8_list(bytes, sizeof(bytes)));
+}
+
+// Queues |event| for the player event channel. Takes ownership.
+static void post_player_event(IvsBroadcasterPlugin* self, const char* key,
+                              ivs_broadcaster::EventPriority priority,
+                              FlValue* event) {
+  QueuedEvent queued;
+  queued.value.reset(event);
+  self->player_events->Post(key, priority, std::move(queued));
+}
+
+PlayerListener::PlayerListener(IvsBroadcasterPlugin* plugin)
+    : plugin_(plugin), block_(ivs_broadcaster::ProcessTelemetryBlock()) {
+  if (block_ != nullptr) {
+    slot_ = block_->Acquire(ivs_broadcaster::TelemetrySource::kPlayer,
+                            "player");
+  }
+}
+
+PlayerListener::~PlayerListener() {
+  if (slot_ >= 0) block_->Release(slot_);
+}
+
+template <typename Fn>
+void PlayerListener::UpdateTelemetrySlot(Fn&& update) {
+  if (slot_ < 0) return;
+  block_->Update(slot_, [&update](ivs_broadcaster::TelemetrySlot* values) {
+    values->updated_us = g_get_monotonic_time();
+    update(values);
+  });
+}
+
+void PlayerListener::OnStateChanged(const std::string& id,
+                                    ivs_broadcaster::PlayerState state) {
+  UpdateTelemetrySlot([state](ivs_broadcaster::TelemetrySlot* values) {
+    ++values->counters[ivs_broadcaster::kTelemetryStateChanges];
+    values->gauges[ivs_broadcaster::kTelemetryState] =
+        static_cast<int>(state);
+  });
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "state",
+                           fl_value_new_int(static_cast<int>(state)));
+  post_player_event(plugin_, "state", ivs_broadcaster::EventPriority::kState,
+                    event);
+}
+
+void PlayerListener::OnError(const std::string& id,
+                             const std::string& message) {
+  UpdateTelemetrySlot([](ivs_broadcaster::TelemetrySlot* values) {
+    ++values->counters[ivs_broadcaster::kTelemetryErrors];
+  });
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "error",
+                           fl_value_new_string(message.c_str()));
+  post_player_event(plugin_, "error", ivs_broadcaster::EventPriority::kState,
+                    event);
+}
+
+void PlayerListener::OnFrame(const std::string& id,
+                             const ivs_broadcaster::FramePtr& frame) {
+  if (plugin_->player_texture != nullptr) {
+    ivs_preview_texture_get_renderer(plugin_->player_texture)->Submit(frame);
+  }
+}
+
+void PlayerListener::OnTileFrame(const std::string& id, int tile,
+                                 const ivs_broadcaster::FramePtr& frame) {
+  std::shared_ptr<ivs_broadcaster::MosaicCompositor> mosaic;
+  {
+    std::lock_guard<std::mutex> lock(mosaic_mutex_);
+    mosaic = mosaic_;
+  }
+  // Scaled on this player's thread, so the tiles scale in parallel.
+  if (mosaic) mosaic->Update(tile, *frame);
+}
+
+void PlayerListener::OnSwitched(const std::string& id, int64_t latency_us) {
+  // In seconds, like the other times on this channel.
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "switchLatency",
+                           fl_value_new_float(latency_us / 1e6));
+  post_player_event(plugin_, "switchLatency",
+                    ivs_broadcaster::EventPriority::kStats, event);
+}
+
+void PlayerListener::OnAbrDecision(
+    const std::string& id, const ivs_broadcaster::AbrDecision& decision) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(
+      value, "quality", fl_value_new_string(decision.rendition.name.c_str()));
+  fl_value_set_string_take(value, "bandwidth",
+                           fl_value_new_int(decision.rendition.bandwidth));
+  fl_value_set_string_take(value, "switched",
+                           fl_value_new_bool(decision.switched()));
+  fl_value_set_string_take(value, "automatic",
+                           fl_value_new_bool(decision.automatic));
+  fl_value_set_string_take(value, "reason",
+                           fl_value_new_string(decision.reason.c_str()));
+  fl_value_set_string_take(value, "throughput",
+                           fl_value_new_int(decision.throughput_bps));
+  fl_value_set_string_take(value, "buffer",
+                           fl_value_new_float(decision.buffer_us / 1e6));
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "abrDecision", value);
+  post_player_event(plugin_, "abrDecision",
+                    ivs_broadcaster::EventPriority::kStats, event);
+}
+
+void PlayerListener::OnPlaybackRateChanged(const std::string& id,
+                                           double rate, int64_t latency_us) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "playbackRate", fl_value_new_float(rate));
+  fl_value_set_string_take(event, "liveLatency",
+                           fl_value_new_float(latency_us / 1e6));
+  // Changes every 100 ms while catching up; only the latest matters.
+  post_player_event(plugin_, "playbackRate",
+                    ivs_broadcaster::EventPriority::kStats, event);
+}
+
+// A cue as the "metadata" events of the other platforms carry it, with
+// times in seconds.
+static FlValue* cue_value(const ivs_broadcaster::MetadataCue& cue) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "metadata",
+                           fl_value_new_string(cue.text.c_str()));
+  fl_value_set_string_take(value, "startTime",
+                           fl_value_new_float(cue.start_us / 1e6));
+  fl_value_set_string_take(value, "endTime",
+                           fl_value_new_float(cue.end_us / 1e6));
+  return value;
+}
+
+void PlayerListener::OnCues(
+    const std::string& id,
+    const std::vector<ivs_broadcaster::MetadataCue>& cues, bool seek) {
+  if (!seek) {
+    // "metadata" events, delivered in batches per metrics interval.
+    for (const ivs_broadcaster::MetadataCue& cue : cues) {
+      post_player_event(plugin_, "metadata",
+                        ivs_broadcaster::EventPriority::kMetrics,
+                        cue_value(cue));
+    }
+    return;
+  }
+  FlValue* list = fl_value_new_list();
+  for (const ivs_broadcaster::MetadataCue& cue : cues) {
+    fl_value_append_take(list, cue_value(cue));
+  }
+  // Sent even when empty, so that cues shown before the seek are cleared.
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "activeCues", list);
+  post_player_event(plugin_, "activeCues",
+                    ivs_broadcaster::EventPriority::kState, event);
+}
+
+void PlayerListener::OnPosition(
+    const std::string& id, const ivs_broadcaster::MediaPlayerStats& stats) {
+  UpdateTelemetrySlot([&stats](ivs_broadcaster::TelemetrySlot* values) {
+    uint64_t* counters = values->counters;
+    counters[ivs_broadcaster::kTelemetryPackets] = stats.packets;
+    counters[ivs_broadcaster::kTelemetryFramesDecoded] = stats.decoded;
+    counters[ivs_broadcaster::kTelemetryFramesShown] = stats.frames;
+    counters[ivs_broadcaster::kTelemetryPacketsSkipped] = stats.skipped;
+    counters[ivs_broadcaster::kTelemetrySwitches] = stats.switches;
+    counters[ivs_broadcaster::kTelemetrySeeks] = stats.seeks;
+    double* gauges = values->gauges;
+    gauges[ivs_broadcaster::kTelemetryPlaybackRate] = stats.playback_rate;
+    gauges[ivs_broadcaster::kTelemetryPositionMs] = stats.position_us / 1000.0;
+    gauges[ivs_broadcaster::kTelemetryBufferedMs] = stats.buffered_us / 1000.0;
+    gauges[ivs_broadcaster::kTelemetryLiveLatencyMs] =
+        stats.live_latency_us / 1000.0;
+    gauges[ivs_broadcaster::kTelemetryDurationMs] = stats.duration_us / 1000.0;
+    gauges[ivs_broadcaster::kTelemetryDecodeMs] =
+        stats.decoded > 0 ? stats.decode_us / 1000.0 / stats.decoded : 0;
+    gauges[ivs_broadcaster::kTelemetrySwitchLatencyMs] =
+        stats.last_switch_us / 1000.0;
+  });
+  // The "playback" stats of iOS, in seconds; bufferedPosition is how far
+  // ahead of the position the player has loaded.
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "position",
+                           fl_value_new_float(stats.position_us / 1e6));
+  fl_value_set_string_take(event, "bufferedPosition",
+                           fl_value_new_float(stats.buffered_us / 1e6));
+  if (stats.live_latency_us >= 0) {
+    fl_value_set_string_take(event, "liveLatency",
+                             fl_value_new_float(stats.live_latency_us / 1e6));
+  }
+  post_player_event(plugin_, "playback",
+                    ivs_broadcaster::EventPriority::kStats, event);
+}
+
+void PlayerListener::OnDuration(const std::string& id, int64_t duration_us) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "duration",
+                           fl_value_new_float(duration_us / 1e6));
+  post_player_event(plugin_, "duration",
+                    ivs_broadcaster::EventPriority::kState, event);
+}
+
+static const gchar* lookup_string(FlValue* args, const gchar* key,
+                                  const gchar* fallback) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return fallback;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return fallback;
+  }
+  return fl_value_get_string(value);
+}
+
+static gboolean lookup_bool(FlValue* args, const gchar* key,
+                            gboolean fallback) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return fallback;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_BOOL) {
+    return fallback;
+  }
+  return fl_value_get_bool(value);
+}
+
+// The strings of the list |key|; anything else in it is skipped.
+static std::vector<std::string> lookup_strings(FlValue* args,
+                                               const gchar* key) {
+  std::vector<std::string> strings;
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return strings;
+  }
+  FlValue* list = fl_value_lookup_string(args, key);
+  if (list == nullptr || fl_value_get_type(list) != FL_VALUE_TYPE_LIST) {
+    return strings;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* value = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+      strings.emplace_back(fl_value_get_string(value));
+    }
+  }
+  return strings;
+}
+
+static double lookup_double(FlValue* args, const gchar* key, double fallback) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return fallback;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr) return fallback;
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_FLOAT) {
+    return fl_value_get_float(value);
+  }
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_INT) {
+    return static_cast<double>(fl_value_get_int(value));
+  }
+  return fallback;
+}
+
+// The interval of the "playback" events for the positionUpdateRate of
+// |args|, 10 a second unless given; 0 turns them off.
+static int64_t position_interval_us(FlValue* args) {
+  const double rate = lookup_double(args, "positionUpdateRate", 10);
+  return rate > 0 ? static_cast<int64_t>(1e6 / rate) : 0;
+}
+
+// Describes the benchmark results and the preset this machine sustains.
+static FlValue* encoder_capabilities(IvsBroadcasterPlugin* self) {
+  ivs_broadcaster::EncoderRecommendation recommendation =
+      self->encoders->Recommend();
+  FlValue* benchmarks = fl_value_new_list();
+  for (const auto& result : self->encoders->results()) {
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "backend",
+                             fl_value_new_string(result.backend.c_str()));
+    fl_value_set_string_take(entry, "quality",
+                             fl_value_new_string(result.preset.c_str()));
+    fl_value_set_string_take(entry, "fps", fl_value_new_float(result.fps));
+    fl_value_set_string_take(entry, "realtime",
+                             fl_value_new_bool(result.realtime));
+    fl_value_append_take(benchmarks, entry);
+  }
+  FlValue* capabilities = fl_value_new_map();
+  fl_value_set_string_take(
+      capabilities, "recommendedQuality",
+      fl_value_new_string(recommendation.preset.c_str()));
+  fl_value_set_string_take(
+      capabilities, "backend",
+      fl_value_new_string(recommendation.backend.c_str()));
+  fl_value_set_string_take(capabilities, "benchmarks", benchmarks);
+  return capabilities;
+}
+
+static gboolean calibration_done_cb(gpointer user_data) {
+  IvsBroadcasterPlugin* self = IVS_BROADCASTER_PLUGIN(user_data);
+  self->calibrated = TRUE;
+  g_autoptr(FlValue) capabilities = encoder_capabilities(self);
+  g_autoptr(FlMethodResponse) response =
+      FL_METHOD_RESPONSE(fl_method_success_response_new(capabilities));
+  for (guint i = 0; i < self->pending_capability_calls->len; i++) {
+    FlMethodCall* call =
+        FL_METHOD_CALL(g_ptr_array_index(self->pending_capability_calls, i));
+    fl_method_call_respond(call, response, nullptr);
+  }
+  g_ptr_array_set_size(self->pending_capability_calls, 0);
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// A command's response on its way from the executor to the platform thread.
+struct CommandReply {
+  FlMethodCall* method_call;
+  FlMethodResponse* response;
+};
+
+static gboolean command_reply_cb(gpointer user_data) {
+  std::unique_ptr<CommandReply> reply(static_cast<CommandReply*>(user_data));
+  fl_method_call_respond(reply->method_call, reply->response, nullptr);
+  g_object_unref(reply->response);
+  g_object_unref(reply->method_call);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs |command| on |lane| of the executor and answers |method_call| with
+// the response it returns. The response is built on the worker and handed
+// over whole, so nothing is shared with the platform thread.
+static void dispatch_command(
+    IvsBroadcasterPlugin* self, FlMethodCall* method_call, const char* lane,
+    std::function<FlMethodResponse*()> command) {
+  g_object_ref(method_call);
+  const bool queued = self->commands->Post(
+      lane, fl_method_call_get_name(method_call),
+      [method_call, command = std::move(command)] {
+        g_idle_add(command_reply_cb, new CommandReply{method_call, command()});
+      });
+  if (!queued) {
+    fl_method_call_respond_error(method_call, "UNAVAILABLE",
+                                 "The plugin is shutting down", nullptr,
+                                 nullptr);
+    g_object_unref(method_call);
+  }
+}
+
+static FlMethodResponse* success_string(const gchar* value) {
+  g_autoptr(FlValue) result = fl_value_new_string(value);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Validates the arguments on the platform thread and restarts the session on
+// the executor. Returns an error response, or nullptr once dispatched.
+static FlMethodResponse* start_preview(IvsBroadcasterPlugin* self,
+                                       FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const gchar* imgset = lookup_string(args, "imgset", nullptr);
+  const gchar* stream_key = lookup_string(args, "streamKey", nullptr);
+  if (imgset == nullptr || stream_key == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "INVALID_ARGUMENTS", "imgset and streamKey are required", nullptr));
+  }
+  ivs_broadcaster::BroadcastSession::Config config;
+  config.ingest_url = imgset;
+  config.stream_key = stream_key;
+  config.quality = lookup_string(args, "quality", "720");
+  config.auto_reconnect = lookup_bool(args, "autoReconnect", FALSE);
+  config.enforce_encoder_limit =
+      lookup_bool(args, "enforceEncoderLimit", TRUE);
+  config.min_refresh_fps = lookup_double(args, "minRefreshRate", 1.0);
+  ivs_broadcaster::BroadcastSession* session = self->session;
+  dispatch_command(self, method_call, kSessionLane, [session, config] {
+    session->StartPreview(config);
+    g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  });
+  return nullptr;
+}
+
+// Queues the "metadata" string or each of the "messages" and returns how
+// many were accepted. Cheap, so it stays on the platform thread.
+static FlMethodResponse* send_timed_metadata(IvsBroadcasterPlugin* self,
+                                             FlValue* args) {
+  int64_t accepted = 0;
+  const gchar* metadata = lookup_string(args, "metadata", nullptr);
+  if (metadata != nullptr) {
+    accepted += self->session->SendTimedMetadata(metadata);
+  }
+  FlValue* messages = args != nullptr &&
+                              fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                          ? fl_value_lookup_string(args, "messages")
+                          : nullptr;
+  if (messages != nullptr &&
+      fl_value_get_type(messages) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(messages); ++i) {
+      FlValue* message = fl_value_get_list_value(messages, i);
+      if (fl_value_get_type(message) == FL_VALUE_TYPE_STRING) {
+        accepted += self->session->SendTimedMetadata(
+            fl_value_get_string(message));
+      }
+    }
+  }
+  g_autoptr(FlValue) result = fl_value_new_int(accepted);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* configure_timed_metadata(IvsBroadcasterPlugin* self,
+                                                  FlValue* args) {
+  ivs_broadcaster::MetadataQueueConfig config;
+  config.window_us = static_cast<int64_t>(
+      lookup_double(args, "windowMs", config.window_us / 1000.0) * 1000);
+  config.bytes_per_second =
+      lookup_double(args, "bytesPerSecond", config.bytes_per_second);
+  config.burst_bytes = static_cast<size_t>(
+      lookup_double(args, "burstBytes", config.burst_bytes));
+  config.max_payload_bytes = static_cast<size_t>(
+      lookup_double(args, "maxPayloadBytes", config.max_payload_bytes));
+  // Replies with the dictionary viewers need, the built-in one unless Dart
+  // passed its own; null when payloads go out uncompressed.
+  std::shared_ptr<const ivs_broadcaster::MetadataCompressor> compressor;
+  if (lookup_bool(args, "compress", FALSE)) {
+    compressor = std::make_shared<ivs_broadcaster::MetadataCompressor>(
+        lookup_string(args, "dictionary",
+                      ivs_broadcaster::DefaultMetadataDictionary().c_str()));
+  }
+  g_autoptr(FlValue) result =
+      compressor != nullptr
+          ? fl_value_new_string(compressor->dictionary().c_str())
+          : fl_value_new_null();
+  self->session->ConfigureMetadata(config, std::move(compressor));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Mean and worst queue wait and run time of each executor method, in ms.
+static FlValue* command_stats(IvsBroadcasterPlugin* self) {
+  FlValue* stats = fl_value_new_map();
+  for (const auto& entry : self->commands->stats()) {
+    const ivs_broadcaster::CommandStats& timing = entry.second;
+    const double count = static_cast<double>(timing.count);
+    FlValue* method = fl_value_new_map();
+    fl_value_set_string_take(method, "count",
+                             fl_value_new_int(timing.count));
+    fl_value_set_string_take(
+        method, "meanWaitMs",
+        fl_value_new_float(timing.total_wait.count() / count / 1000));
+    fl_value_set_string_take(
+        method, "maxWaitMs",
+        fl_value_new_float(timing.max_wait.count() / 1000.0));
+    fl_value_set_string_take(
+        method, "meanRunMs",
+        fl_value_new_float(timing.total_run.count() / count / 1000));
+    fl_value_set_string_take(
+        method, "maxRunMs",
+        fl_value_new_float(timing.max_run.count() / 1000.0));
+    fl_value_set_string_take(stats, entry.first.c_str(), method);
+  }
+  return stats;
+}
+
+// The memory budget of the players and what each of them holds, selected
+// first.
+static FlValue* memory_stats(IvsBroadcasterPlugin* self) {
+  const ivs_broadcaster::MemoryBudgetStats budget =
+      self->players->memory_stats();
+  FlValue* stats = fl_value_new_map();
+  fl_value_set_string_take(stats, "maxBytes",
+                           fl_value_new_int(budget.max_bytes));
+  fl_value_set_string_take(stats, "bytes", fl_value_new_int(budget.bytes));
+  fl_value_set_string_take(stats, "peakBytes",
+                           fl_value_new_int(budget.peak_bytes));
+  fl_value_set_string_take(stats, "evictions",
+                           fl_value_new_int(budget.evictions));
+  fl_value_set_string_take(stats, "evictedBytes",
+                           fl_value_new_int(budget.evicted_bytes));
+  fl_value_set_string_take(stats, "overruns",
+                           fl_value_new_int(budget.overruns));
+  std::vector<ivs_broadcaster::PlayerInfo> infos = self->players->players();
+  std::stable_sort(infos.begin(), infos.end(),
+                   [](const ivs_broadcaster::PlayerInfo& a,
+                      const ivs_broadcaster::PlayerInfo& b) {
+                     // Players never selected have rank -1; they go last.
+                     return static_cast<unsigned>(a.memory.rank) <
+                            static_cast<unsigned>(b.memory.rank);
+                   });
+  FlValue* players = fl_value_new_list();
+  for (const ivs_broadcaster::PlayerInfo& info : infos) {
+    const ivs_broadcaster::PlayerMemory& memory = info.memory;
+    FlValue* player = fl_value_new_map();
+    fl_value_set_string_take(player, "id",
+                             fl_value_new_string(info.id.c_str()));
+    fl_value_set_string_take(player, "mode",
+                             fl_value_new_string(
+                                 ivs_broadcaster::DecodeModeName(info.mode)));
+    fl_value_set_string_take(player, "rank", fl_value_new_int(memory.rank));
+    fl_value_set_string_take(player, "demuxedBytes",
+                             fl_value_new_int(memory.demuxed_bytes));
+    fl_value_set_string_take(player, "decodedBytes",
+                             fl_value_new_int(memory.decoded_bytes));
+    fl_value_set_string_take(player, "allowanceBytes",
+                             fl_value_new_int(memory.allowance_bytes));
+    fl_value_set_string_take(player, "peakBytes",
+                             fl_value_new_int(memory.peak_bytes));
+    fl_value_set_string_take(player, "evictions",
+                             fl_value_new_int(memory.evictions));
+    fl_value_set_string_take(player, "evictedBytes",
+                             fl_value_new_int(memory.evicted_bytes));
+    fl_value_append_take(players, player);
+  }
+  fl_value_set_string_take(stats, "players", players);
+  return stats;
+}
+
+// A thumbnail on its way from a worker back to the platform thread.
+struct ThumbnailReply {
+  FlMethodCall* method_call;
+  ivs_broadcaster::ThumbnailResult result;
+};
+
+static gboolean thumbnail_reply_cb(gpointer user_data) {
+  std::unique_ptr<ThumbnailReply> reply(
+      static_cast<ThumbnailReply*>(user_data));
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (reply->result.ok) {
+    const std::vector<uint8_t>& data = reply->result.thumbnail->data;
+    g_autoptr(FlValue) result =
+        fl_value_new_uint8_list(data.data(), data.size());
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "THUMBNAIL_FAILED", reply->result.error.c_str(), nullptr));
+  }
+  fl_method_call_respond(reply->method_call, response, nullptr);
+  g_object_unref(reply->method_call);
+  return G_SOURCE_REMOVE;
+}
+
+// Answers getScreenshot asynchronously: decoding and encoding happen on the
+// engine's workers, never on the platform thread.
+static void request_thumbnail(IvsBroadcasterPlugin* self,
+                              FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const gchar* url = lookup_string(args, "url", nullptr);
+  if (url == nullptr) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "url is required", nullptr, nullptr);
+    return;
+  }
+  ivs_broadcaster::ThumbnailRequest request;
+  request.url = url;
+  request.time_us =
+      static_cast<int64_t>(lookup_double(args, "time", 0) * 1000000);
+  request.width = static_cast<int>(lookup_double(args, "width", 320));
+  request.height = static_cast<int>(lookup_double(args, "height", 180));
+  request.quality = static_cast<int>(lookup_double(args, "quality", 80));
+  request.format = strcmp(lookup_string(args, "format", "jpeg"), "webp") == 0
+                       ? ivs_broadcaster::ThumbnailFormat::kWebp
+                       : ivs_broadcaster::ThumbnailFormat::kJpeg;
+  g_object_ref(method_call);
+  self->thumbnails->Request(
+      request, [method_call](const ivs_broadcaster::ThumbnailResult& result) {
+        g_idle_add(thumbnail_reply_cb, new ThumbnailReply{method_call, result});
+      });
+}
+
+// Sprite sheets on their way from the generator back to the platform
+// thread.
+struct SpriteReply {
+  FlMethodCall* method_call;
+  ivs_broadcaster::SpriteResult result;
+};
+
+static gboolean sprite_reply_cb(gpointer user_data) {
+  std::unique_ptr<SpriteReply> reply(static_cast<SpriteReply*>(user_data));
+  const ivs_broadcaster::SpriteResult& sprites = reply->result;
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (sprites.ok) {
+    const ivs_broadcaster::SpriteIndex& index = *sprites.index;
+    g_autoptr(FlValue) result = fl_value_new_map();
+    g_autoptr(FlValue) sheets = fl_value_new_list();
+    for (int sheet = 0; sheet < index.sheets(); ++sheet) {
+      fl_value_append_take(
+          sheets, fl_value_new_string(sprites.SheetPath(sheet).c_str()));
+    }
+    g_autoptr(FlValue) times = fl_value_new_list();
+    for (int64_t time_us : index.times_us()) {
+      fl_value_append_take(times, fl_value_new_float(time_us / 1e6));
+    }
+    fl_value_set_string(result, "sheets", sheets);
+    fl_value_set_string(result, "times", times);
+    fl_value_set_string_take(result, "cellWidth",
+                             fl_value_new_int(index.cell_width()));
+    fl_value_set_string_take(result, "cellHeight",
+                             fl_value_new_int(index.cell_height()));
+    fl_value_set_string_take(result, "columns",
+                             fl_value_new_int(index.columns()));
+    fl_value_set_string_take(result, "rows", fl_value_new_int(index.rows()));
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "SPRITES_FAILED", sprites.error.c_str(), nullptr));
+  }
+  fl_method_call_respond(reply->method_call, response, nullptr);
+  g_object_unref(reply->method_call);
+  return G_SOURCE_REMOVE;
+}
+
+// Answers generateSprites once the sheets are on disk; the keyframes are
+// decoded on the generator's worker.
+static void request_sprites(IvsBroadcasterPlugin* self,
+                            FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const gchar* url = lookup_string(args, "url", nullptr);
+  if (url == nullptr) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "url is required", nullptr, nullptr);
+    return;
+  }
+  ivs_broadcaster::SpriteConfig config;
+  config.interval_us =
+      static_cast<int64_t>(lookup_double(args, "interval", 10) * 1000000);
+  config.cell_width = static_cast<int>(lookup_double(args, "width", 160));
+  config.cell_height = static_cast<int>(lookup_double(args, "height", 90));
+  config.columns = static_cast<int>(lookup_double(args, "columns", 10));
+  config.rows = static_cast<int>(lookup_double(args, "rows", 10));
+  config.quality = static_cast<int>(lookup_double(args, "quality", 70));
+  config.format = strcmp(lookup_string(args, "format", "jpeg"), "webp") == 0
+                      ? ivs_broadcaster::ThumbnailFormat::kWebp
+                      : ivs_broadcaster::ThumbnailFormat::kJpeg;
+  g_object_ref(method_call);
+  self->sprites->Generate(
+      url, config, [method_call](const ivs_broadcaster::SpriteResult& result) {
+        g_idle_add(sprite_reply_cb, new SpriteReply{method_call, result});
+      });
+}
+
+// A prefetchVod warm on its way from the warmer back to the platform
+// thread.
+struct PrefetchReply {
+  FlMethodCall* method_call;
+  ivs_broadcaster::CacheWarmResult result;
+};
+
+static gboolean prefetch_reply_cb(gpointer user_data) {
+  std::unique_ptr<PrefetchReply> reply(static_cast<PrefetchReply*>(user_data));
+  const ivs_broadcaster::CacheWarmResult& warm = reply->result;
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (warm.ok) {
+    g_autoptr(FlValue) result = fl_value_new_map();
+    fl_value_set_string_take(result, "segments",
+                             fl_value_new_int(warm.segments));
+    fl_value_set_string_take(result, "cached", fl_value_new_int(warm.cached));
+    fl_value_set_string_take(result, "bytes", fl_value_new_int(warm.bytes));
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "PREFETCH_FAILED", warm.error.c_str(), nullptr));
+  }
+  fl_method_call_respond(reply->method_call, response, nullptr);
+  g_object_unref(reply->method_call);
+  return G_SOURCE_REMOVE;
+}
+
+// Answers prefetchVod once the segments of the VOD are in the segment
+// cache, where players opening it later find them.
+static void prefetch_vod(IvsBroadcasterPlugin* self,
+                         FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const gchar* url = lookup_string(args, "url", nullptr);
+  if (url == nullptr) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "url is required", nullptr, nullptr);
+    return;
+  }
+  if (self->cache_warmer == nullptr) {
+    fl_method_call_respond_error(method_call, "PREFETCH_FAILED",
+                                 "segment cache unavailable", nullptr,
+                                 nullptr);
+    return;
+  }
+  ivs_broadcaster::CacheWarmConfig config;
+  config.duration_us =
+      static_cast<int64_t>(lookup_double(args, "duration", 0) * 1000000);
+  config.max_bandwidth =
+      static_cast<int64_t>(lookup_double(args, "maxBandwidth", 0));
+  g_object_ref(method_call);
+  self->cache_warmer->Warm(
+      url, config,
+      [method_call](const ivs_broadcaster::CacheWarmResult& result) {
+        g_idle_add(prefetch_reply_cb, new PrefetchReply{method_call, result});
+      });
+}
+
+// Tiles the streams of startMosaic into the mosaic texture and answers
+// with its id. The mosaic is in place before the players start, so their
+// first frames are drawn.
+static void start_mosaic(IvsBroadcasterPlugin* self,
+                         FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const std::vector<std::string> urls = lookup_strings(args, "urls");
+  ivs_broadcaster::MosaicConfig config;
+  config.width = static_cast<int>(lookup_double(args, "width", 1280));
+  config.height = static_cast<int>(lookup_double(args, "height", 720));
+  config.max_fps = static_cast<int>(lookup_double(args, "fps", 30));
+  const int columns = static_cast<int>(lookup_double(args, "columns", 0));
+  if (urls.empty() ||
+      !ivs_broadcaster::MosaicLayoutNamed(lookup_string(args, "layout", "grid"),
+                                          static_cast<int>(urls.size()),
+                                          columns, &config.tiles)) {
+    fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                 "urls and a grid or spotlight layout are "
+                                 "required",
+                                 nullptr, nullptr);
+    return;
+  }
+  IvsPreviewTexture* texture = self->mosaic_texture;
+  auto mosaic = std::make_shared<ivs_broadcaster::MosaicCompositor>(
+      config, [texture](const ivs_broadcaster::FramePtr& frame) {
+        ivs_preview_texture_get_renderer(texture)->Submit(frame);
+      });
+  std::vector<ivs_broadcaster::MosaicSlot> slots;
+  for (size_t i = 0; i < urls.size(); ++i) {
+    const ivs_broadcaster::MosaicRect rect =
+        mosaic->tile_rect(static_cast<int>(i));
+    slots.push_back({urls[i], rect.width, rect.height});
+  }
+  self->player_listener->SetMosaic(std::move(mosaic));
+  // The stream heard, and whose events are sent; selectPlayer changes it.
+  const std::string audio = lookup_string(args, "audio", urls[0].c_str());
+  const int64_t texture_id = fl_texture_get_id(FL_TEXTURE(texture));
+  ivs_broadcaster::MultiPlayer* players = self->players;
+  dispatch_command(self, method_call, kPlayerLane,
+                   [players, urls, slots, audio, texture_id] {
+                     for (const std::string& url : urls) players->Add(url);
+                     players->SetMosaic(slots);
+                     players->Select(audio);
+                     g_autoptr(FlValue) result = fl_value_new_int(texture_id);
+                     return FL_METHOD_RESPONSE(
+                         fl_method_success_response_new(result));
+                   });
+}
+
+static FlMethodResponse* success_bool() {
+  g_autoptr(FlValue) result = fl_value_new_bool(TRUE);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// The player methods of the mobile views, on top of MultiPlayer. Players
+// are keyed by URL, as on iOS. Anything that creates or joins a player
+// thread runs on the executor, in order.
+static void player_method_call_cb(FlMethodChannel* channel,
+                                  FlMethodCall* method_call,
+                                  gpointer user_data) {
+  IvsBroadcasterPlugin* self = IVS_BROADCASTER_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+  ivs_broadcaster::MultiPlayer* players = self->players;
+  if (strcmp(method, "getScreenshot") == 0) {
+    request_thumbnail(self, method_call);
+  } else if (strcmp(method, "generateSprites") == 0) {
+    request_sprites(self, method_call);
+  } else if (strcmp(method, "prefetchVod") == 0) {
+    prefetch_vod(self, method_call);
+  } else if (strcmp(method, "startMosaic") == 0) {
+    start_mosaic(self, method_call);
+  } else if (strcmp(method, "stopMosaic") == 0) {
+    self->player_listener->SetMosaic(nullptr);
+    dispatch_command(self, method_call, kPlayerLane, [players] {
+      players->SetMosaic({});
+      return success_bool();
+    });
+  } else if (strcmp(method, "multiPlayer") == 0) {
+    const std::vector<std::string> list = lookup_strings(args, "urls");
+    const int64_t interval_us = position_interval_us(args);
+    // The first URL is shown; the others stay warm in the background.
+    dispatch_command(self, method_call, kPlayerLane,
+                     [players, list, interval_us] {
+                       players->SetPositionInterval(interval_us);
+                       for (const std::string& url : list) players->Add(url);
+                       if (!list.empty()) players->Select(list.front());
+                       return success_string("Players created successfully");
+                     });
+  } else if (strcmp(method, "createPlayer") == 0 ||
+             strcmp(method, "startPlayer") == 0 ||
+             strcmp(method, "selectPlayer") == 0) {
+    const bool start = strcmp(method, "startPlayer") == 0;
+    const gchar* url =
+        lookup_string(args, start ? "url" : "playerId", nullptr);
+    if (url == nullptr) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                   "A url is required", nullptr, nullptr);
+      return;
+    }
+    const bool select = strcmp(method, "createPlayer") != 0;
+    const bool pause = start && !lookup_bool(args, "autoPlay", TRUE);
+    const int64_t interval_us = start ? position_interval_us(args) : -1;
+    dispatch_command(self, method_call, kPlayerLane,
+                     [players, id = std::string(url), select, pause,
+                      interval_us] {
+                       if (interval_us >= 0) {
+                         players->SetPositionInterval(interval_us);
+                       }
+                       players->Add(id);
+                       if (select) players->Select(id);
+                       if (pause) players->Pause();
+                       return success_bool();
+                     });
+  } else if (strcmp(method, "stopPlayer") == 0) {
+    dispatch_command(self, method_call, kPlayerLane, [players] {
+      players->Remove(players->selected());
+      return success_bool();
+    });
+  } else if (strcmp(method, "pause") == 0) {
+    players->Pause();
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "resume") == 0) {
+    players->Resume();
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "qualities") == 0) {
+    g_autoptr(FlValue) result = fl_value_new_list();
+    for (const ivs_broadcaster::AbrRendition& rendition :
+         players->qualities()) {
+      fl_value_append_take(result,
+                           fl_value_new_string(rendition.name.c_str()));
+    }
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    fl_method_call_respond(method_call, response, nullptr);
+  } else if (strcmp(method, "setQuality") == 0) {
+    const gchar* quality = lookup_string(args, "quality", nullptr);
+    if (quality == nullptr || !players->SetQuality(quality)) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                   "Unknown quality", nullptr, nullptr);
+      return;
+    }
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "autoQuality") == 0) {
+    players->SetAutoQuality(!players->auto_quality());
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "isAuto") == 0) {
+    g_autoptr(FlValue) result = fl_value_new_bool(players->auto_quality());
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    fl_method_call_respond(method_call, response, nullptr);
+  } else if (strcmp(method, "seek") == 0) {
+    // In seconds, sent as a string like on the other platforms.
+    const gchar* time = lookup_string(args, "time", nullptr);
+    const double seconds =
+        time != nullptr ? g_ascii_strtod(time, nullptr)
+                        : lookup_double(args, "time", -1);
+    if (seconds < 0) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGUMENTS",
+                                   "Missing time", nullptr, nullptr);
+      return;
+    }
+    players->Seek(static_cast<int64_t>(seconds * 1e6));
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "position") == 0) {
+    // In seconds, like Android's.
+    const int64_t position_us = players->position_us();
+    g_autoptr(FlValue) result =
+        fl_value_new_float(std::max<int64_t>(position_us, 0) / 1e6);
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    fl_method_call_respond(method_call, response, nullptr);
+  } else if (strcmp(method, "getCues") == 0) {
+    const double from = lookup_double(args, "from", 0);
+    const double to = lookup_double(args, "to", from);
+    const std::vector<ivs_broadcaster::MetadataCue> cues =
+        players->CuesBetween(static_cast<int64_t>(from * 1e6),
+                             static_cast<int64_t>(to * 1e6));
+    g_autoptr(FlValue) result = fl_value_new_list();
+    for (const ivs_broadcaster::MetadataCue& cue : cues) {
+      fl_value_append_take(result, cue_value(cue));
+    }
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    fl_method_call_respond(method_call, response, nullptr);
+  } else if (strcmp(method, "setTargetLatency") == 0) {
+    // In seconds; 0 returns to the stream's own target.
+    const double latency = lookup_double(args, "latency", 0);
+    players->SetTargetLatency(static_cast<int64_t>(latency * 1e6));
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "getMemoryStats") == 0) {
+    g_autoptr(FlValue) result = memory_stats(self);
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    fl_method_call_respond(method_call, response, nullptr);
+  } else if (strcmp(method, "mute") == 0) {
+    // Audio is not played on Linux yet.
+    fl_method_call_respond(method_call, success_bool(), nullptr);
+  } else if (strcmp(method, "getTextureId") == 0) {
+    g_autoptr(FlValue) result =
+        self->player_texture != nullptr
+            ? fl_value_new_int(
+                  fl_texture_get_id(FL_TEXTURE(self->player_texture)))
+            : fl_value_new_null();
+    g_autoptr(FlMethodResponse) response =
+        FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    fl_method_call_respond(method_call, response, nullptr);
+  } else {
+    fl_method_call_respond_not_implemented(method_call, nullptr);
+  }
+}
+
+void ivs_broadcaster_plugin_handle_method_call(IvsBroadcasterPlugin* self,
+                                               FlMethodCall* method_call) {
+  g_autoptr(FlMethodResponse) response = nullptr;
+
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  ivs_broadcaster::BroadcastSession* session = self->session;
+  if (strcmp(method, "startPreview") == 0) {
+    response = start_preview(self, method_call);
+    if (response == nullptr) return;
+  } else if (strcmp(method, "startBroadcast") == 0) {
+    dispatch_command(self, method_call, kSessionLane, [session] {
+      session->StartBroadcast();
+      return success_string("Broadcasting Started");
+    });
+    return;
+  } else if (strcmp(method, "stopBroadcast") == 0) {
+    // Joins the capture and encode threads, which can take a while.
+    dispatch_command(self, method_call, kSessionLane, [session] {
+      session->Stop();
+      return success_string("Broadcast Stopped");
+    });
+    return;
+  } else if (strcmp(method, "sendTimeMetaData") == 0) {
+    response = send_timed_metadata(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "configureTimedMetadata") == 0) {
+    response =
+        configure_timed_metadata(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, "getCommandStats") == 0) {
+    g_autoptr(FlValue) result = command_stats(self);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else if (strcmp(method, "getPreviewTextureId") == 0) {
+    g_autoptr(FlValue) result =
+        self->preview_texture != nullptr
+            ? fl_value_new_int(
+                  fl_texture_get_id(FL_TEXTURE(self->preview_texture)))
+            : fl_value_new_null();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else if (strcmp(method, "getEncoderCapabilities") == 0) {
+    if (!self->calibrated) {
+      g_ptr_array_add(self->pending_capability_calls,
+                      g_object_ref(method_call));
+      return;
+    }
+    g_autoptr(FlValue) result = encoder_capabilities(self);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  fl_method_call_respond(method_call, response, nullptr);
+}
+
+static FlMethodErrorResponse* listen_cb(FlEventChannel* channel, FlValue* args,
+                                        gpointer user_data) {
+  IVS_BROADCASTER_PLUGIN(user_data)->listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* cancel_cb(FlEventChannel* channel, FlValue* args,
+                                        gpointer user_data) {
+  IVS_BROADCASTER_PLUGIN(user_data)->listening = FALSE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* player_listen_cb(FlEventChannel* channel,
+                                               FlValue* args,
+                                               gpointer user_data) {
+  IVS_BROADCASTER_PLUGIN(user_data)->player_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* player_cancel_cb(FlEventChannel* channel,
+                                               FlValue* args,
+                                               gpointer user_data) {
+  IVS_BROADCASTER_PLUGIN(user_data)->player_listening = FALSE;
+  return nullptr;
+}
+
+static void ivs_broadcaster_plugin_dispose(GObject* object) {
+  IvsBroadcasterPlugin* self = IVS_BROADCASTER_PLUGIN(object);
+
+  // Finishes queued session commands; their replies hold their own
+  // references to the method calls.
+  delete self->commands;
+  self->commands = nullptr;
+  if (self->session != nullptr) {
+    self->session->Stop();
+    delete self->session;
+    self->session = nullptr;
+  }
+  if (self->preview_texture != nullptr) {
+    ivs_preview_texture_unregister(self->preview_texture);
+    g_clear_object(&self->preview_texture);
+  }
+  delete self->listener;
+  self->listener = nullptr;
+  // Stops the player threads before the texture they draw into goes away.
+  delete self->players;
+  self->players = nullptr;
+  delete self->decode_pool;
+  self->decode_pool = nullptr;
+  delete self->cache_warmer;
+  self->cache_warmer = nullptr;
+  delete self->segment_cache;
+  self->segment_cache = nullptr;
+  delete self->player_listener;
+  self->player_listener = nullptr;
+  if (self->player_texture != nullptr) {
+    ivs_preview_texture_unregister(self->player_texture);
+    g_clear_object(&self->player_texture);
+  }
+  if (self->mosaic_texture != nullptr) {
+    ivs_preview_texture_unregister(self->mosaic_texture);
+    g_clear_object(&self->mosaic_texture);
+  }
+  g_clear_object(&self->player_event_channel);
+  // Queued requests are answered with an error on the way out.
+  delete self->thumbnails;
+  self->thumbnails = nullptr;
+  delete self->sprites;
+  self->sprites = nullptr;
+  delete self->events;
+  self->events = nullptr;
+  delete self->player_events;
+  self->player_events = nullptr;
+  if (self->calibration != nullptr) {
+    self->calibration->join();
+    delete self->calibration;
+    self->calibration = nullptr;
+  }
+  delete self->encoders;
+  self->encoders = nullptr;
+  g_clear_pointer(&self->pending_capability_calls, g_ptr_array_unref);
+  g_clear_object(&self->event_channel);
+  for (FlValue*& event : self->state_events) {
+    g_clear_pointer(&event, fl_value_unref);
+  }
+
+  G_OBJECT_CLASS(ivs_broadcaster_plugin_parent_class)->dispose(object);
+}
+
+static void ivs_broadcaster_plugin_class_init(
+    IvsBroadcasterPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = ivs_broadcaster_plugin_dispose;
+}
+
+static void ivs_broadcaster_plugin_init(IvsBroadcasterPlugin* self) {
+  for (int i = 0; i < kBroadcastStateCount; ++i) {
+    FlValue* event = fl_value_new_map();
+    fl_value_set_string_take(
+        event, "state",
+        fl_value_new_string(ivs_broadcaster::BroadcastStateName(
+            static_cast<ivs_broadcaster::BroadcastState>(i))));
+    self->state_events[i] = event;
+  }
+  self->encoders = new ivs_broadcaster::EncoderRegistry();
+  ivs_broadcaster::RegisterFfmpegEncoderBackends(self->encoders);
+  self->pending_capability_calls = g_ptr_array_new_with_free_func(g_object_unref);
+  self->events = new BroadcasterEventHub(
+      ivs_broadcaster::EventHubConfig(),
+      [self](std::chrono::milliseconds delay) {
+        schedule_drain(self, drain_events_cb, delay);
+      });
+  self->player_events = new PlayerEventHub(
+      ivs_broadcaster::EventHubConfig(),
+      [self](std::chrono::milliseconds delay) {
+        schedule_drain(self, drain_player_events_cb, delay);
+      });
+  self->listener = new SessionListener(self);
+  self->thumbnails = new ivs_broadcaster::ThumbnailEngine(
+      [] { return ivs_broadcaster::CreateFfmpegThumbnailCodec(); },
+      ivs_broadcaster::ThumbnailEngine::Config());
+  self->sprites = new ivs_broadcaster::SpriteSheetGenerator(
+      [] { return ivs_broadcaster::CreateFfmpegThumbnailCodec(); },
+      ivs_broadcaster::DefaultSpriteCacheDir());
+  self->player_listener = new PlayerListener(self);
+  self->decode_pool =
+      new ivs_broadcaster::DecodePool(ivs_broadcaster::DecodePoolConfig());
+  ivs_broadcaster::SegmentCacheConfig cache_config;
+  cache_config.directory = ivs_broadcaster::DefaultSegmentCacheDir();
+  std::string cache_error;
+  self->segment_cache =
+      ivs_broadcaster::SegmentCache::Open(cache_config, &cache_error)
+          .release();
+  if (self->segment_cache == nullptr) {
+    g_warning("Segment cache disabled: %s", cache_error.c_str());
+  } else {
+    self->cache_warmer =
+        new ivs_broadcaster::SegmentCacheWarmer(self->segment_cache);
+  }
+  ivs_broadcaster::DecodePool* decode_pool = self->decode_pool;
+  ivs_broadcaster::SegmentCache* segment_cache = self->segment_cache;
+  self->players = new ivs_broadcaster::MultiPlayer(
+      [decode_pool, segment_cache] {
+        return ivs_broadcaster::CreateFfmpegMediaSource(decode_pool,
+                                                        segment_cache);
+      },
+      ivs_broadcaster::MultiPlayerConfig(), self->player_listener);
+  self->session =
+      new ivs_broadcaster::BroadcastSession(self->encoders, self->listener);
+  self->commands = new ivs_broadcaster::CommandExecutor(2);
+
+  // Benchmarking takes a few seconds on first run; keep it off the platform
+  // thread. Cached results make later launches near instant.
+  g_object_ref(self);
+  self->calibration = new std::thread([self] {
+    self->encoders->Calibrate(ivs_broadcaster::DefaultBenchmarkCachePath(),
+                              ivs_broadcaster::ReadCpuModel());
+    g_idle_add(calibration_done_cb, self);
+  });
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                           gpointer user_data) {
+  IvsBroadcasterPlugin* plugin = IVS_BROADCASTER_PLUGIN(user_data);
+  ivs_broadcaster_plugin_handle_method_call(plugin, method_call);
+}
+
+void ivs_broadcaster_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  IvsBroadcasterPlugin* plugin = IVS_BROADCASTER_PLUGIN(
+      g_object_new(ivs_broadcaster_plugin_get_type(), nullptr));
+
+  FlBinaryMessenger* messenger = fl_plugin_registrar_get_messenger(registrar);
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel = fl_method_channel_new(
+      messenger, "ivs_broadcaster", FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(
+      channel, method_call_cb, g_object_ref(plugin), g_object_unref);
+
+  g_autoptr(FlMethodChannel) player_channel = fl_method_channel_new(
+      messenger, "ivs_player", FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(
+      player_channel, player_method_call_cb, g_object_ref(plugin),
+      g_object_unref);
+  plugin->player_event_channel = fl_event_channel_new(
+      messenger, "ivs_player_event", FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->player_event_channel,
+                                       player_listen_cb, player_cancel_cb,
+                                       plugin, nullptr);
+
+  plugin->event_channel = fl_event_channel_new(
+      messenger, "ivs_broadcaster_event", FL_METHOD_CODEC(codec));
+  // The plugin owns the event channel, so the handlers borrow it.
+  fl_event_channel_set_stream_handlers(plugin->event_channel, listen_cb,
+                                       cancel_cb, plugin, nullptr);
+
+  plugin->preview_texture = ivs_preview_texture_new(
+      fl_plugin_registrar_get_texture_registrar(registrar));
+  plugin->session->SetPreview(
+      ivs_preview_texture_get_renderer(plugin->preview_texture));
+  plugin->player_texture = ivs_preview_texture_new(
+      fl_plugin_registrar_get_texture_registrar(registrar));
+  plugin->mosaic_texture = ivs_preview_texture_new(
+      fl_plugin_registrar_get_texture_registrar(registrar));
+
+  g_object_unref(plugin);
+}
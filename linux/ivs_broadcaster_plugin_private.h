@@ -0,0 +1,11 @@
+#include <flutter_linux/flutter_linux.h>
+
+#include "include/ivs_broadcaster/ivs_broadcaster_plugin.h"
+
+// This file exposes some plugin internals for unit testing. See
+// https://github.com/flutter/flutter/issues/88724 for current limitations
+// in the unit-testable API.
+
+// Handles a call on the "ivs_broadcaster" method channel.
+void ivs_broadcaster_plugin_handle_method_call(IvsBroadcasterPlugin* self,
+                                               FlMethodCall* method_call);
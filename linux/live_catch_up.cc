@@ -0,0 +1,40 @@
+#include "live_catch_up.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace ivs_broadcaster {
+
+CatchUpController::CatchUpController(const CatchUpConfig& config)
+    : config_(config) {}
+
+void CatchUpController::Reset() {
+  rate_ = 1;
+  steering_ = false;
+  last_update_us_ = -1;
+}
+
+double CatchUpController::Update(int64_t latency_us, int64_t target_us,
+                                 int64_t now_us) {
+  const int64_t error_us = latency_us - target_us;
+  // Starts steering outside the tolerance and stops within half of it, so
+  // latency hovering at the edge does not toggle the rate.
+  if (std::llabs(error_us) > config_.tolerance_us) {
+    steering_ = true;
+  } else if (std::llabs(error_us) <= config_.tolerance_us / 2) {
+    steering_ = false;
+  }
+  double wanted = 1;
+  if (steering_) {
+    wanted = std::clamp(1 + config_.gain * error_us / 1e6, config_.min_rate,
+                        config_.max_rate);
+  }
+  const double elapsed_s =
+      last_update_us_ < 0 ? 0 : (now_us - last_update_us_) / 1e6;
+  last_update_us_ = now_us;
+  const double step = config_.max_rate_change_per_s * elapsed_s;
+  rate_ = std::clamp(wanted, rate_ - step, rate_ + step);
+  return rate_;
+}
+
+}  // namespace ivs_broadcaster
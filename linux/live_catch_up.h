@@ -0,0 +1,52 @@
+#ifndef IVS_BROADCASTER_LIVE_CATCH_UP_H_
+#define IVS_BROADCASTER_LIVE_CATCH_UP_H_
+
+#include <cstdint>
+
+namespace ivs_broadcaster {
+
+struct CatchUpConfig {
+  // The latency behind the live edge playback returns to. 0 takes the one
+  // the stream recommends, e.g. its HLS hold-back; below 0 turns catch-up
+  // off.
+  int64_t target_latency_us = 0;
+  double min_rate = 0.9;
+  double max_rate = 1.1;
+  // Within this of the target, playback runs at 1x.
+  int64_t tolerance_us = 300000;
+  // Rate change per second of latency off target, so that 1 s behind plays
+  // at 1.1x.
+  double gain = 0.1;
+  // The most the rate moves per second, so that speeding up and slowing
+  // down are gradual.
+  double max_rate_change_per_s = 0.1;
+};
+
+// Chooses a playback rate that steers the latency behind the live edge to
+// a target, e.g. after a rebuffer left playback further behind than it
+// should be. Far from the target the rate is proportional to the error and
+// clamped; near it playback returns to 1x, which it holds until the error
+// exceeds the tolerance again. Not thread-safe.
+class CatchUpController {
+ public:
+  explicit CatchUpController(const CatchUpConfig& config);
+
+  // The rate to play at from |now_us|, with playback |latency_us| behind
+  // the live edge and aiming for |target_us|.
+  double Update(int64_t latency_us, int64_t target_us, int64_t now_us);
+  double rate() const { return rate_; }
+
+  // Back to 1x at once, e.g. when the stream changes.
+  void Reset();
+
+ private:
+  const CatchUpConfig config_;
+  double rate_ = 1;
+  // Steering towards the target rather than holding 1x.
+  bool steering_ = false;
+  int64_t last_update_us_ = -1;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_LIVE_CATCH_UP_H_
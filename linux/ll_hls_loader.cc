@@ -0,0 +1,626 @@
+#include "ll_hls_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include "http_client.h"
+#include "segment_cache.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool IsMasterPlaylist(std::string_view text) {
+  return text.find("#EXT-X-STREAM-INF") != std::string_view::npos;
+}
+
+}  // namespace
+
+LlHlsLoader::LlHlsLoader(const LlHlsConfig& config)
+    : config_(config),
+      client_(std::make_unique<HttpClient>()),
+      max_buffered_bytes_(config.max_buffered_bytes) {
+  client_->set_cancel_check([this] { return stopping(); });
+}
+
+LlHlsLoader::~LlHlsLoader() {
+  Interrupt();
+  if (thread_.joinable()) thread_.join();
+}
+
+std::string LlHlsLoader::ChooseVariant(std::vector<HlsVariant> variants) {
+  if (config_.abr != nullptr && variants.size() > 1) {
+    std::stable_sort(variants.begin(), variants.end(),
+                     [](const HlsVariant& a, const HlsVariant& b) {
+                       return a.bandwidth < b.bandwidth;
+                     });
+    std::vector<AbrRendition> ladder;
+    for (const HlsVariant& variant : variants) {
+      AbrRendition rendition;
+      rendition.name = AbrRenditionName(variant.height, variant.bandwidth);
+      rendition.bandwidth = variant.bandwidth;
+      rendition.width = variant.width;
+      rendition.height = variant.height;
+      // Renditions of one resolution at several bitrates.
+      for (const AbrRendition& other : ladder) {
+        if (other.name == rendition.name) {
+          rendition.name += " " + AbrRenditionName(0, variant.bandwidth);
+          break;
+        }
+      }
+      ladder.push_back(std::move(rendition));
+    }
+    variants_ = std::move(variants);
+    config_.abr->SetLadder(std::move(ladder));
+    variant_ = std::max(config_.abr->Decide(0, 0).index, 0);
+    return variants_[variant_].uri;
+  }
+  return ChooseHlsVariant(variants, config_.max_bandwidth)->uri;
+}
+
+bool LlHlsLoader::SwitchVariant(int index) {
+  variant_ = index;
+  media_url_ = variants_[index].uri;
+  // Another variant's playlist, not an update of the one held.
+  playlist_ = HlsMediaPlaylist();
+  hint_loaded_.clear();
+  ClearPrefetch();
+  if (!LoadPlaylist(media_url_, false)) return false;
+  low_latency_ = config_.low_latency && playlist_.part_target_us > 0;
+  if (cursor_.part == 0 && !low_latency_) cursor_.part = -1;
+  if (cursor_.part < 0 && low_latency_) cursor_.part = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.variant_switches;
+  return true;
+}
+
+int64_t LlHlsLoader::BufferedUs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  double buffered_us = 0;
+  for (const Span& span : spans_) {
+    const int64_t unread = span.end - std::max(span.start, consumed_);
+    if (unread <= 0) continue;
+    buffered_us += static_cast<double>(span.duration_us) * unread /
+                   std::max<int64_t>(span.end - span.start, 1);
+  }
+  return static_cast<int64_t>(buffered_us);
+}
+
+size_t LlHlsLoader::BufferedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return buffer_.capacity();
+}
+
+void LlHlsLoader::SetMaxBufferedBytes(size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes == max_buffered_bytes_) return;
+    max_buffered_bytes_ = bytes;
+  }
+  writable_.notify_all();
+}
+
+bool LlHlsLoader::Open(const std::string& url, std::string* error) {
+  std::string text;
+  HttpResponse response;
+  const bool ok = client_->Get(
+      url, 0, -1,
+      [&text](const uint8_t* data, size_t size, const HttpResponse&) {
+        text.append(reinterpret_cast<const char*>(data), size);
+        return true;
+      },
+      &response);
+  if (!ok) {
+    *error = "cannot load " + url + ": " + response.error;
+    return false;
+  }
+  media_url_ = url;
+  if (IsMasterPlaylist(text)) {
+    std::vector<HlsVariant> variants;
+    if (!ParseHlsMasterPlaylist(text, &variants, error)) return false;
+    for (HlsVariant& variant : variants) {
+      variant.uri = ResolveHlsUrl(url, variant.uri);
+    }
+    media_url_ = ChooseVariant(std::move(variants));
+    if (!LoadPlaylist(media_url_, false)) {
+      *error = error_;
+      return false;
+    }
+  } else {
+    HlsUpdateStats stats;
+    if (!ParseHlsPlaylist(text, &playlist_, &stats, error)) return false;
+    playlist_loaded_us_ = NowUs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.playlist_requests;
+  }
+  if (playlist_.segments.empty()) {
+    *error = "no segments in " + media_url_;
+    return false;
+  }
+  low_latency_ = config_.low_latency && playlist_.part_target_us > 0;
+  live_ = !playlist_.end_list;
+  duration_us_ = live_ ? -1 : playlist_.duration_us;
+  ChooseStart();
+  // The variant was just chosen for the first segment.
+  decided_msn_ = cursor_.msn;
+  thread_ = std::thread(&LlHlsLoader::Run, this);
+  return true;
+}
+
+int64_t LlHlsLoader::Read(uint8_t* buffer, size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  readable_.wait(lock, [this] {
+    return stopping_ || finished_ || read_offset_ < buffer_.size();
+  });
+  if (stopping_) return -1;
+  const size_t available = buffer_.size() - read_offset_;
+  if (available == 0) return error_.empty() ? 0 : -1;
+  const size_t count = std::min(size, available);
+  std::memcpy(buffer, buffer_.data() + read_offset_, count);
+  read_offset_ += count;
+  consumed_ += count;
+  while (!spans_.empty() && spans_.front().end <= consumed_) {
+    spans_.pop_front();
+  }
+  // Compact once the consumed head outweighs what is left.
+  if (read_offset_ > buffer_.size() / 2) {
+    buffer_.erase(buffer_.begin(), buffer_.begin() + read_offset_);
+    read_offset_ = 0;
+    // Gives back what a larger limit, since lowered, left allocated.
+    if (buffer_.capacity() > 2 * max_buffered_bytes_) buffer_.shrink_to_fit();
+  }
+  writable_.notify_all();
+  return static_cast<int64_t>(count);
+}
+
+void LlHlsLoader::Interrupt() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  readable_.notify_all();
+  writable_.notify_all();
+}
+
+std::string LlHlsLoader::error() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return error_;
+}
+
+LlHlsStats LlHlsLoader::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+bool LlHlsLoader::stopping() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_;
+}
+
+void LlHlsLoader::Run() {
+  while (Step()) {
+  }
+}
+
+void LlHlsLoader::ChooseStart() {
+  const HlsServerControl& control = playlist_.server_control;
+  const std::deque<HlsSegment>& segments = playlist_.segments;
+  int64_t behind_us = 0;
+  if (playlist_.end_list) {
+    // Not live: from the segment holding start_us.
+    cursor_ = {segments.front().sequence, -1};
+    int64_t start_us = 0;
+    for (const HlsSegment& segment : segments) {
+      if (start_us + segment.duration_us > config_.start_us) {
+        cursor_.msn = segment.sequence;
+        break;
+      }
+      start_us += segment.duration_us;
+    }
+    stats_.start_offset_us = playlist_.duration_us - start_us;
+    return;
+  }
+  if (low_latency_) {
+    const int64_t hold_back_us = control.part_hold_back_us > 0
+                                     ? control.part_hold_back_us
+                                     : 3 * playlist_.part_target_us;
+    // Walk back over the parts, newest first, until far enough from the
+    // edge and at a part a decoder can start from.
+    for (size_t i = playlist_.pending_parts.size(); i-- > 0;) {
+      const HlsPart& part = playlist_.pending_parts[i];
+      behind_us += part.duration_us;
+      if (behind_us >= hold_back_us && part.independent) {
+        cursor_ = {playlist_.next_sequence(), static_cast<int64_t>(i)};
+        stats_.start_offset_us = behind_us;
+        return;
+      }
+    }
+    for (size_t s = segments.size(); s-- > 0;) {
+      const HlsSegment& segment = segments[s];
+      if (segment.parts.empty()) {
+        // Beyond the listed parts: start with this segment, whole.
+        behind_us += segment.duration_us;
+        cursor_ = {segment.sequence, -1};
+        stats_.start_offset_us = behind_us;
+        return;
+      }
+      for (size_t i = segment.parts.size(); i-- > 0;) {
+        const HlsPart& part = segment.parts[i];
+        behind_us += part.duration_us;
+        if (behind_us >= hold_back_us && part.independent) {
+          cursor_ = {segment.sequence, static_cast<int64_t>(i)};
+          stats_.start_offset_us = behind_us;
+          return;
+        }
+      }
+    }
+    cursor_ = {segments.front().sequence, 0};
+    stats_.start_offset_us = behind_us;
+    return;
+  }
+  const int64_t hold_back_us = control.hold_back_us > 0
+                                   ? control.hold_back_us
+                                   : 3 * playlist_.target_duration_us;
+  cursor_ = {segments.front().sequence, -1};
+  for (size_t s = segments.size(); s-- > 0;) {
+    behind_us += segments[s].duration_us;
+    if (behind_us >= hold_back_us) {
+      cursor_.msn = segments[s].sequence;
+      break;
+    }
+  }
+  stats_.start_offset_us = behind_us;
+}
+
+bool LlHlsLoader::Step() {
+  if (stopping()) return false;
+  const bool ended =
+      playlist_.end_list && cursor_.msn >= playlist_.next_sequence();
+  if (adaptive() && !ended && cursor_.part <= 0 &&
+      cursor_.msn != decided_msn_) {
+    // Variants switch where segments start, which decoders can start from.
+    decided_msn_ = cursor_.msn;
+    const AbrDecision decision =
+        config_.abr->Decide(BufferedUs(), playlist_.target_duration_us);
+    if (decision.index >= 0 && decision.index != variant_) {
+      return SwitchVariant(decision.index);
+    }
+  }
+  const HlsSegment* segment = playlist_.Find(cursor_.msn);
+  if (segment == nullptr && cursor_.msn < playlist_.media_sequence()) {
+    // Fell out of the window: jump to the oldest segment still listed.
+    cursor_ = {playlist_.media_sequence(), low_latency_ ? 0 : -1};
+    segment = playlist_.Find(cursor_.msn);
+  }
+  if (segment != nullptr) {
+    if (cursor_.part >= 0 && !segment->parts.empty()) {
+      if (cursor_.part >= static_cast<int64_t>(segment->parts.size())) {
+        cursor_ = {cursor_.msn + 1, 0};
+        return true;
+      }
+      const HlsPart& part = segment->parts[cursor_.part];
+      if (!part.gap &&
+          (!LoadMap(segment->map) ||
+           !Load(part.uri, part.byte_range, part.duration_us, false))) {
+        return false;
+      }
+      ++cursor_.part;
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.parts;
+      return true;
+    }
+    // A segment listed without parts, or loaded whole by choice.
+    if (cursor_.part > 0) {
+      // Its first parts were loaded before they aged out; the rest of it
+      // cannot be told apart, so carry on with the next segment.
+      cursor_ = {cursor_.msn + 1, low_latency_ ? 0 : -1};
+      return true;
+    }
+    if (!segment->gap &&
+        (!LoadMap(segment->map) || !LoadSegment(*segment))) {
+      return false;
+    }
+    cursor_ = {cursor_.msn + 1, low_latency_ ? 0 : -1};
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.segments;
+    return true;
+  }
+
+  if (cursor_.msn == playlist_.next_sequence()) {
+    if (playlist_.end_list) {
+      Finish("");
+      return false;
+    }
+    if (low_latency_) {
+      const int64_t listed = playlist_.pending_parts.size();
+      if (cursor_.part >= 0 && cursor_.part < listed) {
+        const HlsPart& part = playlist_.pending_parts[cursor_.part];
+        const std::shared_ptr<const HlsMap> map =
+            playlist_.segments.empty() ? nullptr
+                                       : playlist_.segments.back().map;
+        if (!part.gap &&
+            (!LoadMap(map) ||
+             !Load(part.uri, part.byte_range, part.duration_us, false))) {
+          return false;
+        }
+        ++cursor_.part;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.parts;
+        return true;
+      }
+      const HlsPreloadHint& hint = playlist_.preload_hint;
+      const std::string hint_key =
+          hint.uri + "@" + std::to_string(hint.byte_range.offset);
+      if (cursor_.part == listed && hint.type == HlsPreloadHint::Type::kPart &&
+          !hint.uri.empty() && hint_key != hint_loaded_) {
+        // Asked for before it exists; the server answers as it is made.
+        hint_loaded_ = hint_key;
+        const std::shared_ptr<const HlsMap> map =
+            playlist_.segments.empty() ? nullptr
+                                       : playlist_.segments.back().map;
+        if (!LoadMap(map) ||
+            !Load(hint.uri, hint.byte_range, playlist_.part_target_us,
+                  true)) {
+          return false;
+        }
+        ++cursor_.part;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.parts;
+        ++stats_.hinted_parts;
+        return true;
+      }
+    }
+  }
+
+  // Nothing loadable is listed yet: reload.
+  const int64_t delay_us =
+      HlsReloadDelayUs(playlist_, playlist_changed_) -
+      (NowUs() - playlist_loaded_us_);
+  if (delay_us > 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (writable_.wait_for(lock, std::chrono::microseconds(delay_us),
+                           [this] { return stopping_; })) {
+      return false;
+    }
+  }
+  const bool blocking =
+      low_latency_ && playlist_.server_control.can_block_reload;
+  const std::string url =
+      blocking ? HlsReloadUrl(media_url_, playlist_,
+                              NowUs() - playlist_loaded_us_)
+               : media_url_;
+  return LoadPlaylist(url, blocking);
+}
+
+bool LlHlsLoader::LoadPlaylist(const std::string& url, bool blocking) {
+  for (int attempt = 0; attempt < config_.max_attempts; ++attempt) {
+    HlsPlaylistParser parser(&playlist_);
+    HttpResponse response;
+    const bool ok = client_->Get(
+        url, 0, -1,
+        [&parser](const uint8_t* data, size_t size, const HttpResponse&) {
+          return parser.Feed(std::string_view(
+              reinterpret_cast<const char*>(data), size));
+        },
+        &response);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.playlist_requests;
+      if (blocking) ++stats_.blocking_reloads;
+    }
+    if (ok && parser.Finish()) {
+      playlist_loaded_us_ = NowUs();
+      playlist_changed_ = parser.stats().changed();
+      return true;
+    }
+    if (stopping()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.failed_requests;
+    error_ = "cannot load " + url + ": " +
+             (ok ? parser.error() : response.error);
+  }
+  Finish(error());
+  return false;
+}
+
+bool LlHlsLoader::LoadMap(const std::shared_ptr<const HlsMap>& map) {
+  if (map == nullptr) return true;
+  const std::string key = map->uri + "@" +
+                          std::to_string(map->byte_range.offset) + "+" +
+                          std::to_string(map->byte_range.length);
+  if (key == map_written_) return true;
+  if (!Load(map->uri, map->byte_range, 0, false)) return false;
+  map_written_ = key;
+  return true;
+}
+
+bool LlHlsLoader::Load(const std::string& uri, const HlsByteRange& range,
+                       int64_t duration_us, bool hinted) {
+  const std::string url = ResolveHlsUrl(media_url_, uri);
+  // A live playlist's segments are rarely wanted again.
+  SegmentCache* cache =
+      playlist_.end_list && !hinted ? config_.cache : nullptr;
+  const std::string key =
+      cache != nullptr ? SegmentCacheKey(url, range.offset, range.length)
+                       : std::string();
+  CachedSegment cached;
+  if (cache != nullptr && cache->Get(key, &cached)) {
+    // Straight from the mapped pack. Says nothing about the network, so
+    // the AbrController is not told.
+    if (!Append(cached.data, cached.size)) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.cache_hits;
+    stats_.cache_bytes += cached.size;
+    if (duration_us > 0) {
+      spans_.push_back(
+          {appended_ - static_cast<int64_t>(cached.size), appended_,
+           duration_us});
+    }
+    return true;
+  }
+  std::vector<uint8_t> loaded;
+  for (int attempt = 0; attempt < config_.max_attempts; ++attempt) {
+    int64_t received = 0;
+    int64_t first_byte_us = 0;
+    const int64_t start_us = NowUs();
+    HttpResponse response;
+    const bool ok = client_->Get(
+        url, range.offset, range.length,
+        [this, cache, &loaded, &received, &first_byte_us](
+            const uint8_t* data, size_t size, const HttpResponse&) {
+          if (received == 0) first_byte_us = NowUs();
+          received += size;
+          if (cache != nullptr) loaded.insert(loaded.end(), data, data + size);
+          return Append(data, size);
+        },
+        &response);
+    if (ok) {
+      if (cache != nullptr) cache->Put(key, loaded.data(), loaded.size());
+      const int64_t end_us = NowUs();
+      if (config_.abr != nullptr &&
+          (!hinted || end_us - first_byte_us > duration_us)) {
+        config_.abr->OnDownload(
+            received, hinted ? end_us - first_byte_us : end_us - start_us);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (duration_us > 0) {
+        spans_.push_back({appended_ - received, appended_, duration_us});
+      }
+      return true;
+    }
+    if (stopping()) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.failed_requests;
+    error_ = "cannot load " + url + ": " + response.error;
+    // A retry would repeat bytes the reader already has.
+    if (received > 0) break;
+  }
+  Finish(error());
+  return false;
+}
+
+bool LlHlsLoader::LoadsWhole(const HlsSegment& segment) const {
+  return !low_latency_ || segment.parts.empty();
+}
+
+bool LlHlsLoader::LoadSegment(const HlsSegment& segment) {
+  if (config_.prefetch_segments <= 0) {
+    return Load(segment.uri, segment.byte_range, segment.duration_us, false);
+  }
+  if (prefetcher_ == nullptr) {
+    // What waits in the prefetcher stays within the reader's buffer limit.
+    PrefetchConfig prefetch = config_.prefetch;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      prefetch.memory_budget_bytes =
+          std::min(prefetch.memory_budget_bytes, max_buffered_bytes_);
+    }
+    prefetcher_ = std::make_unique<SegmentPrefetcher>(prefetch);
+  }
+  // The cursor passed what was queued, e.g. out of a live playlist's
+  // window.
+  if (!prefetched_.empty() && prefetched_.front() < segment.sequence) {
+    ClearPrefetch();
+  }
+  PrefetchAhead();
+  if (prefetched_.empty() || prefetched_.front() != segment.sequence) {
+    // Cached when it was considered.
+    return Load(segment.uri, segment.byte_range, segment.duration_us, false);
+  }
+  prefetched_.pop_front();
+  PrefetchedSegment fetched;
+  while (!prefetcher_->Take(100000, &fetched)) {
+    if (stopping()) return false;
+  }
+  const std::string url = ResolveHlsUrl(media_url_, segment.uri);
+  if (!fetched.ok) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.failed_requests;
+      error_ = "cannot load " + url + ": " + fetched.error;
+    }
+    Finish(error());
+    return false;
+  }
+  const int64_t size = static_cast<int64_t>(fetched.data.size());
+  if (playlist_.end_list && config_.cache != nullptr) {
+    config_.cache->Put(SegmentCacheKey(url, segment.byte_range.offset,
+                                       segment.byte_range.length),
+                       fetched.data.data(), fetched.data.size());
+  }
+  // Fetched alongside others, so this understates the throughput a little.
+  if (config_.abr != nullptr) config_.abr->OnDownload(size, fetched.fetch_us);
+  if (!Append(fetched.data.data(), fetched.data.size())) return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.prefetched_segments;
+  if (segment.duration_us > 0) {
+    spans_.push_back({appended_ - size, appended_, segment.duration_us});
+  }
+  return true;
+}
+
+void LlHlsLoader::PrefetchAhead() {
+  prefetch_next_ = std::max(prefetch_next_, cursor_.msn);
+  for (; prefetch_next_ <= cursor_.msn + config_.prefetch_segments;
+       ++prefetch_next_) {
+    const HlsSegment* segment = playlist_.Find(prefetch_next_);
+    // Not listed yet, or to be loaded part by part.
+    if (segment == nullptr || !LoadsWhole(*segment)) return;
+    if (segment->gap) continue;
+    const std::string url = ResolveHlsUrl(media_url_, segment->uri);
+    if (playlist_.end_list && config_.cache != nullptr &&
+        config_.cache->Touch(SegmentCacheKey(url, segment->byte_range.offset,
+                                             segment->byte_range.length))) {
+      continue;
+    }
+    SegmentRequest request;
+    request.sequence = segment->sequence;
+    request.url = url;
+    request.offset = segment->byte_range.offset;
+    request.length = segment->byte_range.length;
+    prefetcher_->Enqueue(request);
+    prefetched_.push_back(segment->sequence);
+  }
+}
+
+void LlHlsLoader::ClearPrefetch() {
+  if (prefetcher_) prefetcher_->Clear();
+  prefetched_.clear();
+  prefetch_next_ = -1;
+}
+
+bool LlHlsLoader::Append(const uint8_t* data, size_t size) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    writable_.wait(lock, [this] {
+      return stopping_ ||
+             buffer_.size() - read_offset_ < max_buffered_bytes_;
+    });
+    if (stopping_) return false;
+    buffer_.insert(buffer_.end(), data, data + size);
+    appended_ += size;
+    stats_.bytes += size;
+  }
+  readable_.notify_all();
+  return true;
+}
+
+void LlHlsLoader::Finish(const std::string& error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    error_ = error;
+  }
+  readable_.notify_all();
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,240 @@
+#ifndef IVS_BROADCASTER_LL_HLS_LOADER_H_
+#define IVS_BROADCASTER_LL_HLS_LOADER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "abr_controller.h"
+#include "hls_playlist.h"
+#include "segment_prefetcher.h"
+
+namespace ivs_broadcaster {
+
+class HttpClient;
+class SegmentCache;
+
+struct LlHlsConfig {
+  // Follows parts, preload hints and blocking reloads when the playlist
+  // offers them. Off, loads whole segments and polls the playlist like a
+  // client from before low-latency HLS.
+  bool low_latency = true;
+  // Highest variant bandwidth of a master playlist to play; 0 takes the
+  // highest listed.
+  int64_t max_bandwidth = 0;
+  // Chooses among the variants of a master playlist at every segment,
+  // instead of |max_bandwidth| once. Not owned.
+  AbrController* abr = nullptr;
+  // Loading pauses while this many bytes wait to be read.
+  size_t max_buffered_bytes = 16 << 20;
+  // Attempts per request before loading fails.
+  int max_attempts = 3;
+  // The segments of an ended playlist are read from it when there and
+  // written to it when loaded, so replaying a VOD loads nothing but its
+  // playlists. Not owned.
+  SegmentCache* cache = nullptr;
+  // Where loading of an ended playlist starts: the segment holding this
+  // media time.
+  int64_t start_us = 0;
+  // Segments loaded whole are fetched up to this many ahead of the one
+  // needed, several at a time; 0 loads each when it is needed.
+  int prefetch_segments = 3;
+  PrefetchConfig prefetch;
+};
+
+struct LlHlsStats {
+  uint64_t playlist_requests = 0;
+  // Reloads the server held until the next part or segment was out.
+  uint64_t blocking_reloads = 0;
+  uint64_t parts = 0;
+  // Parts requested from a preload hint, before any playlist listed them.
+  uint64_t hinted_parts = 0;
+  uint64_t segments = 0;
+  uint64_t bytes = 0;
+  uint64_t failed_requests = 0;
+  uint64_t variant_switches = 0;
+  // Segments and initialisation sections read from the cache, and their
+  // bytes, also counted in |bytes|.
+  uint64_t cache_hits = 0;
+  uint64_t cache_bytes = 0;
+  // Segments that came from the prefetcher, also counted in |segments|.
+  uint64_t prefetched_segments = 0;
+  // How far behind the live edge loading started, per the playlist.
+  int64_t start_offset_us = 0;
+};
+
+// Loads a live HLS stream as one byte stream for a demuxer.
+//
+// With a low-latency playlist, loading starts PART-HOLD-BACK from the live
+// edge at an independent part and goes on part by part. Once the listed
+// parts are loaded, the part named by the preload hint is requested before
+// any playlist lists it; the server answers when its first bytes exist, and
+// the bytes are handed to Read() as they arrive. The playlist is reloaded
+// with _HLS_msn and _HLS_part, so the server holds the reload until it has
+// something new instead of the client polling for it. Segments whose parts
+// have aged out of the playlist are loaded whole. Other playlists are
+// loaded segment by segment from HOLD-BACK.
+//
+// With an AbrController, the variant is chosen again at every segment
+// boundary and loading carries on at the same media sequence number in the
+// new variant's playlist, which assumes aligned variants.
+//
+// Segments loaded whole, i.e. all of them but those of a low-latency
+// playlist that still lists their parts, go through a SegmentPrefetcher
+// that fetches the next few at once, so round trips do not add up between
+// them. Such a segment reaches the reader once it is complete; parts and
+// preload hints are still handed over as their bytes arrive.
+//
+// Initialisation sections (EXT-X-MAP) are inserted into the stream when
+// they change. Encrypted segments are not supported.
+class LlHlsLoader {
+ public:
+  explicit LlHlsLoader(const LlHlsConfig& config);
+  // Interrupts loading and joins the thread.
+  ~LlHlsLoader();
+
+  LlHlsLoader(const LlHlsLoader&) = delete;
+  LlHlsLoader& operator=(const LlHlsLoader&) = delete;
+
+  // Loads the playlist at |url|, following a master playlist to one of its
+  // variants, and starts loading media on a thread.
+  bool Open(const std::string& url, std::string* error);
+
+  // Whether the playlist has parts. Valid after Open().
+  bool low_latency() const { return low_latency_; }
+  // Whether an AbrController chooses among several variants. Valid after
+  // Open().
+  bool adaptive() const { return variants_.size() > 1; }
+  // The media playlist's URL. Valid after Open().
+  const std::string& media_url() const { return media_url_; }
+  // Whether the playlist was live, not ended, at Open().
+  bool live() const { return live_; }
+  // The length of a VOD, or -1 for a live playlist. Valid after Open().
+  int64_t duration_us() const { return duration_us_; }
+
+  // Media time loaded but not read yet. Loading a live playlist keeps up
+  // with its edge, so this is how far the reader trails the edge.
+  int64_t BufferedUs() const;
+  // Memory the loaded bytes take, read or not, until the buffer compacts.
+  size_t BufferedBytes() const;
+  // Replaces |max_buffered_bytes| of the config, e.g. to the share of a
+  // memory budget. Called from any thread.
+  void SetMaxBufferedBytes(size_t bytes);
+
+  // Copies up to |size| loaded bytes into |buffer|, waiting until there
+  // are some. Returns 0 at the end of the stream and -1 after an error or
+  // Interrupt().
+  int64_t Read(uint8_t* buffer, size_t size);
+
+  // Makes a blocked or later Read() return -1. Called from any thread.
+  void Interrupt();
+
+  std::string error() const;
+  LlHlsStats stats() const;
+
+ private:
+  // The next thing to load.
+  struct Cursor {
+    int64_t msn = 0;
+    // Part within the segment; -1 loads the whole segment.
+    int64_t part = -1;
+  };
+
+  void Run();
+  // Loads the next part or segment, or reloads the playlist. Returns false
+  // once loading is over.
+  bool Step();
+  bool LoadPlaylist(const std::string& url, bool blocking);
+  // Places the cursor near the live edge.
+  void ChooseStart();
+  // Writes the initialisation section |map| into the stream unless it is
+  // the one already written.
+  bool LoadMap(const std::shared_ptr<const HlsMap>& map);
+  // Appends |url|, or the given range of it, to the stream as it arrives,
+  // or from the cache. The download is measured for the AbrController
+  // unless |hinted|: the server answers those as the media is made, so
+  // they say how fast the network is only when they take longer than the
+  // |duration_us| they hold.
+  bool Load(const std::string& uri, const HlsByteRange& range,
+            int64_t duration_us, bool hinted);
+  // Whether |segment| is loaded whole rather than part by part.
+  bool LoadsWhole(const HlsSegment& segment) const;
+  // Loads whole |segment|, the one at the cursor, from the prefetcher
+  // unless it is cached.
+  bool LoadSegment(const HlsSegment& segment);
+  // Queues the segments loaded whole from the cursor on, up to
+  // prefetch_segments past it, that are not queued or cached yet.
+  void PrefetchAhead();
+  // Drops what was prefetched, e.g. for another variant.
+  void ClearPrefetch();
+  // Picks the variant to start with and returns its URL.
+  std::string ChooseVariant(std::vector<HlsVariant> variants);
+  // Moves to the media playlist of variants_[index].
+  bool SwitchVariant(int index);
+  // Hands bytes to the reader, waiting while the buffer is full.
+  bool Append(const uint8_t* data, size_t size);
+  void Finish(const std::string& error);
+  bool stopping() const;
+
+  const LlHlsConfig config_;
+  std::unique_ptr<HttpClient> client_;
+  std::string media_url_;
+  bool low_latency_ = false;
+  bool live_ = false;
+  int64_t duration_us_ = -1;
+  // Variants of the master playlist, in the AbrController's ladder order;
+  // empty without an AbrController or with a single variant.
+  std::vector<HlsVariant> variants_;
+  int variant_ = 0;
+
+  // Only touched on the loading thread once it runs.
+  HlsMediaPlaylist playlist_;
+  int64_t playlist_loaded_us_ = 0;
+  bool playlist_changed_ = true;
+  Cursor cursor_;
+  // The last hinted resource loaded, so a playlist that still names it
+  // does not get it loaded twice.
+  std::string hint_loaded_;
+  std::string map_written_;
+  // The segment the variant was last chosen for.
+  int64_t decided_msn_ = -1;
+  // Created when a segment is first loaded whole.
+  std::unique_ptr<SegmentPrefetcher> prefetcher_;
+  // Sequence numbers of the segments queued in prefetcher_, in order, and
+  // the next one to consider queueing.
+  std::deque<int64_t> prefetched_;
+  int64_t prefetch_next_ = -1;
+
+  mutable std::mutex mutex_;
+  std::condition_variable readable_;
+  std::condition_variable writable_;
+  std::vector<uint8_t> buffer_;
+  size_t read_offset_ = 0;
+  // Starts as config_.max_buffered_bytes.
+  size_t max_buffered_bytes_;
+  // Media time of the loaded stream by byte position, for BufferedUs().
+  struct Span {
+    int64_t start = 0;
+    int64_t end = 0;
+    int64_t duration_us = 0;
+  };
+  std::deque<Span> spans_;
+  int64_t appended_ = 0;
+  int64_t consumed_ = 0;
+  bool stopping_ = false;
+  bool finished_ = false;
+  std::string error_;
+  LlHlsStats stats_;
+
+  std::thread thread_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_LL_HLS_LOADER_H_
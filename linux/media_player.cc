@@ -0,0 +1,570 @@
+#include "media_player.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#include "gop_cache.h"
+#include "memory_budget.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// How often the playback rate follows the latency, and how often the
+// player reports to the memory budget.
+constexpr int64_t kRateIntervalUs = 100000;
+constexpr int64_t kMemoryIntervalUs = 100000;
+// The read-ahead a small allowance still leaves a source.
+constexpr size_t kMinReadAheadBytes = 1 << 20;
+// Audio further than this from where the last ended starts the stretcher
+// afresh.
+constexpr int64_t kMaxAudioGapUs = 100000;
+
+// Whether |to| decodes frames that |from| skipped.
+bool DecodesMore(DecodeMode to, DecodeMode from) {
+  return static_cast<int>(to) < static_cast<int>(from);
+}
+
+}  // namespace
+
+const char* DecodeModeName(DecodeMode mode) {
+  switch (mode) {
+    case DecodeMode::kFull:
+      return "full";
+    case DecodeMode::kKeyframes:
+      return "keyframes";
+    case DecodeMode::kNetworkOnly:
+      return "networkOnly";
+  }
+  return "unknown";
+}
+
+MediaPlayer::MediaPlayer(std::string url, MediaSourceFactory source_factory,
+                         Config config, Listener* listener)
+    : url_(std::move(url)),
+      source_factory_(std::move(source_factory)),
+      config_(config),
+      listener_(listener),
+      own_frame_pool_(config.frame_pool ? nullptr
+                                        : std::make_unique<FramePool>()),
+      frame_pool_(config.frame_pool ? config.frame_pool
+                                    : own_frame_pool_.get()),
+      abr_(config.abr, config.abr_policy
+                           ? config.abr_policy()
+                           : std::make_unique<BolaAbrPolicy>()),
+      mode_(config.mode),
+      target_latency_us_(config.catch_up.target_latency_us),
+      position_interval_us_(config.position_interval_us),
+      catch_up_(config.catch_up) {
+  abr_.SetCallback([this](const AbrDecision& decision) {
+    listener_->OnAbrDecision(this, decision);
+  });
+  if (config_.memory_budget != nullptr) {
+    config_.memory_budget->Register(url_, [this] { return Shed(); });
+  }
+  thread_ = std::thread(&MediaPlayer::Run, this);
+}
+
+MediaPlayer::~MediaPlayer() {
+  // Waits out an eviction running on another player's thread.
+  if (config_.memory_budget != nullptr) {
+    config_.memory_budget->Unregister(url_);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    if (source_) source_->Interrupt();
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void MediaPlayer::SetMode(DecodeMode mode) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_ == mode) return;
+    mode_ = mode;
+    mode_changed_us_ = NowUs();
+  }
+  // Wakes a player waiting for its next packet to be due.
+  cv_.notify_all();
+}
+
+void MediaPlayer::Pause() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  paused_ = true;
+}
+
+void MediaPlayer::Resume() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!paused_) return;
+    paused_ = false;
+    reanchor_ = true;
+  }
+  cv_.notify_all();
+}
+
+void MediaPlayer::SetAudible(bool audible) { audible_ = audible; }
+
+void MediaPlayer::Seek(int64_t position_us) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    seek_to_us_ = position_us;
+    // Stops waiting for the packet before it.
+    reanchor_ = true;
+  }
+  cv_.notify_all();
+}
+
+void MediaPlayer::SetTargetLatency(int64_t target_us) {
+  target_latency_us_ = target_us;
+}
+
+void MediaPlayer::SetPositionInterval(int64_t interval_us) {
+  position_interval_us_ = interval_us;
+}
+
+MediaPlayerStats MediaPlayer::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+bool MediaPlayer::stopping() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_;
+}
+
+void MediaPlayer::SetState(PlayerState state) {
+  if (state_.exchange(state) != state) {
+    listener_->OnStateChanged(this, state);
+  }
+}
+
+void MediaPlayer::Run() {
+  SetState(PlayerState::kBuffering);
+  MediaSource* source = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) return;
+    source_ = source_factory_();
+    source = source_.get();
+  }
+  source->SetAbrController(&abr_);
+  std::string error;
+  if (!source->Open(url_, &error) ||
+      !(decoder_ = source->CreateDecoder(&error))) {
+    if (stopping()) return;
+    listener_->OnError(this, error);
+    SetState(PlayerState::kIdle);
+    return;
+  }
+  audio_decoder_ = source->CreateAudioDecoder();
+  const int64_t duration_us = source->DurationUs();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.duration_us = duration_us;
+  }
+  if (duration_us > 0) listener_->OnDuration(this, duration_us);
+  // Starting in a mode is not a switch to it.
+  decoding_ = mode_;
+  decoder_->SetKeyframesOnly(decoding_ == DecodeMode::kKeyframes);
+  SetState(PlayerState::kReady);
+
+  MediaPacket packet;
+  while (true) {
+    int64_t seek_us = kNoTime;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (paused_ && !stopping_) {
+        lock.unlock();
+        SetState(PlayerState::kIdle);
+        lock.lock();
+        cv_.wait(lock, [this] { return stopping_ || !paused_; });
+      }
+      if (stopping_) return;
+      seek_us = std::exchange(seek_to_us_, kNoTime);
+    }
+    if (seek_us != kNoTime) ApplySeek(source, seek_us);
+    if (trim_decoded_.exchange(false)) TrimDecoded();
+    ReportMemory(source);
+    const ReadResult result = source->Read(&packet, &error);
+    if (result != ReadResult::kPacket) {
+      if (stopping()) return;
+      if (result == ReadResult::kError) listener_->OnError(this, error);
+      SetState(result == ReadResult::kEnd ? PlayerState::kEnded
+                                          : PlayerState::kIdle);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.packets;
+      stats_.bytes += packet.data.size();
+    }
+    // Timestamps jump back at a seek or a discontinuity.
+    if (read_us_ == kNoTime || packet.pts_us > read_us_ ||
+        read_us_ - packet.pts_us > config_.max_lateness_us) {
+      read_us_ = packet.pts_us;
+    }
+    CollectCues(source);
+    // Packets before a seek's target are not shown, so not waited for.
+    const bool held_back = packet.pts_us < seek_target_us_;
+    if (config_.paced && !held_back) {
+      UpdateRate();
+      if (!WaitUntilDue(packet)) return;
+    }
+    SetState(PlayerState::kPlaying);
+    if (!packet.video) {
+      HandleAudio(packet);
+      continue;
+    }
+    if (!held_back) ReportCues(packet.pts_us);
+    HandleVideo(packet);
+    if (config_.gop_cache != nullptr) {
+      // Handed over without copying; the next Read() refills |packet|.
+      config_.gop_cache->Append(
+          url_, std::make_shared<MediaPacket>(std::move(packet)));
+    }
+  }
+}
+
+bool MediaPlayer::WaitUntilDue(const MediaPacket& packet) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const int64_t now_us = NowUs();
+  const int64_t due_us = DueUs(packet.pts_us);
+  // After a pause, a stall or a timestamp jump, restart the clock at this
+  // packet rather than rushing through or sleeping over the gap.
+  if (reanchor_ || now_us - due_us > config_.max_lateness_us ||
+      due_us - now_us > config_.max_lateness_us) {
+    reanchor_ = false;
+    anchor_pts_us_ = packet.pts_us;
+    anchor_wall_us_ = now_us;
+    return !stopping_;
+  }
+  const auto due = std::chrono::steady_clock::now() +
+                   std::chrono::microseconds(due_us - now_us);
+  while (cv_.wait_until(lock, due, [this] {
+    return stopping_ || reanchor_ || mode_ != decoding_;
+  })) {
+    if (stopping_ || reanchor_) break;
+    // A promotion should not wait for this packet's turn.
+    lock.unlock();
+    ApplyMode(packet);
+    lock.lock();
+  }
+  return !stopping_;
+}
+
+int64_t MediaPlayer::DueUs(int64_t pts_us) const {
+  return anchor_wall_us_ +
+         std::llround((pts_us - anchor_pts_us_) / rate_);
+}
+
+void MediaPlayer::UpdateRate() {
+  const int64_t now_us = NowUs();
+  const int64_t elapsed_us = now_us - rate_updated_us_;
+  if (rate_updated_us_ != 0 && elapsed_us < kRateIntervalUs) return;
+  rate_updated_us_ = now_us;
+  const int64_t latency_us = source_->LiveLatencyUs();
+  int64_t target_us = target_latency_us_;
+  if (target_us == 0) target_us = source_->TargetLatencyUs();
+  double rate = 1;
+  if (latency_us < 0 || target_us <= 0) {
+    catch_up_.Reset();
+  } else {
+    rate = catch_up_.Update(latency_us, target_us, now_us);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rate_ != 1) stats_.catch_up_us += elapsed_us;
+    if (rate != rate_ && !reanchor_) {
+      // Restarts the clock where it has got to, so that frames already due
+      // stay due and the picture does not jump.
+      anchor_pts_us_ += std::llround((now_us - anchor_wall_us_) * rate_);
+      anchor_wall_us_ = now_us;
+    }
+    rate_ = rate;
+    stats_.playback_rate = rate;
+    stats_.live_latency_us = latency_us;
+  }
+  if (std::abs(rate - reported_rate_) >= 0.01 ||
+      (rate == 1 && reported_rate_ != 1)) {
+    reported_rate_ = rate;
+    listener_->OnPlaybackRateChanged(this, rate, latency_us);
+  }
+}
+
+void MediaPlayer::ReportMemory(MediaSource* source) {
+  MemoryBudget* budget = config_.memory_budget;
+  if (budget == nullptr) return;
+  const int64_t now_us = NowUs();
+  if (memory_reported_us_ != 0 &&
+      now_us - memory_reported_us_ < kMemoryIntervalUs) {
+    return;
+  }
+  memory_reported_us_ = now_us;
+  source->SetMaxBufferedBytes(
+      std::max(budget->Allowance(url_) / 2, kMinReadAheadBytes));
+  size_t demuxed = source->BufferedBytes();
+  if (config_.gop_cache != nullptr) demuxed += config_.gop_cache->bytes(url_);
+  size_t decoded = decoder_->BufferedBytes() +
+                   (decoded_audio_.samples.capacity() +
+                    stretched_audio_.samples.capacity()) *
+                       sizeof(float);
+  if (frame_) decoded += frame_->data.capacity();
+  budget->Update(url_, demuxed, decoded);
+}
+
+size_t MediaPlayer::Shed() {
+  size_t freed = 0;
+  if (config_.gop_cache != nullptr) freed = config_.gop_cache->Drop(url_);
+  // The stream being watched keeps its pictures; the others show a still
+  // until their next keyframe.
+  if (mode_ != DecodeMode::kFull) trim_decoded_ = true;
+  return freed;
+}
+
+void MediaPlayer::TrimDecoded() {
+  if (decoding_ == DecodeMode::kFull) return;
+  frame_.reset();
+  decoder_->Flush();
+  need_keyframe_ = true;
+  stretcher_.reset();
+  decoded_audio_.samples = std::vector<float>();
+  stretched_audio_.samples = std::vector<float>();
+}
+
+void MediaPlayer::ApplyMode(const MediaPacket& next) {
+  const DecodeMode mode = mode_;
+  if (mode == decoding_) return;
+  const bool promoted = DecodesMore(mode, decoding_);
+  if (promoted) {
+    decoder_->Flush();
+    need_keyframe_ = true;
+  }
+  decoder_->SetKeyframesOnly(mode == DecodeMode::kKeyframes);
+  decoding_ = mode;
+  if (!promoted || mode != DecodeMode::kFull) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch_start_us_ = mode_changed_us_;
+    ++stats_.switches;
+  }
+  switching_ = true;
+  // A keyframe up next is as good a start as the cache, and cheaper.
+  if (!(next.video && next.keyframe)) CatchUp();
+}
+
+void MediaPlayer::CatchUp() {
+  if (config_.gop_cache == nullptr) return;
+  // Ends with the packet before the one about to be handled, so decoding
+  // carries on from there without a gap.
+  const std::vector<SharedPacket> gop = config_.gop_cache->Get(url_);
+  if (gop.empty()) return;
+  const int64_t start_us = NowUs();
+  bool produced = false;
+  for (const SharedPacket& packet : gop) {
+    if (stopping()) return;
+    produced = decoder_->Decode(*packet, NextFrame()) || produced;
+  }
+  need_keyframe_ = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.decoded += gop.size();
+    ++stats_.decoded_keyframes;
+    stats_.catch_up_decoded += gop.size();
+    ++stats_.cached_switches;
+    if (produced) ++stats_.frames;
+    stats_.decode_us += NowUs() - start_us;
+  }
+  if (produced) ShowFrame();
+}
+
+void MediaPlayer::HandleVideo(const MediaPacket& packet) {
+  ApplyMode(packet);
+  const DecodeMode mode = decoding_;
+  if (mode == DecodeMode::kFull && !need_keyframe_ && !packet.keyframe &&
+      packet.pts_us >= seek_target_us_ && FallenBehind(packet)) {
+    // Frames decoded this late could only be shown late, and nothing from
+    // the next keyframe on refers to them.
+    decoder_->Flush();
+    need_keyframe_ = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.keyframe_skips;
+  }
+  if (mode == DecodeMode::kNetworkOnly ||
+      ((mode == DecodeMode::kKeyframes || need_keyframe_) &&
+       !packet.keyframe)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.skipped;
+    return;
+  }
+  need_keyframe_ = false;
+  const int64_t start_us = NowUs();
+  const bool produced = decoder_->Decode(packet, NextFrame());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.decoded;
+    if (packet.keyframe) ++stats_.decoded_keyframes;
+    if (produced) ++stats_.frames;
+    stats_.decode_us += NowUs() - start_us;
+  }
+  // Frames before a seek's target only lead up to it.
+  if (produced && frame_->pts_us >= seek_target_us_) {
+    seek_target_us_ = kNoTime;
+    ShowFrame();
+  }
+}
+
+bool MediaPlayer::FallenBehind(const MediaPacket& packet) const {
+  if (!config_.paced || config_.max_decode_lag_us <= 0) return false;
+  // The anchor and the rate only change on this thread.
+  return NowUs() - DueUs(packet.pts_us) > config_.max_decode_lag_us;
+}
+
+void MediaPlayer::HandleAudio(const MediaPacket& packet) {
+  if (audio_decoder_ == nullptr || packet.pts_us < seek_target_us_) return;
+  // Only the stream being watched, or chosen among those shown, is heard.
+  if (decoding_ != DecodeMode::kFull || !audible_) {
+    stretcher_.reset();
+    return;
+  }
+  if (!audio_decoder_->Decode(packet, &decoded_audio_)) return;
+  const AudioBuffer& input = decoded_audio_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.audio_decoded;
+  }
+  if (input.frames() == 0 || input.sample_rate <= 0) return;
+  if (stretcher_ != nullptr) {
+    const int64_t expected_us =
+        stretch_start_us_ +
+        stretch_input_frames_ * 1000000 / stretcher_->sample_rate();
+    // A new format, a gap or a jump back starts over rather than splicing.
+    if (stretcher_->sample_rate() != input.sample_rate ||
+        stretcher_->channels() != input.channels ||
+        std::llabs(input.pts_us - expected_us) > kMaxAudioGapUs) {
+      stretcher_.reset();
+    }
+  }
+  if (stretcher_ == nullptr) {
+    stretcher_ =
+        std::make_unique<WsolaStretcher>(input.sample_rate, input.channels);
+    stretch_start_us_ = input.pts_us;
+    stretch_input_frames_ = 0;
+  }
+  stretcher_->SetRate(rate_);
+  stretched_audio_.samples.clear();
+  const int64_t first = stretcher_->Process(
+      input.samples.data(), input.frames(), &stretched_audio_.samples);
+  stretch_input_frames_ += input.frames();
+  if (first < 0) return;
+  stretched_audio_.sample_rate = input.sample_rate;
+  stretched_audio_.channels = stretcher_->channels();
+  stretched_audio_.pts_us =
+      stretch_start_us_ + first * 1000000 / input.sample_rate;
+  listener_->OnAudio(this, stretched_audio_);
+}
+
+void MediaPlayer::ApplySeek(MediaSource* source, int64_t position_us) {
+  if (!source->Seek(position_us)) return;
+  decoder_->Flush();
+  need_keyframe_ = true;
+  stretcher_.reset();
+  seek_target_us_ = position_us;
+  read_us_ = kNoTime;
+  cues_until_us_ = position_us;
+  cues_from_us_ = position_us;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.seeks;
+    reanchor_ = true;
+  }
+  // Reported even when there are none, so that stale cues can be cleared.
+  listener_->OnCues(this, cues_.ActiveAt(position_us), true);
+}
+
+void MediaPlayer::CollectCues(MediaSource* source) {
+  source->TakeCues(&new_cues_);
+  if (new_cues_.empty()) return;
+  std::vector<MetadataCue> late;
+  for (const MetadataCue& cue : new_cues_) {
+    // Cues seen before were reported then, or at the seek that returned
+    // to them.
+    if (cues_.Add(cue) && cues_until_us_ != kNoTime &&
+        cue.start_us <= cues_until_us_ && cue.end_us >= cues_from_us_) {
+      late.push_back(cue);
+    }
+  }
+  new_cues_.clear();
+  if (!late.empty()) listener_->OnCues(this, late, false);
+}
+
+void MediaPlayer::ReportCues(int64_t pts_us) {
+  // Timestamps that jumped back, e.g. at a discontinuity, start over.
+  if (cues_until_us_ == kNoTime ||
+      cues_until_us_ - pts_us > config_.max_lateness_us) {
+    cues_until_us_ = pts_us - 1;
+  }
+  // Packets come in decoding order, a little out of timestamp order.
+  if (pts_us <= cues_until_us_) return;
+  const std::vector<MetadataCue> reached =
+      cues_.Starting(cues_until_us_, pts_us);
+  cues_until_us_ = pts_us;
+  if (!reached.empty()) listener_->OnCues(this, reached, false);
+}
+
+VideoFrame* MediaPlayer::NextFrame() {
+  if (!frame_) frame_ = frame_pool_->Acquire();
+  return frame_.get();
+}
+
+void MediaPlayer::ShowFrame() {
+  // Listeners may keep the frame, so the next decode takes another.
+  const FramePtr frame = std::move(frame_);
+  listener_->OnFrame(this, frame);
+  ReportPosition(frame->pts_us);
+  if (!switching_ || decoding_ != DecodeMode::kFull) return;
+  switching_ = false;
+  int64_t latency_us = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latency_us = NowUs() - switch_start_us_;
+    stats_.last_switch_us = latency_us;
+  }
+  listener_->OnSwitched(this, latency_us);
+}
+
+void MediaPlayer::ReportPosition(int64_t pts_us) {
+  const int64_t buffered_us =
+      std::max<int64_t>(read_us_ == kNoTime ? 0 : read_us_ - pts_us, 0) +
+      source_->BufferedUs();
+  int64_t live_latency_us = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.position_us = pts_us;
+    stats_.buffered_us = buffered_us;
+    live_latency_us = stats_.live_latency_us;
+  }
+  const int64_t interval_us = position_interval_us_;
+  if (interval_us <= 0) return;
+  const int64_t now_us = NowUs();
+  // A frame a little early should not skip a whole interval.
+  if (position_reported_us_ != 0 &&
+      now_us - position_reported_us_ < interval_us - interval_us / 10) {
+    return;
+  }
+  position_reported_us_ = now_us;
+  listener_->OnPosition(this, pts_us, buffered_us, live_latency_us);
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,420 @@
+#ifndef IVS_BROADCASTER_MEDIA_PLAYER_H_
+#define IVS_BROADCASTER_MEDIA_PLAYER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "abr_controller.h"
+#include "cue_index.h"
+#include "frame_pool.h"
+#include "live_catch_up.h"
+#include "video_frame.h"
+#include "wsola.h"
+
+namespace ivs_broadcaster {
+
+class GopCache;
+class MemoryBudget;
+
+// One demuxed access unit.
+struct MediaPacket {
+  bool video = false;
+  bool keyframe = false;
+  int64_t pts_us = 0;
+  std::vector<uint8_t> data;
+};
+
+// Decodes the video stream of one source. Used from the player's thread
+// only.
+class VideoDecoder {
+ public:
+  virtual ~VideoDecoder() = default;
+
+  // Decodes |packet| and returns true when that produced |frame|. A
+  // decoder may hand out frames later than the packets they came from.
+  virtual bool Decode(const MediaPacket& packet, VideoFrame* frame) = 0;
+  // Drops reference frames and anything buffered, e.g. before decoding
+  // resumes at a keyframe.
+  virtual void Flush() = 0;
+  // Lets the decoder skip all but keyframes without reconstructing them.
+  virtual void SetKeyframesOnly(bool keyframes_only) = 0;
+  // An estimate of the memory the pictures the decoder holds take, or 0 if
+  // it cannot tell. Flush() frees them.
+  virtual size_t BufferedBytes() const { return 0; }
+};
+
+// Decoded audio, interleaved.
+struct AudioBuffer {
+  int sample_rate = 0;
+  int channels = 0;
+  // The stream time of the first sample.
+  int64_t pts_us = 0;
+  std::vector<float> samples;
+
+  int frames() const {
+    return channels > 0 ? static_cast<int>(samples.size()) / channels : 0;
+  }
+};
+
+// Decodes the audio stream of one source. Used from the player's thread
+// only.
+class AudioDecoder {
+ public:
+  virtual ~AudioDecoder() = default;
+
+  // Decodes |packet| into |buffer|, replacing what it held, and returns
+  // true when that produced samples.
+  virtual bool Decode(const MediaPacket& packet, AudioBuffer* buffer) = 0;
+};
+
+enum class ReadResult { kPacket, kEnd, kError };
+
+// Demuxes a stream, e.g. an HLS playlist over HTTP.
+class MediaSource {
+ public:
+  virtual ~MediaSource() = default;
+
+  // Lets the source choose among the renditions of |url| with |abr|, which
+  // outlives it. Called before Open(); sources with a single rendition
+  // ignore it.
+  virtual void SetAbrController(AbrController* abr) {}
+  virtual bool Open(const std::string& url, std::string* error) = 0;
+  // Blocks until the next packet is available.
+  virtual ReadResult Read(MediaPacket* packet, std::string* error) = 0;
+  // A decoder for the video stream; called after Open().
+  virtual std::unique_ptr<VideoDecoder> CreateDecoder(std::string* error) = 0;
+  // A decoder for the audio stream, or null when the source has none or
+  // drops it; called after Open().
+  virtual std::unique_ptr<AudioDecoder> CreateAudioDecoder() { return nullptr; }
+  // How far the packet last read trails the live edge, or -1 when the
+  // source cannot tell, e.g. for a VOD. Called on the player's thread.
+  virtual int64_t LiveLatencyUs() { return -1; }
+  // The latency the stream is meant to be played at, e.g. the HLS
+  // hold-back playback started from, or 0 if it names none.
+  virtual int64_t TargetLatencyUs() { return 0; }
+  // The length of the stream, or -1 when it is live or the source cannot
+  // tell. Called after Open().
+  virtual int64_t DurationUs() { return -1; }
+  // Media time loaded ahead of Read(), or 0 for sources without a
+  // read-ahead of their own. Called on the player's thread.
+  virtual int64_t BufferedUs() { return 0; }
+  // Moves to the keyframe at or before |position_us| of stream time, so
+  // that the next Read() returns it. Returns false if the stream cannot
+  // seek, e.g. a live one.
+  virtual bool Seek(int64_t position_us) { return false; }
+  // Appends the timed-metadata cues found since the last call to |cues|.
+  // Called on the player's thread after every Read().
+  virtual void TakeCues(std::vector<MetadataCue>* cues) {}
+  // Memory taken by media loaded ahead of Read(), and a limit for it, e.g.
+  // the player's share of a memory budget. Called on the player's thread
+  // after Open(); sources without a read-ahead of their own ignore them.
+  virtual size_t BufferedBytes() { return 0; }
+  virtual void SetMaxBufferedBytes(size_t bytes) {}
+  // Makes a blocked or later Open() or Read() return. Called from another
+  // thread.
+  virtual void Interrupt() = 0;
+};
+
+using MediaSourceFactory = std::function<std::unique_ptr<MediaSource>()>;
+
+// How much of its stream a player decodes.
+enum class DecodeMode {
+  // Every frame, presented in real time.
+  kFull,
+  // Keyframes only, e.g. to keep a recent still of a background stream.
+  kKeyframes,
+  // Nothing: packets are downloaded and dropped, keeping the connection and
+  // playlist position warm.
+  kNetworkOnly,
+};
+
+const char* DecodeModeName(DecodeMode mode);
+
+// Matches PlayerState in lib/helpers/enums.dart.
+enum class PlayerState { kIdle, kReady, kBuffering, kPlaying, kEnded };
+
+struct MediaPlayerStats {
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  // Video packets handed to the decoder, and those of them keyframes.
+  uint64_t decoded = 0;
+  uint64_t decoded_keyframes = 0;
+  // Video packets not decoded because of the mode, or while waiting for a
+  // keyframe to start decoding from.
+  uint64_t skipped = 0;
+  uint64_t frames = 0;
+  int64_t decode_us = 0;
+  // Promotions to full decoding, those that started from the GOP cache
+  // rather than the next keyframe, and how long the last one took from
+  // SetMode() to its first frame.
+  uint64_t switches = 0;
+  uint64_t cached_switches = 0;
+  int64_t last_switch_us = 0;
+  // Cached packets decoded to catch up with the stream.
+  uint64_t catch_up_decoded = 0;
+  // Times decoding fell max_decode_lag_us behind and skipped the rest of
+  // the GOP; the packets skipped count in |skipped|.
+  uint64_t keyframe_skips = 0;
+  uint64_t audio_decoded = 0;
+  // The rate the stream plays at to reach its target latency, the latency
+  // last reported by the source (-1 if unknown), and the time played at a
+  // rate other than 1x.
+  double playback_rate = 1;
+  int64_t live_latency_us = -1;
+  int64_t catch_up_us = 0;
+  uint64_t seeks = 0;
+  // The stream time of the frame on screen (-1 before the first), the
+  // media read ahead of it, and the stream's length (-1 if live or
+  // unknown).
+  int64_t position_us = -1;
+  int64_t buffered_us = 0;
+  int64_t duration_us = -1;
+};
+
+// Plays one stream on its own thread.
+//
+// The thread reads packets at the pace of their timestamps, so a VOD is not
+// downloaded as fast as the network allows, and handles video according to
+// the decode mode. Audio the source decodes is stretched to the playback
+// rate and handed to the listener. Timed-metadata cues are kept in an
+// index and handed out as playback reaches them.
+class MediaPlayer {
+ public:
+  // Called on the player's thread.
+  class Listener {
+   public:
+    virtual ~Listener() = default;
+    virtual void OnStateChanged(MediaPlayer* player, PlayerState state) = 0;
+    virtual void OnError(MediaPlayer* player, const std::string& message) = 0;
+    // |frame| may be kept; it goes back to the frame pool once released.
+    virtual void OnFrame(MediaPlayer* player, const FramePtr& frame) = 0;
+    // The first frame after a promotion to full decoding was shown
+    // |latency_us| after SetMode().
+    virtual void OnSwitched(MediaPlayer* player, int64_t latency_us) = 0;
+    // The source chose the rendition of its next segment. Called on the
+    // source's loading thread.
+    virtual void OnAbrDecision(MediaPlayer* player,
+                               const AbrDecision& decision) = 0;
+    // Audio of the stream in full decoding, at the playback rate, to play
+    // now. Its |pts_us| is on the clock frames are shown by, trailing the
+    // newest packet by the time stretcher's window (some 40 ms).
+    virtual void OnAudio(MediaPlayer* player, const AudioBuffer& buffer) = 0;
+    // Playback sped up or slowed down to steer the latency behind the live
+    // edge to its target, or went back to 1x.
+    virtual void OnPlaybackRateChanged(MediaPlayer* player, double rate,
+                                       int64_t latency_us) = 0;
+    // Playback reached |cues|, in order, or, with |seek|, they are the cues
+    // active where a seek landed, including those from before it.
+    virtual void OnCues(MediaPlayer* player,
+                        const std::vector<MetadataCue>& cues, bool seek) = 0;
+    // The frame at |position_us| was shown, with |buffered_us| of media
+    // read ahead of it and |live_latency_us| behind the live edge (-1 if
+    // unknown). Sent at most every position interval, so never while
+    // paused.
+    virtual void OnPosition(MediaPlayer* player, int64_t position_us,
+                            int64_t buffered_us, int64_t live_latency_us) = 0;
+    // The source is open and knows the stream's length; not sent for live
+    // streams.
+    virtual void OnDuration(MediaPlayer* player, int64_t duration_us) = 0;
+  };
+
+  struct Config {
+    DecodeMode mode = DecodeMode::kFull;
+    // Reads in real time. Off in tests that feed canned packets.
+    bool paced = true;
+    // A packet this late restarts the clock instead of being rushed.
+    int64_t max_lateness_us = 1000000;
+    // In full decoding, a packet this late means decoding cannot keep up;
+    // the rest of its GOP is skipped and decoding resumes on time at the
+    // next keyframe. 0 rushes through instead.
+    int64_t max_decode_lag_us = 500000;
+    // Decoded frames are drawn from it; null uses one of the player's own.
+    FramePool* frame_pool = nullptr;
+    // Steers a live stream back to its target latency by playing at up to
+    // 1.1x or down to 0.9x. Video follows the rate through the clock;
+    // audio is time-stretched, keeping its pitch, so the two stay in sync
+    // and nothing is skipped.
+    CatchUpConfig catch_up;
+    // Receives every video packet, keyed by url. On promotion to full
+    // decoding the player decodes the cached GOP as fast as it can and
+    // shows its last frame, instead of waiting for the next keyframe.
+    GopCache* gop_cache = nullptr;
+    AbrConfig abr;
+    // Makes the rendition policy; null uses BolaAbrPolicy.
+    AbrPolicyFactory abr_policy;
+    // The player reports what it holds under its url, keeps its read-ahead
+    // within half its allowance and, when asked to evict, drops its cached
+    // GOP and, unless in full decoding, its decoded pictures and audio.
+    MemoryBudget* memory_budget = nullptr;
+    // Reports the position on shown frames at most this often; 0 never.
+    int64_t position_interval_us = 0;
+  };
+
+  MediaPlayer(std::string url, MediaSourceFactory source_factory,
+              Config config, Listener* listener);
+  // Interrupts the source and joins the thread.
+  ~MediaPlayer();
+
+  MediaPlayer(const MediaPlayer&) = delete;
+  MediaPlayer& operator=(const MediaPlayer&) = delete;
+
+  const std::string& url() const { return url_; }
+  // Chooses the rendition of every segment, and takes a rendition pinned by
+  // the user.
+  AbrController* abr() { return &abr_; }
+
+  // Takes effect from the next packet, or at once while waiting for one to
+  // be due. Moving to a mode that decodes more starts from the cached GOP
+  // if there is one and otherwise waits for the next keyframe, since the
+  // decoder lacks the references for anything before it.
+  void SetMode(DecodeMode mode);
+  DecodeMode mode() const { return mode_; }
+
+  void Pause();
+  void Resume();
+
+  // Whether audio is decoded and handed to the listener in full decoding;
+  // on by default. Players shown together decode every frame, but only the
+  // one listened to needs its audio.
+  void SetAudible(bool audible);
+
+  // Moves playback to |position_us| of stream time. Frames from the
+  // keyframe before it are decoded but not shown, and the cues active
+  // there are reported. Does nothing when the source cannot seek; a paused
+  // player seeks once resumed.
+  void Seek(int64_t position_us);
+
+  // Every cue seen so far.
+  const CueIndex& cues() const { return cues_; }
+
+  // Replaces catch_up.target_latency_us; takes effect within 100 ms.
+  void SetTargetLatency(int64_t target_us);
+  // Replaces position_interval_us from the next frame shown.
+  void SetPositionInterval(int64_t interval_us);
+
+  PlayerState state() const { return state_; }
+  MediaPlayerStats stats() const;
+
+ private:
+  // No seek pending, no cue reported yet, or no frame held back.
+  static constexpr int64_t kNoTime = std::numeric_limits<int64_t>::min();
+
+  void Run();
+  // Waits until |packet| is due. Returns false when stopping.
+  bool WaitUntilDue(const MediaPacket& packet);
+  // When |pts_us| is due on the steady clock, at the playback rate.
+  int64_t DueUs(int64_t pts_us) const;
+  // Moves the playback rate towards the target latency.
+  void UpdateRate();
+  // Tells the memory budget what the player holds and sizes the source's
+  // read-ahead to the allowance.
+  void ReportMemory(MediaSource* source);
+  // The budget's evictor; called from any thread.
+  size_t Shed();
+  // Frees decoded pictures and audio after Shed(), unless in full
+  // decoding.
+  void TrimDecoded();
+  // Follows a mode change made by SetMode() before handling |next|.
+  void ApplyMode(const MediaPacket& next);
+  // Decodes the cached GOP unpaced and shows its last frame.
+  void CatchUp();
+  void HandleVideo(const MediaPacket& packet);
+  // Decodes and stretches audio of the stream in full decoding.
+  void HandleAudio(const MediaPacket& packet);
+  void ApplySeek(MediaSource* source, int64_t position_us);
+  // Indexes the cues the source found, reporting late ones at once.
+  void CollectCues(MediaSource* source);
+  // Reports the cues playback reached by |pts_us|.
+  void ReportCues(int64_t pts_us);
+  // Whether |packet| is more than max_decode_lag_us behind the clock.
+  bool FallenBehind(const MediaPacket& packet) const;
+  // The frame the next decode writes into.
+  VideoFrame* NextFrame();
+  void ShowFrame();
+  // Records the position of the frame just shown and reports it when the
+  // position interval has passed.
+  void ReportPosition(int64_t pts_us);
+  void SetState(PlayerState state);
+  bool stopping() const;
+
+  const std::string url_;
+  const MediaSourceFactory source_factory_;
+  const Config config_;
+  Listener* const listener_;
+  const std::unique_ptr<FramePool> own_frame_pool_;
+  FramePool* const frame_pool_;
+  AbrController abr_;
+
+  std::atomic<DecodeMode> mode_;
+  std::atomic<PlayerState> state_{PlayerState::kIdle};
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+  bool paused_ = false;
+  // Set when the clock must restart at the next packet.
+  bool reanchor_ = true;
+  std::atomic<int64_t> target_latency_us_;
+  std::atomic<int64_t> position_interval_us_;
+  std::atomic<bool> audible_{true};
+  // Set by Shed() for the player's thread.
+  std::atomic<bool> trim_decoded_{false};
+  // Requested by Seek().
+  int64_t seek_to_us_ = kNoTime;
+  // When SetMode() last changed the mode.
+  int64_t mode_changed_us_ = 0;
+  std::unique_ptr<MediaSource> source_;
+  MediaPlayerStats stats_;
+
+  // Only touched on the player's thread.
+  std::unique_ptr<VideoDecoder> decoder_;
+  DecodeMode decoding_ = DecodeMode::kNetworkOnly;
+  bool need_keyframe_ = true;
+  // Set from a promotion to full decoding until its first frame.
+  bool switching_ = false;
+  int64_t switch_start_us_ = 0;
+  int64_t anchor_pts_us_ = 0;
+  int64_t anchor_wall_us_ = 0;
+  // Stream seconds per second; the clock above runs at this rate.
+  double rate_ = 1;
+  double reported_rate_ = 1;
+  int64_t rate_updated_us_ = 0;
+  int64_t memory_reported_us_ = 0;
+  int64_t position_reported_us_ = 0;
+  // The newest stream time read, for the media buffered ahead.
+  int64_t read_us_ = kNoTime;
+  CatchUpController catch_up_;
+  std::shared_ptr<VideoFrame> frame_;
+  std::unique_ptr<AudioDecoder> audio_decoder_;
+  AudioBuffer decoded_audio_;
+  AudioBuffer stretched_audio_;
+  std::unique_ptr<WsolaStretcher> stretcher_;
+  // The stream time of the stretcher's first input, and the input frames
+  // it has taken since.
+  int64_t stretch_start_us_ = 0;
+  int64_t stretch_input_frames_ = 0;
+  CueIndex cues_;
+  std::vector<MetadataCue> new_cues_;
+  // Playback has reported the cues starting up to here. Cues found late
+  // are reported if they end at or after |cues_from_us_|, where the last
+  // seek landed.
+  int64_t cues_until_us_ = kNoTime;
+  int64_t cues_from_us_ = kNoTime;
+  // Frames before this are decoded but not shown, after a seek.
+  int64_t seek_target_us_ = kNoTime;
+
+  std::thread thread_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_MEDIA_PLAYER_H_
@@ -0,0 +1,157 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Takes |freed| bytes off what |memory| holds, demuxed first.
+void Subtract(size_t freed, PlayerMemory* memory) {
+  const size_t demuxed = std::min(freed, memory->demuxed_bytes);
+  memory->demuxed_bytes -= demuxed;
+  memory->decoded_bytes -= std::min(freed - demuxed, memory->decoded_bytes);
+}
+
+}  // namespace
+
+MemoryBudget::MemoryBudget(MemoryBudgetConfig config)
+    : config_(std::move(config)) {
+  stats_.max_bytes = config_.max_bytes;
+}
+
+void MemoryBudget::Register(const std::string& id, Evictor evictor) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Account& account = accounts_[id];
+  account.memory.id = id;
+  account.evictor = std::move(evictor);
+}
+
+void MemoryBudget::Unregister(const std::string& id) {
+  std::lock_guard<std::mutex> evict_lock(evict_mutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = accounts_.find(id);
+  if (it == accounts_.end()) return;
+  stats_.bytes -= it->second.memory.bytes();
+  accounts_.erase(it);
+}
+
+void MemoryBudget::SetRank(const std::string& id, int rank) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = accounts_.find(id);
+  if (it != accounts_.end()) it->second.memory.rank = rank;
+}
+
+double MemoryBudget::WeightLocked(const Account& account) const {
+  const std::vector<double>& weights = config_.rank_weights;
+  if (weights.empty()) return 1;
+  const int rank = account.memory.rank;
+  if (rank < 0 || rank >= static_cast<int>(weights.size())) {
+    return weights.back();
+  }
+  return weights[rank];
+}
+
+size_t MemoryBudget::AllowanceLocked(const Account& account) const {
+  double total = 0;
+  for (const auto& entry : accounts_) total += WeightLocked(entry.second);
+  if (total <= 0) return 0;
+  return static_cast<size_t>(config_.max_bytes * WeightLocked(account) /
+                             total);
+}
+
+size_t MemoryBudget::Allowance(const std::string& id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = accounts_.find(id);
+  return it == accounts_.end() ? config_.max_bytes
+                               : AllowanceLocked(it->second);
+}
+
+std::vector<std::string> MemoryBudget::EvictionOrderLocked() const {
+  std::vector<std::pair<int, std::string>> ranked;
+  ranked.reserve(accounts_.size());
+  for (const auto& entry : accounts_) {
+    const int rank = entry.second.memory.rank;
+    ranked.emplace_back(rank < 0 ? kUnranked : rank, entry.first);
+  }
+  std::stable_sort(
+      ranked.begin(), ranked.end(),
+      [](const auto& a, const auto& b) { return a.first > b.first; });
+  std::vector<std::string> order;
+  order.reserve(ranked.size());
+  for (auto& entry : ranked) order.push_back(std::move(entry.second));
+  return order;
+}
+
+void MemoryBudget::Update(const std::string& id, size_t demuxed_bytes,
+                          size_t decoded_bytes) {
+  std::vector<std::string> order;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = accounts_.find(id);
+    if (it == accounts_.end()) return;
+    PlayerMemory& memory = it->second.memory;
+    stats_.bytes -= memory.bytes();
+    memory.demuxed_bytes = demuxed_bytes;
+    memory.decoded_bytes = decoded_bytes;
+    stats_.bytes += memory.bytes();
+    memory.peak_bytes = std::max(memory.peak_bytes, memory.bytes());
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.bytes);
+    if (config_.max_bytes == 0 || stats_.bytes <= config_.max_bytes) return;
+    order = EvictionOrderLocked();
+  }
+
+  std::lock_guard<std::mutex> evict_lock(evict_mutex_);
+  for (const std::string& victim : order) {
+    Evictor evictor;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Another report may have evicted enough meanwhile.
+      if (stats_.bytes <= config_.max_bytes) return;
+      auto it = accounts_.find(victim);
+      if (it == accounts_.end() || it->second.memory.bytes() == 0) continue;
+      evictor = it->second.evictor;
+    }
+    const size_t freed = evictor ? evictor() : 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = accounts_.find(victim);
+    if (it == accounts_.end()) continue;
+    PlayerMemory& memory = it->second.memory;
+    const size_t held = memory.bytes();
+    Subtract(freed, &memory);
+    const size_t released = held - memory.bytes();
+    if (released == 0) continue;
+    stats_.bytes -= released;
+    ++memory.evictions;
+    memory.evicted_bytes += released;
+    ++stats_.evictions;
+    stats_.evicted_bytes += released;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stats_.bytes > config_.max_bytes) ++stats_.overruns;
+}
+
+std::vector<PlayerMemory> MemoryBudget::players() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<PlayerMemory> players;
+  players.reserve(accounts_.size());
+  for (const auto& entry : accounts_) {
+    players.push_back(entry.second.memory);
+    players.back().allowance_bytes = AllowanceLocked(entry.second);
+  }
+  std::stable_sort(players.begin(), players.end(),
+                   [](const PlayerMemory& a, const PlayerMemory& b) {
+                     const int a_rank = a.rank < 0 ? kUnranked : a.rank;
+                     const int b_rank = b.rank < 0 ? kUnranked : b.rank;
+                     return a_rank < b_rank;
+                   });
+  return players;
+}
+
+MemoryBudgetStats MemoryBudget::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,114 @@
+#ifndef IVS_BROADCASTER_MEMORY_BUDGET_H_
+#define IVS_BROADCASTER_MEMORY_BUDGET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+struct MemoryBudgetConfig {
+  // For the demuxed and decoded buffers of all players together. 0 turns
+  // the budget off.
+  size_t max_bytes = 128 << 20;
+  // Each player's share of the budget by selection rank, the selected
+  // player first; later ranks, and players never selected, take the last.
+  std::vector<double> rank_weights = {8, 2, 1};
+};
+
+struct PlayerMemory {
+  std::string id;
+  // 0 for the selected player, then in order of last selection; -1 if
+  // never selected.
+  int rank = -1;
+  // Media loaded or cached but not decoded, e.g. read-ahead and the GOP
+  // cache, and decoded pictures and audio.
+  size_t demuxed_bytes = 0;
+  size_t decoded_bytes = 0;
+  // The player's priority-weighted share of the budget.
+  size_t allowance_bytes = 0;
+  size_t peak_bytes = 0;
+  uint64_t evictions = 0;
+  uint64_t evicted_bytes = 0;
+
+  size_t bytes() const { return demuxed_bytes + decoded_bytes; }
+};
+
+struct MemoryBudgetStats {
+  size_t max_bytes = 0;
+  size_t bytes = 0;
+  size_t peak_bytes = 0;
+  uint64_t evictions = 0;
+  uint64_t evicted_bytes = 0;
+  // Reports that left the budget exceeded after every player had been
+  // asked to give memory back.
+  uint64_t overruns = 0;
+};
+
+// Holds the buffers of every player in the process to one byte budget.
+//
+// Players report what they hold and size their read-ahead to their
+// allowance, a share of the budget weighted by how recently they were
+// selected. When a report takes the total over the budget, players are
+// asked to give memory back, least recently selected first, the selected
+// player last, until it fits. Thread-safe.
+class MemoryBudget {
+ public:
+  // Frees what the player can spare at once and returns how many bytes
+  // that was. May also start freeing more that shows in later reports.
+  // Called on the thread whose report exceeded the budget, without the
+  // budget's lock; must not call Update().
+  using Evictor = std::function<size_t()>;
+
+  explicit MemoryBudget(MemoryBudgetConfig config);
+
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  void Register(const std::string& id, Evictor evictor);
+  // Returns once no eviction of |id| is running, so its evictor may go.
+  void Unregister(const std::string& id);
+
+  // Players with a lower rank get a larger share and are evicted later.
+  void SetRank(const std::string& id, int rank);
+
+  // Records what |id| holds now, evicting if the budget is exceeded.
+  void Update(const std::string& id, size_t demuxed_bytes,
+              size_t decoded_bytes);
+
+  // The share of the budget |id| should keep its buffers within.
+  size_t Allowance(const std::string& id) const;
+
+  // Every registered player, selected first.
+  std::vector<PlayerMemory> players() const;
+  MemoryBudgetStats stats() const;
+
+ private:
+  struct Account {
+    PlayerMemory memory;
+    Evictor evictor;
+  };
+
+  static constexpr int kUnranked = 1 << 30;
+
+  double WeightLocked(const Account& account) const;
+  size_t AllowanceLocked(const Account& account) const;
+  // Ids in eviction order: unranked first, then the highest rank.
+  std::vector<std::string> EvictionOrderLocked() const;
+
+  const MemoryBudgetConfig config_;
+
+  // Held while evictors run, so Unregister() can wait them out.
+  std::mutex evict_mutex_;
+  mutable std::mutex mutex_;
+  std::map<std::string, Account> accounts_;
+  MemoryBudgetStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_MEMORY_BUDGET_H_
@@ -0,0 +1,304 @@
+#include "metadata_codec.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr char kBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Raw deflate, so the payload carries no zlib header or checksum.
+constexpr int kWindowBits = -15;
+
+constexpr size_t kDefaultDictionarySize = 1024;
+
+// Representative messages for DefaultMetadataDictionary(). Changing them
+// changes the dictionary, which viewers must then pick up as well.
+const char* const kDefaultDictionarySamples[] = {
+    "{\"type\":\"question\",\"id\":1001,\"text\":\"Which planet is known "
+    "as the red planet?\",\"choices\":[\"Venus\",\"Mars\",\"Jupiter\","
+    "\"Saturn\"],\"timeout\":15}",
+    "{\"type\":\"question\",\"id\":1002,\"text\":\"What is the capital "
+    "of Australia?\",\"choices\":[\"Sydney\",\"Melbourne\",\"Canberra\","
+    "\"Perth\"],\"timeout\":15}",
+    "{\"type\":\"question\",\"id\":1003,\"text\":\"How many sides does a "
+    "hexagon have?\",\"choices\":[\"5\",\"6\",\"7\",\"8\"],\"timeout\":10}",
+    "{\"type\":\"answer\",\"id\":1001,\"correct\":1,\"stats\":[12,64,"
+    "18,6]}",
+    "{\"type\":\"answer\",\"id\":1002,\"correct\":2,\"stats\":[41,9,"
+    "37,13]}",
+    "{\"type\":\"answer\",\"id\":1003,\"correct\":1,\"stats\":[3,88,"
+    "7,2]}",
+    "{\"type\":\"poll\",\"id\":2001,\"text\":\"Who wins tonight?\","
+    "\"choices\":[\"Home\",\"Away\",\"Draw\"],\"timeout\":30}",
+    "{\"type\":\"poll\",\"id\":2002,\"text\":\"Pick the next song\","
+    "\"choices\":[\"A\",\"B\",\"C\",\"D\"],\"timeout\":30}",
+    "{\"type\":\"results\",\"id\":2001,\"votes\":[512,430,97]}",
+    "{\"type\":\"score\",\"home\":2,\"away\":1,\"period\":2,"
+    "\"clock\":\"63:12\"}",
+    "{\"type\":\"score\",\"home\":2,\"away\":2,\"period\":2,"
+    "\"clock\":\"78:40\"}",
+    "{\"type\":\"leaderboard\",\"players\":[{\"name\":\"ana\","
+    "\"points\":1200},{\"name\":\"li\",\"points\":1100},{\"name\":"
+    "\"sam\",\"points\":950}]}",
+    "{\"type\":\"leaderboard\",\"players\":[{\"name\":\"li\","
+    "\"points\":1400},{\"name\":\"ana\",\"points\":1300},{\"name\":"
+    "\"kim\",\"points\":990}]}",
+    "{\"type\":\"reaction\",\"emoji\":\"clap\",\"count\":37}",
+    "{\"type\":\"reaction\",\"emoji\":\"heart\",\"count\":112}",
+    "{\"type\":\"product\",\"id\":\"sku-4410\",\"title\":\"Team "
+    "jersey\",\"price\":\"49.99\",\"currency\":\"USD\"}",
+};
+
+bool IsFragmentEnd(char c) {
+  switch (c) {
+    case ',':
+    case ':':
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case '"':
+    case ' ':
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+bool IsValidMetadataMessage(const std::string& message) {
+  return message.find_first_of("\x1e\x1f") == std::string::npos;
+}
+
+MetadataCompressor::MetadataCompressor(std::string dictionary)
+    : dictionary_(std::move(dictionary)) {}
+
+bool MetadataCompressor::Compress(const std::string& input,
+                                  std::string* output) const {
+  z_stream stream{};
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, kWindowBits, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  bool ok = dictionary_.empty() ||
+            deflateSetDictionary(
+                &stream, reinterpret_cast<const Bytef*>(dictionary_.data()),
+                static_cast<uInt>(dictionary_.size())) == Z_OK;
+  if (ok) {
+    output->resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+    stream.avail_out = static_cast<uInt>(output->size());
+    ok = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    output->resize(stream.total_out);
+  }
+  deflateEnd(&stream);
+  return ok;
+}
+
+bool MetadataCompressor::Decompress(const std::string& input,
+                                    std::string* output) const {
+  z_stream stream{};
+  if (inflateInit2(&stream, kWindowBits) != Z_OK) return false;
+  // Raw inflate takes the dictionary up front rather than on Z_NEED_DICT.
+  bool ok = dictionary_.empty() ||
+            inflateSetDictionary(
+                &stream, reinterpret_cast<const Bytef*>(dictionary_.data()),
+                static_cast<uInt>(dictionary_.size())) == Z_OK;
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  output->clear();
+  char buffer[4096];
+  int status = Z_OK;
+  while (ok && status == Z_OK) {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_NO_FLUSH);
+    ok = status == Z_OK || status == Z_STREAM_END;
+    if (ok) output->append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  return ok && status == Z_STREAM_END;
+}
+
+std::string TrainMetadataDictionary(const std::vector<std::string>& samples,
+                                    size_t max_size) {
+  // Fragments run up to and including a JSON delimiter, so keys, common
+  // values and punctuation are counted as units, along with runs of up to
+  // kMaxRun consecutive fragments to catch whole recurring key-value pairs.
+  constexpr int kMaxRun = 8;
+  std::unordered_map<std::string, size_t> counts;
+  for (const std::string& sample : samples) {
+    std::vector<size_t> ends;
+    for (size_t i = 0; i < sample.size(); ++i) {
+      if (IsFragmentEnd(sample[i]) || i + 1 == sample.size()) {
+        ends.push_back(i + 1);
+      }
+    }
+    for (size_t first = 0; first < ends.size(); ++first) {
+      const size_t start = first == 0 ? 0 : ends[first - 1];
+      for (size_t last = first;
+           last < ends.size() && last < first + kMaxRun; ++last) {
+        if (ends[last] - start >= 3) {
+          ++counts[sample.substr(start, ends[last] - start)];
+        }
+      }
+    }
+  }
+  std::vector<std::pair<size_t, std::string>> scored;
+  for (auto& entry : counts) {
+    if (entry.second < 2) continue;
+    scored.emplace_back((entry.second - 1) * entry.first.size(),
+                        std::move(entry.first));
+  }
+  std::sort(scored.begin(), scored.end(),
+            [](const auto& a, const auto& b) {
+              return a.first != b.first ? a.first > b.first
+                                        : a.second < b.second;
+            });
+  std::vector<const std::string*> chosen;
+  size_t size = 0;
+  for (const auto& entry : scored) {
+    if (size + entry.second.size() > max_size) continue;
+    // Parts of a longer run already chosen add nothing.
+    const bool covered =
+        std::any_of(chosen.begin(), chosen.end(), [&](const std::string* s) {
+          return s->find(entry.second) != std::string::npos;
+        });
+    if (covered) continue;
+    size += entry.second.size();
+    chosen.push_back(&entry.second);
+  }
+  std::string dictionary;
+  dictionary.reserve(size);
+  for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+    dictionary += **it;
+  }
+  return dictionary;
+}
+
+const std::string& DefaultMetadataDictionary() {
+  static const std::string dictionary = TrainMetadataDictionary(
+      std::vector<std::string>(std::begin(kDefaultDictionarySamples),
+                               std::end(kDefaultDictionarySamples)),
+      kDefaultDictionarySize);
+  return dictionary;
+}
+
+std::string EncodeMetadataPayload(const std::vector<std::string>& messages,
+                                  const MetadataCompressor* compressor) {
+  std::string framed;
+  if (messages.size() == 1) {
+    framed = messages.front();
+  } else {
+    for (const std::string& message : messages) {
+      framed += kMetadataBatchMarker;
+      framed += message;
+    }
+  }
+  if (compressor == nullptr) return framed;
+  std::string compressed;
+  if (!compressor->Compress(framed, &compressed)) return framed;
+  std::string encoded = kMetadataCompressedMarker + Base64Encode(compressed);
+  return encoded.size() < framed.size() ? encoded : framed;
+}
+
+bool DecodeMetadataPayload(const std::string& payload,
+                           const MetadataCompressor* compressor,
+                           std::vector<std::string>* messages) {
+  messages->clear();
+  std::string framed;
+  if (!payload.empty() && payload[0] == kMetadataCompressedMarker) {
+    std::string compressed;
+    if (compressor == nullptr ||
+        !Base64Decode(payload.substr(1), &compressed) ||
+        !compressor->Decompress(compressed, &framed)) {
+      return false;
+    }
+  } else {
+    framed = payload;
+  }
+  if (framed.empty() || framed[0] != kMetadataBatchMarker) {
+    messages->push_back(std::move(framed));
+    return true;
+  }
+  size_t start = 1;
+  while (true) {
+    const size_t end = framed.find(kMetadataBatchMarker, start);
+    messages->push_back(framed.substr(start, end - start));
+    if (end == std::string::npos) return true;
+    start = end + 1;
+  }
+}
+
+std::string Base64Encode(const std::string& input) {
+  std::string output;
+  output.reserve((input.size() + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 3 <= input.size(); i += 3) {
+    const uint32_t bits = static_cast<uint8_t>(input[i]) << 16 |
+                          static_cast<uint8_t>(input[i + 1]) << 8 |
+                          static_cast<uint8_t>(input[i + 2]);
+    output += kBase64Alphabet[bits >> 18];
+    output += kBase64Alphabet[(bits >> 12) & 63];
+    output += kBase64Alphabet[(bits >> 6) & 63];
+    output += kBase64Alphabet[bits & 63];
+  }
+  if (i < input.size()) {
+    uint32_t bits = static_cast<uint8_t>(input[i]) << 16;
+    if (i + 1 < input.size()) bits |= static_cast<uint8_t>(input[i + 1]) << 8;
+    output += kBase64Alphabet[bits >> 18];
+    output += kBase64Alphabet[(bits >> 12) & 63];
+    output += i + 1 < input.size() ? kBase64Alphabet[(bits >> 6) & 63] : '=';
+    output += '=';
+  }
+  return output;
+}
+
+bool Base64Decode(const std::string& input, std::string* output) {
+  if (input.size() % 4 != 0) return false;
+  output->clear();
+  uint32_t bits = 0;
+  int count = 0;
+  for (size_t i = 0; i < input.size(); ++i) {
+    const char c = input[i];
+    if (c == '=') {
+      // Padding only at the end.
+      if (i + 2 < input.size()) return false;
+      break;
+    }
+    const char* found = std::find(kBase64Alphabet, kBase64Alphabet + 64, c);
+    if (found == kBase64Alphabet + 64) return false;
+    bits = bits << 6 | static_cast<uint32_t>(found - kBase64Alphabet);
+    if (++count == 4) {
+      output->push_back(static_cast<char>(bits >> 16));
+      output->push_back(static_cast<char>(bits >> 8));
+      output->push_back(static_cast<char>(bits));
+      bits = 0;
+      count = 0;
+    }
+  }
+  if (count == 3) {
+    output->push_back(static_cast<char>(bits >> 10));
+    output->push_back(static_cast<char>(bits >> 2));
+  } else if (count == 2) {
+    output->push_back(static_cast<char>(bits >> 4));
+  } else if (count != 0) {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ivs_broadcaster
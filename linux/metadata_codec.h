@@ -0,0 +1,69 @@
+#ifndef IVS_BROADCASTER_METADATA_CODEC_H_
+#define IVS_BROADCASTER_METADATA_CODEC_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// Wire format of one timed-metadata payload, as viewers receive it in a
+// text cue (mirrored by TimedMetadata.decode on the Dart side):
+//
+//   message                     a single message, sent verbatim
+//   "\x1e" m1 "\x1e" m2 ...     a batch
+//   "\x1f" base64(deflate)      a compressed single message or batch, raw
+//                               deflate with the shared preset dictionary
+//
+// Messages therefore may not contain either marker byte.
+constexpr char kMetadataBatchMarker = '\x1e';
+constexpr char kMetadataCompressedMarker = '\x1f';
+
+// Whether |message| can be framed, i.e. contains neither marker.
+bool IsValidMetadataMessage(const std::string& message);
+
+// Compresses payloads with raw deflate and a preset dictionary shared with
+// the receivers. Sample-trained dictionaries make the short, repetitive
+// messages typical of timed metadata (quiz questions, scores) compress well
+// where a dictionary-less compressor cannot.
+class MetadataCompressor {
+ public:
+  explicit MetadataCompressor(std::string dictionary);
+
+  const std::string& dictionary() const { return dictionary_; }
+
+  bool Compress(const std::string& input, std::string* output) const;
+  bool Decompress(const std::string& input, std::string* output) const;
+
+ private:
+  std::string dictionary_;
+};
+
+// Builds a preset dictionary of at most |max_size| bytes from |samples| of
+// typical messages: fragments that recur across samples, the most valuable
+// last, where deflate reaches them with the shortest distances.
+std::string TrainMetadataDictionary(const std::vector<std::string>& samples,
+                                    size_t max_size);
+
+// The dictionary used when compression is enabled without one: trained once
+// on built-in samples of typical interactive-stream messages (quiz
+// questions and answers, polls, scores, reactions).
+const std::string& DefaultMetadataDictionary();
+
+// Frames |messages| into one payload, compressed when |compressor| is set and
+// that makes it smaller.
+std::string EncodeMetadataPayload(const std::vector<std::string>& messages,
+                                  const MetadataCompressor* compressor);
+
+// Splits a received payload back into messages. Returns false for a
+// compressed payload that cannot be decoded with |compressor|.
+bool DecodeMetadataPayload(const std::string& payload,
+                           const MetadataCompressor* compressor,
+                           std::vector<std::string>* messages);
+
+std::string Base64Encode(const std::string& input);
+bool Base64Decode(const std::string& input, std::string* output);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_METADATA_CODEC_H_
@@ -0,0 +1,150 @@
+#include "metadata_queue.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+MetadataQueue::MetadataQueue(
+    MetadataQueueConfig config,
+    std::shared_ptr<const MetadataCompressor> compressor)
+    : config_(config),
+      compressor_(std::move(compressor)),
+      tokens_(static_cast<double>(config.burst_bytes)) {}
+
+bool MetadataQueue::Push(const std::string& message, int64_t now_us) {
+  const bool valid =
+      IsValidMetadataMessage(message) &&
+      EncodeMetadataPayload({message}, compressor_.get()).size() <=
+          config_.max_payload_bytes;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.pushed;
+  if (!valid) {
+    ++stats_.dropped;
+    return false;
+  }
+  auto seen = recent_.find(message);
+  if (seen != recent_.end() && now_us - seen->second < config_.dedup_us) {
+    ++stats_.deduplicated;
+    return false;
+  }
+  recent_[message] = now_us;
+  pending_.push_back(Pending{message, now_us});
+  return true;
+}
+
+std::string MetadataQueue::Encode(size_t count) const {
+  std::vector<std::string> messages;
+  messages.reserve(count);
+  for (size_t i = 0; i < count; ++i) messages.push_back(pending_[i].message);
+  return EncodeMetadataPayload(messages, compressor_.get());
+}
+
+void MetadataQueue::Poll(int64_t frame_pts_us,
+                         std::vector<MetadataPayload>* payloads) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (refilled_us_ >= 0 && frame_pts_us > refilled_us_) {
+    tokens_ = std::min(
+        static_cast<double>(config_.burst_bytes),
+        tokens_ + (frame_pts_us - refilled_us_) * config_.bytes_per_second /
+                      1e6);
+  }
+  refilled_us_ = std::max(refilled_us_, frame_pts_us);
+
+  for (auto it = recent_.begin(); it != recent_.end();) {
+    if (frame_pts_us - it->second >= config_.dedup_us) {
+      it = recent_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  while (!pending_.empty() &&
+         frame_pts_us - pending_.front().pushed_us > config_.max_age_us) {
+    pending_.pop_front();
+    ++stats_.dropped;
+  }
+
+  while (!pending_.empty() &&
+         frame_pts_us >= pending_.front().pushed_us + config_.window_us) {
+    // As many messages as fit uncompressed, which is cheap to measure...
+    size_t count = 0;
+    size_t framed = 0;
+    while (count < pending_.size()) {
+      const size_t size =
+          framed + pending_[count].message.size() + (count > 0 ? 1 : 0) +
+          (count == 1 ? 1 : 0);
+      if (count > 0 && size > config_.max_payload_bytes) break;
+      framed = size;
+      ++count;
+    }
+    std::string payload = Encode(count);
+    // ...then, if compression makes room, the most that fit compressed,
+    // found in a logarithmic number of compressions.
+    if (compressor_ && count < pending_.size()) {
+      size_t low = count;
+      size_t high = pending_.size();
+      while (low < high) {
+        const size_t mid = (low + high + 1) / 2;
+        std::string candidate = Encode(mid);
+        if (candidate.size() <= config_.max_payload_bytes) {
+          low = mid;
+          payload = std::move(candidate);
+        } else {
+          high = mid - 1;
+        }
+      }
+      count = low;
+    }
+    if (static_cast<double>(payload.size()) > tokens_) break;
+    tokens_ -= static_cast<double>(payload.size());
+
+    MetadataPayload out;
+    out.pts_us = frame_pts_us;
+    out.messages = count;
+    for (size_t i = 0; i < count; ++i) {
+      stats_.raw_bytes += pending_.front().message.size() + (count > 1);
+      stats_.max_delay_us = std::max(
+          stats_.max_delay_us, frame_pts_us - pending_.front().pushed_us);
+      pending_.pop_front();
+    }
+    stats_.sent_messages += count;
+    ++stats_.sent_payloads;
+    stats_.sent_bytes += payload.size();
+    out.data = std::move(payload);
+    payloads->push_back(std::move(out));
+  }
+}
+
+void MetadataQueue::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.dropped += pending_.size();
+  pending_.clear();
+}
+
+void MetadataQueue::MoveFrom(MetadataQueue* previous) {
+  std::deque<Pending> pending;
+  std::unordered_map<std::string, int64_t> recent;
+  {
+    std::lock_guard<std::mutex> lock(previous->mutex_);
+    pending.swap(previous->pending_);
+    recent.swap(previous->recent_);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : recent) recent_.insert(std::move(entry));
+  for (Pending& message : pending) {
+    ++stats_.pushed;
+    if (EncodeMetadataPayload({message.message}, compressor_.get()).size() >
+        config_.max_payload_bytes) {
+      ++stats_.dropped;
+      continue;
+    }
+    pending_.push_back(std::move(message));
+  }
+}
+
+MetadataQueueStats MetadataQueue::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace ivs_broadcaster
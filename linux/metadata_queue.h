@@ -0,0 +1,112 @@
+#ifndef IVS_BROADCASTER_METADATA_QUEUE_H_
+#define IVS_BROADCASTER_METADATA_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "metadata_codec.h"
+
+namespace ivs_broadcaster {
+
+struct MetadataQueueConfig {
+  // Messages pushed within this long of the first pending one go out
+  // together. Zero sends each on the next frame.
+  int64_t window_us = 100000;
+  // An identical message pushed again within this long is dropped.
+  int64_t dedup_us = 2000000;
+  // IVS caps a timed-metadata payload at 1 KB.
+  size_t max_payload_bytes = 1024;
+  // Sustained payload budget and the burst allowed above it.
+  double bytes_per_second = 2048;
+  size_t burst_bytes = 4096;
+  // Messages that waited longer than this for budget are dropped; late quiz
+  // questions are worse than missing ones.
+  int64_t max_age_us = 5000000;
+};
+
+// A payload ready to mux, attached to the video frame at |pts_us|.
+struct MetadataPayload {
+  std::string data;
+  int64_t pts_us = 0;
+  size_t messages = 0;
+};
+
+struct MetadataQueueStats {
+  uint64_t pushed = 0;
+  uint64_t deduplicated = 0;
+  // Rejected as oversized or invalid, or expired waiting for budget.
+  uint64_t dropped = 0;
+  uint64_t sent_messages = 0;
+  uint64_t sent_payloads = 0;
+  // Framed size before compression, and size actually sent.
+  uint64_t raw_bytes = 0;
+  uint64_t sent_bytes = 0;
+  // Longest time from Push() to the frame a message was attached to.
+  int64_t max_delay_us = 0;
+};
+
+// Turns bursts of timed-metadata messages into payloads that fit IVS's size
+// and rate limits.
+//
+// Push() may be called from any thread. The encode thread calls Poll() once
+// per video frame with that frame's timestamp, which drives every timer:
+// batching windows, the byte budget (a token bucket) and expiry all run on
+// the video clock, so each payload is attached to the first frame at or
+// after the moment it became sendable. Both clocks are steady-clock
+// microseconds.
+class MetadataQueue {
+ public:
+  // |compressor| may be null to send payloads uncompressed.
+  MetadataQueue(MetadataQueueConfig config,
+                std::shared_ptr<const MetadataCompressor> compressor);
+
+  MetadataQueue(const MetadataQueue&) = delete;
+  MetadataQueue& operator=(const MetadataQueue&) = delete;
+
+  // Returns false if |message| was dropped as a duplicate, oversized or
+  // invalid (see IsValidMetadataMessage()).
+  bool Push(const std::string& message, int64_t now_us);
+
+  // Appends the payloads to send with the frame at |frame_pts_us|.
+  void Poll(int64_t frame_pts_us, std::vector<MetadataPayload>* payloads);
+
+  // Drops everything pending, e.g. when the broadcast stops.
+  void Clear();
+
+  // Takes over the messages |previous| has not sent yet, with their push
+  // times, and its deduplication history, e.g. when the queue is
+  // reconfigured. Messages this queue's limits reject count as dropped.
+  void MoveFrom(MetadataQueue* previous);
+
+  MetadataQueueStats stats() const;
+
+ private:
+  struct Pending {
+    std::string message;
+    int64_t pushed_us;
+  };
+
+  // The payload for the first |count| pending messages.
+  std::string Encode(size_t count) const;
+
+  const MetadataQueueConfig config_;
+  const std::shared_ptr<const MetadataCompressor> compressor_;
+
+  mutable std::mutex mutex_;
+  std::deque<Pending> pending_;
+  // Push time of each recently seen message, for deduplication.
+  std::unordered_map<std::string, int64_t> recent_;
+  double tokens_;
+  int64_t refilled_us_ = -1;
+  MetadataQueueStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_METADATA_QUEUE_H_
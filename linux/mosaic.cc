@@ -0,0 +1,220 @@
+#include "mosaic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "frame_scaler.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Black in the limited range I420ToRgba() expects.
+constexpr uint8_t kBlackY = 16;
+constexpr uint8_t kBlackUv = 128;
+
+int EvenFloor(double value) { return static_cast<int>(value) & ~1; }
+
+MosaicRect PixelRect(const MosaicTile& tile, int width, int height) {
+  MosaicRect rect;
+  rect.x = std::clamp(EvenFloor(tile.x * width), 0, width);
+  rect.y = std::clamp(EvenFloor(tile.y * height), 0, height);
+  const int right =
+      std::clamp(EvenFloor((tile.x + tile.width) * width), rect.x, width);
+  const int bottom =
+      std::clamp(EvenFloor((tile.y + tile.height) * height), rect.y, height);
+  rect.width = right - rect.x;
+  rect.height = bottom - rect.y;
+  return rect;
+}
+
+// The largest even size with |width| x |height|'s aspect ratio that fits
+// |rect|, scaling up as well as down, centred in it.
+MosaicRect FitInto(int width, int height, const MosaicRect& rect) {
+  const double scale =
+      std::min(static_cast<double>(rect.width) / width,
+               static_cast<double>(rect.height) / height);
+  MosaicRect fitted;
+  fitted.width = std::clamp(EvenFloor(width * scale), 2, rect.width);
+  fitted.height = std::clamp(EvenFloor(height * scale), 2, rect.height);
+  fitted.x = rect.x + (((rect.width - fitted.width) / 2) & ~1);
+  fitted.y = rect.y + (((rect.height - fitted.height) / 2) & ~1);
+  return fitted;
+}
+
+void FillPlane(uint8_t* plane, int stride, int x, int y, int width,
+               int height, uint8_t value) {
+  for (int row = 0; row < height; ++row) {
+    std::memset(plane + static_cast<size_t>(y + row) * stride + x, value,
+                width);
+  }
+}
+
+void CopyPlane(const uint8_t* src, int src_stride, uint8_t* dst,
+               int dst_stride, int x, int y, int width, int height) {
+  for (int row = 0; row < height; ++row) {
+    std::memcpy(dst + static_cast<size_t>(y + row) * dst_stride + x,
+                src + static_cast<size_t>(row) * src_stride, width);
+  }
+}
+
+bool SameRect(const MosaicRect& a, const MosaicRect& b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width &&
+         a.height == b.height;
+}
+
+}  // namespace
+
+std::vector<MosaicTile> GridLayout(int count, int columns) {
+  std::vector<MosaicTile> tiles;
+  if (count <= 0) return tiles;
+  if (columns <= 0) {
+    columns = static_cast<int>(std::ceil(std::sqrt(count)));
+  }
+  columns = std::min(columns, count);
+  const int rows = (count + columns - 1) / columns;
+  for (int i = 0; i < count; ++i) {
+    MosaicTile tile;
+    tile.width = 1.0 / columns;
+    tile.height = 1.0 / rows;
+    tile.x = (i % columns) * tile.width;
+    tile.y = (i / columns) * tile.height;
+    tiles.push_back(tile);
+  }
+  return tiles;
+}
+
+std::vector<MosaicTile> SpotlightLayout(int count) {
+  if (count <= 1) return GridLayout(count);
+  std::vector<MosaicTile> tiles;
+  tiles.push_back({0, 0, 0.75, 1});
+  const int others = count - 1;
+  for (int i = 0; i < others; ++i) {
+    tiles.push_back({0.75, static_cast<double>(i) / others, 0.25,
+                     1.0 / others});
+  }
+  return tiles;
+}
+
+bool MosaicLayoutNamed(const std::string& name, int count, int columns,
+                       std::vector<MosaicTile>* tiles) {
+  if (name == "grid") {
+    *tiles = GridLayout(count, columns);
+  } else if (name == "spotlight") {
+    *tiles = SpotlightLayout(count);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+MosaicCompositor::MosaicCompositor(MosaicConfig config, Output output)
+    : interval_us_(config.max_fps > 0 ? 1000000 / config.max_fps : 0),
+      output_(std::move(output)) {
+  const int width = std::max(2, config.width & ~1);
+  const int height = std::max(2, config.height & ~1);
+  for (const MosaicTile& layout : config.tiles) {
+    auto tile = std::make_unique<Tile>();
+    tile->rect = PixelRect(layout, width, height);
+    tiles_.push_back(std::move(tile));
+  }
+  canvas_ = pool_.Acquire();
+  canvas_->Allocate(width, height);
+  FillLocked({0, 0, width, height});
+}
+
+void MosaicCompositor::Update(int index, const VideoFrame& frame) {
+  if (index < 0 || index >= tile_count() || frame.width < 2 ||
+      frame.height < 2) {
+    return;
+  }
+  Tile& tile = *tiles_[index];
+  if (tile.rect.width < 2 || tile.rect.height < 2) return;
+  std::lock_guard<std::mutex> tile_lock(tile.mutex);
+  const MosaicRect fitted = FitInto(frame.width, frame.height, tile.rect);
+  const int64_t start_us = NowUs();
+  tile.scaled.Allocate(fitted.width, fitted.height);
+  ScaleFrame(frame, &tile.scaled);
+  const int64_t now_us = NowUs();
+
+  FramePtr published;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    VideoFrame* canvas = WritableCanvasLocked();
+    // A new aspect ratio leaves parts of the old picture outside the new.
+    if (!SameRect(tile.drawn, fitted)) FillLocked(tile.rect);
+    tile.drawn = fitted;
+    const VideoFrame& scaled = tile.scaled;
+    CopyPlane(scaled.y(), scaled.y_stride(), canvas->y(), canvas->y_stride(),
+              fitted.x, fitted.y, fitted.width, fitted.height);
+    CopyPlane(scaled.u(), scaled.uv_stride(), canvas->u(),
+              canvas->uv_stride(), fitted.x / 2, fitted.y / 2,
+              scaled.uv_stride(), scaled.uv_height());
+    CopyPlane(scaled.v(), scaled.uv_stride(), canvas->v(),
+              canvas->uv_stride(), fitted.x / 2, fitted.y / 2,
+              scaled.uv_stride(), scaled.uv_height());
+    ++stats_.updates;
+    stats_.scale_us += now_us - start_us;
+    if (now_us - published_us_ >= interval_us_) {
+      published_us_ = now_us;
+      // Taken as the capture time by the preview renderer.
+      canvas->pts_us = now_us;
+      published = canvas_;
+      ++stats_.published;
+    }
+  }
+  if (published && output_) output_(published);
+}
+
+void MosaicCompositor::Clear(int index) {
+  if (index < 0 || index >= tile_count()) return;
+  Tile& tile = *tiles_[index];
+  std::lock_guard<std::mutex> tile_lock(tile.mutex);
+  std::lock_guard<std::mutex> lock(mutex_);
+  WritableCanvasLocked();
+  FillLocked(tile.rect);
+  tile.drawn = MosaicRect();
+}
+
+FramePtr MosaicCompositor::Snapshot() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return canvas_;
+}
+
+MosaicStats MosaicCompositor::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+VideoFrame* MosaicCompositor::WritableCanvasLocked() {
+  // Only this class hands the canvas out, and only under the lock, so a
+  // count of one cannot grow behind its back.
+  if (canvas_.use_count() > 1) {
+    std::shared_ptr<VideoFrame> copy = pool_.Acquire();
+    *copy = *canvas_;
+    canvas_ = std::move(copy);
+    ++stats_.copies;
+  }
+  return canvas_.get();
+}
+
+void MosaicCompositor::FillLocked(const MosaicRect& rect) {
+  VideoFrame* canvas = canvas_.get();
+  FillPlane(canvas->y(), canvas->y_stride(), rect.x, rect.y, rect.width,
+            rect.height, kBlackY);
+  FillPlane(canvas->u(), canvas->uv_stride(), rect.x / 2, rect.y / 2,
+            rect.width / 2, rect.height / 2, kBlackUv);
+  FillPlane(canvas->v(), canvas->uv_stride(), rect.x / 2, rect.y / 2,
+            rect.width / 2, rect.height / 2, kBlackUv);
+}
+
+}  // namespace ivs_broadcaster
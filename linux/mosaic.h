@@ -0,0 +1,125 @@
+#ifndef IVS_BROADCASTER_MOSAIC_H_
+#define IVS_BROADCASTER_MOSAIC_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_pool.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+// Where a stream goes in the mosaic, in fractions of its width and height.
+struct MosaicTile {
+  double x = 0;
+  double y = 0;
+  double width = 1;
+  double height = 1;
+};
+
+// |count| equal tiles in rows of |columns|, or of the smallest number of
+// columns that makes the grid square enough when |columns| is 0.
+std::vector<MosaicTile> GridLayout(int count, int columns = 0);
+
+// The first stream large on the left, three quarters of the width; the
+// others stacked in a column on the right.
+std::vector<MosaicTile> SpotlightLayout(int count);
+
+// The layout called |name|, "grid" or "spotlight", for |count| streams.
+// Returns false for other names.
+bool MosaicLayoutNamed(const std::string& name, int count, int columns,
+                       std::vector<MosaicTile>* tiles);
+
+struct MosaicConfig {
+  // The output frame, rounded down to even numbers for I420.
+  int width = 1280;
+  int height = 720;
+  std::vector<MosaicTile> tiles = GridLayout(4);
+  // Tile updates closer together than this are published together, with
+  // the next update after it.
+  int max_fps = 30;
+};
+
+// A tile in pixels of the output frame; every value is even.
+struct MosaicRect {
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+};
+
+struct MosaicStats {
+  uint64_t updates = 0;
+  uint64_t published = 0;
+  // Published frames still referenced when the next tile was drawn, so the
+  // canvas was copied rather than drawn over.
+  uint64_t copies = 0;
+  // Total time spent scaling tiles.
+  int64_t scale_us = 0;
+};
+
+// Tiles the frames of several streams into one I420 frame, e.g. for a
+// single texture showing every camera.
+//
+// Update() scales a stream's frame into its tile with ScaleFrame(), whose
+// SIMD halving does most of the work, keeping the aspect ratio with black
+// bars, and draws it into the canvas. At most max_fps times a second the
+// canvas is handed to the output; a canvas still referenced there is
+// copied before the next tile is drawn, so published frames never change.
+// Thread-safe; tiles may be updated from different threads at once.
+class MosaicCompositor {
+ public:
+  // Called on the thread of the Update() that published |frame|, without
+  // the compositor's lock.
+  using Output = std::function<void(const FramePtr& frame)>;
+
+  MosaicCompositor(MosaicConfig config, Output output);
+
+  MosaicCompositor(const MosaicCompositor&) = delete;
+  MosaicCompositor& operator=(const MosaicCompositor&) = delete;
+
+  // Draws |frame| into tile |index|; out-of-range indices are ignored.
+  void Update(int index, const VideoFrame& frame);
+  // Blanks tile |index|, e.g. when its stream ended.
+  void Clear(int index);
+
+  int tile_count() const { return static_cast<int>(tiles_.size()); }
+  MosaicRect tile_rect(int index) const { return tiles_[index]->rect; }
+
+  // The canvas as it is now.
+  FramePtr Snapshot();
+  MosaicStats stats() const;
+
+ private:
+  struct Tile {
+    MosaicRect rect;
+    // Serialises updates of this tile; they scale into |scaled| without
+    // the canvas lock.
+    std::mutex mutex;
+    VideoFrame scaled;
+    // The picture last drawn, within |rect|; the rest is black.
+    MosaicRect drawn;
+  };
+
+  // The canvas, copied first if a published frame still references it.
+  VideoFrame* WritableCanvasLocked();
+  void FillLocked(const MosaicRect& rect);
+
+  const int64_t interval_us_;
+  const Output output_;
+  std::vector<std::unique_ptr<Tile>> tiles_;
+  FramePool pool_;
+
+  mutable std::mutex mutex_;
+  std::shared_ptr<VideoFrame> canvas_;
+  int64_t published_us_ = 0;
+  MosaicStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_MOSAIC_H_
@@ -0,0 +1,350 @@
+#include "multi_player.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+// Passes a player's events on while it is the selected one.
+class MultiPlayer::Forwarder : public MediaPlayer::Listener {
+ public:
+  Forwarder(std::string id, MultiPlayer::Listener* listener)
+      : id_(std::move(id)), listener_(listener) {}
+
+  void set_selected(bool selected) { selected_ = selected; }
+  void set_tile(int tile) { tile_ = tile; }
+
+  void OnStateChanged(MediaPlayer* player, PlayerState state) override {
+    if (selected_) listener_->OnStateChanged(id_, state);
+  }
+
+  void OnError(MediaPlayer* player, const std::string& message) override {
+    if (selected_) listener_->OnError(id_, message);
+  }
+
+  void OnFrame(MediaPlayer* player, const FramePtr& frame) override {
+    if (selected_) listener_->OnFrame(id_, frame);
+    const int tile = tile_;
+    if (tile >= 0) listener_->OnTileFrame(id_, tile, frame);
+  }
+
+  void OnSwitched(MediaPlayer* player, int64_t latency_us) override {
+    if (selected_) listener_->OnSwitched(id_, latency_us);
+  }
+
+  void OnAbrDecision(MediaPlayer* player,
+                     const AbrDecision& decision) override {
+    if (selected_) listener_->OnAbrDecision(id_, decision);
+  }
+
+  void OnAudio(MediaPlayer* player, const AudioBuffer& buffer) override {
+    if (selected_) listener_->OnAudio(id_, buffer);
+  }
+
+  void OnPlaybackRateChanged(MediaPlayer* player, double rate,
+                             int64_t latency_us) override {
+    if (selected_) listener_->OnPlaybackRateChanged(id_, rate, latency_us);
+  }
+
+  void OnCues(MediaPlayer* player, const std::vector<MetadataCue>& cues,
+              bool seek) override {
+    if (selected_) listener_->OnCues(id_, cues, seek);
+  }
+
+  void OnPosition(MediaPlayer* player, int64_t position_us,
+                  int64_t buffered_us, int64_t live_latency_us) override {
+    if (selected_) listener_->OnPosition(id_, player->stats());
+  }
+
+  void OnDuration(MediaPlayer* player, int64_t duration_us) override {
+    if (selected_) listener_->OnDuration(id_, duration_us);
+  }
+
+ private:
+  const std::string id_;
+  MultiPlayer::Listener* const listener_;
+  std::atomic<bool> selected_{false};
+  std::atomic<int> tile_{-1};
+};
+
+struct MultiPlayer::Entry {
+  std::unique_ptr<Forwarder> forwarder;
+  // Declared last so that it stops before the forwarder goes away.
+  std::unique_ptr<MediaPlayer> player;
+};
+
+MultiPlayer::MultiPlayer(MediaSourceFactory source_factory,
+                         MultiPlayerConfig config, Listener* listener)
+    : source_factory_(std::move(source_factory)),
+      config_(config),
+      listener_(listener),
+      gop_cache_(config.gop_cache_bytes > 0
+                     ? std::make_unique<GopCache>(config.gop_cache_bytes)
+                     : nullptr),
+      memory_budget_(config.memory.max_bytes > 0
+                         ? std::make_unique<MemoryBudget>(config.memory)
+                         : nullptr),
+      target_latency_us_(config.player.catch_up.target_latency_us),
+      position_interval_us_(config.player.position_interval_us) {}
+
+MultiPlayer::~MultiPlayer() { Clear(); }
+
+void MultiPlayer::Add(const std::string& url) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (players_.count(url) > 0) return;
+  if (selected_.empty()) {
+    selected_ = url;
+    recent_.push_front(url);
+    if (gop_cache_) gop_cache_->SetRank(url, 0);
+  }
+  auto entry = std::make_unique<Entry>();
+  entry->forwarder = std::make_unique<Forwarder>(url, listener_);
+  entry->forwarder->set_selected(url == selected_);
+  const int tile = TileLocked(url);
+  entry->forwarder->set_tile(tile);
+  MediaPlayer::Config player = config_.player;
+  player.mode = url == selected_ || tile >= 0 ? DecodeMode::kFull
+                                              : DecodeMode::kNetworkOnly;
+  player.gop_cache = gop_cache_.get();
+  player.memory_budget = memory_budget_.get();
+  player.catch_up.target_latency_us = target_latency_us_;
+  player.position_interval_us = position_interval_us_;
+  if (player.frame_pool == nullptr) player.frame_pool = &frame_pool_;
+  entry->player = std::make_unique<MediaPlayer>(url, source_factory_, player,
+                                                entry->forwarder.get());
+  if (memory_budget_ && url == selected_) memory_budget_->SetRank(url, 0);
+  entry->player->SetAudible(url == selected_);
+  if (tile >= 0) {
+    entry->player->abr()->SetMaxResolution(mosaic_[tile].width,
+                                           mosaic_[tile].height);
+  }
+  players_.emplace(url, std::move(entry));
+}
+
+bool MultiPlayer::Select(const std::string& id) {
+  int64_t duration_us = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = players_.find(id);
+    if (it == players_.end()) return false;
+    if (id == selected_) return true;
+    selected_ = id;
+    recent_.erase(std::remove(recent_.begin(), recent_.end(), id),
+                  recent_.end());
+    recent_.push_front(id);
+    Reschedule();
+    duration_us = it->second->player->stats().duration_us;
+  }
+  // The player sent it when it opened, most likely while in the background.
+  if (duration_us > 0) listener_->OnDuration(id, duration_us);
+  return true;
+}
+
+void MultiPlayer::SetMosaic(std::vector<MosaicSlot> slots) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  mosaic_ = std::move(slots);
+  Reschedule();
+}
+
+std::vector<MosaicSlot> MultiPlayer::mosaic() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return mosaic_;
+}
+
+int MultiPlayer::TileLocked(const std::string& id) const {
+  for (size_t i = 0; i < mosaic_.size(); ++i) {
+    if (mosaic_[i].id == id) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+void MultiPlayer::Remove(const std::string& id) {
+  std::unique_ptr<Entry> removed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = players_.find(id);
+    if (it == players_.end()) return;
+    removed = std::move(it->second);
+    players_.erase(it);
+    recent_.erase(std::remove(recent_.begin(), recent_.end(), id),
+                  recent_.end());
+    if (selected_ == id) {
+      // The most recently selected remaining player takes over.
+      selected_ = recent_.empty() ? std::string() : recent_.front();
+      if (selected_.empty() && !players_.empty()) {
+        selected_ = players_.begin()->first;
+        recent_.push_front(selected_);
+      }
+    }
+    Reschedule();
+  }
+  // Joins the player's thread, which may be waiting to forward an event;
+  // done without the lock.
+  removed.reset();
+  // Only now that the player cannot add to it.
+  if (gop_cache_) gop_cache_->Remove(id);
+}
+
+void MultiPlayer::Clear() {
+  std::map<std::string, std::unique_ptr<Entry>> removed;
+  std::vector<std::string> removed_ids;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    removed.swap(players_);
+    for (const auto& entry : removed) removed_ids.push_back(entry.first);
+    recent_.clear();
+    selected_.clear();
+  }
+  removed.clear();
+  if (gop_cache_) {
+    for (const auto& entry : removed_ids) gop_cache_->Remove(entry);
+  }
+}
+
+void MultiPlayer::Pause() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it != players_.end()) it->second->player->Pause();
+}
+
+void MultiPlayer::Resume() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it != players_.end()) it->second->player->Resume();
+}
+
+void MultiPlayer::Seek(int64_t position_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it != players_.end()) it->second->player->Seek(position_us);
+}
+
+std::vector<MetadataCue> MultiPlayer::CuesBetween(int64_t from_us,
+                                                  int64_t to_us) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it == players_.end()) return {};
+  return it->second->player->cues().Overlapping(from_us, to_us);
+}
+
+std::vector<AbrRendition> MultiPlayer::qualities() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it == players_.end()) return {};
+  return it->second->player->abr()->ladder();
+}
+
+bool MultiPlayer::SetQuality(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  return it != players_.end() && it->second->player->abr()->SetManual(name);
+}
+
+void MultiPlayer::SetAutoQuality(bool automatic) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it != players_.end()) it->second->player->abr()->SetAutomatic(automatic);
+}
+
+bool MultiPlayer::auto_quality() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  return it == players_.end() || it->second->player->abr()->automatic();
+}
+
+void MultiPlayer::SetTargetLatency(int64_t target_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  target_latency_us_ = target_us;
+  for (auto& entry : players_) {
+    entry.second->player->SetTargetLatency(target_us);
+  }
+}
+
+void MultiPlayer::SetPositionInterval(int64_t interval_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  position_interval_us_ = interval_us;
+  for (auto& entry : players_) {
+    entry.second->player->SetPositionInterval(interval_us);
+  }
+}
+
+int64_t MultiPlayer::position_us() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = players_.find(selected_);
+  if (it == players_.end()) return -1;
+  return it->second->player->stats().position_us;
+}
+
+std::string MultiPlayer::selected() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return selected_;
+}
+
+std::vector<PlayerInfo> MultiPlayer::players() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<PlayerInfo> players;
+  players.reserve(players_.size());
+  for (const auto& entry : players_) {
+    PlayerInfo info;
+    info.id = entry.first;
+    info.mode = entry.second->player->mode();
+    info.state = entry.second->player->state();
+    info.stats = entry.second->player->stats();
+    if (gop_cache_) info.cached_bytes = gop_cache_->bytes(entry.first);
+    players.push_back(std::move(info));
+  }
+  if (memory_budget_) {
+    for (PlayerMemory& memory : memory_budget_->players()) {
+      for (PlayerInfo& info : players) {
+        if (info.id == memory.id) info.memory = std::move(memory);
+      }
+    }
+  }
+  return players;
+}
+
+GopCacheStats MultiPlayer::gop_cache_stats() const {
+  return gop_cache_ ? gop_cache_->stats() : GopCacheStats();
+}
+
+MemoryBudgetStats MultiPlayer::memory_stats() const {
+  return memory_budget_ ? memory_budget_->stats() : MemoryBudgetStats();
+}
+
+void MultiPlayer::Reschedule() {
+  for (auto& entry : players_) {
+    const std::string& id = entry.first;
+    // recent_ starts with the selected player itself.
+    const auto it = std::find(recent_.begin(), recent_.end(), id);
+    const int rank =
+        it == recent_.end() ? -1 : static_cast<int>(it - recent_.begin());
+    const int tile = TileLocked(id);
+    DecodeMode mode = DecodeMode::kNetworkOnly;
+    if (id == selected_ || tile >= 0) {
+      mode = DecodeMode::kFull;
+    } else if (rank >= 0 && rank <= config_.keyframe_players) {
+      mode = DecodeMode::kKeyframes;
+    }
+    // The streams selected most recently are the likeliest to come back,
+    // so their GOPs are evicted last.
+    if (rank >= 0) {
+      if (gop_cache_) gop_cache_->SetRank(id, rank);
+      if (memory_budget_) memory_budget_->SetRank(id, rank);
+    }
+    entry.second->forwarder->set_selected(id == selected_);
+    entry.second->forwarder->set_tile(tile);
+    MediaPlayer* player = entry.second->player.get();
+    player->SetAudible(id == selected_);
+    // Streams in small tiles need no more than a small rendition.
+    if (tile >= 0) {
+      player->abr()->SetMaxResolution(mosaic_[tile].width,
+                                      mosaic_[tile].height);
+    } else {
+      player->abr()->SetMaxResolution(0, 0);
+    }
+    player->SetMode(mode);
+  }
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,190 @@
+#ifndef IVS_BROADCASTER_MULTI_PLAYER_H_
+#define IVS_BROADCASTER_MULTI_PLAYER_H_
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_pool.h"
+#include "gop_cache.h"
+#include "media_player.h"
+#include "memory_budget.h"
+
+namespace ivs_broadcaster {
+
+struct MultiPlayerConfig {
+  // Background players that keep decoding keyframes, most recently selected
+  // first; the rest only download.
+  int keyframe_players = 1;
+  // Shared by the latest GOPs of all streams, which let a selected stream
+  // show a frame without waiting for its next keyframe. 0 disables the
+  // cache.
+  size_t gop_cache_bytes = 32 << 20;
+  // Holds the read-ahead, cached GOPs and decoded buffers of all players
+  // to one budget, shared by selection rank like the GOP cache.
+  MemoryBudgetConfig memory;
+  MediaPlayer::Config player;
+};
+
+// A stream shown in a mosaic tile of |width| x |height| pixels.
+struct MosaicSlot {
+  std::string id;
+  int width = 0;
+  int height = 0;
+};
+
+struct PlayerInfo {
+  std::string id;
+  DecodeMode mode = DecodeMode::kNetworkOnly;
+  PlayerState state = PlayerState::kIdle;
+  MediaPlayerStats stats;
+  // Bytes of the stream's latest GOP held in the cache.
+  size_t cached_bytes = 0;
+  // Empty without a memory budget.
+  PlayerMemory memory;
+};
+
+// Plays several streams but fully decodes only the one on screen.
+//
+// The selected player decodes every frame. The players selected most
+// recently before it decode keyframes only, and the others just download,
+// so the connection and live position stay warm while their decode cost is
+// near zero. Select() promotes a player to full decoding and demotes the
+// previous one. A promoted stream decodes its cached GOP faster than real
+// time and shows the live frame at once; when the cache had to drop that
+// GOP it starts at its next keyframe.
+//
+// In mosaic mode the streams shown in tiles all decode in full, each at
+// the rendition its tile needs, while only the selected one is heard and
+// reports its events.
+//
+// With a memory budget, players that held the most when it ran out give
+// back memory in the same order: the least recently selected first, the
+// selected player last.
+class MultiPlayer {
+ public:
+  // Only the selected player's events are forwarded. Called on player
+  // threads.
+  class Listener {
+   public:
+    virtual ~Listener() = default;
+    virtual void OnStateChanged(const std::string& id, PlayerState state) = 0;
+    virtual void OnError(const std::string& id, const std::string& message) = 0;
+    virtual void OnFrame(const std::string& id, const FramePtr& frame) = 0;
+    // A frame of the stream shown in mosaic tile |tile|; see SetMosaic().
+    // Forwarded whether or not |id| is selected.
+    virtual void OnTileFrame(const std::string& id, int tile,
+                             const FramePtr& frame) = 0;
+    // |id| showed its first frame |latency_us| after being selected.
+    virtual void OnSwitched(const std::string& id, int64_t latency_us) = 0;
+    virtual void OnAbrDecision(const std::string& id,
+                               const AbrDecision& decision) = 0;
+    virtual void OnAudio(const std::string& id, const AudioBuffer& buffer) = 0;
+    virtual void OnPlaybackRateChanged(const std::string& id, double rate,
+                                       int64_t latency_us) = 0;
+    virtual void OnCues(const std::string& id,
+                        const std::vector<MetadataCue>& cues, bool seek) = 0;
+    // See MediaPlayer::Listener::OnPosition(); |stats| hold the position,
+    // buffer and latency reported, with the rest of the player's totals.
+    virtual void OnPosition(const std::string& id,
+                            const MediaPlayerStats& stats) = 0;
+    // Also sent again, on the caller's thread, by Select() when the newly
+    // selected stream already knows its length.
+    virtual void OnDuration(const std::string& id, int64_t duration_us) = 0;
+  };
+
+  MultiPlayer(MediaSourceFactory source_factory, MultiPlayerConfig config,
+              Listener* listener);
+  ~MultiPlayer();
+
+  MultiPlayer(const MultiPlayer&) = delete;
+  MultiPlayer& operator=(const MultiPlayer&) = delete;
+
+  // Starts playing |url| under the id |url|, in the background unless
+  // nothing is selected yet. Does nothing if it is already playing.
+  void Add(const std::string& url);
+  // Makes |id| the player on screen, and in mosaic mode the one heard.
+  // Returns false if there is no such player.
+  bool Select(const std::string& id);
+
+  // Shows the streams of |slots| in mosaic tiles, in order, from their
+  // next frame: they decode in full and pick renditions no larger than
+  // their tile needs. Players added later take their tile when they start.
+  // No slots end mosaic mode.
+  void SetMosaic(std::vector<MosaicSlot> slots);
+  std::vector<MosaicSlot> mosaic() const;
+  void Remove(const std::string& id);
+  void Clear();
+
+  // Pauses or resumes the selected player.
+  void Pause();
+  void Resume();
+  // Seeks the selected player; see MediaPlayer::Seek().
+  void Seek(int64_t position_us);
+
+  // The cues of the selected stream seen so far that overlap
+  // [from_us, to_us], in order.
+  std::vector<MetadataCue> CuesBetween(int64_t from_us, int64_t to_us) const;
+
+  // Renditions of the selected stream, lowest first; empty until its
+  // master playlist is loaded or when it has a single rendition.
+  std::vector<AbrRendition> qualities() const;
+  // Pins the selected stream to the rendition called |name| from its next
+  // segment. Returns false if it has none of that name.
+  bool SetQuality(const std::string& name);
+  // Turns automatic rendition choice for the selected stream on or off.
+  void SetAutoQuality(bool automatic);
+  bool auto_quality() const;
+
+  // The latency behind the live edge every player steers to, now and when
+  // added later; see CatchUpConfig::target_latency_us.
+  void SetTargetLatency(int64_t target_us);
+  // How often every player reports its position, now and when added
+  // later; see MediaPlayer::Config::position_interval_us.
+  void SetPositionInterval(int64_t interval_us);
+
+  // The stream time the selected player shows, or -1 before its first
+  // frame or with nothing selected.
+  int64_t position_us() const;
+
+  std::string selected() const;
+  std::vector<PlayerInfo> players() const;
+  GopCacheStats gop_cache_stats() const;
+  MemoryBudgetStats memory_stats() const;
+
+ private:
+  class Forwarder;
+  struct Entry;
+
+  // Assigns every player its mode from the selection history, and its
+  // mosaic tile.
+  void Reschedule();
+  // The mosaic tile of |id|, or -1.
+  int TileLocked(const std::string& id) const;
+
+  const MediaSourceFactory source_factory_;
+  const MultiPlayerConfig config_;
+  Listener* const listener_;
+  const std::unique_ptr<GopCache> gop_cache_;
+  const std::unique_ptr<MemoryBudget> memory_budget_;
+  // Shared by all players, unless the player config names a pool.
+  FramePool frame_pool_;
+
+  mutable std::mutex mutex_;
+  std::string selected_;
+  // Ids in order of their last selection, most recent first.
+  std::deque<std::string> recent_;
+  int64_t target_latency_us_;
+  int64_t position_interval_us_;
+  std::map<std::string, std::unique_ptr<Entry>> players_;
+  // In tile order; empty outside mosaic mode.
+  std::vector<MosaicSlot> mosaic_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_MULTI_PLAYER_H_
@@ -0,0 +1,109 @@
+#include "preview_renderer.h"
+
+#include <chrono>
+#include <utility>
+
+#include "color_convert.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+PreviewRenderer::PreviewRenderer(FrameAvailable frame_available)
+    : frame_available_(std::move(frame_available)),
+      worker_(&PreviewRenderer::WorkLoop, this) {}
+
+PreviewRenderer::~PreviewRenderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+}
+
+void PreviewRenderer::Submit(const VideoFrame& frame) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Reuses the mailbox storage, so steady-state submits do not allocate.
+    pending_.Allocate(frame.width, frame.height);
+    pending_.data.assign(frame.data.begin(), frame.data.end());
+    pending_.pts_us = frame.pts_us;
+    pending_shared_.reset();
+    if (has_pending_) ++stats_.replaced;
+    has_pending_ = true;
+    ++stats_.submitted;
+  }
+  cv_.notify_one();
+}
+
+void PreviewRenderer::Submit(FramePtr frame) {
+  FramePtr replaced;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Returned to its pool outside the lock.
+    replaced = std::exchange(pending_shared_, std::move(frame));
+    if (has_pending_) ++stats_.replaced;
+    has_pending_ = true;
+    ++stats_.submitted;
+  }
+  cv_.notify_one();
+}
+
+const RgbaFrame* PreviewRenderer::Acquire() {
+  if (frames_.Update()) has_frame_ = true;
+  return has_frame_ ? &frames_.read_buffer() : nullptr;
+}
+
+PreviewStats PreviewRenderer::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PreviewRenderer::WorkLoop() {
+  VideoFrame copied;
+  FramePtr shared;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return has_pending_ || stopping_; });
+      if (stopping_) return;
+      shared = std::move(pending_shared_);
+      // Swapping keeps both buffers' capacity, so the next Submit() copies
+      // into memory that is already allocated.
+      if (!shared) std::swap(copied, pending_);
+      has_pending_ = false;
+    }
+    const VideoFrame& frame = shared ? *shared : copied;
+
+    const int64_t start_us = NowUs();
+    RgbaFrame& out = frames_.write_buffer();
+    out.width = frame.width;
+    out.height = frame.height;
+    out.capture_us = frame.pts_us;
+    out.pixels.resize(static_cast<size_t>(frame.width) * frame.height * 4);
+    I420ToRgba(frame.y(), frame.y_stride(), frame.u(), frame.v(),
+               frame.uv_stride(), frame.width, frame.height, out.pixels.data(),
+               frame.width * 4);
+    const int64_t converted_us = NowUs();
+    out.converted_us = converted_us;
+    frames_.Publish();
+    shared.reset();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats_.converted;
+      stats_.convert_us += converted_us - start_us;
+    }
+    if (frame_available_) frame_available_();
+  }
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,90 @@
+#ifndef IVS_BROADCASTER_PREVIEW_RENDERER_H_
+#define IVS_BROADCASTER_PREVIEW_RENDERER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.h"
+#include "triple_buffer.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+// A converted preview frame, ready to upload as a texture.
+struct RgbaFrame {
+  int width = 0;
+  int height = 0;
+  // Steady-clock time the source frame was captured.
+  int64_t capture_us = 0;
+  // Steady-clock time the conversion finished.
+  int64_t converted_us = 0;
+  std::vector<uint8_t> pixels;
+};
+
+struct PreviewStats {
+  uint64_t submitted = 0;
+  uint64_t converted = 0;
+  // Frames replaced by a newer one before the worker got to them.
+  uint64_t replaced = 0;
+  // Total conversion time.
+  int64_t convert_us = 0;
+};
+
+// Turns captured I420 frames into RGBA for a Flutter pixel-buffer texture.
+//
+// Submit() copies the frame, or takes a reference to a shared one, into a
+// mailbox and returns; a worker thread converts the newest frame with
+// I420ToRgba() and publishes it through a TripleBuffer. Acquire(), called
+// from the raster thread, never waits on the capture or conversion side.
+class PreviewRenderer {
+ public:
+  // Called on the worker after each published frame, e.g. to mark the
+  // texture frame available.
+  using FrameAvailable = std::function<void()>;
+
+  explicit PreviewRenderer(FrameAvailable frame_available);
+  ~PreviewRenderer();
+
+  PreviewRenderer(const PreviewRenderer&) = delete;
+  PreviewRenderer& operator=(const PreviewRenderer&) = delete;
+
+  // May be called from any thread. A frame the worker has not picked up yet
+  // is replaced. |frame.pts_us| is taken as the capture time.
+  void Submit(const VideoFrame& frame);
+  // Like Submit(), keeping a reference to |frame| instead of copying it,
+  // e.g. a player's frame from a FramePool. |frame| must not change while
+  // it is referenced.
+  void Submit(FramePtr frame);
+
+  // Consumer side, one thread only. Returns the newest converted frame, or
+  // nullptr before the first one. The frame stays valid until the next call.
+  const RgbaFrame* Acquire();
+
+  PreviewStats stats() const;
+
+ private:
+  void WorkLoop();
+
+  const FrameAvailable frame_available_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  VideoFrame pending_;
+  // Set instead of |pending_| by Submit(FramePtr).
+  FramePtr pending_shared_;
+  bool has_pending_ = false;
+  bool stopping_ = false;
+  PreviewStats stats_;
+
+  TripleBuffer<RgbaFrame> frames_;
+  bool has_frame_ = false;
+  std::thread worker_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_PREVIEW_RENDERER_H_
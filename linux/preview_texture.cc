@@ -0,0 +1,76 @@
+#include "preview_texture.h"
+
+struct _IvsPreviewTexture {
+  FlPixelBufferTexture parent_instance;
+
+  FlTextureRegistrar* registrar;
+  ivs_broadcaster::PreviewRenderer* renderer;
+};
+
+G_DEFINE_TYPE(IvsPreviewTexture, ivs_preview_texture,
+              fl_pixel_buffer_texture_get_type())
+
+// Runs on Flutter's raster thread.
+static gboolean ivs_preview_texture_copy_pixels(FlPixelBufferTexture* texture,
+                                                const uint8_t** out_buffer,
+                                                uint32_t* width,
+                                                uint32_t* height,
+                                                GError** error) {
+  // Shown until the first frame is converted.
+  static const uint8_t kBlack[4] = {0, 0, 0, 255};
+  IvsPreviewTexture* self = IVS_PREVIEW_TEXTURE(texture);
+  const ivs_broadcaster::RgbaFrame* frame =
+      self->renderer != nullptr ? self->renderer->Acquire() : nullptr;
+  if (frame == nullptr) {
+    *out_buffer = kBlack;
+    *width = 1;
+    *height = 1;
+    return TRUE;
+  }
+  *out_buffer = frame->pixels.data();
+  *width = static_cast<uint32_t>(frame->width);
+  *height = static_cast<uint32_t>(frame->height);
+  return TRUE;
+}
+
+static void ivs_preview_texture_dispose(GObject* object) {
+  IvsPreviewTexture* self = IVS_PREVIEW_TEXTURE(object);
+  // Joins the worker, so no frame-available call outlives the texture.
+  delete self->renderer;
+  self->renderer = nullptr;
+  g_clear_object(&self->registrar);
+  G_OBJECT_CLASS(ivs_preview_texture_parent_class)->dispose(object);
+}
+
+static void ivs_preview_texture_class_init(IvsPreviewTextureClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = ivs_preview_texture_dispose;
+  FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels =
+      ivs_preview_texture_copy_pixels;
+}
+
+static void ivs_preview_texture_init(IvsPreviewTexture* self) {}
+
+IvsPreviewTexture* ivs_preview_texture_new(FlTextureRegistrar* registrar) {
+  IvsPreviewTexture* self = IVS_PREVIEW_TEXTURE(
+      g_object_new(ivs_preview_texture_get_type(), nullptr));
+  self->registrar = FL_TEXTURE_REGISTRAR(g_object_ref(registrar));
+  // The registrar may be called from any thread, so the worker signals new
+  // frames directly instead of hopping to the platform thread.
+  self->renderer = new ivs_broadcaster::PreviewRenderer([self] {
+    fl_texture_registrar_mark_texture_frame_available(self->registrar,
+                                                      FL_TEXTURE(self));
+  });
+  fl_texture_registrar_register_texture(registrar, FL_TEXTURE(self));
+  return self;
+}
+
+void ivs_preview_texture_unregister(IvsPreviewTexture* self) {
+  // The renderer lives until the last reference goes, since the raster
+  // thread may still be copying from it.
+  fl_texture_registrar_unregister_texture(self->registrar, FL_TEXTURE(self));
+}
+
+ivs_broadcaster::PreviewRenderer* ivs_preview_texture_get_renderer(
+    IvsPreviewTexture* self) {
+  return self->renderer;
+}
@@ -0,0 +1,28 @@
+#ifndef IVS_BROADCASTER_PREVIEW_TEXTURE_H_
+#define IVS_BROADCASTER_PREVIEW_TEXTURE_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include "preview_renderer.h"
+
+G_BEGIN_DECLS
+
+// A Flutter pixel-buffer texture showing the frames of a PreviewRenderer.
+// Flutter's raster thread pulls the newest converted frame; it never waits
+// for capture or conversion.
+G_DECLARE_FINAL_TYPE(IvsPreviewTexture, ivs_preview_texture, IVS,
+                     PREVIEW_TEXTURE, FlPixelBufferTexture)
+
+// Creates the texture and registers it with |registrar|.
+IvsPreviewTexture* ivs_preview_texture_new(FlTextureRegistrar* registrar);
+
+// Unregisters the texture. Frames submitted afterwards are not shown.
+void ivs_preview_texture_unregister(IvsPreviewTexture* texture);
+
+// The renderer to submit frames to. Owned by the texture.
+ivs_broadcaster::PreviewRenderer* ivs_preview_texture_get_renderer(
+    IvsPreviewTexture* texture);
+
+G_END_DECLS
+
+#endif  // IVS_BROADCASTER_PREVIEW_TEXTURE_H_
@@ -0,0 +1,549 @@
+#include "segment_cache.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr char kMagic[] = {'I', 'V', 'S', 'G'};
+// Magic, 4 reserved bytes, size and digest.
+constexpr size_t kHeaderSize = 24;
+constexpr char kJournalName[] = "index.log";
+constexpr char kPackPrefix[] = "pack-";
+constexpr char kPackSuffix[] = ".dat";
+
+// Ages count across restarts, so they are on the wall clock.
+int64_t WallUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t Rotate(uint64_t value, int bits) {
+  return value << bits | value >> (64 - bits);
+}
+
+uint64_t Avalanche(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  return hash ^ hash >> 33;
+}
+
+// A 64-bit digest of |data|, eight bytes at a time on four independent
+// lanes so that hashing a segment keeps up with writing it. Collisions
+// cost nothing but a comparison: bytes are compared before being shared.
+uint64_t Digest(const uint8_t* data, size_t size) {
+  constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+  constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+  uint64_t lanes[4] = {kPrime1, kPrime2, ~kPrime1, ~kPrime2};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int lane = 0; lane < 4; ++lane) {
+      uint64_t word;
+      std::memcpy(&word, data + i + lane * 8, 8);
+      lanes[lane] = Rotate(lanes[lane] + word * kPrime2, 31) * kPrime1;
+    }
+  }
+  uint64_t hash = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) +
+                  Rotate(lanes[2], 12) + Rotate(lanes[3], 18);
+  for (; i < size; ++i) hash = Rotate(hash ^ data[i] * kPrime1, 11) * kPrime2;
+  return Avalanche(hash ^ size);
+}
+
+bool WriteAll(int fd, const uint8_t* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// The number of a pack file's name, or -1 for other files.
+int PackNumber(const std::string& name) {
+  const size_t prefix = sizeof(kPackPrefix) - 1;
+  const size_t suffix = sizeof(kPackSuffix) - 1;
+  if (name.size() <= prefix + suffix ||
+      name.compare(0, prefix, kPackPrefix) != 0 ||
+      name.compare(name.size() - suffix, suffix, kPackSuffix) != 0) {
+    return -1;
+  }
+  const std::string digits = name.substr(prefix, name.size() - prefix - suffix);
+  if (digits.find_first_not_of("0123456789") != std::string::npos ||
+      digits.size() > 9) {
+    return -1;
+  }
+  return std::atoi(digits.c_str());
+}
+
+}  // namespace
+
+struct SegmentCache::Mapping {
+  Mapping(void* base, size_t size) : base(base), size(size) {}
+  ~Mapping() { munmap(base, size); }
+
+  void* const base;
+  const size_t size;
+};
+
+std::string SegmentCacheKey(const std::string& url, int64_t offset,
+                            int64_t length) {
+  if (offset == 0 && length < 0) return url;
+  return url + "@" + std::to_string(offset) + "+" + std::to_string(length);
+}
+
+std::string DefaultSegmentCacheDir() {
+  std::filesystem::path base;
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    base = xdg;
+  } else if (const char* home = std::getenv("HOME"); home && *home) {
+    base = std::filesystem::path(home) / ".cache";
+  } else {
+    base = std::filesystem::temp_directory_path();
+  }
+  return (base / "ivs_broadcaster" / "segments").string();
+}
+
+std::unique_ptr<SegmentCache> SegmentCache::Open(
+    const SegmentCacheConfig& config, std::string* error) {
+  std::error_code create_error;
+  std::filesystem::create_directories(config.directory, create_error);
+  if (create_error) {
+    *error = "cannot create " + config.directory;
+    return nullptr;
+  }
+  const std::string lock_path = config.directory + "/lock";
+  const int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    *error = "cannot open " + lock_path;
+    return nullptr;
+  }
+  // Two writers would append to the same packs.
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    close(fd);
+    *error = config.directory + " is in use";
+    return nullptr;
+  }
+  std::unique_ptr<SegmentCache> cache(new SegmentCache(config, fd));
+  std::lock_guard<std::mutex> lock(cache->mutex_);
+  if (!cache->Load(error)) return nullptr;
+  return cache;
+}
+
+SegmentCache::SegmentCache(const SegmentCacheConfig& config, int lock_fd)
+    : config_(config), lock_fd_(lock_fd) {}
+
+SegmentCache::~SegmentCache() {
+  if (open_fd_ >= 0) close(open_fd_);
+  if (journal_ != nullptr) std::fclose(journal_);
+  close(lock_fd_);
+}
+
+bool SegmentCache::Load(std::string* error) {
+  std::error_code list_error;
+  for (const auto& file :
+       std::filesystem::directory_iterator(config_.directory, list_error)) {
+    const int number = PackNumber(file.path().filename().string());
+    if (number < 0) continue;
+    std::error_code size_error;
+    const uintmax_t size = std::filesystem::file_size(file.path(), size_error);
+    if (size_error) continue;
+    Pack& pack = packs_[number];
+    pack.path = file.path().string();
+    pack.size = static_cast<size_t>(size);
+    stats_.bytes += pack.size;
+    next_pack_ = std::max(next_pack_, number + 1);
+  }
+  if (list_error) {
+    *error = "cannot list " + config_.directory;
+    return false;
+  }
+
+  // Replay the journal; a line cut short by a crash is skipped.
+  std::unordered_map<std::string, Entry> replayed;
+  std::ifstream in(config_.directory + "/" + kJournalName);
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string op;
+    fields >> op;
+    Entry entry;
+    if (op == "put") {
+      fields >> entry.used_us >> entry.location.pack >>
+          entry.location.offset >> entry.location.size >> std::hex >>
+          entry.digest >> std::dec;
+      std::getline(fields >> std::ws, entry.key);
+      if (fields && !entry.key.empty()) {
+        next_pack_ = std::max(next_pack_, entry.location.pack + 1);
+        replayed[entry.key] = entry;
+      }
+    } else if (op == "use") {
+      fields >> entry.used_us;
+      std::getline(fields >> std::ws, entry.key);
+      auto it = replayed.find(entry.key);
+      if (it != replayed.end()) it->second.used_us = entry.used_us;
+    } else if (op == "del") {
+      std::getline(fields >> std::ws, entry.key);
+      replayed.erase(entry.key);
+    }
+  }
+
+  std::vector<Entry> valid;
+  valid.reserve(replayed.size());
+  for (auto& item : replayed) {
+    if (!item.second.key.empty() && ValidLocked(item.second)) {
+      valid.push_back(std::move(item.second));
+    }
+  }
+  std::sort(valid.begin(), valid.end(), [](const Entry& a, const Entry& b) {
+    return a.used_us > b.used_us;
+  });
+  for (Entry& entry : valid) {
+    const BlobId id(entry.location.pack, entry.location.offset);
+    if (blobs_.count(id) == 0) AddBlobLocked(entry.digest, entry.location);
+    ++blobs_[id].refs;
+    entries_.push_back(std::move(entry));
+    index_[entries_.back().key] = std::prev(entries_.end());
+  }
+  // Packs whose records never made it into the journal.
+  std::vector<int> orphans;
+  for (const auto& pack : packs_) {
+    if (pack.second.blobs == 0) orphans.push_back(pack.first);
+  }
+  for (int pack : orphans) DeletePackLocked(pack);
+
+  if (!CompactJournalLocked()) {
+    *error = "cannot write the index in " + config_.directory;
+    return false;
+  }
+  EvictLocked(WallUs());
+  return true;
+}
+
+bool SegmentCache::ValidLocked(const Entry& entry) {
+  const Location& location = entry.location;
+  if (packs_.count(location.pack) == 0 || location.offset < kHeaderSize ||
+      location.size == 0) {
+    return false;
+  }
+  CachedSegment record;
+  if (!MapLocked({location.pack, location.offset - kHeaderSize,
+                  kHeaderSize + location.size},
+                 &record)) {
+    return false;
+  }
+  uint64_t size = 0;
+  uint64_t digest = 0;
+  std::memcpy(&size, record.data + 8, 8);
+  std::memcpy(&digest, record.data + 16, 8);
+  return std::memcmp(record.data, kMagic, sizeof(kMagic)) == 0 &&
+         size == location.size && digest == entry.digest;
+}
+
+bool SegmentCache::MapLocked(const Location& location,
+                             CachedSegment* segment) {
+  auto it = packs_.find(location.pack);
+  if (it == packs_.end()) return false;
+  Pack& pack = it->second;
+  const size_t end = location.offset + location.size;
+  if (end > pack.size) return false;
+  if (!pack.mapping || pack.mapping->size < end) {
+    // Appends since the last mapping are not in it; map the whole pack
+    // again. Readers of the old mapping keep it alive.
+    const int fd = open(pack.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    void* base = mmap(nullptr, pack.size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+    pack.mapping = std::make_shared<const Mapping>(base, pack.size);
+  }
+  segment->data =
+      static_cast<const uint8_t*>(pack.mapping->base) + location.offset;
+  segment->size = location.size;
+  segment->mapping = pack.mapping;
+  return true;
+}
+
+bool SegmentCache::AppendLocked(uint64_t digest, const uint8_t* data,
+                                size_t size, Location* location) {
+  if (open_fd_ >= 0 && packs_[open_pack_].size >= config_.pack_bytes) {
+    close(open_fd_);
+    open_fd_ = -1;
+    open_pack_ = -1;
+  }
+  if (open_fd_ < 0) {
+    const int number = next_pack_++;
+    const std::string path = config_.directory + "/" + kPackPrefix +
+                             std::to_string(number) + kPackSuffix;
+    open_fd_ =
+        open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (open_fd_ < 0) return false;
+    open_pack_ = number;
+    packs_[number].path = path;
+  }
+  Pack& pack = packs_[open_pack_];
+  uint8_t header[kHeaderSize] = {};
+  const uint64_t size64 = size;
+  std::memcpy(header, kMagic, sizeof(kMagic));
+  std::memcpy(header + 8, &size64, 8);
+  std::memcpy(header + 16, &digest, 8);
+  if (!WriteAll(open_fd_, header, kHeaderSize) ||
+      !WriteAll(open_fd_, data, size)) {
+    // Cut the partial record off, so the next one lands where expected.
+    if (ftruncate(open_fd_, static_cast<off_t>(pack.size)) != 0 ||
+        lseek(open_fd_, 0, SEEK_END) < 0) {
+      close(open_fd_);
+      open_fd_ = -1;
+      open_pack_ = -1;
+    }
+    return false;
+  }
+  *location = {open_pack_, pack.size + kHeaderSize, size};
+  pack.size += kHeaderSize + size;
+  stats_.bytes += kHeaderSize + size;
+  AddBlobLocked(digest, *location);
+  return true;
+}
+
+void SegmentCache::AddBlobLocked(uint64_t digest, const Location& location) {
+  const BlobId id(location.pack, location.offset);
+  Blob& blob = blobs_[id];
+  blob.digest = digest;
+  blob.size = location.size;
+  digests_.emplace(digest, id);
+  ++packs_[location.pack].blobs;
+  stats_.live_bytes += location.size;
+}
+
+void SegmentCache::UseLocked(EntryList::iterator entry, int64_t now_us) {
+  entries_.splice(entries_.begin(), entries_, entry);
+  entry->used_us = now_us;
+  JournalLocked("use " + std::to_string(now_us) + " " + entry->key);
+}
+
+void SegmentCache::DropLocked(EntryList::iterator entry) {
+  const Location location = entry->location;
+  index_.erase(entry->key);
+  entries_.erase(entry);
+  auto blob = blobs_.find(BlobId(location.pack, location.offset));
+  if (blob == blobs_.end() || --blob->second.refs > 0) return;
+  auto range = digests_.equal_range(blob->second.digest);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == blob->first) {
+      digests_.erase(it);
+      break;
+    }
+  }
+  stats_.live_bytes -= blob->second.size;
+  blobs_.erase(blob);
+  if (--packs_[location.pack].blobs == 0) DeletePackLocked(location.pack);
+}
+
+void SegmentCache::EvictPackLocked(int pack) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->location.pack != pack) {
+      ++it;
+      continue;
+    }
+    index_.erase(it->key);
+    it = entries_.erase(it);
+    ++stats_.evictions;
+  }
+  auto blob = blobs_.lower_bound(BlobId(pack, 0));
+  while (blob != blobs_.end() && blob->first.first == pack) {
+    auto range = digests_.equal_range(blob->second.digest);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == blob->first) {
+        digests_.erase(it);
+        break;
+      }
+    }
+    stats_.live_bytes -= blob->second.size;
+    blob = blobs_.erase(blob);
+  }
+  // Its entries are not journalled as dropped: on the next opening the
+  // missing pack invalidates them.
+  DeletePackLocked(pack);
+}
+
+void SegmentCache::DeletePackLocked(int pack) {
+  auto it = packs_.find(pack);
+  if (it == packs_.end()) return;
+  if (pack == open_pack_) {
+    close(open_fd_);
+    open_fd_ = -1;
+    open_pack_ = -1;
+  }
+  // Mappings still held keep the bytes readable.
+  unlink(it->second.path.c_str());
+  stats_.bytes -= it->second.size;
+  packs_.erase(it);
+}
+
+void SegmentCache::EvictLocked(int64_t now_us) {
+  if (config_.max_age_us > 0) {
+    while (!entries_.empty() &&
+           now_us - entries_.back().used_us > config_.max_age_us) {
+      const std::string key = entries_.back().key;
+      DropLocked(std::prev(entries_.end()));
+      JournalLocked("del " + key);
+      ++stats_.evictions;
+    }
+  }
+  while (config_.max_bytes > 0 && stats_.bytes > config_.max_bytes &&
+         !packs_.empty()) {
+    // The pack whose most recent use is the oldest.
+    std::map<int, int64_t> last_used;
+    for (const auto& pack : packs_) last_used[pack.first] = INT64_MIN;
+    for (const Entry& entry : entries_) {
+      int64_t& used_us = last_used[entry.location.pack];
+      used_us = std::max(used_us, entry.used_us);
+    }
+    auto victim = std::min_element(
+        last_used.begin(), last_used.end(),
+        [](const auto& a, const auto& b) { return a.second < b.second; });
+    EvictPackLocked(victim->first);
+  }
+}
+
+void SegmentCache::JournalLocked(const std::string& line) {
+  if (journal_ == nullptr) return;
+  std::fputs(line.c_str(), journal_);
+  std::fputc('\n', journal_);
+  std::fflush(journal_);
+  if (++journal_lines_ > 2 * entries_.size() + 1024) CompactJournalLocked();
+}
+
+bool SegmentCache::CompactJournalLocked() {
+  if (journal_ != nullptr) {
+    std::fclose(journal_);
+    journal_ = nullptr;
+  }
+  const std::string path = config_.directory + "/" + kJournalName;
+  const std::string temp = path + ".tmp";
+  std::FILE* out = std::fopen(temp.c_str(), "w");
+  if (out == nullptr) return false;
+  // Oldest first, so a replay ends on the most recent uses.
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+    std::fprintf(out, "put %" PRId64 " %d %zu %zu %016" PRIx64 " %s\n",
+                 it->used_us, it->location.pack, it->location.offset,
+                 it->location.size, it->digest, it->key.c_str());
+  }
+  const bool written = std::fflush(out) == 0 && !std::ferror(out);
+  std::fclose(out);
+  if (!written || std::rename(temp.c_str(), path.c_str()) != 0) return false;
+  journal_ = std::fopen(path.c_str(), "a");
+  journal_lines_ = entries_.size();
+  return journal_ != nullptr;
+}
+
+bool SegmentCache::Get(const std::string& key, CachedSegment* segment) {
+  const int64_t now_us = WallUs();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return false;
+  }
+  const EntryList::iterator entry = it->second;
+  if ((config_.max_age_us > 0 &&
+       now_us - entry->used_us > config_.max_age_us) ||
+      !MapLocked(entry->location, segment)) {
+    DropLocked(entry);
+    JournalLocked("del " + key);
+    ++stats_.evictions;
+    ++stats_.misses;
+    return false;
+  }
+  UseLocked(entry, now_us);
+  ++stats_.hits;
+  return true;
+}
+
+bool SegmentCache::Touch(const std::string& key) {
+  const int64_t now_us = WallUs();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) return false;
+  if (config_.max_age_us > 0 &&
+      now_us - it->second->used_us > config_.max_age_us) {
+    DropLocked(it->second);
+    JournalLocked("del " + key);
+    ++stats_.evictions;
+    return false;
+  }
+  UseLocked(it->second, now_us);
+  return true;
+}
+
+bool SegmentCache::Put(const std::string& key, const uint8_t* data,
+                       size_t size) {
+  // The journal is line based.
+  if (size == 0 || key.empty() || key.find('\n') != std::string::npos) {
+    return false;
+  }
+  const uint64_t digest = Digest(data, size);
+  const int64_t now_us = WallUs();
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.puts;
+  Location location;
+  bool stored = false;
+  auto range = digests_.equal_range(digest);
+  for (auto it = range.first; it != range.second && !stored; ++it) {
+    if (blobs_[it->second].size != size) continue;
+    const Location candidate{it->second.first, it->second.second, size};
+    CachedSegment existing;
+    if (MapLocked(candidate, &existing) &&
+        std::memcmp(existing.data, data, size) == 0) {
+      location = candidate;
+      stored = true;
+      ++stats_.deduplicated;
+    }
+  }
+  if (!stored && !AppendLocked(digest, data, size, &location)) return false;
+  // Referenced before the old entry goes, which may share the blob.
+  ++blobs_[BlobId(location.pack, location.offset)].refs;
+  auto old = index_.find(key);
+  if (old != index_.end()) DropLocked(old->second);
+  entries_.push_front({key, digest, location, now_us});
+  index_[key] = entries_.begin();
+  char fields[96];
+  std::snprintf(fields, sizeof(fields),
+                "put %" PRId64 " %d %zu %zu %016" PRIx64 " ", now_us,
+                location.pack, location.offset, location.size, digest);
+  JournalLocked(fields + key);
+  EvictLocked(now_us);
+  return true;
+}
+
+SegmentCacheStats SegmentCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SegmentCacheStats stats = stats_;
+  stats.entries = entries_.size();
+  stats.packs = static_cast<int>(packs_.size());
+  return stats;
+}
+
+}  // namespace ivs_broadcaster
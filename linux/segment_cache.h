@@ -0,0 +1,172 @@
+#ifndef IVS_BROADCASTER_SEGMENT_CACHE_H_
+#define IVS_BROADCASTER_SEGMENT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+struct SegmentCacheConfig {
+  // Holds the pack files and the index. Created if missing.
+  std::string directory;
+  // For the pack files on disk, including the bytes of dropped entries
+  // that their pack still holds.
+  size_t max_bytes = size_t{1} << 30;
+  // Entries not used for this long are dropped; 0 keeps them until they
+  // are evicted for space. Wall-clock time, so it counts across restarts.
+  int64_t max_age_us = int64_t{7} * 24 * 3600 * 1000000;
+  // A pack is sealed, and the next segment starts a new one, once it is
+  // this large. Space is given back a whole pack at a time.
+  size_t pack_bytes = 64 << 20;
+};
+
+struct SegmentCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t puts = 0;
+  // Puts whose bytes were already stored under another key.
+  uint64_t deduplicated = 0;
+  // Entries dropped for space or age.
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  int packs = 0;
+  // The pack files on disk, and the part of them entries still use.
+  size_t bytes = 0;
+  size_t live_bytes = 0;
+};
+
+// A segment read back from the cache: the bytes stay mapped, and valid,
+// while the segment is held, even if the cache drops its entry meanwhile.
+struct CachedSegment {
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  std::shared_ptr<const void> mapping;
+};
+
+// The key a resource is cached under: its URL, and the byte range when
+// only part of it is meant.
+std::string SegmentCacheKey(const std::string& url, int64_t offset,
+                            int64_t length);
+
+// A content-addressed cache of media segments on disk, kept across runs.
+//
+// Segments are appended to large pack files and read back through mmap,
+// so a hit costs no read() copies and no allocation. Each key names the
+// digest of its bytes, and identical bytes under several keys, e.g. one
+// segment listed by two playlists, are stored once. The index is a
+// journal of puts and uses, replayed and compacted on opening; entries
+// whose bytes did not all reach their pack are dropped then. Entries
+// unused for max_age_us are dropped, and while the packs exceed
+// max_bytes the pack used least recently is deleted with its entries.
+// Thread-safe; a directory is used by one process at a time.
+class SegmentCache {
+ public:
+  // Returns null, with |error| set, when |config.directory| cannot be
+  // used, e.g. while another process has it open.
+  static std::unique_ptr<SegmentCache> Open(const SegmentCacheConfig& config,
+                                            std::string* error);
+  ~SegmentCache();
+
+  SegmentCache(const SegmentCache&) = delete;
+  SegmentCache& operator=(const SegmentCache&) = delete;
+
+  // Maps the bytes stored under |key| and marks it used. Returns false on
+  // a miss.
+  bool Get(const std::string& key, CachedSegment* segment);
+  // Marks |key| used, as Get() would, without mapping it. Returns false if
+  // it is not cached.
+  bool Touch(const std::string& key);
+  // Stores |size| bytes under |key|, replacing what it named, then
+  // evicts until the cache fits. Returns false if they could not be
+  // written; the cache carries on without them.
+  bool Put(const std::string& key, const uint8_t* data, size_t size);
+
+  SegmentCacheStats stats() const;
+
+ private:
+  struct Mapping;
+  struct Pack {
+    std::string path;
+    size_t size = 0;
+    // Stored segments some entry still names.
+    int blobs = 0;
+    // Mapped on the first read, and again once appends outgrow it.
+    std::shared_ptr<const Mapping> mapping;
+  };
+  struct Location {
+    int pack = 0;
+    // Of the bytes, after their record header.
+    size_t offset = 0;
+    size_t size = 0;
+  };
+  // Stored bytes, shared by the entries whose content they are.
+  struct Blob {
+    uint64_t digest = 0;
+    size_t size = 0;
+    int refs = 0;
+  };
+  using BlobId = std::pair<int, size_t>;
+  struct Entry {
+    std::string key;
+    uint64_t digest = 0;
+    Location location;
+    int64_t used_us = 0;
+  };
+  using EntryList = std::list<Entry>;
+
+  SegmentCache(const SegmentCacheConfig& config, int lock_fd);
+
+  bool Load(std::string* error);
+  // Whether the record before |entry|'s bytes is whole and of its digest.
+  bool ValidLocked(const Entry& entry);
+  // Maps the bytes at |location|, remapping the pack if it grew.
+  bool MapLocked(const Location& location, CachedSegment* segment);
+  // Appends a record of |data| to the open pack as a blob without refs.
+  bool AppendLocked(uint64_t digest, const uint8_t* data, size_t size,
+                    Location* location);
+  void AddBlobLocked(uint64_t digest, const Location& location);
+  void UseLocked(EntryList::iterator entry, int64_t now_us);
+  // Drops |entry|, and its pack once no entry names anything in it.
+  void DropLocked(EntryList::iterator entry);
+  // Drops every entry in |pack| and deletes it.
+  void EvictPackLocked(int pack);
+  void DeletePackLocked(int pack);
+  void EvictLocked(int64_t now_us);
+  // Appends |line| to the journal, compacting it once it is mostly uses.
+  void JournalLocked(const std::string& line);
+  bool CompactJournalLocked();
+
+  const SegmentCacheConfig config_;
+  const int lock_fd_;
+
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+  std::map<BlobId, Blob> blobs_;
+  // Blobs by digest; different bytes with the same digest are kept apart.
+  std::unordered_multimap<uint64_t, BlobId> digests_;
+  std::map<int, Pack> packs_;
+  // Appended to; -1 until the next put opens one.
+  int open_pack_ = -1;
+  int open_fd_ = -1;
+  int next_pack_ = 0;
+  std::FILE* journal_ = nullptr;
+  size_t journal_lines_ = 0;
+  SegmentCacheStats stats_;
+};
+
+// $XDG_CACHE_HOME/ivs_broadcaster/segments, or the same under ~/.cache.
+std::string DefaultSegmentCacheDir();
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_SEGMENT_CACHE_H_
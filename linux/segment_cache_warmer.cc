@@ -0,0 +1,177 @@
+#include "segment_cache_warmer.h"
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "hls_playlist.h"
+#include "http_client.h"
+#include "segment_cache.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+bool LoadText(HttpClient* client, const std::string& url, std::string* text,
+              std::string* error) {
+  HttpResponse response;
+  const bool ok = client->Get(
+      url, 0, -1,
+      [text](const uint8_t* data, size_t size, const HttpResponse&) {
+        text->append(reinterpret_cast<const char*>(data), size);
+        return true;
+      },
+      &response);
+  if (!ok) *error = "cannot load " + url + ": " + response.error;
+  return ok;
+}
+
+}  // namespace
+
+SegmentCacheWarmer::SegmentCacheWarmer(SegmentCache* cache)
+    : cache_(cache), worker_(&SegmentCacheWarmer::WorkerLoop, this) {}
+
+SegmentCacheWarmer::~SegmentCacheWarmer() {
+  std::deque<Job> abandoned;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    abandoned.swap(queue_);
+  }
+  wake_.notify_all();
+  worker_.join();
+  CacheWarmResult result;
+  result.error = "cache warmer stopped";
+  for (const Job& job : abandoned) job.callback(result);
+}
+
+bool SegmentCacheWarmer::stopping() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_;
+}
+
+void SegmentCacheWarmer::Warm(const std::string& url,
+                              const CacheWarmConfig& config,
+                              Callback callback) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopping_) {
+      queue_.push_back(Job{url, config, std::move(callback)});
+      wake_.notify_one();
+      return;
+    }
+  }
+  CacheWarmResult result;
+  result.error = "cache warmer stopped";
+  callback(result);
+}
+
+void SegmentCacheWarmer::WorkerLoop() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    job.callback(Produce(job));
+  }
+}
+
+CacheWarmResult SegmentCacheWarmer::Produce(const Job& job) {
+  CacheWarmResult result;
+  HttpClient client;
+  client.set_cancel_check([this] { return stopping(); });
+  std::string text;
+  if (!LoadText(&client, job.url, &text, &result.error)) return result;
+  std::string media_url = job.url;
+  if (text.find("#EXT-X-STREAM-INF") != std::string::npos) {
+    std::vector<HlsVariant> variants;
+    if (!ParseHlsMasterPlaylist(text, &variants, &result.error)) {
+      return result;
+    }
+    const HlsVariant* variant =
+        ChooseHlsVariant(variants, job.config.max_bandwidth);
+    if (variant == nullptr) {
+      result.error = "no variants in " + job.url;
+      return result;
+    }
+    media_url = ResolveHlsUrl(job.url, variant->uri);
+    text.clear();
+    if (!LoadText(&client, media_url, &text, &result.error)) return result;
+  }
+  HlsMediaPlaylist playlist;
+  HlsUpdateStats stats;
+  if (!ParseHlsPlaylist(text, &playlist, &stats, &result.error)) {
+    return result;
+  }
+  if (!playlist.end_list) {
+    result.error = media_url + " is live; only VODs are cached";
+    return result;
+  }
+
+  // What the player will load, in its order: each segment, after its
+  // initialisation section where that changes.
+  std::vector<SegmentRequest> requests;
+  std::vector<std::string> keys;
+  auto add = [&](const std::string& uri, const HlsByteRange& range) {
+    ++result.segments;
+    const std::string url = ResolveHlsUrl(media_url, uri);
+    std::string key = SegmentCacheKey(url, range.offset, range.length);
+    if (cache_->Touch(key)) {
+      ++result.cached;
+      return;
+    }
+    SegmentRequest request;
+    request.sequence = static_cast<int64_t>(requests.size());
+    request.url = url;
+    request.offset = range.offset;
+    request.length = range.length;
+    requests.push_back(std::move(request));
+    keys.push_back(std::move(key));
+  };
+  std::string map_added;
+  int64_t listed_us = 0;
+  for (const HlsSegment& segment : playlist.segments) {
+    if (job.config.duration_us > 0 && listed_us >= job.config.duration_us) {
+      break;
+    }
+    listed_us += segment.duration_us;
+    if (segment.gap) continue;
+    if (segment.map != nullptr) {
+      const HlsMap& map = *segment.map;
+      const std::string map_key =
+          SegmentCacheKey(map.uri, map.byte_range.offset,
+                          map.byte_range.length);
+      if (map_key != map_added) {
+        add(map.uri, map.byte_range);
+        map_added = map_key;
+      }
+    }
+    add(segment.uri, segment.byte_range);
+  }
+
+  SegmentPrefetcher prefetcher(job.config.prefetch);
+  for (const SegmentRequest& request : requests) prefetcher.Enqueue(request);
+  for (size_t i = 0; i < requests.size();) {
+    if (stopping()) {
+      result.error = "cache warmer stopped";
+      return result;
+    }
+    PrefetchedSegment segment;
+    if (!prefetcher.Take(100000, &segment)) continue;
+    if (!segment.ok) {
+      result.error = "cannot load " + requests[i].url + ": " + segment.error;
+      return result;
+    }
+    cache_->Put(keys[i], segment.data.data(), segment.data.size());
+    result.bytes += static_cast<int64_t>(segment.data.size());
+    ++i;
+  }
+  result.ok = true;
+  return result;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,84 @@
+#ifndef IVS_BROADCASTER_SEGMENT_CACHE_WARMER_H_
+#define IVS_BROADCASTER_SEGMENT_CACHE_WARMER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "segment_prefetcher.h"
+
+namespace ivs_broadcaster {
+
+class SegmentCache;
+
+struct CacheWarmConfig {
+  // The variant of a master playlist to warm, chosen as LlHlsConfig's
+  // |max_bandwidth| chooses it; 0 takes the highest listed.
+  int64_t max_bandwidth = 0;
+  // Warms the first |duration_us| of the stream; 0 warms all of it.
+  int64_t duration_us = 0;
+  PrefetchConfig prefetch;
+};
+
+struct CacheWarmResult {
+  bool ok = false;
+  std::string error;
+  // Segments and initialisation sections warmed, how many of them were
+  // cached already, and the bytes loaded for the rest.
+  int segments = 0;
+  int cached = 0;
+  int64_t bytes = 0;
+};
+
+// Loads the segments of VOD playlists into a SegmentCache ahead of
+// playback, e.g. for highlights a viewer is likely to open, so that
+// playing them loads nothing but their playlists.
+//
+// One playlist is warmed at a time, on a worker. Segments already cached
+// are only marked used; the rest are fetched several at a time by a
+// SegmentPrefetcher, whose memory budget bounds what waits to be written.
+// They are stored under the keys LlHlsLoader looks up.
+class SegmentCacheWarmer {
+ public:
+  // Called once per request, on the worker thread.
+  using Callback = std::function<void(const CacheWarmResult&)>;
+
+  // |cache| outlives the warmer.
+  explicit SegmentCacheWarmer(SegmentCache* cache);
+  // Stops the warm in progress within a segment; it and queued ones are
+  // answered with an error.
+  ~SegmentCacheWarmer();
+
+  SegmentCacheWarmer(const SegmentCacheWarmer&) = delete;
+  SegmentCacheWarmer& operator=(const SegmentCacheWarmer&) = delete;
+
+  void Warm(const std::string& url, const CacheWarmConfig& config,
+            Callback callback);
+
+ private:
+  struct Job {
+    std::string url;
+    CacheWarmConfig config;
+    Callback callback;
+  };
+
+  void WorkerLoop();
+  CacheWarmResult Produce(const Job& job);
+  bool stopping() const;
+
+  SegmentCache* const cache_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::deque<Job> queue_;
+  std::thread worker_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_SEGMENT_CACHE_WARMER_H_
@@ -0,0 +1,414 @@
+#include "segment_prefetcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "http_client.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+PrefetchConcurrency::PrefetchConcurrency(int min_limit, int max_limit)
+    : min_limit_(std::max(1, min_limit)),
+      max_limit_(std::max(min_limit_, max_limit)),
+      limit_(min_limit_),
+      rate_at_(max_limit_ + 1, 0.0) {}
+
+void PrefetchConcurrency::OnRequestDone(int64_t bytes, int64_t first_byte_us,
+                                        int64_t elapsed_us, int64_t now_us) {
+  constexpr double kGain = 0.25;
+  const double first_byte =
+      static_cast<double>(std::max<int64_t>(first_byte_us, 0));
+  const double transfer =
+      static_cast<double>(std::max<int64_t>(elapsed_us - first_byte_us, 1));
+  rtt_us_ =
+      rtt_us_ == 0 ? first_byte : rtt_us_ + kGain * (first_byte - rtt_us_);
+  transfer_us_ = transfer_us_ == 0
+                     ? transfer
+                     : transfer_us_ + kGain * (transfer - transfer_us_);
+
+  if (window_start_us_ < 0) window_start_us_ = now_us - elapsed_us;
+  window_bytes_ += bytes;
+  ++window_requests_;
+  // Let every slot finish twice so the window sees the limit at work.
+  if (window_requests_ >= 2 * limit_ && now_us > window_start_us_) {
+    CloseWindow(now_us);
+  }
+}
+
+void PrefetchConcurrency::CloseWindow(int64_t now_us) {
+  const double rate = window_bytes_ * 1e6 / (now_us - window_start_us_);
+  window_start_us_ = now_us;
+  window_bytes_ = 0;
+  window_requests_ = 0;
+
+  // A sharp drop means the network changed under us; what was measured at
+  // other limits no longer applies.
+  if (throughput_ > 0 && rate < 0.5 * throughput_) {
+    std::fill(rate_at_.begin(), rate_at_.end(), 0.0);
+  }
+  throughput_ = throughput_ == 0 ? rate : 0.7 * throughput_ + 0.3 * rate;
+  // Requests started under the previous limit are still finishing in the
+  // first window after a change; it does not measure the new limit.
+  if (settling_) {
+    settling_ = false;
+    return;
+  }
+  double& here = rate_at_[limit_];
+  here = here == 0 ? rate : 0.5 * (here + rate);
+  const double below = rate_at_[limit_ - 1];
+
+  const int previous = limit_;
+  if (hold_windows_ > 0) {
+    --hold_windows_;
+  } else if (limit_ < max_limit_ && (below == 0 || here > 1.1 * below)) {
+    ++limit_;
+  } else if (limit_ > min_limit_ && below > 0 && here < 1.05 * below) {
+    --limit_;
+    hold_windows_ = 4;
+  }
+  const int latency_floor =
+      1 + static_cast<int>(std::ceil(rtt_us_ / std::max(transfer_us_, 1.0)));
+  limit_ = std::min(max_limit_, std::max(limit_, latency_floor));
+  settling_ = limit_ != previous;
+}
+
+struct SegmentPrefetcher::Segment {
+  SegmentRequest request;
+  std::vector<uint8_t> data;
+  // Total bytes, once known.
+  int64_t size = -1;
+  // First byte not yet handed to a request.
+  int64_t next_offset = 0;
+  int64_t received = 0;
+  int active = 0;
+  bool started = false;
+  // The first request is out and will tell us the size.
+  bool probing = false;
+  size_t reserved = 0;
+  // Ranges whose request failed, to fetch again.
+  std::vector<std::pair<int64_t, int64_t>> retry;
+  int failures = 0;
+  bool failed = false;
+  std::string error;
+  int64_t start_us = 0;
+  int64_t done_us = 0;
+
+  bool done() const {
+    if (failed) return active == 0;
+    return size >= 0 && received >= size && active == 0 && retry.empty();
+  }
+};
+
+SegmentPrefetcher::SegmentPrefetcher(const PrefetchConfig& config)
+    : config_(config),
+      concurrency_(config.min_concurrency, config.max_concurrency) {
+  const int threads = std::max(1, std::max(config.min_concurrency,
+                                           config.max_concurrency));
+  for (int i = 0; i < threads; ++i) {
+    workers_.emplace_back(&SegmentPrefetcher::WorkerLoop, this);
+  }
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    ++generation_;
+  }
+  work_cv_.notify_all();
+  ready_cv_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+}
+
+void SegmentPrefetcher::Enqueue(const SegmentRequest& request) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto segment = std::make_shared<Segment>();
+    segment->request = request;
+    segment->size = request.length;
+    queue_.push_back(std::move(segment));
+    if (first_enqueue_us_ < 0) first_enqueue_us_ = NowUs();
+  }
+  work_cv_.notify_all();
+}
+
+bool SegmentPrefetcher::Take(int64_t timeout_us, PrefetchedSegment* segment) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (queue_.empty()) return false;
+  const uint64_t generation = generation_;
+  const std::shared_ptr<Segment> front = queue_.front();
+  const bool was_ready = front->done();
+  const int64_t start_us = NowUs();
+  const bool ready = ready_cv_.wait_for(
+      lock, std::chrono::microseconds(timeout_us), [&] {
+        return stopping_ || generation_ != generation || front->done();
+      });
+  if (stopping_ || generation_ != generation) return false;
+  if (!was_ready && started_us_ >= 0) {
+    // Playback is waiting for data. A stall that spans several calls is
+    // counted once.
+    stats_.stall_us += NowUs() - start_us;
+    if (!stalled_) ++stats_.stalls;
+    stalled_ = !ready;
+  } else {
+    stalled_ = false;
+  }
+  if (!ready) return false;
+  queue_.pop_front();
+  reserved_bytes_ -= front->reserved;
+  if (started_us_ < 0) {
+    started_us_ = NowUs();
+    stats_.startup_us = started_us_ - first_enqueue_us_;
+  }
+
+  segment->sequence = front->request.sequence;
+  segment->ok = !front->failed;
+  segment->error = front->error;
+  segment->data = std::move(front->data);
+  segment->fetch_us = front->done_us - front->start_us;
+  lock.unlock();
+  // Budget freed up; more segments may start.
+  work_cv_.notify_all();
+  return true;
+}
+
+void SegmentPrefetcher::Clear() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    queue_.clear();
+    reserved_bytes_ = 0;
+    first_enqueue_us_ = -1;
+    started_us_ = -1;
+    stats_.startup_us = -1;
+  }
+  ready_cv_.notify_all();
+}
+
+PrefetchStats SegmentPrefetcher::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  PrefetchStats stats = stats_;
+  stats.concurrency = concurrency_.limit();
+  stats.rtt_us = concurrency_.rtt_us();
+  stats.throughput = concurrency_.throughput();
+  stats.buffered_bytes = reserved_bytes_;
+  stats.playing_us = started_us_ < 0 ? 0 : NowUs() - started_us_;
+  return stats;
+}
+
+size_t SegmentPrefetcher::EstimatedSize() const {
+  if (stats_.segments > 0) {
+    return static_cast<size_t>(completed_bytes_ / stats_.segments);
+  }
+  return config_.range_bytes > 0 ? static_cast<size_t>(config_.range_bytes)
+                                 : size_t{1} << 20;
+}
+
+bool SegmentPrefetcher::NextJob(Job* job) {
+  // At the limit, the segment playback needs next may still use idle
+  // workers: it is what startup and any stall are waiting for.
+  const bool head_only = in_flight_ >= concurrency_.limit();
+  const int64_t range = config_.range_bytes;
+  for (const std::shared_ptr<Segment>& segment : queue_) {
+    Segment& s = *segment;
+    if (head_only && segment != queue_.front()) break;
+    if (s.failed) continue;
+    job->segment = segment;
+    job->generation = generation_;
+    if (!s.retry.empty()) {
+      job->offset = s.retry.back().first;
+      job->length = s.retry.back().second;
+      s.retry.pop_back();
+      return true;
+    }
+    if (!s.started) {
+      // Segments start in order, so one that does not fit holds back the
+      // ones after it rather than letting them jump ahead.
+      const size_t need = s.size >= 0 ? static_cast<size_t>(s.size)
+                                       : EstimatedSize();
+      if (reserved_bytes_ > 0 &&
+          reserved_bytes_ + need > config_.memory_budget_bytes) {
+        return false;
+      }
+      s.started = true;
+      s.start_us = NowUs();
+      s.reserved = need;
+      reserved_bytes_ += need;
+      stats_.max_buffered_bytes =
+          std::max(stats_.max_buffered_bytes, reserved_bytes_);
+      if (s.size >= 0) s.data.resize(s.size);
+    }
+    if (s.size < 0) {
+      if (s.probing || s.active > 0) continue;
+      // Fetch the first range; its response tells us the size.
+      s.probing = true;
+      job->offset = 0;
+      job->length = range > 0 ? range : -1;
+      return true;
+    }
+    if (s.next_offset < s.size) {
+      job->offset = s.next_offset;
+      job->length = range > 0 ? std::min(range, s.size - s.next_offset)
+                              : s.size - s.next_offset;
+      s.next_offset += job->length;
+      return true;
+    }
+  }
+  job->segment.reset();
+  return false;
+}
+
+void SegmentPrefetcher::WorkerLoop() {
+  HttpClient client;
+  uint64_t job_generation = 0;
+  client.set_cancel_check(
+      [this, &job_generation] { return generation_ != job_generation; });
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    Job job;
+    work_cv_.wait(lock, [&] { return stopping_ || NextJob(&job); });
+    if (stopping_) return;
+    ++in_flight_;
+    ++job.segment->active;
+    stats_.max_in_flight = std::max(stats_.max_in_flight, in_flight_);
+    job_generation = job.generation;
+    lock.unlock();
+    RunJob(&client, job);
+    lock.lock();
+  }
+}
+
+void SegmentPrefetcher::RunJob(HttpClient* client, const Job& job) {
+  Segment& s = *job.segment;
+  const SegmentRequest& request = s.request;
+  // Only a probe finds out the size; every other request writes into the
+  // buffer sized for it, at its own offset.
+  const bool probe = s.size < 0;
+  int64_t write_at = job.offset;
+  // End of the bytes this request is responsible for.
+  int64_t end = job.length >= 0 ? job.offset + job.length : -1;
+  bool first = true;
+  // Set when the probe found the segment too big for the budget left.
+  bool deferred = false;
+  auto on_data = [&](const uint8_t* data, size_t size,
+                     const HttpResponse& response) {
+    if (generation_ != job.generation) return false;
+    if (first) {
+      first = false;
+      if (probe) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const int64_t total = response.total_size;
+        if (total >= 0 && queue_.front().get() != &s &&
+            reserved_bytes_ - s.reserved + total >
+                config_.memory_budget_bytes) {
+          // It was started on an estimate. Give the reservation back and
+          // start it again, at its real size, once that fits.
+          reserved_bytes_ -= s.reserved;
+          s.reserved = 0;
+          s.started = false;
+          s.size = total;
+          s.probing = false;
+          deferred = true;
+          return false;
+        }
+        if (total >= 0) {
+          s.size = total;
+          s.data.resize(total);
+          end = response.partial && end >= 0 ? std::min(total, end) : total;
+          s.next_offset = end;
+          reserved_bytes_ += total - s.reserved;
+          s.reserved = total;
+          stats_.max_buffered_bytes =
+              std::max(stats_.max_buffered_bytes, reserved_bytes_);
+        }
+        s.probing = false;
+        // The rest of the segment can now be fetched in parallel.
+        work_cv_.notify_all();
+      } else if (!response.partial) {
+        // The server ignored the range; the bytes would land in the wrong
+        // place.
+        return false;
+      }
+    }
+    if (s.size >= 0) {
+      if (write_at + static_cast<int64_t>(size) > s.size) return false;
+      std::memcpy(s.data.data() + write_at, data, size);
+    } else {
+      // Size unknown: this is the only request for the segment.
+      s.data.insert(s.data.end(), data, data + size);
+    }
+    write_at += size;
+    return true;
+  };
+
+  HttpResponse response;
+  const bool ok = client->Get(request.url, request.offset + job.offset,
+                              job.length, on_data, &response);
+  const int64_t now_us = NowUs();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  --in_flight_;
+  --s.active;
+  ++stats_.requests;
+  if (job.generation != generation_) {
+    work_cv_.notify_all();
+    return;
+  }
+  if (probe) s.probing = false;
+  if (deferred) {
+    work_cv_.notify_all();
+    return;
+  }
+  // The first range of an empty resource cannot be satisfied.
+  const bool empty = probe && !ok && response.status == 416;
+  if (ok || empty) {
+    if (ok) {
+      concurrency_.OnRequestDone(response.bytes, response.first_byte_us,
+                                 response.elapsed_us, now_us);
+    }
+    s.received += write_at - job.offset;
+    if (s.size < 0) {
+      // The server never said; what arrived is the segment.
+      s.size = s.received;
+      s.next_offset = s.size;
+      reserved_bytes_ += s.size - s.reserved;
+      s.reserved = s.size;
+    }
+  } else {
+    ++stats_.failed_requests;
+    if (++s.failures >= config_.max_attempts) {
+      s.failed = true;
+      s.error = response.error;
+    } else if (s.size < 0) {
+      // Failed before the size was known: probe again.
+      s.data.clear();
+    } else {
+      s.retry.emplace_back(job.offset, end - job.offset);
+    }
+  }
+  if (s.done()) {
+    s.done_us = now_us;
+    if (!s.failed) {
+      ++stats_.segments;
+      stats_.bytes += s.size;
+      completed_bytes_ += s.size;
+    }
+    ready_cv_.notify_all();
+  }
+  work_cv_.notify_all();
+}
+
+}  // namespace ivs_broadcaster
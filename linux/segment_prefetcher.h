@@ -0,0 +1,192 @@
+#ifndef IVS_BROADCASTER_SEGMENT_PREFETCHER_H_
+#define IVS_BROADCASTER_SEGMENT_PREFETCHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+class HttpClient;
+
+// Picks how many requests to keep in flight from what finished requests
+// measured.
+//
+// Two effects decide it. Each request waits about one round trip before its
+// first byte, so hiding that latency takes 1 + RTT / transfer time requests
+// in flight; that estimate is a floor. Above it, the limit probes upward
+// while each extra request still raises aggregate throughput by 10%, and
+// backs off when it does not, e.g. once the link rather than the per-
+// connection rate is the bottleneck.
+class PrefetchConcurrency {
+ public:
+  PrefetchConcurrency(int min_limit, int max_limit);
+
+  // Records a finished request of |bytes|, |first_byte_us| of which was
+  // spent waiting for the first byte, |elapsed_us| in total, ending at
+  // |now_us|.
+  void OnRequestDone(int64_t bytes, int64_t first_byte_us, int64_t elapsed_us,
+                     int64_t now_us);
+
+  int limit() const { return limit_; }
+  int64_t rtt_us() const { return static_cast<int64_t>(rtt_us_); }
+  // Aggregate throughput across all requests, in bytes per second.
+  double throughput() const { return throughput_; }
+
+ private:
+  void CloseWindow(int64_t now_us);
+
+  const int min_limit_;
+  const int max_limit_;
+  int limit_;
+  double rtt_us_ = 0;
+  double transfer_us_ = 0;
+  double throughput_ = 0;
+
+  // The measurement window at the current limit.
+  int64_t window_start_us_ = -1;
+  int64_t window_bytes_ = 0;
+  int window_requests_ = 0;
+  // Throughput measured at each limit; 0 when not measured.
+  std::vector<double> rate_at_;
+  // Windows to wait after backing off before probing again.
+  int hold_windows_ = 0;
+  bool settling_ = false;
+};
+
+struct PrefetchConfig {
+  // Two requests hide one round trip from the start, before anything has
+  // been measured.
+  int min_concurrency = 2;
+  int max_concurrency = 6;
+  // Bytes of fetched, not yet taken segments plus those being fetched.
+  size_t memory_budget_bytes = 32 << 20;
+  // Segments are fetched in ranges of this size, in parallel once the first
+  // range has told us how large the segment is. 0 fetches whole segments.
+  int64_t range_bytes = 512 << 10;
+  // Attempts per range before the segment fails.
+  int max_attempts = 3;
+};
+
+struct SegmentRequest {
+  int64_t sequence = 0;
+  std::string url;
+  // A byte range of |url| (EXT-X-BYTERANGE); -1 for the whole resource.
+  int64_t offset = 0;
+  int64_t length = -1;
+};
+
+struct PrefetchedSegment {
+  int64_t sequence = 0;
+  bool ok = false;
+  std::string error;
+  std::vector<uint8_t> data;
+  // From the first request for the segment to its last byte.
+  int64_t fetch_us = 0;
+};
+
+struct PrefetchStats {
+  uint64_t requests = 0;
+  uint64_t failed_requests = 0;
+  uint64_t segments = 0;
+  uint64_t bytes = 0;
+  int concurrency = 0;
+  int max_in_flight = 0;
+  int64_t rtt_us = 0;
+  double throughput = 0;
+  size_t buffered_bytes = 0;
+  size_t max_buffered_bytes = 0;
+  // From the first Enqueue() after construction or Clear() to the first
+  // segment taken; -1 before then.
+  int64_t startup_us = -1;
+  // Time Take() spent waiting after startup, i.e. playback stalled.
+  int64_t stall_us = 0;
+  uint64_t stalls = 0;
+  // Time since startup.
+  int64_t playing_us = 0;
+
+  // Fraction of the time since startup spent stalled.
+  double rebuffer_ratio() const {
+    return playing_us > 0 ? static_cast<double>(stall_us) / playing_us : 0;
+  }
+};
+
+// Fetches the segments a player will need next, several at a time.
+//
+// Segments are queued in playback order and handed out in that order. The
+// number of requests in flight follows PrefetchConcurrency. A segment larger
+// than one range is split into range requests that run in parallel, so a
+// single large segment at the live edge does not crawl over one connection;
+// the segment playback needs next may use idle workers beyond the limit.
+// New segments are not started while the fetched and in-flight bytes would
+// exceed the memory budget.
+class SegmentPrefetcher {
+ public:
+  explicit SegmentPrefetcher(const PrefetchConfig& config);
+  // Cancels outstanding requests.
+  ~SegmentPrefetcher();
+
+  SegmentPrefetcher(const SegmentPrefetcher&) = delete;
+  SegmentPrefetcher& operator=(const SegmentPrefetcher&) = delete;
+
+  void Enqueue(const SegmentRequest& request);
+
+  // Waits up to |timeout_us| for the oldest queued segment and removes it.
+  // Call it when playback needs the segment: the time it waits counts as
+  // rebuffering. Returns false on timeout or when nothing is queued; a
+  // segment whose requests failed is returned with |ok| false.
+  bool Take(int64_t timeout_us, PrefetchedSegment* segment);
+
+  // Drops every queued segment and cancels their requests, e.g. on seek.
+  void Clear();
+
+  PrefetchStats stats() const;
+
+ private:
+  struct Segment;
+  struct Job {
+    std::shared_ptr<Segment> segment;
+    int64_t offset = 0;
+    int64_t length = -1;
+    uint64_t generation = 0;
+  };
+
+  void WorkerLoop();
+  // Picks the next range to fetch, or returns false when nothing may start.
+  bool NextJob(Job* job);
+  void RunJob(HttpClient* client, const Job& job);
+  size_t EstimatedSize() const;
+
+  const PrefetchConfig config_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable ready_cv_;
+  bool stopping_ = false;
+  // Bumped by Clear(); requests from an older generation are abandoned.
+  // Atomic so that transfers can check it without the lock.
+  std::atomic<uint64_t> generation_{0};
+  std::deque<std::shared_ptr<Segment>> queue_;
+  PrefetchConcurrency concurrency_;
+  int in_flight_ = 0;
+  // Bytes reserved by started, not yet taken segments.
+  size_t reserved_bytes_ = 0;
+  int64_t completed_bytes_ = 0;
+  PrefetchStats stats_;
+  int64_t first_enqueue_us_ = -1;
+  int64_t started_us_ = -1;
+  bool stalled_ = false;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_SEGMENT_PREFETCHER_H_
@@ -0,0 +1,304 @@
+#include "shared_frame_ring.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <new>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x49565346;  // "IVSF"
+constexpr uint32_t kVersion = 1;
+
+// Slot metadata sits in front of the pixels; the pixels start on a cache
+// line so SIMD readers get aligned planes.
+constexpr size_t kSlotHeaderSize = 64;
+
+constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+// Bounds on what a peer may put in the header, so that the sizes computed
+// from it can neither overflow nor turn negative as ints.
+constexpr uint32_t kMaxDimension = 16384;
+constexpr uint32_t kMaxSlotCount = 1024;
+
+struct SlotHeader {
+  int64_t pts_us;
+};
+
+size_t FrameBytes(uint32_t width, uint32_t height) {
+  const size_t uv = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+  return static_cast<size_t>(width) * height + 2 * uv;
+}
+
+size_t RoundUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Shared (not FUTEX_PRIVATE) operations, since the waiter and the waker are
+// in different processes.
+void FutexWait(std::atomic<uint32_t>* word, uint32_t expected,
+               const timespec* timeout) {
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex words must be plain 32-bit integers");
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+          timeout, nullptr, 0);
+}
+
+void FutexWake(std::atomic<uint32_t>* word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+// Waits until |ready| holds, sleeping on |word|, which the other side bumps
+// whenever |ready| may have changed.
+template <typename Ready>
+bool WaitOn(std::atomic<uint32_t>* word, const std::atomic<uint32_t>* closed,
+            std::chrono::milliseconds timeout, Ready ready) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  for (;;) {
+    const uint32_t observed = word->load(std::memory_order_acquire);
+    if (ready()) return true;
+    if (closed->load(std::memory_order_acquire) != 0) return false;
+    const auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+      return false;
+    }
+    const auto nanos =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(remaining)
+            .count();
+    timespec relative;
+    relative.tv_sec = static_cast<time_t>(nanos / 1000000000);
+    relative.tv_nsec = static_cast<long>(nanos % 1000000000);
+    FutexWait(word, observed, &relative);
+  }
+}
+
+}  // namespace
+
+struct SharedFrameRing::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t slot_count;
+  uint64_t slot_size;
+  uint64_t slots_offset;
+  // Frames published and released so far. Each is written by one side only
+  // and kept on its own cache line.
+  alignas(64) std::atomic<uint32_t> write_sequence;
+  alignas(64) std::atomic<uint32_t> read_sequence;
+  alignas(64) std::atomic<uint32_t> closed;
+};
+
+SharedFrameRing::SharedFrameRing(int fd, void* mapping, size_t size)
+    : fd_(fd),
+      mapping_(mapping),
+      size_(size),
+      header_(static_cast<Header*>(mapping)) {}
+
+SharedFrameRing::~SharedFrameRing() {
+  munmap(mapping_, size_);
+  close(fd_);
+}
+
+std::unique_ptr<SharedFrameRing> SharedFrameRing::Create(int width,
+                                                         int height,
+                                                         int slot_count) {
+  if (width <= 0 || height <= 0 || slot_count <= 0 ||
+      static_cast<uint32_t>(width) > kMaxDimension ||
+      static_cast<uint32_t>(height) > kMaxDimension ||
+      static_cast<uint32_t>(slot_count) > kMaxSlotCount) {
+    return nullptr;
+  }
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t slot_size =
+      RoundUp(kSlotHeaderSize + FrameBytes(width, height), page);
+  const size_t slots_offset = RoundUp(sizeof(Header), page);
+  const size_t size = slots_offset + slot_size * slot_count;
+
+  int fd = memfd_create("ivs_broadcaster_frames",
+                        MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) return nullptr;
+  if (ftruncate(fd, static_cast<off_t>(size)) < 0 ||
+      fcntl(fd, F_ADD_SEALS, kRequiredSeals) < 0) {
+    close(fd);
+    return nullptr;
+  }
+  void* mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+
+  Header* header = new (mapping) Header();
+  header->magic = kMagic;
+  header->version = kVersion;
+  header->width = static_cast<uint32_t>(width);
+  header->height = static_cast<uint32_t>(height);
+  header->slot_count = static_cast<uint32_t>(slot_count);
+  header->slot_size = slot_size;
+  header->slots_offset = slots_offset;
+  header->write_sequence.store(0, std::memory_order_relaxed);
+  header->read_sequence.store(0, std::memory_order_relaxed);
+  header->closed.store(0, std::memory_order_release);
+  return std::unique_ptr<SharedFrameRing>(
+      new SharedFrameRing(fd, mapping, size));
+}
+
+std::unique_ptr<SharedFrameRing> SharedFrameRing::Attach(int fd) {
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) < 0 ||
+      (fcntl(fd, F_GET_SEALS) & kRequiredSeals) != kRequiredSeals ||
+      static_cast<size_t>(info.st_size) < sizeof(Header)) {
+    if (fd >= 0) close(fd);
+    return nullptr;
+  }
+  const size_t size = static_cast<size_t>(info.st_size);
+  void* mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+  std::unique_ptr<SharedFrameRing> ring(
+      new SharedFrameRing(fd, mapping, size));
+  // Dimensions and count first, so FrameBytes() cannot overflow, then the
+  // slots against the file without multiplying untrusted sizes.
+  const Header* header = ring->header_;
+  const bool valid =
+      header->magic == kMagic && header->version == kVersion &&
+      header->width > 0 && header->width <= kMaxDimension &&
+      header->height > 0 && header->height <= kMaxDimension &&
+      header->slot_count > 0 && header->slot_count <= kMaxSlotCount &&
+      header->slot_size >=
+          kSlotHeaderSize + FrameBytes(header->width, header->height) &&
+      header->slots_offset >= sizeof(Header) &&
+      header->slots_offset <= size &&
+      header->slot_count <= (size - header->slots_offset) / header->slot_size;
+  return valid ? std::move(ring) : nullptr;
+}
+
+int SharedFrameRing::width() const { return header_->width; }
+
+int SharedFrameRing::height() const { return header_->height; }
+
+int SharedFrameRing::slot_count() const { return header_->slot_count; }
+
+uint8_t* SharedFrameRing::Slot(uint32_t sequence) const {
+  return static_cast<uint8_t*>(mapping_) + header_->slots_offset +
+         (sequence % header_->slot_count) * header_->slot_size;
+}
+
+bool SharedFrameRing::BeginWrite(SharedFrame* frame,
+                                 std::chrono::milliseconds timeout) {
+  const uint32_t written =
+      header_->write_sequence.load(std::memory_order_relaxed);
+  const uint32_t slots = header_->slot_count;
+  const bool ready = WaitOn(&header_->read_sequence, &header_->closed,
+                            timeout, [this, written, slots] {
+                              return written - header_->read_sequence.load(
+                                                   std::memory_order_acquire) <
+                                     slots;
+                            });
+  if (!ready || closed()) return false;
+  uint8_t* slot = Slot(written);
+  frame->width = header_->width;
+  frame->height = header_->height;
+  frame->pts_us = 0;
+  frame->data = slot + kSlotHeaderSize;
+  return true;
+}
+
+void SharedFrameRing::EndWrite(int64_t pts_us) {
+  const uint32_t written =
+      header_->write_sequence.load(std::memory_order_relaxed);
+  reinterpret_cast<SlotHeader*>(Slot(written))->pts_us = pts_us;
+  header_->write_sequence.store(written + 1, std::memory_order_release);
+  FutexWake(&header_->write_sequence);
+}
+
+bool SharedFrameRing::BeginRead(SharedFrame* frame,
+                                std::chrono::milliseconds timeout) {
+  const uint32_t read = header_->read_sequence.load(std::memory_order_relaxed);
+  // Frames published before Close() are still delivered.
+  const bool ready = WaitOn(&header_->write_sequence, &header_->closed,
+                            timeout, [this, read] {
+                              return header_->write_sequence.load(
+                                         std::memory_order_acquire) != read;
+                            });
+  if (!ready) return false;
+  uint8_t* slot = Slot(read);
+  frame->width = header_->width;
+  frame->height = header_->height;
+  frame->pts_us = reinterpret_cast<const SlotHeader*>(slot)->pts_us;
+  frame->data = slot + kSlotHeaderSize;
+  return true;
+}
+
+void SharedFrameRing::EndRead() {
+  const uint32_t read = header_->read_sequence.load(std::memory_order_relaxed);
+  header_->read_sequence.store(read + 1, std::memory_order_release);
+  FutexWake(&header_->read_sequence);
+}
+
+void SharedFrameRing::Close() {
+  header_->closed.store(1, std::memory_order_release);
+  FutexWake(&header_->write_sequence);
+  FutexWake(&header_->read_sequence);
+}
+
+bool SharedFrameRing::closed() const {
+  return header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+bool SendRingFd(int socket, int fd) {
+  char byte = 0;
+  iovec payload{&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr message = {};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+  return sendmsg(socket, &message, MSG_NOSIGNAL) == 1;
+}
+
+int ReceiveRingFd(int socket) {
+  char byte = 0;
+  iovec payload{&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr message = {};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != 1) return -1;
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (header == nullptr || header->cmsg_level != SOL_SOCKET ||
+      header->cmsg_type != SCM_RIGHTS ||
+      header->cmsg_len != CMSG_LEN(sizeof(int))) {
+    return -1;
+  }
+  int fd = -1;
+  std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+  return fd;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,97 @@
+#ifndef IVS_BROADCASTER_SHARED_FRAME_RING_H_
+#define IVS_BROADCASTER_SHARED_FRAME_RING_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ivs_broadcaster {
+
+// An I420 frame living in a SharedFrameRing slot. Same plane layout as
+// VideoFrame, but the memory belongs to the ring.
+struct SharedFrame {
+  int width = 0;
+  int height = 0;
+  int64_t pts_us = 0;
+  uint8_t* data = nullptr;
+
+  int y_stride() const { return width; }
+  int uv_stride() const { return (width + 1) / 2; }
+  int uv_height() const { return (height + 1) / 2; }
+
+  uint8_t* y() const { return data; }
+  uint8_t* u() const { return y() + y_stride() * height; }
+  uint8_t* v() const { return u() + uv_stride() * uv_height(); }
+};
+
+// A single-producer, single-consumer ring of I420 frames in a memfd, for
+// running capture and encoding in separate processes.
+//
+// The producer writes straight into a slot and publishes it; the consumer
+// reads the same pages and releases the slot, so frames are never copied
+// between processes. Both sides block on futexes in the shared mapping.
+//
+// The memfd is sealed against shrinking and growing once created, and
+// Attach() refuses descriptors without those seals, so a misbehaving peer
+// cannot truncate the file and fault the other process. Slot contents stay
+// writable: ownership of a slot is handed over by the sequence counters.
+class SharedFrameRing {
+ public:
+  ~SharedFrameRing();
+
+  SharedFrameRing(const SharedFrameRing&) = delete;
+  SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+  // Creates a ring of |slot_count| frames of |width| x |height|. Returns
+  // nullptr when the memfd cannot be created or mapped.
+  static std::unique_ptr<SharedFrameRing> Create(int width, int height,
+                                                 int slot_count);
+
+  // Maps a ring created by another process. Takes ownership of |fd|, which
+  // is closed on failure.
+  static std::unique_ptr<SharedFrameRing> Attach(int fd);
+
+  // The memfd, to pass to the other process (see SendRingFd()).
+  int fd() const { return fd_; }
+  int width() const;
+  int height() const;
+  int slot_count() const;
+
+  // Producer side. Waits up to |timeout| for a free slot and points |frame|
+  // at it. Returns false on timeout or when the ring is closed.
+  bool BeginWrite(SharedFrame* frame, std::chrono::milliseconds timeout);
+  // Publishes the slot from the last BeginWrite().
+  void EndWrite(int64_t pts_us);
+
+  // Consumer side. Waits up to |timeout| for a published frame. Returns
+  // false on timeout, or once the ring is closed and drained.
+  bool BeginRead(SharedFrame* frame, std::chrono::milliseconds timeout);
+  // Hands the slot from the last BeginRead() back to the producer.
+  void EndRead();
+
+  // Wakes both sides and makes further waits fail. Either process may call
+  // it, e.g. when shutting down.
+  void Close();
+  bool closed() const;
+
+ private:
+  struct Header;
+
+  SharedFrameRing(int fd, void* mapping, size_t size);
+  uint8_t* Slot(uint32_t sequence) const;
+
+  int fd_;
+  void* mapping_;
+  size_t size_;
+  Header* header_;
+};
+
+// Passes a ring descriptor over a Unix domain socket (SCM_RIGHTS).
+bool SendRingFd(int socket, int fd);
+// Receives a descriptor sent with SendRingFd(), or returns -1.
+int ReceiveRingFd(int socket);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_SHARED_FRAME_RING_H_
@@ -0,0 +1,421 @@
+#include "sprite_sheet.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include "frame_scaler.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr char kMagic[] = {'I', 'V', 'S', 'P'};
+constexpr uint8_t kVersion = 1;
+// Magic, version, format, cell size, grid and cell count.
+constexpr size_t kHeaderSize = 18;
+constexpr char kIndexName[] = "index.bin";
+// Keyframes closer together than this are not worth a cell each.
+constexpr int64_t kMinIntervalUs = 100000;
+
+void PutU16(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(value & 0xff);
+  out->push_back((value >> 8) & 0xff);
+}
+
+void PutU32(std::vector<uint8_t>* out, uint32_t value) {
+  PutU16(out, value & 0xffff);
+  PutU16(out, value >> 16);
+}
+
+uint32_t GetU16(const uint8_t* data) { return data[0] | data[1] << 8; }
+
+uint32_t GetU32(const uint8_t* data) {
+  return GetU16(data) | GetU16(data + 2) << 16;
+}
+
+// FNV-1a, which unlike std::hash names the same directory in every run.
+uint64_t Fnv1a(const std::string& text) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+void CopyPlane(const uint8_t* src, int src_stride, int width, int height,
+               uint8_t* dst, int dst_stride) {
+  for (int row = 0; row < height; ++row) {
+    std::memcpy(dst + row * dst_stride, src + row * src_stride, width);
+  }
+}
+
+// Scales |frame| to fit the cell at |x|, |y| of |sheet|, centred, and
+// copies it in. Offsets stay even so the chroma planes line up.
+void DrawCell(const VideoFrame& frame, int x, int y, int cell_width,
+              int cell_height, VideoFrame* sheet) {
+  int width = 0;
+  int height = 0;
+  FitWithin(frame.width, frame.height, cell_width, cell_height, &width,
+            &height);
+  if (width <= 0 || height <= 0) return;
+  VideoFrame scaled;
+  const VideoFrame* image = &frame;
+  if (width != frame.width || height != frame.height) {
+    scaled.Allocate(width, height);
+    ScaleFrame(frame, &scaled);
+    image = &scaled;
+  }
+  x += ((cell_width - width) / 2) & ~1;
+  y += ((cell_height - height) / 2) & ~1;
+  CopyPlane(image->y(), image->y_stride(), width, height,
+            sheet->y() + y * sheet->y_stride() + x, sheet->y_stride());
+  const int uv_offset = y / 2 * sheet->uv_stride() + x / 2;
+  CopyPlane(image->u(), image->uv_stride(), width / 2, height / 2,
+            sheet->u() + uv_offset, sheet->uv_stride());
+  CopyPlane(image->v(), image->uv_stride(), width / 2, height / 2,
+            sheet->v() + uv_offset, sheet->uv_stride());
+}
+
+std::string SheetPathIn(const std::string& directory, int sheet,
+                        ThumbnailFormat format) {
+  return directory + "/sheet_" + std::to_string(sheet) +
+         (format == ThumbnailFormat::kWebp ? ".webp" : ".jpg");
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(data.data()), data.size());
+  return static_cast<bool>(out);
+}
+
+}  // namespace
+
+SpriteIndex::SpriteIndex(int cell_width, int cell_height, int columns,
+                         int rows, ThumbnailFormat format,
+                         std::vector<int64_t> times_us)
+    : cell_width_(cell_width),
+      cell_height_(cell_height),
+      columns_(std::max(columns, 1)),
+      rows_(std::max(rows, 1)),
+      format_(format),
+      times_us_(std::move(times_us)) {
+  // Kept to the millisecond, as on disk, so a loaded index answers the same.
+  for (int64_t& time_us : times_us_) time_us = time_us / 1000 * 1000;
+}
+
+int SpriteIndex::sheets() const {
+  const size_t per_sheet = static_cast<size_t>(columns_) * rows_;
+  return static_cast<int>((times_us_.size() + per_sheet - 1) / per_sheet);
+}
+
+SpriteCell SpriteIndex::CellAt(size_t index) const {
+  const size_t per_sheet = static_cast<size_t>(columns_) * rows_;
+  const int position = static_cast<int>(index % per_sheet);
+  SpriteCell cell;
+  cell.sheet = static_cast<int>(index / per_sheet);
+  cell.x = position % columns_ * cell_width_;
+  cell.y = position / columns_ * cell_height_;
+  cell.width = cell_width_;
+  cell.height = cell_height_;
+  cell.pts_us = times_us_[index];
+  return cell;
+}
+
+bool SpriteIndex::Find(int64_t time_us, SpriteCell* cell) const {
+  if (times_us_.empty()) return false;
+  auto it = std::upper_bound(times_us_.begin(), times_us_.end(), time_us);
+  const size_t index = it == times_us_.begin() ? 0 : it - times_us_.begin() - 1;
+  *cell = CellAt(index);
+  return true;
+}
+
+std::vector<uint8_t> SpriteIndex::Serialize() const {
+  std::vector<uint8_t> out(std::begin(kMagic), std::end(kMagic));
+  out.push_back(kVersion);
+  out.push_back(static_cast<uint8_t>(format_));
+  PutU16(&out, cell_width_);
+  PutU16(&out, cell_height_);
+  PutU16(&out, columns_);
+  PutU16(&out, rows_);
+  PutU32(&out, static_cast<uint32_t>(times_us_.size()));
+  for (int64_t time_us : times_us_) {
+    PutU32(&out, static_cast<uint32_t>(time_us / 1000));
+  }
+  return out;
+}
+
+bool SpriteIndex::Parse(const uint8_t* data, size_t size,
+                        SpriteIndex* index) {
+  if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0 ||
+      data[4] != kVersion ||
+      data[5] > static_cast<int>(ThumbnailFormat::kWebp)) {
+    return false;
+  }
+  const int cell_width = GetU16(data + 6);
+  const int cell_height = GetU16(data + 8);
+  const int columns = GetU16(data + 10);
+  const int rows = GetU16(data + 12);
+  const uint32_t count = GetU32(data + 14);
+  if (cell_width == 0 || cell_height == 0 || columns == 0 || rows == 0 ||
+      size != kHeaderSize + static_cast<size_t>(count) * 4) {
+    return false;
+  }
+  std::vector<int64_t> times_us(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    times_us[i] = GetU32(data + kHeaderSize + i * 4) * int64_t{1000};
+    if (i > 0 && times_us[i] < times_us[i - 1]) return false;
+  }
+  *index = SpriteIndex(cell_width, cell_height, columns, rows,
+                       static_cast<ThumbnailFormat>(data[5]),
+                       std::move(times_us));
+  return true;
+}
+
+std::string SpriteResult::SheetPath(int sheet) const {
+  return SheetPathIn(directory, sheet,
+                     index ? index->format() : ThumbnailFormat::kJpeg);
+}
+
+bool LoadSprites(const std::string& directory, SpriteResult* result) {
+  std::ifstream in(directory + "/" + kIndexName, std::ios::binary);
+  if (!in) return false;
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+  auto index = std::make_shared<SpriteIndex>();
+  if (!SpriteIndex::Parse(data.data(), data.size(), index.get())) {
+    return false;
+  }
+  for (int sheet = 0; sheet < index->sheets(); ++sheet) {
+    std::error_code error;
+    if (!std::filesystem::exists(
+            SheetPathIn(directory, sheet, index->format()), error)) {
+      return false;
+    }
+  }
+  result->ok = true;
+  result->directory = directory;
+  result->index = std::move(index);
+  return true;
+}
+
+std::string DefaultSpriteCacheDir() {
+  std::filesystem::path base;
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    base = xdg;
+  } else if (const char* home = std::getenv("HOME"); home && *home) {
+    base = std::filesystem::path(home) / ".cache";
+  } else {
+    base = std::filesystem::temp_directory_path();
+  }
+  return (base / "ivs_broadcaster" / "sprites").string();
+}
+
+SpriteSheetGenerator::SpriteSheetGenerator(
+    ThumbnailCodecFactory codec_factory, std::string cache_dir)
+    : codec_factory_(std::move(codec_factory)),
+      cache_dir_(std::move(cache_dir)),
+      worker_(&SpriteSheetGenerator::WorkerLoop, this) {}
+
+SpriteSheetGenerator::~SpriteSheetGenerator() {
+  std::deque<Job> abandoned;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    abandoned.swap(queue_);
+  }
+  wake_.notify_all();
+  worker_.join();
+  SpriteResult result;
+  result.error = "sprite generator stopped";
+  for (const Job& job : abandoned) Finish(job.directory, result);
+}
+
+std::string SpriteSheetGenerator::DirectoryFor(
+    const std::string& url, const SpriteConfig& config) const {
+  const std::string key =
+      url + '\n' + std::to_string(config.interval_us) + ' ' +
+      std::to_string(config.cell_width) + 'x' +
+      std::to_string(config.cell_height) + ' ' +
+      std::to_string(config.columns) + 'x' + std::to_string(config.rows) +
+      ' ' + std::to_string(static_cast<int>(config.format)) + ' ' +
+      std::to_string(config.quality);
+  char name[17];
+  std::snprintf(name, sizeof(name), "%016llx",
+                static_cast<unsigned long long>(Fnv1a(key)));
+  return cache_dir_ + "/" + name;
+}
+
+uint64_t SpriteSheetGenerator::decodes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return decodes_;
+}
+
+bool SpriteSheetGenerator::stopping() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_;
+}
+
+void SpriteSheetGenerator::Generate(const std::string& url,
+                                    const SpriteConfig& config,
+                                    Callback callback) {
+  std::string directory = DirectoryFor(url, config);
+  SpriteResult result;
+  if (LoadSprites(directory, &result)) {
+    result.from_cache = true;
+    callback(result);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopping_) {
+      std::vector<Callback>& callbacks = waiting_[directory];
+      callbacks.push_back(std::move(callback));
+      if (callbacks.size() > 1) return;
+      queue_.push_back(Job{std::move(directory), url, config});
+      wake_.notify_one();
+      return;
+    }
+  }
+  result.error = "sprite generator stopped";
+  callback(result);
+}
+
+void SpriteSheetGenerator::WorkerLoop() {
+  std::unique_ptr<ThumbnailCodec> codec;
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    if (!codec) codec = codec_factory_();
+    SpriteResult result;
+    if (codec) {
+      result = Produce(codec.get(), job);
+    } else {
+      result.error = "no thumbnail codec";
+    }
+    Finish(job.directory, result);
+  }
+}
+
+SpriteResult SpriteSheetGenerator::Produce(ThumbnailCodec* codec,
+                                           const Job& job) {
+  SpriteResult result;
+  result.directory = job.directory;
+  int64_t duration_us = 0;
+  if (!codec->Duration(job.url, &duration_us, &result.error)) return result;
+
+  const SpriteConfig& config = job.config;
+  const int cell_width = std::max(2, config.cell_width & ~1);
+  const int cell_height = std::max(2, config.cell_height & ~1);
+  const int columns = std::max(1, config.columns);
+  const int rows = std::max(1, config.rows);
+  const int64_t interval_us = std::max(kMinIntervalUs, config.interval_us);
+  std::error_code error;
+  std::filesystem::create_directories(job.directory, error);
+  if (error) {
+    result.error = "cannot create " + job.directory;
+    return result;
+  }
+  const std::string index_path = job.directory + "/" + kIndexName;
+  std::filesystem::remove(index_path, error);
+
+  ThumbnailFormat format = config.format;
+  VideoFrame sheet;
+  int filled = 0;
+  std::vector<int64_t> times_us;
+  auto flush = [&] {
+    std::vector<uint8_t> data;
+    const int number = static_cast<int>((times_us.size() - 1) /
+                                        (static_cast<size_t>(columns) * rows));
+    if (!codec->Encode(sheet, config.quality, &format, &data,
+                       &result.error)) {
+      return false;
+    }
+    if (!WriteFile(SheetPathIn(job.directory, number, format), data)) {
+      result.error = "cannot write sheet " + std::to_string(number);
+      return false;
+    }
+    filled = 0;
+    return true;
+  };
+
+  for (int64_t time_us = 0; time_us < duration_us; time_us += interval_us) {
+    if (stopping()) {
+      result.error = "sprite generator stopped";
+      return result;
+    }
+    VideoFrame frame;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++decodes_;
+    }
+    if (!codec->DecodeKeyframe(job.url, time_us, &frame, &result.error)) {
+      return result;
+    }
+    // A GOP longer than the interval lands on the same keyframe again.
+    const int64_t pts_us = frame.pts_us / 1000 * 1000;
+    if (!times_us.empty() && pts_us <= times_us.back()) continue;
+    if (filled == 0) {
+      sheet.Allocate(columns * cell_width, rows * cell_height);
+      const size_t luma = static_cast<size_t>(sheet.y_stride()) * sheet.height;
+      std::fill(sheet.data.begin(), sheet.data.begin() + luma, 16);
+      std::fill(sheet.data.begin() + luma, sheet.data.end(), 128);
+    }
+    DrawCell(frame, filled % columns * cell_width,
+             filled / columns * cell_height, cell_width, cell_height, &sheet);
+    times_us.push_back(pts_us);
+    if (++filled == columns * rows && !flush()) return result;
+  }
+  if (times_us.empty()) {
+    result.error = "no keyframes in " + job.url;
+    return result;
+  }
+  if (filled > 0 && !flush()) return result;
+
+  auto index = std::make_shared<SpriteIndex>(
+      cell_width, cell_height, columns, rows, format, std::move(times_us));
+  // Written under a temporary name and renamed, so a crash never leaves a
+  // truncated index behind.
+  const std::string temporary = index_path + ".tmp";
+  if (!WriteFile(temporary, index->Serialize())) {
+    result.error = "cannot write " + index_path;
+    return result;
+  }
+  std::filesystem::rename(temporary, index_path, error);
+  if (error) {
+    result.error = "cannot write " + index_path;
+    return result;
+  }
+  result.ok = true;
+  result.error.clear();
+  result.index = std::move(index);
+  return result;
+}
+
+void SpriteSheetGenerator::Finish(const std::string& directory,
+                                  const SpriteResult& result) {
+  std::vector<Callback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = waiting_.find(directory);
+    if (it == waiting_.end()) return;
+    callbacks.swap(it->second);
+    waiting_.erase(it);
+  }
+  for (Callback& callback : callbacks) callback(result);
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,162 @@
+#ifndef IVS_BROADCASTER_SPRITE_SHEET_H_
+#define IVS_BROADCASTER_SPRITE_SHEET_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "thumbnail_cache.h"
+#include "thumbnail_engine.h"
+
+namespace ivs_broadcaster {
+
+struct SpriteConfig {
+  // One keyframe is looked for every interval; a GOP longer than that gives
+  // fewer cells.
+  int64_t interval_us = 10000000;
+  // Each keyframe is scaled to fit a cell, keeping its aspect ratio.
+  // Rounded down to even numbers.
+  int cell_width = 160;
+  int cell_height = 90;
+  // Cells per sheet; a sheet is filled row by row.
+  int columns = 10;
+  int rows = 10;
+  ThumbnailFormat format = ThumbnailFormat::kJpeg;
+  int quality = 70;
+};
+
+// Where the preview for a time is: a rectangle of sheet |sheet|.
+struct SpriteCell {
+  int sheet = 0;
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+  // The keyframe shown.
+  int64_t pts_us = 0;
+};
+
+// Maps stream time to sprite cells. Cells are numbered in keyframe order,
+// so a cell's sheet and position follow from its number and the index only
+// stores each keyframe's time, 4 bytes per cell on disk.
+class SpriteIndex {
+ public:
+  SpriteIndex() = default;
+  // |times_us| must be ascending.
+  SpriteIndex(int cell_width, int cell_height, int columns, int rows,
+              ThumbnailFormat format, std::vector<int64_t> times_us);
+
+  // The cell of the last keyframe at or before |time_us|, or the first
+  // one for an earlier time. False if there are no cells.
+  bool Find(int64_t time_us, SpriteCell* cell) const;
+  SpriteCell CellAt(size_t index) const;
+
+  size_t cells() const { return times_us_.size(); }
+  int sheets() const;
+  const std::vector<int64_t>& times_us() const { return times_us_; }
+  int cell_width() const { return cell_width_; }
+  int cell_height() const { return cell_height_; }
+  int columns() const { return columns_; }
+  int rows() const { return rows_; }
+  ThumbnailFormat format() const { return format_; }
+
+  std::vector<uint8_t> Serialize() const;
+  // False, leaving |index| untouched, unless |data| is a whole index.
+  static bool Parse(const uint8_t* data, size_t size, SpriteIndex* index);
+
+ private:
+  int cell_width_ = 0;
+  int cell_height_ = 0;
+  int columns_ = 1;
+  int rows_ = 1;
+  ThumbnailFormat format_ = ThumbnailFormat::kJpeg;
+  std::vector<int64_t> times_us_;
+};
+
+struct SpriteResult {
+  bool ok = false;
+  std::string error;
+  // Holds index.bin and the sheets, sheet_<n>.jpg or .webp.
+  std::string directory;
+  std::shared_ptr<const SpriteIndex> index;
+  bool from_cache = false;
+
+  std::string SheetPath(int sheet) const;
+};
+
+// Builds trick-play sprite sheets of VOD streams off the calling thread and
+// caches them on disk, so scrubbing previews need no network requests.
+//
+// A worker seeks to every interval and decodes only the keyframe there;
+// segments between keyframes are never fetched when the interval is longer
+// than the GOP. Keyframes are scaled into cells with ScaleFrame() and the
+// sheets encoded with the codec as they fill. The index is written last,
+// so a directory without one is an interrupted job and is rebuilt.
+// Concurrent requests for the same stream and config share one job.
+class SpriteSheetGenerator {
+ public:
+  // Called once per request: synchronously when the sheets are already on
+  // disk, otherwise on the worker thread.
+  using Callback = std::function<void(const SpriteResult&)>;
+
+  SpriteSheetGenerator(ThumbnailCodecFactory codec_factory,
+                       std::string cache_dir);
+  // Stops the job in progress at its next keyframe; it and queued jobs are
+  // answered with an error.
+  ~SpriteSheetGenerator();
+
+  SpriteSheetGenerator(const SpriteSheetGenerator&) = delete;
+  SpriteSheetGenerator& operator=(const SpriteSheetGenerator&) = delete;
+
+  void Generate(const std::string& url, const SpriteConfig& config,
+                Callback callback);
+
+  // Where the sheets of |url| with |config| are cached.
+  std::string DirectoryFor(const std::string& url,
+                           const SpriteConfig& config) const;
+
+  // Keyframes decoded so far.
+  uint64_t decodes() const;
+
+ private:
+  struct Job {
+    std::string directory;
+    std::string url;
+    SpriteConfig config;
+  };
+
+  void WorkerLoop();
+  SpriteResult Produce(ThumbnailCodec* codec, const Job& job);
+  void Finish(const std::string& directory, const SpriteResult& result);
+  bool stopping() const;
+
+  const ThumbnailCodecFactory codec_factory_;
+  const std::string cache_dir_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::deque<Job> queue_;
+  // Callbacks waiting on each directory that is queued or being built.
+  std::unordered_map<std::string, std::vector<Callback>> waiting_;
+  uint64_t decodes_ = 0;
+  std::thread worker_;
+};
+
+// Loads the index in |directory| and checks every sheet it names exists.
+bool LoadSprites(const std::string& directory, SpriteResult* result);
+
+// $XDG_CACHE_HOME/ivs_broadcaster/sprites, or the same under ~/.cache.
+std::string DefaultSpriteCacheDir();
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_SPRITE_SHEET_H_
@@ -0,0 +1,124 @@
+#include "static_frame_detector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace ivs_broadcaster {
+
+namespace {
+
+uint32_t SadScalar(const uint8_t* a, const uint8_t* b, int n) {
+  uint32_t sum = 0;
+  for (int i = 0; i < n; ++i) sum += std::abs(a[i] - b[i]);
+  return sum;
+}
+
+uint32_t Sad8(const uint8_t* a, const uint8_t* b) {
+#if defined(__SSE2__)
+  __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a));
+  __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b));
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_sad_epu8(va, vb)));
+#elif defined(__aarch64__)
+  return vaddlv_u8(vabd_u8(vld1_u8(a), vld1_u8(b)));
+#else
+  return SadScalar(a, b, 8);
+#endif
+}
+
+}  // namespace
+
+uint32_t Sad16(const uint8_t* a, const uint8_t* b) {
+#if defined(__SSE2__)
+  __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+  __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+  __m128i sad = _mm_sad_epu8(va, vb);
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(sad) +
+                               _mm_extract_epi16(sad, 4));
+#elif defined(__aarch64__)
+  return vaddlvq_u8(vabdq_u8(vld1q_u8(a), vld1q_u8(b)));
+#else
+  return SadScalar(a, b, 16);
+#endif
+}
+
+bool PlanesMatch(const uint8_t* a, const uint8_t* b, int stride, int width,
+                 int height, int block, uint32_t max_block_sad) {
+  const int full_blocks = width / block;
+  const int tail = width - full_blocks * block;
+  std::vector<uint32_t> sums(full_blocks + (tail > 0 ? 1 : 0));
+  for (int top = 0; top < height; top += block) {
+    std::fill(sums.begin(), sums.end(), 0);
+    const int rows = std::min(block, height - top);
+    for (int row = top; row < top + rows; ++row) {
+      const uint8_t* line_a = a + static_cast<size_t>(row) * stride;
+      const uint8_t* line_b = b + static_cast<size_t>(row) * stride;
+      for (int i = 0; i < full_blocks; ++i) {
+        const int x = i * block;
+        sums[i] += block == 16 ? Sad16(line_a + x, line_b + x)
+                               : Sad8(line_a + x, line_b + x);
+      }
+      if (tail > 0) {
+        const int x = full_blocks * block;
+        sums[full_blocks] += SadScalar(line_a + x, line_b + x, tail);
+      }
+    }
+    // Stop at the first block row with a change; moving content almost
+    // always differs near the top of the picture.
+    for (uint32_t sum : sums) {
+      if (sum > max_block_sad) return false;
+    }
+  }
+  return true;
+}
+
+StaticFrameDetector::StaticFrameDetector(StaticFrameDetectorConfig config)
+    : config_(config) {}
+
+bool StaticFrameDetector::ShouldSkip(const VideoFrame& frame) {
+  if (config_.min_refresh_fps <= 0) return false;
+
+  bool skip = false;
+  if (has_reference_ && reference_.width == frame.width &&
+      reference_.height == frame.height) {
+    const int64_t refresh_us =
+        static_cast<int64_t>(1000000 / config_.min_refresh_fps);
+    if (frame.pts_us - reference_.pts_us < refresh_us) {
+      const auto start = std::chrono::steady_clock::now();
+      const uint32_t chroma_sad = config_.max_block_sad / 4;
+      skip = PlanesMatch(frame.y(), reference_.y(), frame.y_stride(),
+                         frame.width, frame.height, 16,
+                         config_.max_block_sad) &&
+             PlanesMatch(frame.u(), reference_.u(), frame.uv_stride(),
+                         frame.uv_stride(), frame.uv_height(), 8,
+                         chroma_sad) &&
+             PlanesMatch(frame.v(), reference_.v(), frame.uv_stride(),
+                         frame.uv_stride(), frame.uv_height(), 8,
+                         chroma_sad);
+      stats_.compare_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+      ++stats_.frames_compared;
+    }
+  }
+
+  if (skip) {
+    ++stats_.frames_skipped;
+  } else {
+    reference_.width = frame.width;
+    reference_.height = frame.height;
+    reference_.pts_us = frame.pts_us;
+    reference_.data.assign(frame.data.begin(), frame.data.end());
+    has_reference_ = true;
+  }
+  return skip;
+}
+
+}  // namespace ivs_broadcaster
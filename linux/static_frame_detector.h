@@ -0,0 +1,60 @@
+#ifndef IVS_BROADCASTER_STATIC_FRAME_DETECTOR_H_
+#define IVS_BROADCASTER_STATIC_FRAME_DETECTOR_H_
+
+#include <cstdint>
+
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+struct StaticFrameDetectorConfig {
+  // A 16x16 luma block (8x8 chroma) whose sum of absolute differences exceeds
+  // this counts as changed. The default tolerates +-1 of sensor noise.
+  uint32_t max_block_sad = 256;
+  // Encode at least this often even when nothing changes, so players and the
+  // ingest keep seeing frames. Zero disables the detector.
+  double min_refresh_fps = 1.0;
+};
+
+struct StaticFrameStats {
+  uint64_t frames_compared = 0;
+  uint64_t frames_skipped = 0;
+  // Time spent comparing frames.
+  int64_t compare_us = 0;
+};
+
+// Detects frames identical to the last one sent to the encoder, so slide and
+// screen-style content does not pay for re-encoding the same picture.
+//
+// Frames are compared in blocks with SIMD sum-of-absolute-differences (SSE2
+// on x86-64, NEON on AArch64) and the comparison stops at the first changed
+// block row, so moving camera content costs little more than one block row.
+class StaticFrameDetector {
+ public:
+  explicit StaticFrameDetector(
+      StaticFrameDetectorConfig config = StaticFrameDetectorConfig());
+
+  // Returns true when |frame| can be skipped. Frames that are not skipped
+  // become the new reference.
+  bool ShouldSkip(const VideoFrame& frame);
+
+  const StaticFrameStats& stats() const { return stats_; }
+
+ private:
+  const StaticFrameDetectorConfig config_;
+  VideoFrame reference_;
+  bool has_reference_ = false;
+  StaticFrameStats stats_;
+};
+
+// Sum of absolute differences of two 16-byte rows.
+uint32_t Sad16(const uint8_t* a, const uint8_t* b);
+
+// Whether no |block| x |block| tile of the two planes differs by more than
+// |max_block_sad|. |block| is 16 for luma and 8 for chroma.
+bool PlanesMatch(const uint8_t* a, const uint8_t* b, int stride, int width,
+                 int height, int block, uint32_t max_block_sad);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_STATIC_FRAME_DETECTOR_H_
@@ -0,0 +1,244 @@
+#include "telemetry_block.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x49565354;  // "IVST"
+constexpr size_t kWordsPerSlot = kTelemetrySlotSize / sizeof(uint64_t);
+
+constexpr size_t kSourceOffset = 8;
+constexpr size_t kNameOffset = 16;
+constexpr size_t kCountersOffset = 48;
+constexpr size_t kGaugesOffset = 112;
+constexpr size_t kStatsOffset = 176;
+constexpr size_t kUpdatedOffset = 240;
+
+static_assert(kStatsOffset + kTelemetryRecordSize <= kUpdatedOffset,
+              "stats overlap the slot trailer");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "seqlock words must be lock-free to live in shared memory");
+
+template <typename T>
+void Put(uint8_t* out, size_t offset, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out[offset + i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >>
+                                           (8 * i));
+  }
+}
+
+template <typename T>
+T Get(const uint8_t* data, size_t offset) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+  }
+  return static_cast<T>(value);
+}
+
+uint64_t DoubleBits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double BitsDouble(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void EncodeSlot(const TelemetrySlot& slot, uint8_t out[kTelemetrySlotSize]) {
+  std::memset(out, 0, kTelemetrySlotSize);
+  Put<uint16_t>(out, kSourceOffset, static_cast<uint16_t>(slot.source));
+  std::memcpy(out + kNameOffset, slot.name.data(),
+              std::min(slot.name.size(), kTelemetryNameSize - 1));
+  for (int i = 0; i < kTelemetryCounterCount; ++i) {
+    Put<uint64_t>(out, kCountersOffset + 8 * i, slot.counters[i]);
+  }
+  for (int i = 0; i < kTelemetryGaugeCount; ++i) {
+    Put<uint64_t>(out, kGaugesOffset + 8 * i, DoubleBits(slot.gauges[i]));
+  }
+  if (slot.source != TelemetrySource::kNone) {
+    EncodeTelemetryRecord(slot.stats, out + kStatsOffset);
+  }
+  Put<int64_t>(out, kUpdatedOffset, slot.updated_us);
+}
+
+}  // namespace
+
+TelemetryBlock::TelemetryBlock(int fd, uint8_t* base, size_t size,
+                               int slot_count)
+    : fd_(fd),
+      base_(base),
+      size_(size),
+      slot_count_(slot_count),
+      slots_(slot_count) {
+  for (int i = 0; i < slot_count_; ++i) {
+    std::atomic<uint64_t>* words = SlotWords(i);
+    for (size_t w = 0; w < kWordsPerSlot; ++w) {
+      new (&words[w]) std::atomic<uint64_t>(0);
+    }
+  }
+  Put<uint32_t>(base_, 0, kMagic);
+  Put<uint16_t>(base_, 4, kTelemetryBlockVersion);
+  Put<uint16_t>(base_, 6, static_cast<uint16_t>(kTelemetrySlotSize));
+  Put<uint32_t>(base_, 8, static_cast<uint32_t>(slot_count_));
+}
+
+TelemetryBlock::~TelemetryBlock() {
+  munmap(base_, size_);
+  close(fd_);
+}
+
+std::unique_ptr<TelemetryBlock> TelemetryBlock::Create(int slot_count) {
+  if (slot_count <= 0) return nullptr;
+  const size_t size =
+      kTelemetryBlockHeaderSize + slot_count * kTelemetrySlotSize;
+  const int fd =
+      memfd_create("ivs_telemetry", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) return nullptr;
+  constexpr int kSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+      fcntl(fd, F_ADD_SEALS, kSeals) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+  return std::unique_ptr<TelemetryBlock>(new TelemetryBlock(
+      fd, static_cast<uint8_t*>(base), size, slot_count));
+}
+
+std::atomic<uint64_t>* TelemetryBlock::SlotWords(int slot) const {
+  return reinterpret_cast<std::atomic<uint64_t>*>(
+      base_ + kTelemetryBlockHeaderSize + slot * kTelemetrySlotSize);
+}
+
+int TelemetryBlock::Acquire(TelemetrySource source, const std::string& name) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  for (int i = 0; i < slot_count_; ++i) {
+    if (slots_[i].source != TelemetrySource::kNone) continue;
+    slots_[i] = TelemetrySlot();
+    slots_[i].source = source;
+    slots_[i].name = name.substr(0, kTelemetryNameSize - 1);
+    Publish(i);
+    return i;
+  }
+  return -1;
+}
+
+void TelemetryBlock::Release(int slot) {
+  Update(slot, [](TelemetrySlot* values) { *values = TelemetrySlot(); });
+}
+
+void TelemetryBlock::Publish(int slot) {
+  uint8_t bytes[kTelemetrySlotSize];
+  EncodeSlot(slots_[slot], bytes);
+  uint64_t values[kWordsPerSlot];
+  std::memcpy(values, bytes, sizeof(values));
+
+  std::atomic<uint64_t>* words = SlotWords(slot);
+  const uint64_t sequence = words[0].load(std::memory_order_relaxed);
+  words[0].store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t w = 1; w < kWordsPerSlot; ++w) {
+    words[w].store(values[w], std::memory_order_relaxed);
+  }
+  words[0].store(sequence + 2, std::memory_order_release);
+}
+
+bool TelemetryBlock::ReadRaw(int slot, uint8_t* out, int max_attempts) const {
+  if (slot < 0 || slot >= slot_count_) return false;
+  const std::atomic<uint64_t>* words = SlotWords(slot);
+  uint64_t values[kWordsPerSlot];
+  for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    const uint64_t before = words[0].load(std::memory_order_acquire);
+    if (before & 1) continue;
+    for (size_t w = 1; w < kWordsPerSlot; ++w) {
+      values[w] = words[w].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (words[0].load(std::memory_order_relaxed) != before) continue;
+    values[0] = before;
+    std::memcpy(out, values, sizeof(values));
+    return true;
+  }
+  return false;
+}
+
+bool TelemetryBlock::Read(int slot, TelemetrySlot* out) const {
+  uint8_t bytes[kTelemetrySlotSize];
+  return ReadRaw(slot, bytes) && DecodeTelemetrySlot(bytes, out);
+}
+
+int TelemetryBlock::Find(const std::string& name) const {
+  TelemetrySlot slot;
+  for (int i = 0; i < slot_count_; ++i) {
+    if (Read(i, &slot) && slot.source != TelemetrySource::kNone &&
+        slot.name == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool DecodeTelemetrySlot(const uint8_t* data, TelemetrySlot* slot) {
+  slot->source =
+      static_cast<TelemetrySource>(Get<uint16_t>(data, kSourceOffset));
+  const char* name = reinterpret_cast<const char*>(data + kNameOffset);
+  slot->name.assign(name, strnlen(name, kTelemetryNameSize));
+  for (int i = 0; i < kTelemetryCounterCount; ++i) {
+    slot->counters[i] = Get<uint64_t>(data, kCountersOffset + 8 * i);
+  }
+  for (int i = 0; i < kTelemetryGaugeCount; ++i) {
+    slot->gauges[i] = BitsDouble(Get<uint64_t>(data, kGaugesOffset + 8 * i));
+  }
+  slot->updated_us = Get<int64_t>(data, kUpdatedOffset);
+  if (slot->source == TelemetrySource::kNone) {
+    slot->stats = TelemetryRecord();
+    return true;
+  }
+  return DecodeTelemetryRecord(data + kStatsOffset, kTelemetryRecordSize,
+                               &slot->stats);
+}
+
+void SetFrameGovernorTelemetry(const FrameGovernorStats& stats,
+                               TelemetryRecord* record) {
+  const int64_t* latency = stats.stage_latency_us;
+  record->target_fps = static_cast<uint32_t>(stats.target_fps);
+  record->frames_dropped = stats.frames_dropped;
+  record->max_queue_depth = static_cast<uint32_t>(stats.max_queue_depth);
+  record->capture_latency_us = static_cast<uint32_t>(
+      latency[static_cast<int>(PipelineStage::kCapture)]);
+  record->encode_latency_us = static_cast<uint32_t>(
+      latency[static_cast<int>(PipelineStage::kEncode)]);
+  record->mux_latency_us =
+      static_cast<uint32_t>(latency[static_cast<int>(PipelineStage::kMux)]);
+}
+
+void SetFrameGovernorTelemetry(const FrameGovernorStats& stats,
+                               TelemetrySlot* slot) {
+  slot->counters[kTelemetryFramesCaptured] = stats.frames_in;
+  slot->counters[kTelemetryFramesDropped] = stats.frames_dropped;
+  slot->gauges[kTelemetryTargetFps] = stats.target_fps;
+  slot->gauges[kTelemetryQueueDepth] =
+      static_cast<double>(stats.max_queue_depth);
+  slot->gauges[kTelemetryEncodeLatencyMs] =
+      stats.stage_latency_us[static_cast<int>(PipelineStage::kEncode)] /
+      1000.0;
+  SetFrameGovernorTelemetry(stats, &slot->stats);
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,166 @@
+#ifndef IVS_BROADCASTER_TELEMETRY_BLOCK_H_
+#define IVS_BROADCASTER_TELEMETRY_BLOCK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_governor.h"
+#include "telemetry_record.h"
+
+namespace ivs_broadcaster {
+
+// What a telemetry slot describes.
+enum class TelemetrySource : uint16_t {
+  kNone = 0,
+  kBroadcastSession = 1,
+  kPlayer = 2,
+};
+
+// Monotonic totals kept per slot.
+enum TelemetryCounter {
+  kTelemetryFramesCaptured = 0,
+  kTelemetryFramesDropped = 1,
+  kTelemetryFramesEncoded = 2,
+  kTelemetryFramesSkipped = 3,
+  kTelemetryStateChanges = 4,
+  kTelemetryErrors = 5,
+  kTelemetryCounterCount = 8,
+};
+
+// Current values kept per slot.
+enum TelemetryGauge {
+  kTelemetryState = 0,
+  kTelemetryTargetFps = 1,
+  kTelemetryQueueDepth = 2,
+  kTelemetryEncodeLatencyMs = 3,
+  kTelemetryGaugeCount = 8,
+};
+
+// The totals of a player slot, which mirror the MediaPlayerStats of the
+// selected player and so start over when another is selected. State changes
+// and errors keep the indices above.
+enum TelemetryPlayerCounter {
+  kTelemetryPackets = 0,
+  kTelemetryFramesDecoded = 1,
+  kTelemetryFramesShown = 2,
+  kTelemetryPacketsSkipped = 3,
+  kTelemetrySwitches = 6,
+  kTelemetrySeeks = 7,
+};
+
+// The current values of a player slot. The state keeps its index above.
+enum TelemetryPlayerGauge {
+  kTelemetryPlaybackRate = 1,
+  kTelemetryPositionMs = 2,
+  kTelemetryBufferedMs = 3,
+  kTelemetryLiveLatencyMs = 4,
+  kTelemetryDurationMs = 5,
+  kTelemetryDecodeMs = 6,
+  kTelemetrySwitchLatencyMs = 7,
+};
+
+// Everything published for one session or player.
+struct TelemetrySlot {
+  TelemetrySource source = TelemetrySource::kNone;
+  std::string name;
+  int64_t updated_us = 0;
+  uint64_t counters[kTelemetryCounterCount] = {};
+  double gauges[kTelemetryGaugeCount] = {};
+  // The latest high-rate statistics, as also sent on the event channel.
+  TelemetryRecord stats;
+};
+
+constexpr uint16_t kTelemetryBlockVersion = 1;
+constexpr size_t kTelemetryBlockHeaderSize = 64;
+constexpr size_t kTelemetrySlotSize = 256;
+constexpr size_t kTelemetryNameSize = 32;
+
+// Telemetry in a memory-mapped block that readers poll instead of receiving
+// messages: Dart reads it synchronously through FFI (see telemetry_ffi.h)
+// every frame without touching the method or event channels.
+//
+// Each slot is guarded by a seqlock. Writers never wait for readers; a
+// reader copies the slot and retries if the sequence moved or was odd while
+// it copied, so it always sees one consistent update.
+//
+// Slot layout, little-endian (mirrored by the Dart TelemetryBlock reader):
+//     0 u64 sequence (odd while an update is in progress)
+//     8 u16 source             16 char name[32], NUL padded
+//    48 u64 counters[8]       112 f64 gauges[8]
+//   176 u8  stats[64] (a TelemetryRecord, see telemetry_record.h)
+//   240 i64 updated_us
+//
+// The block lives in a sealed-size memfd, so it can also be handed to a
+// helper process (see SendRingFd()) and read there.
+class TelemetryBlock {
+ public:
+  ~TelemetryBlock();
+
+  TelemetryBlock(const TelemetryBlock&) = delete;
+  TelemetryBlock& operator=(const TelemetryBlock&) = delete;
+
+  // Returns nullptr when the memfd cannot be created or mapped.
+  static std::unique_ptr<TelemetryBlock> Create(int slot_count);
+
+  int fd() const { return fd_; }
+  int slot_count() const { return slot_count_; }
+
+  // Claims a free slot and publishes |source| and |name| in it. Returns -1
+  // when every slot is taken.
+  int Acquire(TelemetrySource source, const std::string& name);
+  // Clears |slot| so readers stop finding it.
+  void Release(int slot);
+
+  // Applies |update| to the writer's copy of |slot| and publishes it. May be
+  // called from any thread; writers are serialised, readers are not.
+  template <typename Fn>
+  void Update(int slot, Fn&& update) {
+    if (slot < 0 || slot >= slot_count_) return;
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    update(&slots_[slot]);
+    Publish(slot);
+  }
+
+  // Copies a consistent snapshot of |slot| into |out|, which must hold
+  // kTelemetrySlotSize bytes. Gives up after |max_attempts| torn reads.
+  bool ReadRaw(int slot, uint8_t* out, int max_attempts = 64) const;
+  bool Read(int slot, TelemetrySlot* out) const;
+
+  // Index of the slot published under |name|, or -1.
+  int Find(const std::string& name) const;
+
+ private:
+  TelemetryBlock(int fd, uint8_t* base, size_t size, int slot_count);
+
+  std::atomic<uint64_t>* SlotWords(int slot) const;
+  void Publish(int slot);
+
+  const int fd_;
+  uint8_t* const base_;
+  const size_t size_;
+  const int slot_count_;
+
+  std::mutex write_mutex_;
+  // Writer-side copies of every slot, guarded by |write_mutex_|.
+  std::vector<TelemetrySlot> slots_;
+};
+
+// Parses a slot copied by ReadRaw(). Returns false for a malformed record.
+bool DecodeTelemetrySlot(const uint8_t* data, TelemetrySlot* slot);
+
+// Copies the frame governor fields of |stats| into |record|.
+void SetFrameGovernorTelemetry(const FrameGovernorStats& stats,
+                               TelemetryRecord* record);
+// Copies |stats| into the counters, gauges and record of a broadcast session
+// slot.
+void SetFrameGovernorTelemetry(const FrameGovernorStats& stats,
+                               TelemetrySlot* slot);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_TELEMETRY_BLOCK_H_
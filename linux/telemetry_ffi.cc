@@ -0,0 +1,41 @@
+#include "include/ivs_broadcaster/ivs_telemetry.h"
+
+#include "telemetry_ffi.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Enough for the broadcaster and a handful of players.
+constexpr int kTelemetrySlots = 16;
+
+}  // namespace
+
+TelemetryBlock* ProcessTelemetryBlock() {
+  // Intentionally leaked: Dart may read it until the process exits.
+  static TelemetryBlock* block =
+      TelemetryBlock::Create(kTelemetrySlots).release();
+  return block;
+}
+
+}  // namespace ivs_broadcaster
+
+int32_t ivs_telemetry_slot_count(void) {
+  ivs_broadcaster::TelemetryBlock* block =
+      ivs_broadcaster::ProcessTelemetryBlock();
+  return block != nullptr ? block->slot_count() : 0;
+}
+
+int32_t ivs_telemetry_slot_size(void) {
+  return static_cast<int32_t>(ivs_broadcaster::kTelemetrySlotSize);
+}
+
+int32_t ivs_telemetry_read(int32_t slot, uint8_t* out, int32_t size) {
+  ivs_broadcaster::TelemetryBlock* block =
+      ivs_broadcaster::ProcessTelemetryBlock();
+  if (block == nullptr || out == nullptr ||
+      size < static_cast<int32_t>(ivs_broadcaster::kTelemetrySlotSize)) {
+    return 0;
+  }
+  return block->ReadRaw(slot, out) ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#ifndef IVS_BROADCASTER_TELEMETRY_FFI_H_
+#define IVS_BROADCASTER_TELEMETRY_FFI_H_
+
+#include "telemetry_block.h"
+
+namespace ivs_broadcaster {
+
+// The telemetry block read by the ivs_telemetry_* FFI functions, created on
+// first use and shared by every plugin instance in the process. Returns
+// nullptr when the block cannot be created; callers then skip publishing.
+TelemetryBlock* ProcessTelemetryBlock();
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_TELEMETRY_FFI_H_
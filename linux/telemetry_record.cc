@@ -0,0 +1,66 @@
+#include "telemetry_record.h"
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// Byte-wise so the wire format does not depend on host endianness or struct
+// padding.
+template <typename T>
+void Put(uint8_t* out, size_t offset, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    out[offset + i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >>
+                                           (8 * i));
+  }
+}
+
+template <typename T>
+T Get(const uint8_t* data, size_t offset) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+  }
+  return static_cast<T>(value);
+}
+
+}  // namespace
+
+void EncodeTelemetryRecord(const TelemetryRecord& record,
+                           uint8_t out[kTelemetryRecordSize]) {
+  Put<uint16_t>(out, 0, kTelemetryRecordVersion);
+  Put<uint16_t>(out, 2, record.changed);
+  Put<uint32_t>(out, 4, record.target_fps);
+  Put<int64_t>(out, 8, record.timestamp_us);
+  Put<uint64_t>(out, 16, record.frames_dropped);
+  Put<uint32_t>(out, 24, record.max_queue_depth);
+  Put<uint32_t>(out, 28, record.encode_latency_us);
+  Put<uint64_t>(out, 32, record.frames_encoded);
+  Put<uint64_t>(out, 40, record.frames_skipped);
+  Put<uint32_t>(out, 48, record.compare_time_us);
+  Put<uint32_t>(out, 52, record.encode_time_saved_us);
+  Put<uint32_t>(out, 56, record.capture_latency_us);
+  Put<uint32_t>(out, 60, record.mux_latency_us);
+}
+
+bool DecodeTelemetryRecord(const uint8_t* data, size_t size,
+                           TelemetryRecord* record) {
+  if (size < kTelemetryRecordSize ||
+      Get<uint16_t>(data, 0) != kTelemetryRecordVersion) {
+    return false;
+  }
+  record->changed = Get<uint16_t>(data, 2);
+  record->target_fps = Get<uint32_t>(data, 4);
+  record->timestamp_us = Get<int64_t>(data, 8);
+  record->frames_dropped = Get<uint64_t>(data, 16);
+  record->max_queue_depth = Get<uint32_t>(data, 24);
+  record->encode_latency_us = Get<uint32_t>(data, 28);
+  record->frames_encoded = Get<uint64_t>(data, 32);
+  record->frames_skipped = Get<uint64_t>(data, 40);
+  record->compare_time_us = Get<uint32_t>(data, 48);
+  record->encode_time_saved_us = Get<uint32_t>(data, 52);
+  record->capture_latency_us = Get<uint32_t>(data, 56);
+  record->mux_latency_us = Get<uint32_t>(data, 60);
+  return true;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,60 @@
+#ifndef IVS_BROADCASTER_TELEMETRY_RECORD_H_
+#define IVS_BROADCASTER_TELEMETRY_RECORD_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ivs_broadcaster {
+
+// Which parts of a TelemetryRecord changed since the previous event.
+enum TelemetryField : uint16_t {
+  kTelemetryFrameRate = 1 << 0,
+  kTelemetryEncode = 1 << 1,
+};
+
+// High-rate broadcaster statistics, sent to Dart as a fixed-layout binary
+// record instead of a map of named values. The record is filled in place
+// and encoded into a caller-provided buffer without allocating; on the wire
+// it is a single Uint8List of kTelemetryRecordSize bytes. See
+// test/telemetry_benchmark.cc for the cost of the whole event path.
+//
+// Layout, little-endian (mirrored by the Dart TelemetryRecord parser):
+//    0 u16 version             2 u16 changed (TelemetryField bits)
+//    4 u32 target_fps          8 i64 timestamp_us
+//   16 u64 frames_dropped     24 u32 max_queue_depth
+//   28 u32 encode_latency_us  32 u64 frames_encoded
+//   40 u64 frames_skipped     48 u32 compare_time_us
+//   52 u32 encode_time_saved_us
+//   56 u32 capture_latency_us 60 u32 mux_latency_us
+struct TelemetryRecord {
+  uint16_t changed = 0;
+  int64_t timestamp_us = 0;
+
+  // Frame governor state.
+  uint32_t target_fps = 0;
+  uint64_t frames_dropped = 0;
+  uint32_t max_queue_depth = 0;
+  uint32_t capture_latency_us = 0;
+  uint32_t encode_latency_us = 0;
+  uint32_t mux_latency_us = 0;
+
+  // Encoder work over the last stats period.
+  uint64_t frames_encoded = 0;
+  uint64_t frames_skipped = 0;
+  uint32_t compare_time_us = 0;
+  uint32_t encode_time_saved_us = 0;
+};
+
+constexpr uint16_t kTelemetryRecordVersion = 1;
+constexpr size_t kTelemetryRecordSize = 64;
+
+void EncodeTelemetryRecord(const TelemetryRecord& record,
+                           uint8_t out[kTelemetryRecordSize]);
+
+// Returns false for short buffers or unknown versions.
+bool DecodeTelemetryRecord(const uint8_t* data, size_t size,
+                           TelemetryRecord* record);
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_TELEMETRY_RECORD_H_
@@ -0,0 +1,231 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "abr_controller.h"
+#include "abr_simulator.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+std::vector<AbrRendition> Ladder() {
+  return {{"1080p", 6000000, 1920, 1080},
+          {"240p", 400000, 426, 240},
+          {"720p", 3000000, 1280, 720},
+          {"360p", 800000, 640, 360},
+          {"480p", 1600000, 854, 480}};
+}
+
+AbrInput Input(const std::vector<AbrRendition>& ladder, int current,
+               int64_t buffer_us, int64_t throughput_bps) {
+  AbrInput input;
+  input.ladder = &ladder;
+  input.current = current;
+  input.buffer_us = buffer_us;
+  input.throughput_bps = throughput_bps;
+  input.segment_duration_us = 2000000;
+  return input;
+}
+
+// Seconds at a rate, repeated.
+std::vector<BandwidthSample> Trace(
+    const std::vector<std::pair<double, double>>& seconds_at_mbps) {
+  std::vector<BandwidthSample> trace;
+  for (const auto& [seconds, mbps] : seconds_at_mbps) {
+    trace.push_back({static_cast<int64_t>(seconds * 1e6),
+                     static_cast<int64_t>(mbps * 1e6)});
+  }
+  return trace;
+}
+
+// A mobile-like trace: a random walk around 3 Mbps with short fades.
+std::vector<BandwidthSample> MobileTrace() {
+  std::mt19937 random(7);
+  std::normal_distribution<double> step(0, 0.6);
+  std::vector<std::pair<double, double>> samples;
+  double mbps = 3;
+  for (int i = 0; i < 300; ++i) {
+    mbps = std::clamp(mbps + step(random), 0.8, 7.0);
+    samples.push_back({1, i % 37 == 36 ? 0.2 : mbps});
+  }
+  return Trace(samples);
+}
+
+}  // namespace
+
+TEST(AbrController, ThroughputPolicyKeepsAMargin) {
+  std::vector<AbrRendition> ladder = Ladder();
+  AbrController sorter(AbrConfig(), nullptr);
+  sorter.SetLadder(ladder);
+  ladder = sorter.ladder();
+  ASSERT_EQ(ladder.front().name, "240p");
+  ThroughputAbrPolicy policy(0.9);
+  EXPECT_EQ(policy.Choose(Input(ladder, -1, 0, 100000)).index, 0);
+  EXPECT_EQ(policy.Choose(Input(ladder, 0, 0, 3300000)).index, 2);
+  EXPECT_EQ(policy.Choose(Input(ladder, 0, 0, 3400000)).index, 3);
+  EXPECT_EQ(policy.Choose(Input(ladder, 0, 0, 100000000)).index, 4);
+}
+
+TEST(AbrController, BolaClimbsWithTheBufferButNotPastTheThroughput) {
+  AbrController sorter(AbrConfig(), nullptr);
+  sorter.SetLadder(Ladder());
+  const std::vector<AbrRendition> ladder = sorter.ladder();
+  BolaAbrPolicy policy;
+  // Shallow buffer: throughput decides.
+  AbrChoice choice = policy.Choose(Input(ladder, -1, 0, 2000000));
+  EXPECT_EQ(choice.index, 2);
+  EXPECT_STREQ(choice.reason, "throughput");
+  // Deep buffer with plenty of throughput: the buffer decides, from the
+  // bottom at the minimum buffer to the top at the target.
+  int previous = 0;
+  for (int64_t buffer_us = 6000000; buffer_us <= 12000000;
+       buffer_us += 1000000) {
+    choice = policy.Choose(Input(ladder, 4, buffer_us, 50000000));
+    EXPECT_STREQ(choice.reason, "buffer");
+    EXPECT_GE(choice.index, previous);
+    previous = choice.index;
+  }
+  EXPECT_EQ(previous, 4);
+  // A throughput dip does not move it down while the buffer holds...
+  choice = policy.Choose(Input(ladder, 4, 12000000, 1000000));
+  EXPECT_EQ(choice.index, 4);
+  // ...nor up past what the throughput sustains.
+  choice = policy.Choose(Input(ladder, 1, 12000000, 1000000));
+  EXPECT_EQ(choice.index, 1);
+  EXPECT_STREQ(choice.reason, "buffer, capped");
+  // Once the buffer runs low, throughput decides again.
+  choice = policy.Choose(Input(ladder, 4, 2000000, 1000000));
+  EXPECT_EQ(choice.index, 1);
+  EXPECT_STREQ(choice.reason, "throughput");
+}
+
+TEST(AbrController, EstimatesThroughputFromDownloads) {
+  AbrConfig config;
+  ThroughputEstimator estimator(config);
+  EXPECT_EQ(estimator.estimate_bps(), config.initial_bandwidth_bps);
+  // Too small to say anything.
+  estimator.AddSample(1000, 1000);
+  EXPECT_EQ(estimator.estimate_bps(), config.initial_bandwidth_bps);
+  for (int i = 0; i < 5; ++i) estimator.AddSample(500000, 1000000);
+  EXPECT_NEAR(estimator.estimate_bps(), 4000000, 1000);
+  // A slow download pulls the estimate down at once; fast ones bring it
+  // back up gradually.
+  estimator.AddSample(500000, 4000000);
+  const int64_t dropped = estimator.estimate_bps();
+  EXPECT_LT(dropped, 3000000);
+  estimator.AddSample(500000, 1000000);
+  EXPECT_GT(estimator.estimate_bps(), dropped);
+  EXPECT_LT(estimator.estimate_bps(), 4000000);
+}
+
+TEST(AbrController, PinsManualChoicesAndReportsDecisions) {
+  AbrController controller(AbrConfig(),
+                           std::make_unique<ThroughputAbrPolicy>());
+  controller.SetLadder(Ladder());
+  std::vector<AbrDecision> decisions;
+  controller.SetCallback(
+      [&decisions](const AbrDecision& decision) {
+        decisions.push_back(decision);
+      });
+  AbrDecision decision = controller.Decide(0, 2000000);
+  // The initial estimate of 1 Mbps.
+  EXPECT_EQ(decision.rendition.name, "360p");
+  EXPECT_EQ(decision.previous, -1);
+  EXPECT_TRUE(decision.automatic);
+
+  EXPECT_FALSE(controller.SetManual("4k"));
+  ASSERT_TRUE(controller.SetManual("1080p"));
+  EXPECT_FALSE(controller.automatic());
+  decision = controller.Decide(0, 2000000);
+  EXPECT_EQ(decision.rendition.name, "1080p");
+  EXPECT_EQ(decision.reason, "manual");
+  EXPECT_TRUE(decision.switched());
+
+  controller.SetAutomatic(true);
+  decision = controller.Decide(0, 2000000);
+  EXPECT_EQ(decision.rendition.name, "360p");
+  EXPECT_EQ(decision.reason, "throughput");
+  ASSERT_EQ(decisions.size(), 3u);
+  EXPECT_EQ(decisions[1].previous, 1);
+  EXPECT_EQ(decisions[2].previous, 4);
+
+  // Turning automatic choice off keeps what plays.
+  controller.SetAutomatic(false);
+  for (int i = 0; i < 5; ++i) controller.OnDownload(5000000, 1000000);
+  EXPECT_EQ(controller.Decide(0, 2000000).rendition.name, "360p");
+}
+
+TEST(AbrController, CapsAutomaticChoicesAtTheResolutionNeeded) {
+  AbrController controller(AbrConfig(),
+                           std::make_unique<ThroughputAbrPolicy>());
+  controller.SetLadder(Ladder());
+  for (int i = 0; i < 5; ++i) controller.OnDownload(5000000, 1000000);
+  EXPECT_EQ(controller.Decide(0, 2000000).rendition.name, "1080p");
+
+  // A 640x360 tile needs no more than 360p; one a little larger takes the
+  // next rendition up rather than stretching 360p.
+  controller.SetMaxResolution(640, 360);
+  AbrDecision decision = controller.Decide(0, 2000000);
+  EXPECT_EQ(decision.rendition.name, "360p");
+  EXPECT_EQ(decision.reason, "resolution cap");
+  controller.SetMaxResolution(700, 360);
+  EXPECT_EQ(controller.Decide(0, 2000000).rendition.name, "480p");
+
+  // A pinned rendition is the user's call.
+  ASSERT_TRUE(controller.SetManual("720p"));
+  EXPECT_EQ(controller.Decide(0, 2000000).rendition.name, "720p");
+  controller.SetAutomatic(true);
+  controller.SetMaxResolution(0, 0);
+  EXPECT_EQ(controller.Decide(0, 2000000).rendition.name, "1080p");
+}
+
+// Replays traces against both policies. On a steady link both settle on
+// what it sustains; where the throughput swings, BOLA rides the swings out
+// on its buffer instead of following them.
+TEST(AbrController, SimulatesTraces) {
+  struct Case {
+    const char* name;
+    std::vector<BandwidthSample> trace;
+  };
+  const std::vector<Case> cases = {
+      {"steady 4 Mbps", Trace({{10, 4}})},
+      {"2 s swings 1.5/6 Mbps", Trace({{2, 6}, {2, 1.5}})},
+      {"8 Mbps, 1.5 Mbps for 60 s", Trace({{60, 8}, {60, 1.5}})},
+      {"4 Mbps, 5 s outages", Trace({{25, 4}, {5, 0.1}})},
+      {"mobile", MobileTrace()},
+  };
+  AbrSimulationConfig config;
+  for (const Case& test_case : cases) {
+    const AbrSimulationResult throughput =
+        SimulateAbr(Ladder(), test_case.trace, config,
+                    std::make_unique<ThroughputAbrPolicy>());
+    const AbrSimulationResult bola = SimulateAbr(
+        Ladder(), test_case.trace, config, std::make_unique<BolaAbrPolicy>());
+    for (const auto& [policy, result] :
+         {std::make_pair("throughput", &throughput),
+          std::make_pair("bola", &bola)}) {
+      std::printf(
+          "%-28s %-10s startup %.2f s, rebuffer %.2f s (%d), average %.2f "
+          "Mbps, %d switches\n",
+          test_case.name, policy, result->startup_us / 1e6,
+          result->rebuffer_us / 1e6, result->rebuffers,
+          result->average_bitrate / 1e6, result->switches);
+    }
+    EXPECT_EQ(bola.choices.size(), static_cast<size_t>(config.segments));
+    EXPECT_LE(bola.rebuffer_us, throughput.rebuffer_us) << test_case.name;
+    EXPECT_LE(bola.switches, throughput.switches) << test_case.name;
+    EXPECT_GT(bola.average_bitrate, throughput.average_bitrate * 0.95)
+        << test_case.name;
+  }
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "color_convert.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+uint8_t Reference(double value) {
+  return static_cast<uint8_t>(std::min(255.0, std::max(0.0, value + 0.5)));
+}
+
+}  // namespace
+
+// Odd sizes exercise the SIMD body, the scalar tail and the last chroma
+// column and row.
+TEST(ColorConvert, MatchesBt601WithinRounding) {
+  constexpr int kWidth = 37;
+  constexpr int kHeight = 5;
+  VideoFrame frame;
+  frame.Allocate(kWidth, kHeight);
+  uint32_t noise = 12345;
+  for (auto& byte : frame.data) {
+    noise = noise * 1103515245u + 12345u;
+    byte = static_cast<uint8_t>(noise >> 16);
+  }
+  // Include the extremes, which saturate the fixed-point sums.
+  frame.y()[0] = 255;
+  frame.u()[0] = 255;
+  frame.v()[0] = 255;
+  frame.y()[2] = 0;
+  frame.u()[1] = 0;
+  frame.v()[1] = 0;
+
+  std::vector<uint8_t> rgba(kWidth * kHeight * 4);
+  I420ToRgba(frame.y(), frame.y_stride(), frame.u(), frame.v(),
+             frame.uv_stride(), kWidth, kHeight, rgba.data(), kWidth * 4);
+
+  for (int row = 0; row < kHeight; ++row) {
+    for (int x = 0; x < kWidth; ++x) {
+      const double luma = 1.164 * (frame.y()[row * kWidth + x] - 16);
+      const int chroma = (row / 2) * frame.uv_stride() + x / 2;
+      const double cb = frame.u()[chroma] - 128;
+      const double cr = frame.v()[chroma] - 128;
+      const uint8_t* pixel = &rgba[(row * kWidth + x) * 4];
+      SCOPED_TRACE(testing::Message() << "x " << x << " row " << row);
+      EXPECT_LE(std::abs(pixel[0] - Reference(luma + 1.596 * cr)), 3);
+      EXPECT_LE(
+          std::abs(pixel[1] - Reference(luma - 0.391 * cb - 0.813 * cr)), 3);
+      EXPECT_LE(std::abs(pixel[2] - Reference(luma + 2.018 * cb)), 3);
+      EXPECT_EQ(pixel[3], 255);
+    }
+  }
+}
+
+TEST(ColorConvert, Benchmark1080p) {
+  VideoFrame frame;
+  SyntheticFrameSource(1920, 1080, 30).Next(&frame);
+  std::vector<uint8_t> rgba(1920 * 1080 * 4);
+  constexpr int kIterations = 50;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    I420ToRgba(frame.y(), frame.y_stride(), frame.u(), frame.v(),
+               frame.uv_stride(), frame.width, frame.height, rgba.data(),
+               frame.width * 4);
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("1080p I420 to RGBA: %.2f ms per frame\n",
+              elapsed.count() / kIterations);
+  EXPECT_EQ(rgba[3], 255);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
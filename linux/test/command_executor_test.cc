@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "command_executor.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+TEST(CommandExecutor, SerialisesCommandsInOneLane) {
+  CommandExecutor executor(4);
+  std::atomic<int> running{0};
+  std::atomic<int> overlaps{0};
+  std::mutex order_mutex;
+  std::vector<int> order;
+  std::vector<std::future<void>> done;
+  for (int i = 0; i < 50; ++i) {
+    done.push_back(executor.Submit("/dev/video0", "setupSession", [&, i] {
+      if (++running > 1) ++overlaps;
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(i);
+      }
+      --running;
+    }));
+  }
+  for (auto& future : done) future.get();
+  EXPECT_EQ(overlaps, 0);
+  ASSERT_EQ(order.size(), 50u);
+  for (int i = 0; i < 50; ++i) EXPECT_EQ(order[i], i);
+}
+
+TEST(CommandExecutor, RunsLanesInParallel) {
+  CommandExecutor executor(2);
+  std::promise<void> camera_started;
+  std::promise<void> release_camera;
+  std::shared_future<void> release = release_camera.get_future().share();
+  executor.Post("camera", "updateCameraType", [&] {
+    camera_started.set_value();
+    release.wait();
+  });
+  camera_started.get_future().wait();
+  // The camera lane is blocked; another lane must still make progress.
+  std::future<int> other =
+      executor.Submit("files", "deleteCapture", [] { return 7; });
+  ASSERT_EQ(other.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  EXPECT_EQ(other.get(), 7);
+  // A second camera command waits behind the first.
+  std::future<void> queued =
+      executor.Submit("camera", "setZoom", [] {});
+  EXPECT_EQ(queued.wait_for(std::chrono::milliseconds(20)),
+            std::future_status::timeout);
+  release_camera.set_value();
+  EXPECT_EQ(queued.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+}
+
+TEST(CommandExecutor, RecordsWaitAndRunTimePerMethod) {
+  CommandExecutor executor(1);
+  std::vector<std::future<void>> done;
+  for (int i = 0; i < 3; ++i) {
+    done.push_back(executor.Submit("session", "startPreview", [] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }));
+  }
+  done.push_back(executor.Submit("session", "stopBroadcast", [] {}));
+  for (auto& future : done) future.get();
+  // Stats are updated just after the work returns.
+  while (executor.pending() > 0) std::this_thread::yield();
+
+  const auto stats = executor.stats();
+  ASSERT_EQ(stats.count("startPreview"), 1u);
+  const CommandStats& start = stats.at("startPreview");
+  EXPECT_EQ(start.count, 3u);
+  EXPECT_GE(start.total_run, std::chrono::milliseconds(15));
+  EXPECT_GE(start.max_run, std::chrono::milliseconds(5));
+  // The third waited behind two 5 ms commands.
+  EXPECT_GE(start.max_wait, std::chrono::milliseconds(10));
+  const CommandStats& stop = stats.at("stopBroadcast");
+  EXPECT_EQ(stop.count, 1u);
+  EXPECT_GE(stop.total_wait, std::chrono::milliseconds(15));
+  std::printf("startPreview: %lld us waiting, %lld us running\n",
+              static_cast<long long>(start.total_wait.count()),
+              static_cast<long long>(start.total_run.count()));
+}
+
+TEST(CommandExecutor, PropagatesExceptionsThroughFutures) {
+  CommandExecutor executor(1);
+  std::future<int> failed = executor.Submit(
+      "session", "startBroadcast",
+      []() -> int { throw std::runtime_error("no camera"); });
+  EXPECT_THROW(failed.get(), std::runtime_error);
+  EXPECT_EQ(executor.Submit("session", "stopBroadcast", [] { return 1; })
+                .get(),
+            1);
+}
+
+TEST(CommandExecutor, FinishesPostedCommandsOnDestruction) {
+  std::atomic<int> ran{0};
+  {
+    CommandExecutor executor(2);
+    for (int i = 0; i < 20; ++i) {
+      executor.Post(i % 2 ? "a" : "b", "work", [&ran] {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++ran;
+      });
+    }
+  }
+  EXPECT_EQ(ran, 20);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cue_index.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+MetadataCue Cue(int64_t start_ms, int64_t end_ms) {
+  return {start_ms * 1000, end_ms * 1000, std::to_string(start_ms)};
+}
+
+std::vector<std::string> Texts(const std::vector<MetadataCue>& cues) {
+  std::vector<std::string> texts;
+  for (const MetadataCue& cue : cues) texts.push_back(cue.text);
+  return texts;
+}
+
+}  // namespace
+
+TEST(CueIndex, FindsOverlappingCuesInOrder) {
+  CueIndex index;
+  // Added out of order, with a long cue spanning the others.
+  for (const MetadataCue& cue :
+       {Cue(500, 600), Cue(100, 200), Cue(0, 1000), Cue(300, 300),
+        Cue(250, 400), Cue(700, 800)}) {
+    EXPECT_TRUE(index.Add(cue));
+  }
+  EXPECT_EQ(Texts(index.Overlapping(280000, 350000)),
+            (std::vector<std::string>{"0", "250", "300"}));
+  EXPECT_EQ(Texts(index.Overlapping(610000, 690000)),
+            (std::vector<std::string>{"0"}));
+  EXPECT_TRUE(index.Overlapping(1500000, 2000000).empty());
+  EXPECT_EQ(index.Overlapping(0, 1000000).size(), 6u);
+}
+
+TEST(CueIndex, ActiveAtExcludesEndedCuesButKeepsInstants) {
+  CueIndex index;
+  index.Add(Cue(100, 200));
+  index.Add(Cue(200, 300));
+  index.Add(Cue(200, 200));
+  index.Add(Cue(50, 150));
+  EXPECT_EQ(Texts(index.ActiveAt(200 * 1000)),
+            (std::vector<std::string>{"200", "200"}));
+  EXPECT_EQ(Texts(index.ActiveAt(120 * 1000)),
+            (std::vector<std::string>{"50", "100"}));
+}
+
+TEST(CueIndex, StartingReturnsWhatPlaybackReaches) {
+  CueIndex index;
+  for (int64_t ms = 0; ms < 1000; ms += 100) index.Add(Cue(ms, ms + 500));
+  EXPECT_EQ(Texts(index.Starting(100 * 1000, 300 * 1000)),
+            (std::vector<std::string>{"200", "300"}));
+  EXPECT_TRUE(index.Starting(950 * 1000, 2000 * 1000).empty());
+}
+
+TEST(CueIndex, IgnoresDuplicatesAndEvictsTheEarliest) {
+  CueIndex index(3);
+  EXPECT_TRUE(index.Add(Cue(100, 200)));
+  EXPECT_FALSE(index.Add(Cue(100, 200)));
+  // Same times, other text.
+  EXPECT_TRUE(index.Add({100000, 200000, "other"}));
+  EXPECT_TRUE(index.Add(Cue(300, 400)));
+  EXPECT_TRUE(index.Add(Cue(0, 50)));
+  const CueIndexStats stats = index.stats();
+  EXPECT_EQ(stats.cues, 3u);
+  EXPECT_EQ(stats.duplicates, 1u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(index.Overlapping(0, 1000 * 1000).front().start_us, 100000);
+}
+
+TEST(CueIndex, MatchesABruteForceScan) {
+  std::mt19937 random(7);
+  std::uniform_int_distribution<int64_t> start(0, 3600 * 1000);
+  std::uniform_int_distribution<int64_t> length(0, 30 * 1000);
+  CueIndex index(50000);
+  std::vector<MetadataCue> all;
+  for (int i = 0; i < 50000; ++i) {
+    const int64_t start_ms = start(random);
+    const MetadataCue cue = Cue(start_ms, start_ms + length(random));
+    if (index.Add(cue)) all.push_back(cue);
+  }
+  using Clock = std::chrono::steady_clock;
+  Clock::duration indexed{};
+  Clock::duration scanned{};
+  for (int i = 0; i < 1000; ++i) {
+    const int64_t from_us = start(random) * 1000;
+    const int64_t to_us = from_us + length(random) * 1000;
+    const auto begin = Clock::now();
+    const std::vector<MetadataCue> cues = index.Overlapping(from_us, to_us);
+    const auto middle = Clock::now();
+    size_t expected = 0;
+    for (const MetadataCue& cue : all) {
+      if (cue.start_us <= to_us && cue.end_us >= from_us) ++expected;
+    }
+    scanned += Clock::now() - middle;
+    indexed += middle - begin;
+    ASSERT_EQ(cues.size(), expected) << i;
+  }
+  using Ms = std::chrono::duration<double, std::milli>;
+  std::printf("1000 range queries over 50000 cues: %.2f ms in the tree, "
+              "%.1f ms scanning\n",
+              Ms(indexed).count(), Ms(scanned).count());
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,279 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "decode_pool.h"
+#include "frame_pool.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int kWidth = 1280;
+constexpr int kHeight = 720;
+// Rows of luma per slice job; 720p in 8 slices.
+constexpr int kSliceRows = kHeight / 8;
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Stands in for reconstructing the rows of one slice: a few integer
+// operations per pixel, dependent on the frame number so that every frame
+// differs.
+void DecodeSlice(int frame_number, int slice, VideoFrame* frame) {
+  const int first = slice * kSliceRows;
+  for (int row = first; row < first + kSliceRows; ++row) {
+    uint8_t* y = frame->y() + row * frame->y_stride();
+    uint32_t state = static_cast<uint32_t>(frame_number * 7919 + row);
+    for (int x = 0; x < kWidth; ++x) {
+      for (int round = 0; round < 4; ++round) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+      }
+      y[x] = static_cast<uint8_t>(state);
+    }
+    if (row % 2 == 0) {
+      const int uv_row = row / 2;
+      for (int x = 0; x < frame->uv_stride(); ++x) {
+        frame->u()[uv_row * frame->uv_stride() + x] = y[2 * x];
+        frame->v()[uv_row * frame->uv_stride() + x] = y[2 * x + 1];
+      }
+    }
+  }
+}
+
+// Threads in this process.
+int ThreadCount() {
+  int count = 0;
+  for (const auto& entry :
+       std::filesystem::directory_iterator("/proc/self/task")) {
+    (void)entry;
+    ++count;
+  }
+  return count;
+}
+
+uint64_t Checksum(const VideoFrame& frame) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < frame.data.size(); i += 61) {
+    sum = sum * 31 + frame.data[i];
+  }
+  return sum;
+}
+
+struct StreamsResult {
+  int64_t elapsed_us = 0;
+  // Per stream, the checksums of its frames in order.
+  std::vector<std::vector<uint64_t>> checksums;
+};
+
+// Decodes |frames| 720p frames on each of |streams| threads, as that many
+// players would, with every slice either run by the player's own thread or
+// handed to |pool|.
+StreamsResult DecodeStreams(int streams, int frames, DecodePool* pool,
+                            FramePool* frame_pool) {
+  StreamsResult result;
+  result.checksums.resize(streams);
+  const int slices = kHeight / kSliceRows;
+  const int64_t start_us = NowUs();
+  std::vector<std::thread> players;
+  for (int stream = 0; stream < streams; ++stream) {
+    players.emplace_back([&, stream] {
+      for (int i = 0; i < frames; ++i) {
+        std::shared_ptr<VideoFrame> frame = frame_pool->Acquire();
+        frame->Allocate(kWidth, kHeight);
+        const int number = stream * frames + i;
+        if (pool != nullptr) {
+          pool->Run(slices, [&](int slice, int worker) {
+            DecodeSlice(number, slice, frame.get());
+          });
+        } else {
+          for (int slice = 0; slice < slices; ++slice) {
+            DecodeSlice(number, slice, frame.get());
+          }
+        }
+        result.checksums[stream].push_back(Checksum(*frame));
+      }
+    });
+  }
+  for (std::thread& player : players) player.join();
+  result.elapsed_us = NowUs() - start_us;
+  return result;
+}
+
+}  // namespace
+
+TEST(DecodePool, RunsEveryJobOnceOnDistinctWorkers) {
+  DecodePoolConfig config;
+  config.threads = 3;
+  DecodePool pool(config);
+  EXPECT_EQ(pool.threads(), 3);
+
+  constexpr int kJobs = 500;
+  std::vector<std::atomic<int>> runs(kJobs);
+  std::vector<std::atomic<int>> busy(pool.threads() + 1);
+  std::atomic<bool> shared_worker{false};
+  pool.Run(kJobs, [&](int index, int worker) {
+    ASSERT_GE(worker, 0);
+    ASSERT_LE(worker, pool.threads());
+    if (busy[worker].fetch_add(1) != 0) shared_worker = true;
+    ++runs[index];
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+    --busy[worker];
+  });
+  for (int i = 0; i < kJobs; ++i) EXPECT_EQ(runs[i], 1) << i;
+  EXPECT_FALSE(shared_worker);
+
+  const DecodePoolStats stats = pool.stats();
+  EXPECT_EQ(stats.batches, 1u);
+  EXPECT_EQ(stats.jobs, static_cast<uint64_t>(kJobs));
+  // The caller works on its own batch rather than waiting.
+  EXPECT_GT(stats.caller_jobs, 0u);
+}
+
+TEST(DecodePool, ServesManyCallersAtOnce) {
+  DecodePoolConfig config;
+  config.threads = 2;
+  DecodePool pool(config);
+  std::atomic<int> total{0};
+  std::vector<std::thread> callers;
+  for (int i = 0; i < 8; ++i) {
+    callers.emplace_back([&] {
+      for (int batch = 0; batch < 50; ++batch) {
+        std::atomic<int> done{0};
+        pool.Run(6, [&](int index, int worker) { ++done; });
+        // Run() returns only once its own jobs are done.
+        EXPECT_EQ(done, 6);
+        total += done;
+      }
+    });
+  }
+  for (std::thread& caller : callers) caller.join();
+  EXPECT_EQ(total, 8 * 50 * 6);
+  EXPECT_EQ(pool.stats().batches, 8u * 50u);
+}
+
+TEST(DecodePool, LeasesFrameThreadsWithinItsSize) {
+  DecodePoolConfig config;
+  config.threads = 6;
+  config.max_frame_threads = 4;
+  DecodePool pool(config);
+  auto first = std::make_unique<DecodePool::Lease>(pool.LeaseFrameThreads());
+  DecodePool::Lease second = pool.LeaseFrameThreads();
+  DecodePool::Lease third = pool.LeaseFrameThreads();
+  EXPECT_EQ(first->threads(), 4);
+  EXPECT_EQ(second.threads(), 2);
+  // Nothing left: the decoder runs on its own thread.
+  EXPECT_EQ(third.threads(), 1);
+  EXPECT_EQ(pool.stats().frame_threaded_decoders, 2);
+  EXPECT_EQ(pool.stats().frame_threads, 6);
+
+  first.reset();
+  EXPECT_EQ(pool.stats().frame_threads, 2);
+  DecodePool::Lease fourth = pool.LeaseFrameThreads();
+  EXPECT_EQ(fourth.threads(), 4);
+  // Moving a lease does not return its threads twice.
+  DecodePool::Lease moved = std::move(fourth);
+  fourth = DecodePool::Lease();
+  EXPECT_EQ(pool.stats().frame_threads, 6);
+}
+
+// Decoders that only lease frame threads, as every FFmpeg decoder does,
+// must not leave pool workers idling.
+TEST(DecodePool, StartsWorkersOnlyForBatches) {
+  const int before = ThreadCount();
+  DecodePoolConfig config;
+  config.threads = 4;
+  DecodePool pool(config);
+  DecodePool::Lease first = pool.LeaseFrameThreads();
+  DecodePool::Lease second = pool.LeaseFrameThreads();
+  EXPECT_EQ(first.threads(), 4);
+  EXPECT_EQ(second.threads(), 1);
+  pool.Run(1, [](int index, int worker) { EXPECT_EQ(worker, 0); });
+  EXPECT_EQ(ThreadCount(), before);
+
+  pool.Run(3, [](int index, int worker) {});
+  EXPECT_EQ(ThreadCount(), before + 4);
+  pool.Run(3, [](int index, int worker) {});
+  EXPECT_EQ(ThreadCount(), before + 4);
+}
+
+TEST(FramePool, RecyclesReleasedFrames) {
+  FramePool pool(2);
+  std::shared_ptr<VideoFrame> frame = pool.Acquire();
+  frame->Allocate(kWidth, kHeight);
+  const uint8_t* planes = frame->data.data();
+  FramePtr shown = frame;
+  frame.reset();
+  // Still referenced by whoever shows it.
+  EXPECT_EQ(pool.stats().free, 0u);
+  shown.reset();
+  EXPECT_EQ(pool.stats().free, 1u);
+
+  frame = pool.Acquire();
+  frame->Allocate(kWidth, kHeight);
+  EXPECT_EQ(frame->data.data(), planes);
+  EXPECT_EQ(pool.stats().allocated, 1u);
+  EXPECT_EQ(pool.stats().reused, 1u);
+
+  // Keeps no more than it was asked to.
+  std::vector<std::shared_ptr<VideoFrame>> many;
+  for (int i = 0; i < 5; ++i) many.push_back(pool.Acquire());
+  many.clear();
+  EXPECT_EQ(pool.stats().free, 2u);
+}
+
+TEST(FramePool, FramesMayOutliveThePool) {
+  std::shared_ptr<VideoFrame> frame;
+  {
+    FramePool pool;
+    frame = pool.Acquire();
+  }
+  frame->Allocate(16, 16);
+  frame.reset();
+}
+
+TEST(DecodePool, DecodesFour720pStreamsAtOnce) {
+  constexpr int kStreams = 4;
+  constexpr int kFrames = 30;
+  DecodePool pool{DecodePoolConfig()};
+  FramePool frames;
+  const StreamsResult own = DecodeStreams(kStreams, kFrames, nullptr, &frames);
+  const StreamsResult shared = DecodeStreams(kStreams, kFrames, &pool, &frames);
+  const StreamsResult alone = DecodeStreams(1, kFrames, nullptr, &frames);
+  const StreamsResult alone_shared = DecodeStreams(1, kFrames, &pool, &frames);
+
+  const auto fps = [](const StreamsResult& result, int streams) {
+    return streams * kFrames * 1e6 / result.elapsed_us;
+  };
+  std::printf("4 x 720p on %d pool threads: %.0f fps decoding slices on "
+              "each player's thread, %.0f fps on the shared pool; one "
+              "stream alone %.0f fps / %.0f fps\n",
+              pool.threads(), fps(own, kStreams), fps(shared, kStreams),
+              fps(alone, 1), fps(alone_shared, 1));
+
+  // The pool changes where slices run, not what they produce.
+  EXPECT_EQ(shared.checksums, own.checksums);
+  const DecodePoolStats stats = pool.stats();
+  EXPECT_EQ(stats.jobs, (kStreams + 1) * kFrames * 8u);
+  // Four players share the frames: a few in flight, the rest recycled.
+  const FramePoolStats frame_stats = frames.stats();
+  EXPECT_LE(frame_stats.allocated, static_cast<uint64_t>(kStreams));
+  EXPECT_EQ(frame_stats.allocated + frame_stats.reused,
+            (2u * kStreams + 2u) * kFrames);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
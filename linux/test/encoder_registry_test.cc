@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "encoder_registry.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+// Pretends to encode at a fixed number of megapixels per second.
+class FakeBackend : public EncoderBackend {
+ public:
+  FakeBackend(std::string name, double megapixels_per_second, int* opens)
+      : name_(std::move(name)), rate_(megapixels_per_second), opens_(opens) {}
+
+  std::string name() const override { return name_; }
+  bool IsAvailable() const override { return true; }
+
+  std::unique_ptr<EncoderSession> Open(const EncoderPreset& preset) override {
+    ++*opens_;
+    return std::make_unique<Session>(preset, rate_);
+  }
+
+ private:
+  class Session : public EncoderSession {
+   public:
+    Session(const EncoderPreset& preset, double rate)
+        : delay_(preset.width * preset.height / (rate * 1e6)) {}
+
+    bool Encode(const VideoFrame& frame,
+                std::vector<EncodedPacket>* packets) override {
+      std::this_thread::sleep_for(std::chrono::duration<double>(delay_));
+      packets->emplace_back();
+      return true;
+    }
+    bool Flush(std::vector<EncodedPacket>* packets) override { return true; }
+    const std::vector<uint8_t>& codec_config() const override {
+      return config_;
+    }
+
+   private:
+    double delay_;
+    std::vector<uint8_t> config_;
+  };
+
+  std::string name_;
+  double rate_;
+  int* opens_;
+};
+
+std::string TempCachePath() {
+  return ::testing::TempDir() + "ivs_encoder_benchmark_" +
+         ::testing::UnitTest::GetInstance()->current_test_info()->name();
+}
+
+}  // namespace
+
+TEST(EncoderRegistry, RecommendsHighestRealtimePreset) {
+  const std::string cache = TempCachePath();
+  std::remove(cache.c_str());
+  int opens = 0;
+  EncoderRegistry registry;
+  // 720p30 with headroom needs ~35 MP/s, 1080p30 ~78 MP/s.
+  registry.Register(std::make_unique<FakeBackend>("slow", 40, &opens));
+  registry.Calibrate(cache, "Test CPU");
+
+  EncoderRecommendation recommendation = registry.Recommend();
+  EXPECT_EQ(recommendation.backend, "slow");
+  EXPECT_EQ(recommendation.preset, "720");
+  EXPECT_EQ(registry.ResolvePreset("1080", true), "720");
+  EXPECT_EQ(registry.ResolvePreset("1080", false), "1080");
+  EXPECT_EQ(registry.ResolvePreset("360", true), "360");
+  EXPECT_EQ(registry.ResolvePreset("auto", true), "720");
+}
+
+TEST(EncoderRegistry, PrefersFasterBackendAtSamePreset) {
+  const std::string cache = TempCachePath();
+  std::remove(cache.c_str());
+  int opens = 0;
+  EncoderRegistry registry;
+  registry.Register(std::make_unique<FakeBackend>("a", 40, &opens));
+  registry.Register(std::make_unique<FakeBackend>("b", 60, &opens));
+  registry.Calibrate(cache, "Test CPU");
+
+  EXPECT_EQ(registry.Recommend().backend, "b");
+  EXPECT_EQ(registry.Recommend().preset, "720");
+}
+
+TEST(EncoderRegistry, ReusesCachedResultsForSameCpu) {
+  const std::string cache = TempCachePath();
+  std::remove(cache.c_str());
+  int opens = 0;
+  {
+    EncoderRegistry registry;
+    registry.Register(std::make_unique<FakeBackend>("slow", 40, &opens));
+    registry.Calibrate(cache, "Test CPU");
+  }
+  const int first_run_opens = opens;
+  EXPECT_GT(first_run_opens, 0);
+
+  EncoderRegistry registry;
+  registry.Register(std::make_unique<FakeBackend>("slow", 40, &opens));
+  registry.Calibrate(cache, "Test CPU");
+  EXPECT_EQ(opens, first_run_opens);
+  EXPECT_EQ(registry.Recommend().preset, "720");
+
+  // A different CPU model must be measured again.
+  EncoderRegistry other;
+  other.Register(std::make_unique<FakeBackend>("slow", 40, &opens));
+  other.Calibrate(cache, "Other CPU");
+  EXPECT_GT(opens, first_run_opens);
+
+  std::ifstream in(cache);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  EXPECT_NE(contents.find("Test CPU"), std::string::npos);
+  EXPECT_NE(contents.find("Other CPU"), std::string::npos);
+}
+
+TEST(EncoderRegistry, FallsBackToSmallestPresetWhenNothingKeepsUp) {
+  const std::string cache = TempCachePath();
+  std::remove(cache.c_str());
+  int opens = 0;
+  EncoderRegistry registry;
+  registry.Register(std::make_unique<FakeBackend>("crawl", 2, &opens));
+  registry.Calibrate(cache, "Test CPU");
+
+  EXPECT_TRUE(registry.Recommend().preset.empty());
+  EXPECT_EQ(registry.ResolvePreset("1080", true), "360");
+  // Larger presets are skipped once a smaller one falls behind.
+  EXPECT_EQ(opens, 1);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "event_hub.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+using Hub = EventHub<std::unique_ptr<int>>;
+using std::chrono::milliseconds;
+
+struct RecordingScheduler {
+  std::vector<milliseconds> requests;
+  Hub::Scheduler callback() {
+    return [this](milliseconds delay) { requests.push_back(delay); };
+  }
+};
+
+std::unique_ptr<int> Value(int value) { return std::make_unique<int>(value); }
+
+}  // namespace
+
+TEST(EventHub, DeliversStatesInOrderWithOneWakeUp) {
+  RecordingScheduler scheduler;
+  Hub hub(EventHubConfig(), scheduler.callback());
+  const auto now = Hub::Clock::now();
+  hub.Post("state", EventPriority::kState, Value(1), now);
+  hub.Post("error", EventPriority::kState, Value(2), now);
+  hub.Post("state", EventPriority::kState, Value(3), now);
+  ASSERT_EQ(scheduler.requests.size(), 1u);
+  EXPECT_EQ(scheduler.requests[0], milliseconds(0));
+
+  auto events = hub.Drain(now);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].key, "state");
+  EXPECT_EQ(*events[0].payloads[0], 1);
+  EXPECT_EQ(events[1].key, "error");
+  EXPECT_EQ(*events[2].payloads[0], 3);
+  EXPECT_TRUE(hub.Drain(now).empty());
+
+  // The next event after a drain asks for a new wake-up.
+  hub.Post("state", EventPriority::kState, Value(4), now);
+  EXPECT_EQ(scheduler.requests.size(), 2u);
+}
+
+TEST(EventHub, KeepsOnlyLatestStatsPerKey) {
+  RecordingScheduler scheduler;
+  Hub hub(EventHubConfig(), scheduler.callback());
+  const auto now = Hub::Clock::now();
+  for (int i = 0; i < 100; ++i) {
+    hub.Post("position", EventPriority::kStats, Value(i), now);
+    hub.Post("telemetry", EventPriority::kStats, Value(1000 + i), now);
+  }
+  auto events = hub.Drain(now);
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0].key, "position");
+  EXPECT_EQ(*events[0].payloads[0], 99);
+  EXPECT_EQ(*events[1].payloads[0], 1099);
+  EXPECT_EQ(hub.stats().coalesced, 198u);
+  EXPECT_EQ(scheduler.requests.size(), 1u);
+}
+
+// The listener sees the final stats of a session before the state that
+// ends it, whatever kinds the events are.
+TEST(EventHub, KeepsPostingOrderAcrossKinds) {
+  RecordingScheduler scheduler;
+  EventHubConfig config;
+  config.metrics_interval = milliseconds(0);
+  Hub hub(config, scheduler.callback());
+  const auto now = Hub::Clock::now();
+  hub.Post("state", EventPriority::kState, Value(1), now);
+  hub.Post("stats", EventPriority::kStats, Value(2), now);
+  hub.Post("bitrate", EventPriority::kMetrics, Value(3), now);
+  hub.Post("stats", EventPriority::kStats, Value(4), now);
+  hub.Post("state", EventPriority::kState, Value(5), now);
+  auto events = hub.Drain(now);
+  ASSERT_EQ(events.size(), 4u);
+  EXPECT_EQ(*events[0].payloads[0], 1);
+  EXPECT_EQ(events[1].key, "bitrate");
+  // The coalesced stats take the place of their latest value.
+  EXPECT_EQ(*events[2].payloads[0], 4);
+  EXPECT_EQ(events[3].key, "state");
+  EXPECT_EQ(*events[3].payloads[0], 5);
+  for (size_t i = 1; i < events.size(); ++i) {
+    EXPECT_LT(events[i - 1].sequence, events[i].sequence);
+  }
+}
+
+TEST(EventHub, BatchesMetricsPerInterval) {
+  RecordingScheduler scheduler;
+  EventHubConfig config;
+  config.metrics_interval = milliseconds(100);
+  config.max_batch = 8;
+  Hub hub(config, scheduler.callback());
+  const auto start = Hub::Clock::now();
+  for (int i = 0; i < 10; ++i) {
+    hub.Post("cue", EventPriority::kMetrics, Value(i),
+             start + milliseconds(i * 5));
+  }
+  ASSERT_EQ(scheduler.requests.size(), 1u);
+  EXPECT_EQ(scheduler.requests[0], milliseconds(100));
+
+  // Nothing is due yet; state events must not flush the batch early, and
+  // their drains leave the batch's wake-up as it is.
+  for (int i = 1; i <= 4; ++i) {
+    const auto now = start + milliseconds(i * 20);
+    hub.Post("state", EventPriority::kState, Value(-i), now);
+    auto events = hub.Drain(now);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].key, "state");
+  }
+  EXPECT_EQ(scheduler.requests.size(), 5u);
+  EXPECT_EQ(scheduler.requests.back(), milliseconds(0));
+
+  auto events = hub.Drain(start + milliseconds(100));
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].priority, EventPriority::kMetrics);
+  ASSERT_EQ(events[0].payloads.size(), 8u);
+  EXPECT_EQ(*events[0].payloads.front(), 2);
+  EXPECT_EQ(*events[0].payloads.back(), 9);
+  EXPECT_EQ(hub.stats().dropped, 2u);
+}
+
+TEST(EventHub, BoundsPendingStatesWhenListenerIsSlow) {
+  RecordingScheduler scheduler;
+  EventHubConfig config;
+  config.max_pending_states = 4;
+  Hub hub(config, scheduler.callback());
+  const auto now = Hub::Clock::now();
+  hub.Post("error", EventPriority::kState, Value(0), now);
+  for (int i = 1; i <= 10; ++i) {
+    hub.Post("state", EventPriority::kState, Value(i), now);
+  }
+  auto events = hub.Drain(now);
+  ASSERT_EQ(events.size(), 4u);
+  // Older events for the same key go first, so the error survives.
+  EXPECT_EQ(events[0].key, "error");
+  EXPECT_EQ(*events[1].payloads[0], 8);
+  EXPECT_EQ(*events[3].payloads[0], 10);
+  EXPECT_EQ(hub.stats().dropped, 7u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "frame_governor.h"
+#include "telemetry_block.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int64_t kSourceIntervalUs = 1000000 / 30;
+
+// Feeds |count| frames at 30 fps starting at |*pts|, reporting |encode_us|
+// of encode latency per frame, and returns the output timestamps.
+std::vector<int64_t> Feed(FrameGovernor* governor, int64_t* pts, int count,
+                          int64_t encode_us) {
+  std::vector<int64_t> output;
+  for (int i = 0; i < count; ++i) {
+    int64_t out = 0;
+    if (governor->Admit(*pts, &out)) {
+      output.push_back(out);
+      governor->ReportStage(PipelineStage::kEncode, encode_us);
+    }
+    *pts += kSourceIntervalUs;
+  }
+  return output;
+}
+
+}  // namespace
+
+TEST(FrameGovernor, KeepsEveryFrameWhenHealthy) {
+  FrameGovernor governor;
+  int64_t pts = 0;
+  EXPECT_EQ(Feed(&governor, &pts, 90, 5000).size(), 90u);
+  EXPECT_EQ(governor.target_fps(), 30);
+  EXPECT_EQ(governor.stats().frames_dropped, 0u);
+}
+
+TEST(FrameGovernor, StepsDownUnderLoadAndDropsEvenly) {
+  FrameGovernor governor;
+  int64_t pts = 0;
+  std::vector<int> levels;
+  governor.set_level_changed_callback(
+      [&](const FrameGovernorStats& stats) {
+        levels.push_back(stats.target_fps);
+      });
+  // 40 ms per frame cannot sustain 30 fps (33 ms) but can sustain 24 fps.
+  Feed(&governor, &pts, 20, 40000);
+  ASSERT_EQ(levels, std::vector<int>({24}));
+
+  std::vector<int64_t> output = Feed(&governor, &pts, 10, 30000);
+  // Exactly four out of every five frames survive.
+  EXPECT_EQ(output.size(), 8u);
+  for (size_t i = 1; i < output.size(); ++i) {
+    EXPECT_NEAR(output[i] - output[i - 1], 1000000 / 24, 1);
+  }
+}
+
+TEST(FrameGovernor, StepsDownOnQueueGrowth) {
+  FrameGovernor governor;
+  int64_t pts = 0;
+  Feed(&governor, &pts, 5, 1000);
+  governor.ReportQueueDepth(4);
+  Feed(&governor, &pts, 12, 1000);
+  EXPECT_EQ(governor.target_fps(), 24);
+}
+
+TEST(FrameGovernor, RecoversWithHysteresis) {
+  FrameGovernor governor;
+  int64_t pts = 0;
+  // Heavy load walks all the way down to 15 fps.
+  Feed(&governor, &pts, 60, 80000);
+  EXPECT_EQ(governor.target_fps(), 15);
+
+  // Light load must persist for several windows before each step up.
+  Feed(&governor, &pts, 15 * 3, 5000);
+  EXPECT_EQ(governor.target_fps(), 15);
+  Feed(&governor, &pts, 15 * 2, 5000);
+  EXPECT_EQ(governor.target_fps(), 20);
+  Feed(&governor, &pts, 15 * 20, 5000);
+  EXPECT_EQ(governor.target_fps(), 30);
+  EXPECT_EQ(governor.stats().level_changes, 6u);
+}
+
+// Drops keep reaching the telemetry slot while a lowered level holds, not
+// only when the level changes.
+TEST(FrameGovernor, PublishesDropsEveryWindowWhileALevelHolds) {
+  auto block = TelemetryBlock::Create(1);
+  ASSERT_NE(block, nullptr);
+  const int slot =
+      block->Acquire(TelemetrySource::kBroadcastSession, "broadcaster");
+  FrameGovernor governor;
+  int level_changes = 0;
+  governor.set_level_changed_callback(
+      [&](const FrameGovernorStats&) { ++level_changes; });
+  governor.set_window_callback([&](const FrameGovernorStats& stats) {
+    block->Update(slot, [&stats](TelemetrySlot* values) {
+      SetFrameGovernorTelemetry(stats, values);
+    });
+  });
+  int64_t pts = 0;
+  Feed(&governor, &pts, 60, 80000);
+  ASSERT_EQ(governor.target_fps(), 15);
+  const int changes = level_changes;
+
+  TelemetrySlot read;
+  ASSERT_TRUE(block->Read(slot, &read));
+  uint64_t dropped = read.counters[kTelemetryFramesDropped];
+  for (int window = 0; window < 5; ++window) {
+    Feed(&governor, &pts, 15, 80000);
+    ASSERT_TRUE(block->Read(slot, &read));
+    EXPECT_GT(read.counters[kTelemetryFramesDropped], dropped);
+    EXPECT_EQ(read.stats.frames_dropped,
+              read.counters[kTelemetryFramesDropped]);
+    EXPECT_EQ(read.gauges[kTelemetryTargetFps], 15);
+    EXPECT_GT(read.stats.encode_latency_us, 0u);
+    dropped = read.counters[kTelemetryFramesDropped];
+  }
+  EXPECT_EQ(level_changes, changes);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "frame_scaler.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+// Widths chosen so the SIMD loop and the scalar tail both run; the SIMD
+// columns must come out exactly as the scalar tail computes them.
+TEST(FrameScaler, HalvingMatchesRoundedAverage) {
+  const int width = 70;
+  const int height = 64;
+  std::vector<uint8_t> src(width * height);
+  uint32_t seed = 1;
+  for (uint8_t& value : src) {
+    seed = seed * 1664525u + 1013904223u;
+    value = static_cast<uint8_t>(seed >> 24);
+  }
+  std::vector<uint8_t> dst((width / 2) * (height / 2));
+  HalvePlane(src.data(), width, width, height, dst.data(), width / 2);
+  for (int y = 0; y < height / 2; ++y) {
+    for (int x = 0; x < width / 2; ++x) {
+      const uint8_t* p = &src[2 * y * width + 2 * x];
+      const int exact = (p[0] + p[1] + p[width] + p[width + 1] + 2) / 4;
+      EXPECT_EQ(dst[y * (width / 2) + x], exact) << x << "," << y;
+    }
+  }
+}
+
+TEST(FrameScaler, FitsWithinBoundingBox) {
+  int width = 0;
+  int height = 0;
+  FitWithin(1920, 1080, 320, 320, &width, &height);
+  EXPECT_EQ(width, 320);
+  EXPECT_EQ(height, 180);
+  FitWithin(1080, 1920, 320, 180, &width, &height);
+  EXPECT_EQ(width, 100);
+  EXPECT_EQ(height, 180);
+  FitWithin(640, 360, 0, 90, &width, &height);
+  EXPECT_EQ(width, 160);
+  EXPECT_EQ(height, 90);
+  // Never upscales.
+  FitWithin(160, 90, 320, 180, &width, &height);
+  EXPECT_EQ(width, 160);
+  EXPECT_EQ(height, 90);
+}
+
+TEST(FrameScaler, PreservesFlatColour) {
+  VideoFrame src;
+  src.Allocate(1280, 720);
+  std::fill(src.y(), src.u(), 200);
+  std::fill(src.u(), src.v(), 90);
+  std::fill(src.v(), src.y() + src.data.size(), 160);
+  VideoFrame dst;
+  dst.Allocate(212, 120);
+  ScaleFrame(src, &dst);
+  for (int i = 0; i < dst.y_stride() * dst.height; ++i) {
+    ASSERT_EQ(dst.y()[i], 200);
+  }
+  for (int i = 0; i < dst.uv_stride() * dst.uv_height(); ++i) {
+    ASSERT_EQ(dst.u()[i], 90);
+    ASSERT_EQ(dst.v()[i], 160);
+  }
+}
+
+TEST(FrameScaler, DownscalesFullHdQuickly) {
+  SyntheticFrameSource source(1920, 1080, 30);
+  VideoFrame src;
+  source.Next(&src);
+  VideoFrame dst;
+  dst.Allocate(320, 180);
+  constexpr int kIterations = 50;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) ScaleFrame(src, &dst);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("1080p to 320x180: %.3f ms per frame\n",
+              elapsed.count() / kIterations);
+  EXPECT_LT(elapsed.count() / kIterations, 20.0);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
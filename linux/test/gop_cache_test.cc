@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "gop_cache.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+SharedPacket Packet(int64_t pts_us, bool keyframe, size_t size) {
+  auto packet = std::make_shared<MediaPacket>();
+  packet->video = true;
+  packet->keyframe = keyframe;
+  packet->pts_us = pts_us;
+  packet->data.assign(size, 0);
+  return packet;
+}
+
+}  // namespace
+
+TEST(GopCache, KeepsTheLatestGopFromItsKeyframe) {
+  GopCache cache(1 << 20);
+  // Nothing to decode from before the first keyframe.
+  cache.Append("a", Packet(0, false, 10));
+  EXPECT_TRUE(cache.Get("a").empty());
+
+  cache.Append("a", Packet(1, true, 100));
+  cache.Append("a", Packet(2, false, 10));
+  cache.Append("a", Packet(3, false, 10));
+  auto gop = cache.Get("a");
+  ASSERT_EQ(gop.size(), 3u);
+  EXPECT_TRUE(gop[0]->keyframe);
+  EXPECT_EQ(gop[2]->pts_us, 3);
+  EXPECT_EQ(cache.bytes("a"), 120u);
+
+  cache.Append("a", Packet(4, true, 50));
+  gop = cache.Get("a");
+  ASSERT_EQ(gop.size(), 1u);
+  EXPECT_EQ(gop[0]->pts_us, 4);
+  EXPECT_EQ(cache.stats().bytes, 50u);
+  EXPECT_EQ(cache.stats().streams, 1u);
+}
+
+TEST(GopCache, SharesPacketsInsteadOfCopying) {
+  GopCache cache(1 << 20);
+  SharedPacket keyframe = Packet(0, true, 100);
+  cache.Append("a", keyframe);
+  EXPECT_EQ(cache.Get("a")[0].get(), keyframe.get());
+}
+
+TEST(GopCache, EvictsTheHighestRankFirst) {
+  GopCache cache(300);
+  cache.SetRank("selected", 0);
+  cache.SetRank("previous", 1);
+  cache.Append("selected", Packet(0, true, 100));
+  cache.Append("previous", Packet(0, true, 100));
+  cache.Append("never", Packet(0, true, 100));
+  EXPECT_EQ(cache.stats().evictions, 0u);
+
+  // Unranked streams go before ranked ones.
+  cache.Append("previous", Packet(1, false, 50));
+  EXPECT_TRUE(cache.Get("never").empty());
+  EXPECT_EQ(cache.stats().evictions, 1u);
+
+  cache.Append("selected", Packet(1, false, 100));
+  EXPECT_TRUE(cache.Get("previous").empty());
+  EXPECT_EQ(cache.Get("selected").size(), 2u);
+  EXPECT_EQ(cache.stats().bytes, 200u);
+  EXPECT_EQ(cache.stats().streams, 1u);
+
+  // An evicted stream is cached again from its next keyframe only.
+  cache.Append("previous", Packet(2, false, 10));
+  EXPECT_TRUE(cache.Get("previous").empty());
+  cache.Append("previous", Packet(3, true, 10));
+  EXPECT_EQ(cache.Get("previous").size(), 1u);
+}
+
+TEST(GopCache, RemoveReleasesTheBudget) {
+  GopCache cache(1 << 20);
+  cache.Append("a", Packet(0, true, 100));
+  cache.Append("b", Packet(0, true, 100));
+  cache.Remove("a");
+  cache.Remove("missing");
+  EXPECT_TRUE(cache.Get("a").empty());
+  EXPECT_EQ(cache.stats().bytes, 100u);
+  EXPECT_EQ(cache.stats().streams, 1u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,390 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hls_playlist.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int64_t kEpochMs = 1714564800000;  // 2024-05-01T12:00:00Z
+
+// A live window of |count| two-second segments starting at |first|, with a
+// program date-time on every segment as IVS sends them. Segments before
+// |skip_until| are left out with EXT-X-SKIP.
+std::string LivePlaylist(int64_t first, int64_t count,
+                         int64_t skip_until = -1) {
+  std::string text =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:9\n"
+      "#EXT-X-TARGETDURATION:2\n"
+      "#EXT-X-SERVER-CONTROL:CAN-SKIP-UNTIL=12.0,HOLD-BACK=6.0\n"
+      "#EXT-X-MEDIA-SEQUENCE:" +
+      std::to_string(first) + "\n";
+  if (skip_until > first) {
+    text += "#EXT-X-SKIP:SKIPPED-SEGMENTS=" +
+            std::to_string(skip_until - first) + "\n";
+  }
+  for (int64_t i = skip_until > first ? skip_until : first; i < first + count;
+       ++i) {
+    const int64_t ms = kEpochMs + i * 2000;
+    char date[64];
+    std::snprintf(date, sizeof(date), "2024-05-%02dT%02d:%02d:%02d.%03dZ",
+                  static_cast<int>(1 + ms / 1000 / 86400 - 19844),
+                  static_cast<int>(ms / 1000 / 3600 % 24),
+                  static_cast<int>(ms / 1000 / 60 % 60),
+                  static_cast<int>(ms / 1000 % 60),
+                  static_cast<int>(ms % 1000));
+    text += "#EXT-X-PROGRAM-DATE-TIME:";
+    text += date;
+    text += "\n#EXTINF:2.000,\n"
+            "https://video-edge.example.net/v1/segment/"
+            "CvQBKz7s0XqUu7rPmwsEYm9vc3Rlcl9yZW5kaXRpb25fMTA4MHA/" +
+            std::to_string(i) + ".ts\n";
+  }
+  return text;
+}
+
+double Milliseconds(std::chrono::steady_clock::duration elapsed) {
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+}  // namespace
+
+TEST(HlsPlaylist, ParsesMediaPlaylistFedInAnyChunks) {
+  const std::string text =
+      "#EXTM3U\r\n"
+      "#EXT-X-VERSION:7\r\n"
+      "#EXT-X-TARGETDURATION:6\r\n"
+      "#EXT-X-PLAYLIST-TYPE:VOD\r\n"
+      "#EXT-X-MEDIA-SEQUENCE:10\r\n"
+      "#EXT-X-DISCONTINUITY-SEQUENCE:3\r\n"
+      "#EXT-X-MAP:URI=\"init.mp4\",BYTERANGE=\"720@0\"\r\n"
+      "#EXT-X-KEY:METHOD=AES-128,URI=\"https://k/1?a=1,b=2\",IV=0x01\r\n"
+      "#EXT-X-PROGRAM-DATE-TIME:2024-05-01T14:00:00.500+02:00\r\n"
+      "#EXTINF:5.005,first\r\n"
+      "#EXT-X-BYTERANGE:1000@720\r\n"
+      "media.mp4\r\n"
+      "# a comment\r\n"
+      "#EXTINF:6,\r\n"
+      "#EXT-X-BYTERANGE:2000\r\n"
+      "media.mp4\r\n"
+      "#EXT-X-DISCONTINUITY\r\n"
+      "#EXT-X-KEY:METHOD=NONE\r\n"
+      "#EXT-X-GAP\r\n"
+      "#EXTINF:4.5,\r\n"
+      "other.ts\r\n"
+      "#EXT-X-ENDLIST";
+
+  for (size_t chunk : {text.size(), size_t{1}, size_t{7}}) {
+    HlsMediaPlaylist playlist;
+    HlsPlaylistParser parser(&playlist);
+    for (size_t i = 0; i < text.size(); i += chunk) {
+      ASSERT_TRUE(parser.Feed(std::string_view(text).substr(i, chunk)));
+    }
+    ASSERT_TRUE(parser.Finish()) << parser.error();
+
+    EXPECT_EQ(playlist.version, 7);
+    EXPECT_EQ(playlist.type, HlsPlaylistType::kVod);
+    EXPECT_TRUE(playlist.end_list);
+    EXPECT_EQ(playlist.target_duration_us, 6000000);
+    EXPECT_EQ(playlist.duration_us, 15505000);
+    ASSERT_EQ(playlist.segments.size(), 3u);
+    EXPECT_EQ(playlist.media_sequence(), 10);
+
+    const HlsSegment& first = playlist.segments[0];
+    EXPECT_EQ(first.uri, "media.mp4");
+    EXPECT_EQ(first.duration_us, 5005000);
+    EXPECT_EQ(first.byte_range.length, 1000);
+    EXPECT_EQ(first.byte_range.offset, 720);
+    EXPECT_EQ(first.program_date_time_ms, kEpochMs + 500);
+    ASSERT_NE(first.key, nullptr);
+    EXPECT_EQ(first.key->uri, "https://k/1?a=1,b=2");
+    EXPECT_EQ(first.map->uri, "init.mp4");
+    EXPECT_EQ(first.map->byte_range.length, 720);
+
+    const HlsSegment& second = playlist.segments[1];
+    EXPECT_EQ(second.byte_range.offset, 1720);
+    EXPECT_EQ(second.program_date_time_ms, first.program_date_time_ms + 5005);
+    EXPECT_EQ(second.key, first.key);
+    EXPECT_EQ(second.discontinuity_sequence, 3);
+
+    const HlsSegment& third = *playlist.Find(12);
+    EXPECT_EQ(third.uri, "other.ts");
+    EXPECT_TRUE(third.discontinuity);
+    EXPECT_TRUE(third.gap);
+    EXPECT_EQ(third.discontinuity_sequence, 4);
+    EXPECT_EQ(third.key, nullptr);
+    EXPECT_EQ(third.map, first.map);
+    EXPECT_EQ(third.byte_range.length, -1);
+  }
+}
+
+TEST(HlsPlaylist, RejectsMalformedPlaylists) {
+  const char* cases[] = {
+      "#EXT-X-TARGETDURATION:2\n#EXTINF:2,\na.ts\n",
+      "#EXTM3U\n#EXTINF:2,\na.ts\n",
+      "#EXTM3U\n#EXT-X-TARGETDURATION:2\na.ts\n",
+      "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXTINF:two,\na.ts\n",
+      "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=1\nlow.m3u8\n",
+      "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXT-X-KEY:METHOD=AES-128,URI=\"x\n",
+  };
+  for (const char* text : cases) {
+    HlsMediaPlaylist playlist = HlsMediaPlaylist();
+    ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(0, 3), &playlist, nullptr,
+                                 nullptr));
+    std::string error;
+    EXPECT_FALSE(ParseHlsPlaylist(text, &playlist, nullptr, &error)) << text;
+    EXPECT_FALSE(error.empty());
+    EXPECT_TRUE(playlist.segments.empty());
+  }
+}
+
+TEST(HlsPlaylist, AppliesLiveRefreshInPlace) {
+  HlsMediaPlaylist playlist;
+  HlsUpdateStats stats;
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(100, 10), &playlist, &stats,
+                               nullptr));
+  EXPECT_EQ(stats.added, 10);
+  const HlsSegment* kept = playlist.Find(105);
+  const char* kept_uri = kept->uri.data();
+
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(103, 10), &playlist, &stats,
+                               nullptr));
+  EXPECT_EQ(stats.added, 3);
+  EXPECT_EQ(stats.reused, 7);
+  EXPECT_EQ(stats.removed, 3);
+  EXPECT_TRUE(stats.changed());
+  EXPECT_EQ(playlist.media_sequence(), 103);
+  EXPECT_EQ(playlist.next_sequence(), 113);
+  EXPECT_EQ(playlist.duration_us, 20000000);
+  // Segments seen before are neither moved nor copied.
+  EXPECT_EQ(playlist.Find(105), kept);
+  EXPECT_EQ(playlist.Find(105)->uri.data(), kept_uri);
+  EXPECT_EQ(playlist.Find(112)->program_date_time_ms, kEpochMs + 224000);
+
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(103, 10), &playlist, &stats,
+                               nullptr));
+  EXPECT_FALSE(stats.changed());
+  EXPECT_EQ(HlsReloadDelayUs(playlist, stats.changed()), 1000000);
+
+  // Falling behind the window leaves nothing to reuse.
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(200, 10), &playlist, &stats,
+                               nullptr));
+  EXPECT_TRUE(stats.reset);
+  EXPECT_EQ(stats.added, 10);
+  EXPECT_EQ(playlist.media_sequence(), 200);
+  EXPECT_EQ(playlist.segments.size(), 10u);
+}
+
+TEST(HlsPlaylist, ResolvesDeltaUpdatesAgainstThePreviousVersion) {
+  HlsMediaPlaylist playlist;
+  HlsUpdateStats stats;
+  std::string error;
+  const std::string url = "https://example.net/live.m3u8?token=abc";
+  EXPECT_EQ(HlsReloadUrl(url, playlist, 0), url);
+
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(0, 30), &playlist, &stats,
+                               nullptr));
+  EXPECT_EQ(playlist.server_control.can_skip_until_us, 12000000);
+  EXPECT_EQ(HlsReloadUrl(url, playlist, 2000000), url + "&_HLS_skip=YES");
+  // Too old for the server to skip against.
+  EXPECT_EQ(HlsReloadUrl(url, playlist, 7000000), url);
+
+  // The server slides two segments and skips all but the last six.
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(2, 30, 26), &playlist, &stats,
+                               &error))
+      << error;
+  EXPECT_EQ(stats.skipped, 24);
+  EXPECT_EQ(stats.reused, 4);
+  EXPECT_EQ(stats.added, 2);
+  EXPECT_EQ(stats.removed, 2);
+  EXPECT_EQ(playlist.media_sequence(), 2);
+  EXPECT_EQ(playlist.segments.size(), 30u);
+  EXPECT_NE(playlist.Find(31)->uri.find("/31.ts"), std::string::npos);
+  EXPECT_EQ(playlist.Find(31)->program_date_time_ms, kEpochMs + 62000);
+
+  // A delta the previous version cannot satisfy is an error; the caller
+  // reloads without _HLS_skip.
+  HlsMediaPlaylist fresh;
+  EXPECT_FALSE(ParseHlsPlaylist(LivePlaylist(2, 30, 26), &fresh, &stats,
+                                &error));
+  EXPECT_NE(error.find("delta update"), std::string::npos);
+}
+
+TEST(HlsPlaylist, ParsesLowLatencyPlaylists) {
+  const std::string text =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:9\n"
+      "#EXT-X-TARGETDURATION:1\n"
+      "#EXT-X-PART-INF:PART-TARGET=0.2\n"
+      "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=0.6\n"
+      "#EXT-X-MEDIA-SEQUENCE:40\n"
+      "#EXTINF:1.0,\ns40.ts\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"s41.0.ts\",INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.5,URI=\"s41.1.ts\"\n"
+      "#EXTINF:1.0,\ns41.ts\n"
+      "#EXT-X-PART:DURATION=0.2,URI=\"s42.mp4\",BYTERANGE=\"500@0\","
+      "INDEPENDENT=YES\n"
+      "#EXT-X-PART:DURATION=0.2,URI=\"s42.mp4\",BYTERANGE=400\n"
+      "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"s42.mp4\",BYTERANGE-START=900\n"
+      "#EXT-X-RENDITION-REPORT:URI=\"alt.m3u8\",LAST-MSN=42,LAST-PART=1\n";
+  HlsMediaPlaylist playlist;
+  HlsUpdateStats stats;
+  std::string error;
+  ASSERT_TRUE(ParseHlsPlaylist(text, &playlist, &stats, &error)) << error;
+  EXPECT_EQ(playlist.part_target_us, 200000);
+  EXPECT_EQ(playlist.server_control.part_hold_back_us, 600000);
+  ASSERT_EQ(playlist.segments.size(), 2u);
+  EXPECT_TRUE(playlist.Find(40)->parts.empty());
+  const std::vector<HlsPart>& parts = playlist.Find(41)->parts;
+  ASSERT_EQ(parts.size(), 2u);
+  EXPECT_EQ(parts[0].uri, "s41.0.ts");
+  EXPECT_TRUE(parts[0].independent);
+  EXPECT_FALSE(parts[1].independent);
+  EXPECT_EQ(parts[1].duration_us, 500000);
+
+  ASSERT_EQ(playlist.pending_parts.size(), 2u);
+  EXPECT_EQ(playlist.pending_parts[1].byte_range.offset, 500);
+  EXPECT_EQ(playlist.pending_parts[1].byte_range.length, 400);
+  EXPECT_EQ(playlist.preload_hint.type, HlsPreloadHint::Type::kPart);
+  EXPECT_EQ(playlist.preload_hint.uri, "s42.mp4");
+  EXPECT_EQ(playlist.preload_hint.byte_range.offset, 900);
+  EXPECT_EQ(playlist.preload_hint.byte_range.length, -1);
+  ASSERT_EQ(playlist.rendition_reports.size(), 1u);
+  EXPECT_EQ(playlist.rendition_reports[0].uri, "alt.m3u8");
+  EXPECT_EQ(playlist.rendition_reports[0].last_msn, 42);
+  EXPECT_EQ(playlist.rendition_reports[0].last_part, 1);
+
+  // The reload asks for the part after the last one listed, and comes back
+  // straight away once it does.
+  const std::string url = "https://example.net/live.m3u8";
+  EXPECT_EQ(HlsReloadUrl(url, playlist, 0),
+            url + "?_HLS_msn=42&_HLS_part=2");
+  EXPECT_EQ(HlsReloadDelayUs(playlist, true), 0);
+  EXPECT_EQ(HlsReloadDelayUs(playlist, false), 250000);
+
+  // A new part of the segment in progress is a change even without a new
+  // segment.
+  ASSERT_TRUE(ParseHlsPlaylist(
+      text + "#EXT-X-PART:DURATION=0.2,URI=\"s42.mp4\",BYTERANGE=300\n",
+      &playlist, &stats, &error))
+      << error;
+  EXPECT_EQ(stats.added, 0);
+  EXPECT_EQ(stats.parts_added, 1);
+  EXPECT_TRUE(stats.changed());
+  EXPECT_EQ(playlist.pending_parts.size(), 3u);
+}
+
+TEST(HlsPlaylist, ParsesMasterPlaylistsAndResolvesUrls) {
+  const std::string text =
+      "#EXTM3U\n"
+      "#EXT-X-STREAM-INF:BANDWIDTH=800000,RESOLUTION=640x360,"
+      "CODECS=\"avc1.4d401e,mp4a.40.2\"\n"
+      "low/index.m3u8\n"
+      "#EXT-X-STREAM-INF:BANDWIDTH=3000000,RESOLUTION=1280x720\n"
+      "/hd/index.m3u8\n";
+  std::vector<HlsVariant> variants;
+  std::string error;
+  ASSERT_TRUE(ParseHlsMasterPlaylist(text, &variants, &error)) << error;
+  ASSERT_EQ(variants.size(), 2u);
+  EXPECT_EQ(variants[0].bandwidth, 800000);
+  EXPECT_EQ(variants[0].width, 640);
+  EXPECT_EQ(variants[0].height, 360);
+  EXPECT_EQ(variants[0].codecs, "avc1.4d401e,mp4a.40.2");
+  EXPECT_EQ(variants[1].uri, "/hd/index.m3u8");
+
+  EXPECT_EQ(ChooseHlsVariant(variants, 0), &variants[1]);
+  EXPECT_EQ(ChooseHlsVariant(variants, 1000000), &variants[0]);
+  EXPECT_EQ(ChooseHlsVariant(variants, 500000), &variants[0]);
+  std::swap(variants[0], variants[1]);
+  EXPECT_EQ(ChooseHlsVariant(variants, 1000000), &variants[1]);
+  EXPECT_EQ(ChooseHlsVariant({}, 0), nullptr);
+
+  EXPECT_FALSE(ParseHlsMasterPlaylist(LivePlaylist(0, 3), &variants, &error));
+
+  const std::string base = "https://cdn.example.net/live/master.m3u8?t=1";
+  EXPECT_EQ(ResolveHlsUrl(base, "low/index.m3u8"),
+            "https://cdn.example.net/live/low/index.m3u8");
+  EXPECT_EQ(ResolveHlsUrl(base, "/hd/index.m3u8"),
+            "https://cdn.example.net/hd/index.m3u8");
+  EXPECT_EQ(ResolveHlsUrl(base, "//other.net/a.ts"), "https://other.net/a.ts");
+  EXPECT_EQ(ResolveHlsUrl(base, "http://x/a.ts"), "http://x/a.ts");
+}
+
+TEST(HlsPlaylist, ParsesDateTimes) {
+  int64_t ms;
+  ASSERT_TRUE(ParseHlsDateTime("2024-05-01T12:00:00Z", &ms));
+  EXPECT_EQ(ms, kEpochMs);
+  ASSERT_TRUE(ParseHlsDateTime("2024-05-01T08:30:00.125-0330", &ms));
+  EXPECT_EQ(ms, kEpochMs + 125);
+  ASSERT_TRUE(ParseHlsDateTime("1969-12-31T23:59:59.000Z", &ms));
+  EXPECT_EQ(ms, -1000);
+  EXPECT_FALSE(ParseHlsDateTime("2024-05-01 12:00:00Z", &ms));
+  EXPECT_FALSE(ParseHlsDateTime("2024-13-01T12:00:00Z", &ms));
+}
+
+// A four-hour DVR window of two-second segments, refreshed every segment:
+// a full rebuild per refresh against an in-place update and against a
+// delta update.
+TEST(HlsPlaylist, BenchmarkDvrRefresh) {
+  constexpr int64_t kSegments = 7200;
+  constexpr int kRefreshes = 20;
+  std::vector<std::string> full, delta;
+  for (int i = 1; i <= kRefreshes; ++i) {
+    full.push_back(LivePlaylist(i, kSegments));
+    delta.push_back(LivePlaylist(i, kSegments, i + kSegments - 6));
+  }
+
+  HlsMediaPlaylist playlist;
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(ParseHlsPlaylist(LivePlaylist(0, kSegments), &playlist,
+                               nullptr, nullptr));
+  const double load_ms = Milliseconds(std::chrono::steady_clock::now() - start);
+  HlsMediaPlaylist base = playlist;
+
+  start = std::chrono::steady_clock::now();
+  for (const std::string& text : full) {
+    HlsMediaPlaylist rebuilt;
+    ASSERT_TRUE(ParseHlsPlaylist(text, &rebuilt, nullptr, nullptr));
+  }
+  const double rebuild_ms =
+      Milliseconds(std::chrono::steady_clock::now() - start) / kRefreshes;
+
+  HlsUpdateStats stats;
+  start = std::chrono::steady_clock::now();
+  for (const std::string& text : full) {
+    ASSERT_TRUE(ParseHlsPlaylist(text, &playlist, &stats, nullptr));
+    ASSERT_EQ(stats.added, 1);
+    ASSERT_EQ(stats.reused, kSegments - 1);
+  }
+  const double update_ms =
+      Milliseconds(std::chrono::steady_clock::now() - start) / kRefreshes;
+
+  start = std::chrono::steady_clock::now();
+  for (const std::string& text : delta) {
+    ASSERT_TRUE(ParseHlsPlaylist(text, &base, &stats, nullptr));
+    ASSERT_EQ(stats.added, 1);
+    ASSERT_EQ(stats.skipped, kSegments - 6);
+  }
+  const double delta_ms =
+      Milliseconds(std::chrono::steady_clock::now() - start) / kRefreshes;
+
+  EXPECT_EQ(base.segments.size(), playlist.segments.size());
+  EXPECT_EQ(base.segments.back().uri, playlist.segments.back().uri);
+  EXPECT_EQ(base.duration_us, playlist.duration_us);
+  std::printf(
+      "%lld segments (%zu KB): load %.2f ms, refresh by rebuild %.2f ms, "
+      "in place %.2f ms, delta (%zu bytes) %.3f ms\n",
+      static_cast<long long>(kSegments), full[0].size() / 1024, load_ms,
+      rebuild_ms, update_ms, delta[0].size(), delta_ms);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
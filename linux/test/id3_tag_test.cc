@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "id3_tag.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+std::string SyncSafe(size_t size) {
+  return {static_cast<char>(size >> 21 & 0x7f),
+          static_cast<char>(size >> 14 & 0x7f),
+          static_cast<char>(size >> 7 & 0x7f), static_cast<char>(size & 0x7f)};
+}
+
+std::string Frame(const std::string& id, const std::string& body) {
+  return id + SyncSafe(body.size()) + std::string(2, '\0') + body;
+}
+
+// An ID3v2.4 tag holding |frames| and some padding.
+std::vector<uint8_t> Tag(const std::string& frames) {
+  const std::string body = frames + std::string(16, '\0');
+  const std::string tag =
+      std::string("ID3\x04\x00\x00", 6) + SyncSafe(body.size()) + body;
+  return std::vector<uint8_t>(tag.begin(), tag.end());
+}
+
+}  // namespace
+
+TEST(Id3Tag, ReadsTextFrames) {
+  const std::vector<uint8_t> tag =
+      Tag(Frame("TXXX", std::string("\x03", 1) + "desc" + std::string(1, '\0') +
+                            "{\"score\":3}") +
+          Frame("PRIV", "owner") +
+          // Latin-1 "café".
+          Frame("TIT2", std::string("\x00" "caf\xe9", 5)) +
+          // UTF-16 with a byte order mark, "hi".
+          Frame("TIT3", std::string("\x01\xff\xfeh\x00i\x00", 7)));
+  std::vector<std::string> texts;
+  ASSERT_TRUE(ParseId3TextFrames(tag.data(), tag.size(), &texts));
+  EXPECT_EQ(texts, (std::vector<std::string>{"{\"score\":3}", "caf\xc3\xa9",
+                                             "hi"}));
+}
+
+TEST(Id3Tag, RejectsTruncatedTags) {
+  std::vector<uint8_t> tag = Tag(Frame("TXXX", "\x03x"));
+  tag.resize(tag.size() - 20);
+  std::vector<std::string> texts;
+  EXPECT_FALSE(ParseId3TextFrames(tag.data(), tag.size(), &texts));
+  const uint8_t not_id3[] = {'I', 'D', '4', 4, 0, 0, 0, 0, 0, 0};
+  EXPECT_FALSE(ParseId3TextFrames(not_id3, sizeof(not_id3), &texts));
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
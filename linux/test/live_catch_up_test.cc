@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include "live_catch_up.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+TEST(CatchUpController, SpeedsUpGraduallyWhenBehind) {
+  CatchUpController controller{CatchUpConfig()};
+  EXPECT_DOUBLE_EQ(controller.Update(3000000, 1000000, 0), 1);
+  // At most 0.1 more every second, up to 1.1.
+  EXPECT_NEAR(controller.Update(3000000, 1000000, 500000), 1.05, 1e-9);
+  EXPECT_NEAR(controller.Update(3000000, 1000000, 1000000), 1.1, 1e-9);
+  EXPECT_NEAR(controller.Update(3000000, 1000000, 2000000), 1.1, 1e-9);
+}
+
+TEST(CatchUpController, SlowsDownWhenAhead) {
+  CatchUpController controller{CatchUpConfig()};
+  int64_t now_us = 0;
+  for (; now_us <= 2000000; now_us += 100000) {
+    controller.Update(500000, 2000000, now_us);
+  }
+  EXPECT_NEAR(controller.rate(), 0.9, 1e-9);
+}
+
+TEST(CatchUpController, HoldsOneUntilTheErrorExceedsTheTolerance) {
+  CatchUpConfig config;
+  config.max_rate_change_per_s = 10;
+  CatchUpController controller(config);
+  // Within 300 ms of the target.
+  controller.Update(1250000, 1000000, 0);
+  EXPECT_DOUBLE_EQ(controller.Update(1250000, 1000000, 100000), 1);
+  EXPECT_GT(controller.Update(1400000, 1000000, 200000), 1);
+  // Steers on until within half the tolerance...
+  EXPECT_GT(controller.Update(1200000, 1000000, 300000), 1);
+  EXPECT_DOUBLE_EQ(controller.Update(1100000, 1000000, 400000), 1);
+  // ...and does not start again inside the tolerance.
+  EXPECT_DOUBLE_EQ(controller.Update(1250000, 1000000, 500000), 1);
+}
+
+TEST(CatchUpController, ResetReturnsToOne) {
+  CatchUpController controller{CatchUpConfig()};
+  controller.Update(5000000, 1000000, 0);
+  controller.Update(5000000, 1000000, 1000000);
+  ASSERT_GT(controller.rate(), 1);
+  controller.Reset();
+  EXPECT_DOUBLE_EQ(controller.rate(), 1);
+  EXPECT_DOUBLE_EQ(controller.Update(5000000, 1000000, 1100000), 1);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
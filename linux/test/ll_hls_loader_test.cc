@@ -0,0 +1,359 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "abr_controller.h"
+#include "ll_hls_loader.h"
+#include "segment_cache.h"
+#include "test/ll_hls_origin.h"
+#include "test/throttled_http_server.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int kPartBytes = 2000;
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Latency {
+  int64_t parts = 0;
+  int64_t mean_us = 0;
+  int64_t max_us = 0;
+  bool in_order = true;
+};
+
+// Plays |origin| for |duration_us| and measures glass to glass: each part is
+// presented when it arrives, but not before its capture time says it is due
+// after the first part, as a player that never speeds up would.
+Latency Measure(const LlHlsOrigin& origin, const LlHlsConfig& config,
+                int64_t duration_us, LlHlsStats* stats) {
+  Latency latency;
+  LlHlsLoader loader(config);
+  std::string error;
+  EXPECT_TRUE(loader.Open(origin.Url(), &error)) << error;
+  EXPECT_EQ(loader.low_latency(), config.low_latency);
+  std::vector<uint8_t> part(kPartBytes);
+  int64_t first_arrival_us = -1;
+  int64_t first_capture_us = 0;
+  int64_t previous = -1;
+  int64_t total_us = 0;
+  const int64_t end_us = NowUs() + duration_us;
+  while (NowUs() < end_us) {
+    size_t filled = 0;
+    while (filled < part.size()) {
+      const int64_t read =
+          loader.Read(part.data() + filled, part.size() - filled);
+      if (read <= 0) {
+        ADD_FAILURE() << "read failed: " << loader.error();
+        return latency;
+      }
+      filled += read;
+    }
+    const int64_t arrival_us = NowUs();
+    LlHlsOrigin::PartHeader header;
+    if (!LlHlsOrigin::ReadHeader(part.data(), part.size(), &header)) {
+      ADD_FAILURE() << "stream out of step";
+      return latency;
+    }
+    const int64_t index = header.msn * 5 + header.part;
+    if (previous >= 0 && index != previous + 1) latency.in_order = false;
+    previous = index;
+    if (first_arrival_us < 0) {
+      first_arrival_us = arrival_us;
+      first_capture_us = header.capture_us;
+    }
+    const int64_t present_us =
+        std::max(arrival_us,
+                 first_arrival_us + header.capture_us - first_capture_us);
+    const int64_t part_latency_us = present_us - header.capture_us;
+    ++latency.parts;
+    total_us += part_latency_us;
+    latency.max_us = std::max(latency.max_us, part_latency_us);
+  }
+  latency.mean_us = latency.parts > 0 ? total_us / latency.parts : 0;
+  *stats = loader.stats();
+  return latency;
+}
+
+// Reads |loader| to the end of its stream.
+std::string ReadAll(LlHlsLoader* loader) {
+  std::string stream;
+  char data[64];
+  int64_t read;
+  while ((read = loader->Read(reinterpret_cast<uint8_t*>(data),
+                              sizeof(data))) > 0) {
+    stream.append(data, read);
+  }
+  EXPECT_EQ(read, 0) << loader->error();
+  return stream;
+}
+
+LlHlsOrigin::Options OriginOptions() {
+  LlHlsOrigin::Options options;
+  options.part_us = 200000;
+  options.parts_per_segment = 5;
+  options.part_bytes = kPartBytes;
+  // A nearby edge.
+  options.server.latency_us = 10000;
+  return options;
+}
+
+}  // namespace
+
+// A live playlist without parts is followed the same way, so the player
+// knows how far behind the live edge it is.
+TEST(LlHlsLoader, FollowsPlainLivePlaylists) {
+  ThrottledHttpServer server({});
+  ASSERT_TRUE(server.ok());
+  std::string playlist = "#EXTM3U\n#EXT-X-TARGETDURATION:1\n";
+  for (int i = 0; i < 4; ++i) {
+    const std::string name = "s" + std::to_string(i);
+    playlist += "#EXTINF:1.0,\n" + name + ".ts\n";
+    server.Set("/" + name + ".ts", name + ";");
+  }
+  server.Set("/live.m3u8", playlist);
+  LlHlsLoader loader{LlHlsConfig()};
+  std::string error;
+  ASSERT_TRUE(loader.Open(server.Url("/live.m3u8"), &error)) << error;
+  EXPECT_TRUE(loader.live());
+  EXPECT_FALSE(loader.low_latency());
+  char data[3];
+  size_t filled = 0;
+  while (filled < sizeof(data)) {
+    const int64_t read = loader.Read(
+        reinterpret_cast<uint8_t*>(data) + filled, sizeof(data) - filled);
+    ASSERT_GT(read, 0) << loader.error();
+    filled += read;
+  }
+  const std::string first(data, sizeof(data));
+  EXPECT_EQ(first.front(), 's');
+  EXPECT_GE(loader.BufferedUs(), 0);
+
+  server.Set("/s4.ts", "s4;");
+  server.Set("/live.m3u8",
+             playlist + "#EXTINF:1.0,\ns4.ts\n#EXT-X-ENDLIST\n");
+  const std::string rest = ReadAll(&loader);
+  ASSERT_GE(rest.size(), 3u);
+  EXPECT_EQ(rest.substr(rest.size() - 3), "s4;");
+}
+
+// Glass-to-glass latency against a local stand-in for a low-latency origin
+// publishing 200 ms parts of 1 s segments, with PART-HOLD-BACK 0.6 s and
+// HOLD-BACK 3 s: following parts, hints and blocking reloads, and loading
+// whole segments as a client from before low-latency HLS would.
+TEST(LlHlsLoader, CutsGlassToGlassLatencyWithParts) {
+  LlHlsOrigin origin(OriginOptions());
+  ASSERT_TRUE(origin.ok());
+
+  LlHlsConfig config;
+  LlHlsStats low_stats;
+  const Latency low = Measure(origin, config, 3000000, &low_stats);
+  config.low_latency = false;
+  LlHlsStats legacy_stats;
+  const Latency legacy = Measure(origin, config, 3000000, &legacy_stats);
+
+  std::printf(
+      "glass to glass: parts %.2f s mean, %.2f s max (%lld parts, %llu "
+      "hinted, %llu blocking reloads); segments %.2f s mean, %.2f s max "
+      "(%llu playlist requests)\n",
+      low.mean_us / 1e6, low.max_us / 1e6, static_cast<long long>(low.parts),
+      static_cast<unsigned long long>(low_stats.hinted_parts),
+      static_cast<unsigned long long>(low_stats.blocking_reloads),
+      legacy.mean_us / 1e6, legacy.max_us / 1e6,
+      static_cast<unsigned long long>(legacy_stats.playlist_requests));
+
+  EXPECT_TRUE(low.in_order);
+  EXPECT_TRUE(legacy.in_order);
+  EXPECT_GT(low.parts, 10);
+  EXPECT_GT(low_stats.hinted_parts, 0u);
+  EXPECT_GT(low_stats.blocking_reloads, 0u);
+  EXPECT_EQ(legacy_stats.parts, 0u);
+  EXPECT_EQ(legacy_stats.blocking_reloads, 0u);
+  // PART-HOLD-BACK plus about a part to load it.
+  EXPECT_LT(low.max_us, 1500000);
+  EXPECT_GT(legacy.mean_us, low.mean_us + 1500000);
+}
+
+TEST(LlHlsLoader, FollowsMasterPlaylists) {
+  LlHlsOrigin origin(OriginOptions());
+  ASSERT_TRUE(origin.ok());
+  ThrottledHttpServer server({});
+  ASSERT_TRUE(server.ok());
+  server.Set("/master.m3u8",
+             "#EXTM3U\n"
+             "#EXT-X-STREAM-INF:BANDWIDTH=800000\n" +
+                 origin.Url() +
+                 "\n"
+                 "#EXT-X-STREAM-INF:BANDWIDTH=5000000\n"
+                 "/missing.m3u8\n");
+  LlHlsConfig config;
+  config.max_bandwidth = 1000000;
+  LlHlsLoader loader(config);
+  std::string error;
+  ASSERT_TRUE(loader.Open(server.Url("/master.m3u8"), &error)) << error;
+  EXPECT_EQ(loader.media_url(), origin.Url());
+  EXPECT_TRUE(loader.low_latency());
+  EXPECT_EQ(loader.duration_us(), -1);
+  uint8_t data[kPartBytes];
+  size_t filled = 0;
+  while (filled < sizeof(data)) {
+    const int64_t read = loader.Read(data + filled, sizeof(data) - filled);
+    ASSERT_GT(read, 0) << loader.error();
+    filled += read;
+  }
+  LlHlsOrigin::PartHeader header;
+  EXPECT_TRUE(LlHlsOrigin::ReadHeader(data, sizeof(data), &header));
+  loader.Interrupt();
+  EXPECT_EQ(loader.Read(data, sizeof(data)), -1);
+}
+
+TEST(LlHlsLoader, SwitchesVariantsAtSegmentBoundaries) {
+  ThrottledHttpServer server({});
+  ASSERT_TRUE(server.ok());
+  server.Set("/master.m3u8",
+             "#EXTM3U\n"
+             "#EXT-X-STREAM-INF:BANDWIDTH=3000000\n"
+             "hi.m3u8\n"
+             "#EXT-X-STREAM-INF:BANDWIDTH=400000\n"
+             "lo.m3u8\n");
+  for (const std::string variant : {"lo", "hi"}) {
+    std::string playlist =
+        "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXT-X-PLAYLIST-TYPE:VOD\n";
+    for (int i = 0; i < 4; ++i) {
+      const std::string name = variant + std::to_string(i);
+      playlist += "#EXTINF:2.0,\n" + name + ".ts\n";
+      server.Set("/" + name + ".ts", name + ";");
+    }
+    server.Set("/" + variant + ".m3u8", playlist + "#EXT-X-ENDLIST\n");
+  }
+
+  AbrController abr(AbrConfig(), std::make_unique<ThroughputAbrPolicy>());
+  std::vector<AbrDecision> decisions;
+  abr.SetCallback([&abr, &decisions](const AbrDecision& decision) {
+    decisions.push_back(decision);
+    // Up to the top from the second segment on.
+    if (decisions.size() == 1) abr.SetManual("3000kbps");
+  });
+  LlHlsConfig config;
+  config.abr = &abr;
+  LlHlsLoader loader(config);
+  std::string error;
+  ASSERT_TRUE(loader.Open(server.Url("/master.m3u8"), &error)) << error;
+  EXPECT_TRUE(loader.adaptive());
+  EXPECT_FALSE(loader.low_latency());
+  EXPECT_EQ(loader.duration_us(), 8000000);
+  std::string stream;
+  char data[64];
+  int64_t read;
+  while ((read = loader.Read(reinterpret_cast<uint8_t*>(data),
+                             sizeof(data))) > 0) {
+    stream.append(data, read);
+  }
+  ASSERT_EQ(read, 0) << loader.error();
+  EXPECT_EQ(stream, "lo0;hi1;hi2;hi3;");
+  EXPECT_EQ(loader.media_url(), server.Url("/hi.m3u8"));
+  EXPECT_EQ(loader.stats().variant_switches, 1u);
+  // One per segment, the first made on opening.
+  ASSERT_EQ(decisions.size(), 4u);
+  EXPECT_EQ(decisions[0].rendition.name, "400kbps");
+  EXPECT_TRUE(decisions[1].switched());
+  EXPECT_EQ(decisions[1].reason, "manual");
+  EXPECT_FALSE(decisions[2].switched());
+}
+
+TEST(LlHlsLoader, ReplaysVodSegmentsFromTheCache) {
+  ThrottledHttpServer server({});
+  ASSERT_TRUE(server.ok());
+  std::string playlist =
+      "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXT-X-PLAYLIST-TYPE:VOD\n";
+  for (int i = 0; i < 4; ++i) {
+    const std::string name = "s" + std::to_string(i);
+    playlist += "#EXTINF:2.0,\n" + name + ".ts\n";
+    server.Set("/" + name + ".ts", name + ";");
+  }
+  server.Set("/vod.m3u8", playlist + "#EXT-X-ENDLIST\n");
+  SegmentCacheConfig cache_config;
+  cache_config.directory = ::testing::TempDir() + "ll_hls_loader_cache";
+  std::filesystem::remove_all(cache_config.directory);
+  std::string error;
+  std::unique_ptr<SegmentCache> cache =
+      SegmentCache::Open(cache_config, &error);
+  ASSERT_NE(cache, nullptr) << error;
+
+  LlHlsConfig config;
+  config.cache = cache.get();
+  {
+    LlHlsLoader loader(config);
+    ASSERT_TRUE(loader.Open(server.Url("/vod.m3u8"), &error)) << error;
+    EXPECT_EQ(ReadAll(&loader), "s0;s1;s2;s3;");
+    EXPECT_EQ(loader.stats().cache_hits, 0u);
+  }
+  const int requests = server.requests();
+  {
+    LlHlsLoader loader(config);
+    ASSERT_TRUE(loader.Open(server.Url("/vod.m3u8"), &error)) << error;
+    EXPECT_EQ(ReadAll(&loader), "s0;s1;s2;s3;");
+    EXPECT_EQ(loader.stats().cache_hits, 4u);
+    EXPECT_EQ(loader.stats().cache_bytes, 12u);
+  }
+  // Only the playlist was loaded again.
+  EXPECT_EQ(server.requests(), requests + 1);
+
+  // Seeking into the third segment starts there.
+  config.start_us = 4500000;
+  LlHlsLoader loader(config);
+  ASSERT_TRUE(loader.Open(server.Url("/vod.m3u8"), &error)) << error;
+  EXPECT_EQ(ReadAll(&loader), "s2;s3;");
+}
+
+TEST(LlHlsLoader, PrefetchesWholeSegments) {
+  // 50 ms to every response, as if the CDN were a round trip away.
+  ThrottledHttpServer::Options options;
+  options.latency_us = 50000;
+  ThrottledHttpServer server(options);
+  ASSERT_TRUE(server.ok());
+  std::string playlist = "#EXTM3U\n#EXT-X-TARGETDURATION:2\n";
+  std::string expected;
+  for (int i = 0; i < 8; ++i) {
+    const std::string name = "s" + std::to_string(i);
+    playlist += "#EXTINF:2.0,\n" + name + ".ts\n";
+    server.Set("/" + name + ".ts", name + ";");
+    expected += name + ";";
+  }
+  server.Set("/vod.m3u8", playlist + "#EXT-X-ENDLIST\n");
+
+  int64_t elapsed_us[2];
+  for (int prefetch : {0, 3}) {
+    LlHlsConfig config;
+    config.prefetch_segments = prefetch;
+    LlHlsLoader loader(config);
+    std::string error;
+    const int64_t start_us = NowUs();
+    ASSERT_TRUE(loader.Open(server.Url("/vod.m3u8"), &error)) << error;
+    EXPECT_EQ(ReadAll(&loader), expected);
+    elapsed_us[prefetch > 0] = NowUs() - start_us;
+    EXPECT_EQ(loader.stats().segments, 8u);
+    EXPECT_EQ(loader.stats().prefetched_segments, prefetch > 0 ? 8u : 0u);
+  }
+  std::printf("8 segments 50 ms away: %.0f ms one at a time, %.0f ms "
+              "prefetched\n",
+              elapsed_us[0] / 1000.0, elapsed_us[1] / 1000.0);
+  // The playlist and a segment one after the other, then several at once.
+  EXPECT_GE(elapsed_us[0], 9 * 50000);
+  EXPECT_LT(elapsed_us[1], elapsed_us[0] * 6 / 10);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,172 @@
+#include "test/ll_hls_origin.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr char kMagic[] = "LLHS";
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string Seconds(int64_t us) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.3f", us / 1e6);
+  return text;
+}
+
+// The value of |name| in the query of |target|, or -1.
+int64_t QueryValue(const std::string& target, const std::string& name) {
+  const size_t query = target.find('?');
+  if (query == std::string::npos) return -1;
+  size_t pos = target.find(name + "=", query);
+  if (pos == std::string::npos) return -1;
+  return std::strtoll(target.c_str() + pos + name.size() + 1, nullptr, 10);
+}
+
+}  // namespace
+
+LlHlsOrigin::LlHlsOrigin(const Options& options)
+    : options_(options),
+      start_us_(NowUs() - options.window_segments *
+                              options.parts_per_segment * options.part_us),
+      server_(options.server) {
+  server_.SetHandler([this](const std::string& target, std::string* body) {
+    return Handle(target, body);
+  });
+}
+
+LlHlsOrigin::~LlHlsOrigin() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+}
+
+bool LlHlsOrigin::ReadHeader(const uint8_t* data, size_t size,
+                             PartHeader* header) {
+  if (size < 28 || std::memcmp(data, kMagic, 4) != 0) return false;
+  std::memcpy(&header->msn, data + 4, 8);
+  std::memcpy(&header->part, data + 12, 8);
+  std::memcpy(&header->capture_us, data + 20, 8);
+  return true;
+}
+
+int64_t LlHlsOrigin::PartsOut() const {
+  return (NowUs() - start_us_) / options_.part_us;
+}
+
+bool LlHlsOrigin::WaitForParts(int64_t parts) {
+  // Servers hold a request for at most a few target durations.
+  const int64_t deadline_us =
+      NowUs() + 3 * options_.parts_per_segment * options_.part_us;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_ && PartsOut() < parts) {
+    const int64_t due_us = start_us_ + parts * options_.part_us;
+    if (due_us > deadline_us) return false;
+    cv_.wait_for(lock, std::chrono::microseconds(due_us - NowUs()));
+  }
+  return !stopping_;
+}
+
+int LlHlsOrigin::Handle(const std::string& target, std::string* body) {
+  const int64_t pps = options_.parts_per_segment;
+  const std::string path = target.substr(0, target.find('?'));
+  if (path == "/live.m3u8") {
+    const int64_t msn = QueryValue(target, "_HLS_msn");
+    if (msn >= 0) {
+      const int64_t part = QueryValue(target, "_HLS_part");
+      // Held until that part, or without one the whole segment, is out.
+      const int64_t needed =
+          part >= 0 ? msn * pps + part + 1 : (msn + 1) * pps;
+      if (!WaitForParts(needed)) return 503;
+    }
+    *body = Playlist(PartsOut());
+    return 200;
+  }
+  long long msn = 0;
+  long long part = 0;
+  if (std::sscanf(path.c_str(), "/s%lld.%lld.ts", &msn, &part) == 2) {
+    const int64_t index = msn * pps + part;
+    if (!WaitForParts(index + 1)) return 404;
+    *body = Part(index);
+    return 200;
+  }
+  if (std::sscanf(path.c_str(), "/s%lld.ts", &msn) == 1) {
+    if (!WaitForParts((msn + 1) * pps)) return 404;
+    for (int64_t i = 0; i < pps; ++i) body->append(Part(msn * pps + i));
+    return 200;
+  }
+  return 404;
+}
+
+std::string LlHlsOrigin::Playlist(int64_t parts) const {
+  const int64_t pps = options_.parts_per_segment;
+  const int64_t complete = parts / pps;
+  const int64_t first =
+      complete > options_.window_segments ? complete - options_.window_segments
+                                          : 0;
+  const int64_t segment_us = pps * options_.part_us;
+  std::string text =
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:9\n"
+      "#EXT-X-TARGETDURATION:" +
+      std::to_string((segment_us + 999999) / 1000000) +
+      "\n"
+      "#EXT-X-PART-INF:PART-TARGET=" +
+      Seconds(options_.part_us) +
+      "\n"
+      "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=" +
+      Seconds(3 * options_.part_us) + ",HOLD-BACK=" +
+      Seconds(3 * segment_us) +
+      "\n"
+      "#EXT-X-MEDIA-SEQUENCE:" +
+      std::to_string(first) + "\n";
+  auto list_part = [&](int64_t msn, int64_t part) {
+    text += "#EXT-X-PART:DURATION=" + Seconds(options_.part_us) +
+            ",URI=\"s" + std::to_string(msn) + "." + std::to_string(part) +
+            ".ts\"" + (part == 0 ? ",INDEPENDENT=YES" : "") + "\n";
+  };
+  for (int64_t msn = first; msn < complete; ++msn) {
+    if (msn >= complete - 3) {
+      for (int64_t part = 0; part < pps; ++part) list_part(msn, part);
+    }
+    text += "#EXTINF:" + Seconds(segment_us) + ",\ns" + std::to_string(msn) +
+            ".ts\n";
+  }
+  for (int64_t part = 0; part < parts % pps; ++part) {
+    list_part(complete, part);
+  }
+  text += "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"s" + std::to_string(complete) +
+          "." + std::to_string(parts % pps) + ".ts\"\n";
+  text += "#EXT-X-RENDITION-REPORT:URI=\"alt.m3u8\",LAST-MSN=" +
+          std::to_string(complete) +
+          ",LAST-PART=" + std::to_string(parts % pps) + "\n";
+  return text;
+}
+
+std::string LlHlsOrigin::Part(int64_t index) const {
+  const int64_t pps = options_.parts_per_segment;
+  const int64_t msn = index / pps;
+  const int64_t part = index % pps;
+  const int64_t capture_us = start_us_ + index * options_.part_us;
+  std::string data(options_.part_bytes, '\0');
+  std::memcpy(&data[0], kMagic, 4);
+  std::memcpy(&data[4], &msn, 8);
+  std::memcpy(&data[12], &part, 8);
+  std::memcpy(&data[20], &capture_us, 8);
+  return data;
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,78 @@
+#ifndef IVS_BROADCASTER_TEST_LL_HLS_ORIGIN_H_
+#define IVS_BROADCASTER_TEST_LL_HLS_ORIGIN_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "test/throttled_http_server.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+// A live low-latency HLS origin on a ThrottledHttpServer.
+//
+// An imaginary encoder finishes a part every |part_us|; the origin lists it
+// with EXT-X-PART, hints the next one with EXT-X-PRELOAD-HINT, and closes a
+// segment every |parts_per_segment| parts. Requests for parts and segments
+// not out yet, and playlist reloads with _HLS_msn/_HLS_part, are held until
+// they can be answered. Each part starts with a header giving its capture
+// time, so a client can measure glass-to-glass latency from the bytes.
+class LlHlsOrigin {
+ public:
+  struct Options {
+    int64_t part_us = 200000;
+    int parts_per_segment = 5;
+    // Segments listed in the playlist; parts are listed for the last 3.
+    int window_segments = 6;
+    int part_bytes = 2000;
+    ThrottledHttpServer::Options server;
+  };
+
+  // The header at the start of each part.
+  struct PartHeader {
+    int64_t msn = 0;
+    int64_t part = 0;
+    // When the first frame of the part was captured, on the steady clock.
+    int64_t capture_us = 0;
+  };
+
+  explicit LlHlsOrigin(const Options& options);
+  ~LlHlsOrigin();
+
+  LlHlsOrigin(const LlHlsOrigin&) = delete;
+  LlHlsOrigin& operator=(const LlHlsOrigin&) = delete;
+
+  bool ok() const { return server_.ok(); }
+  std::string Url() const { return server_.Url("/live.m3u8"); }
+
+  // Reads the header of the part starting at |data|.
+  static bool ReadHeader(const uint8_t* data, size_t size, PartHeader* header);
+
+ private:
+  int Handle(const std::string& target, std::string* body);
+  // Waits until |parts| parts are out. Returns false when giving up.
+  bool WaitForParts(int64_t parts);
+  int64_t PartsOut() const;
+  std::string Playlist(int64_t parts) const;
+  std::string Part(int64_t index) const;
+
+  const Options options_;
+  // The imaginary encoder started this long before the origin, so the
+  // playlist has a full window from the start.
+  int64_t start_us_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+
+  // Last, so that it stops serving before the state above goes away.
+  ThrottledHttpServer server_;
+};
+
+}  // namespace test
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_TEST_LL_HLS_ORIGIN_H_
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "memory_budget.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+MemoryBudgetConfig Config(size_t max_bytes) {
+  MemoryBudgetConfig config;
+  config.max_bytes = max_bytes;
+  config.rank_weights = {8, 2, 1};
+  return config;
+}
+
+}  // namespace
+
+TEST(MemoryBudget, SharesTheBudgetByRank) {
+  MemoryBudget budget(Config(1100));
+  budget.Register("selected", nullptr);
+  budget.Register("previous", nullptr);
+  budget.Register("never", nullptr);
+  budget.SetRank("selected", 0);
+  budget.SetRank("previous", 1);
+  EXPECT_EQ(budget.Allowance("selected"), 800u);
+  EXPECT_EQ(budget.Allowance("previous"), 200u);
+  EXPECT_EQ(budget.Allowance("never"), 100u);
+
+  const std::vector<PlayerMemory> players = budget.players();
+  ASSERT_EQ(players.size(), 3u);
+  EXPECT_EQ(players[0].id, "selected");
+  EXPECT_EQ(players[1].id, "previous");
+  EXPECT_EQ(players[2].id, "never");
+  EXPECT_EQ(players[2].allowance_bytes, 100u);
+}
+
+TEST(MemoryBudget, EvictsTheLeastRecentlySelectedFirst) {
+  MemoryBudget budget(Config(1000));
+  std::vector<std::string> evicted;
+  for (const std::string id : {"selected", "previous", "older", "never"}) {
+    budget.Register(id, [&evicted, id] {
+      evicted.push_back(id);
+      return size_t{200};
+    });
+  }
+  budget.SetRank("selected", 0);
+  budget.SetRank("previous", 1);
+  budget.SetRank("older", 2);
+  budget.Update("never", 200, 0);
+  budget.Update("older", 200, 0);
+  budget.Update("previous", 200, 0);
+  EXPECT_TRUE(evicted.empty());
+
+  // 1100 bytes: the player never selected goes first and that suffices.
+  budget.Update("selected", 300, 200);
+  EXPECT_EQ(evicted, std::vector<std::string>({"never"}));
+  EXPECT_EQ(budget.stats().bytes, 900u);
+
+  // Then by how long ago the others were selected.
+  budget.Update("selected", 600, 200);
+  EXPECT_EQ(evicted, std::vector<std::string>({"never", "older"}));
+  const MemoryBudgetStats stats = budget.stats();
+  EXPECT_EQ(stats.bytes, 1000u);
+  EXPECT_EQ(stats.peak_bytes, 1200u);
+  EXPECT_EQ(stats.evictions, 2u);
+  EXPECT_EQ(stats.evicted_bytes, 400u);
+  EXPECT_EQ(stats.overruns, 0u);
+
+  const std::vector<PlayerMemory> players = budget.players();
+  ASSERT_EQ(players.size(), 4u);
+  EXPECT_EQ(players[2].id, "older");
+  EXPECT_EQ(players[2].bytes(), 0u);
+  EXPECT_EQ(players[2].peak_bytes, 200u);
+  EXPECT_EQ(players[2].evictions, 1u);
+}
+
+TEST(MemoryBudget, EvictsTheSelectedPlayerLastAndCountsOverruns) {
+  MemoryBudget budget(Config(1000));
+  std::vector<std::string> evicted;
+  // Gives back only what it cached, keeping its decoded pictures.
+  budget.Register("selected", [&evicted] {
+    evicted.push_back("selected");
+    return size_t{100};
+  });
+  budget.Register("background", [&evicted] {
+    evicted.push_back("background");
+    return size_t{0};
+  });
+  budget.SetRank("selected", 0);
+  budget.SetRank("background", 1);
+  budget.Update("background", 100, 0);
+  budget.Update("selected", 600, 600);
+
+  // Nothing freed by the background player counts as an eviction.
+  EXPECT_EQ(evicted, std::vector<std::string>({"background", "selected"}));
+  const MemoryBudgetStats stats = budget.stats();
+  EXPECT_EQ(stats.bytes, 1200u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.overruns, 1u);
+  EXPECT_EQ(budget.players()[0].demuxed_bytes, 500u);
+}
+
+TEST(MemoryBudget, ForgetsUnregisteredPlayers) {
+  MemoryBudget budget(Config(1000));
+  int evictions = 0;
+  budget.Register("a", [&evictions] {
+    ++evictions;
+    return size_t{0};
+  });
+  budget.Register("b", nullptr);
+  budget.Update("a", 400, 0);
+  EXPECT_EQ(budget.Allowance("b"), 500u);
+
+  budget.Unregister("a");
+  EXPECT_EQ(budget.stats().bytes, 0u);
+  EXPECT_EQ(budget.Allowance("b"), 1000u);
+  budget.Update("a", 2000, 0);
+  budget.Update("b", 900, 0);
+  EXPECT_EQ(evictions, 0);
+  EXPECT_EQ(budget.stats().bytes, 900u);
+  EXPECT_EQ(budget.players().size(), 1u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
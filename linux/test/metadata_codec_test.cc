@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "metadata_codec.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+// Quiz traffic: the same keys and choices with different ids and text.
+std::string QuizMessage(int i) {
+  return "{\"type\":\"question\",\"id\":" + std::to_string(1000 + i) +
+         ",\"text\":\"Question number " + std::to_string(i) +
+         "?\",\"choices\":[\"A\",\"B\",\"C\",\"D\"],\"timeout\":15}";
+}
+
+}  // namespace
+
+TEST(MetadataCodec, Base64RoundTrips) {
+  for (const std::string& input :
+       {std::string(), std::string("f"), std::string("fo"),
+        std::string("foo"), std::string("foob"),
+        std::string("\0\xff\x80", 3)}) {
+    std::string decoded;
+    ASSERT_TRUE(Base64Decode(Base64Encode(input), &decoded));
+    EXPECT_EQ(decoded, input);
+  }
+  EXPECT_EQ(Base64Encode("foobar"), "Zm9vYmFy");
+  EXPECT_EQ(Base64Encode("fo"), "Zm8=");
+  std::string decoded;
+  EXPECT_FALSE(Base64Decode("Zm9", &decoded));
+  EXPECT_FALSE(Base64Decode("Zm*v", &decoded));
+}
+
+TEST(MetadataCodec, FramesSingleMessagesVerbatim) {
+  EXPECT_EQ(EncodeMetadataPayload({"hello"}, nullptr), "hello");
+  std::vector<std::string> messages;
+  ASSERT_TRUE(DecodeMetadataPayload("hello", nullptr, &messages));
+  EXPECT_EQ(messages, std::vector<std::string>{"hello"});
+  EXPECT_FALSE(IsValidMetadataMessage("a\x1e" "b"));
+}
+
+TEST(MetadataCodec, RoundTripsBatchesWithAndWithoutCompression) {
+  std::vector<std::string> batch;
+  for (int i = 0; i < 6; ++i) batch.push_back(QuizMessage(i));
+  batch.push_back("");
+
+  std::vector<std::string> decoded;
+  const std::string plain = EncodeMetadataPayload(batch, nullptr);
+  ASSERT_TRUE(DecodeMetadataPayload(plain, nullptr, &decoded));
+  EXPECT_EQ(decoded, batch);
+
+  MetadataCompressor compressor("");
+  const std::string packed = EncodeMetadataPayload(batch, &compressor);
+  EXPECT_EQ(packed[0], kMetadataCompressedMarker);
+  EXPECT_LT(packed.size(), plain.size());
+  ASSERT_TRUE(DecodeMetadataPayload(packed, &compressor, &decoded));
+  EXPECT_EQ(decoded, batch);
+  EXPECT_FALSE(DecodeMetadataPayload(packed, nullptr, &decoded));
+}
+
+TEST(MetadataCodec, TrainedDictionaryShrinksShortMessages) {
+  std::vector<std::string> samples;
+  for (int i = 0; i < 50; ++i) samples.push_back(QuizMessage(i));
+  const std::string dictionary = TrainMetadataDictionary(samples, 1024);
+  EXPECT_FALSE(dictionary.empty());
+  EXPECT_LE(dictionary.size(), 1024u);
+
+  MetadataCompressor plain("");
+  MetadataCompressor trained(dictionary);
+  size_t raw = 0;
+  size_t without = 0;
+  size_t with = 0;
+  for (int i = 100; i < 150; ++i) {
+    const std::string message = QuizMessage(i);
+    std::string compressed;
+    raw += message.size();
+    ASSERT_TRUE(plain.Compress(message, &compressed));
+    without += compressed.size();
+    ASSERT_TRUE(trained.Compress(message, &compressed));
+    with += compressed.size();
+    std::string restored;
+    ASSERT_TRUE(trained.Decompress(compressed, &restored));
+    EXPECT_EQ(restored, message);
+  }
+  std::printf("50 quiz messages: %zu raw, %zu deflated, %zu with a %zu-byte "
+              "dictionary\n",
+              raw, without, with, dictionary.size());
+  EXPECT_LT(with * 2, without);
+}
+
+// The built-in dictionary is what production uses when Dart passes none, so
+// it must help on messages it was not trained on.
+TEST(MetadataCodec, DefaultDictionaryShrinksTypicalMessages) {
+  const std::string& dictionary = DefaultMetadataDictionary();
+  EXPECT_FALSE(dictionary.empty());
+  EXPECT_LE(dictionary.size(), 1024u);
+  EXPECT_TRUE(IsValidMetadataMessage(dictionary));
+
+  MetadataCompressor plain("");
+  MetadataCompressor preset(dictionary);
+  size_t without = 0;
+  size_t with = 0;
+  for (int i = 0; i < 20; ++i) {
+    const std::string message = QuizMessage(i);
+    std::string compressed;
+    ASSERT_TRUE(plain.Compress(message, &compressed));
+    without += compressed.size();
+    ASSERT_TRUE(preset.Compress(message, &compressed));
+    with += compressed.size();
+    std::string restored;
+    ASSERT_TRUE(preset.Decompress(compressed, &restored));
+    EXPECT_EQ(restored, message);
+  }
+  std::printf("20 quiz messages: %zu deflated, %zu with the %zu-byte default "
+              "dictionary\n",
+              without, with, dictionary.size());
+  EXPECT_LT(with * 4, without * 3);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metadata_queue.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int64_t kFrameUs = 33333;
+
+std::string Answer(int player, int choice) {
+  return "{\"type\":\"answer\",\"player\":" + std::to_string(player) +
+         ",\"choice\":" + std::to_string(choice) + "}";
+}
+
+}  // namespace
+
+TEST(MetadataQueue, BatchesMessagesWithinTheWindow) {
+  MetadataQueue queue(MetadataQueueConfig(), nullptr);
+  EXPECT_TRUE(queue.Push("a", 0));
+  EXPECT_TRUE(queue.Push("b", 40000));
+  std::vector<MetadataPayload> payloads;
+  queue.Poll(66666, &payloads);
+  EXPECT_TRUE(payloads.empty());
+  queue.Poll(100000, &payloads);
+  ASSERT_EQ(payloads.size(), 1u);
+  EXPECT_EQ(payloads[0].messages, 2u);
+  EXPECT_EQ(payloads[0].pts_us, 100000);
+  std::vector<std::string> messages;
+  ASSERT_TRUE(DecodeMetadataPayload(payloads[0].data, nullptr, &messages));
+  EXPECT_EQ(messages, (std::vector<std::string>{"a", "b"}));
+}
+
+TEST(MetadataQueue, DropsDuplicatesAndOversizedMessages) {
+  MetadataQueueConfig config;
+  config.max_payload_bytes = 64;
+  MetadataQueue queue(config, nullptr);
+  EXPECT_TRUE(queue.Push("next question", 0));
+  EXPECT_FALSE(queue.Push("next question", 500000));
+  EXPECT_FALSE(queue.Push(std::string(65, 'x'), 0));
+  EXPECT_FALSE(queue.Push("bad\x1f", 0));
+  std::vector<MetadataPayload> payloads;
+  queue.Poll(2500000, &payloads);
+  ASSERT_EQ(payloads.size(), 1u);
+  // The dedup window has passed.
+  EXPECT_TRUE(queue.Push("next question", 2600000));
+  const MetadataQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.deduplicated, 1u);
+  EXPECT_EQ(stats.dropped, 2u);
+}
+
+// A quiz round: 300 answers in the first two seconds, then quiet. The queue
+// must stay inside the byte budget, never exceed the payload cap, and deliver
+// everything within max_age.
+TEST(MetadataQueue, KeepsABurstInsideTheBudget) {
+  for (bool compress : {false, true}) {
+    MetadataQueueConfig config;
+    std::shared_ptr<const MetadataCompressor> compressor;
+    if (compress) {
+      std::vector<std::string> samples;
+      for (int i = 0; i < 40; ++i) samples.push_back(Answer(i, i % 4));
+      compressor = std::make_shared<MetadataCompressor>(
+          TrainMetadataDictionary(samples, 512));
+    }
+    MetadataQueue queue(config, compressor);
+    std::vector<MetadataPayload> payloads;
+    int pushed = 0;
+    int64_t now = 0;
+    for (; now < 10000000; now += kFrameUs) {
+      while (now < 2000000 && pushed * 2000000 / 300 <= now) {
+        queue.Push(Answer(pushed, pushed % 4), now);
+        ++pushed;
+      }
+      queue.Poll(now, &payloads);
+    }
+    size_t sent = 0;
+    size_t messages = 0;
+    for (const MetadataPayload& payload : payloads) {
+      EXPECT_LE(payload.data.size(), config.max_payload_bytes);
+      sent += payload.data.size();
+      messages += payload.messages;
+      std::vector<std::string> decoded;
+      ASSERT_TRUE(
+          DecodeMetadataPayload(payload.data, compressor.get(), &decoded));
+      EXPECT_EQ(decoded.size(), payload.messages);
+    }
+    // Burst plus the sustained rate over the run.
+    EXPECT_LE(sent, config.burst_bytes + config.bytes_per_second * 10);
+    const MetadataQueueStats stats = queue.stats();
+    EXPECT_EQ(stats.sent_messages + stats.dropped, 300u);
+    std::printf("%s: %zu of 300 messages in %zu payloads, %zu bytes "
+                "(%llu raw), max delay %.2f s\n",
+                compress ? "deflate+dictionary" : "plain", messages,
+                payloads.size(), sent,
+                static_cast<unsigned long long>(stats.raw_bytes),
+                stats.max_delay_us / 1e6);
+    if (compress) {
+      EXPECT_EQ(messages, 300u);
+    }
+  }
+}
+
+TEST(MetadataQueue, ExpiresMessagesThatWaitTooLong) {
+  MetadataQueueConfig config;
+  config.bytes_per_second = 10;
+  config.burst_bytes = 0;
+  config.max_age_us = 1000000;
+  MetadataQueue queue(config, nullptr);
+  queue.Push("stale", 0);
+  std::vector<MetadataPayload> payloads;
+  queue.Poll(500000, &payloads);
+  queue.Poll(1500000, &payloads);
+  EXPECT_TRUE(payloads.empty());
+  EXPECT_EQ(queue.stats().dropped, 1u);
+}
+
+TEST(MetadataQueue, KeepsPendingMessagesWhenReconfigured) {
+  MetadataQueue previous(MetadataQueueConfig(), nullptr);
+  EXPECT_TRUE(previous.Push("a", 0));
+  EXPECT_TRUE(previous.Push(std::string(100, 'x'), 10000));
+
+  MetadataQueueConfig config;
+  config.max_payload_bytes = 64;
+  MetadataQueue queue(config, nullptr);
+  queue.MoveFrom(&previous);
+  // Deduplication carries over too.
+  EXPECT_FALSE(queue.Push("a", 20000));
+
+  std::vector<MetadataPayload> payloads;
+  previous.Poll(100000, &payloads);
+  EXPECT_TRUE(payloads.empty());
+  queue.Poll(100000, &payloads);
+  ASSERT_EQ(payloads.size(), 1u);
+  std::vector<std::string> messages;
+  ASSERT_TRUE(DecodeMetadataPayload(payloads[0].data, nullptr, &messages));
+  EXPECT_EQ(messages, std::vector<std::string>{"a"});
+  const MetadataQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.pushed, 3u);
+  EXPECT_EQ(stats.sent_messages, 1u);
+  // The long message no longer fits the new payload cap.
+  EXPECT_EQ(stats.dropped, 1u);
+  EXPECT_EQ(stats.deduplicated, 1u);
+}
+
+TEST(MetadataQueue, ClearDropsPendingMessages) {
+  MetadataQueue queue(MetadataQueueConfig(), nullptr);
+  EXPECT_TRUE(queue.Push("a", 0));
+  EXPECT_TRUE(queue.Push("b", 0));
+  queue.Clear();
+  std::vector<MetadataPayload> payloads;
+  queue.Poll(1000000, &payloads);
+  EXPECT_TRUE(payloads.empty());
+  EXPECT_EQ(queue.stats().dropped, 2u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "mosaic.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+VideoFrame Solid(int width, int height, uint8_t y, uint8_t u, uint8_t v) {
+  VideoFrame frame;
+  frame.Allocate(width, height);
+  std::fill(frame.y(), frame.u(), y);
+  std::fill(frame.u(), frame.v(), u);
+  std::fill(frame.v(), frame.data.data() + frame.data.size(), v);
+  return frame;
+}
+
+uint8_t YAt(const VideoFrame& frame, int x, int y) {
+  return frame.y()[y * frame.y_stride() + x];
+}
+
+uint8_t UAt(const VideoFrame& frame, int x, int y) {
+  return frame.u()[(y / 2) * frame.uv_stride() + x / 2];
+}
+
+}  // namespace
+
+TEST(Mosaic, LaysOutGridsAndSpotlights) {
+  std::vector<MosaicTile> tiles = GridLayout(4);
+  ASSERT_EQ(tiles.size(), 4u);
+  EXPECT_DOUBLE_EQ(tiles[3].x, 0.5);
+  EXPECT_DOUBLE_EQ(tiles[3].y, 0.5);
+  EXPECT_DOUBLE_EQ(tiles[3].width, 0.5);
+
+  // Five streams need three columns and leave a gap in the second row.
+  tiles = GridLayout(5);
+  ASSERT_EQ(tiles.size(), 5u);
+  EXPECT_DOUBLE_EQ(tiles[4].x, 1.0 / 3);
+  EXPECT_DOUBLE_EQ(tiles[4].y, 0.5);
+  tiles = GridLayout(3, 1);
+  EXPECT_DOUBLE_EQ(tiles[2].y, 2.0 / 3);
+  EXPECT_DOUBLE_EQ(tiles[2].width, 1);
+
+  ASSERT_TRUE(MosaicLayoutNamed("spotlight", 4, 0, &tiles));
+  ASSERT_EQ(tiles.size(), 4u);
+  EXPECT_DOUBLE_EQ(tiles[0].width, 0.75);
+  EXPECT_DOUBLE_EQ(tiles[3].x, 0.75);
+  EXPECT_DOUBLE_EQ(tiles[3].y, 2.0 / 3);
+  EXPECT_FALSE(MosaicLayoutNamed("carousel", 4, 0, &tiles));
+}
+
+TEST(Mosaic, ScalesFramesIntoTheirTilesWithBars) {
+  MosaicConfig config;
+  config.width = 640;
+  config.height = 360;
+  config.tiles = GridLayout(4);
+  config.max_fps = 0;
+  std::vector<FramePtr> published;
+  MosaicCompositor mosaic(config, [&published](const FramePtr& frame) {
+    published.push_back(frame);
+  });
+  const MosaicRect rect = mosaic.tile_rect(3);
+  EXPECT_EQ(rect.x, 320);
+  EXPECT_EQ(rect.y, 180);
+  EXPECT_EQ(rect.width, 320);
+  EXPECT_EQ(rect.height, 180);
+
+  // A 16:9 frame fills tile 0; a square one is pillarboxed in tile 3.
+  mosaic.Update(0, Solid(1280, 720, 200, 90, 160));
+  mosaic.Update(3, Solid(400, 400, 100, 60, 200));
+  ASSERT_EQ(published.size(), 2u);
+  const VideoFrame& frame = *published.back();
+  EXPECT_EQ(frame.width, 640);
+  EXPECT_EQ(frame.height, 360);
+  EXPECT_EQ(YAt(frame, 0, 0), 200);
+  EXPECT_EQ(YAt(frame, 318, 178), 200);
+  EXPECT_EQ(UAt(frame, 100, 100), 90);
+  // 180x180 centred in 320x180: bars of 70 on either side.
+  EXPECT_EQ(YAt(frame, 320 + 69, 200), 16);
+  EXPECT_EQ(YAt(frame, 320 + 70, 200), 100);
+  EXPECT_EQ(YAt(frame, 320 + 249, 359), 100);
+  EXPECT_EQ(YAt(frame, 320 + 250, 200), 16);
+  EXPECT_EQ(UAt(frame, 320 + 100, 200), 60);
+  // Tiles never drawn stay black.
+  EXPECT_EQ(YAt(frame, 0, 200), 16);
+  EXPECT_EQ(UAt(frame, 0, 200), 128);
+
+  mosaic.Clear(0);
+  EXPECT_EQ(YAt(*mosaic.Snapshot(), 0, 0), 16);
+}
+
+TEST(Mosaic, NeverChangesAPublishedFrame) {
+  MosaicConfig config;
+  config.width = 320;
+  config.height = 180;
+  config.tiles = GridLayout(2);
+  config.max_fps = 0;
+  FramePtr held;
+  MosaicCompositor mosaic(config,
+                          [&held](const FramePtr& frame) { held = frame; });
+  mosaic.Update(0, Solid(160, 180, 50, 128, 128));
+  const FramePtr first = held;
+  mosaic.Update(0, Solid(160, 180, 150, 128, 128));
+  EXPECT_EQ(YAt(*first, 10, 10), 50);
+  EXPECT_EQ(YAt(*held, 10, 10), 150);
+  EXPECT_NE(first.get(), held.get());
+  EXPECT_EQ(mosaic.stats().copies, 1u);
+
+  // Once nothing else holds the canvas, it is drawn over in place.
+  const VideoFrame* canvas = held.get();
+  held.reset();
+  mosaic.Update(1, Solid(160, 180, 80, 128, 128));
+  EXPECT_EQ(held.get(), canvas);
+  EXPECT_EQ(mosaic.stats().copies, 1u);
+}
+
+TEST(Mosaic, PublishesAtMostMaxFps) {
+  MosaicConfig config;
+  config.width = 320;
+  config.height = 180;
+  config.tiles = GridLayout(4);
+  config.max_fps = 10;
+  int published = 0;
+  MosaicCompositor mosaic(config, [&published](const FramePtr&) {
+    ++published;
+  });
+  const VideoFrame frame = Solid(640, 360, 100, 128, 128);
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 40; ++i) mosaic.Update(i % 4, frame);
+  const int64_t elapsed_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  EXPECT_EQ(mosaic.stats().updates, 40u);
+  EXPECT_LE(published, 1 + elapsed_us / 100000);
+  EXPECT_GE(published, 1);
+  std::printf("mosaic: 40 tile updates from 640x360 in %.2f ms\n",
+              elapsed_us / 1000.0);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
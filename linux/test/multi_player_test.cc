@@ -0,0 +1,960 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "media_player.h"
+#include "multi_player.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int64_t kFrameUs = 5000;
+constexpr int kGop = 20;
+constexpr int64_t kLiveFrameUs = 33333;
+constexpr int kSampleRate = 48000;
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Returns a 2x2 frame per packet carrying the packet's timestamp, taking
+// |cost_us| for each.
+class FakeDecoder : public VideoDecoder {
+ public:
+  explicit FakeDecoder(int64_t cost_us = 0) : cost_us_(cost_us) {}
+
+  bool Decode(const MediaPacket& packet, VideoFrame* frame) override {
+    if (cost_us_ > 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(cost_us_));
+    }
+    frame->Allocate(2, 2);
+    frame->pts_us = packet.pts_us;
+    return true;
+  }
+  void Flush() override {}
+  void SetKeyframesOnly(bool keyframes_only) override {}
+
+ private:
+  const int64_t cost_us_;
+};
+
+// A 440 Hz tone, one frame's worth of stereo per packet.
+class FakeAudioDecoder : public AudioDecoder {
+ public:
+  explicit FakeAudioDecoder(int64_t frame_us) : frame_us_(frame_us) {}
+
+  bool Decode(const MediaPacket& packet, AudioBuffer* buffer) override {
+    const int frames = static_cast<int>(frame_us_ * kSampleRate / 1000000);
+    const int64_t first = packet.pts_us * kSampleRate / 1000000;
+    buffer->sample_rate = kSampleRate;
+    buffer->channels = 2;
+    buffer->pts_us = packet.pts_us;
+    buffer->samples.resize(frames * 2);
+    for (int i = 0; i < frames; ++i) {
+      const float sample = static_cast<float>(
+          0.5 * std::sin(2 * M_PI * 440 * (first + i) / kSampleRate));
+      buffer->samples[2 * i] = sample;
+      buffer->samples[2 * i + 1] = sample;
+    }
+    return true;
+  }
+
+ private:
+  const int64_t frame_us_;
+};
+
+// Video packets every |frame_us| with a keyframe every |gop|. A live source
+// hands each packet out only once its time has come, like the live edge of
+// a stream; otherwise |count| packets are available at once.
+class FakeSource : public MediaSource {
+ public:
+  FakeSource(bool live, int count, int64_t frame_us = kFrameUs,
+             int gop = kGop, int64_t decode_us = 0)
+      : live_(live),
+        count_(count),
+        frame_us_(frame_us),
+        gop_(gop),
+        decode_us_(decode_us) {}
+
+  void SetAbrController(AbrController* abr) override { abr_ = abr; }
+
+  bool Open(const std::string& url, std::string* error) override {
+    if (url.find("missing") != std::string::npos) {
+      *error = "cannot open " + url;
+      return false;
+    }
+    if (abr_ != nullptr) {
+      abr_->SetLadder({{"720p", 3000000, 1280, 720},
+                       {"240p", 400000, 426, 240}});
+    }
+    start_us_ = NowUs() - behind_us_;
+    return true;
+  }
+
+  // Makes a live source start |behind_us| behind its edge, with an audio
+  // packet after every video one, and report how far behind it is.
+  void StartBehind(int64_t behind_us) {
+    behind_us_ = behind_us;
+    audio_ = true;
+  }
+
+  // Carries a cue of |duration_us| every |every_us|, found with the packet
+  // after the one it starts at, as a demuxer may interleave them.
+  void CarryCues(int64_t every_us, int64_t duration_us) {
+    cue_every_us_ = every_us;
+    cue_duration_us_ = duration_us;
+  }
+
+  ReadResult Read(MediaPacket* packet, std::string* error) override {
+    if (audio_next_) {
+      audio_next_ = false;
+      packet->video = false;
+      packet->keyframe = true;
+      packet->data.assign(200, 0);
+      return ReadResult::kPacket;
+    }
+    if (index_ == count_) return ReadResult::kEnd;
+    const int64_t pts_us = index_ * frame_us_;
+    const int64_t previous_us = pts_us - frame_us_;
+    if (cue_every_us_ > 0 && previous_us >= 0 &&
+        previous_us % cue_every_us_ == 0) {
+      cues_.push_back({previous_us, previous_us + cue_duration_us_,
+                       "cue " + std::to_string(previous_us / 1000)});
+    }
+    if (live_) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_until(lock,
+                     std::chrono::steady_clock::time_point(
+                         std::chrono::microseconds(start_us_ + pts_us)),
+                     [this] { return interrupted_; });
+      if (interrupted_) {
+        *error = "interrupted";
+        return ReadResult::kError;
+      }
+    }
+    packet->video = true;
+    packet->keyframe = index_ % gop_ == 0;
+    // Every GOP stands in for a segment.
+    if (packet->keyframe && abr_ != nullptr) abr_->Decide(0, gop_ * frame_us_);
+    packet->pts_us = pts_us;
+    packet->data.assign(packet->keyframe ? 1000 : 100, 0);
+    ++index_;
+    audio_next_ = audio_;
+    return ReadResult::kPacket;
+  }
+
+  std::unique_ptr<VideoDecoder> CreateDecoder(std::string* error) override {
+    return std::make_unique<FakeDecoder>(decode_us_);
+  }
+
+  std::unique_ptr<AudioDecoder> CreateAudioDecoder() override {
+    if (!audio_) return nullptr;
+    return std::make_unique<FakeAudioDecoder>(frame_us_);
+  }
+
+  bool Seek(int64_t position_us) override {
+    if (live_) return false;
+    const int frame = static_cast<int>(position_us / frame_us_);
+    index_ = frame - frame % gop_;
+    audio_next_ = false;
+    return true;
+  }
+
+  void TakeCues(std::vector<MetadataCue>* cues) override {
+    cues->insert(cues->end(), cues_.begin(), cues_.end());
+    cues_.clear();
+  }
+
+  int64_t DurationUs() override { return live_ ? -1 : count_ * frame_us_; }
+
+  int64_t LiveLatencyUs() override {
+    if (!audio_ || index_ == 0) return -1;
+    return NowUs() - start_us_ - (index_ - 1) * frame_us_;
+  }
+
+  void Interrupt() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted_ = true;
+    cv_.notify_all();
+  }
+
+ private:
+  const bool live_;
+  const int count_;
+  const int64_t frame_us_;
+  const int gop_;
+  const int64_t decode_us_;
+  AbrController* abr_ = nullptr;
+  int index_ = 0;
+  int64_t start_us_ = 0;
+  int64_t behind_us_ = 0;
+  bool audio_ = false;
+  bool audio_next_ = false;
+  int64_t cue_every_us_ = 0;
+  int64_t cue_duration_us_ = 0;
+  std::vector<MetadataCue> cues_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool interrupted_ = false;
+};
+
+class RecordingListener : public MediaPlayer::Listener,
+                          public MultiPlayer::Listener {
+ public:
+  void OnStateChanged(MediaPlayer* player, PlayerState state) override {
+    OnStateChanged(player->url(), state);
+  }
+  void OnError(MediaPlayer* player, const std::string& message) override {
+    OnError(player->url(), message);
+  }
+  void OnFrame(MediaPlayer* player, const FramePtr& frame) override {
+    OnFrame(player->url(), frame);
+  }
+  void OnSwitched(MediaPlayer* player, int64_t latency_us) override {
+    OnSwitched(player->url(), latency_us);
+  }
+  void OnAbrDecision(MediaPlayer* player,
+                     const AbrDecision& decision) override {
+    OnAbrDecision(player->url(), decision);
+  }
+  void OnAudio(MediaPlayer* player, const AudioBuffer& buffer) override {
+    OnAudio(player->url(), buffer);
+  }
+  void OnPlaybackRateChanged(MediaPlayer* player, double rate,
+                             int64_t latency_us) override {
+    OnPlaybackRateChanged(player->url(), rate, latency_us);
+  }
+  void OnCues(MediaPlayer* player, const std::vector<MetadataCue>& cues,
+              bool seek) override {
+    OnCues(player->url(), cues, seek);
+  }
+  void OnPosition(MediaPlayer* player, int64_t position_us,
+                  int64_t buffered_us, int64_t live_latency_us) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    positions.push_back({player->url(), NowUs(), position_us, buffered_us});
+  }
+  void OnDuration(MediaPlayer* player, int64_t duration_us) override {
+    OnDuration(player->url(), duration_us);
+  }
+
+  void OnStateChanged(const std::string& id, PlayerState state) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    states[id] = state;
+    cv_.notify_all();
+  }
+  void OnError(const std::string& id, const std::string& message) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    errors[id] = message;
+  }
+  void OnFrame(const std::string& id, const FramePtr& frame) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frames.emplace_back(id, frame->pts_us);
+  }
+  void OnTileFrame(const std::string& id, int tile,
+                   const FramePtr& frame) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tiles_[id] = tile;
+    ++tile_frames_[id];
+  }
+  void OnSwitched(const std::string& id, int64_t latency_us) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    switches[id] = latency_us;
+    cv_.notify_all();
+  }
+  void OnAbrDecision(const std::string& id,
+                     const AbrDecision& decision) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    decisions.emplace_back(id, decision);
+    cv_.notify_all();
+  }
+  void OnAudio(const std::string& id, const AudioBuffer& buffer) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    audio_frames += buffer.frames();
+    // How far the audio is from the picture on screen.
+    if (!frames.empty()) {
+      max_av_offset_us = std::max<int64_t>(
+          max_av_offset_us, std::llabs(buffer.pts_us - frames.back().second));
+    }
+  }
+  void OnPlaybackRateChanged(const std::string& id, double rate,
+                             int64_t latency_us) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rates.push_back(rate);
+  }
+  void OnCues(const std::string& id, const std::vector<MetadataCue>& cues,
+              bool seek) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (seek) {
+      active_cues.push_back(cues);
+      // Frames shown from here on came after the seek.
+      seek_frame = frames.size();
+    } else {
+      for (const MetadataCue& cue : cues) {
+        reached_cues.emplace_back(!active_cues.empty(), cue);
+      }
+    }
+    cv_.notify_all();
+  }
+  void OnPosition(const std::string& id,
+                  const MediaPlayerStats& stats) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    positions.push_back({id, NowUs(), stats.position_us, stats.buffered_us});
+  }
+  void OnDuration(const std::string& id, int64_t duration_us) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    durations.emplace_back(id, duration_us);
+    positions_before_duration += positions.size();
+  }
+
+  // Waits for a decision for |id| giving |reason|.
+  bool WaitForDecision(const std::string& id, const std::string& reason,
+                       AbrDecision* found) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, std::chrono::seconds(5), [&] {
+      for (const auto& [decided, decision] : decisions) {
+        if (decided == id && decision.reason == reason) {
+          *found = decision;
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
+  std::vector<std::pair<std::string, AbrDecision>> TakeDecisions() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(decisions);
+  }
+
+  bool WaitFor(const std::string& id, PlayerState state) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, std::chrono::seconds(5), [&] {
+      auto it = states.find(id);
+      return it != states.end() && it->second == state;
+    });
+  }
+
+  // The latency of |id|'s switch, or -1 if it did not show a frame in time.
+  int64_t WaitForSwitch(const std::string& id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::seconds(5),
+                 [&] { return switches.count(id) > 0; });
+    return switches.count(id) > 0 ? switches[id] : -1;
+  }
+
+  // The tile each stream was shown in and how many frames it showed.
+  std::map<std::string, std::pair<int, int>> Tiles() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, std::pair<int, int>> shown;
+    for (const auto& [id, tile] : tiles_) {
+      shown[id] = {tile, tile_frames_[id]};
+    }
+    return shown;
+  }
+
+  std::vector<std::pair<std::string, int64_t>> TakeFrames() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(frames);
+  }
+
+  std::map<std::string, PlayerState> states;
+  std::map<std::string, std::string> errors;
+  std::map<std::string, int64_t> switches;
+  std::vector<std::pair<std::string, AbrDecision>> decisions;
+  std::vector<std::pair<std::string, int64_t>> frames;
+  std::vector<double> rates;
+  int64_t audio_frames = 0;
+  int64_t max_av_offset_us = 0;
+  // The cues active after each seek, and the cues playback reached, marked
+  // if that was after a seek.
+  std::vector<std::vector<MetadataCue>> active_cues;
+  std::vector<std::pair<bool, MetadataCue>> reached_cues;
+  size_t seek_frame = 0;
+  // When each position was reported, and the position and buffer in it.
+  struct Position {
+    std::string id;
+    int64_t at_us;
+    int64_t position_us;
+    int64_t buffered_us;
+  };
+  std::vector<Position> positions;
+  std::vector<std::pair<std::string, int64_t>> durations;
+  size_t positions_before_duration = 0;
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // The mosaic tile each stream was last shown in, and its frames there.
+  std::map<std::string, int> tiles_;
+  std::map<std::string, int> tile_frames_;
+};
+
+MediaSourceFactory LiveSources() {
+  return [] { return std::make_unique<FakeSource>(true, 1 << 30); };
+}
+
+// Live sources with audio, at the live edge.
+MediaSourceFactory LiveSourcesWithAudio() {
+  return [] {
+    auto source = std::make_unique<FakeSource>(true, 1 << 30);
+    source->StartBehind(0);
+    return source;
+  };
+}
+
+// Selects a background stream of 30 fps with a keyframe every 2 s, 1.2 s
+// into its GOP, and returns the switch latency.
+int64_t MeasureSwitch(size_t gop_cache_bytes, PlayerInfo* info) {
+  RecordingListener listener;
+  MultiPlayerConfig config;
+  config.keyframe_players = 0;
+  config.gop_cache_bytes = gop_cache_bytes;
+  MultiPlayer players(
+      [] {
+        // About 1 ms of decoding per frame.
+        return std::make_unique<FakeSource>(true, 1 << 30, kLiveFrameUs, 60,
+                                            1000);
+      },
+      config, &listener);
+  players.Add("a");
+  players.Add("b");
+  std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+  players.Select("b");
+  const int64_t latency_us = listener.WaitForSwitch("b");
+  for (const PlayerInfo& player : players.players()) {
+    if (player.id == "b") *info = player;
+  }
+  return latency_us;
+}
+
+std::map<std::string, PlayerInfo> ById(const MultiPlayer& players) {
+  std::map<std::string, PlayerInfo> by_id;
+  for (const PlayerInfo& info : players.players()) by_id[info.id] = info;
+  return by_id;
+}
+
+}  // namespace
+
+TEST(MediaPlayer, DecodesAccordingToMode) {
+  RecordingListener listener;
+  MediaPlayer::Config config;
+  config.paced = false;
+  auto canned = [] { return std::make_unique<FakeSource>(false, 100); };
+  std::map<DecodeMode, MediaPlayerStats> stats;
+  for (DecodeMode mode : {DecodeMode::kFull, DecodeMode::kKeyframes,
+                          DecodeMode::kNetworkOnly}) {
+    config.mode = mode;
+    MediaPlayer player(DecodeModeName(mode), canned, config, &listener);
+    ASSERT_TRUE(listener.WaitFor(DecodeModeName(mode), PlayerState::kEnded));
+    stats[mode] = player.stats();
+  }
+  EXPECT_EQ(stats[DecodeMode::kFull].decoded, 100u);
+  EXPECT_EQ(stats[DecodeMode::kFull].frames, 100u);
+  EXPECT_EQ(stats[DecodeMode::kKeyframes].decoded, 5u);
+  EXPECT_EQ(stats[DecodeMode::kKeyframes].decoded_keyframes, 5u);
+  EXPECT_EQ(stats[DecodeMode::kKeyframes].skipped, 95u);
+  EXPECT_EQ(stats[DecodeMode::kNetworkOnly].decoded, 0u);
+  EXPECT_EQ(stats[DecodeMode::kNetworkOnly].skipped, 100u);
+  // Every mode downloads the whole stream.
+  for (const auto& entry : stats) EXPECT_EQ(entry.second.packets, 100u);
+}
+
+TEST(MediaPlayer, ReportsOpenErrors) {
+  RecordingListener listener;
+  {
+    MediaPlayer player("missing.m3u8", LiveSources(), MediaPlayer::Config(),
+                       &listener);
+    ASSERT_TRUE(listener.WaitFor("missing.m3u8", PlayerState::kIdle));
+  }
+  EXPECT_EQ(listener.errors["missing.m3u8"], "cannot open missing.m3u8");
+}
+
+TEST(MediaPlayer, PacesReadsToTimestamps) {
+  RecordingListener listener;
+  auto canned = [] { return std::make_unique<FakeSource>(false, 40); };
+  const int64_t start_us = NowUs();
+  MediaPlayer player("vod", canned, MediaPlayer::Config(), &listener);
+  ASSERT_TRUE(listener.WaitFor("vod", PlayerState::kEnded));
+  // 40 packets 5 ms apart take 195 ms to play, not a burst.
+  EXPECT_GE(NowUs() - start_us, 39 * kFrameUs);
+}
+
+TEST(MediaPlayer, SkipsToTheNextKeyframeWhenDecodingFallsBehind) {
+  RecordingListener listener;
+  MediaPlayer::Config config;
+  config.max_decode_lag_us = 30000;
+  FramePool frames;
+  config.frame_pool = &frames;
+  // 200 frames 5 ms apart that take 8 ms each to decode.
+  auto slow = [] {
+    return std::make_unique<FakeSource>(false, 200, kFrameUs, kGop, 8000);
+  };
+  const int64_t start_us = NowUs();
+  MediaPlayer player("slow", slow, config, &listener);
+  ASSERT_TRUE(listener.WaitFor("slow", PlayerState::kEnded));
+  const int64_t elapsed_us = NowUs() - start_us;
+  const MediaPlayerStats stats = player.stats();
+  std::printf("decoding at 0.6x real time: %llu of 200 frames shown, %llu "
+              "skips to the next keyframe, %.2f s for 1 s of video\n",
+              static_cast<unsigned long long>(stats.frames),
+              static_cast<unsigned long long>(stats.keyframe_skips),
+              elapsed_us / 1e6);
+
+  EXPECT_GT(stats.keyframe_skips, 0u);
+  EXPECT_EQ(stats.decoded + stats.skipped, 200u);
+  // Every keyframe is decoded, on time or nearly.
+  EXPECT_EQ(stats.decoded_keyframes, 10u);
+  // Rushing through would take 1.6 s.
+  EXPECT_LT(elapsed_us, 1300000);
+  // Decoding resumes at keyframes only.
+  const auto shown = listener.TakeFrames();
+  for (size_t i = 1; i < shown.size(); ++i) {
+    if (shown[i].second != shown[i - 1].second + kFrameUs) {
+      EXPECT_EQ(shown[i].second % (kGop * kFrameUs), 0) << i;
+    }
+  }
+  // All frames came from the pool, most of them more than once.
+  EXPECT_LE(frames.stats().allocated, 2u);
+}
+
+TEST(MediaPlayer, CatchesUpWithTheLiveEdgeWithoutSkipping) {
+  RecordingListener listener;
+  MediaPlayer::Config config;
+  config.catch_up.target_latency_us = 500000;
+  // 20 ms frames, starting 2 s behind the live edge.
+  auto behind = [] {
+    auto source = std::make_unique<FakeSource>(true, 1 << 30, 20000);
+    source->StartBehind(2000000);
+    return source;
+  };
+  const int64_t start_us = NowUs();
+  MediaPlayer player("live", behind, config, &listener);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+  const MediaPlayerStats stats = player.stats();
+  const int64_t elapsed_us = NowUs() - start_us;
+  const auto shown = listener.TakeFrames();
+  ASSERT_GT(shown.size(), 100u);
+  const int64_t played_us = shown.back().second - shown.front().second;
+  std::printf("catching up from 2 s behind: %.2f s played in %.2f s, at "
+              "%.3fx, %.2f s of audio, A/V within %.1f ms\n",
+              played_us / 1e6, elapsed_us / 1e6, stats.playback_rate,
+              listener.audio_frames / static_cast<double>(kSampleRate),
+              listener.max_av_offset_us / 1000.0);
+
+  // Sped up gradually to the most it may.
+  ASSERT_FALSE(listener.rates.empty());
+  EXPECT_GT(listener.rates.front(), 1.0);
+  EXPECT_LT(listener.rates.front(), 1.05);
+  EXPECT_NEAR(stats.playback_rate, 1.1, 0.001);
+  EXPECT_GT(stats.catch_up_us, 0);
+  EXPECT_GT(played_us, elapsed_us * 105 / 100);
+  EXPECT_LT(stats.live_latency_us, 2000000);
+  // Every frame is shown, none jumped over.
+  EXPECT_EQ(stats.skipped, 0u);
+  EXPECT_EQ(stats.keyframe_skips, 0u);
+  for (size_t i = 1; i < shown.size(); ++i) {
+    EXPECT_EQ(shown[i].second, shown[i - 1].second + 20000) << i;
+  }
+  // The stretched audio lasts as long as the playback it accompanies, and
+  // keeps up with the picture.
+  EXPECT_GT(stats.audio_decoded, 100u);
+  EXPECT_NEAR(listener.audio_frames / static_cast<double>(kSampleRate),
+              elapsed_us / 1e6, 0.15);
+  EXPECT_LT(listener.max_av_offset_us, 60000);
+}
+
+TEST(MediaPlayer, KeepsAudioWithThePictureAcrossRateChanges) {
+  RecordingListener listener;
+  MediaPlayer::Config config;
+  // Quick to react, so that one test sees it speed up and slow down.
+  config.catch_up.target_latency_us = 200000;
+  config.catch_up.min_rate = 0.7;
+  config.catch_up.max_rate = 1.4;
+  config.catch_up.gain = 1;
+  config.catch_up.max_rate_change_per_s = 1;
+  config.catch_up.tolerance_us = 100000;
+  // 20 ms frames with audio, starting 1.5 s behind the live edge.
+  auto behind = [] {
+    auto source = std::make_unique<FakeSource>(true, 1 << 30, 20000);
+    source->StartBehind(1500000);
+    return source;
+  };
+  const int64_t start_us = NowUs();
+  MediaPlayer player("live", behind, config, &listener);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  const MediaPlayerStats caught_up = player.stats();
+  // Now well ahead of where it should be.
+  player.SetTargetLatency(1500000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  const MediaPlayerStats stats = player.stats();
+  const int64_t elapsed_us = NowUs() - start_us;
+  const auto shown = listener.TakeFrames();
+  std::printf("sped up to %.2fx then slowed to %.2fx: %.2f s of audio in "
+              "%.2f s, A/V within %.1f ms\n",
+              *std::max_element(listener.rates.begin(), listener.rates.end()),
+              *std::min_element(listener.rates.begin(), listener.rates.end()),
+              listener.audio_frames / static_cast<double>(kSampleRate),
+              elapsed_us / 1e6, listener.max_av_offset_us / 1000.0);
+
+  EXPECT_LT(caught_up.live_latency_us, 1300000);
+  EXPECT_GT(*std::max_element(listener.rates.begin(), listener.rates.end()),
+            1.2);
+  EXPECT_LT(*std::min_element(listener.rates.begin(), listener.rates.end()),
+            0.9);
+  EXPECT_LT(stats.playback_rate, 1.0);
+  EXPECT_EQ(stats.skipped, 0u);
+  ASSERT_GT(shown.size(), 100u);
+  for (size_t i = 1; i < shown.size(); ++i) {
+    EXPECT_EQ(shown[i].second, shown[i - 1].second + 20000) << i;
+  }
+  // Stretched and squeezed, the audio still lasts as long as the playback
+  // and never drifts from the picture.
+  EXPECT_NEAR(listener.audio_frames / static_cast<double>(kSampleRate),
+              elapsed_us / 1e6, 0.15);
+  EXPECT_LT(listener.max_av_offset_us, 60000);
+}
+
+TEST(MediaPlayer, ReportsTheCuesActiveAfterASeek) {
+  RecordingListener listener;
+  // 1 s of 5 ms frames with a keyframe every 100 ms, and a 150 ms cue every
+  // 100 ms.
+  auto cued = [] {
+    auto source = std::make_unique<FakeSource>(false, 200);
+    source->CarryCues(100000, 150000);
+    return source;
+  };
+  MediaPlayer player("vod", cued, MediaPlayer::Config(), &listener);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  // Back into the GOP starting at 100 ms.
+  player.Seek(130000);
+  ASSERT_TRUE(listener.WaitFor("vod", PlayerState::kEnded));
+  EXPECT_EQ(player.stats().seeks, 1u);
+
+  // The cues of 0 ms and 100 ms are both still on at 130 ms.
+  ASSERT_EQ(listener.active_cues.size(), 1u);
+  ASSERT_EQ(listener.active_cues[0].size(), 2u);
+  EXPECT_EQ(listener.active_cues[0][0].text, "cue 0");
+  EXPECT_EQ(listener.active_cues[0][1].text, "cue 100");
+  // Played up to the seek, each cue once, then every cue after 130 ms once
+  // more, though they were indexed already.
+  std::vector<std::string> before;
+  std::vector<std::string> after;
+  for (const auto& [after_seek, cue] : listener.reached_cues) {
+    (after_seek ? after : before).push_back(cue.text);
+  }
+  ASSERT_GE(before.size(), 2u);
+  for (size_t i = 0; i < before.size(); ++i) {
+    EXPECT_EQ(before[i], "cue " + std::to_string(i * 100));
+  }
+  ASSERT_EQ(after.size(), 8u);
+  for (size_t i = 0; i < after.size(); ++i) {
+    EXPECT_EQ(after[i], "cue " + std::to_string(200 + i * 100));
+  }
+  EXPECT_EQ(player.cues().stats().cues, 10u);
+  EXPECT_EQ(player.cues().Overlapping(420000, 560000).size(), 3u);
+
+  // Frames before the target were decoded but not shown.
+  const auto shown = listener.TakeFrames();
+  ASSERT_LT(listener.seek_frame, shown.size());
+  EXPECT_EQ(shown[listener.seek_frame].second, 130000);
+}
+
+TEST(MediaPlayer, ReportsThePositionAtItsIntervalButNotWhilePaused) {
+  RecordingListener listener;
+  MediaPlayer::Config config;
+  config.position_interval_us = 50000;
+  // 1 s of 5 ms frames.
+  auto vod = [] { return std::make_unique<FakeSource>(false, 200); };
+  MediaPlayer player("vod", vod, config, &listener);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  player.Pause();
+  const int64_t paused_us = NowUs();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  const int64_t resumed_us = NowUs();
+  player.Resume();
+  ASSERT_TRUE(listener.WaitFor("vod", PlayerState::kEnded));
+
+  ASSERT_EQ(listener.durations.size(), 1u);
+  EXPECT_EQ(listener.durations[0].second, 1000000);
+  EXPECT_EQ(listener.positions_before_duration, 0u);
+  EXPECT_EQ(player.stats().duration_us, 1000000);
+  EXPECT_EQ(player.stats().position_us, 199 * kFrameUs);
+
+  // Some 20 reports over the 1 s played, in order, none while paused.
+  const auto& positions = listener.positions;
+  ASSERT_GE(positions.size(), 15u);
+  EXPECT_LE(positions.size(), 22u);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    EXPECT_GE(positions[i].buffered_us, 0);
+    EXPECT_FALSE(positions[i].at_us > paused_us + 20000 &&
+                 positions[i].at_us < resumed_us)
+        << i;
+    if (i == 0) continue;
+    EXPECT_GT(positions[i].position_us, positions[i - 1].position_us);
+    // 45 ms apart when sent, give or take when the listener timed them.
+    EXPECT_GE(positions[i].at_us - positions[i - 1].at_us, 44000) << i;
+  }
+
+  // None at all without an interval.
+  RecordingListener quiet;
+  MediaPlayer::Config unset;
+  unset.paced = false;
+  MediaPlayer unreported("vod", vod, unset, &quiet);
+  ASSERT_TRUE(quiet.WaitFor("vod", PlayerState::kEnded));
+  EXPECT_TRUE(quiet.positions.empty());
+  EXPECT_EQ(unreported.stats().position_us, 199 * kFrameUs);
+}
+
+TEST(MultiPlayer, DecodesOnlyTheSelectedStreamInFull) {
+  RecordingListener listener;
+  MultiPlayerConfig config;
+  config.keyframe_players = 1;
+  MultiPlayer players(LiveSources(), config, &listener);
+  for (const char* id : {"a", "b", "c", "d"}) players.Add(id);
+  EXPECT_EQ(players.selected(), "a");
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+  auto info = ById(players);
+  EXPECT_EQ(info["a"].mode, DecodeMode::kFull);
+  EXPECT_GT(info["a"].stats.frames, 0u);
+  for (const char* id : {"b", "c", "d"}) {
+    EXPECT_EQ(info[id].mode, DecodeMode::kNetworkOnly) << id;
+    EXPECT_EQ(info[id].stats.decoded, 0u) << id;
+    // Still downloading.
+    EXPECT_GT(info[id].stats.packets, 20u) << id;
+    EXPECT_EQ(info[id].state, PlayerState::kPlaying) << id;
+  }
+  for (const auto& frame : listener.TakeFrames()) {
+    EXPECT_EQ(frame.first, "a");
+  }
+
+  const MediaPlayerStats a_before = info["a"].stats;
+  ASSERT_TRUE(players.Select("b"));
+  EXPECT_FALSE(players.Select("missing"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  info = ById(players);
+  EXPECT_EQ(info["b"].mode, DecodeMode::kFull);
+  EXPECT_EQ(info["a"].mode, DecodeMode::kKeyframes);
+  EXPECT_EQ(info["c"].mode, DecodeMode::kNetworkOnly);
+  EXPECT_EQ(info["d"].mode, DecodeMode::kNetworkOnly);
+  EXPECT_EQ(info["c"].stats.decoded, 0u);
+  // Allow for the packet that was being handled during the switch.
+  EXPECT_LE(info["a"].stats.decoded - a_before.decoded,
+            info["a"].stats.decoded_keyframes - a_before.decoded_keyframes +
+                1);
+
+  // The promoted stream starts at a keyframe; the demoted one goes quiet.
+  const auto frames = listener.TakeFrames();
+  ASSERT_FALSE(frames.empty());
+  size_t first_b = 0;
+  while (first_b < frames.size() && frames[first_b].first != "b") ++first_b;
+  ASSERT_LT(first_b, frames.size());
+  EXPECT_EQ(frames[first_b].second % (kGop * kFrameUs), 0);
+  for (size_t i = first_b; i < frames.size(); ++i) {
+    EXPECT_EQ(frames[i].first, "b");
+  }
+
+  // Decoding all four would be four streams' worth of work; scheduled it is
+  // about one, plus a keyframe per GOP of the previous selection.
+  const uint64_t background = info["a"].stats.decoded - a_before.decoded +
+                              info["c"].stats.decoded +
+                              info["d"].stats.decoded;
+  EXPECT_LT(background * 4, info["b"].stats.decoded);
+  std::printf("after the switch: selected decoded %llu packets, the three "
+              "others %llu\n",
+              static_cast<unsigned long long>(info["b"].stats.decoded),
+              static_cast<unsigned long long>(background));
+}
+
+TEST(MultiPlayer, ForwardsTheSelectedPlayersPositionAndDuration) {
+  RecordingListener listener;
+  MultiPlayerConfig config;
+  config.player.position_interval_us = 20000;
+  MultiPlayer players(
+      [] { return std::make_unique<FakeSource>(false, 200); }, config,
+      &listener);
+  players.Add("a");
+  players.Add("b");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  players.Select("b");
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_GT(players.position_us(), 0);
+  players.Clear();
+  EXPECT_EQ(players.position_us(), -1);
+
+  // Each once: "a" when it opened, "b" when selected.
+  ASSERT_EQ(listener.durations.size(), 2u);
+  EXPECT_EQ(listener.durations[0].first, "a");
+  EXPECT_EQ(listener.durations[1].first, "b");
+  EXPECT_EQ(listener.durations[1].second, 1000000);
+  // Only the selected player's, though one report of "a" may have been on
+  // its way while selecting.
+  const auto& positions = listener.positions;
+  const auto first_b =
+      std::find_if(positions.begin(), positions.end(),
+                   [](const auto& position) { return position.id == "b"; });
+  ASSERT_NE(first_b, positions.begin());
+  ASSERT_NE(first_b, positions.end());
+  EXPECT_LE(std::count_if(first_b, positions.end(),
+                          [](const auto& position) {
+                            return position.id == "a";
+                          }),
+            1);
+  EXPECT_GT(positions.end() - first_b, 2);
+}
+
+TEST(MultiPlayer, RemovingTheSelectedPlayerPromotesTheLastOne) {
+  RecordingListener listener;
+  MultiPlayer players(LiveSources(), MultiPlayerConfig(), &listener);
+  players.Add("a");
+  players.Add("b");
+  players.Add("c");
+  ASSERT_TRUE(players.Select("c"));
+  ASSERT_TRUE(players.Select("b"));
+  players.Remove("b");
+  EXPECT_EQ(players.selected(), "c");
+  auto info = ById(players);
+  EXPECT_EQ(info.size(), 2u);
+  EXPECT_EQ(info["c"].mode, DecodeMode::kFull);
+  EXPECT_EQ(info["a"].mode, DecodeMode::kKeyframes);
+  players.Clear();
+  EXPECT_TRUE(players.players().empty());
+  EXPECT_EQ(players.selected(), "");
+}
+
+TEST(MultiPlayer, EvictsBackgroundStreamsToStayWithinTheMemoryBudget) {
+  RecordingListener listener;
+  MultiPlayerConfig config;
+  // Under what the four streams' cached GOPs add up to.
+  config.memory.max_bytes = 4000;
+  MultiPlayer players(LiveSources(), config, &listener);
+  for (const char* id : {"a", "b", "c", "d"}) players.Add(id);
+  ASSERT_TRUE(players.Select("b"));
+  ASSERT_TRUE(players.Select("a"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+
+  auto info = ById(players);
+  EXPECT_EQ(info["a"].memory.rank, 0);
+  EXPECT_EQ(info["b"].memory.rank, 1);
+  EXPECT_EQ(info["c"].memory.rank, -1);
+  EXPECT_GT(info["a"].memory.allowance_bytes,
+            info["b"].memory.allowance_bytes);
+  EXPECT_GT(info["b"].memory.allowance_bytes,
+            info["c"].memory.allowance_bytes);
+  // The streams never selected give their GOPs back; the one on screen
+  // keeps its own.
+  EXPECT_GT(info["c"].memory.evictions + info["d"].memory.evictions, 0u);
+  EXPECT_EQ(info["a"].memory.evictions, 0u);
+  EXPECT_GT(info["a"].stats.frames, 0u);
+  const MemoryBudgetStats stats = players.memory_stats();
+  EXPECT_EQ(stats.max_bytes, 4000u);
+  EXPECT_GT(stats.evictions, 0u);
+  EXPECT_EQ(stats.overruns, 0u);
+}
+
+TEST(MultiPlayer, ShowsEveryMosaicStreamButHearsOnlyTheSelectedOne) {
+  RecordingListener listener;
+  MultiPlayer players(LiveSourcesWithAudio(), MultiPlayerConfig(),
+                      &listener);
+  for (const char* id : {"a", "b", "c", "d"}) players.Add(id);
+  players.SetMosaic({{"b", 320, 180}, {"c", 320, 180}, {"d", 320, 180}});
+  ASSERT_TRUE(players.Select("c"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+  auto info = ById(players);
+  auto tiles = listener.Tiles();
+  for (const char* id : {"b", "c", "d"}) {
+    EXPECT_EQ(info[id].mode, DecodeMode::kFull) << id;
+    EXPECT_GT(info[id].stats.frames, 0u) << id;
+    EXPECT_GT(tiles[id].second, 0) << id;
+  }
+  EXPECT_EQ(tiles["b"].first, 0);
+  EXPECT_EQ(tiles["c"].first, 1);
+  EXPECT_EQ(tiles["d"].first, 2);
+  EXPECT_EQ(tiles.count("a"), 0u);
+  // The previous selection keeps decoding keyframes outside the mosaic.
+  EXPECT_EQ(info["a"].mode, DecodeMode::kKeyframes);
+  // Only the selected tile decodes its audio.
+  EXPECT_GT(info["c"].stats.audio_decoded, 0u);
+  EXPECT_EQ(info["b"].stats.audio_decoded, 0u);
+  EXPECT_EQ(info["d"].stats.audio_decoded, 0u);
+
+  players.SetMosaic({});
+  EXPECT_TRUE(players.mosaic().empty());
+  info = ById(players);
+  EXPECT_EQ(info["c"].mode, DecodeMode::kFull);
+  EXPECT_EQ(info["b"].mode, DecodeMode::kNetworkOnly);
+  EXPECT_EQ(info["d"].mode, DecodeMode::kNetworkOnly);
+}
+
+TEST(MultiPlayer, RoutesQualityControlToTheSelectedStream) {
+  RecordingListener listener;
+  MultiPlayer players(LiveSources(), MultiPlayerConfig(), &listener);
+  players.Add("a");
+  players.Add("b");
+  AbrDecision decision;
+  ASSERT_TRUE(listener.WaitForDecision("a", "throughput", &decision));
+  // The initial estimate of 1 Mbps.
+  EXPECT_EQ(decision.rendition.name, "240p");
+  EXPECT_TRUE(decision.automatic);
+
+  const std::vector<AbrRendition> qualities = players.qualities();
+  ASSERT_EQ(qualities.size(), 2u);
+  EXPECT_EQ(qualities[0].name, "240p");
+  EXPECT_EQ(qualities[1].name, "720p");
+  EXPECT_FALSE(players.SetQuality("1080p"));
+  ASSERT_TRUE(players.SetQuality("720p"));
+  EXPECT_FALSE(players.auto_quality());
+  ASSERT_TRUE(listener.WaitForDecision("a", "manual", &decision));
+  EXPECT_EQ(decision.rendition.name, "720p");
+  EXPECT_FALSE(decision.automatic);
+  players.SetAutoQuality(true);
+  EXPECT_TRUE(players.auto_quality());
+
+  // Only the selected stream's decisions are passed on.
+  players.Clear();
+  for (const auto& [id, ignored] : listener.TakeDecisions()) {
+    EXPECT_EQ(id, "a");
+  }
+}
+
+TEST(MultiPlayer, SwitchesFromTheCachedGopWithin100Ms) {
+  PlayerInfo cached;
+  const int64_t cached_us = MeasureSwitch(4 << 20, &cached);
+  PlayerInfo uncached;
+  const int64_t uncached_us = MeasureSwitch(0, &uncached);
+  std::printf("switch latency: %.1f ms from the GOP cache, %.1f ms waiting "
+              "for the next keyframe\n",
+              cached_us / 1000.0, uncached_us / 1000.0);
+
+  ASSERT_GE(cached_us, 0);
+  EXPECT_LT(cached_us, 100000);
+  EXPECT_EQ(cached.stats.switches, 1u);
+  EXPECT_EQ(cached.stats.cached_switches, 1u);
+  // About 36 frames into the GOP, decoded unpaced.
+  EXPECT_GT(cached.stats.catch_up_decoded, 20u);
+  EXPECT_GT(cached.cached_bytes, 0u);
+
+  // The next keyframe is some 0.8 s away.
+  ASSERT_GE(uncached_us, 0);
+  EXPECT_GT(uncached_us, 500000);
+  EXPECT_EQ(uncached.stats.cached_switches, 0u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "frame_pool.h"
+#include "preview_renderer.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+TEST(PreviewRenderer, ConvertsSubmittedFrames) {
+  std::atomic<int> available{0};
+  PreviewRenderer renderer([&available] { ++available; });
+  EXPECT_EQ(renderer.Acquire(), nullptr);
+
+  VideoFrame frame;
+  frame.Allocate(64, 32);
+  std::fill(frame.data.begin(), frame.data.end(), 128);
+  frame.pts_us = 7;
+  renderer.Submit(frame);
+
+  const RgbaFrame* rgba = nullptr;
+  for (int i = 0; i < 1000 && rgba == nullptr; ++i) {
+    rgba = renderer.Acquire();
+    if (rgba == nullptr) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  ASSERT_NE(rgba, nullptr);
+  EXPECT_EQ(rgba->width, 64);
+  EXPECT_EQ(rgba->height, 32);
+  EXPECT_EQ(rgba->capture_us, 7);
+  ASSERT_EQ(rgba->pixels.size(), 64u * 32 * 4);
+  // Mid grey.
+  EXPECT_NEAR(rgba->pixels[0], 130, 2);
+  EXPECT_EQ(rgba->pixels[3], 255);
+  EXPECT_EQ(available.load(), 1);
+}
+
+TEST(PreviewRenderer, ConvertsSharedFramesWithoutCopying) {
+  std::atomic<int> available{0};
+  PreviewRenderer renderer([&available] { ++available; });
+  FramePool pool;
+  {
+    std::shared_ptr<VideoFrame> frame = pool.Acquire();
+    frame->Allocate(64, 32);
+    std::fill(frame->data.begin(), frame->data.end(), 128);
+    frame->pts_us = 9;
+    renderer.Submit(std::move(frame));
+  }
+  for (int i = 0; i < 1000 && available == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const RgbaFrame* rgba = renderer.Acquire();
+  ASSERT_NE(rgba, nullptr);
+  EXPECT_EQ(rgba->capture_us, 9);
+  EXPECT_NEAR(rgba->pixels[0], 130, 2);
+  // Back in the pool once converted.
+  EXPECT_EQ(pool.stats().free, 1u);
+}
+
+// Captures 720p at 30 fps while a 60 Hz "raster thread" acquires frames, and
+// reports the time from capture to the frame being available to the texture.
+TEST(PreviewRenderer, CaptureToTextureLatency) {
+  PreviewRenderer renderer(nullptr);
+  std::atomic<bool> done{false};
+  std::vector<int64_t> latencies;
+  std::thread raster([&] {
+    int64_t last_capture = -1;
+    while (!done) {
+      const RgbaFrame* frame = renderer.Acquire();
+      if (frame != nullptr && frame->capture_us != last_capture) {
+        last_capture = frame->capture_us;
+        latencies.push_back(NowUs() - frame->capture_us);
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(16667));
+    }
+  });
+
+  SyntheticFrameSource source(1280, 720, 30);
+  VideoFrame frame;
+  for (int i = 0; i < 60; ++i) {
+    source.Next(&frame);
+    frame.pts_us = NowUs();
+    renderer.Submit(frame);
+    std::this_thread::sleep_for(std::chrono::microseconds(33333));
+  }
+  done = true;
+  raster.join();
+
+  ASSERT_GT(latencies.size(), 30u);
+  std::sort(latencies.begin(), latencies.end());
+  const int64_t median = latencies[latencies.size() / 2];
+  const int64_t p95 = latencies[latencies.size() * 95 / 100];
+  const PreviewStats stats = renderer.stats();
+  std::printf(
+      "Capture to texture at 720p: median %.2f ms, p95 %.2f ms, "
+      "conversion %.2f ms per frame, %llu of %llu frames shown\n",
+      median / 1000.0, p95 / 1000.0,
+      stats.convert_us / 1000.0 / std::max<uint64_t>(stats.converted, 1),
+      static_cast<unsigned long long>(latencies.size()),
+      static_cast<unsigned long long>(stats.submitted));
+  // Conversion plus at most one 60 Hz refresh interval, with headroom for
+  // loaded CI machines.
+  EXPECT_LT(median, 40000);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
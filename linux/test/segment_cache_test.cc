@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "segment_cache.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+std::string FreshDir(const std::string& name) {
+  const std::string path = ::testing::TempDir() + name;
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+// |size| bytes that differ with |seed|.
+std::vector<uint8_t> Segment(int seed, size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<uint8_t>(i * 7 + seed * 31);
+  }
+  return data;
+}
+
+std::unique_ptr<SegmentCache> OpenCache(const SegmentCacheConfig& config) {
+  std::string error;
+  std::unique_ptr<SegmentCache> cache = SegmentCache::Open(config, &error);
+  EXPECT_NE(cache, nullptr) << error;
+  return cache;
+}
+
+bool Holds(SegmentCache* cache, const std::string& key,
+           const std::vector<uint8_t>& expected) {
+  CachedSegment segment;
+  if (!cache->Get(key, &segment)) return false;
+  return std::vector<uint8_t>(segment.data, segment.data + segment.size) ==
+         expected;
+}
+
+}  // namespace
+
+TEST(SegmentCache, MapsSegmentsBackAcrossRestarts) {
+  SegmentCacheConfig config;
+  config.directory = FreshDir("segment_cache_restart");
+  const std::vector<uint8_t> first = Segment(1, 100000);
+  const std::vector<uint8_t> second = Segment(2, 3000);
+  const std::string ranged = SegmentCacheKey("https://cdn/a.ts", 0, 3000);
+  {
+    std::unique_ptr<SegmentCache> cache = OpenCache(config);
+    ASSERT_NE(cache, nullptr);
+    EXPECT_TRUE(cache->Put("https://cdn/a.ts", first.data(), first.size()));
+    EXPECT_TRUE(cache->Put(ranged, second.data(), second.size()));
+    // A second process would append to the same packs.
+    std::string error;
+    EXPECT_EQ(SegmentCache::Open(config, &error), nullptr);
+    EXPECT_FALSE(error.empty());
+  }
+  std::unique_ptr<SegmentCache> cache = OpenCache(config);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_TRUE(Holds(cache.get(), "https://cdn/a.ts", first));
+  EXPECT_TRUE(Holds(cache.get(), ranged, second));
+  EXPECT_FALSE(cache->Touch("https://cdn/b.ts"));
+  const SegmentCacheStats stats = cache->stats();
+  EXPECT_EQ(stats.entries, 2u);
+  EXPECT_EQ(stats.hits, 2u);
+  EXPECT_EQ(stats.live_bytes, first.size() + second.size());
+}
+
+TEST(SegmentCache, StoresIdenticalBytesOnce) {
+  SegmentCacheConfig config;
+  config.directory = FreshDir("segment_cache_dedup");
+  std::unique_ptr<SegmentCache> cache = OpenCache(config);
+  ASSERT_NE(cache, nullptr);
+  const std::vector<uint8_t> segment = Segment(3, 50000);
+  ASSERT_TRUE(cache->Put("https://a/x.ts", segment.data(), segment.size()));
+  const size_t bytes = cache->stats().bytes;
+  ASSERT_TRUE(cache->Put("https://b/x.ts", segment.data(), segment.size()));
+  SegmentCacheStats stats = cache->stats();
+  EXPECT_EQ(stats.deduplicated, 1u);
+  EXPECT_EQ(stats.bytes, bytes);
+  EXPECT_EQ(stats.entries, 2u);
+
+  // Replacing one key leaves the bytes to the other.
+  const std::vector<uint8_t> other = Segment(4, 50000);
+  ASSERT_TRUE(cache->Put("https://a/x.ts", other.data(), other.size()));
+  EXPECT_TRUE(Holds(cache.get(), "https://b/x.ts", segment));
+  EXPECT_TRUE(Holds(cache.get(), "https://a/x.ts", other));
+  stats = cache->stats();
+  EXPECT_EQ(stats.live_bytes, segment.size() + other.size());
+}
+
+TEST(SegmentCache, DeletesTheLeastRecentlyUsedPackOverTheLimit) {
+  SegmentCacheConfig config;
+  config.directory = FreshDir("segment_cache_lru");
+  // One segment per pack, and room for three.
+  config.pack_bytes = 1;
+  config.max_bytes = 3 * 10100;
+  std::unique_ptr<SegmentCache> cache = OpenCache(config);
+  ASSERT_NE(cache, nullptr);
+  std::vector<std::vector<uint8_t>> segments;
+  for (int i = 0; i < 3; ++i) {
+    segments.push_back(Segment(10 + i, 10000));
+    ASSERT_TRUE(cache->Put("s" + std::to_string(i), segments[i].data(),
+                           10000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  // Held across the eviction of its pack.
+  CachedSegment held;
+  ASSERT_TRUE(cache->Get("s0", &held));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ASSERT_TRUE(cache->Touch("s1"));
+
+  segments.push_back(Segment(13, 10000));
+  ASSERT_TRUE(cache->Put("s3", segments[3].data(), 10000));
+  EXPECT_TRUE(Holds(cache.get(), "s0", segments[0]));
+  EXPECT_FALSE(cache->Touch("s2"));
+  EXPECT_TRUE(Holds(cache.get(), "s3", segments[3]));
+  EXPECT_EQ(std::vector<uint8_t>(held.data, held.data + held.size),
+            segments[0]);
+  const SegmentCacheStats stats = cache->stats();
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.packs, 3);
+  EXPECT_LE(stats.bytes, config.max_bytes);
+}
+
+TEST(SegmentCache, DropsEntriesPastTheirAge) {
+  SegmentCacheConfig config;
+  config.directory = FreshDir("segment_cache_age");
+  config.max_age_us = 100000;
+  const std::vector<uint8_t> segment = Segment(5, 2000);
+  {
+    std::unique_ptr<SegmentCache> cache = OpenCache(config);
+    ASSERT_NE(cache, nullptr);
+    ASSERT_TRUE(cache->Put("old", segment.data(), segment.size()));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  // Ages count while the cache is closed.
+  std::unique_ptr<SegmentCache> cache = OpenCache(config);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_FALSE(cache->Touch("old"));
+  EXPECT_EQ(cache->stats().packs, 0);
+  EXPECT_EQ(cache->stats().bytes, 0u);
+}
+
+TEST(SegmentCache, ForgetsSegmentsCutShortByACrash) {
+  SegmentCacheConfig config;
+  config.directory = FreshDir("segment_cache_torn");
+  const std::vector<uint8_t> whole = Segment(6, 4000);
+  const std::vector<uint8_t> torn = Segment(7, 4000);
+  {
+    std::unique_ptr<SegmentCache> cache = OpenCache(config);
+    ASSERT_NE(cache, nullptr);
+    ASSERT_TRUE(cache->Put("whole", whole.data(), whole.size()));
+    ASSERT_TRUE(cache->Put("torn", torn.data(), torn.size()));
+  }
+  for (const auto& file :
+       std::filesystem::directory_iterator(config.directory)) {
+    if (file.path().extension() == ".dat") {
+      std::filesystem::resize_file(file.path(),
+                                   std::filesystem::file_size(file) - 100);
+    }
+  }
+  std::unique_ptr<SegmentCache> cache = OpenCache(config);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_TRUE(Holds(cache.get(), "whole", whole));
+  EXPECT_FALSE(cache->Touch("torn"));
+  // Appends go to a new pack, past the cut.
+  ASSERT_TRUE(cache->Put("torn", torn.data(), torn.size()));
+  EXPECT_TRUE(Holds(cache.get(), "torn", torn));
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
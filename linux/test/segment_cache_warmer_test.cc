@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ll_hls_loader.h"
+#include "segment_cache.h"
+#include "segment_cache_warmer.h"
+#include "test/throttled_http_server.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+class Waiter {
+ public:
+  SegmentCacheWarmer::Callback callback() {
+    return [this](const CacheWarmResult& result) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      result_ = result;
+      done_ = true;
+      cv_.notify_all();
+    };
+  }
+
+  CacheWarmResult Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    EXPECT_TRUE(
+        cv_.wait_for(lock, std::chrono::seconds(10), [this] { return done_; }));
+    done_ = false;
+    return result_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool done_ = false;
+  CacheWarmResult result_;
+};
+
+// A VOD of fMP4 segments in two variants behind a master playlist.
+void ServeVod(ThrottledHttpServer* server) {
+  server->Set("/master.m3u8",
+              "#EXTM3U\n"
+              "#EXT-X-STREAM-INF:BANDWIDTH=3000000\n"
+              "hi/index.m3u8\n"
+              "#EXT-X-STREAM-INF:BANDWIDTH=400000\n"
+              "lo/index.m3u8\n");
+  for (const std::string variant : {"lo", "hi"}) {
+    std::string playlist =
+        "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXT-X-PLAYLIST-TYPE:VOD\n"
+        "#EXT-X-MAP:URI=\"init.mp4\"\n";
+    server->Set("/" + variant + "/init.mp4", variant + "-init;");
+    for (int i = 0; i < 5; ++i) {
+      const std::string name = std::to_string(i) + ".m4s";
+      playlist += "#EXTINF:2.0,\n" + name + "\n";
+      server->Set("/" + variant + "/" + name,
+                  variant + std::to_string(i) + ";");
+    }
+    server->Set("/" + variant + "/index.m3u8", playlist + "#EXT-X-ENDLIST\n");
+  }
+}
+
+}  // namespace
+
+TEST(SegmentCacheWarmer, WarmsAVodSoPlayingItLoadsOnlyPlaylists) {
+  ThrottledHttpServer server({});
+  ASSERT_TRUE(server.ok());
+  ServeVod(&server);
+  SegmentCacheConfig cache_config;
+  cache_config.directory = ::testing::TempDir() + "segment_cache_warmer";
+  std::filesystem::remove_all(cache_config.directory);
+  std::string error;
+  std::unique_ptr<SegmentCache> cache =
+      SegmentCache::Open(cache_config, &error);
+  ASSERT_NE(cache, nullptr) << error;
+
+  SegmentCacheWarmer warmer(cache.get());
+  Waiter waiter;
+  CacheWarmConfig config;
+  config.max_bandwidth = 1000000;
+  // The first three segments, after the initialisation section.
+  config.duration_us = 5000000;
+  warmer.Warm(server.Url("/master.m3u8"), config, waiter.callback());
+  CacheWarmResult result = waiter.Wait();
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.segments, 4);
+  EXPECT_EQ(result.cached, 0);
+  EXPECT_EQ(result.bytes, 8 + 3 * 4);
+
+  config.duration_us = 0;
+  warmer.Warm(server.Url("/master.m3u8"), config, waiter.callback());
+  result = waiter.Wait();
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.segments, 6);
+  EXPECT_EQ(result.cached, 4);
+
+  const int requests = server.requests();
+  LlHlsConfig loader_config;
+  loader_config.max_bandwidth = 1000000;
+  loader_config.cache = cache.get();
+  LlHlsLoader loader(loader_config);
+  ASSERT_TRUE(loader.Open(server.Url("/master.m3u8"), &error)) << error;
+  std::string stream;
+  char data[64];
+  int64_t read;
+  while ((read = loader.Read(reinterpret_cast<uint8_t*>(data),
+                             sizeof(data))) > 0) {
+    stream.append(data, read);
+  }
+  ASSERT_EQ(read, 0) << loader.error();
+  EXPECT_EQ(stream, "lo-init;lo0;lo1;lo2;lo3;lo4;");
+  EXPECT_EQ(loader.stats().cache_hits, 6u);
+  // The master and media playlists.
+  EXPECT_EQ(server.requests(), requests + 2);
+}
+
+TEST(SegmentCacheWarmer, RefusesLivePlaylists) {
+  ThrottledHttpServer server({});
+  ASSERT_TRUE(server.ok());
+  server.Set("/live.m3u8",
+             "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXTINF:2.0,\n0.ts\n");
+  SegmentCacheConfig cache_config;
+  cache_config.directory = ::testing::TempDir() + "segment_cache_warmer_live";
+  std::filesystem::remove_all(cache_config.directory);
+  std::string error;
+  std::unique_ptr<SegmentCache> cache =
+      SegmentCache::Open(cache_config, &error);
+  ASSERT_NE(cache, nullptr) << error;
+  SegmentCacheWarmer warmer(cache.get());
+  Waiter waiter;
+  warmer.Warm(server.Url("/live.m3u8"), CacheWarmConfig(), waiter.callback());
+  const CacheWarmResult result = waiter.Wait();
+  EXPECT_FALSE(result.ok);
+  EXPECT_NE(result.error.find("live"), std::string::npos);
+  EXPECT_EQ(cache->stats().puts, 0u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
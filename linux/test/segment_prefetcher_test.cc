@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "segment_prefetcher.h"
+#include "test/throttled_http_server.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+std::string Body(size_t size, int seed) {
+  std::string body(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    body[i] = static_cast<char>((i * 131 + seed * 7) >> 3);
+  }
+  return body;
+}
+
+// Runs |limiter| against a network where every request waits |rtt_us| for
+// its first byte and then gets an equal share of |link| bytes per second,
+// at most |per_connection|. Returns the throughput over the last half.
+double Simulate(PrefetchConcurrency* limiter, int64_t rtt_us,
+                double per_connection, double link, int64_t request_bytes,
+                int64_t duration_us) {
+  struct Request {
+    int64_t start_us;
+    int64_t first_byte_us = -1;
+    double remaining;
+  };
+  std::vector<Request> active;
+  constexpr int64_t kStepUs = 1000;
+  double late_bytes = 0;
+  for (int64_t now = 0; now < duration_us; now += kStepUs) {
+    while (static_cast<int>(active.size()) < limiter->limit()) {
+      active.push_back({now, -1, static_cast<double>(request_bytes)});
+    }
+    int receiving = 0;
+    for (const Request& request : active) {
+      if (now - request.start_us >= rtt_us) ++receiving;
+    }
+    const double share =
+        receiving == 0 ? 0 : std::min(per_connection, link / receiving);
+    for (auto it = active.begin(); it != active.end();) {
+      if (now - it->start_us < rtt_us) {
+        ++it;
+        continue;
+      }
+      if (it->first_byte_us < 0) it->first_byte_us = now - it->start_us;
+      const double bytes = std::min(it->remaining, share * kStepUs / 1e6);
+      it->remaining -= bytes;
+      if (now >= duration_us / 2) late_bytes += bytes;
+      if (it->remaining <= 0) {
+        limiter->OnRequestDone(request_bytes, it->first_byte_us,
+                               now + kStepUs - it->start_us, now + kStepUs);
+        it = active.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return late_bytes * 1e6 / (duration_us / 2);
+}
+
+// Plays |count| segments of |segment_us| each: takes the next one when the
+// previous has played out.
+PrefetchStats Play(const PrefetchConfig& config,
+                   const ThrottledHttpServer& server, int count,
+                   int64_t segment_us) {
+  SegmentPrefetcher prefetcher(config);
+  for (int i = 0; i < count; ++i) {
+    prefetcher.Enqueue({i, server.Url("/" + std::to_string(i) + ".ts")});
+  }
+  for (int i = 0; i < count; ++i) {
+    PrefetchedSegment segment;
+    while (!prefetcher.Take(100000, &segment)) {
+    }
+    EXPECT_TRUE(segment.ok);
+    EXPECT_EQ(segment.sequence, i);
+    std::this_thread::sleep_for(std::chrono::microseconds(segment_us));
+  }
+  return prefetcher.stats();
+}
+
+}  // namespace
+
+TEST(PrefetchConcurrency, RaisesLimitUntilTheLinkSaturates) {
+  // 100 ms to first byte, 1 MB/s per connection, 4 MB/s link: one
+  // connection gets a fifth of the link. Past four, the requests mostly
+  // split the link between them and each extra one adds only a few percent.
+  PrefetchConcurrency limiter(1, 8);
+  const double rate =
+      Simulate(&limiter, 100000, 1e6, 4e6, 500000, 60000000);
+  EXPECT_GE(limiter.limit(), 4);
+  EXPECT_LE(limiter.limit(), 6);
+  EXPECT_GT(rate, 0.8 * 4e6);
+  EXPECT_NEAR(limiter.rtt_us(), 100000, 2000);
+}
+
+TEST(PrefetchConcurrency, StaysLowWhenOneConnectionFillsTheLink) {
+  PrefetchConcurrency limiter(1, 8);
+  const double rate = Simulate(&limiter, 5000, 4e6, 4e6, 2000000, 60000000);
+  EXPECT_LE(limiter.limit(), 3);
+  EXPECT_GT(rate, 0.9 * 4e6);
+}
+
+TEST(SegmentPrefetcher, FetchesSegmentsInOrderInParallelRanges) {
+  ThrottledHttpServer server({5000, 0, 0});
+  ASSERT_TRUE(server.ok());
+  const std::vector<size_t> sizes = {1300000, 10, 200000, 0, 700000};
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    server.Set("/" + std::to_string(i) + ".ts", Body(sizes[i], i));
+  }
+  const std::string packed = Body(100000, 9);
+  server.Set("/packed.mp4", packed);
+
+  PrefetchConfig config;
+  config.range_bytes = 256 << 10;
+  SegmentPrefetcher prefetcher(config);
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    prefetcher.Enqueue({static_cast<int64_t>(i),
+                        server.Url("/" + std::to_string(i) + ".ts")});
+  }
+  prefetcher.Enqueue({5, server.Url("/packed.mp4"), 1000, 5000});
+
+  for (size_t i = 0; i <= sizes.size(); ++i) {
+    PrefetchedSegment segment;
+    ASSERT_TRUE(prefetcher.Take(5000000, &segment));
+    ASSERT_TRUE(segment.ok) << segment.error;
+    EXPECT_EQ(segment.sequence, static_cast<int64_t>(i));
+    const std::string expected = i < sizes.size()
+                                     ? Body(sizes[i], i)
+                                     : packed.substr(1000, 5000);
+    EXPECT_EQ(std::string(segment.data.begin(), segment.data.end()), expected)
+        << "segment " << i;
+  }
+  PrefetchedSegment none;
+  EXPECT_FALSE(prefetcher.Take(0, &none));
+
+  const PrefetchStats stats = prefetcher.stats();
+  EXPECT_EQ(stats.segments, sizes.size() + 1);
+  // The 1.3 MB segment alone takes six ranges.
+  EXPECT_GE(server.range_requests(), 10);
+  EXPECT_GT(stats.max_in_flight, 1);
+  EXPECT_EQ(stats.failed_requests, 0u);
+}
+
+TEST(SegmentPrefetcher, RetriesAndReportsFailures) {
+  ThrottledHttpServer server({0, 0, 0});
+  ASSERT_TRUE(server.ok());
+  server.Set("/0.ts", Body(50000, 0));
+  server.Set("/1.ts", Body(50000, 1));
+  server.Fail("/0.ts", 503, 1);
+  server.Fail("/1.ts", 503, 10);
+
+  PrefetchConfig config;
+  SegmentPrefetcher prefetcher(config);
+  prefetcher.Enqueue({0, server.Url("/0.ts")});
+  prefetcher.Enqueue({1, server.Url("/1.ts")});
+  prefetcher.Enqueue({2, server.Url("/missing.ts")});
+
+  PrefetchedSegment segment;
+  ASSERT_TRUE(prefetcher.Take(5000000, &segment));
+  EXPECT_TRUE(segment.ok);
+  EXPECT_EQ(segment.data.size(), 50000u);
+  ASSERT_TRUE(prefetcher.Take(5000000, &segment));
+  EXPECT_FALSE(segment.ok);
+  EXPECT_FALSE(segment.error.empty());
+  ASSERT_TRUE(prefetcher.Take(5000000, &segment));
+  EXPECT_FALSE(segment.ok);
+  EXPECT_EQ(prefetcher.stats().failed_requests, 1u + 3u + 3u);
+}
+
+TEST(SegmentPrefetcher, KeepsBufferedBytesWithinBudget) {
+  ThrottledHttpServer server({0, 0, 0});
+  ASSERT_TRUE(server.ok());
+  constexpr size_t kSize = 200 << 10;
+  for (int i = 0; i < 20; ++i) {
+    server.Set("/" + std::to_string(i) + ".ts", Body(kSize, i));
+  }
+  PrefetchConfig config;
+  config.memory_budget_bytes = 1 << 20;
+  config.range_bytes = 64 << 10;
+  SegmentPrefetcher prefetcher(config);
+  for (int i = 0; i < 20; ++i) {
+    prefetcher.Enqueue({i, server.Url("/" + std::to_string(i) + ".ts")});
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  // Nothing was taken, so fetching stopped at the budget.
+  PrefetchStats stats = prefetcher.stats();
+  EXPECT_LE(stats.buffered_bytes, config.memory_budget_bytes);
+  EXPECT_GE(stats.buffered_bytes, config.memory_budget_bytes - kSize);
+  EXPECT_LT(stats.segments, 20u);
+
+  for (int i = 0; i < 20; ++i) {
+    PrefetchedSegment segment;
+    ASSERT_TRUE(prefetcher.Take(5000000, &segment));
+    EXPECT_EQ(segment.data.size(), kSize);
+  }
+  stats = prefetcher.stats();
+  // Sizes are estimated until the first range of a segment answers, so the
+  // budget can be overshot by at most the estimation error of the segments
+  // started in that window.
+  EXPECT_LE(stats.max_buffered_bytes, config.memory_budget_bytes + kSize);
+  EXPECT_EQ(stats.buffered_bytes, 0u);
+}
+
+// One connection gets 1 MB/s after a 50 ms round trip, the link 6 MB/s.
+// Segments are 200 KB for 150 ms of playback, so one request at a time
+// cannot keep up.
+TEST(SegmentPrefetcher, BenchmarkStartupAndRebuffering) {
+  ThrottledHttpServer server({50000, 1000000, 6000000});
+  ASSERT_TRUE(server.ok());
+  constexpr int kSegments = 10;
+  constexpr int64_t kSegmentUs = 150000;
+  for (int i = 0; i < kSegments; ++i) {
+    server.Set("/" + std::to_string(i) + ".ts", Body(200 << 10, i));
+  }
+
+  PrefetchConfig sequential;
+  sequential.min_concurrency = 1;
+  sequential.max_concurrency = 1;
+  sequential.range_bytes = 0;
+  const PrefetchStats one = Play(sequential, server, kSegments, kSegmentUs);
+
+  PrefetchConfig adaptive;
+  adaptive.range_bytes = 64 << 10;
+  const PrefetchStats many = Play(adaptive, server, kSegments, kSegmentUs);
+
+  std::printf(
+      "one at a time: startup %.0f ms, rebuffer %.1f%% (%llu stalls)\n"
+      "adaptive (%d in flight, rtt %.0f ms, %.1f MB/s): startup %.0f ms, "
+      "rebuffer %.1f%% (%llu stalls)\n",
+      one.startup_us / 1000.0, 100 * one.rebuffer_ratio(),
+      static_cast<unsigned long long>(one.stalls), many.concurrency,
+      many.rtt_us / 1000.0, many.throughput / 1e6, many.startup_us / 1000.0,
+      100 * many.rebuffer_ratio(),
+      static_cast<unsigned long long>(many.stalls));
+  EXPECT_LT(many.startup_us, one.startup_us);
+  EXPECT_LT(many.rebuffer_ratio(), one.rebuffer_ratio() / 2);
+  EXPECT_GT(one.rebuffer_ratio(), 0.2);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "shared_frame_ring.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr std::chrono::milliseconds kTimeout(2000);
+
+// 32-bit FNV-1a over a sample of the frame, enough to catch torn or stale
+// slots without dominating the benchmark.
+uint32_t Fingerprint(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i += 4093) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+size_t FrameSize(const SharedFrame& frame) {
+  return static_cast<size_t>(frame.y_stride()) * frame.height +
+         2 * static_cast<size_t>(frame.uv_stride()) * frame.uv_height();
+}
+
+}  // namespace
+
+TEST(SharedFrameRing, HandsOffSlotsInOrderAndBlocksWhenFull) {
+  auto ring = SharedFrameRing::Create(64, 48, 2);
+  ASSERT_NE(ring, nullptr);
+
+  SharedFrame frame;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(ring->BeginWrite(&frame, kTimeout));
+    std::memset(frame.data, i + 1, FrameSize(frame));
+    ring->EndWrite(i * 1000);
+  }
+  EXPECT_FALSE(ring->BeginWrite(&frame, std::chrono::milliseconds(10)));
+
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(ring->BeginRead(&frame, kTimeout));
+    EXPECT_EQ(frame.pts_us, i * 1000);
+    EXPECT_EQ(frame.v()[0], i + 1);
+    ring->EndRead();
+  }
+  EXPECT_FALSE(ring->BeginRead(&frame, std::chrono::milliseconds(10)));
+
+  ring->Close();
+  EXPECT_FALSE(ring->BeginWrite(&frame, kTimeout));
+  EXPECT_FALSE(ring->BeginRead(&frame, kTimeout));
+}
+
+TEST(SharedFrameRing, RejectsUnsealedDescriptors) {
+  int fd = memfd_create("unsealed", MFD_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 1 << 20), 0);
+  EXPECT_EQ(SharedFrameRing::Attach(fd), nullptr);
+}
+
+// A peer controls the header; sizes that would wrap around when multiplied
+// must not let the slots reach past the mapping.
+TEST(SharedFrameRing, RejectsHeadersThatOverflow) {
+  struct Field {
+    size_t offset;
+    uint64_t value;
+    size_t size;
+  };
+  // Offsets of width, height, slot_count and slot_size in the header.
+  const Field fields[] = {
+      {8, 0xffffffffu, 4},
+      {12, 0x80000000u, 4},
+      {16, 0xffffffffu, 4},
+      {24, (uint64_t{1} << 63) + 4096, 8},
+  };
+  for (const Field& field : fields) {
+    auto ring = SharedFrameRing::Create(64, 48, 2);
+    ASSERT_NE(ring, nullptr);
+    void* mapping =
+        mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd(), 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    std::memcpy(static_cast<uint8_t*>(mapping) + field.offset, &field.value,
+                field.size);
+    munmap(mapping, 4096);
+    EXPECT_EQ(SharedFrameRing::Attach(dup(ring->fd())), nullptr)
+        << "field at " << field.offset;
+  }
+
+  auto ring = SharedFrameRing::Create(64, 48, 2);
+  ASSERT_NE(ring, nullptr);
+  auto attached = SharedFrameRing::Attach(dup(ring->fd()));
+  ASSERT_NE(attached, nullptr);
+  EXPECT_EQ(attached->slot_count(), 2);
+}
+
+// A child process generates synthetic frames into the ring it received over
+// a socket; the parent checks every frame arrives intact and in order.
+TEST(SharedFrameRing, TransfersFramesBetweenProcesses) {
+  constexpr int kWidth = 640;
+  constexpr int kHeight = 360;
+  constexpr int kFrames = 90;
+
+  int sockets[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets), 0);
+  const pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    close(sockets[0]);
+    auto ring = SharedFrameRing::Attach(ReceiveRingFd(sockets[1]));
+    if (!ring) _exit(1);
+    SyntheticFrameSource source(kWidth, kHeight, 30);
+    for (int i = 0; i < kFrames; ++i) {
+      SharedFrame frame;
+      if (!ring->BeginWrite(&frame, kTimeout)) _exit(2);
+      const int64_t pts = source.Fill(frame.y(), frame.u(), frame.v());
+      const uint32_t print = Fingerprint(frame.data, FrameSize(frame));
+      ring->EndWrite(pts);
+      if (write(sockets[1], &print, sizeof(print)) != sizeof(print)) _exit(3);
+    }
+    ring->Close();
+    _exit(0);
+  }
+  close(sockets[1]);
+
+  auto ring = SharedFrameRing::Create(kWidth, kHeight, 3);
+  ASSERT_NE(ring, nullptr);
+  ASSERT_TRUE(SendRingFd(sockets[0], ring->fd()));
+
+  int received = 0;
+  SharedFrame frame;
+  while (ring->BeginRead(&frame, kTimeout)) {
+    uint32_t expected = 0;
+    ASSERT_EQ(read(sockets[0], &expected, sizeof(expected)),
+              static_cast<ssize_t>(sizeof(expected)));
+    EXPECT_EQ(Fingerprint(frame.data, FrameSize(frame)), expected);
+    EXPECT_EQ(frame.pts_us, received * 1000000LL / 30);
+    ring->EndRead();
+    ++received;
+  }
+  close(sockets[0]);
+
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  EXPECT_EQ(received, kFrames);
+}
+
+// 4K I420 frames through a three slot ring, with the producer in another
+// process touching every byte it hands over.
+TEST(SharedFrameRing, Benchmark4K) {
+  constexpr int kWidth = 3840;
+  constexpr int kHeight = 2160;
+  constexpr int kFrames = 240;
+
+  auto ring = SharedFrameRing::Create(kWidth, kHeight, 3);
+  ASSERT_NE(ring, nullptr);
+  const auto start = std::chrono::steady_clock::now();
+  const pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    for (int i = 0; i < kFrames; ++i) {
+      SharedFrame frame;
+      if (!ring->BeginWrite(&frame, kTimeout)) _exit(1);
+      std::memset(frame.data, i & 0xff, FrameSize(frame));
+      ring->EndWrite(i);
+    }
+    ring->Close();
+    _exit(0);
+  }
+
+  int received = 0;
+  SharedFrame frame;
+  while (ring->BeginRead(&frame, kTimeout)) {
+    EXPECT_EQ(frame.v()[frame.uv_stride() * frame.uv_height() - 1],
+              received & 0xff);
+    ring->EndRead();
+    ++received;
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  ASSERT_EQ(received, kFrames);
+
+  const double fps = kFrames / elapsed.count();
+  std::printf("4K I420 through shared memory: %.0f fps (%.2f GB/s)\n", fps,
+              fps * kWidth * kHeight * 1.5 / 1e9);
+  EXPECT_GT(fps, 30);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
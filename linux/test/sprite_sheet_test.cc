@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sprite_sheet.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int kWidth = 64;
+constexpr int kHeight = 36;
+
+// A VOD stream of |duration_us| with a keyframe every |gop_us|. Keyframe k
+// is a flat picture of luma 20 + 10k, so a sheet shows which one landed in
+// each cell. Encoding stores the raw planes.
+class FlatCodec : public ThumbnailCodec {
+ public:
+  FlatCodec(int64_t duration_us, int64_t gop_us, std::atomic<int>* decodes)
+      : duration_us_(duration_us), gop_us_(gop_us), decodes_(decodes) {}
+
+  bool DecodeKeyframe(const std::string& url, int64_t time_us,
+                      VideoFrame* frame, std::string* error) override {
+    ++*decodes_;
+    const int64_t keyframe = time_us / gop_us_;
+    frame->Allocate(kWidth, kHeight);
+    const size_t luma = static_cast<size_t>(kWidth) * kHeight;
+    std::fill(frame->data.begin(), frame->data.begin() + luma,
+              static_cast<uint8_t>(20 + 10 * keyframe));
+    std::fill(frame->data.begin() + luma, frame->data.end(), 128);
+    frame->pts_us = keyframe * gop_us_;
+    return true;
+  }
+
+  bool Duration(const std::string& url, int64_t* duration_us,
+                std::string* error) override {
+    if (duration_us_ <= 0) {
+      *error = "not a VOD stream";
+      return false;
+    }
+    *duration_us = duration_us_;
+    return true;
+  }
+
+  bool Encode(const VideoFrame& frame, int quality, ThumbnailFormat* format,
+              std::vector<uint8_t>* out, std::string* error) override {
+    *format = ThumbnailFormat::kJpeg;
+    *out = frame.data;
+    return true;
+  }
+
+ private:
+  const int64_t duration_us_;
+  const int64_t gop_us_;
+  std::atomic<int>* decodes_;
+};
+
+class Waiter {
+ public:
+  SpriteSheetGenerator::Callback callback() {
+    return [this](const SpriteResult& result) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      results_.push_back(result);
+      done_.notify_all();
+    };
+  }
+
+  std::vector<SpriteResult> Wait(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait_for(lock, std::chrono::seconds(10),
+                   [&] { return results_.size() >= count; });
+    return results_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::vector<SpriteResult> results_;
+};
+
+std::string FreshDir(const std::string& name) {
+  const std::string path = ::testing::TempDir() + name;
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+// The luma at the centre of |cell| in a raw sheet on disk.
+int LumaAt(const std::string& path, int sheet_width, const SpriteCell& cell) {
+  std::ifstream in(path, std::ios::binary);
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+  const size_t offset = static_cast<size_t>(cell.y + cell.height / 2) *
+                            sheet_width +
+                        cell.x + cell.width / 2;
+  return offset < data.size() ? data[offset] : -1;
+}
+
+}  // namespace
+
+TEST(SpriteIndex, FindsTheCellOfTheKeyframeBeforeATime) {
+  SpriteIndex index(160, 90, 2, 2, ThumbnailFormat::kWebp,
+                    {0, 4000000, 10000000, 14000000, 20000000});
+  EXPECT_EQ(index.sheets(), 2);
+
+  SpriteCell cell;
+  ASSERT_TRUE(index.Find(-1, &cell));
+  EXPECT_EQ(cell.pts_us, 0);
+  ASSERT_TRUE(index.Find(13999999, &cell));
+  EXPECT_EQ(cell.pts_us, 10000000);
+  EXPECT_EQ(cell.sheet, 0);
+  EXPECT_EQ(cell.x, 0);
+  EXPECT_EQ(cell.y, 90);
+  ASSERT_TRUE(index.Find(99000000, &cell));
+  EXPECT_EQ(cell.sheet, 1);
+  EXPECT_EQ(cell.x, 0);
+  EXPECT_EQ(cell.y, 0);
+  EXPECT_EQ(cell.width, 160);
+
+  // Four bytes a cell after the header.
+  const std::vector<uint8_t> data = index.Serialize();
+  EXPECT_EQ(data.size(), 18u + 5 * 4);
+  SpriteIndex loaded;
+  ASSERT_TRUE(SpriteIndex::Parse(data.data(), data.size(), &loaded));
+  EXPECT_EQ(loaded.times_us(), index.times_us());
+  EXPECT_EQ(loaded.format(), ThumbnailFormat::kWebp);
+  EXPECT_EQ(loaded.columns(), 2);
+  EXPECT_FALSE(SpriteIndex::Parse(data.data(), data.size() - 1, &loaded));
+  EXPECT_FALSE(SpriteIndex().Find(0, &cell));
+}
+
+TEST(SpriteSheetGenerator, TilesKeyframesAndReusesTheDiskCache) {
+  const std::string dir = FreshDir("sprites_cache");
+  std::atomic<int> decodes{0};
+  SpriteConfig config;
+  config.interval_us = 5000000;
+  config.cell_width = 32;
+  config.cell_height = 18;
+  config.columns = 2;
+  config.rows = 2;
+  const std::string url = "https://example.com/vod.m3u8";
+  SpriteResult first;
+  {
+    SpriteSheetGenerator generator(
+        [&] {
+          return std::make_unique<FlatCodec>(30000000, 2000000, &decodes);
+        },
+        dir);
+    Waiter waiter;
+    generator.Generate(url, config, waiter.callback());
+    std::vector<SpriteResult> results = waiter.Wait(1);
+    ASSERT_EQ(results.size(), 1u);
+    first = results[0];
+  }
+  ASSERT_TRUE(first.ok) << first.error;
+  EXPECT_FALSE(first.from_cache);
+  EXPECT_EQ(decodes, 6);
+  // Keyframes at 0, 4, 10, 14, 20 and 24 s over two sheets.
+  const SpriteIndex& index = *first.index;
+  ASSERT_EQ(index.cells(), 6u);
+  EXPECT_EQ(index.sheets(), 2);
+  SpriteCell cell;
+  ASSERT_TRUE(index.Find(15000000, &cell));
+  EXPECT_EQ(cell.pts_us, 14000000);
+  EXPECT_EQ(LumaAt(first.SheetPath(cell.sheet), 64, cell), 20 + 10 * 7);
+  ASSERT_TRUE(index.Find(29000000, &cell));
+  EXPECT_EQ(cell.sheet, 1);
+  EXPECT_EQ(LumaAt(first.SheetPath(cell.sheet), 64, cell), 20 + 10 * 12);
+
+  // A new generator finds the sheets on disk without decoding anything.
+  SpriteSheetGenerator generator(
+      [&] { return std::make_unique<FlatCodec>(30000000, 2000000, &decodes); },
+      dir);
+  Waiter waiter;
+  generator.Generate(url, config, waiter.callback());
+  std::vector<SpriteResult> results = waiter.Wait(1);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_TRUE(results[0].ok);
+  EXPECT_TRUE(results[0].from_cache);
+  EXPECT_EQ(results[0].directory, first.directory);
+  EXPECT_EQ(results[0].index->times_us(), index.times_us());
+  EXPECT_EQ(decodes, 6);
+}
+
+TEST(SpriteSheetGenerator, GivesEachKeyframeOneCellWhenTheGopIsLong) {
+  const std::string dir = FreshDir("sprites_long_gop");
+  std::atomic<int> decodes{0};
+  SpriteSheetGenerator generator(
+      [&] { return std::make_unique<FlatCodec>(12000000, 4000000, &decodes); },
+      dir);
+  SpriteConfig config;
+  config.interval_us = 1000000;
+  Waiter waiter;
+  // Identical requests share the job.
+  generator.Generate("vod", config, waiter.callback());
+  generator.Generate("vod", config, waiter.callback());
+  std::vector<SpriteResult> results = waiter.Wait(2);
+  ASSERT_EQ(results.size(), 2u);
+  ASSERT_TRUE(results[0].ok) << results[0].error;
+  EXPECT_EQ(results[0].index, results[1].index);
+  EXPECT_EQ(results[0].index->times_us(),
+            (std::vector<int64_t>{0, 4000000, 8000000}));
+  EXPECT_EQ(generator.decodes(), 12u);
+}
+
+TEST(SpriteSheetGenerator, RefusesLiveStreams) {
+  const std::string dir = FreshDir("sprites_live");
+  std::atomic<int> decodes{0};
+  SpriteSheetGenerator generator(
+      [&] { return std::make_unique<FlatCodec>(0, 2000000, &decodes); }, dir);
+  Waiter waiter;
+  generator.Generate("live", SpriteConfig(), waiter.callback());
+  std::vector<SpriteResult> results = waiter.Wait(1);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_FALSE(results[0].ok);
+  EXPECT_FALSE(results[0].error.empty());
+  EXPECT_EQ(decodes, 0);
+  SpriteResult loaded;
+  EXPECT_FALSE(LoadSprites(results[0].directory, &loaded));
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include "static_frame_detector.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+VideoFrame MakeFrame(int64_t pts_us) {
+  VideoFrame frame;
+  SyntheticFrameSource(1280, 720, 30).Next(&frame);
+  frame.pts_us = pts_us;
+  return frame;
+}
+
+}  // namespace
+
+TEST(StaticFrameDetector, Sad16MatchesScalar) {
+  uint8_t a[16];
+  uint8_t b[16];
+  uint32_t expected = 0;
+  for (int i = 0; i < 16; ++i) {
+    a[i] = static_cast<uint8_t>(i * 17);
+    b[i] = static_cast<uint8_t>(255 - i * 13);
+    expected += std::abs(a[i] - b[i]);
+  }
+  EXPECT_EQ(Sad16(a, b), expected);
+}
+
+TEST(StaticFrameDetector, SkipsIdenticalFramesUntilRefreshIsDue) {
+  StaticFrameDetector detector;
+  VideoFrame frame = MakeFrame(0);
+  EXPECT_FALSE(detector.ShouldSkip(frame));
+  for (int i = 1; i < 30; ++i) {
+    frame.pts_us = i * 33333;
+    EXPECT_TRUE(detector.ShouldSkip(frame)) << i;
+  }
+  // One second after the last encoded frame the minimum refresh kicks in.
+  frame.pts_us = 1000000;
+  EXPECT_FALSE(detector.ShouldSkip(frame));
+  EXPECT_EQ(detector.stats().frames_skipped, 29u);
+}
+
+TEST(StaticFrameDetector, ToleratesNoiseButDetectsChanges) {
+  StaticFrameDetector detector;
+  VideoFrame frame = MakeFrame(0);
+  EXPECT_FALSE(detector.ShouldSkip(frame));
+
+  VideoFrame noisy = frame;
+  noisy.pts_us = 33333;
+  for (size_t i = 0; i < noisy.data.size(); i += 7) {
+    noisy.data[i] = static_cast<uint8_t>(noisy.data[i] ^ 1);
+  }
+  EXPECT_TRUE(detector.ShouldSkip(noisy));
+
+  // A small change in the bottom right corner of the picture.
+  VideoFrame changed = frame;
+  changed.pts_us = 66666;
+  for (int row = 700; row < 716; ++row) {
+    for (int col = 1260; col < 1276; ++col) {
+      changed.y()[row * changed.y_stride() + col] ^= 0x80;
+    }
+  }
+  EXPECT_FALSE(detector.ShouldSkip(changed));
+
+  // A chroma-only change.
+  VideoFrame tinted = changed;
+  tinted.pts_us = 99999;
+  for (int i = 0; i < 64; ++i) tinted.v()[i] ^= 0x40;
+  EXPECT_FALSE(detector.ShouldSkip(tinted));
+}
+
+TEST(StaticFrameDetector, Benchmark1080p) {
+  VideoFrame frame;
+  SyntheticFrameSource(1920, 1080, 30).Next(&frame);
+  VideoFrame same = frame;
+  constexpr int kIterations = 200;
+  const auto start = std::chrono::steady_clock::now();
+  int matches = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    matches += PlanesMatch(frame.y(), same.y(), frame.y_stride(), frame.width,
+                           frame.height, 16, 256);
+  }
+  const std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(matches, kIterations);
+  std::printf("Full 1080p luma compare: %.1f us\n",
+              elapsed.count() / kIterations);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,171 @@
+// Compares what the plugin pays per broadcaster stats event for the binary
+// TelemetryRecord against the map of named values it used to send, along
+// the whole path: building the FlValue, posting it through the EventHub,
+// draining it on the platform side and encoding it the way the event
+// channel does before handing it to the engine.
+//
+// This is a binary of its own because it replaces malloc to count every
+// allocation, GLib's included, which would skew the unit test runner.
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+
+#include "event_hub.h"
+#include "telemetry_record.h"
+
+namespace {
+
+// Counts heap allocations made while a benchmark is measuring.
+std::atomic<bool> counting{false};
+std::atomic<uint64_t> allocations{0};
+
+void CountAllocation() {
+  if (counting.load(std::memory_order_relaxed)) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+// glibc lets a program interpose the allocator by defining these four; the
+// aligned variants it still serves itself are freed through free() too.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) {
+  CountAllocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  CountAllocation();
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+  CountAllocation();
+  return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) { __libc_free(pointer); }
+}
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+struct FlValueUnref {
+  void operator()(FlValue* value) const { fl_value_unref(value); }
+};
+
+// As queued by the plugin.
+struct QueuedEvent {
+  std::unique_ptr<FlValue, FlValueUnref> value;
+};
+
+using Hub = EventHub<QueuedEvent>;
+
+TelemetryRecord SampleRecord(uint64_t i) {
+  TelemetryRecord record;
+  record.changed = kTelemetryFrameRate;
+  record.timestamp_us = 1700000000000000 + static_cast<int64_t>(i);
+  record.target_fps = 24;
+  record.frames_dropped = 1234 + i;
+  record.max_queue_depth = 3;
+  record.capture_latency_us = 4100;
+  record.encode_latency_us = 28500;
+  record.mux_latency_us = 350;
+  return record;
+}
+
+// The frameRate event as the plugin sent it before the binary record.
+FlValue* NamedMap(const TelemetryRecord& record) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "frameRate",
+                           fl_value_new_int(record.target_fps));
+  fl_value_set_string_take(
+      event, "droppedFrames",
+      fl_value_new_int(static_cast<int64_t>(record.frames_dropped)));
+  fl_value_set_string_take(event, "queueDepth",
+                           fl_value_new_int(record.max_queue_depth));
+  fl_value_set_string_take(
+      event, "encodeLatencyMs",
+      fl_value_new_float(record.encode_latency_us / 1000.0));
+  return event;
+}
+
+// What SessionListener::PostTelemetry() sends.
+FlValue* BinaryRecord(const TelemetryRecord& record) {
+  uint8_t bytes[kTelemetryRecordSize];
+  EncodeTelemetryRecord(record, bytes);
+  return fl_value_new_uint8_list(bytes, sizeof(bytes));
+}
+
+struct PathCost {
+  double ns = 0;
+  double allocations = 0;
+  double bytes = 0;
+};
+
+// Builds, posts, drains and encodes |events| events made by |make|.
+template <typename Make>
+PathCost Measure(FlMethodCodec* codec, uint64_t events, Make make) {
+  Hub hub(EventHubConfig(), [](std::chrono::milliseconds) {});
+  uint64_t encoded = 0;
+  allocations = 0;
+  counting = true;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < events; ++i) {
+    QueuedEvent queued;
+    queued.value.reset(make(SampleRecord(i)));
+    hub.Post("frameRate", EventPriority::kStats, std::move(queued));
+    for (const auto& event : hub.Drain()) {
+      g_autoptr(GError) error = nullptr;
+      g_autoptr(GBytes) message = fl_method_codec_encode_success_envelope(
+          codec, event.payloads.front().value.get(), &error);
+      if (message != nullptr) encoded += g_bytes_get_size(message);
+    }
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  counting = false;
+  PathCost cost;
+  cost.ns = elapsed.count() / events;
+  cost.allocations = static_cast<double>(allocations.load()) / events;
+  cost.bytes = static_cast<double>(encoded) / events;
+  return cost;
+}
+
+}  // namespace
+
+TEST(TelemetryBenchmark, BinaryRecordAgainstNamedMap) {
+  constexpr uint64_t kEvents = 100000;
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  const PathCost map =
+      Measure(FL_METHOD_CODEC(codec), kEvents, NamedMap);
+  const PathCost binary =
+      Measure(FL_METHOD_CODEC(codec), kEvents, BinaryRecord);
+  std::printf(
+      "Per event, build to encoded message: named map %.0f ns, %.1f "
+      "allocations, %.0f bytes; binary record %.0f ns, %.1f allocations, "
+      "%.0f bytes\n",
+      map.ns, map.allocations, map.bytes, binary.ns, binary.allocations,
+      binary.bytes);
+  EXPECT_GT(binary.bytes, 0);
+  EXPECT_LT(binary.allocations, map.allocations);
+  EXPECT_LT(binary.ns, map.ns);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include "telemetry_record.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+TelemetryRecord SampleRecord(uint64_t i) {
+  TelemetryRecord record;
+  record.changed = kTelemetryFrameRate | kTelemetryEncode;
+  record.timestamp_us = 1700000000000000 + static_cast<int64_t>(i);
+  record.target_fps = 24;
+  record.frames_dropped = 1234 + i;
+  record.max_queue_depth = 3;
+  record.capture_latency_us = 4100;
+  record.encode_latency_us = 28500;
+  record.mux_latency_us = 350;
+  record.frames_encoded = 29;
+  record.frames_skipped = 1 + i % 7;
+  record.compare_time_us = 812;
+  record.encode_time_saved_us = 9000;
+  return record;
+}
+
+}  // namespace
+
+TEST(TelemetryRecord, RoundTrips) {
+  const TelemetryRecord record = SampleRecord(5);
+  uint8_t bytes[kTelemetryRecordSize];
+  EncodeTelemetryRecord(record, bytes);
+  EXPECT_EQ(bytes[0], kTelemetryRecordVersion);
+  EXPECT_EQ(bytes[1], 0);
+
+  TelemetryRecord decoded;
+  ASSERT_TRUE(DecodeTelemetryRecord(bytes, sizeof(bytes), &decoded));
+  EXPECT_EQ(decoded.changed, record.changed);
+  EXPECT_EQ(decoded.timestamp_us, record.timestamp_us);
+  EXPECT_EQ(decoded.target_fps, record.target_fps);
+  EXPECT_EQ(decoded.frames_dropped, record.frames_dropped);
+  EXPECT_EQ(decoded.max_queue_depth, record.max_queue_depth);
+  EXPECT_EQ(decoded.capture_latency_us, record.capture_latency_us);
+  EXPECT_EQ(decoded.encode_latency_us, record.encode_latency_us);
+  EXPECT_EQ(decoded.mux_latency_us, record.mux_latency_us);
+  EXPECT_EQ(decoded.frames_encoded, record.frames_encoded);
+  EXPECT_EQ(decoded.frames_skipped, record.frames_skipped);
+  EXPECT_EQ(decoded.compare_time_us, record.compare_time_us);
+  EXPECT_EQ(decoded.encode_time_saved_us, record.encode_time_saved_us);
+
+  EXPECT_FALSE(DecodeTelemetryRecord(bytes, sizeof(bytes) - 1, &decoded));
+  bytes[0] = 0xff;
+  EXPECT_FALSE(DecodeTelemetryRecord(bytes, sizeof(bytes), &decoded));
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,243 @@
+#include "test/throttled_http_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <utility>
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr size_t kChunkBytes = 8 << 10;
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void SleepUntilUs(int64_t deadline_us) {
+  const int64_t wait_us = deadline_us - NowUs();
+  if (wait_us > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+  }
+}
+
+bool SendAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent <= 0) return false;
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+// The value of header |name| in |headers|, or an empty string.
+std::string Header(const std::string& headers, const char* name) {
+  const size_t length = std::strlen(name);
+  size_t line = headers.find("\r\n");
+  while (line != std::string::npos && line + 2 < headers.size()) {
+    const size_t start = line + 2;
+    if (strncasecmp(headers.c_str() + start, name, length) == 0 &&
+        headers[start + length] == ':') {
+      const size_t end = headers.find("\r\n", start);
+      size_t value = start + length + 1;
+      while (value < end && headers[value] == ' ') ++value;
+      return headers.substr(value, end - value);
+    }
+    line = headers.find("\r\n", start);
+  }
+  return "";
+}
+
+}  // namespace
+
+ThrottledHttpServer::ThrottledHttpServer(const Options& options)
+    : options_(options) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) return;
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+      listen(listen_fd_, 64) != 0 ||
+      getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                  &length) != 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return;
+  }
+  port_ = ntohs(address.sin_port);
+  acceptor_ = std::thread(&ThrottledHttpServer::AcceptLoop, this);
+}
+
+ThrottledHttpServer::~ThrottledHttpServer() {
+  stopping_ = true;
+  if (acceptor_.joinable()) acceptor_.join();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int fd : connections_) shutdown(fd, SHUT_RDWR);
+  }
+  for (std::thread& server : servers_) server.join();
+  for (int fd : connections_) close(fd);
+  if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+void ThrottledHttpServer::Set(const std::string& path, std::string body) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  resources_[path] = std::make_shared<const std::string>(std::move(body));
+}
+
+void ThrottledHttpServer::Fail(const std::string& path, int status,
+                               int times) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  failures_[path] = {status, times};
+}
+
+void ThrottledHttpServer::SetHandler(Handler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  handler_ = std::move(handler);
+}
+
+std::string ThrottledHttpServer::Url(const std::string& path) const {
+  return "http://127.0.0.1:" + std::to_string(port_) + path;
+}
+
+void ThrottledHttpServer::AcceptLoop() {
+  while (!stopping_) {
+    pollfd poll_fd = {listen_fd_, POLLIN, 0};
+    if (poll(&poll_fd, 1, 20) <= 0) continue;
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) continue;
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.push_back(fd);
+    servers_.emplace_back(&ThrottledHttpServer::Serve, this, fd);
+  }
+}
+
+void ThrottledHttpServer::Pace(int64_t bytes, int64_t* next_us) {
+  int64_t deadline_us = NowUs();
+  if (options_.connection_bytes_per_second > 0) {
+    *next_us = std::max(*next_us, deadline_us) +
+               bytes * 1000000 / options_.connection_bytes_per_second;
+    deadline_us = *next_us;
+  }
+  if (options_.total_bytes_per_second > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_next_us_ = std::max(total_next_us_, NowUs()) +
+                     bytes * 1000000 / options_.total_bytes_per_second;
+    deadline_us = std::max(deadline_us, total_next_us_);
+  }
+  SleepUntilUs(deadline_us);
+}
+
+void ThrottledHttpServer::Serve(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  int64_t next_us = 0;
+  while (!stopping_) {
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      const ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+      if (received <= 0) return;
+      buffer.append(chunk, received);
+    }
+    const std::string headers = buffer.substr(0, end + 2);
+    buffer.erase(0, end + 4);
+    ++requests_;
+    const int concurrent = ++concurrent_;
+    int seen = max_concurrent_;
+    while (concurrent > seen &&
+           !max_concurrent_.compare_exchange_weak(seen, concurrent)) {
+    }
+
+    const size_t path_start = headers.find(' ') + 1;
+    const std::string path =
+        headers.substr(path_start, headers.find(' ', path_start) - path_start);
+    std::shared_ptr<const std::string> body;
+    int status = 200;
+    Handler handler;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      handler = handler_;
+    }
+    std::string generated;
+    const int handled = handler ? handler(path, &generated) : 0;
+    if (handled != 0) {
+      status = handled;
+      if (status < 300) {
+        body = std::make_shared<const std::string>(std::move(generated));
+      }
+    } else {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto failure = failures_.find(path);
+      if (failure != failures_.end() && failure->second.second > 0) {
+        status = failure->second.first;
+        --failure->second.second;
+      } else {
+        auto resource = resources_.find(path);
+        if (resource == resources_.end()) {
+          status = 404;
+        } else {
+          body = resource->second;
+        }
+      }
+    }
+    SleepUntilUs(NowUs() + options_.latency_us);
+
+    int64_t first = 0;
+    int64_t last = body ? static_cast<int64_t>(body->size()) - 1 : -1;
+    const std::string range = Header(headers, "Range");
+    if (body && range.compare(0, 6, "bytes=") == 0) {
+      ++range_requests_;
+      const size_t dash = range.find('-');
+      first = std::strtoll(range.c_str() + 6, nullptr, 10);
+      if (dash + 1 < range.size()) {
+        last = std::min<int64_t>(
+            last, std::strtoll(range.c_str() + dash + 1, nullptr, 10));
+      }
+      status = first <= last ? 206 : 416;
+    }
+
+    std::string response;
+    const int64_t length = status == 200 || status == 206 ? last - first + 1
+                                                         : 0;
+    response = "HTTP/1.1 " + std::to_string(status) +
+               (status < 300 ? " OK" : " Error") +
+               "\r\nContent-Length: " + std::to_string(length) + "\r\n";
+    if (status == 206) {
+      response += "Content-Range: bytes " + std::to_string(first) + "-" +
+                  std::to_string(last) + "/" + std::to_string(body->size()) +
+                  "\r\n";
+    }
+    response += "\r\n";
+    bool sent = SendAll(fd, response.data(), response.size());
+    for (int64_t offset = first; sent && offset < first + length;
+         offset += kChunkBytes) {
+      const int64_t size = std::min<int64_t>(kChunkBytes,
+                                             first + length - offset);
+      Pace(size, &next_us);
+      sent = !stopping_ && SendAll(fd, body->data() + offset, size);
+    }
+    --concurrent_;
+    if (!sent) return;
+  }
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
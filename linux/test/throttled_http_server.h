@@ -0,0 +1,87 @@
+#ifndef IVS_BROADCASTER_TEST_THROTTLED_HTTP_SERVER_H_
+#define IVS_BROADCASTER_TEST_THROTTLED_HTTP_SERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ivs_broadcaster {
+namespace test {
+
+// A local HTTP/1.1 server standing in for a CDN edge: it serves in-memory
+// resources with Range support and keep-alive, adds a fixed latency before
+// every response and paces bodies per connection and in total.
+class ThrottledHttpServer {
+ public:
+  struct Options {
+    // Delay before each response, standing in for a round trip.
+    int64_t latency_us = 0;
+    // 0 leaves the rate unlimited.
+    int64_t connection_bytes_per_second = 0;
+    int64_t total_bytes_per_second = 0;
+  };
+
+  // Answers a request for |target|, path and query, with a status and a
+  // body, or 0 to fall back to the resources set. May block, e.g. until the
+  // resource exists.
+  using Handler = std::function<int(const std::string& target,
+                                    std::string* body)>;
+
+  explicit ThrottledHttpServer(const Options& options);
+  ~ThrottledHttpServer();
+
+  ThrottledHttpServer(const ThrottledHttpServer&) = delete;
+  ThrottledHttpServer& operator=(const ThrottledHttpServer&) = delete;
+
+  bool ok() const { return listen_fd_ >= 0; }
+
+  // Serves |body| at |path|, replacing what was there.
+  void Set(const std::string& path, std::string body);
+  // Answers requests for |path| with |status| instead, e.g. to fail them.
+  void Fail(const std::string& path, int status, int times);
+  // Called for every request before the resources are looked at.
+  void SetHandler(Handler handler);
+
+  std::string Url(const std::string& path) const;
+
+  int requests() const { return requests_; }
+  int range_requests() const { return range_requests_; }
+  int max_concurrent() const { return max_concurrent_; }
+
+ private:
+  void AcceptLoop();
+  void Serve(int fd);
+  // Sleeps until |bytes| more may be sent on a connection whose pacing
+  // state is |next_us|.
+  void Pace(int64_t bytes, int64_t* next_us);
+
+  const Options options_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::atomic<bool> stopping_{false};
+  std::thread acceptor_;
+
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<const std::string>> resources_;
+  std::map<std::string, std::pair<int, int>> failures_;
+  Handler handler_;
+  std::vector<int> connections_;
+  std::vector<std::thread> servers_;
+  int64_t total_next_us_ = 0;
+
+  std::atomic<int> requests_{0};
+  std::atomic<int> range_requests_{0};
+  std::atomic<int> concurrent_{0};
+  std::atomic<int> max_concurrent_{0};
+};
+
+}  // namespace test
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_TEST_THROTTLED_HTTP_SERVER_H_
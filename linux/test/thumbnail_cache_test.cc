@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "thumbnail_cache.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+ThumbnailKey Key(const char* url, int64_t bucket) {
+  ThumbnailKey key;
+  key.url = url;
+  key.bucket = bucket;
+  key.width = 320;
+  key.height = 180;
+  return key;
+}
+
+ThumbnailPtr Bytes(size_t size) {
+  auto thumbnail = std::make_shared<Thumbnail>();
+  thumbnail->data.resize(size);
+  return thumbnail;
+}
+
+}  // namespace
+
+TEST(ThumbnailCache, EvictsLeastRecentlyUsedOverBudget) {
+  ThumbnailCache cache(300);
+  cache.Put(Key("a", 0), Bytes(100));
+  cache.Put(Key("a", 1), Bytes(100));
+  cache.Put(Key("b", 0), Bytes(100));
+  // Touch the oldest so the next insert evicts ("a", 1) instead.
+  EXPECT_NE(cache.Get(Key("a", 0)), nullptr);
+  cache.Put(Key("b", 1), Bytes(100));
+
+  EXPECT_NE(cache.Get(Key("a", 0)), nullptr);
+  EXPECT_EQ(cache.Get(Key("a", 1)), nullptr);
+  EXPECT_NE(cache.Get(Key("b", 0)), nullptr);
+  EXPECT_NE(cache.Get(Key("b", 1)), nullptr);
+
+  ThumbnailCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.entries, 3u);
+  EXPECT_EQ(stats.bytes, 300u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.hits, 4u);
+  EXPECT_EQ(stats.misses, 1u);
+}
+
+TEST(ThumbnailCache, KeysIncludeSizeAndFormat) {
+  ThumbnailCache cache(1000);
+  ThumbnailKey key = Key("a", 0);
+  cache.Put(key, Bytes(10));
+  ThumbnailKey other = key;
+  other.width = 160;
+  EXPECT_EQ(cache.Get(other), nullptr);
+  other = key;
+  other.format = ThumbnailFormat::kWebp;
+  EXPECT_EQ(cache.Get(other), nullptr);
+  EXPECT_NE(cache.Get(key), nullptr);
+}
+
+TEST(ThumbnailCache, ReplacesAndRejectsOversizedEntries) {
+  ThumbnailCache cache(100);
+  cache.Put(Key("a", 0), Bytes(60));
+  cache.Put(Key("a", 0), Bytes(40));
+  EXPECT_EQ(cache.stats().bytes, 40u);
+  cache.Put(Key("b", 0), Bytes(101));
+  EXPECT_EQ(cache.Get(Key("b", 0)), nullptr);
+  EXPECT_EQ(cache.stats().bytes, 40u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thumbnail_engine.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int kFps = 10;
+constexpr int kGop = 20;
+
+// Writes |frames| of the synthetic pattern as a YUV4MPEG2 file.
+std::string WriteY4m(const std::string& name, int width, int height,
+                     int frames) {
+  const std::string path = ::testing::TempDir() + name;
+  std::ofstream out(path, std::ios::binary);
+  out << "YUV4MPEG2 W" << width << " H" << height << " F" << kFps
+      << ":1 Ip A1:1 C420jpeg\n";
+  SyntheticFrameSource source(width, height, kFps);
+  VideoFrame frame;
+  for (int i = 0; i < frames; ++i) {
+    source.Next(&frame);
+    out << "FRAME\n";
+    out.write(reinterpret_cast<const char*>(frame.data.data()),
+              frame.data.size());
+  }
+  return path;
+}
+
+// Reads Y4M files from disk, treating every kGop-th frame as a keyframe.
+// Encoding stores the raw planes; WebP is "unsupported" and falls back to
+// JPEG the way the FFmpeg codec does without libwebp.
+class Y4mCodec : public ThumbnailCodec {
+ public:
+  explicit Y4mCodec(std::atomic<int>* decodes) : decodes_(decodes) {}
+
+  bool DecodeKeyframe(const std::string& url, int64_t time_us,
+                      VideoFrame* frame, std::string* error) override {
+    ++*decodes_;
+    std::ifstream in(url, std::ios::binary);
+    std::string header;
+    if (!std::getline(in, header) || header.rfind("YUV4MPEG2", 0) != 0) {
+      *error = "not a y4m file: " + url;
+      return false;
+    }
+    int width = 0;
+    int height = 0;
+    std::sscanf(header.c_str(), "YUV4MPEG2 W%d H%d", &width, &height);
+    frame->Allocate(width, height);
+    const int64_t index = time_us * kFps / 1000000;
+    const int64_t keyframe = index - index % kGop;
+    const std::streamoff frame_size = 6 + frame->data.size();
+    in.seekg(keyframe * frame_size + 6, std::ios::cur);
+    if (!in.read(reinterpret_cast<char*>(frame->data.data()),
+                 frame->data.size())) {
+      *error = "seek past end";
+      return false;
+    }
+    frame->pts_us = keyframe * 1000000 / kFps;
+    return true;
+  }
+
+  bool Encode(const VideoFrame& frame, int quality, ThumbnailFormat* format,
+              std::vector<uint8_t>* out, std::string* error) override {
+    *format = ThumbnailFormat::kJpeg;
+    *out = frame.data;
+    return true;
+  }
+
+ private:
+  std::atomic<int>* decodes_;
+};
+
+class Waiter {
+ public:
+  ThumbnailEngine::Callback callback() {
+    return [this](const ThumbnailResult& result) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      results_.push_back(result);
+      done_.notify_all();
+    };
+  }
+
+  std::vector<ThumbnailResult> Wait(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait_for(lock, std::chrono::seconds(10),
+                   [&] { return results_.size() >= count; });
+    return results_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::vector<ThumbnailResult> results_;
+};
+
+}  // namespace
+
+TEST(ThumbnailEngine, DecodesNearestKeyframeFromLocalFile) {
+  const std::string path = WriteY4m("thumbs_720p.y4m", 1280, 720, 60);
+  std::atomic<int> decodes{0};
+  ThumbnailEngine engine([&] { return std::make_unique<Y4mCodec>(&decodes); },
+                         ThumbnailEngine::Config());
+
+  ThumbnailRequest request;
+  request.url = path;
+  request.time_us = 3500000;  // Frame 35; its keyframe is frame 20.
+  request.width = 320;
+  request.height = 320;
+  request.format = ThumbnailFormat::kWebp;
+  Waiter waiter;
+  engine.Request(request, waiter.callback());
+  std::vector<ThumbnailResult> results = waiter.Wait(1);
+  ASSERT_EQ(results.size(), 1u);
+  ASSERT_TRUE(results[0].ok) << results[0].error;
+  const Thumbnail& thumbnail = *results[0].thumbnail;
+  EXPECT_EQ(thumbnail.width, 320);
+  EXPECT_EQ(thumbnail.height, 180);
+  EXPECT_EQ(thumbnail.pts_us, 2000000);
+  EXPECT_EQ(thumbnail.format, ThumbnailFormat::kJpeg);
+  EXPECT_EQ(thumbnail.data.size(), 320u * 180 * 3 / 2);
+  EXPECT_FALSE(results[0].from_cache);
+
+  // Same bucket: answered from the cache without decoding again.
+  request.time_us = 3900000;
+  Waiter cached;
+  engine.Request(request, cached.callback());
+  results = cached.Wait(1);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_TRUE(results[0].from_cache);
+  EXPECT_EQ(decodes, 1);
+  EXPECT_EQ(engine.cache_stats().hits, 1u);
+}
+
+TEST(ThumbnailEngine, SharesOneDecodeBetweenIdenticalRequests) {
+  const std::string path = WriteY4m("thumbs_shared.y4m", 640, 360, 40);
+  std::atomic<int> decodes{0};
+  ThumbnailEngine::Config config;
+  config.workers = 4;
+  ThumbnailEngine engine([&] { return std::make_unique<Y4mCodec>(&decodes); },
+                         config);
+
+  ThumbnailRequest request;
+  request.url = path;
+  request.time_us = 1000000;
+  Waiter waiter;
+  for (int i = 0; i < 8; ++i) engine.Request(request, waiter.callback());
+  request.time_us = 2500000;
+  engine.Request(request, waiter.callback());
+  std::vector<ThumbnailResult> results = waiter.Wait(9);
+  ASSERT_EQ(results.size(), 9u);
+  for (const ThumbnailResult& result : results) EXPECT_TRUE(result.ok);
+  // At most one decode per bucket, fewer if the first finished before the
+  // rest were queued and they hit the cache.
+  EXPECT_LE(decodes, 2);
+  EXPECT_EQ(engine.decodes(), static_cast<uint64_t>(decodes.load()));
+}
+
+TEST(ThumbnailEngine, ReportsDecodeErrors) {
+  std::atomic<int> decodes{0};
+  ThumbnailEngine engine([&] { return std::make_unique<Y4mCodec>(&decodes); },
+                         ThumbnailEngine::Config());
+  ThumbnailRequest request;
+  request.url = ::testing::TempDir() + "missing.y4m";
+  Waiter waiter;
+  engine.Request(request, waiter.callback());
+  std::vector<ThumbnailResult> results = waiter.Wait(1);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_FALSE(results[0].ok);
+  EXPECT_FALSE(results[0].error.empty());
+  EXPECT_EQ(engine.cache_stats().entries, 0u);
+}
+
+TEST(ThumbnailEngine, ThumbnailsLongFileQuickly) {
+  const std::string path = WriteY4m("thumbs_1080p.y4m", 1920, 1080, 100);
+  std::atomic<int> decodes{0};
+  ThumbnailEngine engine([&] { return std::make_unique<Y4mCodec>(&decodes); },
+                         ThumbnailEngine::Config());
+  Waiter waiter;
+  const auto start = std::chrono::steady_clock::now();
+  for (int second = 0; second < 10; ++second) {
+    ThumbnailRequest request;
+    request.url = path;
+    request.time_us = second * 1000000LL;
+    engine.Request(request, waiter.callback());
+  }
+  std::vector<ThumbnailResult> results = waiter.Wait(10);
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("10 requests over 1080p y4m: %.1f ms, %d decodes\n",
+              elapsed.count(), decodes.load());
+  ASSERT_EQ(results.size(), 10u);
+  // Two-second buckets over a ten-second file.
+  EXPECT_EQ(decodes, 5);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "triple_buffer.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+TEST(TripleBuffer, ConsumerSeesNewestValue) {
+  TripleBuffer<int> buffer;
+  EXPECT_FALSE(buffer.Update());
+
+  buffer.write_buffer() = 1;
+  buffer.Publish();
+  buffer.write_buffer() = 2;
+  buffer.Publish();
+  ASSERT_TRUE(buffer.Update());
+  EXPECT_EQ(buffer.read_buffer(), 2);
+  EXPECT_FALSE(buffer.Update());
+  EXPECT_EQ(buffer.read_buffer(), 2);
+
+  buffer.write_buffer() = 3;
+  buffer.Publish();
+  ASSERT_TRUE(buffer.Update());
+  EXPECT_EQ(buffer.read_buffer(), 3);
+}
+
+// Each value is written as a pair of equal halves; a buffer shared by both
+// threads at once would show up as a mismatched pair.
+TEST(TripleBuffer, NeverSharesABufferBetweenThreads) {
+  struct Pair {
+    uint64_t first = 0;
+    uint64_t second = 0;
+  };
+  TripleBuffer<Pair> buffer;
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (uint64_t i = 1; i <= 1000000; ++i) {
+      Pair& pair = buffer.write_buffer();
+      pair.first = i;
+      pair.second = i;
+      buffer.Publish();
+    }
+    done = true;
+  });
+
+  uint64_t last = 0;
+  uint64_t updates = 0;
+  while (!done) {
+    if (!buffer.Update()) continue;
+    const Pair& pair = buffer.read_buffer();
+    ASSERT_EQ(pair.first, pair.second);
+    ASSERT_GT(pair.first, last);
+    last = pair.first;
+    ++updates;
+  }
+  producer.join();
+  ASSERT_TRUE(buffer.Update() || last == 1000000);
+  EXPECT_EQ(buffer.read_buffer().first, 1000000u);
+  EXPECT_GT(updates, 0u);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
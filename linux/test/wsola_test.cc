@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "wsola.h"
+
+namespace ivs_broadcaster {
+namespace test {
+
+namespace {
+
+constexpr int kRate = 48000;
+
+std::vector<float> Tone(double hz, int frames, int channels) {
+  std::vector<float> samples(static_cast<size_t>(frames) * channels);
+  for (int i = 0; i < frames; ++i) {
+    for (int c = 0; c < channels; ++c) {
+      samples[i * channels + c] =
+          static_cast<float>(0.5 * std::sin(2 * M_PI * hz * i / kRate));
+    }
+  }
+  return samples;
+}
+
+// Feeds |input| in 10 ms packets, as a decoder would.
+std::vector<float> Stretch(WsolaStretcher* stretcher,
+                           const std::vector<float>& input, int64_t* first) {
+  const int channels = stretcher->channels();
+  const int frames = static_cast<int>(input.size()) / channels;
+  std::vector<float> output;
+  *first = -1;
+  for (int i = 0; i < frames; i += kRate / 100) {
+    const int count = std::min(kRate / 100, frames - i);
+    const int64_t appended =
+        stretcher->Process(input.data() + i * channels, count, &output);
+    if (*first < 0) *first = appended;
+  }
+  return output;
+}
+
+// The tone's frequency, from the rising zero crossings of its first channel.
+double Frequency(const std::vector<float>& samples, int channels) {
+  int first = -1;
+  int last = -1;
+  int crossings = 0;
+  for (size_t i = channels; i < samples.size(); i += channels) {
+    if (samples[i - channels] < 0 && samples[i] >= 0) {
+      const int frame = static_cast<int>(i / channels);
+      if (first < 0) first = frame;
+      last = frame;
+      ++crossings;
+    }
+  }
+  if (crossings < 2) return 0;
+  return (crossings - 1) * static_cast<double>(kRate) / (last - first);
+}
+
+}  // namespace
+
+TEST(WsolaStretcher, ReproducesTheInputAtRateOne) {
+  WsolaStretcher stretcher(kRate, 2);
+  std::vector<float> input(kRate * 2);
+  // Not periodic, so no other segment matches as well.
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = static_cast<float>(std::sin(i * 0.01 + 0.00001 * i * i));
+  }
+  int64_t first = 0;
+  const std::vector<float> output = Stretch(&stretcher, input, &first);
+  // Held back by half a window.
+  EXPECT_EQ(first, kRate / 100);
+  ASSERT_GT(output.size(), input.size() * 9 / 10);
+  for (size_t i = 0; i < output.size(); ++i) {
+    ASSERT_NEAR(output[i], input[first * 2 + i], 1e-5) << i;
+  }
+}
+
+TEST(WsolaStretcher, ChangesSpeedButNotPitch) {
+  const std::vector<float> input = Tone(440, kRate * 2, 2);
+  for (double rate : {0.9, 1.1}) {
+    WsolaStretcher stretcher(kRate, 2);
+    stretcher.SetRate(rate);
+    int64_t first = 0;
+    const std::vector<float> output = Stretch(&stretcher, input, &first);
+    const double seconds = output.size() / 2.0 / kRate;
+    const double frequency = Frequency(output, 2);
+    std::printf("2 s of 440 Hz at %.1fx: %.3f s at %.1f Hz\n", rate,
+                seconds, frequency);
+
+    EXPECT_NEAR(seconds, 2 / rate, 0.05) << rate;
+    EXPECT_NEAR(frequency, 440, 440 * 0.02) << rate;
+    // No sample is louder than the tone, as a phase jump's would be.
+    for (float sample : output) ASSERT_LE(std::fabs(sample), 0.51f);
+  }
+}
+
+TEST(WsolaStretcher, StartsOverAfterReset) {
+  WsolaStretcher stretcher(kRate, 1);
+  std::vector<float> output;
+  const std::vector<float> input = Tone(440, kRate / 10, 1);
+  stretcher.Process(input.data(), kRate / 10, &output);
+  stretcher.Reset();
+  output.clear();
+  EXPECT_EQ(stretcher.Process(input.data(), kRate / 10, &output),
+            kRate / 100);
+}
+
+}  // namespace test
+}  // namespace ivs_broadcaster
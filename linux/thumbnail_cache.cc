@@ -0,0 +1,79 @@
+#include "thumbnail_cache.h"
+
+#include <functional>
+#include <utility>
+
+namespace ivs_broadcaster {
+
+bool ThumbnailKey::operator==(const ThumbnailKey& other) const {
+  return bucket == other.bucket && width == other.width &&
+         height == other.height && format == other.format &&
+         url == other.url;
+}
+
+size_t ThumbnailKeyHash::operator()(const ThumbnailKey& key) const {
+  size_t hash = std::hash<std::string>()(key.url);
+  for (int64_t part : {key.bucket, static_cast<int64_t>(key.width),
+                       static_cast<int64_t>(key.height),
+                       static_cast<int64_t>(key.format)}) {
+    hash ^= std::hash<int64_t>()(part) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+  }
+  return hash;
+}
+
+ThumbnailCache::ThumbnailCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+ThumbnailPtr ThumbnailCache::Get(const ThumbnailKey& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return nullptr;
+  }
+  ++stats_.hits;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->thumbnail;
+}
+
+void ThumbnailCache::Put(const ThumbnailKey& key, ThumbnailPtr thumbnail) {
+  if (!thumbnail) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    stats_.bytes -= it->second->thumbnail->data.size();
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+  if (thumbnail->data.size() > max_bytes_) return;
+  stats_.bytes += thumbnail->data.size();
+  entries_.push_front(Entry{key, std::move(thumbnail)});
+  index_[key] = entries_.begin();
+  EvictLocked();
+}
+
+void ThumbnailCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  stats_.bytes = 0;
+}
+
+ThumbnailCacheStats ThumbnailCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ThumbnailCacheStats stats = stats_;
+  stats.entries = entries_.size();
+  return stats;
+}
+
+void ThumbnailCache::EvictLocked() {
+  while (stats_.bytes > max_bytes_ && !entries_.empty()) {
+    const Entry& last = entries_.back();
+    stats_.bytes -= last.thumbnail->data.size();
+    index_.erase(last.key);
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+}
+
+}  // namespace ivs_broadcaster
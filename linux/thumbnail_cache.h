@@ -0,0 +1,102 @@
+#ifndef IVS_BROADCASTER_THUMBNAIL_CACHE_H_
+#define IVS_BROADCASTER_THUMBNAIL_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// Image formats a thumbnail can be encoded in. Matches ThumbnailFormat on
+// the Dart side.
+enum class ThumbnailFormat {
+  kJpeg = 0,
+  kWebp = 1,
+};
+
+// Identifies one encoded thumbnail. Requests for nearby times share a
+// |bucket| so scrubbing does not decode the same keyframe over and over.
+struct ThumbnailKey {
+  std::string url;
+  int64_t bucket = 0;
+  int width = 0;
+  int height = 0;
+  ThumbnailFormat format = ThumbnailFormat::kJpeg;
+
+  bool operator==(const ThumbnailKey& other) const;
+};
+
+struct ThumbnailKeyHash {
+  size_t operator()(const ThumbnailKey& key) const;
+};
+
+// An encoded thumbnail.
+struct Thumbnail {
+  // May differ from the requested format when the codec cannot produce it.
+  ThumbnailFormat format = ThumbnailFormat::kJpeg;
+  int width = 0;
+  int height = 0;
+  // Presentation time of the decoded keyframe.
+  int64_t pts_us = 0;
+  std::vector<uint8_t> data;
+};
+
+using ThumbnailPtr = std::shared_ptr<const Thumbnail>;
+
+struct ThumbnailCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t bytes = 0;
+  size_t entries = 0;
+};
+
+// A least-recently-used cache of encoded thumbnails bounded by their total
+// size. Entries are shared, so a hit hands out the bytes without copying
+// them. Thread-safe.
+class ThumbnailCache {
+ public:
+  explicit ThumbnailCache(size_t max_bytes);
+
+  ThumbnailCache(const ThumbnailCache&) = delete;
+  ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+  // Returns the entry for |key| and marks it most recently used, or nullptr.
+  ThumbnailPtr Get(const ThumbnailKey& key);
+
+  // Inserts or replaces |key|, then evicts from the least recently used end
+  // until the cache fits its budget. An entry larger than the whole budget
+  // is not kept.
+  void Put(const ThumbnailKey& key, ThumbnailPtr thumbnail);
+
+  void Clear();
+
+  ThumbnailCacheStats stats() const;
+
+ private:
+  struct Entry {
+    ThumbnailKey key;
+    ThumbnailPtr thumbnail;
+  };
+
+  void EvictLocked();
+
+  const size_t max_bytes_;
+
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<ThumbnailKey, std::list<Entry>::iterator,
+                     ThumbnailKeyHash>
+      index_;
+  ThumbnailCacheStats stats_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_THUMBNAIL_CACHE_H_
@@ -0,0 +1,147 @@
+#include "thumbnail_engine.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "frame_scaler.h"
+
+namespace ivs_broadcaster {
+
+ThumbnailEngine::ThumbnailEngine(ThumbnailCodecFactory codec_factory,
+                                 Config config)
+    : codec_factory_(std::move(codec_factory)),
+      config_(config),
+      cache_(config.cache_bytes) {
+  for (int i = 0; i < std::max(1, config_.workers); ++i) {
+    workers_.emplace_back(&ThumbnailEngine::WorkerLoop, this);
+  }
+}
+
+ThumbnailEngine::~ThumbnailEngine() {
+  std::deque<Job> abandoned;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    abandoned.swap(queue_);
+  }
+  wake_.notify_all();
+  for (std::thread& worker : workers_) worker.join();
+  ThumbnailResult result;
+  result.error = "thumbnail engine stopped";
+  for (const Job& job : abandoned) Finish(job.key, result);
+}
+
+ThumbnailKey ThumbnailEngine::KeyFor(const ThumbnailRequest& request) const {
+  ThumbnailKey key;
+  key.url = request.url;
+  const int64_t bucket_us = std::max<int64_t>(1, config_.time_bucket_us);
+  key.bucket = std::max<int64_t>(0, request.time_us) / bucket_us;
+  key.width = request.width;
+  key.height = request.height;
+  key.format = request.format;
+  return key;
+}
+
+uint64_t ThumbnailEngine::decodes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return decodes_;
+}
+
+void ThumbnailEngine::Request(const ThumbnailRequest& request,
+                              Callback callback) {
+  ThumbnailKey key = KeyFor(request);
+  if (ThumbnailPtr thumbnail = cache_.Get(key)) {
+    ThumbnailResult result;
+    result.ok = true;
+    result.thumbnail = std::move(thumbnail);
+    result.from_cache = true;
+    callback(result);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopping_) {
+      std::vector<Callback>& callbacks = waiting_[key];
+      callbacks.push_back(std::move(callback));
+      if (callbacks.size() > 1) return;
+      queue_.push_back(Job{std::move(key), request});
+      wake_.notify_one();
+      return;
+    }
+  }
+  ThumbnailResult result;
+  result.error = "thumbnail engine stopped";
+  callback(result);
+}
+
+void ThumbnailEngine::WorkerLoop() {
+  std::unique_ptr<ThumbnailCodec> codec = codec_factory_();
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+      ++decodes_;
+    }
+    ThumbnailResult result;
+    if (codec) {
+      result = Produce(codec.get(), job);
+    } else {
+      result.error = "no thumbnail codec";
+    }
+    if (result.ok) cache_.Put(job.key, result.thumbnail);
+    Finish(job.key, result);
+  }
+}
+
+ThumbnailResult ThumbnailEngine::Produce(ThumbnailCodec* codec,
+                                         const Job& job) {
+  ThumbnailResult result;
+  VideoFrame frame;
+  if (!codec->DecodeKeyframe(job.request.url, job.request.time_us, &frame,
+                             &result.error)) {
+    return result;
+  }
+  int width = 0;
+  int height = 0;
+  FitWithin(frame.width, frame.height, job.request.width, job.request.height,
+            &width, &height);
+  VideoFrame scaled;
+  const VideoFrame* output = &frame;
+  if (width != frame.width || height != frame.height) {
+    scaled.Allocate(width, height);
+    scaled.pts_us = frame.pts_us;
+    ScaleFrame(frame, &scaled);
+    output = &scaled;
+  }
+  auto thumbnail = std::make_shared<Thumbnail>();
+  thumbnail->format = job.request.format;
+  thumbnail->width = width;
+  thumbnail->height = height;
+  thumbnail->pts_us = frame.pts_us;
+  if (!codec->Encode(*output, job.request.quality, &thumbnail->format,
+                     &thumbnail->data, &result.error)) {
+    return result;
+  }
+  result.ok = true;
+  result.thumbnail = std::move(thumbnail);
+  return result;
+}
+
+void ThumbnailEngine::Finish(const ThumbnailKey& key,
+                             const ThumbnailResult& result) {
+  std::vector<Callback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = waiting_.find(key);
+    if (it == waiting_.end()) return;
+    callbacks.swap(it->second);
+    waiting_.erase(it);
+  }
+  for (Callback& callback : callbacks) callback(result);
+}
+
+}  // namespace ivs_broadcaster
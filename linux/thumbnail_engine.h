@@ -0,0 +1,128 @@
+#ifndef IVS_BROADCASTER_THUMBNAIL_ENGINE_H_
+#define IVS_BROADCASTER_THUMBNAIL_ENGINE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "thumbnail_cache.h"
+#include "video_frame.h"
+
+namespace ivs_broadcaster {
+
+struct ThumbnailRequest {
+  std::string url;
+  int64_t time_us = 0;
+  // Bounding box; the thumbnail keeps the source aspect ratio inside it.
+  // Zero leaves a dimension unconstrained.
+  int width = 320;
+  int height = 180;
+  ThumbnailFormat format = ThumbnailFormat::kJpeg;
+  int quality = 80;
+};
+
+struct ThumbnailResult {
+  bool ok = false;
+  std::string error;
+  ThumbnailPtr thumbnail;
+  bool from_cache = false;
+};
+
+// Decodes and encodes frames for the engine. Each worker owns one, so an
+// implementation need not be thread-safe.
+class ThumbnailCodec {
+ public:
+  virtual ~ThumbnailCodec() = default;
+
+  // Decodes the keyframe at or before |time_us| in the media at |url| into
+  // |frame|, falling back to the first keyframe after it.
+  virtual bool DecodeKeyframe(const std::string& url, int64_t time_us,
+                              VideoFrame* frame, std::string* error) = 0;
+
+  // The length of the media at |url|. Fails for live streams, which have
+  // none yet.
+  virtual bool Duration(const std::string& url, int64_t* duration_us,
+                        std::string* error) {
+    *error = "duration unknown";
+    return false;
+  }
+
+  // Encodes |frame| as |*format|. May change |*format| to one it supports.
+  virtual bool Encode(const VideoFrame& frame, int quality,
+                      ThumbnailFormat* format, std::vector<uint8_t>* out,
+                      std::string* error) = 0;
+};
+
+using ThumbnailCodecFactory = std::function<std::unique_ptr<ThumbnailCodec>()>;
+
+// Produces thumbnails off the calling thread.
+//
+// A pool of workers decodes the nearest keyframe, scales it down with
+// ScaleFrame() and encodes it. Results are kept in a ThumbnailCache keyed by
+// (url, time bucket, size, format); concurrent requests for the same key
+// share one decode.
+class ThumbnailEngine {
+ public:
+  struct Config {
+    int workers = 2;
+    // Requests within the same bucket share a thumbnail.
+    int64_t time_bucket_us = 2000000;
+    size_t cache_bytes = 16 * 1024 * 1024;
+  };
+
+  // Called once per request: synchronously on a cache hit, otherwise on a
+  // worker thread.
+  using Callback = std::function<void(const ThumbnailResult&)>;
+
+  ThumbnailEngine(ThumbnailCodecFactory codec_factory, Config config);
+  // Waits for the decode in progress on each worker; queued requests are
+  // answered with an error.
+  ~ThumbnailEngine();
+
+  ThumbnailEngine(const ThumbnailEngine&) = delete;
+  ThumbnailEngine& operator=(const ThumbnailEngine&) = delete;
+
+  void Request(const ThumbnailRequest& request, Callback callback);
+
+  ThumbnailKey KeyFor(const ThumbnailRequest& request) const;
+
+  ThumbnailCacheStats cache_stats() const { return cache_.stats(); }
+  // Keyframes decoded so far, i.e. requests that missed both the cache and
+  // an identical request in flight.
+  uint64_t decodes() const;
+
+ private:
+  struct Job {
+    ThumbnailKey key;
+    ThumbnailRequest request;
+  };
+
+  void WorkerLoop();
+  ThumbnailResult Produce(ThumbnailCodec* codec, const Job& job);
+  void Finish(const ThumbnailKey& key, const ThumbnailResult& result);
+
+  const ThumbnailCodecFactory codec_factory_;
+  const Config config_;
+  ThumbnailCache cache_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::deque<Job> queue_;
+  // Callbacks waiting on each key that is queued or being decoded.
+  std::unordered_map<ThumbnailKey, std::vector<Callback>, ThumbnailKeyHash>
+      waiting_;
+  uint64_t decodes_ = 0;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_THUMBNAIL_ENGINE_H_
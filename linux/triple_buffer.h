@@ -0,0 +1,59 @@
+#ifndef IVS_BROADCASTER_TRIPLE_BUFFER_H_
+#define IVS_BROADCASTER_TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace ivs_broadcaster {
+
+// Hands the latest value from one producer thread to one consumer thread
+// without locks or waiting on either side.
+//
+// The producer fills write_buffer() and calls Publish(), which swaps it with
+// the spare buffer. The consumer calls Update(), which swaps its buffer with
+// the spare one if something new was published, and reads read_buffer()
+// until its next Update(). Values the consumer did not get to in time are
+// overwritten, so it always sees the newest one.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Producer side.
+  T& write_buffer() { return buffers_[write_]; }
+  void Publish() {
+    const uint8_t previous =
+        spare_.exchange(static_cast<uint8_t>(write_ | kFresh),
+                       std::memory_order_acq_rel);
+    write_ = previous & kIndexMask;
+  }
+
+  // Consumer side. Returns true if read_buffer() now holds a newer value.
+  bool Update() {
+    if ((spare_.load(std::memory_order_relaxed) & kFresh) == 0) return false;
+    // Only the consumer clears kFresh, so the spare is still fresh here,
+    // though the producer may have replaced it with a newer value.
+    const uint8_t previous = spare_.exchange(read_, std::memory_order_acq_rel);
+    read_ = previous & kIndexMask;
+    return true;
+  }
+  const T& read_buffer() const { return buffers_[read_]; }
+  T& read_buffer() { return buffers_[read_]; }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFresh = 0x4;
+
+  T buffers_[3];
+  uint8_t write_ = 0;
+  uint8_t read_ = 1;
+  // Index of the spare buffer, plus kFresh when it holds an unread value.
+  std::atomic<uint8_t> spare_{2};
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_TRIPLE_BUFFER_H_
@@ -0,0 +1,59 @@
+#include "video_frame.h"
+
+#include <cstddef>
+
+namespace ivs_broadcaster {
+
+void VideoFrame::Allocate(int w, int h) {
+  width = w;
+  height = h;
+  data.resize(static_cast<size_t>(y_stride()) * height +
+              2 * static_cast<size_t>(uv_stride()) * uv_height());
+}
+
+SyntheticFrameSource::SyntheticFrameSource(int width, int height, int fps)
+    : width_(width), height_(height), fps_(fps > 0 ? fps : 30) {}
+
+void SyntheticFrameSource::Next(VideoFrame* frame) {
+  frame->Allocate(width_, height_);
+  frame->pts_us = Fill(frame->y(), frame->u(), frame->v());
+}
+
+int64_t SyntheticFrameSource::Fill(uint8_t* y, uint8_t* u, uint8_t* v) {
+  const int y_stride = width_;
+  const int uv_stride = (width_ + 1) / 2;
+  const int uv_height = (height_ + 1) / 2;
+  const int64_t pts_us = index_ * 1000000 / fps_;
+
+  // A diagonal gradient scrolling by a few pixels per frame, overlaid with a
+  // band of xorshift noise that moves down the picture.
+  const int shift = static_cast<int>(index_ * 3);
+  const int band_top = static_cast<int>((index_ * 8) % height_);
+  const int band_bottom = band_top + height_ / 8;
+  for (int row = 0; row < height_; ++row) {
+    uint8_t* line = y + static_cast<size_t>(row) * y_stride;
+    const bool noisy = row >= band_top && row < band_bottom;
+    for (int col = 0; col < width_; ++col) {
+      uint8_t value = static_cast<uint8_t>((row + col + shift) & 0xff);
+      if (noisy) {
+        noise_ ^= noise_ << 13;
+        noise_ ^= noise_ >> 17;
+        noise_ ^= noise_ << 5;
+        value = static_cast<uint8_t>(noise_);
+      }
+      line[col] = value;
+    }
+  }
+
+  const uint8_t cb = static_cast<uint8_t>(128 + (index_ % 64) - 32);
+  const uint8_t cr = static_cast<uint8_t>(128 - (index_ % 64) + 32);
+  const size_t chroma = static_cast<size_t>(uv_stride) * uv_height;
+  for (size_t i = 0; i < chroma; ++i) {
+    u[i] = cb;
+    v[i] = cr;
+  }
+  ++index_;
+  return pts_us;
+}
+
+}  // namespace ivs_broadcaster
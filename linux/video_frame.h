@@ -0,0 +1,57 @@
+#ifndef IVS_BROADCASTER_VIDEO_FRAME_H_
+#define IVS_BROADCASTER_VIDEO_FRAME_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// An I420 (planar YUV 4:2:0) frame owned by the native pipeline. The three
+// planes are stored back to back in |data| with tightly packed strides.
+struct VideoFrame {
+  int width = 0;
+  int height = 0;
+  int64_t pts_us = 0;
+  std::vector<uint8_t> data;
+
+  // Resizes |data| for a |w| x |h| frame. Existing contents are not cleared.
+  void Allocate(int w, int h);
+
+  int y_stride() const { return width; }
+  int uv_stride() const { return (width + 1) / 2; }
+  int uv_height() const { return (height + 1) / 2; }
+
+  uint8_t* y() { return data.data(); }
+  uint8_t* u() { return y() + y_stride() * height; }
+  uint8_t* v() { return u() + uv_stride() * uv_height(); }
+  const uint8_t* y() const { return data.data(); }
+  const uint8_t* u() const { return y() + y_stride() * height; }
+  const uint8_t* v() const { return u() + uv_stride() * uv_height(); }
+};
+
+// Produces a moving test pattern so encoders and transports can be exercised
+// without a camera. Each frame carries enough motion and texture that an
+// encoder cannot treat it as static content.
+class SyntheticFrameSource {
+ public:
+  SyntheticFrameSource(int width, int height, int fps);
+
+  // Fills |frame| with the next pattern and advances the presentation clock.
+  void Next(VideoFrame* frame);
+
+  // Draws the next pattern into tightly packed I420 planes that already hold
+  // a frame of this source's size, such as a shared-memory slot, and returns
+  // its presentation timestamp.
+  int64_t Fill(uint8_t* y, uint8_t* u, uint8_t* v);
+
+ private:
+  int width_;
+  int height_;
+  int fps_;
+  int64_t index_ = 0;
+  uint32_t noise_ = 0x9e3779b9u;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_VIDEO_FRAME_H_
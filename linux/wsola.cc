@@ -0,0 +1,137 @@
+#include "wsola.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ivs_broadcaster {
+
+namespace {
+
+// The search first compares every other candidate on every other frame,
+// then refines around the best one.
+constexpr int kCoarseStep = 2;
+constexpr double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+WsolaStretcher::WsolaStretcher(int sample_rate, int channels)
+    : sample_rate_(sample_rate),
+      channels_(std::max(channels, 1)),
+      window_(std::max(sample_rate / 50, 8) & ~1),
+      hop_(window_ / 2),
+      tolerance_(std::max(sample_rate / 100, 1)) {
+  // Periodic, so that windows half a window apart sum to exactly one.
+  hann_.resize(window_);
+  for (int i = 0; i < window_; ++i) {
+    hann_[i] =
+        static_cast<float>(0.5 - 0.5 * std::cos(2 * kPi * i / window_));
+  }
+  overlap_.assign(static_cast<size_t>(hop_) * channels_, 0);
+}
+
+void WsolaStretcher::SetRate(double rate) { rate_ = rate > 0 ? rate : 1; }
+
+void WsolaStretcher::Reset() {
+  input_.clear();
+  input_start_ = 0;
+  nominal_ = 0;
+  last_ = -1;
+  std::fill(overlap_.begin(), overlap_.end(), 0.0f);
+}
+
+int64_t WsolaStretcher::Process(const float* input, int frames,
+                                std::vector<float>* output) {
+  input_.insert(input_.end(), input, input + frames * channels_);
+  int64_t first = -1;
+  while (true) {
+    const int available = static_cast<int>(input_.size() / channels_);
+    const int nominal =
+        static_cast<int>(std::llround(nominal_) - input_start_);
+    const int target =
+        last_ < 0 ? nominal : static_cast<int>(last_ + hop_ - input_start_);
+    // The furthest any candidate, or the target, reads.
+    if (std::max(nominal + tolerance_, target) + window_ > available) break;
+    const int start = last_ < 0 ? nominal : BestMatch(nominal, target);
+    const float* segment = input_.data() + start * channels_;
+    if (last_ >= 0) {
+      // The second half of the last segment and the first of this one.
+      if (first < 0) first = input_start_ + start;
+      for (int i = 0; i < hop_; ++i) {
+        for (int c = 0; c < channels_; ++c) {
+          const int index = i * channels_ + c;
+          output->push_back(overlap_[index] + hann_[i] * segment[index]);
+        }
+      }
+    }
+    for (int i = 0; i < hop_; ++i) {
+      for (int c = 0; c < channels_; ++c) {
+        const int index = i * channels_ + c;
+        overlap_[index] = hann_[hop_ + i] * segment[hop_ * channels_ + index];
+      }
+    }
+    last_ = input_start_ + start;
+    nominal_ += hop_ * rate_;
+    // Input before both the next target and the earliest next candidate is
+    // never read again.
+    const int64_t keep =
+        std::min<int64_t>(std::llround(nominal_) - tolerance_, last_ + hop_);
+    if (keep > input_start_) {
+      const int64_t drop = std::min<int64_t>(keep - input_start_, available);
+      input_.erase(input_.begin(), input_.begin() + drop * channels_);
+      input_start_ += drop;
+    }
+  }
+  return first;
+}
+
+int WsolaStretcher::BestMatch(int nominal, int target) const {
+  const float* reference = input_.data() + target * channels_;
+  // Normalised cross-correlation over the overlap, channels mixed. The
+  // target's own energy is the same for every candidate and left out.
+  auto score = [&](int start, int step) {
+    const float* candidate = input_.data() + start * channels_;
+    double product = 0;
+    double energy = 0;
+    for (int i = 0; i < hop_; i += step) {
+      float a = 0;
+      float b = 0;
+      for (int c = 0; c < channels_; ++c) {
+        a += reference[i * channels_ + c];
+        b += candidate[i * channels_ + c];
+      }
+      product += static_cast<double>(a) * b;
+      energy += static_cast<double>(b) * b;
+    }
+    return product / (std::sqrt(energy) + 1e-9);
+  };
+  const int lowest = std::max(nominal - tolerance_, 0);
+  const int highest = nominal + tolerance_;
+  // Nearest the nominal position first; only a strictly better match moves
+  // away from it, so an exact copy of the target wins.
+  int best = std::clamp(nominal, lowest, highest);
+  double best_score = score(best, kCoarseStep);
+  for (int offset = kCoarseStep; offset <= tolerance_; offset += kCoarseStep) {
+    for (int start : {nominal - offset, nominal + offset}) {
+      if (start < lowest || start > highest) continue;
+      const double candidate = score(start, kCoarseStep);
+      if (candidate > best_score) {
+        best_score = candidate;
+        best = start;
+      }
+    }
+  }
+  const int coarse = best;
+  best_score = score(coarse, 1);
+  for (int start = coarse - kCoarseStep + 1; start < coarse + kCoarseStep;
+       ++start) {
+    if (start == coarse || start < lowest || start > highest) continue;
+    const double candidate = score(start, 1);
+    if (candidate > best_score) {
+      best_score = candidate;
+      best = start;
+    }
+  }
+  return best;
+}
+
+}  // namespace ivs_broadcaster
@@ -0,0 +1,67 @@
+#ifndef IVS_BROADCASTER_WSOLA_H_
+#define IVS_BROADCASTER_WSOLA_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace ivs_broadcaster {
+
+// Changes the speed of interleaved float audio without changing its pitch,
+// by waveform-similarity overlap-add (WSOLA, Verhelst and Roelands).
+//
+// Output is made of Hann-windowed input segments, each half a window after
+// the last. The input is read faster or slower than that by the rate, and
+// each segment is taken from where, within a small tolerance of its nominal
+// position, it best matches the natural continuation of the segment before
+// it, so the waveforms line up and no phase jumps are heard. At a rate of
+// exactly 1 this reproduces the input, delayed by the window.
+class WsolaStretcher {
+ public:
+  // A 20 ms window, and segments found within 10 ms of where they would be.
+  WsolaStretcher(int sample_rate, int channels);
+
+  // Input seconds per output second, e.g. 1.1 to play 10% faster. Takes
+  // effect from the next segment.
+  void SetRate(double rate);
+  double rate() const { return rate_; }
+
+  // Takes |frames| frames of |channels| samples each from |input| and
+  // appends the output they complete to |output|. Returns the index, in
+  // input frames since the last Reset(), of the first frame appended, or
+  // -1 if none was.
+  int64_t Process(const float* input, int frames, std::vector<float>* output);
+
+  // Drops buffered input and output, e.g. after a seek.
+  void Reset();
+
+  int sample_rate() const { return sample_rate_; }
+  int channels() const { return channels_; }
+
+ private:
+  // Where, within the tolerance of |nominal|, the segment best matching
+  // |target| starts. Positions are in frames of input_.
+  int BestMatch(int nominal, int target) const;
+
+  const int sample_rate_;
+  const int channels_;
+  const int window_;
+  const int hop_;
+  const int tolerance_;
+  std::vector<float> hann_;
+  double rate_ = 1;
+
+  // Input not consumed yet; its first frame is |input_start_| frames into
+  // the stream.
+  std::vector<float> input_;
+  int64_t input_start_ = 0;
+  // Where the next segment should start, relative to |input_start_|.
+  double nominal_ = 0;
+  // Where the last segment started; -1 before the first.
+  int64_t last_ = -1;
+  // The second half of the last windowed segment, added to the next.
+  std::vector<float> overlap_;
+};
+
+}  // namespace ivs_broadcaster
+
+#endif  // IVS_BROADCASTER_WSOLA_H_